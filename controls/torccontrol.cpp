@@ -27,8 +27,12 @@
 #include "torcinput.h"
 #include "torcoutput.h"
 #include "../notify/torcnotification.h"
+#include "torccontrols.h"
 #include "torccontrol.h"
 
+// std
+#include <algorithm>
+
 /*! \brief Parse a Torc time string into days, hours, minutes and, if present, seconds.
  *
  * Valid times are of the format MM, HH:MM, DD:HH:MM with an optional trailing .SS for seconds.
@@ -159,13 +163,23 @@ QString TorcControl::DurationToString(int Days, quint64 Duration)
                       QStringLiteral("%1").arg(QTime(0, 0).addSecs(Duration).toString(QStringLiteral("hh:mm.ss")));
 }
 
-#define BLACKLIST QStringLiteral("SetValue,SetValid,InputValueChanged,InputValidChanged")
+#define BLACKLIST QStringLiteral("SetValue,SetValid")
 
 /*! \class TorcControl
  *
  * The control is 'valid' if all of its inputs are present, valid and have a known value.
  * It can then determine an output value.
  * If 'invalid' the output will be set to the default.
+ *
+ * Changes to input values and validity are recorded immediately but the output is not recalculated
+ * until the control is evaluated by TorcControls, which evaluates every control with changed inputs
+ * once, in topological order.
+ *
+ * Once validated, input state is held in flat arrays indexed in the order of m_inputs (m_inputDevices),
+ * with bitmasks of valid and known inputs, so an input change is an indexed update with no lookups.
+ * A control may have at most CONTROL_MAX_INPUTS inputs.
+ *
+ * \sa TorcPropagator
 */
 TorcControl::TorcControl(TorcControl::Type Type, const QVariantMap &Details)
   : TorcDevice(false, 0, 0, QStringLiteral("Control"), Details),
@@ -177,10 +191,14 @@ TorcControl::TorcControl(TorcControl::Type Type, const QVariantMap &Details)
     m_outputList(),
     m_inputs(),
     m_outputs(),
+    m_inputDevices(),
     m_inputValues(),
     m_lastInputValues(),
-    m_inputValids(),
-    m_allInputsValid(false)
+    m_allInputs(0),
+    m_validInputs(0),
+    m_knownInputs(0),
+    m_lastKnownInputs(0),
+    m_propagatorIndex(-1)
 {
     // parse inputs
     QVariantMap inputs = Details.value(QStringLiteral("inputs")).toMap();
@@ -208,6 +226,13 @@ bool TorcControl::Validate(void)
     if (!m_parsed)
         return false;
 
+    if (m_inputList.size() > CONTROL_MAX_INPUTS)
+    {
+        LOG(VB_GENERAL, LOG_ERR, QStringLiteral("Control '%1' has %2 inputs (maximum %3)")
+            .arg(uniqueId).arg(m_inputList.size()).arg(CONTROL_MAX_INPUTS));
+        return false;
+    }
+
     // validate inputs
     foreach (QString input, m_inputList)
     {
@@ -292,6 +317,25 @@ bool TorcControl::AllowInputs(void) const
     return true;
 }
 
+/*! \brief Return true if the control must be evaluated in the main thread.
+ *
+ * Controls that use the main thread TorcTimerScheduler or TorcTransitionClock cannot be evaluated on the thread pool.
+*/
+bool TorcControl::RequiresMainThread(void) const
+{
+    return GetType() != TorcControl::Logic;
+}
+
+/// Called by TorcTimerScheduler when a timeout scheduled by the control is due. The default implementation does nothing.
+void TorcControl::TimerTimeout(void)
+{
+}
+
+/// Called by TorcTimerScheduler when the system time changes. The default implementation does nothing.
+void TorcControl::SystemTimeChanged(void)
+{
+}
+
 QString TorcControl::GetUIName(void)
 {
     QMutexLocker locker(&lock);
@@ -438,8 +482,7 @@ bool TorcControl::Finish(void)
                 return false;
             }
 
-            connect(this, &TorcControl::ValidChanged, control, &TorcControl::InputValidChanged, Qt::UniqueConnection);
-            connect(this, &TorcControl::ValueChanged, control, &TorcControl::InputValueChanged, Qt::UniqueConnection);
+            // NB the receiving control connects itself to its inputs
         }
         else if (qobject_cast<TorcNotification*>(it.key()))
         {
@@ -461,11 +504,19 @@ bool TorcControl::Finish(void)
         }
     }
 
-    it = m_inputs.constBegin();
-    for ( ; it != m_inputs.constEnd(); ++it)
+    m_inputDevices    = m_inputs.keys().toVector();
+    m_inputValues     = QVector<double>(m_inputDevices.size(), 0.0);
+    m_lastInputValues = QVector<double>(m_inputDevices.size(), 0.0);
+    m_allInputs       = m_inputDevices.size() < 64 ? (Q_UINT64_C(1) << m_inputDevices.size()) - 1 : ~Q_UINT64_C(0);
+    m_validInputs     = 0;
+    m_knownInputs     = 0;
+    m_lastKnownInputs = 0;
+
+    for (int index = 0; index < m_inputDevices.size(); ++index)
     {
-        TorcControl *control = qobject_cast<TorcControl*>(it.key());
-        TorcInput     *input = qobject_cast<TorcInput*>(it.key());
+        QObject *object      = m_inputDevices.at(index);
+        TorcControl *control = qobject_cast<TorcControl*>(object);
+        TorcInput     *input = qobject_cast<TorcInput*>(object);
 
         // an input must be a sensor or control
         if (!control && !input)
@@ -482,17 +533,13 @@ bool TorcControl::Finish(void)
             return false;
         }
 
-        if (control)
-        {
-            connect(control, &TorcControl::ValidChanged, this, &TorcControl::InputValidChanged, Qt::UniqueConnection);
-            connect(control, &TorcControl::ValueChanged, this, &TorcControl::InputValueChanged, Qt::UniqueConnection);
-        }
-        else
-        {
-            connect(input, &TorcInput::ValidChanged, this, &TorcControl::InputValidChanged, Qt::UniqueConnection);
-            connect(input, &TorcInput::ValueChanged, this, &TorcControl::InputValueChanged, Qt::UniqueConnection);
-        }
-        m_inputValids.insert(it.key(), false);
+        // bind the input index into the connection - no need for sender()
+        // NB controls in the same component may be evaluated on a worker thread, so control inputs are
+        // connected directly to keep the pass on that thread. Sensor changes are delivered to the main thread.
+        TorcDevice *device = control ? static_cast<TorcDevice*>(control) : static_cast<TorcDevice*>(input);
+        Qt::ConnectionType type = control ? Qt::DirectConnection : Qt::AutoConnection;
+        connect(device, &TorcDevice::ValidChanged, this, [this, index](bool Valid)    { InputValidChanged(index, Valid); }, type);
+        connect(device, &TorcDevice::ValueChanged, this, [this, index](double Value) { InputValueChanged(index, Value); }, type);
     }
 
     LOG(VB_GENERAL, LOG_DEBUG, QStringLiteral("%1: Ready").arg(uniqueId));
@@ -500,56 +547,138 @@ bool TorcControl::Finish(void)
     return true;
 }
 
+/*! \brief Disconnect the control from its inputs and release its outputs.
+ *
+ * \sa TorcDevice::Retire
+*/
+void TorcControl::Retire(void)
+{
+    QVector<QObject*> inputs;
+    QList<QObject*> outputs;
+    {
+        QMutexLocker locker(&lock);
+        inputs  = m_inputDevices;
+        outputs = m_outputs.keys();
+        m_validated = false;
+    }
+
+    foreach (QObject *input, inputs)
+        QObject::disconnect(input, nullptr, this, nullptr);
+
+    foreach (QObject *output, outputs)
+    {
+        TorcOutput *out = qobject_cast<TorcOutput*>(output);
+        if (out)
+            out->ReleaseOwner(this);
+    }
+
+    TorcDevice::Retire();
+}
+
+/*! \brief Seed the control with the current state of its inputs.
+ *
+ * Controls created when the configuration is reloaded may be connected to inputs that are already running and will
+ * not signal until they next change.
+*/
+void TorcControl::Prime(void)
+{
+    QVector<QObject*> inputs;
+    {
+        QMutexLocker locker(&lock);
+        if (!m_parsed || !m_validated)
+            return;
+        inputs = m_inputDevices;
+    }
+
+    // NB read the inputs without holding our lock
+    for (int index = 0; index < inputs.size(); ++index)
+    {
+        TorcDevice *device = qobject_cast<TorcDevice*>(inputs.at(index));
+        if (device && device->GetValid())
+        {
+            InputValueChanged(index, device->GetValue());
+            InputValidChanged(index, true);
+        }
+    }
+}
+
 void TorcControl::SubscriberDeleted(QObject *Subscriber)
 {
     TorcHTTPService::HandleSubscriberDeleted(Subscriber);
 }
 
-void TorcControl::InputValueChanged(double Value)
+/// Return the dense index for Input or -1 if it is not an input.
+int TorcControl::InputIndex(QObject *Input) const
 {
-    QMutexLocker locker(&lock);
-
-    if (!m_parsed || !m_validated)
-        return;
+    return m_inputDevices.indexOf(Input);
+}
 
-    QObject *input = sender();
+void TorcControl::InputValueChanged(int Index, double Value)
+{
+    QMutexLocker locker(&lock);
 
-    // a valid input
-    if (!input)
+    if (!m_parsed || !m_validated || Index < 0 || Index >= m_inputValues.size())
         return;
 
-    // a known input
-    if (!m_inputs.contains(input))
-        return;
+    quint64 bit = Q_UINT64_C(1) << Index;
+    double *values = m_inputValues.data();
 
     // ignore known values
-    if (m_inputValids.contains(input) && m_inputValids.value(input) == true)
-        if (m_inputValues.contains(input) && qFuzzyCompare(m_inputValues.value(input) + 1.0, Value + 1.0))
-            return;
+    if ((m_validInputs & m_knownInputs & bit) && qFuzzyCompare(values[Index] + 1.0, Value + 1.0))
+        return;
 
-    // set the last value if known. Otherwise set to new which will not trigger any change.
-    double lastvalue = m_inputValues.contains(input) ? m_inputValues.value(input) : Value;
+    // the last value is the value when the control was last evaluated. If unknown, use the current
+    // value or, if this is the first value, the new value which will not trigger any change.
+    if (!(m_lastKnownInputs & bit))
+    {
+        m_lastInputValues.data()[Index] = (m_knownInputs & bit) ? values[Index] : Value;
+        m_lastKnownInputs |= bit;
+    }
 
-    m_inputValues[input]     = Value;
-    m_lastInputValues[input] = lastvalue;
+    values[Index] = Value;
+    m_knownInputs |= bit;
 
     // as for sensors, setting an input value is assumed to make the input valid
-    InputValidChangedPriv(input, true);
+    InputValidChangedPriv(Index, true);
 
     // check for an update to the output
-    CheckInputValues();
+    ScheduleEvaluation();
 }
 
-void TorcControl::CheckInputValues(void)
+/*! \brief Request evaluation of the control's output.
+ *
+ * Evaluation is deferred to TorcControls if the control is part of the validated control graph,
+ * otherwise the control is evaluated immediately.
+*/
+void TorcControl::ScheduleEvaluation(void)
+{
+    if (m_propagatorIndex < 0 || !TorcControls::gControls->ScheduleControl(this))
+        Evaluate();
+}
+
+/*! \brief Update the output from the current input values.
+ *
+ * Last input values are updated to reflect the values used for this evaluation, so edge
+ * triggered operations (e.g. Toggle) see changes relative to the last evaluation.
+*/
+void TorcControl::Evaluate(void)
 {
     QMutexLocker locker(&lock);
 
+    CheckInputValues();
+    std::copy(m_inputValues.constBegin(), m_inputValues.constEnd(), m_lastInputValues.begin());
+    m_lastKnownInputs = m_knownInputs;
+}
+
+/// \note The caller must hold lock.
+void TorcControl::CheckInputValues(void)
+{
     if (!m_parsed || !m_validated)
         return;
 
-    bool isvalid = m_validated && m_allInputsValid && (m_inputList.size() == m_inputValues.size());
+    bool isvalid = (m_validInputs & m_knownInputs) == m_allInputs;
 
-    SetValid(isvalid);
+    SetValidPriv(isvalid);
     if (!isvalid)
         return;
 
@@ -557,73 +686,67 @@ void TorcControl::CheckInputValues(void)
     CalculateOutput();
 }
 
-void TorcControl::InputValidChanged(bool Valid)
+void TorcControl::InputValidChanged(int Index, bool Valid)
 {
     QMutexLocker locker(&lock);
 
-    if (!m_parsed || !m_validated)
+    if (!m_parsed || !m_validated || Index < 0 || Index >= m_inputValues.size())
         return;
 
-    QObject* input = sender();
-    if (input)
-    {
-        InputValidChangedPriv(input, Valid);
-        CheckInputValues();
-    }
+    InputValidChangedPriv(Index, Valid);
+    ScheduleEvaluation();
 }
 
-void TorcControl::InputValidChangedPriv(QObject *Input, bool Valid)
+/// \note The caller must hold lock and check Index.
+void TorcControl::InputValidChangedPriv(int Index, bool Valid)
 {
-    if (!m_parsed || !m_validated)
-        return;
+    quint64 bit = Q_UINT64_C(1) << Index;
 
-    // a valid input
-    if (!Input)
-        return;
-
-    // a known input
-    if (!m_inputs.contains(Input))
-        return;
-
-    // ignore known values
-    if (m_inputValids.contains(Input) && m_inputValids.value(Input) == Valid)
-        return;
-
-    m_inputValids[Input] = Valid;
-    m_allInputsValid     = Valid;
-
-    if (!Valid)
+    if (Valid)
     {
-        m_inputValues.remove(Input);
-        m_lastInputValues.remove(Input);
+        m_validInputs |= bit;
     }
     else
     {
-        foreach(bool inputvalid, m_inputValids)
-            m_allInputsValid &= inputvalid;
+        m_validInputs     &= ~bit;
+        m_knownInputs     &= ~bit;
+        m_lastKnownInputs &= ~bit;
     }
 }
 
 void TorcControl::SetValue(double Value)
 {
     QMutexLocker locker(&lock);
-
-    if (m_parsed && m_validated)
-        TorcDevice::SetValue(Value);
+    SetValuePriv(Value);
 }
 
 void TorcControl::SetValid(bool Valid)
 {
     QMutexLocker locker(&lock);
+    SetValidPriv(Valid);
+}
+
+/*! \brief Set the output value without re-taking lock.
+ *
+ * \note The caller must hold lock - as it does when evaluating the control (CheckInputValues and CalculateOutput).
+*/
+void TorcControl::SetValuePriv(double Value)
+{
+    if (m_parsed && m_validated)
+        TorcDevice::SetValuePriv(Value);
+}
 
+/// \note The caller must hold lock.
+void TorcControl::SetValidPriv(bool Valid)
+{
     if (m_parsed && m_validated)
     {
         // important!!
         // do this before SetValid as setting a value automatically sets validity.
         if (!Valid)
-            SetValue(defaultValue);
+            SetValuePriv(defaultValue);
 
-        TorcDevice::SetValid(Valid);
+        TorcDevice::SetValidPriv(Valid);
     }
 }
 
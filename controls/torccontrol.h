@@ -3,6 +3,7 @@
 
 // Qt
 #include <QMap>
+#include <QVector>
 #include <QObject>
 #include <QStringList>
 
@@ -11,10 +12,12 @@
 #include "torcdevice.h"
 
 #define CONTROLS_DIRECTORY QStringLiteral("controls")
+#define CONTROL_MAX_INPUTS 64
 
 class TorcControl : public TorcDevice, public TorcHTTPService
 {
     friend class TorcControls;
+    friend class TorcControlComponent;
 
     Q_OBJECT
     Q_CLASSINFO("Version", "1.0.0")
@@ -42,24 +45,33 @@ class TorcControl : public TorcDevice, public TorcHTTPService
     virtual TorcControl::Type GetType             (void) const = 0;
     virtual bool           IsPassthrough          (void);
     virtual bool           AllowInputs            (void) const;
+    virtual bool           RequiresMainThread     (void) const;
+    virtual void           TimerTimeout           (void);
+    virtual void           SystemTimeChanged      (void);
     bool                   IsKnownInput           (const QString &Input) const;
     bool                   IsKnownOutput          (const QString &Output) const;
     QString                GetUIName              (void) override;
+    void                   Retire                 (void) override;
+    void                   Prime                  (void);
 
   public slots:
     // TorcHTTPService
     void                   SubscriberDeleted      (QObject *Subscriber);
 
-    void                   InputValueChanged      (double Value);
-    void                   InputValidChanged      (bool   Valid);
-
   protected:
     void                   Graph                  (QByteArray* Data);
     bool                   Finish                 (void);
-    void                   InputValidChangedPriv  (QObject* Input, bool Valid);
+    int                    InputIndex             (QObject *Input) const;
+    void                   InputValueChanged      (int Index, double Value);
+    void                   InputValidChanged      (int Index, bool Valid);
+    void                   InputValidChangedPriv  (int Index, bool Valid);
+    void                   ScheduleEvaluation     (void);
+    void                   Evaluate               (void);
     void                   CheckInputValues       (void);
     void                   SetValue               (double Value) override;
     void                   SetValid               (bool Valid) override;
+    void                   SetValuePriv           (double Value);
+    void                   SetValidPriv           (bool Valid);
     virtual void           CalculateOutput        (void) = 0;
     bool                   CheckForCircularReferences (const QString &UniqueId, const QString &Path) const;
 
@@ -70,10 +82,15 @@ class TorcControl : public TorcDevice, public TorcHTTPService
     QStringList            m_outputList;
     QMap<QObject*,QString> m_inputs;
     QMap<QObject*,QString> m_outputs;
-    QMap<QObject*,double>  m_inputValues;
-    QMap<QObject*,double>  m_lastInputValues;
-    QMap<QObject*,bool>    m_inputValids;
-    bool                   m_allInputsValid;
+    // compiled input state, indexed in m_inputs order
+    QVector<QObject*>      m_inputDevices;
+    QVector<double>        m_inputValues;
+    QVector<double>        m_lastInputValues;
+    quint64                m_allInputs;
+    quint64                m_validInputs;
+    quint64                m_knownInputs;
+    quint64                m_lastKnownInputs;
+    int                    m_propagatorIndex;
 };
 
 #endif // TORCCONTROL_H
@@ -0,0 +1,185 @@
+/* Class TorcControlComponent
+*
+* Copyright (C) Mark Kendall 2018
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+*/
+
+// Torc
+#include "torclogging.h"
+#include "torccontrol.h"
+#include "torccontrolcomponent.h"
+
+/*! \class TorcControlComponent
+ *  \brief A weakly connected component of the control graph.
+ *
+ * Controls in different components share no inputs, outputs or other controls, so their evaluation
+ * is independent. Each component has its own TorcPropagator and runs at most one pass at a time - so ordering
+ * within a component is exactly as for a single graph - but separate components can be evaluated concurrently.
+ *
+ * A component with a thread pool runs its passes on the pool. A component without one is 'pinned' to the main thread,
+ * which TorcControls uses for any component containing timer, transition or windowed logic controls (which depend on
+ * the main thread TorcTimerScheduler and TorcTransitionClock).
+ *
+ * The latency between a control being scheduled and the pass that evaluates it completing is recorded for each component.
+ *
+ * \note Schedule may be called from any thread.
+*/
+TorcControlComponent::TorcControlComponent(const QList<TorcControl*> &Controls, const QVector<QVector<int> > &Inputs, QThreadPool *Pool)
+  : QRunnable(),
+    m_controls(Controls),
+    m_propagator(),
+    m_pool(Pool),
+    m_lock(),
+    m_queued(false),
+    m_latencyTimer(),
+    m_passes(0),
+    m_totalLatency(0),
+    m_maxLatency(0)
+{
+    setAutoDelete(false);
+    (void)m_propagator.Build(Inputs);
+}
+
+static int FindRoot(QVector<int> &Parent, int Node)
+{
+    while (Parent[Node] != Node)
+    {
+        Parent[Node] = Parent[Parent[Node]];
+        Node = Parent[Node];
+    }
+    return Node;
+}
+
+/*! \brief Assign each node of an undirected graph to a weakly connected component.
+ *
+ * Links[node] lists the nodes that node is connected to (in either direction). Components are numbered in order of
+ * their lowest node. Returns the number of components.
+*/
+int TorcControlComponent::Partition(const QVector<QVector<int> > &Links, QVector<int> &Components)
+{
+    int count = Links.size();
+    QVector<int> parent(count);
+    for (int node = 0; node < count; ++node)
+        parent[node] = node;
+
+    for (int node = 0; node < count; ++node)
+    {
+        foreach (int link, Links[node])
+        {
+            if (link < 0 || link >= count)
+                continue;
+            int one = FindRoot(parent, node);
+            int two = FindRoot(parent, link);
+            if (one != two)
+                parent[qMax(one, two)] = qMin(one, two);
+        }
+    }
+
+    int result = 0;
+    QVector<int> numbers(count, -1);
+    Components = QVector<int>(count, -1);
+    for (int node = 0; node < count; ++node)
+    {
+        int root = FindRoot(parent, node);
+        if (numbers[root] < 0)
+            numbers[root] = result++;
+        Components[node] = numbers[root];
+    }
+    return result;
+}
+
+/*! \brief Schedule Node for evaluation.
+ *
+ * Returns true if the caller must dispatch a pass (i.e. no pass is queued or running).
+*/
+bool TorcControlComponent::Schedule(int Node)
+{
+    QMutexLocker locker(&m_lock);
+    (void)m_propagator.Schedule(Node);
+    if (m_queued)
+        return false;
+    m_queued = true;
+    m_latencyTimer.start();
+    return true;
+}
+
+/*! \brief Evaluate all scheduled controls in topological order.
+ *
+ * Returns true if another pass is required (i.e. the graph contains a cycle).
+*/
+bool TorcControlComponent::Pass(void)
+{
+    QMutexLocker locker(&m_lock);
+    if (!m_queued)
+        return false;
+
+    int node = -1;
+    while ((node = m_propagator.Next()) > -1)
+    {
+        TorcControl *control = m_controls.value(node);
+        if (!control)
+            continue;
+        // NB controls scheduled by this evaluation are picked up by this pass
+        locker.unlock();
+        control->Evaluate();
+        locker.relock();
+    }
+
+    qint64 latency = m_latencyTimer.nsecsElapsed() / 1000;
+    m_passes++;
+    m_totalLatency += latency;
+    if (latency > m_maxLatency)
+        m_maxLatency = latency;
+
+    // controls in a cycle are deferred to the next pass
+    if (m_propagator.IsPending())
+    {
+        m_latencyTimer.start();
+        return true;
+    }
+
+    m_queued = false;
+    return false;
+}
+
+void TorcControlComponent::run(void)
+{
+    if (Pass() && m_pool)
+        m_pool->start(this);
+}
+
+bool TorcControlComponent::IsPinned(void) const
+{
+    return !m_pool;
+}
+
+/// Return the component's controls and latency statistics (in microseconds).
+QVariantMap TorcControlComponent::GetStatus(void)
+{
+    QMutexLocker locker(&m_lock);
+
+    QStringList controls;
+    foreach (TorcControl *control, m_controls)
+        controls.append(control->GetUniqueId());
+
+    QVariantMap result;
+    result.insert(QStringLiteral("controls"), controls);
+    result.insert(QStringLiteral("pinned"),   IsPinned());
+    result.insert(QStringLiteral("passes"),   m_passes);
+    result.insert(QStringLiteral("averageLatency"), m_passes ? m_totalLatency / (qint64)m_passes : 0);
+    result.insert(QStringLiteral("maxLatency"), m_maxLatency);
+    return result;
+}
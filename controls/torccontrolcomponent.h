@@ -0,0 +1,43 @@
+#ifndef TORCCONTROLCOMPONENT_H
+#define TORCCONTROLCOMPONENT_H
+
+// Qt
+#include <QMutex>
+#include <QVariant>
+#include <QRunnable>
+#include <QThreadPool>
+#include <QElapsedTimer>
+
+// Torc
+#include "torcpropagator.h"
+
+class TorcControl;
+
+class TorcControlComponent final : public QRunnable
+{
+  public:
+    TorcControlComponent(const QList<TorcControl*> &Controls, const QVector<QVector<int> > &Inputs, QThreadPool *Pool);
+   ~TorcControlComponent() = default;
+
+    static int          Partition        (const QVector<QVector<int> > &Links, QVector<int> &Components);
+
+    bool                Schedule         (int Node);
+    bool                Pass             (void);
+    void                run              (void) override;
+    bool                IsPinned         (void) const;
+    QVariantMap         GetStatus        (void);
+
+  private:
+    Q_DISABLE_COPY(TorcControlComponent)
+    QList<TorcControl*> m_controls;
+    TorcPropagator      m_propagator;
+    QThreadPool        *m_pool;
+    QMutex              m_lock;
+    bool                m_queued;
+    QElapsedTimer       m_latencyTimer;
+    quint64             m_passes;
+    qint64              m_totalLatency;
+    qint64              m_maxLatency;
+};
+
+#endif // TORCCONTROLCOMPONENT_H
@@ -19,13 +19,16 @@
 
 // Qt
 #include <QMutex>
+#include <QThread>
 
 // Torc
 #include "torclogging.h"
 #include "torccoreutils.h"
 #include "torclogiccontrol.h"
+#include "torcexpressioncontrol.h"
 #include "torctimercontrol.h"
 #include "torctransitioncontrol.h"
+#include "torccontrolcomponent.h"
 #include "torccontrols.h"
 
 TorcControls* TorcControls::gControls = new TorcControls();
@@ -37,7 +40,14 @@ TorcControls::TorcControls()
     TorcHTTPService(this, CONTROLS_DIRECTORY, QStringLiteral("controls"), TorcControls::staticMetaObject, BLACKLIST),
     TorcDeviceHandler(),
     controlList(),
-    controlTypes()
+    controlTypes(),
+    m_components(),
+    m_componentOf(),
+    m_localIndex(),
+    m_pool(),
+    m_holdLock(),
+    m_holds(0),
+    m_heldComponents()
 {
 }
 
@@ -73,7 +83,12 @@ void TorcControls::Create(const QVariantMap &Details)
 
             switch ((TorcControl::Type)type)
             {
-                case TorcControl::Logic:      controlList.append(new TorcLogicControl(it2.key(), details)); break;
+                case TorcControl::Logic:
+                    if (it2.key() == QStringLiteral("expression"))
+                        controlList.append(new TorcExpressionControl(details));
+                    else
+                        controlList.append(new TorcLogicControl(it2.key(), details));
+                    break;
                 case TorcControl::Timer:      controlList.append(new TorcTimerControl(it2.key(), details)); break;
                 case TorcControl::Transition: controlList.append(new TorcTransitionControl(it2.key(), details)); break;
                 default: break;
@@ -84,15 +99,39 @@ void TorcControls::Create(const QVariantMap &Details)
 
 void TorcControls::Destroy(void)
 {
-    QWriteLocker locker(&m_handlerLock);
+    Quiesce();
 
+    QWriteLocker locker(&m_handlerLock);
     foreach (TorcControl *control, controlList)
         control->DownRef();
     controlList.clear();
+    DeleteComponents();
+}
+
+/// \note The remaining controls are not propagated until Validate rebuilds the components.
+void TorcControls::RemoveDevices(const QStringList &UniqueIds, QStringList &Removed)
+{
+    Quiesce();
+
+    QWriteLocker locker(&m_handlerLock);
+    QMutableListIterator<TorcControl*> it(controlList);
+    while (it.hasNext())
+    {
+        TorcControl *control = it.next();
+        QString uniqueid = control->GetUniqueId();
+        if (UniqueIds.contains(uniqueid))
+        {
+            control->DownRef();
+            it.remove();
+            Removed.append(uniqueid);
+        }
+    }
 }
 
 void TorcControls::Validate(void)
 {
+    Quiesce();
+
     QWriteLocker locker(&m_handlerLock);
 
     // We first validate each control.
@@ -131,6 +170,245 @@ void TorcControls::Validate(void)
         QString path(QStringLiteral(""));
         (void)control->CheckForCircularReferences(id, path);
     }
+
+    BuildPropagator();
+}
+
+/*! \brief Partition the control graph into independent components and level each for ordered propagation.
+ *
+ * Sensors (and timers) are the sources of the graph and outputs the sinks. Only controls are scheduled. Controls
+ * are in the same component if they are connected through any device (including a shared sensor), so components
+ * never share state and each can be evaluated on its own thread.
+ *
+ * Components containing controls that require the main thread (see TorcControl::RequiresMainThread), and all
+ * components on single core machines, are evaluated in the main thread. The others are evaluated on a thread pool.
+*/
+void TorcControls::BuildPropagator(void)
+{
+    QWriteLocker locker(&m_handlerLock);
+
+    DeleteComponents();
+
+    // controls are nodes 0..n-1, any other device is allocated a node as it is seen
+    QHash<QObject*,int> indices;
+    for (int i = 0; i < controlList.size(); ++i)
+    {
+        indices.insert(controlList[i], i);
+        controlList[i]->m_propagatorIndex = i;
+    }
+
+    QVector<QVector<int> > links(controlList.size());
+    for (int i = 0; i < controlList.size(); ++i)
+    {
+        QList<QObject*> devices = controlList[i]->m_inputs.keys() + controlList[i]->m_outputs.keys();
+        foreach (QObject *device, devices)
+        {
+            if (!indices.contains(device))
+            {
+                indices.insert(device, links.size());
+                links.append(QVector<int>());
+            }
+            links[i].append(indices.value(device));
+        }
+    }
+
+    QVector<int> components;
+    int count = TorcControlComponent::Partition(links, components);
+
+    QVector<QList<TorcControl*> > members(count);
+    m_componentOf = QVector<int>(controlList.size(), -1);
+    m_localIndex  = QVector<int>(controlList.size(), -1);
+    for (int i = 0; i < controlList.size(); ++i)
+    {
+        m_componentOf[i] = components[i];
+        m_localIndex[i]  = members[components[i]].size();
+        members[components[i]].append(controlList[i]);
+    }
+
+    bool parallel = QThread::idealThreadCount() > 1;
+    int pinned = 0;
+    // NB every device is linked to a control, so no component is empty
+    for (int component = 0; component < count; ++component)
+    {
+        // inputs in local indices
+        bool pin = !parallel;
+        QVector<QVector<int> > inputs(members[component].size());
+        for (int i = 0; i < members[component].size(); ++i)
+        {
+            TorcControl *control = members[component][i];
+            if (control->RequiresMainThread())
+                pin = true;
+
+            QMap<QObject*,QString>::const_iterator it = control->m_inputs.constBegin();
+            for ( ; it != control->m_inputs.constEnd(); ++it)
+            {
+                int index = indices.value(it.key(), -1);
+                if (index > -1 && index < controlList.size())
+                    inputs[i].append(m_localIndex[index]);
+            }
+        }
+
+        if (pin)
+            pinned++;
+        m_components.append(new TorcControlComponent(members[component], inputs, pin ? nullptr : &m_pool));
+    }
+
+    LOG(VB_GENERAL, LOG_INFO, QStringLiteral("Control graph has %1 control(s) in %2 component(s) (%3 in the main thread)")
+        .arg(controlList.size()).arg(m_components.size()).arg(pinned));
+}
+
+/// \note The caller must hold the handler lock and ensure no passes are running (see Quiesce).
+void TorcControls::DeleteComponents(void)
+{
+    qDeleteAll(m_components);
+    m_components.clear();
+    {
+        QMutexLocker hold(&m_holdLock);
+        m_heldComponents.clear();
+    }
+    m_componentOf.clear();
+    m_localIndex.clear();
+}
+
+/*! \brief Stop scheduling and wait for any passes in progress.
+ *
+ * Until BuildPropagator is called again, controls are evaluated directly.
+*/
+void TorcControls::Quiesce(void)
+{
+    {
+        QWriteLocker locker(&m_handlerLock);
+        foreach (TorcControl *control, controlList)
+            control->m_propagatorIndex = -1;
+    }
+    m_pool.waitForDone();
+}
+
+/*! \brief Schedule evaluation of Control.
+ *
+ * Changes that arrive before the scheduled pass runs are coalesced. Returns false if the control is not
+ * part of the validated graph, in which case the caller must evaluate it directly.
+ *
+ * \note This may be called from any thread.
+*/
+bool TorcControls::ScheduleControl(TorcControl *Control)
+{
+    QReadLocker locker(&m_handlerLock);
+
+    int index = Control ? Control->m_propagatorIndex : -1;
+    if (index < 0 || index >= controlList.size() || controlList.at(index) != Control || index >= m_componentOf.size())
+        return false;
+
+    int component = m_componentOf.at(index);
+    TorcControlComponent *item = m_components.value(component);
+    if (!item)
+        return false;
+
+    if (item->Schedule(m_localIndex.at(index)))
+    {
+        {
+            QMutexLocker hold(&m_holdLock);
+            if (m_holds > 0)
+            {
+                m_heldComponents.insert(component);
+                return true;
+            }
+        }
+        StartComponent(component, item);
+    }
+    return true;
+}
+
+/// \note The caller must hold the handler lock.
+void TorcControls::StartComponent(int Component, TorcControlComponent *Item)
+{
+    if (Item->IsPinned())
+        QMetaObject::invokeMethod(this, "RunComponent", Qt::QueuedConnection, Q_ARG(int, Component));
+    else
+        m_pool.start(Item);
+}
+
+/*! \brief Defer the evaluation of controls until ReleasePropagation is called.
+ *
+ * Controls continue to be scheduled but no pass is started. This is used to apply a batch of input changes
+ * (see TorcInputs::SetInputValues) before any control sees them, so each affected control is evaluated once
+ * with the complete set of new values.
+ *
+ * Sensor changes are delivered to controls in the main thread, so the hold is applied there as well - in order
+ * with any changes signalled by the calling thread. Calls may be nested.
+*/
+void TorcControls::HoldPropagation(void)
+{
+    QMetaObject::invokeMethod(this, "Hold", Qt::AutoConnection);
+}
+
+/// Start any passes that were scheduled while propagation was held.
+void TorcControls::ReleasePropagation(void)
+{
+    QMetaObject::invokeMethod(this, "Release", Qt::AutoConnection);
+}
+
+void TorcControls::Hold(void)
+{
+    QMutexLocker locker(&m_holdLock);
+    m_holds++;
+}
+
+void TorcControls::Release(void)
+{
+    QList<int> components;
+    {
+        QMutexLocker locker(&m_holdLock);
+        if (m_holds < 1 || --m_holds > 0)
+            return;
+        components = m_heldComponents.toList();
+        m_heldComponents.clear();
+    }
+
+    QReadLocker locker(&m_handlerLock);
+    foreach (int component, components)
+    {
+        TorcControlComponent *item = m_components.value(component);
+        if (item)
+            StartComponent(component, item);
+    }
+}
+
+/// Run a pass for a component that is evaluated in the main thread.
+void TorcControls::RunComponent(int Component)
+{
+    QReadLocker locker(&m_handlerLock);
+
+    TorcControlComponent *component = m_components.value(Component);
+    if (component && component->IsPinned() && component->Pass())
+        QMetaObject::invokeMethod(this, "RunComponent", Qt::QueuedConnection, Q_ARG(int, Component));
+}
+
+/*! \brief Complete every scheduled pass.
+ *
+ * Passes for main thread components are run immediately and passes on the thread pool are waited for. Used
+ * when the caller needs the control graph to be settled (e.g. TorcSimulator).
+*/
+void TorcControls::Propagate(void)
+{
+    {
+        QReadLocker locker(&m_handlerLock);
+        foreach (TorcControlComponent *component, m_components)
+            if (component->IsPinned())
+                (void)component->Pass();
+    }
+    m_pool.waitForDone();
+}
+
+/// Return the controls, main thread status and evaluation latency of each independent component.
+QVariantList TorcControls::GetComponents(void)
+{
+    QReadLocker locker(&m_handlerLock);
+
+    QVariantList result;
+    foreach (TorcControlComponent *component, m_components)
+        result.append(component->GetStatus());
+    return result;
 }
 
 void TorcControls::Graph(QByteArray* Data)
@@ -1,12 +1,18 @@
 #ifndef TORCCONTROLS_H
 #define TORCCONTROLS_H
 
+// Qt
+#include <QSet>
+#include <QMutex>
+#include <QThreadPool>
 
 // Torc
 #include "torchttpservice.h"
 #include "torccentral.h"
 #include "torccontrol.h"
 
+class TorcControlComponent;
+
 class TorcControls final : public QObject, public TorcHTTPService, public TorcDeviceHandler
 {
     Q_OBJECT
@@ -23,9 +29,14 @@ class TorcControls final : public QObject, public TorcHTTPService, public TorcDe
 
     void                Create                    (const QVariantMap &Details) override;
     void                Destroy                   (void) override;
+    void                RemoveDevices             (const QStringList &UniqueIds, QStringList &Removed) override;
     void                Validate                  (void);
     void                Graph                     (QByteArray* Data);
     QString             GetUIName                 (void) override;
+    bool                ScheduleControl           (TorcControl *Control);
+    void                Propagate                 (void);
+    void                HoldPropagation           (void);
+    void                ReleasePropagation        (void);
 
   public slots:
     // TorcHTTPService
@@ -33,13 +44,32 @@ class TorcControls final : public QObject, public TorcHTTPService, public TorcDe
 
     QVariantMap         GetControlList            (void);
     QStringList         GetControlTypes           (void);
+    QVariantList        GetComponents             (void);
 
   signals:
     void                ControlsChanged           (void);
 
+  private slots:
+    void                RunComponent              (int Component);
+    void                Hold                      (void);
+    void                Release                   (void);
+
+  private:
+    void                BuildPropagator           (void);
+    void                DeleteComponents          (void);
+    void                Quiesce                   (void);
+    void                StartComponent            (int Component, TorcControlComponent *Item);
+
   private:
     QList<TorcControl*> controlList;
     QStringList         controlTypes;
+    QList<TorcControlComponent*> m_components;
+    QVector<int>        m_componentOf;
+    QVector<int>        m_localIndex;
+    QThreadPool         m_pool;
+    QMutex              m_holdLock;
+    int                 m_holds;
+    QSet<int>           m_heldComponents;
 };
 
 #endif // TORCCONTROLS_H
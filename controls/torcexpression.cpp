@@ -0,0 +1,470 @@
+/* Class TorcExpression
+*
+* Copyright (C) Mark Kendall 2018
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+*/
+
+// Qt
+#include <QtGlobal>
+
+// Torc
+#include "torcexpression.h"
+
+// std
+#include <cmath>
+
+static inline bool IsTrue(double Value)
+{
+    return !qFuzzyCompare(Value + 1.0, 1.0);
+}
+
+/*! \class TorcExpression
+ *  \brief Compiles an arithmetic/boolean expression over named inputs into stack based bytecode.
+ *
+ * Supported, in increasing order of precedence:
+ *  - '||', 'or'
+ *  - '&&', 'and'
+ *  - '<', '<=', '>', '>=', '==', '!=' (or 'lt', 'le', 'gt', 'ge', 'eq', 'ne', which avoid escaping in XML)
+ *  - '+', '-'
+ *  - '*', '/'
+ *  - unary '-', '!', 'not'
+ *  - numbers, 'true', 'false', min(a,b), max(a,b), abs(a), parentheses and input names.
+ *
+ * Input names are letters, digits and underscores. Names containing a '-' must be enclosed in braces (e.g. {tank-temp}).
+ * As for TorcLogicControl, any non-zero value is true and boolean operations return 1 or 0.
+ *
+ * Constant sub-expressions are folded during parsing. Names are recorded in order of first use (GetNames) and,
+ * once the owner knows where each value is stored, Bind replaces each name with the index of its value.
+ * Evaluate then requires no lookups or allocation.
+ *
+ * \note TorcExpression is not thread safe.
+*/
+TorcExpression::TorcExpression()
+  : m_source(),
+    m_position(0),
+    m_error(),
+    m_names(),
+    m_code(),
+    m_stack(),
+    m_bound(false)
+{
+}
+
+/// Parse and compile Expression. On failure, GetError describes the problem.
+bool TorcExpression::Parse(const QString &Expression)
+{
+    m_source   = Expression;
+    m_position = 0;
+    m_error    = QString();
+    m_names.clear();
+    m_code.clear();
+    m_stack.clear();
+    m_bound    = false;
+
+    if (!ParseOr())
+        return false;
+
+    SkipSpace();
+    if (m_position < m_source.size())
+        return Fail(QStringLiteral("Unexpected '%1'").arg(m_source.mid(m_position)));
+
+    // size the evaluation stack
+    int depth = 0;
+    int max   = 0;
+    foreach (const Instruction &instruction, m_code)
+    {
+        if (instruction.op == Constant || instruction.op == Input)
+            max = qMax(max, ++depth);
+        else if (!IsUnary(instruction.op))
+            depth--;
+    }
+    m_stack.resize(max);
+    return true;
+}
+
+/*! \brief Replace each input name with the position of its value.
+ *
+ * Indices must contain one entry for each name returned by GetNames.
+*/
+bool TorcExpression::Bind(const QVector<int> &Indices)
+{
+    if (m_bound || Indices.size() != m_names.size() || m_stack.isEmpty())
+        return false;
+
+    for (int i = 0; i < m_code.size(); ++i)
+        if (m_code[i].op == Input)
+            m_code[i].input = Indices.at(m_code.at(i).input);
+    m_bound = true;
+    return true;
+}
+
+/// Evaluate the expression. Values must contain every index passed to Bind.
+double TorcExpression::Evaluate(const double *Values)
+{
+    if (!m_bound || !Values)
+        return 0.0;
+
+    double *stack = m_stack.data();
+    int top = -1;
+
+    const Instruction *instruction = m_code.constData();
+    const Instruction *end         = instruction + m_code.size();
+    for ( ; instruction < end; ++instruction)
+    {
+        switch (instruction->op)
+        {
+            case Constant:
+                stack[++top] = instruction->value;
+                break;
+            case Input:
+                stack[++top] = Values[instruction->input];
+                break;
+            case Negate:
+            case Not:
+            case Absolute:
+                stack[top] = Apply(instruction->op, stack[top], 0.0);
+                break;
+            default:
+                top--;
+                stack[top] = Apply(instruction->op, stack[top], stack[top + 1]);
+                break;
+        }
+    }
+
+    return stack[0];
+}
+
+/// Input names in order of first use.
+const QStringList& TorcExpression::GetNames(void) const
+{
+    return m_names;
+}
+
+QString TorcExpression::GetError(void) const
+{
+    return m_error;
+}
+
+/// The number of instructions after constant folding.
+int TorcExpression::Size(void) const
+{
+    return m_code.size();
+}
+
+double TorcExpression::Apply(OpCode Op, double Left, double Right)
+{
+    switch (Op)
+    {
+        case Negate:         return -Left;
+        case Not:            return IsTrue(Left) ? 0.0 : 1.0;
+        case Absolute:       return std::fabs(Left);
+        case Add:            return Left + Right;
+        case Subtract:       return Left - Right;
+        case Multiply:       return Left * Right;
+        case Divide:         return Left / Right;
+        case Less:           return Left <  Right ? 1.0 : 0.0;
+        case LessOrEqual:    return Left <= Right ? 1.0 : 0.0;
+        case Greater:        return Left >  Right ? 1.0 : 0.0;
+        case GreaterOrEqual: return Left >= Right ? 1.0 : 0.0;
+        case Equal:          return qFuzzyCompare(Left + 1.0, Right + 1.0) ? 1.0 : 0.0;
+        case NotEqual:       return qFuzzyCompare(Left + 1.0, Right + 1.0) ? 0.0 : 1.0;
+        case And:            return IsTrue(Left) && IsTrue(Right) ? 1.0 : 0.0;
+        case Or:             return IsTrue(Left) || IsTrue(Right) ? 1.0 : 0.0;
+        case Minimum:        return qMin(Left, Right);
+        case Maximum:        return qMax(Left, Right);
+        case Constant:
+        case Input:
+            break;
+    }
+    return 0.0;
+}
+
+bool TorcExpression::IsUnary(OpCode Op)
+{
+    return Op == Negate || Op == Not || Op == Absolute;
+}
+
+void TorcExpression::SkipSpace(void)
+{
+    while (m_position < m_source.size() && m_source.at(m_position).isSpace())
+        m_position++;
+}
+
+bool TorcExpression::Accept(const QString &Token)
+{
+    SkipSpace();
+    if (m_source.midRef(m_position, Token.size()) != Token)
+        return false;
+    m_position += Token.size();
+    return true;
+}
+
+/// Accept a keyword that is not the start of a longer name.
+bool TorcExpression::AcceptWord(const QString &Word)
+{
+    SkipSpace();
+    if (m_source.midRef(m_position, Word.size()).compare(Word, Qt::CaseInsensitive) != 0)
+        return false;
+    int end = m_position + Word.size();
+    if (end < m_source.size() && (m_source.at(end).isLetterOrNumber() || m_source.at(end) == '_'))
+        return false;
+    m_position = end;
+    return true;
+}
+
+QString TorcExpression::ReadName(void)
+{
+    SkipSpace();
+    int start = m_position;
+    while (m_position < m_source.size() && (m_source.at(m_position).isLetterOrNumber() || m_source.at(m_position) == '_'))
+        m_position++;
+    return m_source.mid(start, m_position - start);
+}
+
+void TorcExpression::EmitConstant(double Value)
+{
+    m_code.append({ Constant, -1, Value });
+}
+
+void TorcExpression::EmitInput(const QString &Name)
+{
+    int index = m_names.indexOf(Name);
+    if (index < 0)
+    {
+        index = m_names.size();
+        m_names.append(Name);
+    }
+    m_code.append({ Input, index, 0.0 });
+}
+
+/*! \brief Append an operation, folding it if its operands are constant.
+ *
+ * An operand that ends with a Constant instruction must be that single instruction.
+*/
+void TorcExpression::Emit(OpCode Op)
+{
+    int size = m_code.size();
+    if (IsUnary(Op))
+    {
+        if (size > 0 && m_code.at(size - 1).op == Constant)
+        {
+            m_code[size - 1].value = Apply(Op, m_code.at(size - 1).value, 0.0);
+            return;
+        }
+    }
+    else if (size > 1 && m_code.at(size - 1).op == Constant && m_code.at(size - 2).op == Constant)
+    {
+        m_code[size - 2].value = Apply(Op, m_code.at(size - 2).value, m_code.at(size - 1).value);
+        m_code.removeLast();
+        return;
+    }
+
+    m_code.append({ Op, -1, 0.0 });
+}
+
+bool TorcExpression::ParseOr(void)
+{
+    if (!ParseAnd())
+        return false;
+    while (Accept(QStringLiteral("||")) || AcceptWord(QStringLiteral("or")))
+    {
+        if (!ParseAnd())
+            return false;
+        Emit(Or);
+    }
+    return true;
+}
+
+bool TorcExpression::ParseAnd(void)
+{
+    if (!ParseCompare())
+        return false;
+    while (Accept(QStringLiteral("&&")) || AcceptWord(QStringLiteral("and")))
+    {
+        if (!ParseCompare())
+            return false;
+        Emit(And);
+    }
+    return true;
+}
+
+bool TorcExpression::ParseCompare(void)
+{
+    if (!ParseAdd())
+        return false;
+
+    OpCode op = Constant;
+    if (Accept(QStringLiteral("<=")) || AcceptWord(QStringLiteral("le")))      op = LessOrEqual;
+    else if (Accept(QStringLiteral(">=")) || AcceptWord(QStringLiteral("ge"))) op = GreaterOrEqual;
+    else if (Accept(QStringLiteral("==")) || AcceptWord(QStringLiteral("eq"))) op = Equal;
+    else if (Accept(QStringLiteral("!=")) || AcceptWord(QStringLiteral("ne"))) op = NotEqual;
+    else if (Accept(QStringLiteral("<"))  || AcceptWord(QStringLiteral("lt"))) op = Less;
+    else if (Accept(QStringLiteral(">"))  || AcceptWord(QStringLiteral("gt"))) op = Greater;
+    else return true;
+
+    if (!ParseAdd())
+        return false;
+    Emit(op);
+    return true;
+}
+
+bool TorcExpression::ParseAdd(void)
+{
+    if (!ParseMultiply())
+        return false;
+    forever
+    {
+        OpCode op = Constant;
+        if (Accept(QStringLiteral("+")))      op = Add;
+        else if (Accept(QStringLiteral("-"))) op = Subtract;
+        else return true;
+
+        if (!ParseMultiply())
+            return false;
+        Emit(op);
+    }
+}
+
+bool TorcExpression::ParseMultiply(void)
+{
+    if (!ParseUnary())
+        return false;
+    forever
+    {
+        OpCode op = Constant;
+        if (Accept(QStringLiteral("*")))      op = Multiply;
+        else if (Accept(QStringLiteral("/"))) op = Divide;
+        else return true;
+
+        if (!ParseUnary())
+            return false;
+        Emit(op);
+    }
+}
+
+bool TorcExpression::ParseUnary(void)
+{
+    OpCode op = Constant;
+    // NB '!=' is only valid after an operand, so '!' here is always negation
+    if (Accept(QStringLiteral("-")))
+        op = Negate;
+    else if (Accept(QStringLiteral("!")) || AcceptWord(QStringLiteral("not")))
+        op = Not;
+    else
+        return ParsePrimary();
+
+    if (!ParseUnary())
+        return false;
+    Emit(op);
+    return true;
+}
+
+bool TorcExpression::ParsePrimary(void)
+{
+    SkipSpace();
+    if (m_position >= m_source.size())
+        return Fail(QStringLiteral("Unexpected end of expression"));
+
+    if (Accept(QStringLiteral("(")))
+    {
+        if (!ParseOr())
+            return false;
+        if (!Accept(QStringLiteral(")")))
+            return Fail(QStringLiteral("Expected ')' at %1").arg(m_position));
+        return true;
+    }
+
+    if (Accept(QStringLiteral("{")))
+    {
+        int end = m_source.indexOf('}', m_position);
+        if (end < 0)
+            return Fail(QStringLiteral("Expected '}' at %1").arg(m_position));
+        QString name = m_source.mid(m_position, end - m_position).trimmed();
+        if (name.isEmpty())
+            return Fail(QStringLiteral("Empty input name at %1").arg(m_position));
+        m_position = end + 1;
+        EmitInput(name);
+        return true;
+    }
+
+    QChar next = m_source.at(m_position);
+    if (next.isDigit() || next == '.')
+    {
+        int start = m_position;
+        while (m_position < m_source.size() && (m_source.at(m_position).isDigit() || m_source.at(m_position) == '.'))
+            m_position++;
+        bool ok = false;
+        double value = m_source.midRef(start, m_position - start).toDouble(&ok);
+        if (!ok)
+            return Fail(QStringLiteral("Invalid number '%1'").arg(m_source.mid(start, m_position - start)));
+        EmitConstant(value);
+        return true;
+    }
+
+    if (AcceptWord(QStringLiteral("true")))
+    {
+        EmitConstant(1.0);
+        return true;
+    }
+
+    if (AcceptWord(QStringLiteral("false")))
+    {
+        EmitConstant(0.0);
+        return true;
+    }
+
+    QString name = ReadName();
+    if (name.isEmpty())
+        return Fail(QStringLiteral("Unexpected '%1'").arg(m_source.mid(m_position)));
+
+    // functions
+    int position = m_position;
+    if (Accept(QStringLiteral("(")))
+    {
+        QString function = name.toLower();
+        int arguments = 0;
+        OpCode op = Constant;
+        if (function == QStringLiteral("min"))      { op = Minimum;  arguments = 2; }
+        else if (function == QStringLiteral("max")) { op = Maximum;  arguments = 2; }
+        else if (function == QStringLiteral("abs")) { op = Absolute; arguments = 1; }
+        else return Fail(QStringLiteral("Unknown function '%1'").arg(name));
+
+        for (int i = 0; i < arguments; ++i)
+        {
+            if (i > 0 && !Accept(QStringLiteral(",")))
+                return Fail(QStringLiteral("Expected ',' at %1").arg(m_position));
+            if (!ParseOr())
+                return false;
+        }
+        if (!Accept(QStringLiteral(")")))
+            return Fail(QStringLiteral("Expected ')' at %1").arg(m_position));
+        Emit(op);
+        return true;
+    }
+
+    m_position = position;
+    EmitInput(name);
+    return true;
+}
+
+bool TorcExpression::Fail(const QString &Error)
+{
+    if (m_error.isEmpty())
+        m_error = Error;
+    m_code.clear();
+    m_names.clear();
+    return false;
+}
@@ -0,0 +1,81 @@
+#ifndef TORCEXPRESSION_H
+#define TORCEXPRESSION_H
+
+// Qt
+#include <QVector>
+#include <QStringList>
+
+class TorcExpression
+{
+  public:
+    enum OpCode
+    {
+        Constant,
+        Input,
+        Negate,
+        Not,
+        Absolute,
+        Add,
+        Subtract,
+        Multiply,
+        Divide,
+        Less,
+        LessOrEqual,
+        Greater,
+        GreaterOrEqual,
+        Equal,
+        NotEqual,
+        And,
+        Or,
+        Minimum,
+        Maximum
+    };
+
+    TorcExpression();
+   ~TorcExpression() = default;
+
+    bool               Parse          (const QString &Expression);
+    bool               Bind           (const QVector<int> &Indices);
+    double             Evaluate       (const double *Values);
+    const QStringList& GetNames       (void) const;
+    QString            GetError       (void) const;
+    int                Size           (void) const;
+
+  private:
+    class Instruction
+    {
+      public:
+        OpCode op;
+        int    input;
+        double value;
+    };
+
+    static double      Apply          (OpCode Op, double Left, double Right);
+    static bool        IsUnary        (OpCode Op);
+    void               SkipSpace      (void);
+    bool               Accept         (const QString &Token);
+    bool               AcceptWord     (const QString &Word);
+    QString            ReadName       (void);
+    void               EmitConstant   (double Value);
+    void               EmitInput      (const QString &Name);
+    void               Emit           (OpCode Op);
+    bool               ParseOr        (void);
+    bool               ParseAnd       (void);
+    bool               ParseCompare   (void);
+    bool               ParseAdd       (void);
+    bool               ParseMultiply  (void);
+    bool               ParseUnary     (void);
+    bool               ParsePrimary   (void);
+    bool               Fail           (const QString &Error);
+
+  private:
+    QString              m_source;
+    int                  m_position;
+    QString              m_error;
+    QStringList          m_names;
+    QVector<Instruction> m_code;
+    QVector<double>      m_stack;
+    bool                 m_bound;
+};
+
+#endif // TORCEXPRESSION_H
@@ -0,0 +1,110 @@
+/* Class TorcExpressionControl
+*
+* Copyright (C) Mark Kendall 2018
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+*/
+
+// Torc
+#include "torclogging.h"
+#include "torcexpressioncontrol.h"
+
+/*! \class TorcExpressionControl
+ *  \brief A logic control that evaluates an expression over its inputs.
+ *
+ * The expression is given in <formula> and refers to its inputs by name (e.g. 'tank lt setpoint - 0.5 and heating and not pumpfault').
+ * Every name used in the formula is an input - so <inputs> is optional - and the state graph shows each of them as
+ * an input to this control. A single expression control replaces a chain of simple logic controls.
+ *
+ * The formula is parsed when the control is created (so that other devices can check their outputs) and is bound to
+ * the control's input values once it is validated.
+ *
+ * \sa TorcExpression
+*/
+TorcExpressionControl::TorcExpressionControl(const QVariantMap &Details)
+  : TorcControl(TorcControl::Logic, Details),
+    m_formula(Details.value(QStringLiteral("formula")).toString().trimmed()),
+    m_expression()
+{
+    if (!m_expression.Parse(m_formula))
+    {
+        LOG(VB_GENERAL, LOG_ERR, QStringLiteral("Failed to parse formula '%1' for control '%2' (%3)")
+            .arg(m_formula, uniqueId, m_expression.GetError()));
+        return;
+    }
+
+    if (m_expression.GetNames().isEmpty())
+    {
+        LOG(VB_GENERAL, LOG_ERR, QStringLiteral("Formula for control '%1' has no inputs").arg(uniqueId));
+        return;
+    }
+
+    m_inputList.append(m_expression.GetNames());
+    m_inputList.removeDuplicates();
+    m_parsed = true;
+}
+
+TorcControl::Type TorcExpressionControl::GetType(void) const
+{
+    return TorcControl::Logic;
+}
+
+QStringList TorcExpressionControl::GetDescription(void)
+{
+    return QStringList() << tr("Expression") << m_formula;
+}
+
+bool TorcExpressionControl::Validate(void)
+{
+    QMutexLocker locker(&lock);
+
+    // don't repeat validation
+    if (m_validated)
+        return true;
+
+    if (!TorcControl::Validate())
+        return false;
+
+    if (m_outputs.isEmpty())
+    {
+        LOG(VB_GENERAL, LOG_ERR, QStringLiteral("Device '%1' needs at least one output").arg(uniqueId));
+        return false;
+    }
+
+    if (!Finish())
+        return false;
+
+    // map each name in the formula to its dense input index
+    QVector<int> indices;
+    foreach (const QString &name, m_expression.GetNames())
+    {
+        int index = InputIndex(m_inputs.key(name));
+        if (index < 0)
+            return false;
+        indices.append(index);
+    }
+
+    if (!m_expression.Bind(indices))
+        return false;
+
+    LOG(VB_GENERAL, LOG_DEBUG, QStringLiteral("%1: formula compiled to %2 instructions").arg(uniqueId).arg(m_expression.Size()));
+    return true;
+}
+
+/// \note Called with lock held from TorcControl::CheckInputValues
+void TorcExpressionControl::CalculateOutput(void)
+{
+    SetValuePriv(m_expression.Evaluate(m_inputValues.constData()));
+}
@@ -0,0 +1,29 @@
+#ifndef TORCEXPRESSIONCONTROL_H
+#define TORCEXPRESSIONCONTROL_H
+
+// Torc
+#include "torcexpression.h"
+#include "torccontrol.h"
+
+class TorcExpressionControl : public TorcControl
+{
+    Q_OBJECT
+
+  public:
+    explicit TorcExpressionControl(const QVariantMap &Details);
+   ~TorcExpressionControl() = default;
+
+    bool                        Validate         (void) override;
+    TorcControl::Type           GetType          (void) const override;
+    QStringList                 GetDescription   (void) override;
+
+  private:
+    void                        CalculateOutput  (void) override;
+
+  private:
+    Q_DISABLE_COPY(TorcExpressionControl)
+    QString                     m_formula;
+    TorcExpression              m_expression;
+};
+
+#endif // TORCEXPRESSIONCONTROL_H
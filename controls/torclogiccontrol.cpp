@@ -22,10 +22,15 @@
 
 // Torc
 #include "torclogging.h"
+#include "torcclock.h"
 #include "torcinput.h"
 #include "torcoutput.h"
+#include "torctimerscheduler.h"
 #include "torclogiccontrol.h"
 
+#define DEFAULT_WINDOW_SAMPLES 1024
+#define MAX_WINDOW_SAMPLES     65536
+
 TorcLogicControl::Operation TorcLogicControl::StringToOperation(const QString &Operation)
 {
     QString operation = Operation.toUpper();
@@ -48,7 +53,13 @@ TorcLogicControl::Operation TorcLogicControl::StringToOperation(const QString &O
     if ("RUNNINGAVERAGE" == operation)     return TorcLogicControl::RunningAverage;
     if ("RUNNINGMAX" == operation)         return TorcLogicControl::RunningMax;
     if ("RUNNINGMIN" == operation)         return TorcLogicControl::RunningMin;
-
+    if ("WINDOWAVERAGE" == operation)      return TorcLogicControl::WindowAverage;
+    if ("WINDOWMAX" == operation)          return TorcLogicControl::WindowMax;
+    if ("WINDOWMIN" == operation)          return TorcLogicControl::WindowMin;
+    if ("WINDOWDEVIATION" == operation)    return TorcLogicControl::WindowDeviation;
+    if ("RATEOFCHANGE" == operation)       return TorcLogicControl::RateOfChange;
+    if ("EXPONENTIALAVERAGE" == operation) return TorcLogicControl::ExponentialAverage;
+    if ("PERCENTILE" == operation)         return TorcLogicControl::Percentile;
 
     return TorcLogicControl::UnknownLogicType;
 }
@@ -70,6 +81,23 @@ inline bool IsComplexType(TorcLogicControl::Operation Type)
     return false;
 }
 
+/// Operations that aggregate a single input over a period of time.
+inline bool IsWindowType(TorcLogicControl::Operation Type)
+{
+    if (Type == TorcLogicControl::WindowAverage ||
+        Type == TorcLogicControl::WindowMax ||
+        Type == TorcLogicControl::WindowMin ||
+        Type == TorcLogicControl::WindowDeviation ||
+        Type == TorcLogicControl::RateOfChange ||
+        Type == TorcLogicControl::ExponentialAverage ||
+        Type == TorcLogicControl::Percentile)
+    {
+        return true;
+    }
+
+    return false;
+}
+
 TorcLogicControl::TorcLogicControl(const QString &Type, const QVariantMap &Details)
   : TorcControl(TorcControl::Logic, Details),
     m_operation(TorcLogicControl::StringToOperation(Type)),
@@ -78,9 +106,17 @@ TorcLogicControl::TorcLogicControl(const QString &Type, const QVariantMap &Detai
     m_inputDevice(nullptr),
     m_triggerDeviceId(),
     m_triggerDevice(nullptr),
+    m_referenceIndex(-1),
+    m_inputIndex(-1),
+    m_triggerIndex(-1),
     m_average(),
     m_firstRunningValue(true),
-    m_runningValue(0)
+    m_runningValue(0),
+    m_statistics(nullptr),
+    m_exponentialAverage(nullptr),
+    m_percentile(nullptr),
+    m_expiryHandle(-1),
+    m_expired(false)
 {
     if (m_operation == TorcLogicControl::UnknownLogicType)
     {
@@ -141,11 +177,66 @@ TorcLogicControl::TorcLogicControl(const QString &Type, const QVariantMap &Detai
         }
     }
 
+    // these operations require a window (and percentile requires a percentile...)
+    if (IsWindowType(m_operation))
+    {
+        int days, hours, minutes, seconds;
+        quint64 window = 0;
+        QString windows = Details.value(QStringLiteral("window")).toString();
+        if (!TorcControl::ParseTimeString(windows, days, hours, minutes, seconds, window) || window < 1)
+        {
+            LOG(VB_GENERAL, LOG_ERR, QStringLiteral("Control '%1' has no valid window ('%2')").arg(uniqueId, windows));
+            return;
+        }
+
+        // the number of samples retained within the window - this fixes the memory used
+        int samples = DEFAULT_WINDOW_SAMPLES;
+        if (Details.contains(QStringLiteral("samples")))
+        {
+            bool ok = false;
+            samples = Details.value(QStringLiteral("samples")).toInt(&ok);
+            if (!ok || samples < 2 || samples > MAX_WINDOW_SAMPLES)
+            {
+                LOG(VB_GENERAL, LOG_ERR, QStringLiteral("Control '%1' has invalid samples (must be 2-%2)").arg(uniqueId).arg(MAX_WINDOW_SAMPLES));
+                return;
+            }
+        }
+
+        qint64 windowms = static_cast<qint64>(window) * 1000;
+        if (m_operation == TorcLogicControl::ExponentialAverage)
+        {
+            m_exponentialAverage = new TorcEWMA(windowms);
+        }
+        else if (m_operation == TorcLogicControl::Percentile)
+        {
+            bool ok = false;
+            double percentile = Details.value(QStringLiteral("percentile")).toDouble(&ok);
+            if (!ok || percentile < 0.0 || percentile > 100.0)
+            {
+                LOG(VB_GENERAL, LOG_ERR, QStringLiteral("Control '%1' has no valid percentile (must be 0-100)").arg(uniqueId));
+                return;
+            }
+            m_percentile = new TorcWindowPercentile(percentile / 100.0, windowms);
+        }
+        else
+        {
+            m_statistics = new TorcWindowStatistics(windowms, samples);
+        }
+    }
+
     // everything appears to be valid at this stage
     m_inputList.removeDuplicates();
     m_parsed = true;
 }
 
+TorcLogicControl::~TorcLogicControl()
+{
+    TorcTimerScheduler::gTimerScheduler->Deregister(m_expiryHandle);
+    delete m_statistics;
+    delete m_exponentialAverage;
+    delete m_percentile;
+}
+
 TorcControl::Type TorcLogicControl::GetType(void) const
 {
     return TorcControl::Logic;
@@ -219,6 +310,27 @@ QStringList TorcLogicControl::GetDescription(void)
         case TorcLogicControl::RunningMin:
             result.append(tr("Running min"));
             break;
+        case TorcLogicControl::WindowAverage:
+            result.append(tr("Window average"));
+            break;
+        case TorcLogicControl::WindowMax:
+            result.append(tr("Window max"));
+            break;
+        case TorcLogicControl::WindowMin:
+            result.append(tr("Window min"));
+            break;
+        case TorcLogicControl::WindowDeviation:
+            result.append(tr("Window deviation"));
+            break;
+        case TorcLogicControl::RateOfChange:
+            result.append(tr("Rate of change"));
+            break;
+        case TorcLogicControl::ExponentialAverage:
+            result.append(tr("Exponential average"));
+            break;
+        case TorcLogicControl::Percentile:
+            result.append(tr("Percentile"));
+            break;
         case TorcLogicControl::UnknownLogicType:
             result.append(tr("Unknown"));
             break;
@@ -288,6 +400,13 @@ bool TorcLogicControl::Validate(void)
         case TorcLogicControl::Passthrough:
         case TorcLogicControl::Toggle:
         case TorcLogicControl::Invert:
+        case TorcLogicControl::WindowAverage:
+        case TorcLogicControl::WindowMax:
+        case TorcLogicControl::WindowMin:
+        case TorcLogicControl::WindowDeviation:
+        case TorcLogicControl::RateOfChange:
+        case TorcLogicControl::ExponentialAverage:
+        case TorcLogicControl::Percentile:
             {
                 if (m_inputs.size() != 1)
                 {
@@ -362,30 +481,112 @@ bool TorcLogicControl::Validate(void)
     if (!Finish())
         return false;
 
+    m_referenceIndex = InputIndex(m_referenceDevice);
+    m_inputIndex     = InputIndex(m_inputDevice);
+    m_triggerIndex   = InputIndex(m_triggerDevice);
+
+    // windowed statistics are re-evaluated when the oldest sample expires
+    if (m_statistics && m_expiryHandle < 0)
+        m_expiryHandle = TorcTimerScheduler::gTimerScheduler->Register(this);
     return true;
 }
 
-void TorcLogicControl::CalculateOutput(void)
+/// Windowed statistics use TorcTimerScheduler.
+bool TorcLogicControl::RequiresMainThread(void) const
+{
+    return m_statistics != nullptr;
+}
+
+/*! \brief Re-evaluate a windowed operation when its oldest sample leaves the window.
+ *
+ * Without this, expired samples would only be discarded when the input next changes.
+*/
+void TorcLogicControl::TimerTimeout(void)
 {
     QMutexLocker locker(&lock);
+    m_expired = true;
+    CheckInputValues();
+    m_expired = false;
+}
 
+/*! \brief Add Value to the window (or discard expired samples) and schedule the next expiry.
+ *
+ * An input that is unchanged for the whole window is still current, so it is added again once every other
+ * sample has expired.
+*/
+void TorcLogicControl::UpdateWindow(qint64 Now, double Value)
+{
+    if (m_expired)
+    {
+        m_statistics->Expire(Now);
+        if (m_statistics->Count() < 1)
+            m_statistics->AddValue(Now, Value);
+    }
+    else
+    {
+        m_statistics->AddValue(Now, Value);
+    }
+
+    qint64 expiry = 0;
+    if (m_expiryHandle > -1 && m_statistics->NextExpiry(expiry))
+        TorcTimerScheduler::gTimerScheduler->Schedule(m_expiryHandle, static_cast<quint64>(qMax(expiry - Now, (qint64)0)));
+}
+
+/// \note Called with lock held from TorcControl::CheckInputValues
+void TorcLogicControl::CalculateOutput(void)
+{
     double newvalue = value; // no change by default
 
+    // all inputs are known and valid when we get here
+    const double *values = m_inputValues.constData();
+    const double *last   = m_lastInputValues.constData();
+    const int      count = m_inputValues.size();
+
     double referencevalue = 0.0;
     double inputvalue     = 0.0;
     double triggervalue   = 0.0;
 
-    if ((TorcLogicControl::RunningAverage == m_operation) && m_triggerDevice)
-        triggervalue = m_inputValues.value(m_triggerDevice);
+    if ((TorcLogicControl::RunningAverage == m_operation) && m_triggerIndex > -1)
+        triggervalue = values[m_triggerIndex];
 
-    if (IsComplexType(m_operation) && m_inputDevice && m_referenceDevice)
+    if (IsComplexType(m_operation) && m_inputIndex > -1 && m_referenceIndex > -1)
     {
-        inputvalue = m_inputValues.value(m_inputDevice);
-        referencevalue = m_inputValues.value(m_referenceDevice);
+        inputvalue = values[m_inputIndex];
+        referencevalue = values[m_referenceIndex];
     }
 
+    // windowed operations are timestamped with the (possibly virtual) monotonic clock
+    qint64 now = IsWindowType(m_operation) ? TorcClock::Elapsed() : 0;
+
     switch (m_operation)
     {
+        case TorcLogicControl::WindowAverage:
+            UpdateWindow(now, values[0]);
+            newvalue = m_statistics->Mean();
+            break;
+        case TorcLogicControl::WindowMax:
+            UpdateWindow(now, values[0]);
+            newvalue = m_statistics->Maximum();
+            break;
+        case TorcLogicControl::WindowMin:
+            UpdateWindow(now, values[0]);
+            newvalue = m_statistics->Minimum();
+            break;
+        case TorcLogicControl::WindowDeviation:
+            UpdateWindow(now, values[0]);
+            newvalue = m_statistics->Deviation();
+            break;
+        case TorcLogicControl::RateOfChange:
+            // change per second across the window
+            UpdateWindow(now, values[0]);
+            newvalue = m_statistics->RateOfChange();
+            break;
+        case TorcLogicControl::ExponentialAverage:
+            newvalue = m_exponentialAverage->AddValue(now, values[0]);
+            break;
+        case TorcLogicControl::Percentile:
+            newvalue = m_percentile->AddValue(now, values[0]);
+            break;
         case TorcLogicControl::RunningAverage:
             // We do not update for a change in value - only when triggered. Reference resets.
             // NB trigger and reset can both be high at the same time - which should probably be avoided
@@ -418,15 +619,15 @@ void TorcLogicControl::CalculateOutput(void)
             }
             break;
         case TorcLogicControl::Passthrough:
-            newvalue = m_inputValues.constBegin().value();
+            newvalue = values[0];
             break;
         case TorcLogicControl::Multiply:
             {
                 // must be multiple range/pwm values that are combined
                 // if binary inputs are used, this will equate to the opposite of Any.
                 double start = 1.0;
-                foreach(double next, m_inputValues)
-                    start *= next;
+                for (int i = 0; i < count; ++i)
+                    start *= values[i];
                 newvalue = start;
             }
             break;
@@ -455,8 +656,8 @@ void TorcLogicControl::CalculateOutput(void)
             {
                 // multiple binary (on/off) inputs that must all be 1/On/non-zero
                 bool on = true;
-                foreach (double next, m_inputValues)
-                    on &= !qFuzzyCompare(next + 1.0, 1.0);
+                for (int i = 0; i < count && on; ++i)
+                    on &= !qFuzzyCompare(values[i] + 1.0, 1.0);
                 newvalue = on ? 1 : 0;
             }
             break;
@@ -465,8 +666,8 @@ void TorcLogicControl::CalculateOutput(void)
             {
                 // multiple binary (on/off) inputs
                 bool on = false;
-                foreach (double next, m_inputValues)
-                    on |= !qFuzzyCompare(next + 1.0, 1.0);
+                for (int i = 0; i < count && !on; ++i)
+                    on |= !qFuzzyCompare(values[i] + 1.0, 1.0);
                 if (m_operation == TorcLogicControl::Any)
                     newvalue = on ? 1 : 0;
                 else
@@ -477,44 +678,44 @@ void TorcLogicControl::CalculateOutput(void)
             {
                 // does exactly what it says on the tin
                 double average = 0;
-                foreach (double next, m_inputValues)
-                    average += next;
-                newvalue = average / m_inputValues.size();
+                for (int i = 0; i < count; ++i)
+                    average += values[i];
+                newvalue = average / count;
             }
             break;
         case TorcLogicControl::Toggle:
             {
                 // the output is toggled for every 'rising' input (i.e. when the input changes from
                 // a value that is less than 1 to a value that is greater than or equal to 1
-                if (m_lastInputValues.constBegin().value() < 1.0 && m_inputValues.constBegin().value() >= 1.0)
+                if (last[0] < 1.0 && values[0] >= 1.0)
                     newvalue = value >= 1.0 ? 0.0 : 1.0;
             }
             break;
         case TorcLogicControl::Invert:
             {
-                newvalue = m_inputValues.constBegin().value() < 1.0 ? 1.0 : 0.0;
+                newvalue = values[0] < 1.0 ? 1.0 : 0.0;
             }
             break;
         case TorcLogicControl::Maximum:
             {
                 double max = 0;
-                foreach (double next, m_inputValues)
-                    if (next > max)
-                        max = next;
+                for (int i = 0; i < count; ++i)
+                    if (values[i] > max)
+                        max = values[i];
                 newvalue = max;
             }
             break;
         case TorcLogicControl::Minimum:
             {
                 double min = qInf();
-                foreach (double next, m_inputValues)
-                    if (next < min)
-                        min = next;
+                for (int i = 0; i < count; ++i)
+                    if (values[i] < min)
+                        min = values[i];
                 newvalue = min;
             }
             break;
         case TorcLogicControl::UnknownLogicType:
             break;
     }
-    SetValue(newvalue);
+    SetValuePriv(newvalue);
 }
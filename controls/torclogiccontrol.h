@@ -29,22 +29,32 @@ class TorcLogicControl : public TorcControl
         Multiply,
         RunningAverage,
         RunningMax,
-        RunningMin
+        RunningMin,
+        WindowAverage,
+        WindowMax,
+        WindowMin,
+        WindowDeviation,
+        RateOfChange,
+        ExponentialAverage,
+        Percentile
     };
 
     static TorcLogicControl::Operation StringToOperation (const QString &Operation);
 
   public:
     TorcLogicControl(const QString &Type, const QVariantMap &Details);
-   ~TorcLogicControl() = default;
+   ~TorcLogicControl();
 
     bool                        Validate         (void) override;
     TorcControl::Type           GetType          (void) const override;
     QStringList                 GetDescription   (void) override;
     bool                        IsPassthrough    (void) override;
+    bool                        RequiresMainThread (void) const override;
+    void                        TimerTimeout     (void) override;
 
   private:
     void                        CalculateOutput  (void) override;
+    void                        UpdateWindow     (qint64 Now, double Value);
 
   private:
     Q_DISABLE_COPY(TorcLogicControl)
@@ -57,10 +67,21 @@ class TorcLogicControl : public TorcControl
     // trigger device for updating running average. Reference device resets.
     QString                     m_triggerDeviceId;
     QObject                    *m_triggerDevice;
+    // dense input indices for the above, resolved once the control is finished
+    int                         m_referenceIndex;
+    int                         m_inputIndex;
+    int                         m_triggerIndex;
     // 'running' devices
     TorcAverage<double>         m_average;
     bool                        m_firstRunningValue;
     double                      m_runningValue;
+    // 'window' devices
+    TorcWindowStatistics       *m_statistics;
+    TorcEWMA                   *m_exponentialAverage;
+    TorcWindowPercentile       *m_percentile;
+    // re-evaluate 'window' devices as samples expire
+    int                         m_expiryHandle;
+    bool                        m_expired;
 };
 
 #endif // TORCLOGICCONTROL_H
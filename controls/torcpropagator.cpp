@@ -0,0 +1,192 @@
+/* Class TorcPropagator
+*
+* Copyright (C) Mark Kendall 2018
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+*/
+
+// Torc
+#include "torclogging.h"
+#include "torcpropagator.h"
+
+/*! \class TorcPropagator
+ *  \brief Schedules evaluation of a directed acyclic graph of nodes in topological order.
+ *
+ * Build is passed, for each node, the list of nodes it takes input from. Each node is assigned a level
+ * that is one greater than the highest level of its inputs (nodes with no inputs are level 0).
+ *
+ * Nodes whose inputs have changed are marked with Schedule and subsequently retrieved, lowest level first,
+ * with Next. A node is only returned once however many of its inputs changed and, as every input of a node
+ * has a lower level, it is only returned once all of its inputs have been evaluated. Nodes scheduled by the
+ * evaluation of another node are returned in the same pass. This removes both repeated evaluation of nodes
+ * that are reachable by more than one path (e.g. a diamond) and the transient 'glitch' values seen
+ * by downstream nodes when their inputs are updated one path at a time.
+ *
+ * If a node is scheduled for a level that has already been processed in the current pass (which is only possible
+ * if the graph contains a cycle), it is deferred until the next pass.
+ *
+ * \note TorcPropagator is not thread safe.
+*/
+TorcPropagator::TorcPropagator()
+  : m_levels(),
+    m_scheduled(),
+    m_dirty(),
+    m_current(),
+    m_level(-1),
+    m_position(0),
+    m_pending(0),
+    m_evaluations(0)
+{
+}
+
+/*! \brief Assign a level to each node using Kahn's algorithm.
+ *
+ * Returns false if the graph contains one or more cycles. Nodes within a cycle (and those downstream of them)
+ * are assigned to the highest level.
+*/
+bool TorcPropagator::Build(const QVector<QVector<int> > &Inputs)
+{
+    Reset();
+
+    int count = Inputs.size();
+    m_levels    = QVector<int>(count, 0);
+    m_scheduled = QVector<bool>(count, false);
+
+    QVector<int> remaining(count, 0);
+    QVector<QVector<int> > outputs(count);
+    for (int node = 0; node < count; ++node)
+    {
+        foreach (int input, Inputs[node])
+        {
+            if (input < 0 || input >= count)
+                continue;
+            outputs[input].append(node);
+            remaining[node]++;
+        }
+    }
+
+    QVector<int> ready;
+    ready.reserve(count);
+    for (int node = 0; node < count; ++node)
+        if (!remaining[node])
+            ready.append(node);
+
+    int maxlevel = 0;
+    for (int index = 0; index < ready.size(); ++index)
+    {
+        int node = ready[index];
+        maxlevel = qMax(maxlevel, m_levels[node]);
+        foreach (int output, outputs[node])
+        {
+            m_levels[output] = qMax(m_levels[output], m_levels[node] + 1);
+            if (--remaining[output] == 0)
+                ready.append(output);
+        }
+    }
+
+    bool result = ready.size() == count;
+    if (!result)
+    {
+        LOG(VB_GENERAL, LOG_ERR, QStringLiteral("Control graph contains %1 node(s) in or after a cycle").arg(count - ready.size()));
+        maxlevel++;
+        for (int node = 0; node < count; ++node)
+            if (remaining[node])
+                m_levels[node] = maxlevel;
+    }
+
+    m_dirty = QVector<QVector<int> >(count ? maxlevel + 1 : 0);
+    return result;
+}
+
+int TorcPropagator::GetLevel(int Node) const
+{
+    return m_levels.value(Node, -1);
+}
+
+int TorcPropagator::LevelCount(void) const
+{
+    return m_dirty.size();
+}
+
+/*! \brief Mark Node as requiring evaluation.
+ *
+ * Returns true if this is the first node to be scheduled since the last complete pass, in which
+ * case the caller should arrange for the pending nodes to be processed.
+*/
+bool TorcPropagator::Schedule(int Node)
+{
+    if (Node < 0 || Node >= m_levels.size() || m_scheduled[Node])
+        return false;
+
+    m_scheduled[Node] = true;
+    m_dirty[m_levels[Node]].append(Node);
+    return 0 == m_pending++;
+}
+
+/*! \brief Return the next node to evaluate or -1 if the current pass is complete.
+ *
+ * A node is no longer considered scheduled once it has been returned, so its evaluation
+ * may (in the case of a cycle) schedule it again for the next pass.
+*/
+int TorcPropagator::Next(void)
+{
+    forever
+    {
+        if (m_position < m_current.size())
+        {
+            int node = m_current[m_position++];
+            m_scheduled[node] = false;
+            m_pending--;
+            m_evaluations++;
+            return node;
+        }
+
+        m_current.clear();
+        m_position = 0;
+
+        if (++m_level >= m_dirty.size())
+        {
+            // end of pass
+            m_level = -1;
+            return -1;
+        }
+
+        m_current.swap(m_dirty[m_level]);
+    }
+}
+
+/// Return true if there are nodes waiting for the next pass.
+bool TorcPropagator::IsPending(void) const
+{
+    return m_pending > 0;
+}
+
+/// Return the total number of node evaluations.
+quint64 TorcPropagator::Evaluations(void) const
+{
+    return m_evaluations;
+}
+
+void TorcPropagator::Reset(void)
+{
+    for (int level = 0; level < m_dirty.size(); ++level)
+        m_dirty[level].clear();
+    m_scheduled.fill(false);
+    m_current.clear();
+    m_level       = -1;
+    m_position    = 0;
+    m_pending     = 0;
+    m_evaluations = 0;
+}
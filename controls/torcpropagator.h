@@ -0,0 +1,33 @@
+#ifndef TORCPROPAGATOR_H
+#define TORCPROPAGATOR_H
+
+// Qt
+#include <QVector>
+
+class TorcPropagator
+{
+  public:
+    TorcPropagator();
+   ~TorcPropagator() = default;
+
+    bool              Build        (const QVector<QVector<int> > &Inputs);
+    int               GetLevel     (int Node) const;
+    int               LevelCount   (void) const;
+    bool              Schedule     (int Node);
+    int               Next         (void);
+    bool              IsPending    (void) const;
+    quint64           Evaluations  (void) const;
+    void              Reset        (void);
+
+  private:
+    QVector<int>            m_levels;
+    QVector<bool>           m_scheduled;
+    QVector<QVector<int> >  m_dirty;
+    QVector<int>            m_current;
+    int                     m_level;
+    int                     m_position;
+    int                     m_pending;
+    quint64                 m_evaluations;
+};
+
+#endif // TORCPROPAGATOR_H
@@ -23,7 +23,9 @@
 
 // Torc
 #include "torclogging.h"
+#include "torcclock.h"
 #include "torclocalcontext.h"
+#include "torctimerscheduler.h"
 #include "torctimercontrol.h"
 
 static const quint64 kThou  = 1000;
@@ -74,7 +76,7 @@ TorcTimerControl::TorcTimerControl(const QString &Type, const QVariantMap &Detai
     m_durationDay(0),
     m_periodDay(0),
     m_periodTime(0),
-    m_timer(),
+    m_timerHandle(-1),
     m_firstTrigger(true),
     m_randomStart(false),
     m_randomDuration(false),
@@ -242,13 +244,11 @@ TorcTimerControl::TorcTimerControl(const QString &Type, const QVariantMap &Detai
 
     // everything appears to be valid at this stage
     m_parsed = true;
-
-    gLocalContext->AddObserver(this);
 }
 
 TorcTimerControl::~TorcTimerControl()
 {
-    gLocalContext->RemoveObserver(this);
+    TorcTimerScheduler::gTimerScheduler->Deregister(m_timerHandle);
 }
 
 TorcControl::Type TorcTimerControl::GetType(void) const
@@ -305,13 +305,8 @@ bool TorcTimerControl::Validate(void)
     // debug
     LOG(VB_GENERAL, LOG_DEBUG, QStringLiteral("Timer '%1': %2").arg(uniqueId, GetDescription().join(',')));
 
-    m_timer.setTimerType(Qt::PreciseTimer);
-
-    // connect the timer
-    connect(&m_timer, &QTimer::timeout, this, &TorcTimerControl::TimerTimeout);
-
-    // all QTimer's are single shot and reset at each trigger
-    m_timer.setSingleShot(true);
+    // all timers share a single scheduler
+    m_timerHandle = TorcTimerScheduler::gTimerScheduler->Register(this);
 
     return true;
 }
@@ -334,7 +329,7 @@ void TorcTimerControl::Start(void)
         TimerTimeout();
 
         // ensure state is communicated
-        SetValid(true);
+        SetValidPriv(true);
         emit ValueChanged(value);
     }
 }
@@ -345,29 +340,28 @@ bool TorcTimerControl::AllowInputs(void) const
     return TorcTimerControl::SingleShot == m_timerType;
 }
 
-bool TorcTimerControl::event(QEvent *Event)
+/*! \brief Restart the timer following a change to the system time.
+ *
+ * \note Called by TorcTimerScheduler, which restarts all timers together.
+*/
+void TorcTimerControl::SystemTimeChanged(void)
 {
-    if (Event && Event->type() == TorcEvent::TorcEventType)
+    QMutexLocker locker(&lock);
+
+    if (!m_parsed || !m_validated)
+        return;
+
+    if (TorcTimerControl::SingleShot == m_timerType)
     {
-        TorcEvent *event = static_cast<TorcEvent*>(Event);
-        if (event && (event->GetEvent() == Torc::SystemTimeChanged))
-        {
-            if (TorcTimerControl::SingleShot == m_timerType)
-            {
-                LOG(VB_GENERAL, LOG_INFO, QStringLiteral("Not restarting single shot timer %1").arg(uniqueId));
-            }
-            else
-            {
-                LOG(VB_GENERAL, LOG_INFO, QStringLiteral("Timer %1 restarting").arg(uniqueId));
-                m_timer.stop();
-                m_firstTrigger = true;
-                TimerTimeout();
-            }
-            return true;
-        }
+        LOG(VB_GENERAL, LOG_INFO, QStringLiteral("Not restarting single shot timer %1").arg(uniqueId));
+    }
+    else
+    {
+        LOG(VB_GENERAL, LOG_INFO, QStringLiteral("Timer %1 restarting").arg(uniqueId));
+        TorcTimerScheduler::gTimerScheduler->Cancel(m_timerHandle);
+        m_firstTrigger = true;
+        TimerTimeout();
     }
-
-    return TorcControl::event(Event);
 }
 
 void TorcTimerControl::TimerTimeout(void)
@@ -497,7 +491,7 @@ void TorcTimerControl::TimerTimeout(void)
         if (first && newvalue)
         {
             LOG(VB_GENERAL, LOG_INFO, QStringLiteral("Triggering timer '%1' late - will run for %2seconds instead of %3 %4")
-                .arg(uniqueId).arg(nexttimer/1000.0).arg(m_duration/1000).arg(QDateTime::currentDateTime().toString(QStringLiteral("HH:mm:ss.zzz"))));
+                .arg(uniqueId).arg(nexttimer/1000.0).arg(m_duration/1000).arg(TorcClock::CurrentDateTime().toString(QStringLiteral("HH:mm:ss.zzz"))));
         }
 
         m_lastElapsed = msecsinceperiodstart;
@@ -517,20 +511,10 @@ void TorcTimerControl::TimerTimeout(void)
         m_newRandom = false;
     }
 
+    // the scheduler wakes on (or just after) the wall clock time of the next transition
     if (m_active)
-    {
-        // trigger timer a little early to hone in and give sub-second accuracy
-        quint64 adjust = nexttimer / 10;
-        if (nexttimer > 100)
-            nexttimer -= adjust;
-
-        // avoid lengthy timers - max 1 hour
-        if (nexttimer > kMSecsInHour)
-            nexttimer = kMSecsInHour;
-
-        m_timer.start(nexttimer);
-    }
-    SetValue(newvalue);
+        TorcTimerScheduler::gTimerScheduler->Schedule(m_timerHandle, nexttimer);
+    SetValuePriv(newvalue);
 }
 
 TorcTimerControl::TimerType TorcTimerControl::GetTimerType(void) const
@@ -610,8 +594,9 @@ quint64 TorcTimerControl::MsecsSincePeriodStart(void)
     if (!m_active)
         return 0;
 
-    QTime timenow = QTime::currentTime();
-    int       day = QDate::currentDate().dayOfWeek() - 1;
+    QDateTime now = TorcClock::CurrentDateTime();
+    QTime timenow = now.time();
+    int       day = now.date().dayOfWeek() - 1;
 
     if (TorcTimerControl::Custom == m_timerType)
     {
@@ -619,12 +604,12 @@ quint64 TorcTimerControl::MsecsSincePeriodStart(void)
         // and to prevent drift
         static const QDateTime reference = QDateTime::fromString(QStringLiteral("2000-01-01T00:00:00"), Qt::ISODate);
         if (m_periodTime > 0)
-            return (QDateTime::currentMSecsSinceEpoch() - reference.toMSecsSinceEpoch()) % m_periodTime;
+            return (TorcClock::CurrentMSecsSinceEpoch() - reference.toMSecsSinceEpoch()) % m_periodTime;
         return 0;
     }
     else if (TorcTimerControl::SingleShot == m_timerType)
     {
-        return QDateTime::currentMSecsSinceEpoch() - m_singleShotStartTime;
+        return TorcClock::CurrentMSecsSinceEpoch() - m_singleShotStartTime;
     }
 
     // clip hours for Hourly
@@ -695,13 +680,13 @@ void TorcTimerControl::CalculateOutput(void)
     {
         QMutexLocker locker(&lock);
         // always start/restart when the input transitions low to high
-        if (m_lastInputValues.constBegin().value() < 1.0 && m_inputValues.constBegin().value() >= 1.0)
+        if (m_lastInputValues.at(0) < 1.0 && m_inputValues.at(0) >= 1.0)
         {
             if (m_active)
                 LOG(VB_GENERAL, LOG_INFO, QStringLiteral("Single shot timer %1 restarting").arg(uniqueId));
             m_active = true;
             GenerateTimings();
-            m_singleShotStartTime = QDateTime::currentMSecsSinceEpoch();
+            m_singleShotStartTime = TorcClock::CurrentMSecsSinceEpoch();
             TimerTimeout();
         }
     }
@@ -3,7 +3,6 @@
 
 // Qt
 #include <QTime>
-#include <QTimer>
 
 // Torc
 #include "torccontrol.h"
@@ -38,10 +37,10 @@ class TorcTimerControl : public TorcControl
     bool              AllowInputs     (void) const override;
     quint64           TimeSinceLastTransition (void);
     TorcTimerControl::TimerType GetTimerType  (void) const;
+    void              SystemTimeChanged (void) override;
 
   public slots:
-    void              TimerTimeout    (void);
-    bool              event           (QEvent *Event) override;
+    void              TimerTimeout    (void) override;
 
   private:
     void              GenerateTimings (void);
@@ -57,7 +56,7 @@ class TorcTimerControl : public TorcControl
     int               m_durationDay;
     int               m_periodDay;
     quint64           m_periodTime;
-    QTimer            m_timer;
+    int               m_timerHandle;
     bool              m_firstTrigger;
     bool              m_randomStart;
     bool              m_randomDuration;
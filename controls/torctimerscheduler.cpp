@@ -0,0 +1,183 @@
+/* Class TorcTimerScheduler
+*
+* Copyright (C) Mark Kendall 2018
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+*/
+
+// Torc
+#include "torclogging.h"
+#include "torcclock.h"
+#include "torclocalcontext.h"
+#include "torccontrol.h"
+#include "torctimerscheduler.h"
+
+// the longest single wait - limits the impact of any drift between the wall clock and the timer
+#define MAX_WAIT (60 * 60 * 1000)
+
+TorcTimerScheduler* TorcTimerScheduler::gTimerScheduler = new TorcTimerScheduler();
+
+/*! \class TorcTimerScheduler
+ *  \brief Drives every TorcTimerControl (and any other control that needs a timeout) from a single QTimer.
+ *
+ * Controls register once and then schedule their next timeout relative to the current wall clock time.
+ * The scheduler keeps the transitions in a TorcTimerWheel and arms one QTimer for the earliest. All transitions that
+ * are due are delivered in the same wake up, so controls that change state together are also propagated together.
+ *
+ * When the system time changes, the wheel is rebased and every periodic timer is restarted in one pass.
+ *
+ * When TorcClock is virtual, the QTimer is not used and the owner of the clock calls NextDue and Service directly.
+ *
+ * \note The scheduler lives in the main thread and controls that use it are evaluated in the main thread
+ *       (see TorcControl::RequiresMainThread).
+*/
+TorcTimerScheduler::TorcTimerScheduler()
+  : QObject(),
+    m_wheel(),
+    m_controls(),
+    m_expired(),
+    m_timer(),
+    m_registered(0),
+    m_dispatching(false),
+    m_wakeUps(0)
+{
+    m_timer.setTimerType(Qt::PreciseTimer);
+    m_timer.setSingleShot(true);
+    connect(&m_timer, &QTimer::timeout, this, &TorcTimerScheduler::Timeout);
+}
+
+int TorcTimerScheduler::Register(TorcControl *Control)
+{
+    if (!Control)
+        return -1;
+
+    if (m_registered++ == 0 && gLocalContext)
+        gLocalContext->AddObserver(this);
+
+    int handle = m_wheel.Add();
+    if (handle >= m_controls.size())
+        m_controls.resize(handle + 1);
+    m_controls[handle] = Control;
+    return handle;
+}
+
+void TorcTimerScheduler::Deregister(int Handle)
+{
+    if (Handle < 0 || Handle >= m_controls.size() || !m_controls.at(Handle))
+        return;
+
+    m_wheel.Remove(Handle);
+    m_controls[Handle] = nullptr;
+    if (--m_registered == 0 && gLocalContext)
+        gLocalContext->RemoveObserver(this);
+    Rearm();
+}
+
+/// Schedule a timeout for Handle in Msecs milliseconds, replacing any existing timeout.
+void TorcTimerScheduler::Schedule(int Handle, quint64 Msecs)
+{
+    quint64 now = TorcClock::CurrentMSecsSinceEpoch();
+    if (now < m_wheel.GetCurrent())
+        m_wheel.Rebase(now);
+    m_wheel.Schedule(Handle, now + Msecs);
+    Rearm();
+}
+
+void TorcTimerScheduler::Cancel(int Handle)
+{
+    m_wheel.Cancel(Handle);
+    Rearm();
+}
+
+/// The number of times the scheduler has woken up.
+quint64 TorcTimerScheduler::WakeUps(void) const
+{
+    return m_wakeUps;
+}
+
+bool TorcTimerScheduler::event(QEvent *Event)
+{
+    if (Event && Event->type() == TorcEvent::TorcEventType)
+    {
+        TorcEvent *event = static_cast<TorcEvent*>(Event);
+        if (event && (event->GetEvent() == Torc::SystemTimeChanged))
+        {
+            LOG(VB_GENERAL, LOG_INFO, QStringLiteral("System time changed - restarting %1 timers").arg(m_registered));
+
+            // preserve relative timeouts (i.e. single shot timers) and then restart everything else
+            m_dispatching = true;
+            m_wheel.Rebase(TorcClock::CurrentMSecsSinceEpoch());
+            for (int handle = 0; handle < m_controls.size(); ++handle)
+                if (m_controls.at(handle))
+                    m_controls.at(handle)->SystemTimeChanged();
+            m_dispatching = false;
+            Rearm();
+            return true;
+        }
+    }
+
+    return QObject::event(Event);
+}
+
+/// Return the time (in milliseconds since the epoch) of the next timeout. Returns false if no timers are scheduled.
+bool TorcTimerScheduler::NextDue(quint64 &Next) const
+{
+    return m_wheel.NextExpiry(Next);
+}
+
+/// Deliver every timeout that is due.
+void TorcTimerScheduler::Service(void)
+{
+    m_wakeUps++;
+    m_dispatching = true;
+
+    m_expired.clear();
+    m_wheel.Advance(TorcClock::CurrentMSecsSinceEpoch(), m_expired);
+    // NB controls will generally reschedule themselves
+    foreach (int handle, m_expired)
+        if (handle < m_controls.size() && m_controls.at(handle))
+            m_controls.at(handle)->TimerTimeout();
+
+    m_dispatching = false;
+    Rearm();
+}
+
+void TorcTimerScheduler::Timeout(void)
+{
+    Service();
+}
+
+void TorcTimerScheduler::Rearm(void)
+{
+    if (m_dispatching)
+        return;
+
+    if (TorcClock::IsVirtual())
+    {
+        m_timer.stop();
+        return;
+    }
+
+    quint64 next = 0;
+    if (!m_wheel.NextExpiry(next))
+    {
+        m_timer.stop();
+        return;
+    }
+
+    quint64 now  = TorcClock::CurrentMSecsSinceEpoch();
+    quint64 wait = next > now ? next - now : 0;
+    m_timer.start(wait > MAX_WAIT ? MAX_WAIT : (int)wait);
+}
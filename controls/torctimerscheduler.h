@@ -0,0 +1,49 @@
+#ifndef TORCTIMERSCHEDULER_H
+#define TORCTIMERSCHEDULER_H
+
+// Qt
+#include <QTimer>
+#include <QObject>
+
+// Torc
+#include "torctimerwheel.h"
+
+class TorcControl;
+
+class TorcTimerScheduler final : public QObject
+{
+    Q_OBJECT
+
+  public:
+    TorcTimerScheduler();
+   ~TorcTimerScheduler() = default;
+
+    static TorcTimerScheduler* gTimerScheduler;
+
+    int                 Register         (TorcControl *Control);
+    void                Deregister       (int Handle);
+    void                Schedule         (int Handle, quint64 Msecs);
+    void                Cancel           (int Handle);
+    quint64             WakeUps          (void) const;
+    bool                NextDue          (quint64 &Next) const;
+    void                Service          (void);
+    bool                event            (QEvent *Event) override;
+
+  private slots:
+    void                Timeout          (void);
+
+  private:
+    void                Rearm            (void);
+
+  private:
+    Q_DISABLE_COPY(TorcTimerScheduler)
+    TorcTimerWheel            m_wheel;
+    QVector<TorcControl*>     m_controls;
+    QVector<int>              m_expired;
+    QTimer                    m_timer;
+    int                       m_registered;
+    bool                      m_dispatching;
+    quint64                   m_wakeUps;
+};
+
+#endif // TORCTIMERSCHEDULER_H
@@ -0,0 +1,274 @@
+/* Class TorcTimerWheel
+*
+* Copyright (C) Mark Kendall 2018
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+*/
+
+// Torc
+#include "torctimerwheel.h"
+
+/*! \class TorcTimerWheel
+ *  \brief A hierarchical timer wheel with millisecond resolution.
+ *
+ * Timers are identified by a handle (from Add) and scheduled for an absolute time (usually milliseconds since the epoch).
+ * Level 0 has one slot per millisecond and each higher level has slots TIMERWHEEL_SLOTS times longer than the
+ * level below. A timer is placed in the lowest level that can represent its due time and is moved (cascaded) to
+ * lower levels as the start of its slot is reached. Six levels of 64 slots cover roughly two years - later timers
+ * are parked in the last slot of the top level and re-examined when it is reached.
+ *
+ * Each level keeps a bitmask of occupied slots so NextExpiry and Advance jump directly to the next slot that needs
+ * attention - the cost of an idle wheel is independent of both the number of timers and the time elapsed.
+ * All timers that are due are returned together by Advance.
+ *
+ * \note TorcTimerWheel is not thread safe.
+ * \sa TorcTimerScheduler
+*/
+TorcTimerWheel::TorcTimerWheel()
+  : m_entries(),
+    m_free(),
+    m_heads(TIMERWHEEL_LEVELS * TIMERWHEEL_SLOTS, -1),
+    m_occupied(),
+    m_current(0),
+    m_count(0)
+{
+}
+
+/// Allocate a new (unscheduled) timer and return its handle.
+int TorcTimerWheel::Add(void)
+{
+    int handle = -1;
+    if (m_free.isEmpty())
+    {
+        handle = m_entries.size();
+        m_entries.append({ 0, -1, -1, -1, -1, true });
+    }
+    else
+    {
+        handle = m_free.takeLast();
+        m_entries[handle] = { 0, -1, -1, -1, -1, true };
+    }
+    return handle;
+}
+
+/// Cancel and release Handle. The handle may subsequently be re-used.
+void TorcTimerWheel::Remove(int Handle)
+{
+    if (Handle < 0 || Handle >= m_entries.size() || !m_entries.at(Handle).inUse)
+        return;
+
+    Cancel(Handle);
+    m_entries[Handle].inUse = false;
+    m_free.append(Handle);
+}
+
+/*! \brief Schedule Handle to expire at Due.
+ *
+ * Any existing schedule is replaced. A time that has already passed will expire on the next call to Advance.
+*/
+void TorcTimerWheel::Schedule(int Handle, quint64 Due)
+{
+    if (Handle < 0 || Handle >= m_entries.size() || !m_entries.at(Handle).inUse)
+        return;
+
+    Cancel(Handle);
+    m_entries[Handle].due = qMax(Due, m_current + 1);
+    Insert(Handle, nullptr);
+}
+
+void TorcTimerWheel::Cancel(int Handle)
+{
+    if (IsScheduled(Handle))
+        Unlink(Handle);
+}
+
+bool TorcTimerWheel::IsScheduled(int Handle) const
+{
+    return Handle > -1 && Handle < m_entries.size() && m_entries.at(Handle).level > -1;
+}
+
+quint64 TorcTimerWheel::GetDue(int Handle) const
+{
+    return IsScheduled(Handle) ? m_entries.at(Handle).due : 0;
+}
+
+/*! \brief Return the time at which Advance next needs to be called.
+ *
+ * This is the due time of the next level 0 timer or the start of the next higher level slot that needs to be cascaded,
+ * whichever is earlier. Returns false if no timers are scheduled.
+*/
+bool TorcTimerWheel::NextExpiry(quint64 &Next) const
+{
+    bool found = false;
+    for (int level = 0; level < TIMERWHEEL_LEVELS; ++level)
+    {
+        quint64 occupied = m_occupied[level];
+        if (!occupied)
+            continue;
+
+        // find the first occupied slot after the current slot
+        int     shift   = level * TIMERWHEEL_BITS;
+        quint64 window  = m_current >> shift;
+        int     start   = (window + 1) & (TIMERWHEEL_SLOTS - 1);
+        quint64 rotated = start ? ((occupied >> start) | (occupied << (TIMERWHEEL_SLOTS - start))) : occupied;
+        quint64 expiry  = (window + 1 + __builtin_ctzll(rotated)) << shift;
+
+        if (!found || expiry < Next)
+            Next = expiry;
+        found = true;
+    }
+    return found;
+}
+
+/*! \brief Advance the wheel to Now, appending every timer that has expired to Expired.
+ *
+ * Expired timers are no longer scheduled. They are returned in order of due time (timers with the same due time
+ * are returned in no particular order).
+*/
+void TorcTimerWheel::Advance(quint64 Now, QVector<int> &Expired)
+{
+    quint64 next = 0;
+    while (NextExpiry(next) && next <= Now)
+    {
+        m_current = next;
+        // highest level first, so cascaded timers that are due now expire in this pass
+        for (int level = TIMERWHEEL_LEVELS - 1; level >= 0; --level)
+        {
+            int shift = level * TIMERWHEEL_BITS;
+            if (m_current & ((Q_UINT64_C(1) << shift) - 1))
+                continue;
+            int slot = (m_current >> shift) & (TIMERWHEEL_SLOTS - 1);
+            if (m_occupied[level] & (Q_UINT64_C(1) << slot))
+                Drain(level, slot, Expired);
+        }
+    }
+
+    if (Now > m_current)
+        m_current = Now;
+}
+
+/*! \brief Move the wheel to Now, preserving the time remaining for each scheduled timer.
+ *
+ * Used when the wall clock is changed. Timers that depend on the wall clock should be rescheduled by their owners.
+*/
+void TorcTimerWheel::Rebase(quint64 Now)
+{
+    QVector<int> scheduled;
+    for (int handle = 0; handle < m_entries.size(); ++handle)
+    {
+        if (IsScheduled(handle))
+        {
+            m_entries[handle].due = Now + (m_entries.at(handle).due - m_current);
+            Unlink(handle);
+            scheduled.append(handle);
+        }
+    }
+
+    m_current = Now;
+    foreach (int handle, scheduled)
+        Insert(handle, nullptr);
+}
+
+quint64 TorcTimerWheel::GetCurrent(void) const
+{
+    return m_current;
+}
+
+/// The number of scheduled timers.
+int TorcTimerWheel::Count(void) const
+{
+    return m_count;
+}
+
+/*! \brief Insert Handle into the lowest level that can represent its due time.
+ *
+ * If the timer is already due, it is appended to Expired (if available).
+*/
+void TorcTimerWheel::Insert(int Handle, QVector<int> *Expired)
+{
+    Entry &entry = m_entries[Handle];
+    if (Expired && entry.due <= m_current)
+    {
+        Expired->append(Handle);
+        return;
+    }
+
+    int level = 0;
+    quint64 window = 0;
+    for ( ; level < TIMERWHEEL_LEVELS; ++level)
+    {
+        int shift = level * TIMERWHEEL_BITS;
+        window = entry.due >> shift;
+        if (window - (m_current >> shift) < TIMERWHEEL_SLOTS)
+            break;
+    }
+
+    // beyond the range of the wheel - park in the furthest slot
+    if (level == TIMERWHEEL_LEVELS)
+    {
+        level  = TIMERWHEEL_LEVELS - 1;
+        window = (m_current >> (level * TIMERWHEEL_BITS)) + TIMERWHEEL_SLOTS - 1;
+    }
+
+    int slot   = window & (TIMERWHEEL_SLOTS - 1);
+    int index  = (level * TIMERWHEEL_SLOTS) + slot;
+    int head   = m_heads.at(index);
+    entry.level    = level;
+    entry.slot     = slot;
+    entry.previous = -1;
+    entry.next     = head;
+    if (head > -1)
+        m_entries[head].previous = Handle;
+    m_heads[index] = Handle;
+    m_occupied[level] |= Q_UINT64_C(1) << slot;
+    m_count++;
+}
+
+void TorcTimerWheel::Unlink(int Handle)
+{
+    Entry &entry = m_entries[Handle];
+    int index = (entry.level * TIMERWHEEL_SLOTS) + entry.slot;
+
+    if (entry.previous > -1)
+        m_entries[entry.previous].next = entry.next;
+    else
+        m_heads[index] = entry.next;
+    if (entry.next > -1)
+        m_entries[entry.next].previous = entry.previous;
+
+    if (m_heads.at(index) < 0)
+        m_occupied[entry.level] &= ~(Q_UINT64_C(1) << entry.slot);
+
+    entry.level    = -1;
+    entry.slot     = -1;
+    entry.previous = -1;
+    entry.next     = -1;
+    m_count--;
+}
+
+/*! \brief Remove every timer from Slot, expiring those that are due and cascading the remainder to lower levels.
+ *
+ * Drain is only called at the start of the slot, so cascaded timers that expire are due now.
+*/
+void TorcTimerWheel::Drain(int Level, int Slot, QVector<int> &Expired)
+{
+    int index = (Level * TIMERWHEEL_SLOTS) + Slot;
+    while (m_heads.at(index) > -1)
+    {
+        int handle = m_heads.at(index);
+        Unlink(handle);
+        Insert(handle, &Expired);
+    }
+}
@@ -0,0 +1,54 @@
+#ifndef TORCTIMERWHEEL_H
+#define TORCTIMERWHEEL_H
+
+// Qt
+#include <QVector>
+
+#define TIMERWHEEL_LEVELS 6
+#define TIMERWHEEL_BITS   6
+#define TIMERWHEEL_SLOTS  (1 << TIMERWHEEL_BITS)
+
+class TorcTimerWheel
+{
+  public:
+    TorcTimerWheel();
+   ~TorcTimerWheel() = default;
+
+    int               Add          (void);
+    void              Remove       (int Handle);
+    void              Schedule     (int Handle, quint64 Due);
+    void              Cancel       (int Handle);
+    bool              IsScheduled  (int Handle) const;
+    quint64           GetDue       (int Handle) const;
+    bool              NextExpiry   (quint64 &Next) const;
+    void              Advance      (quint64 Now, QVector<int> &Expired);
+    void              Rebase       (quint64 Now);
+    quint64           GetCurrent   (void) const;
+    int               Count        (void) const;
+
+  private:
+    class Entry
+    {
+      public:
+        quint64 due;
+        int     level;
+        int     slot;
+        int     previous;
+        int     next;
+        bool    inUse;
+    };
+
+    void              Insert       (int Handle, QVector<int> *Expired);
+    void              Unlink       (int Handle);
+    void              Drain        (int Level, int Slot, QVector<int> &Expired);
+
+  private:
+    QVector<Entry>    m_entries;
+    QVector<int>      m_free;
+    QVector<int>      m_heads;
+    quint64           m_occupied[TIMERWHEEL_LEVELS];
+    quint64           m_current;
+    int               m_count;
+};
+
+#endif // TORCTIMERWHEEL_H
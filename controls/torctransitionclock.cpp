@@ -0,0 +1,263 @@
+/* Class TorcTransitionClock
+*
+* Copyright (C) Mark Kendall 2018
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+*/
+
+// Torc
+#include "torclogging.h"
+#include "torcclock.h"
+#include "torcoutput.h"
+#include "torctransitioncontrol.h"
+#include "torctransitionclock.h"
+
+// std
+#include <limits>
+
+TorcTransitionClock* TorcTransitionClock::gTransitionClock = new TorcTransitionClock();
+
+/*! \class TorcTransitionClock
+ *  \brief Animates every TorcTransitionControl from a single clock.
+ *
+ * Each transition registers its easing curve, duration, update interval and output quantum (the smallest change
+ * that its outputs can represent). The clock runs only while transitions are active, at the shortest interval
+ * required, and evaluates every transition that is due in one pass.
+ *
+ * Updates that do not change the quantised value are suppressed (the final value of a transition is always delivered)
+ * and the changes from each pass are delivered inside a TorcOutput batch, so output drivers can write them together.
+ *
+ * As for QPropertyAnimation, a transition that is started in the opposite direction while it is still active reverses
+ * from its current position.
+ *
+ * Time is taken from TorcClock::Elapsed. When TorcClock is virtual, the owner of the clock calls NextDue and Service directly.
+ *
+ * \note The clock and all transition controls live in the main thread.
+*/
+TorcTransitionClock::TorcTransitionClock()
+  : QObject(),
+    m_transitions(),
+    m_free(),
+    m_timer(),
+    m_active(0),
+    m_updates(0),
+    m_suppressed(0)
+{
+    m_timer.setTimerType(Qt::PreciseTimer);
+    connect(&m_timer, &QTimer::timeout, this, &TorcTransitionClock::Tick);
+}
+
+/*! \brief Register a transition.
+ *
+ * \param Duration The duration of the transition in milliseconds.
+ * \param Interval The interval between updates in milliseconds.
+ * \param Quantum  Changes smaller than Quantum are not delivered. Zero to deliver every change.
+*/
+int TorcTransitionClock::Register(TorcTransitionControl *Control, const QEasingCurve &Curve, quint64 Duration, int Interval, double Quantum)
+{
+    if (!Control || Duration < 1 || Interval < 1)
+        return -1;
+
+    Transition transition { Control, Curve, (qint64)Duration, Interval, Quantum, false, true, 0, 0, 0, 0 };
+    if (m_free.isEmpty())
+    {
+        m_transitions.append(transition);
+        return m_transitions.size() - 1;
+    }
+
+    int handle = m_free.takeLast();
+    m_transitions[handle] = transition;
+    return handle;
+}
+
+void TorcTransitionClock::Deregister(int Handle)
+{
+    if (Handle < 0 || Handle >= m_transitions.size() || !m_transitions.at(Handle).control)
+        return;
+
+    Transition &transition = m_transitions[Handle];
+    if (transition.active)
+        m_active--;
+    transition.active  = false;
+    transition.control = nullptr;
+    m_free.append(Handle);
+    Rearm();
+}
+
+/*! \brief Start the transition in the given direction.
+ *
+ * A stopped transition starts from the beginning (Forward) or end and its initial value is delivered immediately.
+ * An active transition continues from its current position.
+*/
+void TorcTransitionClock::Start(int Handle, bool Forward)
+{
+    if (Handle < 0 || Handle >= m_transitions.size() || !m_transitions.at(Handle).control)
+        return;
+
+    qint64 now = TorcClock::Elapsed();
+    Transition &transition = m_transitions[Handle];
+    if (transition.active)
+    {
+        transition.position = PositionAt(transition, now);
+        transition.anchor   = now;
+        transition.forward  = Forward;
+        return;
+    }
+
+    transition.active        = true;
+    transition.forward       = Forward;
+    transition.position      = Forward ? 0 : transition.duration;
+    transition.anchor        = now;
+    transition.nextDue       = now + transition.interval;
+    transition.lastQuantised = std::numeric_limits<qint64>::min();
+    m_active++;
+
+    TorcOutput::BeginBatch();
+    (void)Evaluate(transition, now);
+    TorcOutput::EndBatch();
+    Rearm();
+}
+
+/// Move the transition to Position (in milliseconds from the start) and deliver the value immediately.
+void TorcTransitionClock::Seek(int Handle, quint64 Position)
+{
+    if (Handle < 0 || Handle >= m_transitions.size() || !m_transitions.at(Handle).control)
+        return;
+
+    qint64 now = TorcClock::Elapsed();
+    Transition &transition = m_transitions[Handle];
+    transition.position      = qBound((qint64)0, (qint64)Position, transition.duration);
+    transition.anchor        = now;
+    transition.nextDue       = now + transition.interval;
+    transition.lastQuantised = std::numeric_limits<qint64>::min();
+    if (!transition.active)
+    {
+        transition.active = true;
+        m_active++;
+    }
+
+    TorcOutput::BeginBatch();
+    (void)Evaluate(transition, now);
+    TorcOutput::EndBatch();
+    Rearm();
+}
+
+bool TorcTransitionClock::IsActive(int Handle) const
+{
+    return Handle > -1 && Handle < m_transitions.size() && m_transitions.at(Handle).active;
+}
+
+/// The number of values delivered to transition controls.
+quint64 TorcTransitionClock::Updates(void) const
+{
+    return m_updates;
+}
+
+/// The number of updates suppressed because the quantised value did not change.
+quint64 TorcTransitionClock::Suppressed(void) const
+{
+    return m_suppressed;
+}
+
+/// Return the time (see TorcClock::Elapsed) at which Service next needs to be called. Returns false if nothing is active.
+bool TorcTransitionClock::NextDue(qint64 &Next) const
+{
+    bool found = false;
+    foreach (const Transition &transition, m_transitions)
+    {
+        if (transition.active && (!found || transition.nextDue < Next))
+        {
+            Next  = transition.nextDue;
+            found = true;
+        }
+    }
+    return found;
+}
+
+void TorcTransitionClock::Tick(void)
+{
+    Service();
+}
+
+/// Evaluate every active transition that is due.
+void TorcTransitionClock::Service(void)
+{
+    qint64 now = TorcClock::Elapsed();
+
+    TorcOutput::BeginBatch();
+    for (int i = 0; i < m_transitions.size(); ++i)
+    {
+        Transition &transition = m_transitions[i];
+        if (!transition.active || now < transition.nextDue)
+            continue;
+        transition.nextDue = now + transition.interval;
+        (void)Evaluate(transition, now);
+    }
+    TorcOutput::EndBatch();
+
+    Rearm();
+}
+
+qint64 TorcTransitionClock::PositionAt(const Transition &Item, qint64 Now) const
+{
+    qint64 elapsed = Now - Item.anchor;
+    return qBound((qint64)0, Item.forward ? Item.position + elapsed : Item.position - elapsed, Item.duration);
+}
+
+/// Deliver the current value of Item, unless suppressed. Returns false once the transition is complete.
+bool TorcTransitionClock::Evaluate(Transition &Item, qint64 Now)
+{
+    qint64 position = PositionAt(Item, Now);
+    bool   finished = Item.forward ? position >= Item.duration : position <= 0;
+    double value    = Item.curve.valueForProgress((double)position / (double)Item.duration);
+
+    if (finished)
+    {
+        Item.active = false;
+        m_active--;
+    }
+
+    if (Item.quantum > 0.0)
+    {
+        qint64 quantised = qRound64(value / Item.quantum);
+        if (!finished && quantised == Item.lastQuantised)
+        {
+            m_suppressed++;
+            return true;
+        }
+        Item.lastQuantised = quantised;
+    }
+
+    m_updates++;
+    Item.control->SetTransitionValue(value);
+    return !finished;
+}
+
+void TorcTransitionClock::Rearm(void)
+{
+    if (m_active < 1 || TorcClock::IsVirtual())
+    {
+        m_timer.stop();
+        return;
+    }
+
+    int interval = std::numeric_limits<int>::max();
+    foreach (const Transition &transition, m_transitions)
+        if (transition.active && transition.interval < interval)
+            interval = transition.interval;
+
+    if (!m_timer.isActive() || m_timer.interval() != interval)
+        m_timer.start(interval);
+}
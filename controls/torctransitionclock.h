@@ -0,0 +1,67 @@
+#ifndef TORCTRANSITIONCLOCK_H
+#define TORCTRANSITIONCLOCK_H
+
+// Qt
+#include <QTimer>
+#include <QObject>
+#include <QVector>
+#include <QEasingCurve>
+
+class TorcTransitionControl;
+
+class TorcTransitionClock final : public QObject
+{
+    Q_OBJECT
+
+  public:
+    TorcTransitionClock();
+   ~TorcTransitionClock() = default;
+
+    static TorcTransitionClock* gTransitionClock;
+
+    int                 Register         (TorcTransitionControl *Control, const QEasingCurve &Curve,
+                                          quint64 Duration, int Interval, double Quantum);
+    void                Deregister       (int Handle);
+    void                Start            (int Handle, bool Forward);
+    void                Seek             (int Handle, quint64 Position);
+    bool                IsActive         (int Handle) const;
+    quint64             Updates          (void) const;
+    quint64             Suppressed       (void) const;
+    bool                NextDue          (qint64 &Next) const;
+    void                Service          (void);
+
+  private slots:
+    void                Tick             (void);
+
+  private:
+    class Transition
+    {
+      public:
+        TorcTransitionControl *control;
+        QEasingCurve curve;
+        qint64       duration;
+        int          interval;
+        double       quantum;
+        bool         active;
+        bool         forward;
+        qint64       position;
+        qint64       anchor;
+        qint64       nextDue;
+        qint64       lastQuantised;
+    };
+
+    qint64              PositionAt       (const Transition &Item, qint64 Now) const;
+    bool                Evaluate         (Transition &Item, qint64 Now);
+    void                Rearm            (void);
+
+  private:
+    Q_DISABLE_COPY(TorcTransitionClock)
+    QVector<Transition> m_transitions;
+    QVector<int>        m_free;
+    QTimer              m_timer;
+    int                 m_active;
+    quint64             m_updates;
+    quint64             m_suppressed;
+};
+
+#endif // TORCTRANSITIONCLOCK_H
@@ -23,9 +23,18 @@
 // Torc
 #include "torclogging.h"
 #include "torclocalcontext.h"
+#include "torcpwmoutput.h"
 #include "torctimercontrol.h"
+#include "torctransitionclock.h"
 #include "torctransitioncontrol.h"
 
+// default update rates (Hz) by output type. PWM outputs (e.g. dimmers) need smooth updates, anything
+// with a threshold (switches) or a slow response (temperature etc) does not. Other controls get a compromise.
+#define PWM_RATE     50
+#define SWITCH_RATE  10
+#define OTHER_RATE   5
+#define CONTROL_RATE 25
+
 QEasingCurve::Type TorcTransitionControl::EasingCurveFromString(const QString &Curve)
 {
     QString curve = Curve.trimmed().toUpper();
@@ -140,13 +149,16 @@ QString TorcTransitionControl::StringFromEasingCurve(QEasingCurve::Type Type)
  *
  * The custom 'LinearLED' transition implements the CIE 1931 formula for adjusting an output for
  * perceived brightness.
+ *
+ * Transitions are animated by TorcTransitionClock. The update rate depends on the output types (or an optional <rate>
+ * in Hz) and, for PWM outputs, updates smaller than the output resolution are suppressed.
 */
 TorcTransitionControl::TorcTransitionControl(const QString &Type, const QVariantMap &Details)
   : TorcControl(TorcControl::Transition, Details),
     m_duration(0),
     m_type(QEasingCurve::Linear),
-    m_animation(this, "animationValue"),
-    animationValue(0),
+    m_rate(0),
+    m_clockHandle(-1),
     m_firstTrigger(true),
     m_transitionValue(0)
 {
@@ -208,6 +220,19 @@ TorcTransitionControl::TorcTransitionControl(const QString &Type, const QVariant
         }
     }
 
+    // an optional update rate
+    if (Details.contains(QStringLiteral("rate")))
+    {
+        bool ok = false;
+        int rate = Details.value(QStringLiteral("rate")).toInt(&ok);
+        if (!ok || rate < 1 || rate > 100)
+        {
+            LOG(VB_GENERAL, LOG_ERR, QStringLiteral("Failed to parse rate for transition '%1' (must be 1-100Hz)").arg(uniqueId));
+            return;
+        }
+        m_rate = rate;
+    }
+
     // so far so good
     m_parsed = true;
 
@@ -216,7 +241,9 @@ TorcTransitionControl::TorcTransitionControl(const QString &Type, const QVariant
 
 TorcTransitionControl::~TorcTransitionControl()
 {
-    gLocalContext->RemoveObserver(this);
+    if (gLocalContext)
+        gLocalContext->RemoveObserver(this);
+    TorcTransitionClock::gTransitionClock->Deregister(m_clockHandle);
 }
 
 TorcControl::Type TorcTransitionControl::GetType(void) const
@@ -296,10 +323,10 @@ bool TorcTransitionControl::Validate(void)
         easingcurve.setCustomType(TorcTransitionControl::LinearLEDFunction);
     else
         easingcurve.setType(m_type);
-    m_animation.setEasingCurve(easingcurve);
-    m_animation.setStartValue(0);
-    m_animation.setEndValue(1);
-    m_animation.setDuration(m_duration * 1000);
+    int interval   = 0;
+    double quantum = 0.0;
+    OutputTiming(interval, quantum);
+    m_clockHandle = TorcTransitionClock::gTransitionClock->Register(this, easingcurve, m_duration * 1000, interval, quantum);
 
     // debug
     LOG(VB_GENERAL, LOG_DEBUG, QStringLiteral("%1: %2").arg(uniqueId, GetDescription().join(',')));
@@ -339,7 +366,7 @@ void TorcTransitionControl::CalculateOutput(void)
     QMutexLocker locker(&lock);
 
     // sanity check
-    if (m_inputs.size() != 1)
+    if (m_inputValues.size() != 1)
         return;
 
     quint64 timesincelasttransition = 0;
@@ -352,7 +379,7 @@ void TorcTransitionControl::CalculateOutput(void)
     // perhaps be configurable (some people might want them to take the hour) but sudden transitions
     // could also be 'smoothed' with a seperate transition.
 
-    double newvalue = m_inputValues.constBegin().value();
+    double newvalue = m_inputValues.at(0);
     LOG(VB_GENERAL, LOG_DEBUG, QStringLiteral("Transition value: %1").arg(newvalue));
 
     if (m_firstTrigger)
@@ -360,7 +387,7 @@ void TorcTransitionControl::CalculateOutput(void)
         m_firstTrigger = false;
         m_transitionValue = newvalue;
 
-        TorcTimerControl *timerinput = qobject_cast<TorcTimerControl*>(m_inputs.firstKey());
+        TorcTimerControl *timerinput = qobject_cast<TorcTimerControl*>(m_inputDevices.at(0));
         if (timerinput)
         {
             timesincelasttransition = timerinput->TimeSinceLastTransition() / 1000;
@@ -368,13 +395,13 @@ void TorcTransitionControl::CalculateOutput(void)
             if (timesincelasttransition > m_duration)
             {
                 LOG(VB_GENERAL, LOG_INFO, QStringLiteral("Transition '%1' is initially inactive (value '%2')").arg(uniqueId).arg(newvalue));
-                SetValue(newvalue);
+                SetValuePriv(newvalue);
                 return;
             }
 
             // if we are part way through the transition, the animation will expect the value to have started
             // from the previous transition value !:)
-            SetValue(newvalue > 0 ? 0 : 1);
+            SetValuePriv(newvalue > 0 ? 0 : 1);
             LOG(VB_GENERAL, LOG_INFO, QStringLiteral("Forcing transition '%1' to %2% complete (%3)").arg(uniqueId)
                 .arg(((double)timesincelasttransition / (double)m_duration) * 100.0).arg(newvalue ? QStringLiteral("rising") : QStringLiteral("falling")));
 
@@ -400,26 +427,58 @@ void TorcTransitionControl::CalculateOutput(void)
 
     // We assume the specified easing curve is for a rising (0-1) transition. We then run it in
     // reverse for the 'mirrored' falling operation.
-    // NB if the animation is still running, it will reverse from its current position - so there
+    // NB if the transition is still running, it will reverse from its current position - so there
     // will be no glitches/jumps/interruptions.
-    m_animation.setDirection(newvalue > 0 ? QAbstractAnimation::Forward : QAbstractAnimation::Backward);
-    m_animation.start();
+    TorcTransitionClock::gTransitionClock->Start(m_clockHandle, newvalue > 0);
 
     // this has to come after start
     if (timesincelasttransition > 0)
-        m_animation.setCurrentTime(timesincelasttransition * 1000);
+        TorcTransitionClock::gTransitionClock->Seek(m_clockHandle, timesincelasttransition * 1000);
 }
 
-/// Our main output, value, is read only. So the animation operates on a proxy, animationValue.
-void TorcTransitionControl::SetAnimationValue(double Value)
+/// Our main output, value, is read only to everything other than TorcTransitionClock.
+void TorcTransitionControl::SetTransitionValue(double Value)
 {
     QMutexLocker locker(&lock);
-    animationValue = Value;
-    SetValue(Value);
+    SetValuePriv(Value);
 }
 
-double TorcTransitionControl::GetAnimationValue(void)
+/*! \brief Determine the update interval and quantum for this transition's outputs.
+ *
+ * The interval is set by the output that needs the highest rate. Updates are only quantised if every output
+ * is a PWM output, using the finest resolution.
+*/
+void TorcTransitionControl::OutputTiming(int &Interval, double &Quantum) const
 {
-    QMutexLocker locker(&lock);
-    return animationValue;
+    int  rate       = 0;
+    uint resolution = 0;
+    bool allpwm     = true;
+
+    QMap<QObject*,QString>::const_iterator it = m_outputs.constBegin();
+    for ( ; it != m_outputs.constEnd(); ++it)
+    {
+        TorcOutput *output = qobject_cast<TorcOutput*>(it.key());
+        TorcPWMOutput *pwm = qobject_cast<TorcPWMOutput*>(it.key());
+        if (pwm)
+            resolution = qMax(resolution, pwm->GetResolution());
+        else
+            allpwm = false;
+
+        if (!output)
+            rate = qMax(rate, CONTROL_RATE);
+        else if (output->GetType() == TorcOutput::PWM)
+            rate = qMax(rate, PWM_RATE);
+        else if (output->GetType() == TorcOutput::Switch || output->GetType() == TorcOutput::Button)
+            rate = qMax(rate, SWITCH_RATE);
+        else
+            rate = qMax(rate, OTHER_RATE);
+    }
+
+    if (m_rate > 0)
+        rate = m_rate;
+    if (rate < 1)
+        rate = OTHER_RATE;
+
+    Interval = 1000 / rate;
+    Quantum  = (allpwm && resolution > 0) ? 1.0 / (double)resolution : 0.0;
 }
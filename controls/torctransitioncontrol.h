@@ -3,15 +3,15 @@
 
 // Qt
 #include <QEasingCurve>
-#include <QPropertyAnimation>
 
 // Torc
 #include "torccontrol.h"
 
 class TorcTransitionControl : public TorcControl
 {
+    friend class TorcTransitionClock;
+
     Q_OBJECT
-    Q_PROPERTY(double animationValue READ GetAnimationValue() WRITE SetAnimationValue(Value) CONSTANT)
 
   public:
     TorcTransitionControl(const QString &Type, const QVariantMap &Details);
@@ -28,17 +28,17 @@ class TorcTransitionControl : public TorcControl
   public slots:
     bool                      event                 (QEvent *Event) override;
     void                      Restart               (void);
-    void                      SetAnimationValue     (double Value);
-    double                    GetAnimationValue     (void);
 
   private:
     void                      CalculateOutput       (void) override;
+    void                      SetTransitionValue    (double Value);
+    void                      OutputTiming          (int &Interval, double &Quantum) const;
 
   private:
     quint64                   m_duration;
     QEasingCurve::Type        m_type;
-    QPropertyAnimation        m_animation;
-    double                    animationValue;
+    int                       m_rate;
+    int                       m_clockHandle;
     bool                      m_firstTrigger;
     double                    m_transitionValue; // tracks the input value to filter transitions
 };
@@ -43,6 +43,8 @@ Torc1WireBus* Torc1WireBus::gTorc1WireBus = new Torc1WireBus();
  * we create those devices specified in the configuration file. Any that are not present
  * will remain invalid.
  *
+ * Sensors are read by a Torc1WireMaster (in its own thread) for each bus master that has configured sensors.
+ *
  * \note Only tested with RaspberryPi under Raspbian; other devices/implementations may
  *       use a different filesystem structure.
  * \note Only the Maxim DS18B20 digital thermometer is currently supported.
@@ -67,7 +69,10 @@ Torc1WireBus* Torc1WireBus::gTorc1WireBus = new Torc1WireBus();
 */
 Torc1WireBus::Torc1WireBus()
   : TorcDeviceHandler(),
-    m_inputs()
+    m_inputs(),
+    m_mastersLock(),
+    m_masters(),
+    m_sensorMasters()
 {
 }
 
@@ -158,6 +163,60 @@ void Torc1WireBus::Destroy(void)
     m_inputs.clear();
 }
 
+void Torc1WireBus::RemoveDevices(const QStringList &UniqueIds, QStringList &Removed)
+{
+    QWriteLocker locker(&m_handlerLock);
+
+    QMutableHashIterator<QString,TorcInput*> it(m_inputs);
+    while (it.hasNext())
+    {
+        it.next();
+        QString uniqueid = it.value()->GetUniqueId();
+        if (UniqueIds.contains(uniqueid))
+        {
+            TorcInputs::gInputs->RemoveInput(it.value());
+            it.value()->DownRef();
+            it.remove();
+            Removed.append(uniqueid);
+        }
+    }
+}
+
+/// Start reading the sensor Serial, starting a reader for its bus master if needed.
+void Torc1WireBus::AddSensor(const QString &Serial, Torc1WireListener *Listener)
+{
+    QString directory = Torc1WireMaster::GetMasterDirectory(ONE_WIRE_DIRECTORY, Serial);
+    if (directory.isEmpty())
+    {
+        LOG(VB_GENERAL, LOG_ERR, QStringLiteral("Failed to find 1Wire device '%1%2'").arg(ONE_WIRE_DIRECTORY, Serial));
+        return;
+    }
+
+    QMutexLocker locker(&m_mastersLock);
+    Torc1WireMasterThread *thread = m_masters.value(directory);
+    if (!thread)
+    {
+        thread = new Torc1WireMasterThread(new Torc1WireMaster(directory));
+        m_masters.insert(directory, thread);
+        thread->start();
+    }
+    thread->GetMaster()->AddSensor(Serial, Listener);
+    m_sensorMasters.insert(Serial, directory);
+}
+
+/// Stop reading the sensor Serial, stopping its bus master reader if it was the last sensor.
+void Torc1WireBus::RemoveSensor(const QString &Serial)
+{
+    QMutexLocker locker(&m_mastersLock);
+    QString directory = m_sensorMasters.take(Serial);
+    Torc1WireMasterThread *thread = m_masters.value(directory);
+    if (thread && thread->GetMaster()->RemoveSensor(Serial))
+    {
+        m_masters.remove(directory);
+        delete thread;
+    }
+}
+
 Torc1WireDeviceFactory* Torc1WireDeviceFactory::gTorc1WireDeviceFactory = nullptr;
 
 Torc1WireDeviceFactory::Torc1WireDeviceFactory()
@@ -188,6 +247,7 @@ QStringLiteral("<xs:simpleType name='ds18b20SerialType'>\r\n"
 "    <xs:element name='username'        type='userNameType' minOccurs='0' maxOccurs='1'/>\r\n"
 "    <xs:element name='userdescription' type='userDescriptionType' minOccurs='0' maxOccurs='1'/>\r\n"
 "    <xs:element name='wire1serial'     type='ds18b20SerialType'/>\r\n"
+"    <xs:element name='filter'          type='inputFilterType' minOccurs='0' maxOccurs='1'/>\r\n"
 "  </xs:all>\r\n"
 "</xs:complexType>\r\n\r\n"
 "<xs:complexType name='wire1Type'>\r\n"
@@ -3,11 +3,13 @@
 
 // Qt
 #include <QMap>
+#include <QMutex>
 #include <QObject>
 
 // Torc
 #include "torcinput.h"
 #include "torccentral.h"
+#include "torc1wiremaster.h"
 
 #define ONE_WIRE_DIRECTORY QStringLiteral("/sys/bus/w1/devices/")
 #define ONE_WIRE_NAME      QStringLiteral("wire1")
@@ -21,9 +23,15 @@ class Torc1WireBus : public TorcDeviceHandler
 
     void                        Create  (const QVariantMap &Details);
     void                        Destroy (void);
+    void                        RemoveDevices (const QStringList &UniqueIds, QStringList &Removed);
+    void                        AddSensor     (const QString &Serial, Torc1WireListener *Listener);
+    void                        RemoveSensor  (const QString &Serial);
 
   private:
     QHash<QString, TorcInput*>  m_inputs;
+    QMutex                      m_mastersLock;
+    QHash<QString, Torc1WireMasterThread*> m_masters;
+    QHash<QString, QString>     m_sensorMasters;
 };
 
 class Torc1WireDeviceFactory
@@ -20,121 +20,31 @@
 * USA.
 */
 
-// Qt
-#include <QtGlobal>
-#include <QTextStream>
-
 // Torc
 #include "torclogging.h"
 #include "torccentral.h"
 #include "torc1wirebus.h"
 #include "torc1wireds18b20.h"
 
-#define MIN_READ_INTERVAL 10000
-
-Torc1WireReader::Torc1WireReader(const QString &DeviceName)
-  : m_timer(),
-    m_file(QStringLiteral("%1%2/w1_slave").arg(ONE_WIRE_DIRECTORY, DeviceName))
-{
-    m_timer.setTimerType(Qt::CoarseTimer);
-    m_timer.setSingleShot(true);
-    connect(&m_timer, &QTimer::timeout, this, &Torc1WireReader::Read);
-    // randomise start time for each input
-    m_timer.start(qrand() % MIN_READ_INTERVAL);
-}
-
-void Torc1WireReader::Read(void)
-{
-    if (!m_file.open(QIODevice::ReadOnly))
-    {
-        LOG(VB_GENERAL, LOG_ERR, QStringLiteral("Failed to read device '%1' (Error #%2: '%3')")
-                                 .arg(m_file.fileName()).arg(m_file.error()).arg(m_file.errorString()));
-        emit NewTemperature(0.0, false);
-        m_timer.start(MIN_READ_INTERVAL);
-        return;
-    }
-
-    // read
-    QTextStream text(&m_file);
-
-    // check crc
-    QString line = text.readLine();
-    if (!line.contains(QStringLiteral("crc")) || !line.contains(QStringLiteral("YES")))
-    {
-        LOG(VB_GENERAL, LOG_ERR, QStringLiteral("CRC check failed for device %1").arg(m_file.fileName()));
-        emit NewTemperature(0.0, false);
-    }
-    else
-    {
-        // read temp
-        line = text.readLine().trimmed();
-        int index = line.lastIndexOf(QStringLiteral("t="));
-        if (index < 0)
-        {
-            LOG(VB_GENERAL, LOG_ERR, QStringLiteral("Failed to parse temperature for device %1").arg(m_file.fileName()));
-            emit NewTemperature(0.0, false);
-        }
-        else
-        {
-            line = line.mid(index + 2);
-            bool ok = false;
-            double temp = line.toDouble(&ok);
-            if (ok)
-            {
-                emit NewTemperature(temp / 1000.0, true);
-            }
-            else
-            {
-                LOG(VB_GENERAL, LOG_ERR, QStringLiteral("Failed to convert temperature for device %1").arg(m_file.fileName()));
-                emit NewTemperature(0.0, false);
-            }
-        }
-    }
-    m_file.close();
-    m_timer.start(MIN_READ_INTERVAL);
-}
-
-Torc1WireReadThread::Torc1WireReadThread(Torc1WireDS18B20 *Parent, const QString &DeviceName)
-  : TorcQThread(QStringLiteral("1Wire")),
-    m_parent(Parent),
-    m_reader(nullptr),
-    m_deviceName(DeviceName)
-{
-}
-
-void Torc1WireReadThread::Start(void)
-{
-    if (m_parent)
-    {
-        m_reader = new Torc1WireReader(m_deviceName);
-        connect(m_reader, &Torc1WireReader::NewTemperature, m_parent, &Torc1WireDS18B20::Read);
-    }
-}
-
-void Torc1WireReadThread::Finish(void)
-{
-    if (m_reader)
-        delete m_reader;
-    m_reader = nullptr;
-    if (m_parent)
-        m_parent->Read(0.0, false);
-}
-
+/*! \class Torc1WireDS18B20
+ *  \brief A Maxim DS18B20 digital thermometer.
+ *
+ * The sensor is read, along with any other sensors on the same bus, by Torc1WireMaster.
+*/
 Torc1WireDS18B20::Torc1WireDS18B20(const QVariantMap &Details)
   : TorcTemperatureInput(TorcCentral::GetGlobalTemperatureUnits() == TorcCentral::Celsius ? 0.0 : 32.0,
                          TorcCentral::GetGlobalTemperatureUnits() == TorcCentral::Celsius ? -55.0 : -67.0,
                          TorcCentral::GetGlobalTemperatureUnits() == TorcCentral::Celsius ? 125.0 : 257.0,
                          DS18B20NAME, Details),
-    m_deviceId(Details.value(QStringLiteral("wire1serial")).toString()),
-    m_readThread(this, Details.value(QStringLiteral("wire1serial")).toString())
+    Torc1WireListener(),
+    m_deviceId(Details.value(QStringLiteral("wire1serial")).toString())
 {
-    m_readThread.start();
+    Torc1WireBus::gTorc1WireBus->AddSensor(m_deviceId, this);
 }
 
 Torc1WireDS18B20::~Torc1WireDS18B20()
 {
-    m_readThread.quit();
-    m_readThread.wait();
+    Torc1WireBus::gTorc1WireBus->RemoveSensor(m_deviceId);
 }
 
 QStringList Torc1WireDS18B20::GetDescription(void)
@@ -142,6 +52,12 @@ QStringList Torc1WireDS18B20::GetDescription(void)
     return QStringList() << tr("1Wire DS18B20 Temperature" ) << tr("Serial# %1").arg(m_deviceId);
 }
 
+/// Pass a new reading from the bus thread to this input's thread.
+void Torc1WireDS18B20::TemperatureRead(double Value, bool Valid)
+{
+    QMetaObject::invokeMethod(this, "Read", Qt::QueuedConnection, Q_ARG(double, Value), Q_ARG(bool, Valid));
+}
+
 void Torc1WireDS18B20::Read(double Value, bool Valid)
 {
     if (Valid)
@@ -167,5 +83,3 @@ class Torc1WireDS18B20Factory : public Torc1WireDeviceFactory
         return nullptr;
     }
 } Torc1WireDS18B20Factory;
-
-          
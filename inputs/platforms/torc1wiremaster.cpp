@@ -0,0 +1,313 @@
+/* Class Torc1WireMaster
+*
+* This file is part of the Torc project.
+*
+* Copyright (C) Mark Kendall 2018
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+* USA.
+*/
+
+// Qt
+#include <QFile>
+#include <QFileInfo>
+
+// Torc
+#include "torclogging.h"
+#include "torc1wiremaster.h"
+
+#define BULK_READ_FILE     QStringLiteral("therm_bulk_read")
+#define FIRST_READ_DELAY   1000
+#define CONVERSION_POLL    50
+#define MAX_POLLS          20
+#define MAX_SLAVE_SIZE     128
+
+/*! \class Torc1WireMaster
+ *  \brief Read every temperature sensor on a 1Wire bus master.
+ *
+ * Reading a sensor's w1_slave file normally triggers a conversion for that sensor alone, which takes up to 750ms
+ * (and the kernel serialises conversions on the bus). Where the kernel supports it (therm_bulk_read), every sensor on
+ * the bus is instead told to convert at the same time and then each w1_slave file is read, which returns the result of
+ * that conversion immediately.
+ *
+ * The conversion wait depends upon the highest resolution configured for any sensor on the bus (from 94ms at 9 bits
+ * to 750ms at 12 bits). If bulk conversion is not available, sensors are read one after another.
+ *
+ * Sensors are added and removed from any thread. Readings are passed to each sensor's Torc1WireListener from the thread
+ * that owns the master.
+*/
+Torc1WireMaster::Torc1WireMaster(const QString &Directory, int Interval /*= DEFAULT_1WIRE_INTERVAL*/)
+  : QObject(),
+    m_directory(Directory.endsWith('/') ? Directory : Directory + '/'),
+    m_interval(qMax(Interval, 100)),
+    m_bulk(QFile::exists(m_directory + BULK_READ_FILE)),
+    m_polls(0),
+    m_cycleTimer(nullptr),
+    m_conversionTimer(nullptr),
+    m_lock(),
+    m_sensors(),
+    m_conversions(0),
+    m_cycles(0)
+{
+    if (!m_bulk)
+        LOG(VB_GENERAL, LOG_INFO, QStringLiteral("1Wire bulk conversion not available for '%1' - reading sensors individually").arg(m_directory));
+}
+
+/*! \brief Parse the contents of a DS18B20 w1_slave file.
+ *
+ * The file contains two lines - the scratchpad and CRC result and then the scratchpad and temperature:
+ * \code
+ * 72 01 4b 46 7f ff 0e 10 57 : crc=57 YES
+ * 72 01 4b 46 7f ff 0e 10 57 t=23125
+ * \endcode
+*/
+bool Torc1WireMaster::ParseSlave(const QByteArray &Data, int &MilliCelsius)
+{
+    const char *data = Data.constData();
+    int size = Data.size();
+
+    // the first line must end with a successful CRC check
+    int eol = Data.indexOf('\n');
+    if (eol < 3 || qstrncmp(data + eol - 3, "YES", 3) != 0)
+        return false;
+
+    int index = Data.indexOf("t=", eol);
+    if (index < 0)
+        return false;
+    index += 2;
+
+    bool negative = index < size && data[index] == '-';
+    if (negative)
+        index++;
+
+    int digits = 0;
+    int value  = 0;
+    for ( ; index < size && digits < 7 && data[index] >= '0' && data[index] <= '9'; ++index, ++digits)
+        value = (value * 10) + (data[index] - '0');
+
+    if (digits < 1)
+        return false;
+    MilliCelsius = negative ? -value : value;
+    return true;
+}
+
+/// The DS18B20 conversion time (in milliseconds) for the given resolution (9 to 12 bits).
+int Torc1WireMaster::ConversionTime(int Resolution)
+{
+    return 750 >> (12 - qBound(9, Resolution, 12));
+}
+
+/*! \brief Return the directory of the bus master for the sensor Serial.
+ *
+ * Each entry in Root (e.g. /sys/bus/w1/devices/28-0000012345678) is a link to the sensor's directory within its
+ * bus master (e.g. /sys/devices/w1_bus_master1/28-0000012345678). An empty string is returned if the sensor is not found.
+*/
+QString Torc1WireMaster::GetMasterDirectory(const QString &Root, const QString &Serial)
+{
+    QString device = QFileInfo(Root + (Root.endsWith('/') ? "" : "/") + Serial).canonicalFilePath();
+    if (device.isEmpty())
+        return QString();
+    return QFileInfo(device).absolutePath() + '/';
+}
+
+QString Torc1WireMaster::GetDirectory(void) const
+{
+    return m_directory;
+}
+
+void Torc1WireMaster::AddSensor(const QString &Serial, Torc1WireListener *Listener)
+{
+    if (!Listener)
+        return;
+
+    Sensor sensor;
+    sensor.listener   = Listener;
+    sensor.resolution = 12;
+
+    QFile resolution(m_directory + Serial + "/resolution");
+    if (resolution.open(QIODevice::ReadOnly))
+    {
+        bool ok = false;
+        int bits = resolution.readAll().trimmed().toInt(&ok);
+        if (ok)
+            sensor.resolution = qBound(9, bits, 12);
+        resolution.close();
+    }
+
+    QMutexLocker locker(&m_lock);
+    m_sensors.insert(Serial, sensor);
+    LOG(VB_GENERAL, LOG_INFO, QStringLiteral("1Wire sensor %1 on '%2' (%3 bit resolution)").arg(Serial, m_directory).arg(sensor.resolution));
+}
+
+/// Remove the sensor Serial. Returns true if there are no sensors left.
+bool Torc1WireMaster::RemoveSensor(const QString &Serial)
+{
+    QMutexLocker locker(&m_lock);
+    m_sensors.remove(Serial);
+    return m_sensors.isEmpty();
+}
+
+quint64 Torc1WireMaster::GetConversionCount(void)
+{
+    QMutexLocker locker(&m_lock);
+    return m_conversions;
+}
+
+quint64 Torc1WireMaster::GetCycleCount(void)
+{
+    QMutexLocker locker(&m_lock);
+    return m_cycles;
+}
+
+/// Start reading. This must be called from the thread that owns the master.
+void Torc1WireMaster::Start(void)
+{
+    if (m_cycleTimer)
+        return;
+
+    m_cycleTimer = new QTimer(this);
+    m_cycleTimer->setTimerType(Qt::CoarseTimer);
+    connect(m_cycleTimer, &QTimer::timeout, this, &Torc1WireMaster::Convert);
+    m_conversionTimer = new QTimer(this);
+    m_conversionTimer->setSingleShot(true);
+    connect(m_conversionTimer, &QTimer::timeout, this, &Torc1WireMaster::Collect);
+
+    // give all of the sensors on the bus time to be added before the first read
+    m_cycleTimer->start(qMin(FIRST_READ_DELAY, m_interval));
+}
+
+void Torc1WireMaster::Stop(void)
+{
+    delete m_cycleTimer;
+    delete m_conversionTimer;
+    m_cycleTimer      = nullptr;
+    m_conversionTimer = nullptr;
+}
+
+/// Start a conversion on every sensor.
+void Torc1WireMaster::Convert(void)
+{
+    if (m_cycleTimer->interval() != m_interval)
+        m_cycleTimer->start(m_interval);
+
+    // don't start a new cycle while the last one is still running
+    if (m_conversionTimer->isActive())
+        return;
+
+    int wait = 0;
+    {
+        QMutexLocker locker(&m_lock);
+        if (m_sensors.isEmpty())
+            return;
+
+        m_cycles++;
+        if (m_bulk)
+        {
+            foreach (const Sensor &sensor, m_sensors)
+                wait = qMax(wait, ConversionTime(sensor.resolution));
+            m_conversions++;
+        }
+    }
+
+    if (m_bulk)
+    {
+        QFile bulk(m_directory + BULK_READ_FILE);
+        if (!bulk.open(QIODevice::WriteOnly) || bulk.write("trigger\n") < 0)
+        {
+            LOG(VB_GENERAL, LOG_ERR, QStringLiteral("Failed to trigger conversion for '%1' (Error #%2: '%3')")
+                                     .arg(m_directory).arg(bulk.error()).arg(bulk.errorString()));
+            wait = 0;
+        }
+        bulk.close();
+    }
+
+    m_polls = 0;
+    m_conversionTimer->start(wait);
+}
+
+/// Read the result of the last conversion from every sensor.
+void Torc1WireMaster::Collect(void)
+{
+    // the kernel reports -1 while a bulk conversion is still in progress
+    if (m_bulk && m_polls < MAX_POLLS)
+    {
+        QFile bulk(m_directory + BULK_READ_FILE);
+        if (bulk.open(QIODevice::ReadOnly) && bulk.readAll().trimmed() == "-1")
+        {
+            m_polls++;
+            m_conversionTimer->start(CONVERSION_POLL);
+            return;
+        }
+    }
+
+    // NB don't hold the lock while reading - without bulk conversion each read will take up to 750ms
+    QStringList serials;
+    {
+        QMutexLocker locker(&m_lock);
+        serials = m_sensors.keys();
+    }
+
+    QVector<int>  values(serials.size());
+    QVector<bool> valid(serials.size());
+    for (int i = 0; i < serials.size(); ++i)
+    {
+        QFile file(m_directory + serials.at(i) + "/w1_slave");
+        valid[i] = file.open(QIODevice::ReadOnly) && ParseSlave(file.read(MAX_SLAVE_SIZE), values[i]);
+        if (!valid[i])
+            LOG(VB_GENERAL, LOG_ERR, QStringLiteral("Failed to read 1Wire device '%1'").arg(file.fileName()));
+    }
+
+    QMutexLocker locker(&m_lock);
+    for (int i = 0; i < serials.size(); ++i)
+    {
+        QMap<QString,Sensor>::const_iterator it = m_sensors.constFind(serials.at(i));
+        if (it != m_sensors.constEnd())
+            it.value().listener->TemperatureRead(valid[i] ? values[i] / 1000.0 : 0.0, valid[i]);
+    }
+}
+
+/*! \class Torc1WireMasterThread
+ *  \brief Run a Torc1WireMaster in its own thread.
+ *
+ * The thread takes ownership of the master.
+*/
+Torc1WireMasterThread::Torc1WireMasterThread(Torc1WireMaster *Master)
+  : TorcQThread(QStringLiteral("1Wire")),
+    m_master(Master)
+{
+    m_master->moveToThread(this);
+}
+
+Torc1WireMasterThread::~Torc1WireMasterThread()
+{
+    quit();
+    wait();
+    delete m_master;
+}
+
+Torc1WireMaster* Torc1WireMasterThread::GetMaster(void) const
+{
+    return m_master;
+}
+
+void Torc1WireMasterThread::Start(void)
+{
+    m_master->Start();
+}
+
+void Torc1WireMasterThread::Finish(void)
+{
+    m_master->Stop();
+}
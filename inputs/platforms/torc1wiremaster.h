@@ -0,0 +1,92 @@
+#ifndef TORC1WIREMASTER_H
+#define TORC1WIREMASTER_H
+
+// Qt
+#include <QMap>
+#include <QMutex>
+#include <QTimer>
+
+// Torc
+#include "torcqthread.h"
+
+#define DEFAULT_1WIRE_INTERVAL 10000 // milliseconds
+
+class Torc1WireListener
+{
+  public:
+    Torc1WireListener() = default;
+    virtual ~Torc1WireListener() = default;
+
+    /// Called from the bus thread with a new reading (in Celsius).
+    virtual void    TemperatureRead   (double Value, bool Valid) = 0;
+
+  private:
+    Q_DISABLE_COPY(Torc1WireListener)
+};
+
+class Torc1WireMaster final : public QObject
+{
+    Q_OBJECT
+
+  public:
+    explicit Torc1WireMaster(const QString &Directory, int Interval = DEFAULT_1WIRE_INTERVAL);
+   ~Torc1WireMaster() = default;
+
+    static bool     ParseSlave        (const QByteArray &Data, int &MilliCelsius);
+    static int      ConversionTime    (int Resolution);
+    static QString  GetMasterDirectory(const QString &Root, const QString &Serial);
+
+    QString         GetDirectory      (void) const;
+    void            AddSensor         (const QString &Serial, Torc1WireListener *Listener);
+    bool            RemoveSensor      (const QString &Serial);
+    quint64         GetConversionCount(void);
+    quint64         GetCycleCount     (void);
+
+  public slots:
+    void            Start             (void);
+    void            Stop              (void);
+
+  private slots:
+    void            Convert           (void);
+    void            Collect           (void);
+
+  private:
+    class Sensor
+    {
+      public:
+        Torc1WireListener *listener;
+        int                resolution;
+    };
+
+  private:
+    Q_DISABLE_COPY(Torc1WireMaster)
+    QString               m_directory;
+    int                   m_interval;
+    bool                  m_bulk;
+    int                   m_polls;
+    QTimer               *m_cycleTimer;
+    QTimer               *m_conversionTimer;
+    QMutex                m_lock;
+    QMap<QString,Sensor>  m_sensors;
+    quint64               m_conversions;
+    quint64               m_cycles;
+};
+
+class Torc1WireMasterThread final : public TorcQThread
+{
+    Q_OBJECT
+
+  public:
+    explicit Torc1WireMasterThread(Torc1WireMaster *Master);
+   ~Torc1WireMasterThread();
+
+    Torc1WireMaster* GetMaster        (void) const;
+    void            Start             (void) override;
+    void            Finish            (void) override;
+
+  private:
+    Q_DISABLE_COPY(Torc1WireMasterThread)
+    Torc1WireMaster *m_master;
+};
+
+#endif // TORC1WIREMASTER_H
@@ -0,0 +1,389 @@
+/* Class TorcGPIOEvents
+*
+* This file is part of the Torc project.
+*
+* Copyright (C) Mark Kendall 2018
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+* USA.
+*/
+
+// Torc
+#include "torclogging.h"
+#include "torcgpioevents.h"
+
+// Linux
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+
+#define MAX_GPIO_EVENTS 64
+
+/*! \class TorcGPIOSysfsLine
+ *  \brief A GPIO input exported through /sys/class/gpio.
+ *
+ * The pin must already be exported, configured as an input and have its edge set (e.g. 'both').
+*/
+TorcGPIOSysfsLine::TorcGPIOSysfsLine(const QString &ValueFile)
+  : TorcGPIOLine(),
+    m_handle(open(ValueFile.toLocal8Bit().constData(), O_RDONLY | O_NONBLOCK | O_CLOEXEC))
+{
+    if (m_handle < 0)
+    {
+        LOG(VB_GENERAL, LOG_ERR, QStringLiteral("Failed to open '%1' to monitor GPIO input (err: %2)")
+            .arg(ValueFile).arg(strerror(errno)));
+    }
+}
+
+TorcGPIOSysfsLine::~TorcGPIOSysfsLine()
+{
+    if (m_handle > -1)
+        close(m_handle);
+}
+
+int TorcGPIOSysfsLine::GetHandle(void) const
+{
+    return m_handle;
+}
+
+quint32 TorcGPIOSysfsLine::GetEvents(void) const
+{
+    return EPOLLPRI | EPOLLERR;
+}
+
+int TorcGPIOSysfsLine::Read(void)
+{
+    // reading from the start of the file both clears the interrupt and returns the current value
+    char value = 0;
+    if (m_handle < 0 || lseek(m_handle, 0, SEEK_SET) < 0 || read(m_handle, &value, 1) != 1)
+        return -1;
+    return value == '1' ? 1 : 0;
+}
+
+/*! \class TorcGPIOEvents
+ *  \brief Monitor any number of GPIO inputs from a single thread.
+ *
+ * Each line is registered in one epoll set (along with an eventfd used to wake the thread) and the thread
+ * sleeps without a timeout unless a debounce period is pending.
+ *
+ * Debouncing is based on timestamps rather than sleeping. A change is reported immediately if the line has been
+ * stable for at least its debounce period. Any further edges within that period are absorbed and the line
+ * is read again when the period expires, so the settled value is always reported.
+ *
+ * Changes are collected into batches and delivered to each line's TorcGPIOListener from the thread that
+ * owns this object. Changes for a line are delivered in order.
+ *
+ * \note Listeners are called with the internal lock held and must not add or remove lines.
+*/
+TorcGPIOEvents::TorcGPIOEvents()
+  : TorcQThread(QStringLiteral("GPIOEvents")),
+    m_lock(),
+    m_epoll(epoll_create1(EPOLL_CLOEXEC)),
+    m_wake(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)),
+    m_aborted(false),
+    m_deliveryQueued(false),
+    m_lines(),
+    m_batch(),
+    m_clock(),
+    m_events(0),
+    m_batches(0)
+{
+    m_clock.start();
+
+    if (m_epoll < 0 || m_wake < 0)
+    {
+        LOG(VB_GENERAL, LOG_ERR, QStringLiteral("Failed to create GPIO event handles (err: %1)").arg(strerror(errno)));
+        return;
+    }
+
+    struct epoll_event event;
+    memset(&event, 0, sizeof(event));
+    event.events  = EPOLLIN;
+    event.data.fd = m_wake;
+    if (epoll_ctl(m_epoll, EPOLL_CTL_ADD, m_wake, &event) < 0)
+        LOG(VB_GENERAL, LOG_ERR, QStringLiteral("Failed to add GPIO wake handle (err: %1)").arg(strerror(errno)));
+}
+
+TorcGPIOEvents::~TorcGPIOEvents()
+{
+    StopThread();
+
+    if (m_wake > -1)
+        close(m_wake);
+    if (m_epoll > -1)
+        close(m_epoll);
+}
+
+/// Return the GPIO event loop shared by all GPIO inputs.
+TorcGPIOEvents* TorcGPIOEvents::GetGPIOEvents(void)
+{
+    static QMutex lock;
+    static TorcGPIOEvents *events = nullptr;
+
+    QMutexLocker locker(&lock);
+    if (!events)
+        events = new TorcGPIOEvents();
+    return events;
+}
+
+/*! \brief Start monitoring Line and report changes to Listener.
+ *
+ * The current value is read and reported immediately. Line and Listener must remain valid until RemoveLine is called.
+*/
+bool TorcGPIOEvents::AddLine(TorcGPIOLine *Line, TorcGPIOListener *Listener, int Debounce /*= DEFAULT_GPIO_DEBOUNCE*/)
+{
+    if (!Line || !Listener || Line->GetHandle() < 0 || m_epoll < 0)
+        return false;
+
+    QMutexLocker locker(&m_lock);
+
+    int handle = Line->GetHandle();
+    if (m_lines.contains(handle))
+    {
+        LOG(VB_GENERAL, LOG_ERR, QStringLiteral("GPIO line %1 is already monitored").arg(handle));
+        return false;
+    }
+
+    struct epoll_event event;
+    memset(&event, 0, sizeof(event));
+    event.events  = Line->GetEvents();
+    event.data.fd = handle;
+    if (epoll_ctl(m_epoll, EPOLL_CTL_ADD, handle, &event) < 0)
+    {
+        LOG(VB_GENERAL, LOG_ERR, QStringLiteral("Failed to monitor GPIO line %1 (err: %2)").arg(handle).arg(strerror(errno)));
+        return false;
+    }
+
+    LineState state;
+    state.line       = Line;
+    state.listener   = Listener;
+    state.debounce   = qMax(Debounce, 0);
+    state.value      = -1;
+    state.lastChange = m_clock.elapsed() - state.debounce;
+    state.pending    = false;
+
+    // read (and report) the initial state
+    int value = Line->Read();
+    if (value > -1)
+        Accept(state, value, state.lastChange);
+    m_lines.insert(handle, state);
+
+    if (!isRunning())
+        start();
+    else
+        Wake();
+    return true;
+}
+
+/// Stop monitoring Line. Any undelivered changes for the line are discarded.
+void TorcGPIOEvents::RemoveLine(TorcGPIOLine *Line)
+{
+    if (!Line)
+        return;
+
+    bool empty = false;
+    {
+        QMutexLocker locker(&m_lock);
+
+        QHash<int,LineState>::iterator it = m_lines.find(Line->GetHandle());
+        if (it == m_lines.end() || it.value().line != Line)
+            return;
+
+        TorcGPIOListener *listener = it.value().listener;
+        (void)epoll_ctl(m_epoll, EPOLL_CTL_DEL, it.key(), nullptr);
+        m_lines.erase(it);
+
+        for (int i = m_batch.size() - 1; i >= 0; --i)
+            if (m_batch.at(i).first == listener)
+                m_batch.remove(i);
+
+        empty = m_lines.isEmpty();
+    }
+
+    // nothing left to monitor
+    if (empty)
+        StopThread();
+}
+
+quint64 TorcGPIOEvents::GetEventCount(void)
+{
+    QMutexLocker locker(&m_lock);
+    return m_events;
+}
+
+quint64 TorcGPIOEvents::GetBatchCount(void)
+{
+    QMutexLocker locker(&m_lock);
+    return m_batches;
+}
+
+void TorcGPIOEvents::Start(void)
+{
+    LOG(VB_GENERAL, LOG_INFO, QStringLiteral("GPIO event thread starting"));
+}
+
+void TorcGPIOEvents::Finish(void)
+{
+    LOG(VB_GENERAL, LOG_INFO, QStringLiteral("GPIO event thread stopping"));
+}
+
+void TorcGPIOEvents::run(void)
+{
+    Initialise();
+
+    struct epoll_event events[MAX_GPIO_EVENTS];
+    int timeout = -1;
+
+    forever
+    {
+        int count = epoll_wait(m_epoll, events, MAX_GPIO_EVENTS, timeout);
+        if (count < 0 && errno != EINTR)
+        {
+            LOG(VB_GENERAL, LOG_ERR, QStringLiteral("GPIO event wait failed (err: %1)").arg(strerror(errno)));
+            break;
+        }
+
+        QMutexLocker locker(&m_lock);
+        if (m_aborted)
+            break;
+
+        qint64 now = m_clock.elapsed();
+        for (int i = 0; i < count; ++i)
+        {
+            int handle = events[i].data.fd;
+            if (handle == m_wake)
+            {
+                quint64 dummy;
+                (void)read(m_wake, &dummy, sizeof(dummy));
+                continue;
+            }
+
+            QHash<int,LineState>::iterator it = m_lines.find(handle);
+            if (it != m_lines.end())
+            {
+                m_events++;
+                Edge(it.value(), now);
+            }
+        }
+
+        Settle(now);
+        timeout = NextTimeout(now);
+    }
+
+    Deinitialise();
+}
+
+/// Deliver the current batch of changes.
+void TorcGPIOEvents::Deliver(void)
+{
+    QMutexLocker locker(&m_lock);
+    m_deliveryQueued = false;
+    if (m_batch.isEmpty())
+        return;
+
+    m_batches++;
+    QVector<QPair<TorcGPIOListener*,int> > batch;
+    batch.swap(m_batch);
+    for (int i = 0; i < batch.size(); ++i)
+        batch.at(i).first->GPIOValueChanged(batch.at(i).second);
+}
+
+void TorcGPIOEvents::Edge(LineState &State, qint64 Now)
+{
+    // always read - to clear the event
+    int value = State.line->Read();
+    if (value < 0 || State.pending || value == State.value)
+        return;
+
+    if ((Now - State.lastChange) < State.debounce)
+        State.pending = true;
+    else
+        Accept(State, value, Now);
+}
+
+/// Report the settled value of any line whose debounce period has expired.
+void TorcGPIOEvents::Settle(qint64 Now)
+{
+    QHash<int,LineState>::iterator it = m_lines.begin();
+    for ( ; it != m_lines.end(); ++it)
+    {
+        LineState &state = it.value();
+        if (!state.pending || (Now - state.lastChange) < state.debounce)
+            continue;
+
+        state.pending = false;
+        int value = state.line->Read();
+        if (value > -1 && value != state.value)
+            Accept(state, value, Now);
+    }
+}
+
+void TorcGPIOEvents::Accept(LineState &State, int Value, qint64 Now)
+{
+    State.value      = Value;
+    State.lastChange = Now;
+    m_batch.append(qMakePair(State.listener, Value));
+
+    if (!m_deliveryQueued)
+    {
+        m_deliveryQueued = true;
+        QMetaObject::invokeMethod(this, "Deliver", Qt::QueuedConnection);
+    }
+}
+
+/// The time (in milliseconds) until the next debounce period expires, or -1 if none is pending.
+int TorcGPIOEvents::NextTimeout(qint64 Now) const
+{
+    qint64 result = -1;
+    QHash<int,LineState>::const_iterator it = m_lines.constBegin();
+    for ( ; it != m_lines.constEnd(); ++it)
+    {
+        if (!it.value().pending)
+            continue;
+        qint64 remaining = qMax(it.value().lastChange + it.value().debounce - Now, (qint64)0);
+        if (result < 0 || remaining < result)
+            result = remaining;
+    }
+    return (int)result;
+}
+
+void TorcGPIOEvents::Wake(void)
+{
+    quint64 one = 1;
+    if (m_wake > -1)
+        (void)write(m_wake, &one, sizeof(one));
+}
+
+void TorcGPIOEvents::StopThread(void)
+{
+    {
+        QMutexLocker locker(&m_lock);
+        if (!isRunning())
+            return;
+        m_aborted = true;
+        Wake();
+    }
+
+    wait();
+
+    // a line may have been added while the thread was stopping
+    QMutexLocker locker(&m_lock);
+    m_aborted = false;
+    if (!m_lines.isEmpty())
+        start();
+}
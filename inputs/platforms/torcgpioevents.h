@@ -0,0 +1,117 @@
+#ifndef TORCGPIOEVENTS_H
+#define TORCGPIOEVENTS_H
+
+// Qt
+#include <QHash>
+#include <QMutex>
+#include <QVector>
+#include <QElapsedTimer>
+
+// Torc
+#include "torcqthread.h"
+
+#define DEFAULT_GPIO_DEBOUNCE 20 // milliseconds
+
+/// A source of GPIO input events (e.g. a sysfs value file).
+class TorcGPIOLine
+{
+  public:
+    TorcGPIOLine() = default;
+    virtual ~TorcGPIOLine() = default;
+
+    /// The file descriptor to monitor.
+    virtual int     GetHandle (void) const = 0;
+    /// The epoll events that signal a change (e.g. EPOLLPRI).
+    virtual quint32 GetEvents (void) const = 0;
+    /// Acknowledge any pending event and return the current value (or -1 on error).
+    virtual int     Read      (void) = 0;
+
+  private:
+    Q_DISABLE_COPY(TorcGPIOLine)
+};
+
+class TorcGPIOSysfsLine final : public TorcGPIOLine
+{
+  public:
+    explicit TorcGPIOSysfsLine(const QString &ValueFile);
+   ~TorcGPIOSysfsLine();
+
+    int             GetHandle (void) const override;
+    quint32         GetEvents (void) const override;
+    int             Read      (void) override;
+
+  private:
+    Q_DISABLE_COPY(TorcGPIOSysfsLine)
+    int             m_handle;
+};
+
+class TorcGPIOListener
+{
+  public:
+    TorcGPIOListener() = default;
+    virtual ~TorcGPIOListener() = default;
+
+    virtual void    GPIOValueChanged (int Value) = 0;
+
+  private:
+    Q_DISABLE_COPY(TorcGPIOListener)
+};
+
+class TorcGPIOEvents final : public TorcQThread
+{
+    Q_OBJECT
+
+  public:
+    TorcGPIOEvents();
+   ~TorcGPIOEvents();
+
+    static TorcGPIOEvents* GetGPIOEvents (void);
+
+    bool            AddLine          (TorcGPIOLine *Line, TorcGPIOListener *Listener, int Debounce = DEFAULT_GPIO_DEBOUNCE);
+    void            RemoveLine       (TorcGPIOLine *Line);
+    quint64         GetEventCount    (void);
+    quint64         GetBatchCount    (void);
+
+    void            Start            (void) override;
+    void            Finish           (void) override;
+
+  protected:
+    void            run              (void) override;
+
+  private slots:
+    void            Deliver          (void);
+
+  private:
+    class LineState
+    {
+      public:
+        TorcGPIOLine     *line;
+        TorcGPIOListener *listener;
+        int               debounce;
+        int               value;
+        qint64            lastChange;
+        bool              pending;
+    };
+
+    void            Edge             (LineState &State, qint64 Now);
+    void            Settle           (qint64 Now);
+    void            Accept           (LineState &State, int Value, qint64 Now);
+    int             NextTimeout      (qint64 Now) const;
+    void            Wake             (void);
+    void            StopThread       (void);
+
+  private:
+    Q_DISABLE_COPY(TorcGPIOEvents)
+    QMutex          m_lock;
+    int             m_epoll;
+    int             m_wake;
+    bool            m_aborted;
+    bool            m_deliveryQueued;
+    QHash<int,LineState> m_lines;
+    QVector<QPair<TorcGPIOListener*,int> > m_batch;
+    QElapsedTimer   m_clock;
+    quint64         m_events;
+    quint64         m_batches;
+};
+
+#endif // TORCGPIOEVENTS_H
@@ -0,0 +1,359 @@
+/* Class TorcIIOBus
+*
+* This file is part of the Torc project.
+*
+* Copyright (C) Mark Kendall 2018
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+* USA.
+*/
+
+// Qt
+#include <QFileInfo>
+
+// Torc
+#include "torclogging.h"
+#include "torcinputs.h"
+#include "torciiobus.h"
+
+TorcIIOBus* TorcIIOBus::gTorcIIOBus = new TorcIIOBus();
+
+static double GetDouble(const QVariantMap &Details, const QString &Name, double Default)
+{
+    bool ok = false;
+    double result = Details.value(Name).toString().toDouble(&ok);
+    return ok ? result : Default;
+}
+
+/*! \class TorcIIOBus
+ *  \brief A class to handle sensors exposed by the Linux Industrial I/O (IIO) and hwmon subsystems.
+ *
+ * Many ADCs, temperature, humidity and pH front ends have kernel drivers that present their channels
+ * under /sys/bus/iio/devices (IIO) or /sys/class/hwmon (hwmon). A device is identified by either its directory
+ * (e.g. iio:device0 or hwmon1) or its name (e.g. ads1015) and a channel by its attribute prefix
+ * (e.g. in_voltage0 or temp1).
+ *
+ * Each device is read by a TorcIIODevice in its own thread. IIO devices that support triggered buffers are read
+ * through their character device (/dev/iio:deviceX), which returns many samples per read. Otherwise the channels
+ * are polled at the device's sample rate (default 10 per second). Samples are averaged and the input is updated
+ * at the channel's rate (default once per second).
+ *
+ * Values are converted to standard units (e.g. millivolts to volts, millidegrees to degrees) and can then be
+ * calibrated with an optional gain and intercept (value * gain + intercept) - e.g. to convert an ADC voltage to pH.
+ *
+ * \note Only temperature and pH inputs are currently supported.
+ * \note A trigger (e.g. from the iio-trig-hrtimer or iio-trig-sysfs modules) is needed for buffered reads from most
+ *       devices and must be configured before Torc is started.
+ *
+ * \code
+ * <torc>
+ *   <inputs>
+ *     <iio>
+ *       <ph>
+ *         <name>tankph</name>
+ *         <username>Tank pH</username>
+ *         <device>ads1015</device>
+ *         <channel>in_voltage0</channel>
+ *         <rate>1</rate>
+ *         <samplerate>100</samplerate>
+ *         <trigger>hrtimer0</trigger>
+ *         <gain>-5.7</gain>
+ *         <intercept>21.34</intercept>
+ *         <filter>
+ *           <deadband>0.02</deadband>
+ *         </filter>
+ *       </ph>
+ *     </iio>
+ *     <hwmon>
+ *       <temperature>
+ *         <name>cputemp</name>
+ *         <device>cpu_thermal</device>
+ *         <channel>temp1</channel>
+ *       </temperature>
+ *     </hwmon>
+ *   </inputs>
+ * </torc>
+ * \endcode
+*/
+TorcIIOBus::TorcIIOBus()
+  : TorcDeviceHandler(),
+    m_inputs(),
+    m_devicesLock(),
+    m_devices(),
+    m_listeners()
+{
+}
+
+void TorcIIOBus::Create(const QVariantMap &Details)
+{
+    QWriteLocker locker(&m_handlerLock);
+
+    QVariantMap::const_iterator i = Details.constBegin();
+    for ( ; i != Details.constEnd(); ++i)
+    {
+        // we look for IIO and hwmon devices in <inputs>
+        if (i.key() != INPUTS_DIRECTORY)
+            continue;
+
+        QVariantMap inputs = i.value().toMap();
+        QVariantMap::const_iterator it = inputs.constBegin();
+        for ( ; it != inputs.constEnd(); ++it)
+        {
+            bool hwmon = it.key() == HWMON_NAME;
+            if (!hwmon && it.key() != IIO_NAME)
+                continue;
+
+            QVariantMap sensors = it.value().toMap();
+            QVariantMap::const_iterator it2 = sensors.constBegin();
+            for ( ; it2 != sensors.constEnd(); ++it2)
+            {
+                QString sensortype  = it2.key();
+                QVariantMap details = it2.value().toMap();
+
+                if (!details.contains(QStringLiteral("device")) || !details.contains(QStringLiteral("channel")))
+                {
+                    LOG(VB_GENERAL, LOG_ERR, QStringLiteral("Cannot create %1 sensor without device and channel ('%2' '%3')")
+                        .arg(it.key(), sensortype, details.value(QStringLiteral("name")).toString()));
+                    continue;
+                }
+
+                TorcInput *input = nullptr;
+                if (sensortype == QStringLiteral("temperature"))
+                    input = new TorcIIOTemperatureInput(hwmon, details);
+                else if (sensortype == QStringLiteral("ph"))
+                    input = new TorcIIOpHInput(hwmon, details);
+
+                if (input)
+                    m_inputs.insert(input->GetUniqueId(), input);
+                else
+                    LOG(VB_GENERAL, LOG_WARNING, QStringLiteral("Unknown %1 sensor type '%2'").arg(it.key(), sensortype));
+            }
+        }
+    }
+}
+
+void TorcIIOBus::Destroy(void)
+{
+    QWriteLocker locker(&m_handlerLock);
+
+    // delete any extant inputs
+    QHash<QString,TorcInput*>::const_iterator it = m_inputs.constBegin();
+    for ( ; it != m_inputs.constEnd(); ++it)
+    {
+        TorcInputs::gInputs->RemoveInput(it.value());
+        it.value()->DownRef();
+    }
+    m_inputs.clear();
+}
+
+void TorcIIOBus::RemoveDevices(const QStringList &UniqueIds, QStringList &Removed)
+{
+    QWriteLocker locker(&m_handlerLock);
+
+    QMutableHashIterator<QString,TorcInput*> it(m_inputs);
+    while (it.hasNext())
+    {
+        it.next();
+        QString uniqueid = it.value()->GetUniqueId();
+        if (UniqueIds.contains(uniqueid))
+        {
+            TorcInputs::gInputs->RemoveInput(it.value());
+            it.value()->DownRef();
+            it.remove();
+            Removed.append(uniqueid);
+        }
+    }
+}
+
+/*! \brief Start reading the channel described by Details and report it to Listener.
+ *
+ * Returns the device directory, or an empty string if the device was not found.
+*/
+QString TorcIIOBus::AddChannel(bool Hwmon, const QVariantMap &Details, TorcIIOListener *Listener)
+{
+    QString device    = Details.value(QStringLiteral("device")).toString().trimmed();
+    QString channel   = Details.value(QStringLiteral("channel")).toString().trimmed();
+    QString directory = TorcIIODevice::FindDevice(Hwmon ? HWMON_DIRECTORY : IIO_DIRECTORY, device);
+    if (directory.isEmpty())
+    {
+        LOG(VB_GENERAL, LOG_ERR, QStringLiteral("Failed to find %1 device '%2'").arg(Hwmon ? HWMON_NAME : IIO_NAME, device));
+        return QString();
+    }
+
+    QMutexLocker locker(&m_devicesLock);
+    TorcIIODevice *iio = m_devices.value(directory);
+    if (!iio)
+    {
+        // the device settings are taken from the first channel that uses it
+        QString character = Hwmon ? QString() : IIO_DEV_DIRECTORY + "/" + QFileInfo(directory).fileName();
+        iio = new TorcIIODevice(directory, character, Hwmon, Details.value(QStringLiteral("trigger")).toString().trimmed());
+        iio->SetSampleRate(GetDouble(Details, QStringLiteral("samplerate"), IIO_DEFAULT_SAMPLES));
+        m_devices.insert(directory, iio);
+    }
+
+    if (!iio->AddChannel(channel, Listener, GetDouble(Details, QStringLiteral("rate"), IIO_DEFAULT_RATE),
+                         GetDouble(Details, QStringLiteral("gain"), 1.0), GetDouble(Details, QStringLiteral("intercept"), 0.0)))
+    {
+        LOG(VB_GENERAL, LOG_ERR, QStringLiteral("Failed to add channel '%1' for '%2'").arg(channel, directory));
+    }
+    m_listeners.insert(Listener, directory);
+    return directory;
+}
+
+/// Stop reporting to Listener, deleting its device if it was the last channel.
+void TorcIIOBus::RemoveChannel(TorcIIOListener *Listener)
+{
+    QMutexLocker locker(&m_devicesLock);
+    QString directory = m_listeners.take(Listener);
+    TorcIIODevice *iio = m_devices.value(directory);
+    if (iio && iio->RemoveChannel(Listener))
+    {
+        m_devices.remove(directory);
+        delete iio;
+    }
+}
+
+/*! \class TorcIIOTemperatureInput
+ *  \brief A temperature sensor read through IIO or hwmon.
+*/
+TorcIIOTemperatureInput::TorcIIOTemperatureInput(bool Hwmon, const QVariantMap &Details)
+  : TorcTemperatureInput(TorcCentral::GetGlobalTemperatureUnits() == TorcCentral::Celsius ? 0.0 : 32.0,
+                         TorcCentral::GetGlobalTemperatureUnits() == TorcCentral::Celsius ? -55.0 : -67.0,
+                         TorcCentral::GetGlobalTemperatureUnits() == TorcCentral::Celsius ? 150.0 : 302.0,
+                         Hwmon ? HWMON_NAME : IIO_NAME, Details),
+    TorcIIOListener(),
+    m_hwmon(Hwmon),
+    m_channel(Details.value(QStringLiteral("channel")).toString())
+{
+    m_channel = QFileInfo(TorcIIOBus::gTorcIIOBus->AddChannel(Hwmon, Details, this)).fileName() + "/" + m_channel;
+}
+
+TorcIIOTemperatureInput::~TorcIIOTemperatureInput()
+{
+    TorcIIOBus::gTorcIIOBus->RemoveChannel(this);
+}
+
+QStringList TorcIIOTemperatureInput::GetDescription(void)
+{
+    return QStringList() << (m_hwmon ? tr("hwmon Temperature") : tr("IIO Temperature")) << m_channel;
+}
+
+/// Pass a new reading from the device thread to this input's thread.
+void TorcIIOTemperatureInput::IIOValueRead(double Value, bool Valid)
+{
+    QMetaObject::invokeMethod(this, "Read", Qt::QueuedConnection, Q_ARG(double, Value), Q_ARG(bool, Valid));
+}
+
+void TorcIIOTemperatureInput::Read(double Value, bool Valid)
+{
+    if (Valid)
+    {
+        // readings are in celsius - convert if needed
+        double value = Value;
+        if (TorcCentral::GetGlobalTemperatureUnits() == TorcCentral::Fahrenheit)
+            value = TorcTemperatureInput::CelsiusToFahrenheit(Value);
+        SetValue(value);
+    }
+    else
+    {
+        SetValid(false);
+    }
+}
+
+/*! \class TorcIIOpHInput
+ *  \brief A pH sensor read through IIO or hwmon.
+ *
+ * Most pH front ends present a voltage, so the channel will usually need a gain and intercept to convert it to pH.
+*/
+TorcIIOpHInput::TorcIIOpHInput(bool Hwmon, const QVariantMap &Details)
+  : TorcpHInput(7.0, Hwmon ? HWMON_NAME : IIO_NAME, Details),
+    TorcIIOListener(),
+    m_hwmon(Hwmon),
+    m_channel(Details.value(QStringLiteral("channel")).toString())
+{
+    m_channel = QFileInfo(TorcIIOBus::gTorcIIOBus->AddChannel(Hwmon, Details, this)).fileName() + "/" + m_channel;
+}
+
+TorcIIOpHInput::~TorcIIOpHInput()
+{
+    TorcIIOBus::gTorcIIOBus->RemoveChannel(this);
+}
+
+QStringList TorcIIOpHInput::GetDescription(void)
+{
+    return QStringList() << (m_hwmon ? tr("hwmon pH") : tr("IIO pH")) << m_channel;
+}
+
+/// Pass a new reading from the device thread to this input's thread.
+void TorcIIOpHInput::IIOValueRead(double Value, bool Valid)
+{
+    QMetaObject::invokeMethod(this, "Read", Qt::QueuedConnection, Q_ARG(double, Value), Q_ARG(bool, Valid));
+}
+
+void TorcIIOpHInput::Read(double Value, bool Valid)
+{
+    if (Valid)
+        SetValue(qBound(0.0, Value, 14.0));
+    else
+        SetValid(false);
+}
+
+static const QString iioInputTypes =
+QStringLiteral("<xs:simpleType name='iioChannelType'>\r\n"
+"  <xs:restriction base='xs:string'>\r\n"
+"    <xs:pattern value='[a-z][a-z0-9_]*'/>\r\n"
+"  </xs:restriction>\r\n"
+"</xs:simpleType>\r\n"
+"<xs:simpleType name='iioRateType'>\r\n"
+"  <xs:restriction base='xs:decimal'>\r\n"
+"    <xs:minExclusive value='0'/>\r\n"
+"    <xs:maxInclusive value='10000'/>\r\n"
+"  </xs:restriction>\r\n"
+"</xs:simpleType>\r\n"
+"<xs:complexType name='iioSensorType'>\r\n"
+"  <xs:all>\r\n"
+"    <xs:element name='name'            type='deviceNameType'/>\r\n"
+"    <xs:element name='username'        type='userNameType' minOccurs='0' maxOccurs='1'/>\r\n"
+"    <xs:element name='userdescription' type='userDescriptionType' minOccurs='0' maxOccurs='1'/>\r\n"
+"    <xs:element name='device'          type='validStringType'/>\r\n"
+"    <xs:element name='channel'         type='iioChannelType'/>\r\n"
+"    <xs:element name='rate'            type='iioRateType' minOccurs='0' maxOccurs='1'/>\r\n"
+"    <xs:element name='samplerate'      type='iioRateType' minOccurs='0' maxOccurs='1'/>\r\n"
+"    <xs:element name='trigger'         type='validStringType' minOccurs='0' maxOccurs='1'/>\r\n"
+"    <xs:element name='gain'            type='xs:decimal' minOccurs='0' maxOccurs='1'/>\r\n"
+"    <xs:element name='intercept'       type='xs:decimal' minOccurs='0' maxOccurs='1'/>\r\n"
+"    <xs:element name='filter'          type='inputFilterType' minOccurs='0' maxOccurs='1'/>\r\n"
+"  </xs:all>\r\n"
+"</xs:complexType>\r\n\r\n"
+"<xs:complexType name='iioType'>\r\n"
+"  <xs:choice minOccurs='1' maxOccurs='unbounded'>\r\n"
+"    <xs:element name='temperature' type='iioSensorType'/>\r\n"
+"    <xs:element name='ph'          type='iioSensorType'/>\r\n"
+"  </xs:choice>\r\n"
+"</xs:complexType>\r\n");
+
+static const QString iioInputs =
+QStringLiteral("    <xs:element minOccurs='0' maxOccurs='1' name='iio'     type='iioType'/>\r\n"
+"    <xs:element minOccurs='0' maxOccurs='1' name='hwmon'   type='iioType'/>\r\n");
+
+class TorcIIOXSDFactory : public TorcXSDFactory
+{
+  public:
+    void GetXSD(QMultiMap<QString,QString> &XSD) {
+        XSD.insert(XSD_INPUTTYPES, iioInputTypes);
+        XSD.insert(XSD_INPUTS, iioInputs);
+    }
+
+} TorcIIOXSDFactory;
@@ -0,0 +1,76 @@
+#ifndef TORCIIOBUS_H
+#define TORCIIOBUS_H
+
+// Qt
+#include <QHash>
+#include <QMutex>
+
+// Torc
+#include "torcinput.h"
+#include "torccentral.h"
+#include "torctemperatureinput.h"
+#include "torcphinput.h"
+#include "torciiodevice.h"
+
+#define IIO_NAME   QStringLiteral("iio")
+#define HWMON_NAME QStringLiteral("hwmon")
+
+class TorcIIOBus : public TorcDeviceHandler
+{
+  public:
+    TorcIIOBus();
+
+    static TorcIIOBus*          gTorcIIOBus;
+
+    void                        Create        (const QVariantMap &Details);
+    void                        Destroy       (void);
+    void                        RemoveDevices (const QStringList &UniqueIds, QStringList &Removed);
+    QString                     AddChannel    (bool Hwmon, const QVariantMap &Details, TorcIIOListener *Listener);
+    void                        RemoveChannel (TorcIIOListener *Listener);
+
+  private:
+    QHash<QString, TorcInput*>  m_inputs;
+    QMutex                      m_devicesLock;
+    QHash<QString, TorcIIODevice*> m_devices;
+    QHash<TorcIIOListener*, QString> m_listeners;
+};
+
+class TorcIIOTemperatureInput final : public TorcTemperatureInput, public TorcIIOListener
+{
+    Q_OBJECT
+
+  public:
+    TorcIIOTemperatureInput(bool Hwmon, const QVariantMap &Details);
+    ~TorcIIOTemperatureInput();
+
+    QStringList GetDescription (void) override;
+    void        IIOValueRead   (double Value, bool Valid) override;
+
+  public slots:
+    void        Read           (double Value, bool Valid);
+
+  private:
+    bool        m_hwmon;
+    QString     m_channel;
+};
+
+class TorcIIOpHInput final : public TorcpHInput, public TorcIIOListener
+{
+    Q_OBJECT
+
+  public:
+    TorcIIOpHInput(bool Hwmon, const QVariantMap &Details);
+    ~TorcIIOpHInput();
+
+    QStringList GetDescription (void) override;
+    void        IIOValueRead   (double Value, bool Valid) override;
+
+  public slots:
+    void        Read           (double Value, bool Valid);
+
+  private:
+    bool        m_hwmon;
+    QString     m_channel;
+};
+
+#endif // TORCIIOBUS_H
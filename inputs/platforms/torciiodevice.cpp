@@ -0,0 +1,569 @@
+/* Class TorcIIODevice
+*
+* This file is part of the Torc project.
+*
+* Copyright (C) Mark Kendall 2018
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+* USA.
+*/
+
+// Qt
+#include <QDir>
+#include <QFile>
+#include <QRegularExpression>
+
+// Torc
+#include "torclogging.h"
+#include "torccoreutils.h"
+#include "torciiodevice.h"
+
+// Linux
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+
+#define IIO_BUFFER_LENGTH 128 // scans
+#define IIO_MISSED_LIMIT  3   // outputs without a sample before the value is invalid
+
+/// Read a channel attribute (e.g. in_voltage0_scale), falling back to the attribute shared by its type (in_voltage_scale).
+static double ReadChannelAttribute(const QString &Directory, const QString &Channel, const QString &Attribute, double Default)
+{
+    QString shared = Channel;
+    shared.remove(QRegularExpression(QStringLiteral("\\d+$")));
+
+    foreach (const QString &name, QStringList() << Channel << shared)
+    {
+        bool ok = false;
+        double value = TorcCoreUtils::ReadSysfsAttribute(Directory + QStringLiteral("/%1_%2").arg(name, Attribute)).toDouble(&ok);
+        if (ok)
+            return value;
+    }
+    return Default;
+}
+
+/*! \class TorcIIOChannel
+ *  \brief A single channel of an IIO device or hwmon chip.
+*/
+TorcIIOChannel::TorcIIOChannel()
+  : name(),
+    listener(nullptr),
+    processed(false),
+    scale(1.0),
+    offset(0.0),
+    units(1.0),
+    gain(1.0),
+    intercept(0.0),
+    interval(1000),
+    nextOutput(0),
+    handle(-1),
+    sum(0.0),
+    count(0),
+    missed(0),
+    index(0),
+    isSigned(false),
+    bigEndian(false),
+    bits(0),
+    storage(0),
+    shift(0),
+    location(0)
+{
+}
+
+/// Parse the format of the channel's buffered data (e.g. 'le:s12/16>>4').
+bool TorcIIOChannel::ParseType(const QByteArray &Type)
+{
+    static const QRegularExpression format(QStringLiteral("^([bl]e):([su])(\\d+)/(\\d+)(?:X\\d+)?>>(\\d+)$"));
+    QRegularExpressionMatch match = format.match(QString::fromLatin1(Type.trimmed()));
+    if (!match.hasMatch())
+        return false;
+
+    bigEndian = match.captured(1) == QStringLiteral("be");
+    isSigned  = match.captured(2) == QStringLiteral("s");
+    bits      = match.captured(3).toInt();
+    storage   = match.captured(4).toInt() / 8;
+    shift     = match.captured(5).toInt();
+    return (storage == 1 || storage == 2 || storage == 4 || storage == 8) && bits > 0 && bits <= storage * 8;
+}
+
+/// Return the raw value of this channel from a scan.
+double TorcIIOChannel::Decode(const uchar *Scan) const
+{
+    quint64 raw = 0;
+    const uchar *data = Scan + location;
+    for (int i = 0; i < storage; ++i)
+        raw |= static_cast<quint64>(data[bigEndian ? i : storage - 1 - i]) << (8 * (storage - 1 - i));
+
+    raw >>= shift;
+    if (bits < 64)
+        raw &= (Q_UINT64_C(1) << bits) - 1;
+
+    if (isSigned && bits < 64 && (raw & (Q_UINT64_C(1) << (bits - 1))))
+        return static_cast<double>(static_cast<qint64>(raw) - static_cast<qint64>(Q_UINT64_C(1) << bits));
+    return isSigned ? static_cast<double>(static_cast<qint64>(raw)) : static_cast<double>(raw);
+}
+
+/*! \class TorcIIODevice
+ *  \brief Sample the channels of a Linux IIO device (or hwmon chip) from a dedicated thread.
+ *
+ * If the device supports triggered buffers (scan_elements), the configured channels are enabled and read from the
+ * device's character device - which delivers many samples per read. Otherwise (and always for hwmon) each channel's
+ * sysfs attribute is polled at the sample rate.
+ *
+ * Samples are averaged and delivered to each channel's listener at that channel's output rate, converted to standard
+ * units (e.g. IIO millivolts to volts) and then calibrated (value * Gain + Intercept).
+ *
+ * Channels can be added or removed at any time - the thread is restarted if necessary.
+*/
+TorcIIODevice::TorcIIODevice(const QString &Directory, const QString &Character, bool Hwmon, const QString &Trigger)
+  : TorcQThread(QStringLiteral("IIO")),
+    m_directory(Directory),
+    m_character(Character),
+    m_hwmon(Hwmon),
+    m_trigger(Trigger),
+    m_lock(),
+    m_wake(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)),
+    m_buffer(-1),
+    m_buffered(false),
+    m_aborted(false),
+    m_sampleInterval(static_cast<qint64>(1000 / IIO_DEFAULT_SAMPLES)),
+    m_scanSize(0),
+    m_data(),
+    m_dataSize(0),
+    m_channels(),
+    m_clock(),
+    m_samples(0),
+    m_reads(0)
+{
+    m_clock.start();
+}
+
+TorcIIODevice::~TorcIIODevice()
+{
+    Stop();
+    if (m_wake > -1)
+        close(m_wake);
+}
+
+/*! \brief Return the directory under Root for the device Name.
+ *
+ * Name is either the directory (e.g. iio:device0 or hwmon1) or the device's name attribute (e.g. ads1015).
+*/
+QString TorcIIODevice::FindDevice(const QString &Root, const QString &Name)
+{
+    QDir root(Root);
+    if (!Name.isEmpty() && root.exists(Name))
+        return root.absoluteFilePath(Name);
+
+    foreach (const QString &entry, root.entryList(QDir::Dirs | QDir::NoDotAndDotDot | QDir::System))
+    {
+        QString directory = root.absoluteFilePath(entry);
+        if (TorcCoreUtils::ReadSysfsAttribute(directory + QStringLiteral("/name")) == Name.toLocal8Bit())
+            return directory;
+    }
+    return QString();
+}
+
+/// Return the factor to convert Channel's values to standard units (IIO and hwmon use milli-units for most types).
+double TorcIIODevice::GetUnits(const QString &Channel)
+{
+    static const QStringList milli = QStringList() << QStringLiteral("in_temp") << QStringLiteral("in_voltage")
+                                                   << QStringLiteral("in_humidityrelative") << QStringLiteral("in_current")
+                                                   << QStringLiteral("in_power") << QStringLiteral("temp")
+                                                   << QStringLiteral("humidity") << QStringLiteral("curr");
+    foreach (const QString &prefix, milli)
+        if (Channel.startsWith(prefix))
+            return 0.001;
+
+    // hwmon voltages (in0...) are millivolts and power is microwatts
+    if (Channel.contains(QRegularExpression(QStringLiteral("^in\\d"))))
+        return 0.001;
+    if (Channel.startsWith(QStringLiteral("power")))
+        return 0.000001;
+    return 1.0;
+}
+
+/// Sample Channel and report its average to Listener Rate times per second.
+bool TorcIIODevice::AddChannel(const QString &Channel, TorcIIOListener *Listener, double Rate, double Gain, double Intercept)
+{
+    if (Channel.isEmpty() || !Listener || Rate <= 0.0)
+        return false;
+
+    bool running = isRunning();
+    if (running)
+        Stop();
+
+    TorcIIOChannel channel;
+    channel.name      = Channel;
+    channel.listener  = Listener;
+    channel.units     = GetUnits(Channel);
+    channel.gain      = Gain;
+    channel.intercept = Intercept;
+    channel.interval  = qMax(static_cast<qint64>(1000.0 / Rate), (qint64)1);
+    m_channels.append(channel);
+
+    start();
+    return true;
+}
+
+/// Stop reporting to Listener. Returns true if the device has no remaining channels (and has been stopped).
+bool TorcIIODevice::RemoveChannel(TorcIIOListener *Listener)
+{
+    Stop();
+
+    for (int i = m_channels.size() - 1; i >= 0; --i)
+        if (m_channels.at(i).listener == Listener)
+            m_channels.removeAt(i);
+
+    if (m_channels.isEmpty())
+        return true;
+
+    start();
+    return false;
+}
+
+/// Set the rate at which channels are polled, if the device is not buffered.
+void TorcIIODevice::SetSampleRate(double Rate)
+{
+    if (Rate > 0.0)
+        m_sampleInterval = qMax(static_cast<qint64>(1000.0 / Rate), (qint64)1);
+}
+
+void TorcIIODevice::Stop(void)
+{
+    {
+        QMutexLocker locker(&m_lock);
+        m_aborted = true;
+        quint64 wake = 1;
+        if (m_wake > -1 && write(m_wake, &wake, sizeof(wake)) != sizeof(wake))
+            LOG(VB_GENERAL, LOG_WARNING, QStringLiteral("Failed to wake IIO thread"));
+    }
+    wait();
+
+    QMutexLocker locker(&m_lock);
+    m_aborted = false;
+}
+
+bool TorcIIODevice::IsBuffered(void)
+{
+    QMutexLocker locker(&m_lock);
+    return m_buffered;
+}
+
+quint64 TorcIIODevice::GetSampleCount(void)
+{
+    QMutexLocker locker(&m_lock);
+    return m_samples;
+}
+
+/// Return the number of reads from the device (one per sample per channel when polling).
+quint64 TorcIIODevice::GetReadCount(void)
+{
+    QMutexLocker locker(&m_lock);
+    return m_reads;
+}
+
+void TorcIIODevice::Start(void)
+{
+}
+
+void TorcIIODevice::Finish(void)
+{
+}
+
+void TorcIIODevice::run(void)
+{
+    Initialise();
+
+    qint64 now = m_clock.elapsed();
+    for (int i = 0; i < m_channels.size(); ++i)
+    {
+        TorcIIOChannel &channel = m_channels[i];
+        channel.nextOutput = now + channel.interval;
+        channel.sum        = 0.0;
+        channel.count      = 0;
+        channel.missed     = 0;
+        if (!Open(channel))
+            LOG(VB_GENERAL, LOG_ERR, QStringLiteral("Failed to open channel '%1' in '%2'").arg(channel.name, m_directory));
+    }
+
+    bool buffered = EnableBuffer();
+    {
+        QMutexLocker locker(&m_lock);
+        m_buffered = buffered;
+    }
+    LOG(VB_GENERAL, LOG_INFO, QStringLiteral("Reading %1 channels from '%2' (%3)")
+        .arg(m_channels.size()).arg(m_directory, buffered ? QStringLiteral("buffered") : QStringLiteral("polled")));
+
+    qint64 nextpoll = now;
+    bool eof = false;
+    forever
+    {
+        now = m_clock.elapsed();
+        if (!buffered && now >= nextpoll)
+        {
+            PollChannels();
+            nextpoll += m_sampleInterval;
+            if (nextpoll <= now)
+                nextpoll = now + m_sampleInterval;
+        }
+
+        Output(now);
+
+        qint64 deadline = buffered ? now + 1000 : nextpoll;
+        foreach (const TorcIIOChannel &channel, m_channels)
+            deadline = qMin(deadline, channel.nextOutput);
+
+        // NB a FIFO (or a device that has gone away) reports POLLHUP continuously after EOF - so skip it once
+        struct pollfd fds[2];
+        fds[0].fd      = m_wake;
+        fds[0].events  = POLLIN;
+        fds[0].revents = 0;
+        fds[1].fd      = m_buffer;
+        fds[1].events  = POLLIN;
+        fds[1].revents = 0;
+        nfds_t count   = (buffered && !eof) ? 2 : 1;
+        eof = false;
+
+        int result = poll(fds, count, static_cast<int>(qBound((qint64)0, deadline - now, (qint64)1000)));
+        if (result < 0 && errno != EINTR)
+        {
+            LOG(VB_GENERAL, LOG_ERR, QStringLiteral("IIO poll failed (err: %1)").arg(strerror(errno)));
+            break;
+        }
+
+        if (fds[0].revents & POLLIN)
+        {
+            quint64 wake = 0;
+            (void)read(m_wake, &wake, sizeof(wake));
+        }
+
+        {
+            QMutexLocker locker(&m_lock);
+            if (m_aborted)
+                break;
+        }
+
+        if (count > 1 && (fds[1].revents & (POLLIN | POLLHUP | POLLERR)))
+        {
+            ReadBuffer();
+            if (!(fds[1].revents & POLLIN))
+                eof = true;
+        }
+    }
+
+    DisableBuffer();
+    for (int i = 0; i < m_channels.size(); ++i)
+    {
+        if (m_channels[i].handle > -1)
+            close(m_channels[i].handle);
+        m_channels[i].handle = -1;
+    }
+
+    Deinitialise();
+}
+
+/// Open the sysfs attribute for Channel and read its scale and offset.
+bool TorcIIODevice::Open(TorcIIOChannel &Channel)
+{
+    QString input = m_directory + QStringLiteral("/%1_input").arg(Channel.name);
+    QString raw   = m_directory + QStringLiteral("/%1_raw").arg(Channel.name);
+
+    Channel.processed = m_hwmon || QFile::exists(input);
+    Channel.scale     = m_hwmon ? 1.0 : ReadChannelAttribute(m_directory, Channel.name, QStringLiteral("scale"), 1.0);
+    Channel.offset    = m_hwmon ? 0.0 : ReadChannelAttribute(m_directory, Channel.name, QStringLiteral("offset"), 0.0);
+    Channel.handle    = open((Channel.processed ? input : raw).toLocal8Bit().constData(), O_RDONLY | O_CLOEXEC);
+    return Channel.handle > -1;
+}
+
+/// Enable the device's buffer for the configured channels and open its character device.
+bool TorcIIODevice::EnableBuffer(void)
+{
+    if (m_hwmon || m_character.isEmpty() || m_channels.isEmpty())
+        return false;
+
+    QString scan = m_directory + QStringLiteral("/scan_elements/");
+    if (!QDir(scan).exists() || !QFile::exists(m_character))
+        return false;
+
+    (void)TorcCoreUtils::WriteSysfsAttribute(m_directory + QStringLiteral("/buffer/enable"), "0");
+    if (!m_trigger.isEmpty() && !TorcCoreUtils::WriteSysfsAttribute(m_directory + QStringLiteral("/trigger/current_trigger"), m_trigger.toLocal8Bit()))
+    {
+        LOG(VB_GENERAL, LOG_WARNING, QStringLiteral("Failed to set trigger '%1' for '%2'").arg(m_trigger, m_directory));
+        return false;
+    }
+
+    // disable everything else (including the timestamp), so the scan contains only our channels
+    foreach (const QString &enable, QDir(scan).entryList(QStringList(QStringLiteral("*_en")), QDir::Files))
+        (void)TorcCoreUtils::WriteSysfsAttribute(scan + enable, "0");
+
+    QList<TorcIIOChannel*> ordered;
+    for (int i = 0; i < m_channels.size(); ++i)
+    {
+        TorcIIOChannel &channel = m_channels[i];
+        bool ok = false;
+        channel.index = TorcCoreUtils::ReadSysfsAttribute(scan + channel.name + QStringLiteral("_index")).toInt(&ok);
+        if (!ok || !channel.ParseType(TorcCoreUtils::ReadSysfsAttribute(scan + channel.name + QStringLiteral("_type"))) ||
+            !TorcCoreUtils::WriteSysfsAttribute(scan + channel.name + QStringLiteral("_en"), "1"))
+        {
+            LOG(VB_GENERAL, LOG_WARNING, QStringLiteral("Channel '%1' of '%2' cannot be buffered").arg(channel.name, m_directory));
+            return false;
+        }
+
+        int position = 0;
+        while (position < ordered.size() && ordered.at(position)->index < channel.index)
+            position++;
+        ordered.insert(position, &channel);
+    }
+
+    // each value is aligned to its own size and the scan is padded to the largest
+    int size    = 0;
+    int largest = 1;
+    foreach (TorcIIOChannel *channel, ordered)
+    {
+        size = ((size + channel->storage - 1) / channel->storage) * channel->storage;
+        channel->location = size;
+        size += channel->storage;
+        largest = qMax(largest, channel->storage);
+    }
+    m_scanSize = ((size + largest - 1) / largest) * largest;
+    m_data.resize(m_scanSize * IIO_BUFFER_LENGTH);
+    m_dataSize = 0;
+
+    (void)TorcCoreUtils::WriteSysfsAttribute(m_directory + QStringLiteral("/buffer/length"), QByteArray::number(IIO_BUFFER_LENGTH * 2));
+    if (!TorcCoreUtils::WriteSysfsAttribute(m_directory + QStringLiteral("/buffer/enable"), "1"))
+    {
+        LOG(VB_GENERAL, LOG_WARNING, QStringLiteral("Failed to enable buffer for '%1'").arg(m_directory));
+        return false;
+    }
+
+    m_buffer = open(m_character.toLocal8Bit().constData(), O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+    if (m_buffer < 0)
+    {
+        LOG(VB_GENERAL, LOG_WARNING, QStringLiteral("Failed to open '%1' (err: %2)").arg(m_character).arg(strerror(errno)));
+        DisableBuffer();
+        return false;
+    }
+    return true;
+}
+
+void TorcIIODevice::DisableBuffer(void)
+{
+    if (m_buffer > -1)
+    {
+        close(m_buffer);
+        m_buffer = -1;
+        (void)TorcCoreUtils::WriteSysfsAttribute(m_directory + QStringLiteral("/buffer/enable"), "0");
+    }
+
+    QMutexLocker locker(&m_lock);
+    m_buffered = false;
+}
+
+/// Read every complete scan that is available and add each channel's value to its average.
+void TorcIIODevice::ReadBuffer(void)
+{
+    forever
+    {
+        ssize_t size = read(m_buffer, m_data.data() + m_dataSize, m_data.size() - m_dataSize);
+        if (size <= 0)
+            break;
+
+        m_dataSize += size;
+        int scans = m_dataSize / m_scanSize;
+        const uchar *data = reinterpret_cast<const uchar*>(m_data.constData());
+        for (int scan = 0; scan < scans; ++scan)
+        {
+            for (int i = 0; i < m_channels.size(); ++i)
+            {
+                TorcIIOChannel &channel = m_channels[i];
+                channel.sum += (channel.Decode(data + (scan * m_scanSize)) + channel.offset) * channel.scale;
+                channel.count++;
+            }
+        }
+
+        // keep any partial scan
+        int used = scans * m_scanSize;
+        if (used && used < m_dataSize)
+            memmove(m_data.data(), m_data.constData() + used, m_dataSize - used);
+        m_dataSize -= used;
+
+        QMutexLocker locker(&m_lock);
+        m_reads++;
+        m_samples += scans;
+    }
+}
+
+/// Read each channel's sysfs attribute once.
+void TorcIIODevice::PollChannels(void)
+{
+    int reads = 0;
+    for (int i = 0; i < m_channels.size(); ++i)
+    {
+        TorcIIOChannel &channel = m_channels[i];
+        if (channel.handle < 0)
+            continue;
+
+        char buffer[32];
+        ssize_t size = pread(channel.handle, buffer, sizeof(buffer) - 1, 0);
+        reads++;
+        if (size <= 0)
+            continue;
+        buffer[size] = 0;
+
+        bool ok = false;
+        double value = QByteArray(buffer).trimmed().toDouble(&ok);
+        if (!ok)
+            continue;
+
+        channel.sum += channel.processed ? value : (value + channel.offset) * channel.scale;
+        channel.count++;
+    }
+
+    QMutexLocker locker(&m_lock);
+    m_reads += reads;
+    m_samples++;
+}
+
+/// Deliver the average value of each channel that is due.
+void TorcIIODevice::Output(qint64 Now)
+{
+    for (int i = 0; i < m_channels.size(); ++i)
+    {
+        TorcIIOChannel &channel = m_channels[i];
+        if (Now < channel.nextOutput)
+            continue;
+
+        channel.nextOutput += channel.interval;
+        if (channel.nextOutput <= Now)
+            channel.nextOutput = Now + channel.interval;
+
+        if (channel.count)
+        {
+            double value = (channel.sum / channel.count) * channel.units;
+            channel.listener->IIOValueRead((value * channel.gain) + channel.intercept, true);
+            channel.sum    = 0.0;
+            channel.count  = 0;
+            channel.missed = 0;
+        }
+        else if (++channel.missed == IIO_MISSED_LIMIT)
+        {
+            channel.listener->IIOValueRead(0.0, false);
+        }
+    }
+}
@@ -0,0 +1,118 @@
+#ifndef TORCIIODEVICE_H
+#define TORCIIODEVICE_H
+
+// Qt
+#include <QList>
+#include <QMutex>
+#include <QElapsedTimer>
+
+// Torc
+#include "torcqthread.h"
+
+#define IIO_DIRECTORY       QStringLiteral("/sys/bus/iio/devices")
+#define IIO_DEV_DIRECTORY   QStringLiteral("/dev")
+#define HWMON_DIRECTORY     QStringLiteral("/sys/class/hwmon")
+#define IIO_DEFAULT_RATE    1.0  // outputs per second
+#define IIO_DEFAULT_SAMPLES 10.0 // samples per second when polling
+
+class TorcIIOListener
+{
+  public:
+    TorcIIOListener() = default;
+    virtual ~TorcIIOListener() = default;
+
+    /// A new (averaged) value, in standard units (e.g. volts or degrees Celsius). Called from the device thread.
+    virtual void    IIOValueRead (double Value, bool Valid) = 0;
+
+  private:
+    Q_DISABLE_COPY(TorcIIOListener)
+};
+
+class TorcIIOChannel
+{
+  public:
+    TorcIIOChannel();
+
+    bool            ParseType     (const QByteArray &Type);
+    double          Decode        (const uchar *Scan) const;
+
+  public:
+    QString         name;
+    TorcIIOListener *listener;
+    bool            processed;
+    double          scale;
+    double          offset;
+    double          units;
+    double          gain;
+    double          intercept;
+    qint64          interval;
+    qint64          nextOutput;
+    int             handle;
+    double          sum;
+    quint64         count;
+    int             missed;
+    int             index;
+    bool            isSigned;
+    bool            bigEndian;
+    int             bits;
+    int             storage;
+    int             shift;
+    int             location;
+};
+
+class TorcIIODevice final : public TorcQThread
+{
+    Q_OBJECT
+
+  public:
+    TorcIIODevice(const QString &Directory, const QString &Character, bool Hwmon, const QString &Trigger = QString());
+   ~TorcIIODevice();
+
+    static QString  FindDevice    (const QString &Root, const QString &Name);
+    static double   GetUnits      (const QString &Channel);
+
+    bool            AddChannel    (const QString &Channel, TorcIIOListener *Listener, double Rate = IIO_DEFAULT_RATE,
+                                   double Gain = 1.0, double Intercept = 0.0);
+    bool            RemoveChannel (TorcIIOListener *Listener);
+    void            SetSampleRate (double Rate);
+    void            Stop          (void);
+    bool            IsBuffered    (void);
+    quint64         GetSampleCount(void);
+    quint64         GetReadCount  (void);
+
+    void            Start         (void) override;
+    void            Finish        (void) override;
+
+  protected:
+    void            run           (void) override;
+
+  private:
+    bool            Open          (TorcIIOChannel &Channel);
+    bool            EnableBuffer  (void);
+    void            DisableBuffer (void);
+    void            ReadBuffer    (void);
+    void            PollChannels  (void);
+    void            Output        (qint64 Now);
+
+  private:
+    Q_DISABLE_COPY(TorcIIODevice)
+    QString         m_directory;
+    QString         m_character;
+    bool            m_hwmon;
+    QString         m_trigger;
+    QMutex          m_lock;
+    int             m_wake;
+    int             m_buffer;
+    bool            m_buffered;
+    bool            m_aborted;
+    qint64          m_sampleInterval;
+    int             m_scanSize;
+    QByteArray      m_data;
+    int             m_dataSize;
+    QList<TorcIIOChannel> m_channels;
+    QElapsedTimer   m_clock;
+    quint64         m_samples;
+    quint64         m_reads;
+};
+
+#endif // TORCIIODEVICE_H
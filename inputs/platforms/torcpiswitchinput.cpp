@@ -20,6 +20,9 @@
 * USA.
 */
 
+// Qt
+#include <QFile>
+
 // Torc
 #include "torclogging.h"
 #include "torcpigpio.h"
@@ -28,49 +31,58 @@
 // wiringPi
 #include "wiringPi.h"
 
-#include <unistd.h>
-#include <poll.h>
-#include <fcntl.h>
-#include <sys/ioctl.h>
-
 #define DEFAULT_VALUE 0
 
-TorcPiSwitchInputThread::TorcPiSwitchInputThread(TorcPiSwitchInput *Parent, int Pin)
-  : TorcQThread(QStringLiteral("GPIOInput%1").arg(Pin)),
-    m_parent(Parent),
+/*! \class TorcPiSwitchInput
+ *  \brief A GPIO pin used as a switch input.
+ *
+ * The pin is exported through sysfs and monitored (with all other GPIO inputs) by TorcGPIOEvents.
+*/
+TorcPiSwitchInput::TorcPiSwitchInput(int Pin, const QVariantMap &Details)
+  : TorcSwitchInput(DEFAULT_VALUE, QStringLiteral("PiGPIOSwitchInput"), Details),
+    TorcGPIOListener(),
     m_pin(Pin),
-    m_aborted(false),
-    m_file(QStringLiteral("/sys/class/gpio/gpio%1/value").arg(wpiPinToGpio(Pin)))
+    m_line(nullptr)
 {
-    connect(this, &TorcPiSwitchInputThread::Changed, m_parent, &TorcPiSwitchInput::SetValue);
 }
 
-void TorcPiSwitchInputThread::Finish(void)
+TorcPiSwitchInput::~TorcPiSwitchInput()
 {
-    // close input file
-    m_file.close();
-
-    // unexport the pin. There shouldn't be anything else using it
-    QFile unexport(QStringLiteral("/sys/class/gpio/unexport"));
-    if (unexport.open(QIODevice::WriteOnly))
+    if (m_line)
     {
-        QByteArray pin = QByteArray::number(wpiPinToGpio(m_pin));
-        pin.append("\n");
-        if (unexport.write(pin) > -1)
-            LOG(VB_GENERAL, LOG_INFO, QStringLiteral("Unexported pin %1").arg(m_pin));
+        TorcGPIOEvents::GetGPIOEvents()->RemoveLine(m_line);
+        delete m_line;
+        m_line = nullptr;
+        Unexport();
+    }
+}
 
-        unexport.close();
+void TorcPiSwitchInput::Start(void)
+{
+    // start listening for interrupts here...
+    if (!m_line && Export())
+    {
+        m_line = new TorcGPIOSysfsLine(QStringLiteral("/sys/class/gpio/gpio%1/value").arg(wpiPinToGpio(m_pin)));
+        if (TorcGPIOEvents::GetGPIOEvents()->AddLine(m_line, this))
+            LOG(VB_GENERAL, LOG_INFO, QStringLiteral("Pin %1 input setup complete").arg(m_pin));
     }
+
+    // and call the default implementation
+    TorcSwitchInput::Start();
+}
+
+QStringList TorcPiSwitchInput::GetDescription(void)
+{
+    return QStringList() << tr("Pin %1 Switch").arg(m_pin);
 }
 
-void TorcPiSwitchInputThread::Update(void)
+void TorcPiSwitchInput::GPIOValueChanged(int Value)
 {
-    int value = digitalRead(m_pin);
-    emit Changed((double)value);
-    LOG(VB_GENERAL, LOG_INFO, QString::number(value));
+    SetValue((double)Value);
 }
 
-void TorcPiSwitchInputThread::Start(void)
+/// Export the pin through sysfs as an input that signals both edges.
+bool TorcPiSwitchInput::Export(void)
 {
     // disable any internall pull up/down resistors
     pullUpDnControl(m_pin, PUD_OFF);
@@ -81,7 +93,7 @@ void TorcPiSwitchInputThread::Start(void)
     if (!export1.open(QIODevice::WriteOnly))
     {
         LOG(VB_GENERAL, LOG_ERR, QStringLiteral("Failed to open '%1' for writing").arg(export1.fileName()));
-        return;
+        return false;
     }
 
     QByteArray pin = QByteArray::number(bcmpin);
@@ -90,7 +102,7 @@ void TorcPiSwitchInputThread::Start(void)
     {
         LOG(VB_GENERAL, LOG_ERR, QStringLiteral("Failed to write to '%1'").arg(export1.fileName()));
         export1.close();
-        return;
+        return false;
     }
     export1.close();
     LOG(VB_GENERAL, LOG_INFO, QStringLiteral("Exported pin %1").arg(m_pin));
@@ -99,7 +111,7 @@ void TorcPiSwitchInputThread::Start(void)
     if (!direction.open(QIODevice::WriteOnly))
     {
         LOG(VB_GENERAL, LOG_ERR, QStringLiteral("Failed to open '%1' for writing").arg(direction.fileName()));
-        return;
+        return false;
     }
 
     QByteArray dir("in\n");
@@ -107,7 +119,7 @@ void TorcPiSwitchInputThread::Start(void)
     {
         LOG(VB_GENERAL, LOG_ERR, QStringLiteral("Failed to write to '%1'").arg(direction.fileName()));
         direction.close();
-        return;
+        return false;
     }
     direction.close();
     LOG(VB_GENERAL, LOG_INFO, QStringLiteral("Pin %1 set as input").arg(m_pin));
@@ -116,7 +128,7 @@ void TorcPiSwitchInputThread::Start(void)
     if (!edge.open(QIODevice::WriteOnly))
     {
         LOG(VB_GENERAL, LOG_ERR, QStringLiteral("Failed to open '%1' for writing").arg(edge.fileName()));
-        return;
+        return false;
     }
 
     QByteArray both("both\n");
@@ -124,110 +136,23 @@ void TorcPiSwitchInputThread::Start(void)
     {
         LOG(VB_GENERAL, LOG_ERR, QStringLiteral("Failed to write to '%1'").arg(edge.fileName()));
         edge.close();
-        return;
+        return false;
     }
     edge.close();
-
-    // and finally, open the pin value for monitoring
-    if (!m_file.open(QIODevice::ReadWrite))
-    {
-        LOG(VB_GENERAL, LOG_ERR, QStringLiteral("Failed to open '%1' to monitor GPIO input (err: %2)")
-            .arg(m_file.fileName()).arg(strerror(errno)));
-    }
-    else
-    {
-        LOG(VB_GENERAL, LOG_INFO, QStringLiteral("Pin %1 input setup complete").arg(m_pin));
-    }
+    return true;
 }
 
-void TorcPiSwitchInputThread::run(void)
+void TorcPiSwitchInput::Unexport(void)
 {
-    Initialise();
-
-    if (m_file.isOpen())
+    // unexport the pin. There shouldn't be anything else using it
+    QFile unexport(QStringLiteral("/sys/class/gpio/unexport"));
+    if (unexport.open(QIODevice::WriteOnly))
     {
-        int count;
-        quint8 c;
-
-        // clear any pending interrupts    
-        ioctl(m_file.handle(), FIONREAD, &count);
-        for (int i = 0; i < count; i++)
-            read(m_file.handle(), &c, 1);
-        lseek(m_file.handle(), 0, SEEK_SET);
-
-        // read the initial state
-        Update();
-
-        while (!m_aborted)
-        {
-            struct pollfd polls;
-            polls.fd = m_file.handle();
-            polls.events = POLLPRI;
-
-            // 10ms timeout - reasonable?
-            int res = poll(&polls, 1, 10);
-        
-            if (res == 0)
-            {
-                continue; // timeout
-            }
-            else if (res < 0)
-            {
-                LOG(VB_GENERAL, LOG_ERR, QStringLiteral("Poll failed for '%1' (err: %2)")
-                    .arg(m_file.fileName()).arg(strerror(errno)));
-                continue;
-            }
-            else
-            {
-                // clear the interrupt
-                (void)read(m_file.handle(), &c, 1);
-                lseek(m_file.handle(), 0, SEEK_SET);
-
-                // read the value
-                Update();
-
-                // crude debounce handling
-                // wait 20ms before polling again
-                msleep(20);
-            }    
-        }
-    }
-
-    Deinitialise();
-}
-
-void TorcPiSwitchInputThread::Stop(void)
-{
-    m_aborted = true;
-}
-
-TorcPiSwitchInput::TorcPiSwitchInput(int Pin, const QVariantMap &Details)
-  : TorcSwitchInput(DEFAULT_VALUE, QStringLiteral("PiGPIOSwitchInput"), Details),
-    m_pin(Pin),
-    m_inputThread(new TorcPiSwitchInputThread(this, m_pin))
-{
-}
-
-TorcPiSwitchInput::~TorcPiSwitchInput()
-{
-    m_inputThread->Stop();
-    m_inputThread->quit();
-    m_inputThread->wait();
-    delete m_inputThread;
-}
-
-void TorcPiSwitchInput::Start(void)
-{
-    // start listening for interrupts here...
-    m_inputThread->start();
-
-    // and call the default implementation
-    TorcSwitchInput::Start();
-}
+        QByteArray pin = QByteArray::number(wpiPinToGpio(m_pin));
+        pin.append("\n");
+        if (unexport.write(pin) > -1)
+            LOG(VB_GENERAL, LOG_INFO, QStringLiteral("Unexported pin %1").arg(m_pin));
 
-QStringList TorcPiSwitchInput::GetDescription(void)
-{
-    return QStringList() << tr("Pin %1 Switch").arg(m_pin);
+        unexport.close();
+    }
 }
-
-
@@ -23,6 +23,7 @@
 // Torc
 #include "torclogging.h"
 #include "torccoreutils.h"
+#include "torcclock.h"
 #include "torcinputs.h"
 #include "torcinput.h"
 
@@ -34,6 +35,10 @@
  * TorcInput implements a generic input and handles high level signalling of changes to the input's status
  * and/or value.
  *
+ * Changes to the value can be filtered (deadband, hysteresis and minimum interval) before they are signalled,
+ * using the input's optional <filter> configuration. See TorcInputFilterChain. A value held back by the minimum
+ * interval filter is published when the interval has passed, unless the input has changed again in the meantime.
+ *
  * \note Both TorcInput and TorcHTTPService can be accessed from multiple threads. Locking is essential
  *       around non-constant member variables.
 */
@@ -47,8 +52,14 @@ TorcInput::TorcInput(TorcInput::Type Type, double Value, double RangeMinimum, do
     operatingRangeMin(RangeMinimum),
     operatingRangeMax(RangeMaximum),
     outOfRangeLow(true),
-    outOfRangeHigh(false)
+    outOfRangeHigh(false),
+    filters(Details),
+    filterTimer()
 {
+    // held values are published from the input's thread
+    filterTimer.setSingleShot(true);
+    connect(&filterTimer, &QTimer::timeout, this, &TorcInput::ReleaseFilteredValue);
+
     // guard against stupidity
     if (operatingRangeMax <= operatingRangeMin)
     {
@@ -95,6 +106,7 @@ void TorcInput::SetValue(double Value)
     if (!valid)
     {
         SetValid(true);
+        filters.Reset();
     }
     else
     {
@@ -102,14 +114,29 @@ void TorcInput::SetValue(double Value)
         if (wasInvalid)
         {
             wasInvalid = false;
+            filters.Reset();
         }
         else
         {
             if (qFuzzyCompare(Value + 1.0f, value + 1.0f))
+            {
+                filters.ClearHeld();
                 return;
+            }
         }
     }
 
+    // suppress jitter before anything is signalled
+    if (!filters.Filter(Value, value))
+    {
+        // timers cannot be started from other threads
+        double held = 0.0;
+        qint64 until = 0;
+        if (filters.GetHeld(held, until))
+            QMetaObject::invokeMethod(this, "StartFilterTimer", Qt::QueuedConnection, Q_ARG(qint64, until));
+        return;
+    }
+
     // update value and valueScaled
     value = Value;
     emit ValueChanged(value);
@@ -144,8 +171,12 @@ void TorcInput::SetValid(bool Valid)
 {
     QMutexLocker locker(&lock);
 
+    // the default value is never filtered
     if (!Valid)
+    {
+        filters.Reset();
         SetValue(defaultValue);
+    }
 
     TorcDevice::SetValid(Valid);
 }
@@ -175,3 +206,38 @@ bool TorcInput::GetOutOfRangeHigh(void)
 
     return outOfRangeHigh;
 }
+
+void TorcInput::StartFilterTimer(qint64 Until)
+{
+    if (filterTimer.isActive())
+        return;
+    filterTimer.start(static_cast<int>(qMax(Until - TorcClock::Elapsed(), (qint64)0)));
+}
+
+/// Publish the value held back by the input's filters, if it is still current.
+void TorcInput::ReleaseFilteredValue(void)
+{
+    QMutexLocker locker(&lock);
+
+    double held = 0.0;
+    qint64 until = 0;
+    if (!filters.GetHeld(held, until))
+        return;
+
+    if (until > TorcClock::Elapsed())
+    {
+        StartFilterTimer(until);
+        return;
+    }
+
+    // N.B. bypass any subclass behaviour (e.g. buttons) - the held value has already been through it
+    TorcInput::SetValue(held);
+}
+
+/// Return the number of value updates that were accepted and suppressed by the input's filters.
+QVariantMap TorcInput::GetFilterStatistics(void)
+{
+    QMutexLocker locker(&lock);
+
+    return filters.GetStatistics();
+}
@@ -3,11 +3,13 @@
 
 // Qt
 #include <QMutex>
+#include <QTimer>
 #include <QObject>
 
 // Torc
 #include "http/torchttpservice.h"
 #include "torcdevice.h"
+#include "torcinputfilter.h"
 
 #define INPUTS_DIRECTORY QStringLiteral("inputs")
 
@@ -63,12 +65,19 @@ class TorcInput : public TorcDevice, public TorcHTTPService
     double           GetOperatingRangeMax      (void);
     bool             GetOutOfRangeLow          (void);
     bool             GetOutOfRangeHigh         (void);
+    QVariantMap      GetFilterStatistics       (void);
+
+  private slots:
+    void             StartFilterTimer          (qint64 Until);
+    void             ReleaseFilteredValue      (void);
 
   protected:
     double           operatingRangeMin;
     double           operatingRangeMax;
     bool             outOfRangeLow;
     bool             outOfRangeHigh;
+    TorcInputFilterChain filters;
+    QTimer           filterTimer;
 };
 
 #endif // TORCINPUT_H
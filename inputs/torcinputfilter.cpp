@@ -0,0 +1,316 @@
+/* Class TorcInputFilter
+*
+* This file is part of the Torc project.
+*
+* Copyright (C) Mark Kendall 2018
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+* USA.
+*/
+
+// Torc
+#include "torclogging.h"
+#include "torcclock.h"
+#include "torcinputfilter.h"
+
+// std
+#include <cmath>
+
+/*! \class TorcInputFilter
+ *  \brief A filter that decides whether a new input value should be published.
+*/
+void TorcInputFilter::Accepted(double Value, double Last, qint64 Now)
+{
+    (void)Value;
+    (void)Last;
+    (void)Now;
+}
+
+void TorcInputFilter::Reset(double Value, qint64 Now)
+{
+    (void)Value;
+    (void)Now;
+}
+
+qint64 TorcInputFilter::HoldUntil(qint64 Now) const
+{
+    (void)Now;
+    return -1;
+}
+
+/*! \class TorcDeadbandFilter
+ *  \brief Ignore changes smaller than the deadband.
+*/
+TorcDeadbandFilter::TorcDeadbandFilter(double Deadband)
+  : TorcInputFilter(),
+    m_deadband(Deadband)
+{
+}
+
+QString TorcDeadbandFilter::GetName(void) const
+{
+    return QStringLiteral("deadband");
+}
+
+bool TorcDeadbandFilter::Accept(double Value, double Last, qint64 Now)
+{
+    (void)Now;
+    return std::fabs(Value - Last) >= m_deadband;
+}
+
+/*! \class TorcHysteresisFilter
+ *  \brief Ignore small changes that reverse the direction of the last change.
+ *
+ * A value that continues in the same direction as the last accepted change is always accepted, so a slowly
+ * rising (or falling) value is tracked closely. A change of direction must exceed the hysteresis - which
+ * stops a value that is sat on a quantisation boundary (e.g. a 1Wire sensor toggling by 0.0625) from
+ * flip-flopping.
+*/
+TorcHysteresisFilter::TorcHysteresisFilter(double Hysteresis)
+  : TorcInputFilter(),
+    m_hysteresis(Hysteresis),
+    m_direction(0)
+{
+}
+
+QString TorcHysteresisFilter::GetName(void) const
+{
+    return QStringLiteral("hysteresis");
+}
+
+bool TorcHysteresisFilter::Accept(double Value, double Last, qint64 Now)
+{
+    (void)Now;
+    int direction = Value > Last ? 1 : -1;
+    if (m_direction != 0 && direction == m_direction)
+        return true;
+    return std::fabs(Value - Last) >= m_hysteresis;
+}
+
+void TorcHysteresisFilter::Accepted(double Value, double Last, qint64 Now)
+{
+    (void)Now;
+    m_direction = Value > Last ? 1 : Value < Last ? -1 : 0;
+}
+
+void TorcHysteresisFilter::Reset(double Value, qint64 Now)
+{
+    (void)Value;
+    (void)Now;
+    m_direction = 0;
+}
+
+/*! \class TorcMinimumIntervalFilter
+ *  \brief Ignore changes that follow the last accepted change too quickly.
+ *
+ * The most recent suppressed value is held and should be published once the interval has passed - otherwise an
+ * edge driven input (e.g. a GPIO switch) that changes state within the interval would never report its final state.
+*/
+TorcMinimumIntervalFilter::TorcMinimumIntervalFilter(qint64 Interval)
+  : TorcInputFilter(),
+    m_interval(Interval),
+    m_last(0)
+{
+}
+
+QString TorcMinimumIntervalFilter::GetName(void) const
+{
+    return QStringLiteral("mininterval");
+}
+
+bool TorcMinimumIntervalFilter::Accept(double Value, double Last, qint64 Now)
+{
+    (void)Value;
+    (void)Last;
+    return Now - m_last >= m_interval;
+}
+
+void TorcMinimumIntervalFilter::Accepted(double Value, double Last, qint64 Now)
+{
+    (void)Value;
+    (void)Last;
+    m_last = Now;
+}
+
+void TorcMinimumIntervalFilter::Reset(double Value, qint64 Now)
+{
+    (void)Value;
+    m_last = Now;
+}
+
+qint64 TorcMinimumIntervalFilter::HoldUntil(qint64 Now) const
+{
+    (void)Now;
+    return m_last + m_interval;
+}
+
+/*! \class TorcInputFilterChain
+ *  \brief An ordered list of input filters with counts of suppressed updates.
+ *
+ * A value must pass every filter to be published. The first value after the chain is created or reset
+ * (e.g. when the input becomes valid or invalid) is always accepted.
+ *
+ * Filters are created from the input's optional <filter> element:
+ *
+ * \code
+ * <filter>
+ *   <deadband>0.05</deadband>        <!-- ignore changes smaller than 0.05 -->
+ *   <hysteresis>0.1</hysteresis>     <!-- ignore reversals smaller than 0.1 -->
+ *   <mininterval>5000</mininterval>  <!-- publish at most one change every 5 seconds -->
+ * </filter>
+ * \endcode
+ *
+ * A value suppressed by a filter that holds values (see TorcInputFilter::HoldUntil) is retained and GetHeld
+ * reports it, with the time it is due, until another value is filtered. The owner should re-submit it when due.
+ *
+ * Times are measured with TorcClock::Elapsed.
+ *
+ * \note The chain is not thread safe - the owner must lock.
+*/
+TorcInputFilterChain::TorcInputFilterChain(const QVariantMap &Details)
+  : m_filters(),
+    m_counts(),
+    m_reset(true),
+    m_held(false),
+    m_heldValue(0.0),
+    m_heldUntil(0),
+    m_accepted(0),
+    m_suppressed(0)
+{
+    if (!Details.contains(INPUT_FILTER))
+        return;
+
+    QVariantMap filter = Details.value(INPUT_FILTER).toMap();
+    bool ok = false;
+    double deadband = filter.value(QStringLiteral("deadband")).toString().toDouble(&ok);
+    if (ok && deadband > 0.0)
+        AddFilter(new TorcDeadbandFilter(deadband));
+
+    double hysteresis = filter.value(QStringLiteral("hysteresis")).toString().toDouble(&ok);
+    if (ok && hysteresis > 0.0)
+        AddFilter(new TorcHysteresisFilter(hysteresis));
+
+    qint64 interval = filter.value(QStringLiteral("mininterval")).toString().toLongLong(&ok);
+    if (ok && interval > 0)
+        AddFilter(new TorcMinimumIntervalFilter(interval));
+
+    if (IsEmpty())
+        LOG(VB_GENERAL, LOG_WARNING, QStringLiteral("Input '%1' has an empty filter").arg(Details.value(QStringLiteral("name")).toString()));
+}
+
+TorcInputFilterChain::~TorcInputFilterChain()
+{
+    qDeleteAll(m_filters);
+}
+
+/// Add Filter to the end of the chain. The chain takes ownership.
+void TorcInputFilterChain::AddFilter(TorcInputFilter *Filter)
+{
+    if (!Filter)
+        return;
+    m_filters.append(Filter);
+    m_counts.append(0);
+}
+
+bool TorcInputFilterChain::IsEmpty(void) const
+{
+    return m_filters.isEmpty();
+}
+
+bool TorcInputFilterChain::Filter(double Value, double Last)
+{
+    return Filter(Value, Last, TorcClock::Elapsed());
+}
+
+/// Return true if Value should replace Last at time Now (in milliseconds).
+bool TorcInputFilterChain::Filter(double Value, double Last, qint64 Now)
+{
+    m_held = false;
+
+    if (m_reset)
+    {
+        m_reset = false;
+        foreach (TorcInputFilter *filter, m_filters)
+            filter->Reset(Value, Now);
+        m_accepted++;
+        return true;
+    }
+
+    for (int i = 0; i < m_filters.size(); ++i)
+    {
+        if (!m_filters.at(i)->Accept(Value, Last, Now))
+        {
+            m_counts[i]++;
+            m_suppressed++;
+            qint64 until = m_filters.at(i)->HoldUntil(Now);
+            if (until >= 0)
+            {
+                m_held      = true;
+                m_heldValue = Value;
+                m_heldUntil = until;
+            }
+            return false;
+        }
+    }
+
+    foreach (TorcInputFilter *filter, m_filters)
+        filter->Accepted(Value, Last, Now);
+    m_accepted++;
+    return true;
+}
+
+/// Accept the next value unconditionally.
+void TorcInputFilterChain::Reset(void)
+{
+    m_reset = true;
+    m_held  = false;
+}
+
+/// Return true if the last value was suppressed but should be re-submitted at time Until.
+bool TorcInputFilterChain::GetHeld(double &Value, qint64 &Until) const
+{
+    if (!m_held)
+        return false;
+    Value = m_heldValue;
+    Until = m_heldUntil;
+    return true;
+}
+
+/// Discard any held value (e.g. the input has returned to the last accepted value).
+void TorcInputFilterChain::ClearHeld(void)
+{
+    m_held = false;
+}
+
+quint64 TorcInputFilterChain::GetAccepted(void) const
+{
+    return m_accepted;
+}
+
+quint64 TorcInputFilterChain::GetSuppressed(void) const
+{
+    return m_suppressed;
+}
+
+/// Return the number of accepted and suppressed updates, and the number suppressed by each filter.
+QVariantMap TorcInputFilterChain::GetStatistics(void) const
+{
+    QVariantMap result;
+    result.insert(QStringLiteral("accepted"), m_accepted);
+    result.insert(QStringLiteral("suppressed"), m_suppressed);
+    for (int i = 0; i < m_filters.size(); ++i)
+        result.insert(m_filters.at(i)->GetName(), m_counts.at(i));
+    return result;
+}
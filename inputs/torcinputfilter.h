@@ -0,0 +1,102 @@
+#ifndef TORCINPUTFILTER_H
+#define TORCINPUTFILTER_H
+
+// Qt
+#include <QList>
+#include <QVariant>
+
+#define INPUT_FILTER QStringLiteral("filter")
+
+class TorcInputFilter
+{
+  public:
+    TorcInputFilter() = default;
+    virtual ~TorcInputFilter() = default;
+
+    virtual QString GetName  (void) const = 0;
+    /// Return true if Value should replace Last (the last value that was accepted).
+    virtual bool    Accept   (double Value, double Last, qint64 Now) = 0;
+    /// Value has replaced Last.
+    virtual void    Accepted (double Value, double Last, qint64 Now);
+    /// Value was accepted unconditionally (the first value or following a reset).
+    virtual void    Reset    (double Value, qint64 Now);
+    /// Return the time at which a suppressed value should be published, or -1 if it is dropped.
+    virtual qint64  HoldUntil(qint64 Now) const;
+
+  private:
+    Q_DISABLE_COPY(TorcInputFilter)
+};
+
+class TorcDeadbandFilter final : public TorcInputFilter
+{
+  public:
+    explicit TorcDeadbandFilter(double Deadband);
+
+    QString GetName  (void) const override;
+    bool    Accept   (double Value, double Last, qint64 Now) override;
+
+  private:
+    double  m_deadband;
+};
+
+class TorcHysteresisFilter final : public TorcInputFilter
+{
+  public:
+    explicit TorcHysteresisFilter(double Hysteresis);
+
+    QString GetName  (void) const override;
+    bool    Accept   (double Value, double Last, qint64 Now) override;
+    void    Accepted (double Value, double Last, qint64 Now) override;
+    void    Reset    (double Value, qint64 Now) override;
+
+  private:
+    double  m_hysteresis;
+    int     m_direction;
+};
+
+class TorcMinimumIntervalFilter final : public TorcInputFilter
+{
+  public:
+    explicit TorcMinimumIntervalFilter(qint64 Interval);
+
+    QString GetName  (void) const override;
+    bool    Accept   (double Value, double Last, qint64 Now) override;
+    void    Accepted (double Value, double Last, qint64 Now) override;
+    void    Reset    (double Value, qint64 Now) override;
+    qint64  HoldUntil(qint64 Now) const override;
+
+  private:
+    qint64  m_interval;
+    qint64  m_last;
+};
+
+class TorcInputFilterChain
+{
+  public:
+    explicit TorcInputFilterChain(const QVariantMap &Details = QVariantMap());
+   ~TorcInputFilterChain();
+
+    void        AddFilter     (TorcInputFilter *Filter);
+    bool        IsEmpty       (void) const;
+    bool        Filter        (double Value, double Last);
+    bool        Filter        (double Value, double Last, qint64 Now);
+    void        Reset         (void);
+    bool        GetHeld       (double &Value, qint64 &Until) const;
+    void        ClearHeld     (void);
+    quint64     GetAccepted   (void) const;
+    quint64     GetSuppressed (void) const;
+    QVariantMap GetStatistics (void) const;
+
+  private:
+    Q_DISABLE_COPY(TorcInputFilterChain)
+    QList<TorcInputFilter*> m_filters;
+    QList<quint64>          m_counts;
+    bool                    m_reset;
+    bool                    m_held;
+    double                  m_heldValue;
+    qint64                  m_heldUntil;
+    quint64                 m_accepted;
+    quint64                 m_suppressed;
+};
+
+#endif // TORCINPUTFILTER_H
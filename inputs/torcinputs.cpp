@@ -20,11 +20,18 @@
 * USA.
 */
 
+// Qt
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QDataStream>
+#include <QtNumeric>
+
 // Torc
 #include "torclogging.h"
 #include "torccoreutils.h"
 #include "torcadminthread.h"
 #include "torccentral.h"
+#include "torccontrols.h"
 #include "torcnetworkpwminput.h"
 #include "torcnetworkswitchinput.h"
 #include "torcnetworktemperatureinput.h"
@@ -47,6 +54,9 @@ TorcInputs* TorcInputs::gInputs = new TorcInputs();
  *
  * It also creates and manages known network (i.e. user set) and constant inputs.
  *
+ * Network inputs can be set in bulk with SetInputValues, using JSON-RPC or an HTTP POST/PUT
+ * to services/inputs/SetInputValues. See ParseInputValues for the accepted formats.
+ *
  * \code
  *
  * <torc>
@@ -80,7 +90,9 @@ TorcInputs::TorcInputs()
     TorcDeviceHandler(),
     inputList(),
     inputTypes(),
-    m_createdInputs()
+    m_createdInputs(),
+    m_batchLock(),
+    m_lastTimestamps()
 {
 }
 
@@ -157,6 +169,228 @@ QStringList TorcInputs::GetInputTypes(void)
     return TorcCoreUtils::EnumList<TorcInput::Type>();
 }
 
+/*! \brief Set the value of multiple network inputs.
+ *
+ * Values is a list of entries of the form {"uniqueId": "temp1", "value": 20.5, "timestamp": 1530000000000},
+ * where the timestamp (milliseconds since the epoch) is optional. A JSON string containing the list is also
+ * accepted.
+ *
+ * Entries are validated first and only the latest value for each input is used. An entry with a timestamp that
+ * is not later than the last value applied to the input is ignored (e.g. a delayed or repeated request).
+ * The remaining values are then applied together and control propagation is held until every value has been
+ * applied - so controls see the batch as a single change.
+ *
+ * Returns the number of values applied, the number of stale entries and any errors.
+*/
+QVariantMap TorcInputs::SetInputValues(const QVariant &Values)
+{
+    QVariantMap result;
+    QVariantList errors;
+    QVariantList entries;
+
+    if (Values.type() == QVariant::String || Values.type() == QVariant::ByteArray)
+    {
+        QString error;
+        if (!ParseInputValues(Values.toByteArray(), false, entries, error))
+            errors.append(error);
+    }
+    else
+    {
+        entries = Values.toList();
+    }
+
+    QMutexLocker batch(&m_batchLock);
+    QReadLocker locker(&m_httpServiceLock);
+
+    QHash<QString,TorcInput*> inputs;
+    foreach (TorcInput *input, inputList)
+        inputs.insert(input->GetUniqueId(), input);
+
+    // validate and keep the latest value for each input
+    QList<TorcInput*> order;
+    QHash<TorcInput*,QPair<double,qint64> > latest;
+    int stale = 0;
+    for (int i = 0; i < entries.size(); ++i)
+    {
+        QVariantMap entry = entries.at(i).toMap();
+        QString uniqueid  = entry.value(QStringLiteral("uniqueId")).toString();
+        TorcInput *input  = inputs.value(uniqueid);
+        if (!input)
+        {
+            errors.append(QStringLiteral("Entry %1: unknown input '%2'").arg(i).arg(uniqueid));
+            continue;
+        }
+
+        if (!input->GetModelId().startsWith(QStringLiteral("Network")))
+        {
+            errors.append(QStringLiteral("Entry %1: input '%2' is not a network input").arg(i).arg(uniqueid));
+            continue;
+        }
+
+        bool ok = false;
+        double value = entry.value(QStringLiteral("value")).toDouble(&ok);
+        if (!ok || !qIsFinite(value))
+        {
+            errors.append(QStringLiteral("Entry %1: invalid value for '%2'").arg(i).arg(uniqueid));
+            continue;
+        }
+
+        qint64 timestamp = entry.value(QStringLiteral("timestamp")).toLongLong();
+        if (timestamp > 0 && (timestamp <= m_lastTimestamps.value(uniqueid) ||
+                              (latest.contains(input) && timestamp < latest.value(input).second)))
+        {
+            stale++;
+            continue;
+        }
+
+        if (!latest.contains(input))
+            order.append(input);
+        latest.insert(input, qMakePair(value, timestamp));
+    }
+
+    // apply in a single pass
+    TorcControls::gControls->HoldPropagation();
+    foreach (TorcInput *input, order)
+    {
+        QPair<double,qint64> value = latest.value(input);
+        input->SetValue(value.first);
+        if (value.second > 0)
+            m_lastTimestamps.insert(input->GetUniqueId(), value.second);
+    }
+    TorcControls::gControls->ReleasePropagation();
+
+    result.insert(QStringLiteral("applied"), order.size());
+    result.insert(QStringLiteral("stale"), stale);
+    result.insert(QStringLiteral("errors"), errors);
+    return result;
+}
+
+/*! \brief Decode a batch of input values for SetInputValues.
+ *
+ * JSON is either a list of entries or an object with a 'values' list. The binary format, intended for
+ * constrained clients, is (all values big endian):
+ *
+ * \code
+ * quint8   version (1)
+ * quint8   flags (0x01 entries have timestamps, 0x02 values are doubles rather than floats)
+ * quint16  number of entries
+ * and, for each entry:
+ * quint8   length of uniqueId
+ * char[]   uniqueId (UTF-8)
+ * float    value (or double)
+ * qint64   timestamp (milliseconds since the epoch - if flagged)
+ * \endcode
+*/
+bool TorcInputs::ParseInputValues(const QByteArray &Data, bool Binary, QVariantList &Values, QString &Error)
+{
+    Values.clear();
+
+    if (!Binary)
+    {
+        QJsonParseError error;
+        QJsonDocument document = QJsonDocument::fromJson(Data, &error);
+        if (error.error != QJsonParseError::NoError)
+        {
+            Error = QStringLiteral("Invalid JSON (%1)").arg(error.errorString());
+            return false;
+        }
+
+        if (document.isArray())
+            Values = document.toVariant().toList();
+        else if (document.isObject() && document.object().value(QStringLiteral("values")).isArray())
+            Values = document.object().value(QStringLiteral("values")).toVariant().toList();
+        else
+            Error = QStringLiteral("Expected a list of values");
+        return Error.isEmpty();
+    }
+
+    QDataStream stream(Data);
+    stream.setByteOrder(QDataStream::BigEndian);
+    quint8  version = 0;
+    quint8  flags   = 0;
+    quint16 count   = 0;
+    stream >> version >> flags >> count;
+    if (stream.status() != QDataStream::Ok || version != 1)
+    {
+        Error = QStringLiteral("Invalid header");
+        return false;
+    }
+
+    bool timestamps = flags & 0x01;
+    stream.setFloatingPointPrecision(flags & 0x02 ? QDataStream::DoublePrecision : QDataStream::SinglePrecision);
+    for (int i = 0; i < count; ++i)
+    {
+        quint8 length = 0;
+        stream >> length;
+        QByteArray id(length, '\0');
+        if (stream.readRawData(id.data(), length) != length)
+        {
+            Error = QStringLiteral("Entry %1 is truncated").arg(i);
+            return false;
+        }
+
+        double value     = 0.0;
+        qint64 timestamp = 0;
+        stream >> value;
+        if (timestamps)
+            stream >> timestamp;
+        if (stream.status() != QDataStream::Ok)
+        {
+            Error = QStringLiteral("Entry %1 is truncated").arg(i);
+            return false;
+        }
+
+        QVariantMap entry;
+        entry.insert(QStringLiteral("uniqueId"), QString::fromUtf8(id));
+        entry.insert(QStringLiteral("value"), value);
+        if (timestamps)
+            entry.insert(QStringLiteral("timestamp"), timestamp);
+        Values.append(entry);
+    }
+
+    if (!stream.atEnd())
+    {
+        Error = QStringLiteral("Unexpected data after %1 entries").arg(count);
+        return false;
+    }
+    return true;
+}
+
+/*! \brief Handle bulk updates sent as the body of a POST or PUT request.
+ *
+ * The body is JSON unless the Content-Type is application/octet-stream. Other requests are handled
+ * as normal.
+*/
+void TorcInputs::ProcessHTTPRequest(const QString &PeerAddress, int PeerPort, const QString &LocalAddress,
+                                    int LocalPort, TorcHTTPRequest &Request)
+{
+    HTTPRequestType type = Request.GetHTTPRequestType();
+    if (Request.GetMethod() == QStringLiteral("SetInputValues") && (type == HTTPPost || type == HTTPPut) &&
+        !Request.GetContent().isEmpty())
+    {
+        if (!MethodIsAuthorised(Request, HTTPPost | HTTPPut | HTTPAuth))
+            return;
+
+        bool binary = Request.Headers().value(QStringLiteral("Content-Type"))
+                        .startsWith(QStringLiteral("application/octet-stream"), Qt::CaseInsensitive);
+        QVariantList values;
+        QString error;
+        if (!ParseInputValues(Request.GetContent(), binary, values, error))
+        {
+            LOG(VB_GENERAL, LOG_ERR, QStringLiteral("Failed to parse input values from %1 (%2)").arg(PeerAddress, error));
+            Request.SetStatus(HTTP_BadRequest);
+            Request.SetResponseType(HTTPResponseDefault);
+            return;
+        }
+
+        Request.Serialise(SetInputValues(values), QStringLiteral("result"));
+        Request.SetStatus(HTTP_OK);
+        return;
+    }
+
+    TorcHTTPService::ProcessHTTPRequest(PeerAddress, PeerPort, LocalAddress, LocalPort, Request);
+}
+
 void TorcInputs::AddInput(TorcInput *Input)
 {
     QWriteLocker locker(&m_httpServiceLock);
@@ -280,3 +514,19 @@ void TorcInputs::Destroy()
     }
     m_createdInputs.clear();
 }
+
+void TorcInputs::RemoveDevices(const QStringList &UniqueIds, QStringList &Removed)
+{
+    QWriteLocker locker(&m_handlerLock);
+
+    foreach (const QString &uniqueid, UniqueIds)
+    {
+        TorcInput *input = m_createdInputs.take(uniqueid);
+        if (input)
+        {
+            input->DownRef();
+            RemoveInput(input);
+            Removed.append(uniqueid);
+        }
+    }
+}
@@ -3,6 +3,7 @@
 
 // Qt
 #include <QList>
+#include <QHash>
 #include <QMutex>
 
 // Torc
@@ -15,11 +16,13 @@ class TorcInputs final : public QObject, public TorcHTTPService, public TorcDevi
     Q_OBJECT
     Q_CLASSINFO("Version",        "1.0.0")
     Q_CLASSINFO("GetInputList",   "type=inputs")
+    Q_CLASSINFO("SetInputValues", "methods=PUT&POST&AUTH")
     Q_PROPERTY(QVariantMap inputList   READ GetInputList() NOTIFY InputsChanged())
     Q_PROPERTY(QStringList inputTypes  READ GetInputTypes() CONSTANT)
 
   public:
     static TorcInputs* gInputs;
+    static bool         ParseInputValues         (const QByteArray &Data, bool Binary, QVariantList &Values, QString &Error);
 
   public:
     TorcInputs();
@@ -27,10 +30,13 @@ class TorcInputs final : public QObject, public TorcHTTPService, public TorcDevi
 
     void                Graph                    (QByteArray* Data);
     QString             GetUIName                (void) override;
+    void                ProcessHTTPRequest       (const QString &PeerAddress, int PeerPort, const QString &LocalAddress,
+                                                  int LocalPort, TorcHTTPRequest &Request) override;
 
     // TorcDeviceHandler
     void                Create                   (const QVariantMap &Details) override;
     void                Destroy                  (void) override;
+    void                RemoveDevices            (const QStringList &UniqueIds, QStringList &Removed) override;
 
   public slots:
     // TorcHTTPService
@@ -38,6 +44,7 @@ class TorcInputs final : public QObject, public TorcHTTPService, public TorcDevi
 
     QVariantMap         GetInputList             (void);
     QStringList         GetInputTypes            (void);
+    QVariantMap         SetInputValues           (const QVariant &Values);
 
   signals:
     void                InputsChanged            (void);
@@ -50,6 +57,8 @@ class TorcInputs final : public QObject, public TorcHTTPService, public TorcDevi
     QList<TorcInput*>   inputList;
     QStringList         inputTypes;
     QMap<QString,TorcInput*> m_createdInputs;
+    QMutex              m_batchLock;
+    QHash<QString,qint64> m_lastTimestamps;
 };
 
 #endif // TORCINPUTS_H
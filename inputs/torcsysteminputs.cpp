@@ -83,3 +83,19 @@ void TorcSystemInputs::Destroy(void)
     }
     m_inputs.clear();
 }
+
+void TorcSystemInputs::RemoveDevices(const QStringList &UniqueIds, QStringList &Removed)
+{
+    QWriteLocker locker(&m_handlerLock);
+
+    foreach (const QString &uniqueid, UniqueIds)
+    {
+        TorcInput *input = m_inputs.take(uniqueid);
+        if (input)
+        {
+            input->DownRef();
+            TorcInputs::gInputs->RemoveInput(input);
+            Removed.append(uniqueid);
+        }
+    }
+}
@@ -16,6 +16,7 @@ class TorcSystemInputs final : public TorcDeviceHandler
 
     void                     Create      (const QVariantMap &Details) override;
     void                     Destroy     (void) override;
+    void                     RemoveDevices (const QStringList &UniqueIds, QStringList &Removed) override;
 
   private:
     QMap<QString,TorcInput*> m_inputs;
@@ -0,0 +1,362 @@
+/* Class TorcMQTTBridge
+*
+* This file is part of the Torc project.
+*
+* Copyright (C) Mark Kendall 2018
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+* USA.
+*/
+
+// Qt
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QtNumeric>
+
+// Torc
+#include "torclogging.h"
+#include "torcmqttbridge.h"
+
+/*! \class TorcMQTTBridge
+ *  \brief Map MQTT topics onto network inputs and publish device values to an MQTT broker.
+ *
+ * Each <input> in <subscribe> maps a topic onto a network input. The topic must match exactly (wildcards are not
+ * supported) so that an incoming message is routed with a single hash lookup. Payloads may be a number, on/off,
+ * true/false or a JSON object with a 'value'.
+ *
+ * The value of each <device> in <publish> is published to <prefix>/<device> whenever it changes, and again when
+ * the connection is (re)established. The bridge itself publishes 'online' to <prefix>/<name> and registers
+ * 'offline' as its will. The value of the bridge device is 1 when connected to the broker.
+ *
+ * \code
+ * <mqtt>
+ *   <bridge>
+ *     <name>mqtt</name>
+ *     <host>192.168.1.2</host>
+ *     <subscribe>
+ *       <input><topic>garden/temperature</topic><device>gardentemp</device></input>
+ *     </subscribe>
+ *     <publish><device>heating</device></publish>
+ *   </bridge>
+ * </mqtt>
+ * \endcode
+ *
+ * \sa TorcMQTTClient
+*/
+TorcMQTTBridge::TorcMQTTBridge(const QVariantMap &Details)
+  : TorcDevice(false, 0, 0, QStringLiteral("MQTTBridge"), Details),
+    m_parsed(false),
+    m_started(false),
+    m_client(nullptr),
+    m_host(Details.value(QStringLiteral("host")).toString().trimmed()),
+    m_port(Details.value(QStringLiteral("port"), MQTT_DEFAULT_PORT).toInt()),
+    m_prefix(Details.value(QStringLiteral("prefix"), MQTT_DEFAULT_PREFIX).toString().trimmed()),
+    m_qos(qBound(0, Details.value(QStringLiteral("qos"), 1).toInt(), 2)),
+    m_retain(true),
+    m_subscriptions(),
+    m_publish(),
+    m_inputs(),
+    m_outputs()
+{
+    if (m_host.isEmpty())
+    {
+        LOG(VB_GENERAL, LOG_ERR, QStringLiteral("MQTT bridge '%1' has no host").arg(uniqueId));
+        return;
+    }
+
+    if (Details.contains(QStringLiteral("retain")))
+    {
+        QString retain = Details.value(QStringLiteral("retain")).toString().trimmed();
+        m_retain = retain == QStringLiteral("true") || retain == QStringLiteral("1");
+    }
+
+    // NB clean session is not used, so the client id must be stable
+    QString clientid = Details.value(QStringLiteral("clientid"), QStringLiteral("torc-%1").arg(uniqueId)).toString().trimmed();
+    m_client = new TorcMQTTClient(m_host, (quint16)m_port, clientid,
+                                  Details.value(QStringLiteral("keepalive"), MQTT_DEFAULT_KEEPALIVE).toInt(),
+                                  Details.value(QStringLiteral("inflight"), MQTT_DEFAULT_INFLIGHT).toInt());
+    m_client->SetCredentials(Details.value(QStringLiteral("user")).toString().trimmed(),
+                             Details.value(QStringLiteral("password")).toString());
+    m_client->SetWill(QStringLiteral("%1/%2").arg(m_prefix, uniqueId), QByteArrayLiteral("offline"), true);
+
+    QVariantMap subscribe = Details.value(QStringLiteral("subscribe")).toMap();
+    QVariantMap::const_iterator it = subscribe.constBegin();
+    for ( ; it != subscribe.constEnd(); ++it)
+    {
+        if (it.key() != QStringLiteral("input"))
+            continue;
+
+        QVariantMap input = it.value().toMap();
+        QString topic  = input.value(QStringLiteral("topic")).toString().trimmed();
+        QString device = input.value(QStringLiteral("device")).toString().trimmed();
+        if (topic.isEmpty() || device.isEmpty() || topic.contains('+') || topic.contains('#'))
+        {
+            LOG(VB_GENERAL, LOG_ERR, QStringLiteral("MQTT bridge '%1' has invalid input (topic '%2' device '%3')")
+                .arg(uniqueId, topic, device));
+            return;
+        }
+        if (m_subscriptions.contains(topic))
+        {
+            LOG(VB_GENERAL, LOG_ERR, QStringLiteral("MQTT bridge '%1' has duplicate topic '%2'").arg(uniqueId, topic));
+            return;
+        }
+        m_subscriptions.insert(topic, device);
+        m_client->AddSubscription(topic, input.value(QStringLiteral("qos"), 1).toInt());
+    }
+
+    QVariantMap publish = Details.value(QStringLiteral("publish")).toMap();
+    for (it = publish.constBegin(); it != publish.constEnd(); ++it)
+        if (it.key() == QStringLiteral("device"))
+            m_publish.append(it.value().toString().trimmed());
+    m_publish.removeDuplicates();
+
+    connect(m_client, &TorcMQTTClient::Connected,       this, &TorcMQTTBridge::Connected);
+    connect(m_client, &TorcMQTTClient::Disconnected,    this, &TorcMQTTBridge::Disconnected);
+    connect(m_client, &TorcMQTTClient::MessageReceived, this, &TorcMQTTBridge::MessageReceived);
+    m_parsed = true;
+}
+
+TorcMQTTBridge::~TorcMQTTBridge()
+{
+    delete m_client;
+}
+
+/// Convert an incoming payload to a value. Returns false if the payload is not understood.
+bool TorcMQTTBridge::ParsePayload(const QByteArray &Payload, double &Value)
+{
+    QByteArray payload = Payload.trimmed();
+    bool ok = false;
+    double value = payload.toDouble(&ok);
+    if (ok && qIsFinite(value))
+    {
+        Value = value;
+        return true;
+    }
+
+    QByteArray lower = payload.toLower();
+    if (lower == "on" || lower == "true")
+    {
+        Value = 1.0;
+        return true;
+    }
+    if (lower == "off" || lower == "false")
+    {
+        Value = 0.0;
+        return true;
+    }
+
+    QJsonDocument document = QJsonDocument::fromJson(payload);
+    if (document.isObject() && document.object().value(QStringLiteral("value")).isDouble())
+    {
+        Value = document.object().value(QStringLiteral("value")).toDouble();
+        return true;
+    }
+    return false;
+}
+
+bool TorcMQTTBridge::IsParsed(void) const
+{
+    return m_parsed;
+}
+
+QStringList TorcMQTTBridge::GetDescription(void)
+{
+    QStringList result;
+    result.append(tr("MQTT %1:%2").arg(m_host).arg(m_port));
+    result.append(tr("%1 subscriptions").arg(m_subscriptions.size()));
+    result.append(tr("%1 published").arg(m_publish.size()));
+    return result;
+}
+
+/*! \brief Find the mapped devices and connect to the broker.
+ *
+ * \note Called from TorcCentral with the device list locked.
+*/
+void TorcMQTTBridge::Start(void)
+{
+    QMutexLocker locker(&lock);
+    if (!m_parsed || m_started)
+        return;
+
+    {
+        QMutexLocker devicelocker(gDeviceListLock);
+
+        QHash<QString,QString>::const_iterator it = m_subscriptions.constBegin();
+        for ( ; it != m_subscriptions.constEnd(); ++it)
+        {
+            TorcDevice *device = gDeviceList->value(it.value());
+            if (!device || !device->GetModelId().startsWith(QStringLiteral("Network")))
+            {
+                LOG(VB_GENERAL, LOG_ERR, QStringLiteral("MQTT bridge '%1': '%2' is not a network input")
+                    .arg(uniqueId, it.value()));
+                continue;
+            }
+            m_inputs.insert(it.key(), device);
+        }
+
+        foreach (const QString &output, m_publish)
+        {
+            TorcDevice *device = gDeviceList->value(output);
+            if (!device)
+            {
+                LOG(VB_GENERAL, LOG_ERR, QStringLiteral("MQTT bridge '%1': failed to find '%2'").arg(uniqueId, output));
+                continue;
+            }
+
+            QString topic = QStringLiteral("%1/%2").arg(m_prefix, output);
+            m_outputs.insert(device, topic);
+            connect(device, &TorcDevice::ValueChanged, this, [this, topic](double Value) { PublishValue(topic, Value); });
+        }
+    }
+
+    m_started = true;
+    SetValid(true);
+    SetValue(0);
+    m_client->Start();
+}
+
+void TorcMQTTBridge::Stop(void)
+{
+    {
+        QMutexLocker locker(&lock);
+        if (m_started)
+        {
+            m_started = false;
+            QHash<TorcDevice*,QString>::const_iterator it = m_outputs.constBegin();
+            for ( ; it != m_outputs.constEnd(); ++it)
+                disconnect(it.key(), nullptr, this, nullptr);
+            m_outputs.clear();
+            m_inputs.clear();
+            if (m_client)
+                m_client->Stop();
+        }
+    }
+
+    TorcDevice::Stop();
+}
+
+/// Announce ourselves and bring subscribers up to date. Changes made while disconnected were coalesced anyway.
+void TorcMQTTBridge::Connected(bool SessionPresent)
+{
+    (void)SessionPresent;
+    QMutexLocker locker(&lock);
+    if (!m_started)
+        return;
+
+    m_client->PublishMessage(QStringLiteral("%1/%2").arg(m_prefix, uniqueId), QByteArrayLiteral("online"), m_qos, true);
+    QHash<TorcDevice*,QString>::const_iterator it = m_outputs.constBegin();
+    for ( ; it != m_outputs.constEnd(); ++it)
+        if (it.key()->GetValid())
+            m_client->PublishMessage(it.value(), QByteArray::number(it.key()->GetValue(), 'g', 10), m_qos, m_retain);
+    SetValue(1);
+}
+
+void TorcMQTTBridge::Disconnected(void)
+{
+    SetValue(0);
+}
+
+void TorcMQTTBridge::MessageReceived(const QString &Topic, const QByteArray &Payload)
+{
+    QMutexLocker locker(&lock);
+    TorcDevice *input = m_inputs.value(Topic);
+    if (!input)
+        return;
+
+    double value = 0.0;
+    if (!ParsePayload(Payload, value))
+    {
+        LOG(VB_GENERAL, LOG_WARNING, QStringLiteral("MQTT bridge '%1': ignoring '%2' from '%3'")
+            .arg(uniqueId, QString::fromUtf8(Payload.left(32)), Topic));
+        return;
+    }
+    input->SetValue(value);
+}
+
+/// Queue the new value - the client publishes everything queued in a single write on the next event loop pass.
+void TorcMQTTBridge::PublishValue(const QString &Topic, double Value)
+{
+    QMutexLocker locker(&lock);
+    if (m_started)
+        m_client->PublishMessage(Topic, QByteArray::number(Value, 'g', 10), m_qos, m_retain);
+}
+
+TorcMQTT* TorcMQTT::gMQTT = new TorcMQTT();
+
+TorcMQTT::TorcMQTT()
+  : TorcDeviceHandler(),
+    m_bridges()
+{
+}
+
+void TorcMQTT::Create(const QVariantMap &Details)
+{
+    QWriteLocker locker(&m_handlerLock);
+
+    QVariantMap mqtt = Details.value(QStringLiteral("mqtt")).toMap();
+    QVariantMap::const_iterator it = mqtt.constBegin();
+    for ( ; it != mqtt.constEnd(); ++it)
+    {
+        if (it.key() != QStringLiteral("bridge"))
+            continue;
+
+        QVariantMap details = it.value().toMap();
+        if (!details.contains(QStringLiteral("name")))
+        {
+            LOG(VB_GENERAL, LOG_ERR, QStringLiteral("MQTT bridge has no name"));
+            continue;
+        }
+
+        TorcMQTTBridge *bridge = new TorcMQTTBridge(details);
+        if (!bridge->IsParsed())
+        {
+            bridge->DownRef();
+            continue;
+        }
+
+        m_bridges.append(bridge);
+        LOG(VB_GENERAL, LOG_INFO, QStringLiteral("New MQTT bridge '%1'").arg(bridge->GetUniqueId()));
+    }
+}
+
+void TorcMQTT::Destroy(void)
+{
+    QWriteLocker locker(&m_handlerLock);
+    foreach (TorcMQTTBridge *bridge, m_bridges)
+    {
+        bridge->Stop();
+        bridge->DownRef();
+    }
+    m_bridges.clear();
+}
+
+void TorcMQTT::RemoveDevices(const QStringList &UniqueIds, QStringList &Removed)
+{
+    QWriteLocker locker(&m_handlerLock);
+
+    QMutableListIterator<TorcMQTTBridge*> it(m_bridges);
+    while (it.hasNext())
+    {
+        TorcMQTTBridge *bridge = it.next();
+        QString uniqueid = bridge->GetUniqueId();
+        if (UniqueIds.contains(uniqueid))
+        {
+            bridge->Stop();
+            bridge->DownRef();
+            it.remove();
+            Removed.append(uniqueid);
+        }
+    }
+}
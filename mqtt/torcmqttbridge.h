@@ -0,0 +1,70 @@
+#ifndef TORCMQTTBRIDGE_H
+#define TORCMQTTBRIDGE_H
+
+// Qt
+#include <QHash>
+
+// Torc
+#include "torcdevice.h"
+#include "torcdevicehandler.h"
+#include "torcmqttclient.h"
+
+#define MQTT_DEFAULT_PREFIX QStringLiteral("torc")
+
+class TorcMQTTBridge final : public TorcDevice
+{
+    Q_OBJECT
+
+  public:
+    explicit TorcMQTTBridge(const QVariantMap &Details);
+
+    static bool     ParsePayload     (const QByteArray &Payload, double &Value);
+
+    bool            IsParsed         (void) const;
+    QStringList     GetDescription   (void) override;
+    void            Start            (void) override;
+    void            Stop             (void) override;
+
+  public slots:
+    void            Connected        (bool SessionPresent);
+    void            Disconnected     (void);
+    void            MessageReceived  (const QString &Topic, const QByteArray &Payload);
+
+  protected:
+    ~TorcMQTTBridge();
+
+  private:
+    void            PublishValue     (const QString &Topic, double Value);
+
+  private:
+    Q_DISABLE_COPY(TorcMQTTBridge)
+    bool            m_parsed;
+    bool            m_started;
+    TorcMQTTClient *m_client;
+    QString         m_host;
+    int             m_port;
+    QString         m_prefix;
+    int             m_qos;
+    bool            m_retain;
+    QHash<QString,QString>     m_subscriptions; // topic -> device
+    QStringList                m_publish;
+    QHash<QString,TorcDevice*> m_inputs;        // topic -> network input
+    QHash<TorcDevice*,QString> m_outputs;       // device -> topic
+};
+
+class TorcMQTT : public TorcDeviceHandler
+{
+  public:
+    TorcMQTT();
+
+    static TorcMQTT*        gMQTT;
+
+    void                    Create        (const QVariantMap &Details) override;
+    void                    Destroy       (void) override;
+    void                    RemoveDevices (const QStringList &UniqueIds, QStringList &Removed) override;
+
+  private:
+    QList<TorcMQTTBridge*>  m_bridges;
+};
+
+#endif // TORCMQTTBRIDGE_H
@@ -0,0 +1,596 @@
+/* Class TorcMQTTClient
+*
+* This file is part of the Torc project.
+*
+* Copyright (C) Mark Kendall 2018
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+* USA.
+*/
+
+// Torc
+#include "torclogging.h"
+#include "torcmqttclient.h"
+
+/*! \class TorcMQTTClient
+ *  \brief A minimal MQTT 3.1.1 client.
+ *
+ * The client connects with a persistent session (clean session is not set) and reconnects, with an increasing
+ * delay, whenever the connection is lost. Unacknowledged QoS 1 and 2 messages are resent when the session is
+ * resumed and subscriptions are only renewed if the broker has lost the session.
+ *
+ * Published messages are queued and written together, in a single socket write, on the next pass of the event loop.
+ * A message for a topic that is still queued replaces the queued message (i.e. topics carry state, not events).
+ * No more than InFlight QoS 1/2 messages await acknowledgement at any time - further messages remain queued until
+ * the broker catches up. QoS 0 messages are not held back.
+ *
+ * \note The client is not thread safe and must be used from the thread it lives in.
+*/
+TorcMQTTClient::TorcMQTTClient(const QString &Host, quint16 Port, const QString &ClientId, int KeepAlive, int InFlight)
+  : QObject(),
+    m_host(Host),
+    m_port(Port),
+    m_clientId(ClientId),
+    m_keepAlive(qBound(0, KeepAlive, 65535)),
+    m_inFlightWindow(qBound(1, InFlight, 65535)),
+    m_user(),
+    m_password(),
+    m_willTopic(),
+    m_willPayload(),
+    m_willRetain(false),
+    m_socket(nullptr),
+    m_readBuffer(),
+    m_running(false),
+    m_connected(false),
+    m_flushPending(false),
+    m_pingOutstanding(false),
+    m_keepAliveTimer(),
+    m_reconnectTimer(),
+    m_reconnectMin(MQTT_RECONNECT_MIN),
+    m_reconnectMax(MQTT_RECONNECT_MAX),
+    m_reconnectDelay(MQTT_RECONNECT_MIN),
+    m_nextPacketId(0),
+    m_subscriptions(),
+    m_pending(),
+    m_pendingOrder(),
+    m_inFlight(),
+    m_received(),
+    m_writes(0),
+    m_published(0),
+    m_coalesced(0)
+{
+    m_reconnectTimer.setSingleShot(true);
+    connect(&m_reconnectTimer, &QTimer::timeout, this, &TorcMQTTClient::Reconnect);
+    connect(&m_keepAliveTimer, &QTimer::timeout, this, &TorcMQTTClient::KeepAliveTimeout);
+}
+
+TorcMQTTClient::~TorcMQTTClient()
+{
+    Stop();
+}
+
+/// Frame Body as an MQTT control packet with the fixed header byte Header.
+QByteArray TorcMQTTClient::EncodePacket(quint8 Header, const QByteArray &Body)
+{
+    QByteArray result;
+    result.reserve(Body.size() + 5);
+    result.append((char)Header);
+    int length = Body.size();
+    do
+    {
+        quint8 byte = length % 128;
+        length /= 128;
+        if (length > 0)
+            byte |= 0x80;
+        result.append((char)byte);
+    } while (length > 0);
+    result.append(Body);
+    return result;
+}
+
+/// Append String to Data as a length prefixed MQTT string.
+void TorcMQTTClient::AppendString(QByteArray &Data, const QByteArray &String)
+{
+    Data.append((char)((String.size() >> 8) & 0xff));
+    Data.append((char)(String.size() & 0xff));
+    Data.append(String);
+}
+
+/*! \brief Remove the first complete control packet from Buffer.
+ *
+ * Returns false if Buffer does not contain a complete packet, setting Error if the remaining length is malformed.
+*/
+bool TorcMQTTClient::TakePacket(QByteArray &Buffer, quint8 &Header, QByteArray &Body, bool &Error)
+{
+    Error = false;
+    if (Buffer.size() < 2)
+        return false;
+
+    int length     = 0;
+    int multiplier = 1;
+    int position   = 1;
+    forever
+    {
+        if (position >= Buffer.size())
+            return false;
+        quint8 byte = (quint8)Buffer.at(position++);
+        length += (byte & 0x7f) * multiplier;
+        if (!(byte & 0x80))
+            break;
+        if (position > 4)
+        {
+            Error = true;
+            return false;
+        }
+        multiplier *= 128;
+    }
+
+    if (Buffer.size() < position + length)
+        return false;
+
+    Header = (quint8)Buffer.at(0);
+    Body   = Buffer.mid(position, length);
+    Buffer.remove(0, position + length);
+    return true;
+}
+
+void TorcMQTTClient::SetCredentials(const QString &User, const QString &Password)
+{
+    m_user     = User;
+    m_password = Password;
+}
+
+/// Set the message the broker publishes if the connection is lost without a DISCONNECT.
+void TorcMQTTClient::SetWill(const QString &Topic, const QByteArray &Payload, bool Retain)
+{
+    m_willTopic   = Topic;
+    m_willPayload = Payload;
+    m_willRetain  = Retain;
+}
+
+void TorcMQTTClient::SetReconnectDelay(int Minimum, int Maximum)
+{
+    m_reconnectMin   = qMax(1, Minimum);
+    m_reconnectMax   = qMax(m_reconnectMin, Maximum);
+    m_reconnectDelay = m_reconnectMin;
+}
+
+void TorcMQTTClient::AddSubscription(const QString &Topic, int QoS)
+{
+    m_subscriptions.insert(Topic, qBound(0, QoS, 2));
+    if (m_connected)
+    {
+        QByteArray body = EncodeId(NextPacketId());
+        AppendString(body, Topic.toUtf8());
+        body.append((char)m_subscriptions.value(Topic));
+        Write(EncodePacket((Subscribe << 4) | 0x02, body));
+    }
+}
+
+/// Queue a message for the next flush. Safe to call when disconnected.
+void TorcMQTTClient::PublishMessage(const QString &Topic, const QByteArray &Payload, int QoS, bool Retain)
+{
+    Message message { Topic, Payload, qBound(0, QoS, 2), Retain, false };
+    if (m_pending.contains(Topic))
+        m_coalesced++;
+    else
+        m_pendingOrder.append(Topic);
+    m_pending.insert(Topic, message);
+    ScheduleFlush();
+}
+
+bool TorcMQTTClient::IsConnected(void) const
+{
+    return m_connected;
+}
+
+int TorcMQTTClient::GetInFlight(void) const
+{
+    return m_inFlight.size();
+}
+
+int TorcMQTTClient::GetQueued(void) const
+{
+    return m_pendingOrder.size();
+}
+
+/// The number of socket writes - each write may contain many packets.
+quint64 TorcMQTTClient::GetWrites(void) const
+{
+    return m_writes;
+}
+
+quint64 TorcMQTTClient::GetPublished(void) const
+{
+    return m_published;
+}
+
+/// The number of queued messages replaced by a newer message for the same topic.
+quint64 TorcMQTTClient::GetCoalesced(void) const
+{
+    return m_coalesced;
+}
+
+void TorcMQTTClient::Start(void)
+{
+    if (m_running)
+        return;
+
+    if (!m_socket)
+    {
+        m_socket = new QTcpSocket(this);
+        connect(m_socket, &QTcpSocket::connected,    this, &TorcMQTTClient::SocketConnected);
+        connect(m_socket, &QTcpSocket::disconnected, this, &TorcMQTTClient::SocketDisconnected);
+        connect(m_socket, &QTcpSocket::readyRead,    this, &TorcMQTTClient::ReadyRead);
+        connect(m_socket, static_cast<void (QAbstractSocket::*)(QAbstractSocket::SocketError)>(&QAbstractSocket::error),
+                this, &TorcMQTTClient::SocketError);
+    }
+
+    m_running = true;
+    m_reconnectDelay = m_reconnectMin;
+    Reconnect();
+}
+
+/// Disconnect cleanly. Queued and unacknowledged messages are retained should the client be restarted.
+void TorcMQTTClient::Stop(void)
+{
+    if (!m_running)
+        return;
+
+    m_running = false;
+    m_reconnectTimer.stop();
+    m_keepAliveTimer.stop();
+
+    bool wasconnected = m_connected;
+    m_connected = false;
+    if (m_socket)
+    {
+        if (wasconnected)
+        {
+            Write(EncodePacket(Disconnect << 4, QByteArray()));
+            m_socket->flush();
+        }
+        m_socket->disconnectFromHost();
+    }
+}
+
+void TorcMQTTClient::Reconnect(void)
+{
+    if (!m_running || !m_socket || m_socket->state() != QAbstractSocket::UnconnectedState)
+        return;
+
+    LOG(VB_GENERAL, LOG_INFO, QStringLiteral("Connecting to MQTT broker %1:%2").arg(m_host).arg(m_port));
+    m_socket->connectToHost(m_host, m_port);
+}
+
+void TorcMQTTClient::ScheduleReconnect(void)
+{
+    if (!m_running || m_reconnectTimer.isActive())
+        return;
+
+    LOG(VB_GENERAL, LOG_INFO, QStringLiteral("Reconnecting to MQTT broker in %1ms").arg(m_reconnectDelay));
+    m_reconnectTimer.start(m_reconnectDelay);
+    m_reconnectDelay = qMin(m_reconnectDelay * 2, m_reconnectMax);
+}
+
+void TorcMQTTClient::SocketConnected(void)
+{
+    m_readBuffer.clear();
+    m_pingOutstanding = false;
+
+    QByteArray will  = m_willTopic.toUtf8();
+    QByteArray user  = m_user.toUtf8();
+    quint8     flags = 0; // clean session is not set
+    if (!will.isEmpty())
+        flags |= 0x04 | (m_willRetain ? 0x20 : 0x00);
+    if (!user.isEmpty())
+        flags |= 0x80 | (m_password.isEmpty() ? 0x00 : 0x40);
+
+    QByteArray body;
+    AppendString(body, QByteArrayLiteral("MQTT"));
+    body.append((char)4); // 3.1.1
+    body.append((char)flags);
+    body.append((char)((m_keepAlive >> 8) & 0xff));
+    body.append((char)(m_keepAlive & 0xff));
+    AppendString(body, m_clientId.toUtf8());
+    if (!will.isEmpty())
+    {
+        AppendString(body, will);
+        AppendString(body, m_willPayload);
+    }
+    if (!user.isEmpty())
+    {
+        AppendString(body, user);
+        if (!m_password.isEmpty())
+            AppendString(body, m_password.toUtf8());
+    }
+    Write(EncodePacket(Connect << 4, body));
+}
+
+void TorcMQTTClient::SocketDisconnected(void)
+{
+    bool wasconnected = m_connected;
+    m_connected = false;
+    m_keepAliveTimer.stop();
+    if (wasconnected)
+    {
+        LOG(VB_GENERAL, LOG_WARNING, QStringLiteral("Lost connection to MQTT broker %1:%2").arg(m_host).arg(m_port));
+        emit Disconnected();
+    }
+    ScheduleReconnect();
+}
+
+void TorcMQTTClient::SocketError(QAbstractSocket::SocketError Error)
+{
+    if (QAbstractSocket::RemoteHostClosedError != Error && m_running)
+        LOG(VB_GENERAL, LOG_ERR, QStringLiteral("MQTT socket error %1 '%2'").arg(Error).arg(m_socket->errorString()));
+
+    // a failed connection attempt does not signal disconnected
+    if (m_socket->state() == QAbstractSocket::UnconnectedState)
+        ScheduleReconnect();
+}
+
+void TorcMQTTClient::ReadyRead(void)
+{
+    m_readBuffer.append(m_socket->readAll());
+
+    quint8 header = 0;
+    QByteArray body;
+    bool error = false;
+    while (m_socket->state() == QAbstractSocket::ConnectedState && TakePacket(m_readBuffer, header, body, error))
+        HandlePacket(header, body);
+
+    if (error)
+    {
+        LOG(VB_GENERAL, LOG_ERR, QStringLiteral("Malformed packet from MQTT broker - disconnecting"));
+        m_readBuffer.clear();
+        m_socket->abort();
+    }
+}
+
+void TorcMQTTClient::HandlePacket(quint8 Header, const QByteArray &Body)
+{
+    int type = Header >> 4;
+    quint16 id = Body.size() >= 2 ? (quint16)(((quint8)Body.at(0) << 8) | (quint8)Body.at(1)) : 0;
+
+    switch (type)
+    {
+        case ConnAck:
+        {
+            if (Body.size() < 2 || Body.at(1) != 0)
+            {
+                LOG(VB_GENERAL, LOG_ERR, QStringLiteral("MQTT broker refused connection (%1)").arg(Body.size() < 2 ? -1 : Body.at(1)));
+                m_socket->abort();
+                return;
+            }
+
+            bool sessionpresent = Body.at(0) & 0x01;
+            LOG(VB_GENERAL, LOG_INFO, QStringLiteral("Connected to MQTT broker %1:%2 (%3 session)")
+                .arg(m_host).arg(m_port).arg(sessionpresent ? QStringLiteral("resumed") : QStringLiteral("new")));
+            m_connected      = true;
+            m_reconnectDelay = m_reconnectMin;
+            if (m_keepAlive > 0)
+                m_keepAliveTimer.start(m_keepAlive * 1000);
+
+            if (!sessionpresent)
+                SendSubscriptions();
+
+            // resend anything unacknowledged. If the session was lost, a QoS 2 message that was received but
+            // not completed has nevertheless been delivered - so drop it rather than publish it again.
+            QByteArray data;
+            QMutableMapIterator<quint16,Message> it(m_inFlight);
+            while (it.hasNext())
+            {
+                it.next();
+                if (it.value().released)
+                {
+                    if (sessionpresent)
+                        data.append(EncodePacket((PubRel << 4) | 0x02, EncodeId(it.key())));
+                    else
+                        it.remove();
+                }
+                else
+                {
+                    data.append(EncodePublish(it.value(), it.key(), true));
+                }
+            }
+            if (!data.isEmpty())
+                Write(data);
+
+            emit Connected(sessionpresent);
+            ScheduleFlush();
+            break;
+        }
+        case Publish:
+        {
+            int qos = (Header >> 1) & 0x03;
+            if (Body.size() < 2)
+                return;
+            int length = ((quint8)Body.at(0) << 8) | (quint8)Body.at(1);
+            int offset = 2 + length + (qos > 0 ? 2 : 0);
+            if (qos > 2 || Body.size() < offset)
+            {
+                LOG(VB_GENERAL, LOG_ERR, QStringLiteral("Malformed MQTT publish"));
+                return;
+            }
+
+            QString topic = QString::fromUtf8(Body.mid(2, length));
+            QByteArray payload = Body.mid(offset);
+            quint16 packetid = qos > 0 ? (quint16)(((quint8)Body.at(2 + length) << 8) | (quint8)Body.at(3 + length)) : 0;
+            QByteArray ack = EncodeId(packetid);
+
+            if (qos == 2)
+            {
+                // deliver once - the broker resends until it sees our PUBREC
+                if (!m_received.contains(packetid))
+                {
+                    m_received.insert(packetid);
+                    emit MessageReceived(topic, payload);
+                }
+                Write(EncodePacket(PubRec << 4, ack));
+            }
+            else
+            {
+                emit MessageReceived(topic, payload);
+                if (qos == 1)
+                    Write(EncodePacket(PubAck << 4, ack));
+            }
+            break;
+        }
+        case PubAck:
+        case PubComp:
+            if (m_inFlight.remove(id))
+                ScheduleFlush();
+            break;
+        case PubRec:
+        {
+            QMap<quint16,Message>::iterator it = m_inFlight.find(id);
+            if (it != m_inFlight.end())
+                it.value().released = true;
+            Write(EncodePacket((PubRel << 4) | 0x02, EncodeId(id)));
+            break;
+        }
+        case PubRel:
+            m_received.remove(id);
+            Write(EncodePacket(PubComp << 4, EncodeId(id)));
+            break;
+        case SubAck:
+            for (int i = 2; i < Body.size(); ++i)
+                if ((quint8)Body.at(i) == 0x80)
+                    LOG(VB_GENERAL, LOG_ERR, QStringLiteral("MQTT broker rejected subscription %1").arg(i - 1));
+            break;
+        case PingResp:
+            m_pingOutstanding = false;
+            break;
+        default:
+            LOG(VB_GENERAL, LOG_WARNING, QStringLiteral("Unexpected MQTT packet type %1").arg(type));
+            break;
+    }
+}
+
+void TorcMQTTClient::SendSubscriptions(void)
+{
+    if (m_subscriptions.isEmpty())
+        return;
+
+    QByteArray body = EncodeId(NextPacketId());
+    QMap<QString,int>::const_iterator it = m_subscriptions.constBegin();
+    for ( ; it != m_subscriptions.constEnd(); ++it)
+    {
+        AppendString(body, it.key().toUtf8());
+        body.append((char)it.value());
+    }
+    Write(EncodePacket((Subscribe << 4) | 0x02, body));
+}
+
+void TorcMQTTClient::KeepAliveTimeout(void)
+{
+    if (m_pingOutstanding)
+    {
+        LOG(VB_GENERAL, LOG_WARNING, QStringLiteral("No response from MQTT broker - disconnecting"));
+        m_socket->abort();
+        return;
+    }
+
+    m_pingOutstanding = true;
+    Write(EncodePacket(PingReq << 4, QByteArray()));
+}
+
+/// Post a single Flush for however many messages are published before control returns to the event loop.
+void TorcMQTTClient::ScheduleFlush(void)
+{
+    if (m_flushPending)
+        return;
+    m_flushPending = true;
+    QMetaObject::invokeMethod(this, "Flush", Qt::QueuedConnection);
+}
+
+void TorcMQTTClient::Flush(void)
+{
+    m_flushPending = false;
+    if (!m_connected || m_pendingOrder.isEmpty())
+        return;
+
+    QByteArray data;
+    QList<QString> remaining;
+    foreach (const QString &topic, m_pendingOrder)
+    {
+        const Message &message = m_pending[topic];
+        if (message.qos > 0)
+        {
+            if (m_inFlight.size() >= m_inFlightWindow)
+            {
+                remaining.append(topic);
+                continue;
+            }
+
+            quint16 id = NextPacketId();
+            m_inFlight.insert(id, message);
+            data.append(EncodePublish(message, id, false));
+        }
+        else
+        {
+            data.append(EncodePublish(message, 0, false));
+        }
+
+        m_published++;
+        m_pending.remove(topic);
+    }
+
+    m_pendingOrder = remaining;
+    if (!data.isEmpty())
+        Write(data);
+}
+
+quint16 TorcMQTTClient::NextPacketId(void)
+{
+    do
+    {
+        if (++m_nextPacketId == 0)
+            m_nextPacketId = 1;
+    } while (m_inFlight.contains(m_nextPacketId));
+    return m_nextPacketId;
+}
+
+QByteArray TorcMQTTClient::EncodeId(quint16 PacketId)
+{
+    QByteArray result;
+    result.append((char)(PacketId >> 8));
+    result.append((char)(PacketId & 0xff));
+    return result;
+}
+
+QByteArray TorcMQTTClient::EncodePublish(const Message &Outgoing, quint16 PacketId, bool Duplicate)
+{
+    QByteArray body;
+    QByteArray topic = Outgoing.topic.toUtf8();
+    body.reserve(topic.size() + Outgoing.payload.size() + 4);
+    AppendString(body, topic);
+    if (Outgoing.qos > 0)
+        body.append(EncodeId(PacketId));
+    body.append(Outgoing.payload);
+
+    quint8 header = (Publish << 4) | (Outgoing.qos << 1) | (Outgoing.retain ? 0x01 : 0x00) | (Duplicate ? 0x08 : 0x00);
+    return EncodePacket(header, body);
+}
+
+void TorcMQTTClient::Write(const QByteArray &Data)
+{
+    if (!m_socket || m_socket->state() != QAbstractSocket::ConnectedState)
+        return;
+
+    m_socket->write(Data);
+    m_writes++;
+}
@@ -0,0 +1,134 @@
+#ifndef TORCMQTTCLIENT_H
+#define TORCMQTTCLIENT_H
+
+// Qt
+#include <QMap>
+#include <QSet>
+#include <QHash>
+#include <QTimer>
+#include <QObject>
+#include <QTcpSocket>
+
+#define MQTT_DEFAULT_PORT       1883
+#define MQTT_DEFAULT_KEEPALIVE  60    // seconds
+#define MQTT_DEFAULT_INFLIGHT   16
+#define MQTT_RECONNECT_MIN      1000  // milliseconds
+#define MQTT_RECONNECT_MAX      60000 // milliseconds
+
+class TorcMQTTClient final : public QObject
+{
+    Q_OBJECT
+
+  public:
+    enum PacketType
+    {
+        Connect     = 1,
+        ConnAck     = 2,
+        Publish     = 3,
+        PubAck      = 4,
+        PubRec      = 5,
+        PubRel      = 6,
+        PubComp     = 7,
+        Subscribe   = 8,
+        SubAck      = 9,
+        Unsubscribe = 10,
+        UnsubAck    = 11,
+        PingReq     = 12,
+        PingResp    = 13,
+        Disconnect  = 14
+    };
+
+    class Message
+    {
+      public:
+        QString     topic;
+        QByteArray  payload;
+        int         qos;
+        bool        retain;
+        bool        released; // QoS 2 - PUBREC received and PUBREL sent
+    };
+
+  public:
+    TorcMQTTClient(const QString &Host, quint16 Port, const QString &ClientId,
+                   int KeepAlive = MQTT_DEFAULT_KEEPALIVE, int InFlight = MQTT_DEFAULT_INFLIGHT);
+   ~TorcMQTTClient();
+
+    static QByteArray EncodePacket      (quint8 Header, const QByteArray &Body);
+    static void       AppendString      (QByteArray &Data, const QByteArray &String);
+    static bool       TakePacket        (QByteArray &Buffer, quint8 &Header, QByteArray &Body, bool &Error);
+    static QByteArray EncodeId          (quint16 PacketId);
+
+    void              SetCredentials    (const QString &User, const QString &Password);
+    void              SetWill           (const QString &Topic, const QByteArray &Payload, bool Retain);
+    void              SetReconnectDelay (int Minimum, int Maximum);
+    void              AddSubscription   (const QString &Topic, int QoS);
+    void              PublishMessage    (const QString &Topic, const QByteArray &Payload, int QoS, bool Retain);
+    bool              IsConnected       (void) const;
+    int               GetInFlight       (void) const;
+    int               GetQueued         (void) const;
+    quint64           GetWrites         (void) const;
+    quint64           GetPublished      (void) const;
+    quint64           GetCoalesced      (void) const;
+
+  public slots:
+    void              Start             (void);
+    void              Stop              (void);
+
+  signals:
+    void              Connected         (bool SessionPresent);
+    void              Disconnected      (void);
+    void              MessageReceived   (const QString &Topic, const QByteArray &Payload);
+
+  private slots:
+    void              SocketConnected   (void);
+    void              SocketDisconnected(void);
+    void              SocketError       (QAbstractSocket::SocketError Error);
+    void              ReadyRead         (void);
+    void              Flush             (void);
+    void              KeepAliveTimeout  (void);
+    void              Reconnect         (void);
+
+  private:
+    void              ScheduleFlush     (void);
+    void              ScheduleReconnect (void);
+    void              HandlePacket      (quint8 Header, const QByteArray &Body);
+    void              SendSubscriptions (void);
+    quint16           NextPacketId      (void);
+    QByteArray        EncodePublish     (const Message &Outgoing, quint16 PacketId, bool Duplicate);
+    void              Write             (const QByteArray &Data);
+
+  private:
+    Q_DISABLE_COPY(TorcMQTTClient)
+    QString           m_host;
+    quint16           m_port;
+    QString           m_clientId;
+    int               m_keepAlive;
+    int               m_inFlightWindow;
+    QString           m_user;
+    QString           m_password;
+    QString           m_willTopic;
+    QByteArray        m_willPayload;
+    bool              m_willRetain;
+    QTcpSocket       *m_socket;
+    QByteArray        m_readBuffer;
+    bool              m_running;
+    bool              m_connected;
+    bool              m_flushPending;
+    bool              m_pingOutstanding;
+    QTimer            m_keepAliveTimer;
+    QTimer            m_reconnectTimer;
+    int               m_reconnectMin;
+    int               m_reconnectMax;
+    int               m_reconnectDelay;
+    quint16           m_nextPacketId;
+    QMap<QString,int> m_subscriptions;
+    QHash<QString,Message> m_pending;
+    QList<QString>    m_pendingOrder;
+    QMap<quint16,Message> m_inFlight;
+    QSet<quint16>     m_received;
+    quint64           m_writes;
+    quint64           m_published;
+    quint64           m_coalesced;
+};
+
+#endif // TORCMQTTCLIENT_H
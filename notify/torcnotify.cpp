@@ -33,6 +33,7 @@ TorcNotify::TorcNotify()
     TorcDeviceHandler(),
     m_notifiers(),
     m_notifications(),
+    m_newNotifications(),
     m_applicationNameChanged(false)
 {
 }
@@ -45,8 +46,10 @@ bool TorcNotify::Validate(void)
 
     QWriteLocker locker(&m_handlerLock);
 
-    foreach (TorcNotification* notification, m_notifications)
+    // NB only setup notifications once - Validate is called again when the configuration is reloaded
+    foreach (TorcNotification* notification, m_newNotifications)
         (void)notification->Setup();
+    m_newNotifications.clear();
 
     return true;
 }
@@ -267,6 +270,7 @@ void TorcNotify::Create(const QVariantMap &Details)
                             if (notification)
                             {
                                 m_notifications.append(notification);
+                                m_newNotifications.append(notification);
                                 LOG(VB_GENERAL, LOG_INFO, QStringLiteral("New notification '%1'").arg(notification->GetUniqueId()));
                                 break;
                             }
@@ -288,4 +292,37 @@ void TorcNotify::Destroy(void)
     foreach (TorcNotification* notification, m_notifications)
         notification->DownRef();
     m_notifications.clear();
+    m_newNotifications.clear();
+}
+
+void TorcNotify::RemoveDevices(const QStringList &UniqueIds, QStringList &Removed)
+{
+    QWriteLocker locker(&m_handlerLock);
+
+    QMutableListIterator<TorcNotifier*> it(m_notifiers);
+    while (it.hasNext())
+    {
+        TorcNotifier *notifier = it.next();
+        QString uniqueid = notifier->GetUniqueId();
+        if (UniqueIds.contains(uniqueid))
+        {
+            notifier->DownRef();
+            it.remove();
+            Removed.append(uniqueid);
+        }
+    }
+
+    QMutableListIterator<TorcNotification*> it2(m_notifications);
+    while (it2.hasNext())
+    {
+        TorcNotification *notification = it2.next();
+        QString uniqueid = notification->GetUniqueId();
+        if (UniqueIds.contains(uniqueid))
+        {
+            m_newNotifications.removeAll(notification);
+            notification->DownRef();
+            it2.remove();
+            Removed.append(uniqueid);
+        }
+    }
 }
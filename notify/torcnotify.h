@@ -32,10 +32,12 @@ class TorcNotify final : public QObject, public TorcDeviceHandler
   protected:
     void          Create                 (const QVariantMap &Details) override;
     void          Destroy                (void) override;
+    void          RemoveDevices          (const QStringList &UniqueIds, QStringList &Removed) override;
 
   private:
     QList<TorcNotifier*>                 m_notifiers;
     QList<TorcNotification*>             m_notifications;
+    QList<TorcNotification*>             m_newNotifications;
     bool                                 m_applicationNameChanged;
 };
 #endif // TORCNOTIFY_H
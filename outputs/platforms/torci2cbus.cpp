@@ -130,6 +130,29 @@ void TorcI2CBus::Destroy(void)
     qDeleteAll(m_devices);
     m_devices.clear();
 }
+
+/// \note An I2C device is removed (and its outputs reported in Removed) if any of its outputs are in UniqueIds.
+void TorcI2CBus::RemoveDevices(const QStringList &UniqueIds, QStringList &Removed)
+{
+    QWriteLocker locker(&m_handlerLock);
+
+    QMutableMapIterator<int,TorcI2CDevice*> it(m_devices);
+    while (it.hasNext())
+    {
+        it.next();
+        QStringList uniqueids = it.value()->GetUniqueIds();
+        foreach (const QString &uniqueid, uniqueids)
+        {
+            if (UniqueIds.contains(uniqueid))
+            {
+                Removed.append(uniqueids);
+                delete it.value();
+                it.remove();
+                break;
+            }
+        }
+    }
+}
 static const QString i2cOutputTypes = QStringLiteral(
 "<xs:simpleType name='pca9685ChannelNumberType'>\r\n"
 "  <xs:restriction base='xs:integer'>\r\n"
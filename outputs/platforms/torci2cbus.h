@@ -17,6 +17,8 @@ class TorcI2CDevice
     explicit TorcI2CDevice(int Address);
     virtual ~TorcI2CDevice()= default;
 
+    virtual QStringList GetUniqueIds (void) const = 0;
+
   protected:
     int  m_address;
     int  m_fd;
@@ -52,6 +54,7 @@ class TorcI2CBus : public TorcDeviceHandler
 
     void Create              (const QVariantMap &Details);
     void Destroy             (void);
+    void RemoveDevices       (const QStringList &UniqueIds, QStringList &Removed);
 
   private:
     QMap<int,TorcI2CDevice*> m_devices;
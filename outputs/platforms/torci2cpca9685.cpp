@@ -27,19 +27,7 @@
 // wiringPi
 #include <wiringPiI2C.h>
 
-// PCA9685
-#include <stdint.h>
-#define MODE1         0x00
-#define MODE2         0x01
-#define LED0_ON_LOW   0x06
-#define LED0_ON_HIGH  0x07
-#define LED0_OFF_LOW  0x08
-#define LED0_OFF_HIGH 0x09
-#define PRESCALE      0xFE
-#define CLOCKFREQ     25000000.0
-#define PCA9685_RESOLUTION 4095
-#define PCA9685_RANGE 4096
-
+// std
 #include <unistd.h>
 #include <math.h>
 
@@ -86,16 +74,35 @@ void TorcI2CPCA9685Channel::SetValue(double Value)
         return;
 
     m_channelValue = channelvalue;
-    m_parent->SetPWM(m_channelNumber, m_channelValue);
+    if (m_parent && !DeferUntilEndOfBatch())
+        m_parent->SetPWM(m_channelNumber, m_channelValue);
     TorcPWMOutput::SetValue(Value);
 }
+
+void TorcI2CPCA9685Channel::FlushBatch(void)
+{
+    QMutexLocker locker(&lock);
+    if (m_parent)
+        m_parent->SetPWM(m_channelNumber, m_channelValue);
+}
+
+/*! \brief Set the channel to its default and detach it from the device.
+ *
+ * The channel may outlive the device (it is reference counted) - e.g. when the configuration is reloaded.
+*/
+void TorcI2CPCA9685Channel::Detach(void)
+{
+    QMutexLocker locker(&lock);
+    if (m_parent)
+        m_parent->SetPWM(m_channelNumber, lround(defaultValue * (float)PCA9685_RESOLUTION));
+    m_parent = nullptr;
+}
     
 TorcI2CPCA9685::TorcI2CPCA9685(int Address, const QVariantMap &Details)
-  : TorcI2CDevice(Address)
+  : TorcI2CDevice(Address),
+    m_outputs(),
+    m_writer(nullptr)
 {
-    // nullify outputs in case they aren't created
-    memset(m_outputs, 0, sizeof(TorcI2CPCA9685Channel*) * 16);
-
     // open a handle to the device
     m_fd = wiringPiI2CSetup(m_address);
     if (m_fd < 0)
@@ -107,22 +114,10 @@ TorcI2CPCA9685::TorcI2CPCA9685(int Address, const QVariantMap &Details)
     LOG(VB_GENERAL, LOG_INFO, QStringLiteral("Opened %1 I2C device at address 0x%2")
         .arg(PCA9685).arg(m_address, 0, 16));
 
-    // reset
-    if (wiringPiI2CWriteReg8(m_fd, MODE1, 0x00) < 0 || wiringPiI2CWriteReg8(m_fd, MODE2, 0x04) < 0)
-    {
-        LOG(VB_GENERAL, LOG_ERR, QStringLiteral("Failed to reset PCA9685 device"));
-        return;
-    }
-
-    // set frequency to 1000Hz
-    bool success = true;
-    success &= wiringPiI2CWriteReg8(m_fd, MODE1, 0x01) > -1;
-    success &= wiringPiI2CWriteReg8(m_fd, PRESCALE, (uint8_t)((CLOCKFREQ / PCA9685_RANGE / 1000) - 1)) > -1;
-    success &= wiringPiI2CWriteReg8(m_fd, MODE1, 0x80) > -1;
-    success &= wiringPiI2CWriteReg8(m_fd, MODE2, 0x04) > -1;
-
-    if (!success)
-        LOG(VB_GENERAL, LOG_ERR, QStringLiteral("Failed to set up PCA9685 device"));
+    // set frequency to 1000Hz and enable register auto-increment
+    m_writer = new TorcI2CPCA9685Writer(new TorcI2CFileTransport(m_fd));
+    (void)m_writer->Setup(1000);
+    m_writer->start();
 
     // create individual channel services
     // this will also reset each channel to the default value (0)
@@ -167,48 +162,41 @@ TorcI2CPCA9685::~TorcI2CPCA9685()
         if (m_outputs[i])
         {
             TorcOutputs::gOutputs->RemoveOutput(m_outputs[i]);
+            m_outputs[i]->Detach();
             m_outputs[i]->DownRef();
             m_outputs[i] = nullptr;
         }
     }
 
+    // write any outstanding channel values and stop the bus thread
+    delete m_writer;
+    m_writer = nullptr;
+
     // close device
     if (m_fd > -1)
         close(m_fd);
 }
 
-/*! \brief Set the hardware PWM for given channel.
- */
+QStringList TorcI2CPCA9685::GetUniqueIds(void) const
+{
+    QStringList result;
+    for (int i = 0; i < 16; i++)
+        if (m_outputs[i])
+            result.append(m_outputs[i]->GetUniqueId());
+    return result;
+}
+
+/*! \brief Queue a new value for the given channel.
+ *
+ * The value is written by the bus thread, together with any other pending channel updates.
+*/
 bool TorcI2CPCA9685::SetPWM(int Channel, int Value)
 {
-    if (m_fd < 0 || Channel < 0 || Channel > 15)
+    if (!m_writer || Channel < 0 || Channel >= PCA9685_CHANNELS)
         return false;
 
-    int offtime = qBound(0, Value, PCA9685_RESOLUTION);
-    int ontime  = 0;
-
-    // turn completely on or off if required
-    // 'off' supercedes 'on' per spec
-    if (offtime < 1)
-    {
-        LOG(VB_GENERAL, LOG_INFO, QStringLiteral("Channel %1 turned completely OFF").arg(Channel));
-        offtime |= 0x1000;
-    }
-    else if (offtime >= PCA9685_RESOLUTION)
-    {
-        LOG(VB_GENERAL, LOG_INFO, QStringLiteral("Channel %1 turned completely ON").arg(Channel));
-        ontime |= 0x1000;
-    }
-
-    bool success = true;
-    success &= wiringPiI2CWriteReg8(m_fd, LED0_ON_LOW   + (4 * Channel), ontime & 0xFF) > -1;
-    success &= wiringPiI2CWriteReg8(m_fd, LED0_ON_HIGH  + (4 * Channel), ontime >> 8) > -1;
-    success &= wiringPiI2CWriteReg8(m_fd, LED0_OFF_LOW  + (4 * Channel), offtime & 0xFF) > -1;
-    success &= wiringPiI2CWriteReg8(m_fd, LED0_OFF_HIGH + (4 * Channel), offtime >> 8) > -1;
-    
-    if (!success)
-        LOG(VB_GENERAL, LOG_ERR, QStringLiteral("Error writing to channel %1").arg(Channel));
-    return success;
+    m_writer->SetChannel(Channel, Value);
+    return true;
 }
 
 class TorcI2CPCA9685Factory : public TorcI2CDeviceFactory
@@ -8,6 +8,7 @@
 #include "../torcpwmoutput.h"
 #include "../torcoutputs.h"
 #include "torci2cbus.h"
+#include "torci2cpca9685writer.h"
 
 #define PCA9685 QStringLiteral("pca9685")
 
@@ -22,10 +23,14 @@ class TorcI2CPCA9685Channel : public TorcPWMOutput
     ~TorcI2CPCA9685Channel();
 
     QStringList GetDescription(void);
+    void        Detach        (void);
 
   public slots:
     void SetValue (double Value);
 
+  protected:
+    void FlushBatch (void) override;
+
   private:
     int             m_channelNumber;
     int             m_channelValue;
@@ -43,12 +48,15 @@ class TorcI2CPCA9685 : public TorcI2CDevice
     TorcI2CPCA9685(int Address, const QVariantMap &Details);
     ~TorcI2CPCA9685();
 
+    QStringList            GetUniqueIds (void) const override;
+
   protected:
     bool                   SetPWM (int Channel, int Value);
 
   private:
     Q_DISABLE_COPY(TorcI2CPCA9685)
-    TorcI2CPCA9685Channel *m_outputs[16];
+    TorcI2CPCA9685Channel *m_outputs[PCA9685_CHANNELS];
+    TorcI2CPCA9685Writer  *m_writer;
 };
 
 #endif // TORCI2CPCA9685_H
@@ -0,0 +1,278 @@
+/* Class TorcI2CPCA9685Writer
+*
+* This file is part of the Torc project.
+*
+* Copyright (C) Mark Kendall 2018
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+* USA.
+*/
+
+// Torc
+#include "torclogging.h"
+#include "torci2cpca9685writer.h"
+
+// std
+#include <unistd.h>
+#include <string.h>
+
+// PCA9685
+#define MODE1         0x00
+#define MODE2         0x01
+#define LED0_ON_LOW   0x06
+#define ALL_LED_ON_L  0xFA
+#define PRESCALE      0xFE
+#define CLOCKFREQ     25000000.0
+
+#define MODE1_ALLCALL 0x01
+#define MODE1_SLEEP   0x10
+#define MODE1_AI      0x20
+#define MODE1_RESTART 0x80
+#define MODE2_OUTDRV  0x04
+
+TorcI2CFileTransport::TorcI2CFileTransport(int Handle)
+  : TorcI2CTransport(),
+    m_handle(Handle)
+{
+}
+
+/// Write to an I2C device opened with i2c-dev (and I2C_SLAVE set).
+bool TorcI2CFileTransport::Write(const quint8 *Data, int Length)
+{
+    return m_handle > -1 && write(m_handle, Data, Length) == Length;
+}
+
+/*! \class TorcI2CPCA9685Writer
+ *  \brief Write channel values to a PCA9685 from a dedicated thread.
+ *
+ * Channel updates are queued (the latest value for each channel wins) and written by the bus thread. The device
+ * is configured to auto-increment its register address, so each contiguous run of changed channels is written
+ * in a single transaction (4 bytes per channel) and, if more than one run has changed and every channel now has
+ * the same value, a single write to the ALL_LED registers is used instead.
+ *
+ * Without this, each channel change required four single register writes - or 64 transactions to update every channel.
+ *
+ * The writer takes ownership of the transport.
+*/
+TorcI2CPCA9685Writer::TorcI2CPCA9685Writer(TorcI2CTransport *Transport)
+  : TorcQThread(QStringLiteral("I2CPCA9685")),
+    m_transport(Transport),
+    m_lock(),
+    m_wait(),
+    m_idle(),
+    m_aborted(false),
+    m_busy(false),
+    m_dirty(0),
+    m_pending(),
+    m_applied(),
+    m_errors(0)
+{
+    for (int i = 0; i < PCA9685_CHANNELS; ++i)
+        m_applied[i] = -1;
+}
+
+TorcI2CPCA9685Writer::~TorcI2CPCA9685Writer()
+{
+    // NB pending updates are written before the thread exits
+    {
+        QMutexLocker locker(&m_lock);
+        m_aborted = true;
+        m_wait.wakeAll();
+    }
+    wait();
+
+    delete m_transport;
+}
+
+/// Encode Value (0 to PCA9685_RESOLUTION) as the four LEDn_ON/LEDn_OFF register values.
+void TorcI2CPCA9685Writer::Encode(int Value, quint8 *Buffer)
+{
+    int offtime = qBound(0, Value, PCA9685_RESOLUTION);
+    int ontime  = 0;
+
+    // turn completely on or off if required
+    // 'off' supercedes 'on' per spec
+    if (offtime < 1)
+        offtime |= 0x1000;
+    else if (offtime >= PCA9685_RESOLUTION)
+        ontime = 0x1000;
+
+    Buffer[0] = ontime & 0xFF;
+    Buffer[1] = ontime >> 8;
+    Buffer[2] = offtime & 0xFF;
+    Buffer[3] = offtime >> 8;
+}
+
+/*! \brief Reset the device and set the PWM frequency.
+ *
+ * This must be called before the thread is started.
+*/
+bool TorcI2CPCA9685Writer::Setup(int Frequency)
+{
+    // reset
+    if (!WriteRegister(MODE1, 0x00) || !WriteRegister(MODE2, MODE2_OUTDRV))
+    {
+        LOG(VB_GENERAL, LOG_ERR, QStringLiteral("Failed to reset PCA9685 device"));
+        return false;
+    }
+
+    // the prescaler can only be set while the oscillator is off
+    bool success = true;
+    success &= WriteRegister(MODE1, MODE1_SLEEP | MODE1_ALLCALL);
+    success &= WriteRegister(PRESCALE, (quint8)((CLOCKFREQ / PCA9685_RANGE / Frequency) - 1));
+    success &= WriteRegister(MODE1, MODE1_AI | MODE1_ALLCALL);
+    usleep(500); // oscillator start up
+    success &= WriteRegister(MODE1, MODE1_RESTART | MODE1_AI | MODE1_ALLCALL);
+    success &= WriteRegister(MODE2, MODE2_OUTDRV);
+
+    if (!success)
+    {
+        LOG(VB_GENERAL, LOG_ERR, QStringLiteral("Failed to set up PCA9685 device"));
+        return false;
+    }
+
+    // every channel is fully off after a reset
+    for (int i = 0; i < PCA9685_CHANNELS; ++i)
+        m_applied[i] = 0;
+    return true;
+}
+
+/// Queue a new value for Channel. Any value not yet written for the channel is replaced.
+void TorcI2CPCA9685Writer::SetChannel(int Channel, int Value)
+{
+    if (Channel < 0 || Channel >= PCA9685_CHANNELS)
+        return;
+
+    QMutexLocker locker(&m_lock);
+    m_pending[Channel] = qBound(0, Value, PCA9685_RESOLUTION);
+    m_dirty |= 1 << Channel;
+    m_wait.wakeAll();
+}
+
+/// Wait until every queued value has been written.
+void TorcI2CPCA9685Writer::Flush(void)
+{
+    QMutexLocker locker(&m_lock);
+    while ((m_dirty || m_busy) && isRunning())
+        m_idle.wait(&m_lock, 100);
+}
+
+quint64 TorcI2CPCA9685Writer::GetErrorCount(void)
+{
+    QMutexLocker locker(&m_lock);
+    return m_errors;
+}
+
+void TorcI2CPCA9685Writer::Start(void)
+{
+}
+
+void TorcI2CPCA9685Writer::Finish(void)
+{
+}
+
+void TorcI2CPCA9685Writer::run(void)
+{
+    Initialise();
+
+    QMutexLocker locker(&m_lock);
+    forever
+    {
+        while (!m_dirty && !m_aborted)
+            m_wait.wait(&m_lock);
+        if (!m_dirty)
+            break;
+
+        int values[PCA9685_CHANNELS];
+        memcpy(values, m_pending, sizeof(values));
+        quint16 dirty = m_dirty;
+        m_dirty = 0;
+        m_busy  = true;
+
+        locker.unlock();
+        WriteChannels(dirty, values);
+        locker.relock();
+
+        m_busy = false;
+        m_idle.wakeAll();
+    }
+    locker.unlock();
+
+    Deinitialise();
+}
+
+bool TorcI2CPCA9685Writer::WriteRegister(quint8 Register, quint8 Value)
+{
+    quint8 data[2] = { Register, Value };
+    return m_transport && m_transport->Write(data, 2);
+}
+
+void TorcI2CPCA9685Writer::WriteChannels(quint16 Dirty, const int *Values)
+{
+    int runs = 0;
+    bool same = true;
+    for (int i = 0; i < PCA9685_CHANNELS; ++i)
+    {
+        if (Dirty & (1 << i))
+        {
+            m_applied[i] = Values[i];
+            if (i == 0 || !(Dirty & (1 << (i - 1))))
+                runs++;
+        }
+        same &= m_applied[i] == m_applied[0];
+    }
+
+    quint8 buffer[1 + PCA9685_CHANNELS * 4];
+    int errors = 0;
+
+    if (runs > 1 && same && m_applied[0] > -1)
+    {
+        buffer[0] = ALL_LED_ON_L;
+        Encode(m_applied[0], buffer + 1);
+        if (!m_transport->Write(buffer, 5))
+        {
+            LOG(VB_GENERAL, LOG_ERR, QStringLiteral("Error writing to all channels"));
+            errors++;
+        }
+    }
+    else
+    {
+        for (int first = 0; first < PCA9685_CHANNELS; ++first)
+        {
+            if (!(Dirty & (1 << first)))
+                continue;
+
+            int last = first;
+            while (last + 1 < PCA9685_CHANNELS && (Dirty & (1 << (last + 1))))
+                last++;
+
+            buffer[0] = LED0_ON_LOW + (4 * first);
+            for (int i = first; i <= last; ++i)
+                Encode(Values[i], buffer + 1 + (4 * (i - first)));
+            if (!m_transport->Write(buffer, 1 + (4 * (last - first + 1))))
+            {
+                LOG(VB_GENERAL, LOG_ERR, QStringLiteral("Error writing to channels %1-%2").arg(first).arg(last));
+                errors++;
+            }
+            first = last;
+        }
+    }
+
+    if (errors)
+    {
+        QMutexLocker locker(&m_lock);
+        m_errors += errors;
+    }
+}
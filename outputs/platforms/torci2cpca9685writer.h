@@ -0,0 +1,79 @@
+#ifndef TORCI2CPCA9685WRITER_H
+#define TORCI2CPCA9685WRITER_H
+
+// Qt
+#include <QMutex>
+#include <QWaitCondition>
+
+// Torc
+#include "torcqthread.h"
+
+#define PCA9685_CHANNELS   16
+#define PCA9685_RESOLUTION 4095
+#define PCA9685_RANGE      4096
+
+/// A connection to a single I2C device.
+class TorcI2CTransport
+{
+  public:
+    TorcI2CTransport() = default;
+    virtual ~TorcI2CTransport() = default;
+
+    /// Write Length bytes in one transaction. The first byte is the register address.
+    virtual bool    Write (const quint8 *Data, int Length) = 0;
+
+  private:
+    Q_DISABLE_COPY(TorcI2CTransport)
+};
+
+class TorcI2CFileTransport final : public TorcI2CTransport
+{
+  public:
+    explicit TorcI2CFileTransport(int Handle);
+   ~TorcI2CFileTransport() = default;
+
+    bool            Write (const quint8 *Data, int Length) override;
+
+  private:
+    int             m_handle;
+};
+
+class TorcI2CPCA9685Writer final : public TorcQThread
+{
+    Q_OBJECT
+
+  public:
+    explicit TorcI2CPCA9685Writer(TorcI2CTransport *Transport);
+   ~TorcI2CPCA9685Writer();
+
+    static void     Encode        (int Value, quint8 *Buffer);
+    bool            Setup         (int Frequency);
+    void            SetChannel    (int Channel, int Value);
+    void            Flush         (void);
+    quint64         GetErrorCount (void);
+
+    void            Start         (void) override;
+    void            Finish        (void) override;
+
+  protected:
+    void            run           (void) override;
+
+  private:
+    bool            WriteRegister (quint8 Register, quint8 Value);
+    void            WriteChannels (quint16 Dirty, const int *Values);
+
+  private:
+    Q_DISABLE_COPY(TorcI2CPCA9685Writer)
+    TorcI2CTransport *m_transport;
+    QMutex          m_lock;
+    QWaitCondition  m_wait;
+    QWaitCondition  m_idle;
+    bool            m_aborted;
+    bool            m_busy;
+    quint16         m_dirty;
+    int             m_pending[PCA9685_CHANNELS];
+    int             m_applied[PCA9685_CHANNELS];
+    quint64         m_errors;
+};
+
+#endif // TORCI2CPCA9685WRITER_H
@@ -0,0 +1,848 @@
+/* Class TorcModbusBus
+*
+* This file is part of the Torc project.
+*
+* Copyright (C) Mark Kendall 2018
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+* USA.
+*/
+
+// Torc
+#include "torclogging.h"
+#include "torcinputs.h"
+#include "torcoutputs.h"
+#include "torcmodbusbus.h"
+
+// std
+#include <math.h>
+#include <string.h>
+
+#define MODBUS_MODEL QStringLiteral("Modbus")
+
+TorcModbusBus* TorcModbusBus::gTorcModbusBus = new TorcModbusBus();
+
+static double GetDouble(const QVariantMap &Details, const QString &Name, double Default)
+{
+    bool ok = false;
+    double result = Details.value(Name).toString().toDouble(&ok);
+    return ok ? result : Default;
+}
+
+/*! \class TorcModbusBus
+ *  \brief A class to handle inputs and outputs that are registers of Modbus slaves.
+ *
+ * Pumps, dosing controllers, energy meters and many other devices are controlled through Modbus - either directly
+ * over TCP, through a serial to TCP gateway or over a serial (RTU) line. Each <tcp> or <rtu> element describes a
+ * connection and the registers (inputs and outputs) that are read or written over it. Each register is identified by
+ * its slave address, table (coil, discrete, input or holding) and address (zero based, as sent on the wire).
+ *
+ * Input registers are decoded according to their format (uint16, int16, uint32, int32 or float32 - 32bit values use
+ * two registers, high word first unless wordswap is set) and then scaled (value * scale + offset). Coils and discrete
+ * inputs read as 0 or 1. Each input is read every 'interval' milliseconds (default 1000).
+ *
+ * Switch outputs write a coil (or 0/1 to a holding register). PWM outputs write a holding register, scaled by the
+ * output's resolution (e.g. a resolution of 1000 writes 0 to 1000). Outputs publish their new value once it has been
+ * written.
+ *
+ * All of the registers on a connection are read and written by a single TorcModbusMaster, which merges reads of
+ * neighbouring registers, limits the request rate to each slave and (over TCP) pipelines requests. A connection
+ * that is used for both inputs and outputs is shared - and its settings are taken from whichever is created first.
+ *
+ * \note Connection settings must come before the registers (host, port, timeout, rate, gap, pipeline for TCP and
+ *       serial, baud, parity, stopbits, timeout, rate, gap for RTU).
+ *
+ * \code
+ * <torc>
+ *   <inputs>
+ *     <modbus>
+ *       <tcp>
+ *         <host>192.168.1.50</host>
+ *         <port>502</port>
+ *         <timeout>500</timeout>
+ *         <rate>20</rate>
+ *         <gap>4</gap>
+ *         <pipeline>4</pipeline>
+ *         <temperature>
+ *           <name>sumptemp</name>
+ *           <slave>1</slave>
+ *           <table>input</table>
+ *           <address>0</address>
+ *           <format>int16</format>
+ *           <scale>0.1</scale>
+ *           <interval>5000</interval>
+ *         </temperature>
+ *         <integer>
+ *           <name>energy</name>
+ *           <slave>2</slave>
+ *           <table>holding</table>
+ *           <address>40</address>
+ *           <format>uint32</format>
+ *         </integer>
+ *       </tcp>
+ *     </modbus>
+ *   </inputs>
+ *   <outputs>
+ *     <modbus>
+ *       <rtu>
+ *         <serial>/dev/ttyUSB0</serial>
+ *         <baud>19200</baud>
+ *         <parity>even</parity>
+ *         <switch>
+ *           <name>returnpump</name>
+ *           <slave>3</slave>
+ *           <table>coil</table>
+ *           <address>0</address>
+ *         </switch>
+ *         <pwm>
+ *           <name>dosingrate</name>
+ *           <slave>3</slave>
+ *           <table>holding</table>
+ *           <address>10</address>
+ *           <resolution>1000</resolution>
+ *         </pwm>
+ *       </rtu>
+ *     </modbus>
+ *   </outputs>
+ * </torc>
+ * \endcode
+*/
+TorcModbusBus::TorcModbusBus()
+  : TorcDeviceHandler(),
+    m_inputs(),
+    m_outputs()
+{
+}
+
+void TorcModbusBus::Create(const QVariantMap &Details)
+{
+    QWriteLocker locker(&m_handlerLock);
+
+    QVariantMap::const_iterator i = Details.constBegin();
+    for ( ; i != Details.constEnd(); ++i)
+    {
+        // Modbus registers can be <inputs> or <outputs>
+        bool output = i.key() == OUTPUTS_DIRECTORY;
+        if (!output && i.key() != INPUTS_DIRECTORY)
+            continue;
+
+        QVariantMap devices = i.value().toMap();
+        QVariantMap::const_iterator it = devices.constBegin();
+        for ( ; it != devices.constEnd(); ++it)
+        {
+            // look for <modbus>
+            if (it.key() != MODBUS_NAME)
+                continue;
+
+            QVariantMap connections = it.value().toMap();
+            QVariantMap::const_iterator it2 = connections.constBegin();
+            for ( ; it2 != connections.constEnd(); ++it2)
+            {
+                bool rtu = it2.key() == MODBUS_RTU;
+                if (!rtu && it2.key() != MODBUS_TCP)
+                    continue;
+
+                QVariantMap settings = it2.value().toMap();
+                if (!settings.contains(rtu ? QStringLiteral("serial") : QStringLiteral("host")))
+                {
+                    LOG(VB_GENERAL, LOG_ERR, QStringLiteral("Modbus %1 connection needs <%2>").arg(it2.key(), rtu ? QStringLiteral("serial") : QStringLiteral("host")));
+                    continue;
+                }
+
+                QString connection = TorcModbusMaster::GetConnection(rtu, settings);
+                QVariantMap::const_iterator it3 = settings.constBegin();
+                for ( ; it3 != settings.constEnd(); ++it3)
+                {
+                    // connection settings are simple values - registers are elements
+                    if (it3.value().type() != QVariant::Map)
+                        continue;
+
+                    QString type        = it3.key();
+                    QVariantMap details = it3.value().toMap();
+                    TorcModbusMaster::Table table = TorcModbusMaster::Holding;
+                    if (!details.contains(QStringLiteral("slave")) || !details.contains(QStringLiteral("address")) ||
+                        !TorcModbusMaster::ParseTable(details.value(QStringLiteral("table")).toString(), table))
+                    {
+                        LOG(VB_GENERAL, LOG_ERR, QStringLiteral("Cannot create Modbus %1 '%2' without slave, table and address")
+                            .arg(type, details.value(QStringLiteral("name")).toString()));
+                        continue;
+                    }
+
+                    if (output)
+                    {
+                        TorcOutput *device = nullptr;
+                        if (type == QStringLiteral("switch") && (table == TorcModbusMaster::Coil || table == TorcModbusMaster::Holding))
+                            device = new TorcModbusSwitchOutput(connection, settings, details);
+                        else if (type == QStringLiteral("pwm") && table == TorcModbusMaster::Holding)
+                            device = new TorcModbusPWMOutput(connection, settings, details);
+
+                        if (device)
+                            m_outputs.insert(device->GetUniqueId(), device);
+                        else
+                            LOG(VB_GENERAL, LOG_WARNING, QStringLiteral("Unsupported Modbus output '%1' (%2 table)")
+                                .arg(type, details.value(QStringLiteral("table")).toString()));
+                        continue;
+                    }
+
+                    TorcInput *device = nullptr;
+                    if (type == QStringLiteral("temperature"))
+                        device = new TorcModbusTemperatureInput(connection, settings, details);
+                    else if (type == QStringLiteral("ph"))
+                        device = new TorcModbuspHInput(connection, settings, details);
+                    else if (type == QStringLiteral("switch"))
+                        device = new TorcModbusSwitchInput(connection, settings, details);
+                    else if (type == QStringLiteral("integer"))
+                        device = new TorcModbusIntegerInput(connection, settings, details);
+
+                    if (device)
+                        m_inputs.insert(device->GetUniqueId(), device);
+                    else
+                        LOG(VB_GENERAL, LOG_WARNING, QStringLiteral("Unknown Modbus input type '%1'").arg(type));
+                }
+            }
+        }
+    }
+}
+
+void TorcModbusBus::Destroy(void)
+{
+    QWriteLocker locker(&m_handlerLock);
+
+    QHash<QString,TorcInput*>::const_iterator it = m_inputs.constBegin();
+    for ( ; it != m_inputs.constEnd(); ++it)
+    {
+        TorcInputs::gInputs->RemoveInput(it.value());
+        it.value()->DownRef();
+    }
+    m_inputs.clear();
+
+    QHash<QString,TorcOutput*>::const_iterator it2 = m_outputs.constBegin();
+    for ( ; it2 != m_outputs.constEnd(); ++it2)
+    {
+        TorcOutputs::gOutputs->RemoveOutput(it2.value());
+        it2.value()->DownRef();
+    }
+    m_outputs.clear();
+}
+
+void TorcModbusBus::RemoveDevices(const QStringList &UniqueIds, QStringList &Removed)
+{
+    QWriteLocker locker(&m_handlerLock);
+
+    foreach (const QString &uniqueid, UniqueIds)
+    {
+        TorcInput *input = m_inputs.take(uniqueid);
+        if (input)
+        {
+            TorcInputs::gInputs->RemoveInput(input);
+            input->DownRef();
+            Removed.append(uniqueid);
+        }
+
+        TorcOutput *output = m_outputs.take(uniqueid);
+        if (output)
+        {
+            TorcOutputs::gOutputs->RemoveOutput(output);
+            output->DownRef();
+            Removed.append(uniqueid);
+        }
+    }
+}
+
+/*! \class TorcModbusRegister
+ *  \brief The register (or coil) behind a Modbus input or output and the master used to reach it.
+*/
+TorcModbusRegister::TorcModbusRegister(const QString &Connection, const QVariantMap &Settings, const QVariantMap &Details)
+  : m_master(TorcModbusMaster::Acquire(Connection, Settings)),
+    m_slave(Details.value(QStringLiteral("slave")).toString().toInt()),
+    m_table(TorcModbusMaster::Holding),
+    m_address(Details.value(QStringLiteral("address")).toString().toInt()),
+    m_format(UInt16),
+    m_wordSwap(Details.value(QStringLiteral("wordswap")).toString().trimmed() == QStringLiteral("true")),
+    m_scale(GetDouble(Details, QStringLiteral("scale"), 1.0)),
+    m_offset(GetDouble(Details, QStringLiteral("offset"), 0.0)),
+    m_interval(static_cast<int>(GetDouble(Details, QStringLiteral("interval"), MODBUS_DEFAULT_INTERVAL)))
+{
+    (void)TorcModbusMaster::ParseTable(Details.value(QStringLiteral("table")).toString(), m_table);
+    if (Details.contains(QStringLiteral("format")) && !ParseFormat(Details.value(QStringLiteral("format")).toString(), m_format))
+    {
+        LOG(VB_GENERAL, LOG_ERR, QStringLiteral("Unknown Modbus format '%1' for '%2' - using uint16")
+            .arg(Details.value(QStringLiteral("format")).toString(), Details.value(QStringLiteral("name")).toString()));
+    }
+}
+
+TorcModbusRegister::~TorcModbusRegister()
+{
+    TorcModbusMaster::Release(m_master);
+}
+
+bool TorcModbusRegister::ParseFormat(const QString &Name, Format &Result)
+{
+    QString name = Name.trimmed().toLower();
+    if (name == QStringLiteral("uint16"))
+        Result = UInt16;
+    else if (name == QStringLiteral("int16"))
+        Result = Int16;
+    else if (name == QStringLiteral("uint32"))
+        Result = UInt32;
+    else if (name == QStringLiteral("int32"))
+        Result = Int32;
+    else if (name == QStringLiteral("float32"))
+        Result = Float32;
+    else
+        return false;
+    return true;
+}
+
+/// Return the raw value of Values (one or two registers) in format Type.
+double TorcModbusRegister::Decode(const QVector<quint16> &Values, Format Type, bool WordSwap)
+{
+    if (Values.isEmpty())
+        return 0.0;
+
+    if (Type == UInt16)
+        return static_cast<double>(Values.at(0));
+    if (Type == Int16)
+        return static_cast<double>(static_cast<qint16>(Values.at(0)));
+    if (Values.size() < 2)
+        return 0.0;
+
+    quint32 raw = WordSwap ? (static_cast<quint32>(Values.at(1)) << 16) | Values.at(0)
+                           : (static_cast<quint32>(Values.at(0)) << 16) | Values.at(1);
+    if (Type == UInt32)
+        return static_cast<double>(raw);
+    if (Type == Int32)
+        return static_cast<double>(static_cast<qint32>(raw));
+
+    float result = 0.0;
+    memcpy(&result, &raw, sizeof(result));
+    return static_cast<double>(result);
+}
+
+bool TorcModbusRegister::Start(TorcModbusListener *Listener)
+{
+    bool bits   = m_table == TorcModbusMaster::Coil || m_table == TorcModbusMaster::Discrete;
+    int count   = (bits || m_format == UInt16 || m_format == Int16) ? 1 : 2;
+    return m_master->AddRegister(Listener, m_slave, m_table, m_address, count, m_interval);
+}
+
+void TorcModbusRegister::Stop(TorcModbusListener *Listener)
+{
+    m_master->RemoveListener(Listener);
+}
+
+bool TorcModbusRegister::Write(TorcModbusListener *Listener, quint16 Value)
+{
+    return m_master->Write(Listener, m_slave, m_table, m_address, QVector<quint16>() << Value);
+}
+
+/// Return the value of Values, scaled for the input.
+double TorcModbusRegister::Scale(const QVector<quint16> &Values) const
+{
+    bool bits = m_table == TorcModbusMaster::Coil || m_table == TorcModbusMaster::Discrete;
+    double raw = bits ? (Values.value(0) ? 1.0 : 0.0) : Decode(Values, m_format, m_wordSwap);
+    return raw * m_scale + m_offset;
+}
+
+QString TorcModbusRegister::GetDescription(void) const
+{
+    static const QStringList tables = QStringList() << QStringLiteral("coil") << QStringLiteral("discrete")
+                                                    << QStringLiteral("input") << QStringLiteral("holding");
+    return QStringLiteral("%1 slave %2 %3 %4").arg(m_master->GetConnection()).arg(m_slave).arg(tables.value(m_table)).arg(m_address);
+}
+
+/*! \class TorcModbusTemperatureInput
+ *  \brief A temperature read from a Modbus register. Scaled values are in celsius.
+*/
+TorcModbusTemperatureInput::TorcModbusTemperatureInput(const QString &Connection, const QVariantMap &Settings, const QVariantMap &Details)
+  : TorcTemperatureInput(TorcCentral::GetGlobalTemperatureUnits() == TorcCentral::Celsius ? 0.0 : 32.0,
+                         TorcCentral::GetGlobalTemperatureUnits() == TorcCentral::Celsius ? -55.0 : -67.0,
+                         TorcCentral::GetGlobalTemperatureUnits() == TorcCentral::Celsius ? 150.0 : 302.0,
+                         MODBUS_MODEL, Details),
+    TorcModbusListener(),
+    m_register(Connection, Settings, Details)
+{
+    (void)m_register.Start(this);
+}
+
+TorcModbusTemperatureInput::~TorcModbusTemperatureInput()
+{
+    m_register.Stop(this);
+}
+
+QStringList TorcModbusTemperatureInput::GetDescription(void)
+{
+    return QStringList() << tr("Modbus Temperature") << m_register.GetDescription();
+}
+
+/// Pass a new reading from the master thread to this input's thread.
+void TorcModbusTemperatureInput::ModbusValueRead(const QVector<quint16> &Values, bool Valid)
+{
+    QMetaObject::invokeMethod(this, "Read", Qt::QueuedConnection, Q_ARG(double, Valid ? m_register.Scale(Values) : 0.0), Q_ARG(bool, Valid));
+}
+
+void TorcModbusTemperatureInput::ModbusValueWritten(const QVector<quint16>& /*Values*/, bool /*Success*/)
+{
+}
+
+void TorcModbusTemperatureInput::Read(double Value, bool Valid)
+{
+    if (Valid)
+    {
+        // readings are in celsius - convert if needed
+        double value = Value;
+        if (TorcCentral::GetGlobalTemperatureUnits() == TorcCentral::Fahrenheit)
+            value = TorcTemperatureInput::CelsiusToFahrenheit(Value);
+        SetValue(value);
+    }
+    else
+    {
+        SetValid(false);
+    }
+}
+
+/*! \class TorcModbuspHInput
+ *  \brief A pH read from a Modbus register.
+*/
+TorcModbuspHInput::TorcModbuspHInput(const QString &Connection, const QVariantMap &Settings, const QVariantMap &Details)
+  : TorcpHInput(7.0, MODBUS_MODEL, Details),
+    TorcModbusListener(),
+    m_register(Connection, Settings, Details)
+{
+    (void)m_register.Start(this);
+}
+
+TorcModbuspHInput::~TorcModbuspHInput()
+{
+    m_register.Stop(this);
+}
+
+QStringList TorcModbuspHInput::GetDescription(void)
+{
+    return QStringList() << tr("Modbus pH") << m_register.GetDescription();
+}
+
+/// Pass a new reading from the master thread to this input's thread.
+void TorcModbuspHInput::ModbusValueRead(const QVector<quint16> &Values, bool Valid)
+{
+    QMetaObject::invokeMethod(this, "Read", Qt::QueuedConnection, Q_ARG(double, Valid ? m_register.Scale(Values) : 0.0), Q_ARG(bool, Valid));
+}
+
+void TorcModbuspHInput::ModbusValueWritten(const QVector<quint16>& /*Values*/, bool /*Success*/)
+{
+}
+
+void TorcModbuspHInput::Read(double Value, bool Valid)
+{
+    if (Valid)
+        SetValue(qBound(0.0, Value, 14.0));
+    else
+        SetValid(false);
+}
+
+/*! \class TorcModbusSwitchInput
+ *  \brief A switch read from a coil, discrete input or register. Any non-zero (scaled) value is on.
+*/
+TorcModbusSwitchInput::TorcModbusSwitchInput(const QString &Connection, const QVariantMap &Settings, const QVariantMap &Details)
+  : TorcSwitchInput(0, MODBUS_MODEL, Details),
+    TorcModbusListener(),
+    m_register(Connection, Settings, Details)
+{
+    (void)m_register.Start(this);
+}
+
+TorcModbusSwitchInput::~TorcModbusSwitchInput()
+{
+    m_register.Stop(this);
+}
+
+QStringList TorcModbusSwitchInput::GetDescription(void)
+{
+    return QStringList() << tr("Modbus Switch") << m_register.GetDescription();
+}
+
+/// Pass a new reading from the master thread to this input's thread.
+void TorcModbusSwitchInput::ModbusValueRead(const QVector<quint16> &Values, bool Valid)
+{
+    QMetaObject::invokeMethod(this, "Read", Qt::QueuedConnection, Q_ARG(double, Valid ? m_register.Scale(Values) : 0.0), Q_ARG(bool, Valid));
+}
+
+void TorcModbusSwitchInput::ModbusValueWritten(const QVector<quint16>& /*Values*/, bool /*Success*/)
+{
+}
+
+void TorcModbusSwitchInput::Read(double Value, bool Valid)
+{
+    if (Valid)
+        SetValue(qFuzzyCompare(Value + 1.0, 1.0) ? 0 : 1);
+    else
+        SetValid(false);
+}
+
+/*! \class TorcModbusIntegerInput
+ *  \brief An integer (e.g. a counter or status code) read from a Modbus register.
+*/
+TorcModbusIntegerInput::TorcModbusIntegerInput(const QString &Connection, const QVariantMap &Settings, const QVariantMap &Details)
+  : TorcIntegerInput(0, MODBUS_MODEL, Details),
+    TorcModbusListener(),
+    m_register(Connection, Settings, Details)
+{
+    (void)m_register.Start(this);
+}
+
+TorcModbusIntegerInput::~TorcModbusIntegerInput()
+{
+    m_register.Stop(this);
+}
+
+QStringList TorcModbusIntegerInput::GetDescription(void)
+{
+    return QStringList() << tr("Modbus Integer") << m_register.GetDescription();
+}
+
+/// Pass a new reading from the master thread to this input's thread.
+void TorcModbusIntegerInput::ModbusValueRead(const QVector<quint16> &Values, bool Valid)
+{
+    QMetaObject::invokeMethod(this, "Read", Qt::QueuedConnection, Q_ARG(double, Valid ? m_register.Scale(Values) : 0.0), Q_ARG(bool, Valid));
+}
+
+void TorcModbusIntegerInput::ModbusValueWritten(const QVector<quint16>& /*Values*/, bool /*Success*/)
+{
+}
+
+void TorcModbusIntegerInput::Read(double Value, bool Valid)
+{
+    if (Valid)
+        SetValue(qRound64(Value));
+    else
+        SetValid(false);
+}
+
+/*! \class TorcModbusSwitchOutput
+ *  \brief A switch that writes a coil (or 0 and 1 to a holding register).
+*/
+TorcModbusSwitchOutput::TorcModbusSwitchOutput(const QString &Connection, const QVariantMap &Settings, const QVariantMap &Details)
+  : TorcSwitchOutput(0, MODBUS_MODEL, Details),
+    TorcModbusListener(),
+    m_register(Connection, Settings, Details)
+{
+    // put the slave into the default state
+    (void)m_register.Write(this, 0);
+}
+
+TorcModbusSwitchOutput::~TorcModbusSwitchOutput()
+{
+    // always return the slave to the default state - the write is made even though we are no longer told the result
+    m_register.Stop(this);
+    (void)m_register.Write(nullptr, defaultValue == 0.0 ? 0 : 1);
+}
+
+QStringList TorcModbusSwitchOutput::GetDescription(void)
+{
+    return QStringList() << tr("Modbus Switch") << m_register.GetDescription();
+}
+
+void TorcModbusSwitchOutput::ModbusValueRead(const QVector<quint16>& /*Values*/, bool /*Valid*/)
+{
+}
+
+/// Publish the new value once the slave has accepted it.
+void TorcModbusSwitchOutput::ModbusValueWritten(const QVector<quint16> &Values, bool Success)
+{
+    ValueApplied(Values.value(0) ? 1 : 0, Success);
+}
+
+void TorcModbusSwitchOutput::SetValue(double Value)
+{
+    QMutexLocker locker(&lock);
+
+    // as in TorcSwitchOutput::SetValue - the value is published once it has been written
+    (void)m_register.Write(this, Value == 0.0 ? 0 : 1);
+}
+
+/*! \class TorcModbusPWMOutput
+ *  \brief A PWM (or any proportional) output that writes a holding register, from 0 to the output's resolution.
+*/
+TorcModbusPWMOutput::TorcModbusPWMOutput(const QString &Connection, const QVariantMap &Settings, const QVariantMap &Details)
+  : TorcPWMOutput(0, MODBUS_MODEL, Details, 0xffff),
+    TorcModbusListener(),
+    m_register(Connection, Settings, Details)
+{
+    // put the slave into the default state
+    (void)m_register.Write(this, 0);
+}
+
+TorcModbusPWMOutput::~TorcModbusPWMOutput()
+{
+    // always return the slave to the default state - the write is made even though we are no longer told the result
+    m_register.Stop(this);
+    (void)m_register.Write(nullptr, static_cast<quint16>(lround(qBound(0.0, defaultValue, 1.0) * (double)m_resolution)));
+}
+
+QStringList TorcModbusPWMOutput::GetDescription(void)
+{
+    return QStringList() << tr("Modbus PWM") << m_register.GetDescription() << tr("Resolution %1").arg(m_resolution);
+}
+
+void TorcModbusPWMOutput::ModbusValueRead(const QVector<quint16>& /*Values*/, bool /*Valid*/)
+{
+}
+
+/// Publish the new value (at the output's resolution) once the slave has accepted it.
+void TorcModbusPWMOutput::ModbusValueWritten(const QVector<quint16> &Values, bool Success)
+{
+    ValueApplied(Values.value(0) / (double)m_resolution, Success);
+}
+
+void TorcModbusPWMOutput::SetValue(double Value)
+{
+    QMutexLocker locker(&lock);
+    (void)m_register.Write(this, static_cast<quint16>(lround(qBound(0.0, Value, 1.0) * (double)m_resolution)));
+}
+
+static const QString modbusInputTypes =
+QStringLiteral("<xs:simpleType name='modbusSlaveType'>\r\n"
+"  <xs:restriction base='xs:integer'>\r\n"
+"    <xs:minInclusive value='1'/>\r\n"
+"    <xs:maxInclusive value='247'/>\r\n"
+"  </xs:restriction>\r\n"
+"</xs:simpleType>\r\n"
+"<xs:simpleType name='modbusAddressType'>\r\n"
+"  <xs:restriction base='xs:integer'>\r\n"
+"    <xs:minInclusive value='0'/>\r\n"
+"    <xs:maxInclusive value='65535'/>\r\n"
+"  </xs:restriction>\r\n"
+"</xs:simpleType>\r\n"
+"<xs:simpleType name='modbusTableType'>\r\n"
+"  <xs:restriction base='xs:string'>\r\n"
+"    <xs:enumeration value='coil'/>\r\n"
+"    <xs:enumeration value='discrete'/>\r\n"
+"    <xs:enumeration value='input'/>\r\n"
+"    <xs:enumeration value='holding'/>\r\n"
+"  </xs:restriction>\r\n"
+"</xs:simpleType>\r\n"
+"<xs:simpleType name='modbusFormatType'>\r\n"
+"  <xs:restriction base='xs:string'>\r\n"
+"    <xs:enumeration value='uint16'/>\r\n"
+"    <xs:enumeration value='int16'/>\r\n"
+"    <xs:enumeration value='uint32'/>\r\n"
+"    <xs:enumeration value='int32'/>\r\n"
+"    <xs:enumeration value='float32'/>\r\n"
+"  </xs:restriction>\r\n"
+"</xs:simpleType>\r\n"
+"<!-- milliseconds -->\r\n"
+"<xs:simpleType name='modbusIntervalType'>\r\n"
+"  <xs:restriction base='xs:integer'>\r\n"
+"    <xs:minInclusive value='10'/>\r\n"
+"    <xs:maxInclusive value='86400000'/>\r\n"
+"  </xs:restriction>\r\n"
+"</xs:simpleType>\r\n"
+"<xs:simpleType name='modbusPortType'>\r\n"
+"  <xs:restriction base='xs:integer'>\r\n"
+"    <xs:minInclusive value='1'/>\r\n"
+"    <xs:maxInclusive value='65535'/>\r\n"
+"  </xs:restriction>\r\n"
+"</xs:simpleType>\r\n"
+"<!-- milliseconds -->\r\n"
+"<xs:simpleType name='modbusTimeoutType'>\r\n"
+"  <xs:restriction base='xs:integer'>\r\n"
+"    <xs:minInclusive value='10'/>\r\n"
+"    <xs:maxInclusive value='60000'/>\r\n"
+"  </xs:restriction>\r\n"
+"</xs:simpleType>\r\n"
+"<!-- requests per second, per slave -->\r\n"
+"<xs:simpleType name='modbusRateType'>\r\n"
+"  <xs:restriction base='xs:integer'>\r\n"
+"    <xs:minInclusive value='1'/>\r\n"
+"    <xs:maxInclusive value='1000'/>\r\n"
+"  </xs:restriction>\r\n"
+"</xs:simpleType>\r\n"
+"<!-- unused registers that may be read to merge two reads -->\r\n"
+"<xs:simpleType name='modbusGapType'>\r\n"
+"  <xs:restriction base='xs:integer'>\r\n"
+"    <xs:minInclusive value='0'/>\r\n"
+"    <xs:maxInclusive value='124'/>\r\n"
+"  </xs:restriction>\r\n"
+"</xs:simpleType>\r\n"
+"<xs:simpleType name='modbusPipelineType'>\r\n"
+"  <xs:restriction base='xs:integer'>\r\n"
+"    <xs:minInclusive value='1'/>\r\n"
+"    <xs:maxInclusive value='64'/>\r\n"
+"  </xs:restriction>\r\n"
+"</xs:simpleType>\r\n"
+"<xs:simpleType name='modbusBaudType'>\r\n"
+"  <xs:restriction base='xs:integer'>\r\n"
+"    <xs:enumeration value='1200'/>\r\n"
+"    <xs:enumeration value='2400'/>\r\n"
+"    <xs:enumeration value='4800'/>\r\n"
+"    <xs:enumeration value='9600'/>\r\n"
+"    <xs:enumeration value='19200'/>\r\n"
+"    <xs:enumeration value='38400'/>\r\n"
+"    <xs:enumeration value='57600'/>\r\n"
+"    <xs:enumeration value='115200'/>\r\n"
+"  </xs:restriction>\r\n"
+"</xs:simpleType>\r\n"
+"<xs:simpleType name='modbusParityType'>\r\n"
+"  <xs:restriction base='xs:string'>\r\n"
+"    <xs:enumeration value='none'/>\r\n"
+"    <xs:enumeration value='even'/>\r\n"
+"    <xs:enumeration value='odd'/>\r\n"
+"  </xs:restriction>\r\n"
+"</xs:simpleType>\r\n"
+"<xs:simpleType name='modbusStopBitsType'>\r\n"
+"  <xs:restriction base='xs:integer'>\r\n"
+"    <xs:minInclusive value='1'/>\r\n"
+"    <xs:maxInclusive value='2'/>\r\n"
+"  </xs:restriction>\r\n"
+"</xs:simpleType>\r\n"
+"<xs:group name='modbusTCPSettings'>\r\n"
+"  <xs:sequence>\r\n"
+"    <xs:element name='host'     type='validStringType'/>\r\n"
+"    <xs:element name='port'     type='modbusPortType'     minOccurs='0' maxOccurs='1'/>\r\n"
+"    <xs:element name='timeout'  type='modbusTimeoutType'  minOccurs='0' maxOccurs='1'/>\r\n"
+"    <xs:element name='rate'     type='modbusRateType'     minOccurs='0' maxOccurs='1'/>\r\n"
+"    <xs:element name='gap'      type='modbusGapType'      minOccurs='0' maxOccurs='1'/>\r\n"
+"    <xs:element name='pipeline' type='modbusPipelineType' minOccurs='0' maxOccurs='1'/>\r\n"
+"  </xs:sequence>\r\n"
+"</xs:group>\r\n"
+"<xs:group name='modbusRTUSettings'>\r\n"
+"  <xs:sequence>\r\n"
+"    <xs:element name='serial'   type='validStringType'/>\r\n"
+"    <xs:element name='baud'     type='modbusBaudType'     minOccurs='0' maxOccurs='1'/>\r\n"
+"    <xs:element name='parity'   type='modbusParityType'   minOccurs='0' maxOccurs='1'/>\r\n"
+"    <xs:element name='stopbits' type='modbusStopBitsType' minOccurs='0' maxOccurs='1'/>\r\n"
+"    <xs:element name='timeout'  type='modbusTimeoutType'  minOccurs='0' maxOccurs='1'/>\r\n"
+"    <xs:element name='rate'     type='modbusRateType'     minOccurs='0' maxOccurs='1'/>\r\n"
+"    <xs:element name='gap'      type='modbusGapType'      minOccurs='0' maxOccurs='1'/>\r\n"
+"  </xs:sequence>\r\n"
+"</xs:group>\r\n"
+"<xs:complexType name='modbusInputType'>\r\n"
+"  <xs:all>\r\n"
+"    <xs:element name='name'            type='deviceNameType'/>\r\n"
+"    <xs:element name='username'        type='userNameType' minOccurs='0' maxOccurs='1'/>\r\n"
+"    <xs:element name='userdescription' type='userDescriptionType' minOccurs='0' maxOccurs='1'/>\r\n"
+"    <xs:element name='slave'           type='modbusSlaveType'/>\r\n"
+"    <xs:element name='table'           type='modbusTableType'/>\r\n"
+"    <xs:element name='address'         type='modbusAddressType'/>\r\n"
+"    <xs:element name='format'          type='modbusFormatType' minOccurs='0' maxOccurs='1'/>\r\n"
+"    <xs:element name='wordswap'        type='xs:boolean' minOccurs='0' maxOccurs='1'/>\r\n"
+"    <xs:element name='scale'           type='xs:decimal' minOccurs='0' maxOccurs='1'/>\r\n"
+"    <xs:element name='offset'          type='xs:decimal' minOccurs='0' maxOccurs='1'/>\r\n"
+"    <xs:element name='interval'        type='modbusIntervalType' minOccurs='0' maxOccurs='1'/>\r\n"
+"    <xs:element name='filter'          type='inputFilterType' minOccurs='0' maxOccurs='1'/>\r\n"
+"  </xs:all>\r\n"
+"</xs:complexType>\r\n"
+"<xs:group name='modbusInputs'>\r\n"
+"  <xs:choice>\r\n"
+"    <xs:element name='temperature' type='modbusInputType'/>\r\n"
+"    <xs:element name='ph'          type='modbusInputType'/>\r\n"
+"    <xs:element name='switch'      type='modbusInputType'/>\r\n"
+"    <xs:element name='integer'     type='modbusInputType'/>\r\n"
+"  </xs:choice>\r\n"
+"</xs:group>\r\n"
+"<xs:complexType name='modbusTCPInputsType'>\r\n"
+"  <xs:sequence>\r\n"
+"    <xs:group ref='modbusTCPSettings'/>\r\n"
+"    <xs:group ref='modbusInputs' minOccurs='1' maxOccurs='unbounded'/>\r\n"
+"  </xs:sequence>\r\n"
+"</xs:complexType>\r\n"
+"<xs:complexType name='modbusRTUInputsType'>\r\n"
+"  <xs:sequence>\r\n"
+"    <xs:group ref='modbusRTUSettings'/>\r\n"
+"    <xs:group ref='modbusInputs' minOccurs='1' maxOccurs='unbounded'/>\r\n"
+"  </xs:sequence>\r\n"
+"</xs:complexType>\r\n"
+"<xs:complexType name='modbusInputsType'>\r\n"
+"  <xs:choice minOccurs='1' maxOccurs='unbounded'>\r\n"
+"    <xs:element name='tcp' type='modbusTCPInputsType'/>\r\n"
+"    <xs:element name='rtu' type='modbusRTUInputsType'/>\r\n"
+"  </xs:choice>\r\n"
+"</xs:complexType>\r\n");
+
+static const QString modbusInputs =
+QStringLiteral("    <xs:element minOccurs='0' maxOccurs='1' name='modbus'  type='modbusInputsType'/>\r\n");
+
+static const QString modbusOutputTypes =
+QStringLiteral("<xs:simpleType name='modbusOutputTableType'>\r\n"
+"  <xs:restriction base='xs:string'>\r\n"
+"    <xs:enumeration value='coil'/>\r\n"
+"    <xs:enumeration value='holding'/>\r\n"
+"  </xs:restriction>\r\n"
+"</xs:simpleType>\r\n"
+"<xs:simpleType name='modbusHoldingTableType'>\r\n"
+"  <xs:restriction base='xs:string'>\r\n"
+"    <xs:enumeration value='holding'/>\r\n"
+"  </xs:restriction>\r\n"
+"</xs:simpleType>\r\n"
+"<xs:complexType name='modbusSwitchOutputType'>\r\n"
+"  <xs:all>\r\n"
+"    <xs:element name='name'            type='deviceNameType'/>\r\n"
+"    <xs:element name='username'        type='userNameType' minOccurs='0' maxOccurs='1'/>\r\n"
+"    <xs:element name='userdescription' type='userDescriptionType' minOccurs='0' maxOccurs='1'/>\r\n"
+"    <xs:element name='slave'           type='modbusSlaveType'/>\r\n"
+"    <xs:element name='table'           type='modbusOutputTableType'/>\r\n"
+"    <xs:element name='address'         type='modbusAddressType'/>\r\n"
+"  </xs:all>\r\n"
+"</xs:complexType>\r\n"
+"<xs:complexType name='modbusPWMOutputType'>\r\n"
+"  <xs:all>\r\n"
+"    <xs:element name='name'            type='deviceNameType'/>\r\n"
+"    <xs:element name='username'        type='userNameType' minOccurs='0' maxOccurs='1'/>\r\n"
+"    <xs:element name='userdescription' type='userDescriptionType' minOccurs='0' maxOccurs='1'/>\r\n"
+"    <xs:element name='slave'           type='modbusSlaveType'/>\r\n"
+"    <xs:element name='table'           type='modbusHoldingTableType'/>\r\n"
+"    <xs:element name='address'         type='modbusAddressType'/>\r\n"
+"    <xs:element name='resolution'      type='pwmResolutionType' minOccurs='0' maxOccurs='1'/>\r\n"
+"  </xs:all>\r\n"
+"</xs:complexType>\r\n"
+"<xs:group name='modbusOutputs'>\r\n"
+"  <xs:choice>\r\n"
+"    <xs:element name='switch' type='modbusSwitchOutputType'/>\r\n"
+"    <xs:element name='pwm'    type='modbusPWMOutputType'/>\r\n"
+"  </xs:choice>\r\n"
+"</xs:group>\r\n"
+"<xs:complexType name='modbusTCPOutputsType'>\r\n"
+"  <xs:sequence>\r\n"
+"    <xs:group ref='modbusTCPSettings'/>\r\n"
+"    <xs:group ref='modbusOutputs' minOccurs='1' maxOccurs='unbounded'/>\r\n"
+"  </xs:sequence>\r\n"
+"</xs:complexType>\r\n"
+"<xs:complexType name='modbusRTUOutputsType'>\r\n"
+"  <xs:sequence>\r\n"
+"    <xs:group ref='modbusRTUSettings'/>\r\n"
+"    <xs:group ref='modbusOutputs' minOccurs='1' maxOccurs='unbounded'/>\r\n"
+"  </xs:sequence>\r\n"
+"</xs:complexType>\r\n"
+"<xs:complexType name='modbusOutputsType'>\r\n"
+"  <xs:choice minOccurs='1' maxOccurs='unbounded'>\r\n"
+"    <xs:element name='tcp' type='modbusTCPOutputsType'/>\r\n"
+"    <xs:element name='rtu' type='modbusRTUOutputsType'/>\r\n"
+"  </xs:choice>\r\n"
+"</xs:complexType>\r\n");
+
+static const QString modbusOutputs =
+QStringLiteral("    <xs:element minOccurs='0' maxOccurs='1' name='modbus'  type='modbusOutputsType'/>\r\n");
+
+class TorcModbusXSDFactory : public TorcXSDFactory
+{
+  public:
+    void GetXSD(QMultiMap<QString,QString> &XSD) {
+        XSD.insert(XSD_INPUTTYPES, modbusInputTypes);
+        XSD.insert(XSD_INPUTS, modbusInputs);
+        XSD.insert(XSD_OUTPUTTYPES, modbusOutputTypes);
+        XSD.insert(XSD_OUTPUTS, modbusOutputs);
+    }
+
+} TorcModbusXSDFactory;
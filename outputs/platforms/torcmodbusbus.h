@@ -0,0 +1,189 @@
+#ifndef TORCMODBUSBUS_H
+#define TORCMODBUSBUS_H
+
+// Qt
+#include <QHash>
+
+// Torc
+#include "torcinput.h"
+#include "torcoutput.h"
+#include "torccentral.h"
+#include "torctemperatureinput.h"
+#include "torcphinput.h"
+#include "torcswitchinput.h"
+#include "torcintegerinput.h"
+#include "torcswitchoutput.h"
+#include "torcpwmoutput.h"
+#include "torcmodbusmaster.h"
+
+#define MODBUS_NAME QStringLiteral("modbus")
+
+class TorcModbusBus : public TorcDeviceHandler
+{
+  public:
+    TorcModbusBus();
+
+    static TorcModbusBus*       gTorcModbusBus;
+
+    void                        Create        (const QVariantMap &Details);
+    void                        Destroy       (void);
+    void                        RemoveDevices (const QStringList &UniqueIds, QStringList &Removed);
+
+  private:
+    QHash<QString, TorcInput*>  m_inputs;
+    QHash<QString, TorcOutput*> m_outputs;
+};
+
+class TorcModbusRegister
+{
+  public:
+    enum Format
+    {
+        UInt16 = 0,
+        Int16,
+        UInt32,
+        Int32,
+        Float32
+    };
+
+  public:
+    TorcModbusRegister(const QString &Connection, const QVariantMap &Settings, const QVariantMap &Details);
+   ~TorcModbusRegister();
+
+    static bool     ParseFormat    (const QString &Name, Format &Result);
+    static double   Decode         (const QVector<quint16> &Values, Format Type, bool WordSwap);
+
+    bool            Start          (TorcModbusListener *Listener);
+    void            Stop           (TorcModbusListener *Listener);
+    bool            Write          (TorcModbusListener *Listener, quint16 Value);
+    double          Scale          (const QVector<quint16> &Values) const;
+    QString         GetDescription (void) const;
+
+  private:
+    Q_DISABLE_COPY(TorcModbusRegister)
+    TorcModbusMaster       *m_master;
+    int                     m_slave;
+    TorcModbusMaster::Table m_table;
+    int                     m_address;
+    Format                  m_format;
+    bool                    m_wordSwap;
+    double                  m_scale;
+    double                  m_offset;
+    int                     m_interval;
+};
+
+class TorcModbusTemperatureInput final : public TorcTemperatureInput, public TorcModbusListener
+{
+    Q_OBJECT
+
+  public:
+    TorcModbusTemperatureInput(const QString &Connection, const QVariantMap &Settings, const QVariantMap &Details);
+    ~TorcModbusTemperatureInput();
+
+    QStringList GetDescription     (void) override;
+    void        ModbusValueRead    (const QVector<quint16> &Values, bool Valid) override;
+    void        ModbusValueWritten (const QVector<quint16> &Values, bool Success) override;
+
+  public slots:
+    void        Read               (double Value, bool Valid);
+
+  private:
+    TorcModbusRegister m_register;
+};
+
+class TorcModbuspHInput final : public TorcpHInput, public TorcModbusListener
+{
+    Q_OBJECT
+
+  public:
+    TorcModbuspHInput(const QString &Connection, const QVariantMap &Settings, const QVariantMap &Details);
+    ~TorcModbuspHInput();
+
+    QStringList GetDescription     (void) override;
+    void        ModbusValueRead    (const QVector<quint16> &Values, bool Valid) override;
+    void        ModbusValueWritten (const QVector<quint16> &Values, bool Success) override;
+
+  public slots:
+    void        Read               (double Value, bool Valid);
+
+  private:
+    TorcModbusRegister m_register;
+};
+
+class TorcModbusSwitchInput final : public TorcSwitchInput, public TorcModbusListener
+{
+    Q_OBJECT
+
+  public:
+    TorcModbusSwitchInput(const QString &Connection, const QVariantMap &Settings, const QVariantMap &Details);
+    ~TorcModbusSwitchInput();
+
+    QStringList GetDescription     (void) override;
+    void        ModbusValueRead    (const QVector<quint16> &Values, bool Valid) override;
+    void        ModbusValueWritten (const QVector<quint16> &Values, bool Success) override;
+
+  public slots:
+    void        Read               (double Value, bool Valid);
+
+  private:
+    TorcModbusRegister m_register;
+};
+
+class TorcModbusIntegerInput final : public TorcIntegerInput, public TorcModbusListener
+{
+    Q_OBJECT
+
+  public:
+    TorcModbusIntegerInput(const QString &Connection, const QVariantMap &Settings, const QVariantMap &Details);
+    ~TorcModbusIntegerInput();
+
+    QStringList GetDescription     (void) override;
+    void        ModbusValueRead    (const QVector<quint16> &Values, bool Valid) override;
+    void        ModbusValueWritten (const QVector<quint16> &Values, bool Success) override;
+
+  public slots:
+    void        Read               (double Value, bool Valid);
+
+  private:
+    TorcModbusRegister m_register;
+};
+
+class TorcModbusSwitchOutput final : public TorcSwitchOutput, public TorcModbusListener
+{
+    Q_OBJECT
+
+  public:
+    TorcModbusSwitchOutput(const QString &Connection, const QVariantMap &Settings, const QVariantMap &Details);
+    ~TorcModbusSwitchOutput();
+
+    QStringList GetDescription     (void) override;
+    void        ModbusValueRead    (const QVector<quint16> &Values, bool Valid) override;
+    void        ModbusValueWritten (const QVector<quint16> &Values, bool Success) override;
+
+  public slots:
+    void        SetValue           (double Value) override;
+
+  private:
+    TorcModbusRegister m_register;
+};
+
+class TorcModbusPWMOutput final : public TorcPWMOutput, public TorcModbusListener
+{
+    Q_OBJECT
+
+  public:
+    TorcModbusPWMOutput(const QString &Connection, const QVariantMap &Settings, const QVariantMap &Details);
+    ~TorcModbusPWMOutput();
+
+    QStringList GetDescription     (void) override;
+    void        ModbusValueRead    (const QVector<quint16> &Values, bool Valid) override;
+    void        ModbusValueWritten (const QVector<quint16> &Values, bool Success) override;
+
+  public slots:
+    void        SetValue           (double Value) override;
+
+  private:
+    TorcModbusRegister m_register;
+};
+
+#endif // TORCMODBUSBUS_H
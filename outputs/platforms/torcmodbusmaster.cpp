@@ -0,0 +1,1055 @@
+/* Class TorcModbusMaster
+*
+* This file is part of the Torc project.
+*
+* Copyright (C) Mark Kendall 2018
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+* USA.
+*/
+
+// Qt
+#include <QTcpSocket>
+
+// Torc
+#include "torclogging.h"
+#include "torcmodbusmaster.h"
+
+// Unix
+#if defined(Q_OS_UNIX)
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <string.h>
+#include <termios.h>
+#include <unistd.h>
+#endif
+
+// std
+#include <algorithm>
+
+static QMutex                          gMastersLock;
+static QHash<QString,TorcModbusMaster*> gMasters;
+
+static int GetInt(const QVariantMap &Details, const QString &Name, int Default)
+{
+    bool ok = false;
+    int result = Details.value(Name).toString().trimmed().toInt(&ok);
+    return ok ? result : Default;
+}
+
+static inline quint16 Get16(const QByteArray &Data, int Offset)
+{
+    return static_cast<quint16>((static_cast<quint8>(Data.at(Offset)) << 8) | static_cast<quint8>(Data.at(Offset + 1)));
+}
+
+static inline void Append16(QByteArray &Data, quint16 Value)
+{
+    Data.append(static_cast<char>(Value >> 8));
+    Data.append(static_cast<char>(Value & 0xff));
+}
+
+static inline bool IsBits(TorcModbusMaster::Table Type)
+{
+    return Type == TorcModbusMaster::Coil || Type == TorcModbusMaster::Discrete;
+}
+
+/*! \class TorcModbusMaster
+ *  \brief Poll and write the registers of Modbus slaves over TCP or a serial (RTU) line from a dedicated thread.
+ *
+ * Listeners register the range of registers (or coils/discrete inputs) they need and how often they must be read.
+ * Registers that are due at the same time are coalesced into as few requests as possible - contiguous (or, if a gap
+ * is allowed, nearly contiguous) ranges in the same table of the same slave are read with a single request of up to
+ * 125 registers or 2000 bits - and the results are split back out to each listener.
+ *
+ * Writes are queued and take priority over reads. Only the latest value queued for a register is written and a value
+ * that matches the last value successfully written is discarded.
+ *
+ * Over TCP, up to 'pipeline' requests are outstanding at once (matched to their responses by transaction id).
+ * A serial line has a single outstanding request. Requests to each slave can be limited to 'rate' per second, which
+ * many serial gateways and slow controllers need.
+ *
+ * Masters are shared by connection (e.g. tcp:192.168.1.10:502 or rtu:/dev/ttyUSB0) and stopped when the last user
+ * releases them. The connection settings are taken from the first user.
+ *
+ * \note Listeners are called from the master thread, with the master locked, so must not call back into the master.
+*/
+TorcModbusMaster* TorcModbusMaster::Acquire(const QString &Connection, const QVariantMap &Details)
+{
+    QMutexLocker locker(&gMastersLock);
+    TorcModbusMaster *master = gMasters.value(Connection);
+    if (!master)
+    {
+        master = new TorcModbusMaster(Connection, Details);
+        gMasters.insert(Connection, master);
+        master->start();
+    }
+    master->m_users++;
+    return master;
+}
+
+void TorcModbusMaster::Release(TorcModbusMaster *Master)
+{
+    if (!Master)
+        return;
+
+    {
+        QMutexLocker locker(&gMastersLock);
+        if (--Master->m_users > 0)
+            return;
+        gMasters.remove(Master->m_connection);
+    }
+
+    delete Master;
+}
+
+/// Return the name of the connection described by Details (i.e. the contents of <tcp> or <rtu>).
+QString TorcModbusMaster::GetConnection(bool Rtu, const QVariantMap &Details)
+{
+    if (Rtu)
+        return QStringLiteral("%1:%2").arg(MODBUS_RTU, Details.value(QStringLiteral("serial")).toString().trimmed());
+    return QStringLiteral("%1:%2:%3").arg(MODBUS_TCP, Details.value(QStringLiteral("host")).toString().trimmed())
+                                     .arg(GetInt(Details, QStringLiteral("port"), MODBUS_DEFAULT_PORT));
+}
+
+bool TorcModbusMaster::ParseTable(const QString &Name, Table &Result)
+{
+    QString name = Name.trimmed().toLower();
+    if (name == QStringLiteral("coil"))
+        Result = Coil;
+    else if (name == QStringLiteral("discrete"))
+        Result = Discrete;
+    else if (name == QStringLiteral("input"))
+        Result = Input;
+    else if (name == QStringLiteral("holding"))
+        Result = Holding;
+    else
+        return false;
+    return true;
+}
+
+/*! \brief Merge the ranges in Due into as few read requests as possible.
+ *
+ * Ranges for the same slave and table are merged if they overlap or are separated by no more than MaxGap unused
+ * registers, as long as the result does not exceed the maximum size of a single read.
+*/
+QList<TorcModbusMaster::Range> TorcModbusMaster::Coalesce(const QList<Range> &Due, int MaxGap)
+{
+    QList<Range> sorted = Due;
+    std::sort(sorted.begin(), sorted.end(), [](const Range &A, const Range &B)
+    {
+        if (A.slave != B.slave)
+            return A.slave < B.slave;
+        if (A.table != B.table)
+            return A.table < B.table;
+        return A.address < B.address;
+    });
+
+    QList<Range> result;
+    foreach (const Range &range, sorted)
+    {
+        if (!result.isEmpty())
+        {
+            Range &last = result.last();
+            int limit = IsBits(range.table) ? MODBUS_MAX_BITS : MODBUS_MAX_REGISTERS;
+            int end   = qMax(last.address + last.count, range.address + range.count);
+            if (last.slave == range.slave && last.table == range.table &&
+                range.address <= last.address + last.count + qMax(MaxGap, 0) && end - last.address <= limit)
+            {
+                last.count = end - last.address;
+                continue;
+            }
+        }
+        result.append(range);
+    }
+    return result;
+}
+
+/// Return the PDU (function code and data) to read Count registers (or bits) from Address.
+QByteArray TorcModbusMaster::EncodeRead(Table Type, int Address, int Count)
+{
+    QByteArray result;
+    switch (Type)
+    {
+        case Coil:     result.append(static_cast<char>(ReadCoils));            break;
+        case Discrete: result.append(static_cast<char>(ReadDiscreteInputs));   break;
+        case Input:    result.append(static_cast<char>(ReadInputRegisters));   break;
+        case Holding:  result.append(static_cast<char>(ReadHoldingRegisters)); break;
+    }
+    Append16(result, static_cast<quint16>(Address));
+    Append16(result, static_cast<quint16>(Count));
+    return result;
+}
+
+/*! \brief Return the PDU to write Values to Address.
+ *
+ * A single coil is written with function 5, a single holding register with function 6 and multiple holding registers
+ * with function 16. Returns an empty PDU for anything else (multiple coils or a read only table).
+*/
+QByteArray TorcModbusMaster::EncodeWrite(Table Type, int Address, const QVector<quint16> &Values)
+{
+    QByteArray result;
+    if (Values.isEmpty())
+        return result;
+
+    if (Type == Coil && Values.size() == 1)
+    {
+        result.append(static_cast<char>(WriteSingleCoil));
+        Append16(result, static_cast<quint16>(Address));
+        Append16(result, Values.first() ? 0xff00 : 0x0000);
+    }
+    else if (Type == Holding && Values.size() == 1)
+    {
+        result.append(static_cast<char>(WriteSingleRegister));
+        Append16(result, static_cast<quint16>(Address));
+        Append16(result, Values.first());
+    }
+    else if (Type == Holding && Values.size() <= MODBUS_MAX_WRITE)
+    {
+        result.append(static_cast<char>(WriteMultipleRegisters));
+        Append16(result, static_cast<quint16>(Address));
+        Append16(result, static_cast<quint16>(Values.size()));
+        result.append(static_cast<char>(Values.size() * 2));
+        foreach (quint16 value, Values)
+            Append16(result, value);
+    }
+    return result;
+}
+
+/*! \brief Check Response against Request and extract any values read.
+ *
+ * Bits are returned as 0 or 1. Returns false if the response does not match the request, setting Exception if the
+ * slave returned an exception.
+*/
+bool TorcModbusMaster::DecodeResponse(const QByteArray &Request, const QByteArray &Response, QVector<quint16> &Values, int &Exception)
+{
+    Values.clear();
+    Exception = 0;
+    if (Request.size() < 5 || Response.isEmpty())
+        return false;
+
+    quint8 function = static_cast<quint8>(Request.at(0));
+    quint8 reply    = static_cast<quint8>(Response.at(0));
+    if (reply == (function | 0x80))
+    {
+        Exception = Response.size() > 1 ? static_cast<quint8>(Response.at(1)) : 0;
+        return false;
+    }
+    if (reply != function)
+        return false;
+
+    int count = Get16(Request, 3);
+    switch (function)
+    {
+        case ReadCoils:
+        case ReadDiscreteInputs:
+        {
+            int bytes = (count + 7) / 8;
+            if (Response.size() != bytes + 2 || static_cast<quint8>(Response.at(1)) != bytes)
+                return false;
+            Values.reserve(count);
+            for (int i = 0; i < count; ++i)
+                Values.append((static_cast<quint8>(Response.at(2 + i / 8)) >> (i % 8)) & 1);
+            return true;
+        }
+        case ReadHoldingRegisters:
+        case ReadInputRegisters:
+        {
+            if (Response.size() != count * 2 + 2 || static_cast<quint8>(Response.at(1)) != count * 2)
+                return false;
+            Values.reserve(count);
+            for (int i = 0; i < count; ++i)
+                Values.append(Get16(Response, 2 + i * 2));
+            return true;
+        }
+        case WriteSingleCoil:
+        case WriteSingleRegister:
+            return Response == Request;
+        case WriteMultipleRegisters:
+            return Response == Request.left(5);
+        default:
+            break;
+    }
+    return false;
+}
+
+/// Wrap PDU in a Modbus TCP (MBAP) header.
+QByteArray TorcModbusMaster::EncodeTCP(quint16 Transaction, int Slave, const QByteArray &PDU)
+{
+    QByteArray result;
+    result.reserve(PDU.size() + 7);
+    Append16(result, Transaction);
+    Append16(result, 0);
+    Append16(result, static_cast<quint16>(PDU.size() + 1));
+    result.append(static_cast<char>(Slave));
+    result.append(PDU);
+    return result;
+}
+
+/*! \brief Remove a complete Modbus TCP frame from the front of Buffer.
+ *
+ * Returns false if Buffer does not yet contain a complete frame. Error is set if the data cannot be a Modbus frame,
+ * in which case the connection should be dropped.
+*/
+bool TorcModbusMaster::TakeTCPFrame(QByteArray &Buffer, quint16 &Transaction, int &Slave, QByteArray &PDU, bool &Error)
+{
+    Error = false;
+    if (Buffer.size() < 7)
+        return false;
+
+    int length = Get16(Buffer, 4);
+    if (Get16(Buffer, 2) != 0 || length < 2 || length > 254)
+    {
+        Error = true;
+        return false;
+    }
+
+    if (Buffer.size() < length + 6)
+        return false;
+
+    Transaction = Get16(Buffer, 0);
+    Slave       = static_cast<quint8>(Buffer.at(6));
+    PDU         = Buffer.mid(7, length - 1);
+    Buffer.remove(0, length + 6);
+    return true;
+}
+
+/// Return the RTU frame for PDU - the slave address, PDU and CRC.
+QByteArray TorcModbusMaster::EncodeRTU(int Slave, const QByteArray &PDU)
+{
+    QByteArray result;
+    result.reserve(PDU.size() + 3);
+    result.append(static_cast<char>(Slave));
+    result.append(PDU);
+    quint16 crc = CRC16(result);
+    result.append(static_cast<char>(crc & 0xff));
+    result.append(static_cast<char>(crc >> 8));
+    return result;
+}
+
+/*! \brief Return the length of the RTU response that begins with Frame.
+ *
+ * Returns 0 if more data is needed to tell and -1 if the function is not recognised.
+*/
+int TorcModbusMaster::GetRTULength(const QByteArray &Frame)
+{
+    if (Frame.size() < 2)
+        return 0;
+
+    quint8 function = static_cast<quint8>(Frame.at(1));
+    if (function & 0x80)
+        return 5;
+
+    switch (function)
+    {
+        case ReadCoils:
+        case ReadDiscreteInputs:
+        case ReadHoldingRegisters:
+        case ReadInputRegisters:
+            return Frame.size() < 3 ? 0 : static_cast<quint8>(Frame.at(2)) + 5;
+        case WriteSingleCoil:
+        case WriteSingleRegister:
+        case WriteMultipleRegisters:
+            return 8;
+        default:
+            break;
+    }
+    return -1;
+}
+
+/// The Modbus CRC (polynomial 0xA001 reflected, initial value 0xFFFF). The low byte is transmitted first.
+quint16 TorcModbusMaster::CRC16(const QByteArray &Data)
+{
+    quint16 crc = 0xffff;
+    foreach (char byte, Data)
+    {
+        crc ^= static_cast<quint8>(byte);
+        for (int i = 0; i < 8; ++i)
+            crc = (crc & 1) ? static_cast<quint16>((crc >> 1) ^ 0xa001) : static_cast<quint16>(crc >> 1);
+    }
+    return crc;
+}
+
+TorcModbusMaster::TorcModbusMaster(const QString &Connection, const QVariantMap &Details)
+  : TorcQThread(QStringLiteral("Modbus")),
+    m_connection(Connection),
+    m_rtu(Connection.startsWith(MODBUS_RTU)),
+    m_host(Details.value(QStringLiteral("host")).toString().trimmed()),
+    m_port(static_cast<quint16>(GetInt(Details, QStringLiteral("port"), MODBUS_DEFAULT_PORT))),
+    m_serial(Details.value(QStringLiteral("serial")).toString().trimmed()),
+    m_baud(GetInt(Details, QStringLiteral("baud"), MODBUS_DEFAULT_BAUD)),
+    m_parity(Details.value(QStringLiteral("parity")).toString().trimmed().toLower()),
+    m_stopBits(GetInt(Details, QStringLiteral("stopbits"), 1)),
+    m_timeout(qMax(GetInt(Details, QStringLiteral("timeout"), MODBUS_DEFAULT_TIMEOUT), 10)),
+    m_pipeline(m_rtu ? 1 : qBound(1, GetInt(Details, QStringLiteral("pipeline"), MODBUS_DEFAULT_PIPELINE), 64)),
+    m_spacing(0),
+    m_gap(qMax(GetInt(Details, QStringLiteral("gap"), 0), 0)),
+    m_users(0),
+    m_lock(),
+    m_wait(),
+    m_aborted(false),
+    m_clock(),
+    m_socket(nullptr),
+    m_fd(-1),
+    m_buffer(),
+    m_open(false),
+    m_nextOpen(0),
+    m_nextTransaction(1),
+    m_registers(),
+    m_writeOrder(),
+    m_writes(),
+    m_written(),
+    m_outstanding(),
+    m_nextSlot(),
+    m_requests(0),
+    m_responses(0),
+    m_errors(0),
+    m_timeouts(0),
+    m_registersRead(0),
+    m_writeRequests(0),
+    m_coalescedWrites(0),
+    m_maxOutstanding(0)
+{
+    int rate = GetInt(Details, QStringLiteral("rate"), 0);
+    if (rate > 0)
+        m_spacing = qMax(1000 / rate, 1);
+    m_clock.start();
+}
+
+TorcModbusMaster::~TorcModbusMaster()
+{
+    Stop();
+
+    QMutexLocker locker(&m_lock);
+    LOG(VB_GENERAL, LOG_INFO, QStringLiteral("Modbus '%1': %2 requests (%3 writes, %4 coalesced) %5 registers read, %6 errors, %7 timeouts, max outstanding %8")
+        .arg(m_connection).arg(m_requests).arg(m_writeRequests).arg(m_coalescedWrites).arg(m_registersRead)
+        .arg(m_errors).arg(m_timeouts).arg(m_maxOutstanding));
+}
+
+/*! \brief Read Count registers (or bits) from Address every Interval milliseconds and pass them to Listener.
+ *
+ * The first read is made as soon as possible.
+*/
+bool TorcModbusMaster::AddRegister(TorcModbusListener *Listener, int Slave, Table Type, int Address, int Count, int Interval)
+{
+    if (!Listener || Slave < 1 || Slave > 247 || Address < 0 || Count < 1 ||
+        Address + Count > 65536 || Count > (IsBits(Type) ? MODBUS_MAX_BITS : MODBUS_MAX_REGISTERS))
+    {
+        LOG(VB_GENERAL, LOG_ERR, QStringLiteral("Invalid Modbus register (slave %1 address %2 count %3)").arg(Slave).arg(Address).arg(Count));
+        return false;
+    }
+
+    QMutexLocker locker(&m_lock);
+    Register reg;
+    reg.listener = Listener;
+    reg.range    = { Slave, Type, Address, Count };
+    reg.interval = qMax(Interval, 1);
+    reg.nextRead = m_clock.elapsed();
+    reg.pending  = false;
+    m_registers.append(reg);
+    m_wait.wakeAll();
+    return true;
+}
+
+/// Stop reading registers for Listener. Any writes it queued are still made, but it is no longer told the result.
+void TorcModbusMaster::RemoveListener(TorcModbusListener *Listener)
+{
+    QMutexLocker locker(&m_lock);
+    for (int i = m_registers.size() - 1; i >= 0; --i)
+        if (m_registers.at(i).listener == Listener)
+            m_registers.removeAt(i);
+
+    QMutableHashIterator<quint64,PendingWrite> it(m_writes);
+    while (it.hasNext())
+        if (it.next().value().listener == Listener)
+            it.value().listener = nullptr;
+
+    QMutableMapIterator<quint16,Transaction> it2(m_outstanding);
+    while (it2.hasNext())
+        if (it2.next().value().listener == Listener)
+            it2.value().listener = nullptr;
+}
+
+/*! \brief Queue Values to be written to Address.
+ *
+ * Any write to the same register that has not yet been sent is replaced. Listener (which may be null) is told
+ * whether the write succeeded, unless the write is discarded because the register already holds Values.
+*/
+bool TorcModbusMaster::Write(TorcModbusListener *Listener, int Slave, Table Type, int Address, const QVector<quint16> &Values)
+{
+    if (Slave < 0 || Slave > 247 || EncodeWrite(Type, Address, Values).isEmpty())
+    {
+        LOG(VB_GENERAL, LOG_ERR, QStringLiteral("Invalid Modbus write (slave %1 address %2 count %3)").arg(Slave).arg(Address).arg(Values.size()));
+        return false;
+    }
+
+    PendingWrite write;
+    write.listener = Listener;
+    write.range    = { Slave, Type, Address, Values.size() };
+    write.values   = Values;
+    quint64 key    = WriteKey(write.range);
+
+    QMutexLocker locker(&m_lock);
+    QHash<quint64,PendingWrite>::iterator it = m_writes.find(key);
+    if (it != m_writes.end())
+    {
+        m_coalescedWrites++;
+        it.value() = write;
+        return true;
+    }
+
+    // a value that is already in the slave is discarded - unless a different value is on its way
+    bool sending = false;
+    foreach (const Transaction &request, m_outstanding)
+        if (request.write && WriteKey(request.range) == key)
+            sending = true;
+    QHash<quint64,QVector<quint16>>::const_iterator written = m_written.constFind(key);
+    if (!sending && written != m_written.constEnd() && written.value() == Values)
+    {
+        m_coalescedWrites++;
+        return true;
+    }
+
+    m_writes.insert(key, write);
+    m_writeOrder.append(key);
+    m_wait.wakeAll();
+    return true;
+}
+
+/// Stop the thread once every queued write has been made.
+void TorcModbusMaster::Stop(void)
+{
+    {
+        QMutexLocker locker(&m_lock);
+        m_aborted = true;
+        m_wait.wakeAll();
+    }
+    wait();
+}
+
+QString TorcModbusMaster::GetConnection(void) const
+{
+    return m_connection;
+}
+
+QVariantMap TorcModbusMaster::GetStatistics(void)
+{
+    QMutexLocker locker(&m_lock);
+    QVariantMap result;
+    result.insert(QStringLiteral("connected"),       m_open);
+    result.insert(QStringLiteral("requests"),        m_requests);
+    result.insert(QStringLiteral("responses"),       m_responses);
+    result.insert(QStringLiteral("errors"),          m_errors);
+    result.insert(QStringLiteral("timeouts"),        m_timeouts);
+    result.insert(QStringLiteral("registersRead"),   m_registersRead);
+    result.insert(QStringLiteral("writes"),          m_writeRequests);
+    result.insert(QStringLiteral("coalescedWrites"), m_coalescedWrites);
+    result.insert(QStringLiteral("outstanding"),     m_outstanding.size());
+    result.insert(QStringLiteral("maxOutstanding"),  m_maxOutstanding);
+    return result;
+}
+
+void TorcModbusMaster::Start(void)
+{
+}
+
+void TorcModbusMaster::Finish(void)
+{
+}
+
+void TorcModbusMaster::run(void)
+{
+    Initialise();
+
+    QMutexLocker locker(&m_lock);
+    forever
+    {
+        qint64 now = m_clock.elapsed();
+        if (!m_open && !m_aborted && now >= m_nextOpen)
+        {
+            locker.unlock();
+            bool open = Open();
+            locker.relock();
+            now = m_clock.elapsed();
+            m_open = open;
+            if (!open)
+                m_nextOpen = now + MODBUS_RECONNECT_DELAY;
+        }
+
+        if (m_open)
+        {
+            // writes first, then as many reads as the pipeline (and each slave's rate) allows
+            SendWrites(now);
+            if (!m_aborted)
+                SendReads(now);
+        }
+        else
+        {
+            FailDue(now);
+        }
+
+        if (m_aborted && m_writeOrder.isEmpty() && m_outstanding.isEmpty())
+            break;
+
+        qint64 deadline = NextDeadline(now);
+        if (m_open && !m_outstanding.isEmpty())
+        {
+            if (m_rtu)
+            {
+                Transaction request = m_outstanding.first();
+                QByteArray response;
+                locker.unlock();
+                bool success = ExchangeRTU(EncodeRTU(request.slave, request.pdu), response);
+                locker.relock();
+
+                m_outstanding.remove(request.id);
+                if (!success)
+                    m_timeouts++;
+                Complete(request, response);
+            }
+            else
+            {
+                // NB new writes are picked up at least every 10ms while waiting for a response
+                locker.unlock();
+                (void)m_socket->waitForReadyRead(static_cast<int>(qBound((qint64)1, deadline - now, (qint64)10)));
+                locker.relock();
+                ReadResponses();
+            }
+        }
+        else
+        {
+            m_wait.wait(&m_lock, static_cast<unsigned long>(qMax(deadline - now, (qint64)1)));
+        }
+    }
+
+    Close();
+    locker.unlock();
+
+    Deinitialise();
+}
+
+bool TorcModbusMaster::Open(void)
+{
+    if (!m_rtu)
+    {
+        m_socket = new QTcpSocket();
+        m_socket->connectToHost(m_host, m_port);
+        if (!m_socket->waitForConnected(m_timeout))
+        {
+            LOG(VB_GENERAL, LOG_ERR, QStringLiteral("Failed to connect to Modbus server %1:%2 (%3)")
+                .arg(m_host).arg(m_port).arg(m_socket->errorString()));
+            delete m_socket;
+            m_socket = nullptr;
+            return false;
+        }
+        m_socket->setSocketOption(QAbstractSocket::LowDelayOption, 1);
+        LOG(VB_GENERAL, LOG_INFO, QStringLiteral("Connected to Modbus server %1:%2").arg(m_host).arg(m_port));
+        return true;
+    }
+
+#if defined(Q_OS_UNIX)
+    m_fd = open(m_serial.toLocal8Bit().constData(), O_RDWR | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+    if (m_fd < 0)
+    {
+        LOG(VB_GENERAL, LOG_ERR, QStringLiteral("Failed to open '%1' (err: %2)").arg(m_serial, strerror(errno)));
+        return false;
+    }
+
+    speed_t speed = B9600;
+    switch (m_baud)
+    {
+        case 1200:   speed = B1200;   break;
+        case 2400:   speed = B2400;   break;
+        case 4800:   speed = B4800;   break;
+        case 9600:   speed = B9600;   break;
+        case 19200:  speed = B19200;  break;
+        case 38400:  speed = B38400;  break;
+        case 57600:  speed = B57600;  break;
+        case 115200: speed = B115200; break;
+        default:
+            LOG(VB_GENERAL, LOG_WARNING, QStringLiteral("Unsupported baud rate %1 - using 9600").arg(m_baud));
+    }
+
+    struct termios options;
+    if (tcgetattr(m_fd, &options) < 0)
+    {
+        LOG(VB_GENERAL, LOG_ERR, QStringLiteral("Failed to read settings for '%1' (err: %2)").arg(m_serial, strerror(errno)));
+        close(m_fd);
+        m_fd = -1;
+        return false;
+    }
+
+    cfmakeraw(&options);
+    options.c_cflag |= CLOCAL | CREAD;
+    options.c_cflag &= ~(PARENB | PARODD | CSTOPB);
+    if (m_parity == QStringLiteral("even"))
+        options.c_cflag |= PARENB;
+    else if (m_parity == QStringLiteral("odd"))
+        options.c_cflag |= PARENB | PARODD;
+    if (m_stopBits == 2)
+        options.c_cflag |= CSTOPB;
+    cfsetispeed(&options, speed);
+    cfsetospeed(&options, speed);
+    if (tcsetattr(m_fd, TCSANOW, &options) < 0)
+    {
+        LOG(VB_GENERAL, LOG_ERR, QStringLiteral("Failed to configure '%1' (err: %2)").arg(m_serial, strerror(errno)));
+        close(m_fd);
+        m_fd = -1;
+        return false;
+    }
+
+    LOG(VB_GENERAL, LOG_INFO, QStringLiteral("Opened Modbus RTU line '%1' at %2").arg(m_serial).arg(m_baud));
+    return true;
+#else
+    LOG(VB_GENERAL, LOG_ERR, QStringLiteral("Modbus RTU is not supported on this platform"));
+    return false;
+#endif
+}
+
+void TorcModbusMaster::Close(void)
+{
+    FailOutstanding();
+
+    if (m_socket)
+    {
+        m_socket->abort();
+        delete m_socket;
+        m_socket = nullptr;
+    }
+
+#if defined(Q_OS_UNIX)
+    if (m_fd > -1)
+        close(m_fd);
+#endif
+    m_fd = -1;
+    m_buffer.clear();
+    m_open = false;
+}
+
+bool TorcModbusMaster::CanSend(int Slave, qint64 Now) const
+{
+    return m_spacing < 1 || m_nextSlot.value(Slave, 0) <= Now;
+}
+
+void TorcModbusMaster::Send(Transaction &Request, qint64 Now)
+{
+    Request.id   = m_nextTransaction++;
+    Request.sent = Now;
+    if (m_spacing > 0)
+        m_nextSlot.insert(Request.slave, Now + m_spacing);
+
+    // serial requests are sent from the main loop, one at a time
+    if (m_socket)
+    {
+        m_socket->write(EncodeTCP(Request.id, Request.slave, Request.pdu));
+        m_socket->flush();
+    }
+
+    m_outstanding.insert(Request.id, Request);
+    m_requests++;
+    if (Request.write)
+        m_writeRequests++;
+    if (m_outstanding.size() > m_maxOutstanding)
+        m_maxOutstanding = m_outstanding.size();
+}
+
+void TorcModbusMaster::SendWrites(qint64 Now)
+{
+    QMutableListIterator<quint64> it(m_writeOrder);
+    while (it.hasNext() && m_outstanding.size() < m_pipeline)
+    {
+        quint64 key = it.next();
+        PendingWrite write = m_writes.value(key);
+        if (!CanSend(write.range.slave, Now))
+            continue;
+
+        Transaction request;
+        request.slave    = write.range.slave;
+        request.pdu      = EncodeWrite(write.range.table, write.range.address, write.values);
+        request.write    = true;
+        request.range    = write.range;
+        request.listener = write.listener;
+        request.values   = write.values;
+        m_writes.remove(key);
+        it.remove();
+        Send(request, Now);
+    }
+}
+
+void TorcModbusMaster::SendReads(qint64 Now)
+{
+    if (m_outstanding.size() >= m_pipeline)
+        return;
+
+    QList<Range> due;
+    foreach (const Register &reg, m_registers)
+        if (!reg.pending && reg.nextRead <= Now && CanSend(reg.range.slave, Now))
+            due.append(reg.range);
+    if (due.isEmpty())
+        return;
+
+    QList<Range> requests = Coalesce(due, m_gap);
+    foreach (const Range &range, requests)
+    {
+        if (m_outstanding.size() >= m_pipeline)
+            break;
+        // NB a rate limited slave only gets one request per slot - the rest wait
+        if (!CanSend(range.slave, Now))
+            continue;
+
+        for (int i = 0; i < m_registers.size(); ++i)
+        {
+            Register &reg = m_registers[i];
+            if (reg.pending || reg.nextRead > Now || reg.range.slave != range.slave || reg.range.table != range.table ||
+                reg.range.address < range.address || reg.range.address + reg.range.count > range.address + range.count)
+            {
+                continue;
+            }
+            reg.pending  = true;
+            reg.nextRead += reg.interval;
+            if (reg.nextRead <= Now)
+                reg.nextRead = Now + reg.interval;
+        }
+
+        Transaction request;
+        request.slave    = range.slave;
+        request.pdu      = EncodeRead(range.table, range.address, range.count);
+        request.write    = false;
+        request.range    = range;
+        request.listener = nullptr;
+        Send(request, Now);
+    }
+}
+
+/// Process any TCP responses and fail requests that have timed out.
+void TorcModbusMaster::ReadResponses(void)
+{
+    if (m_socket->state() != QAbstractSocket::ConnectedState)
+    {
+        LOG(VB_GENERAL, LOG_WARNING, QStringLiteral("Lost connection to Modbus server %1:%2").arg(m_host).arg(m_port));
+        Close();
+        m_nextOpen = m_clock.elapsed() + MODBUS_RECONNECT_DELAY;
+        return;
+    }
+
+    m_buffer.append(m_socket->readAll());
+    quint16 id  = 0;
+    int slave   = 0;
+    bool error  = false;
+    QByteArray pdu;
+    while (TakeTCPFrame(m_buffer, id, slave, pdu, error))
+    {
+        QMap<quint16,Transaction>::iterator it = m_outstanding.find(id);
+        if (it == m_outstanding.end() || it.value().slave != slave)
+        {
+            LOG(VB_GENERAL, LOG_WARNING, QStringLiteral("Unexpected Modbus response (transaction %1 slave %2)").arg(id).arg(slave));
+            continue;
+        }
+        Transaction request = it.value();
+        m_outstanding.erase(it);
+        Complete(request, pdu);
+    }
+
+    if (error)
+    {
+        LOG(VB_GENERAL, LOG_ERR, QStringLiteral("Invalid data from Modbus server %1:%2 - reconnecting").arg(m_host).arg(m_port));
+        Close();
+        m_nextOpen = m_clock.elapsed();
+        return;
+    }
+
+    qint64 now = m_clock.elapsed();
+    QMutableMapIterator<quint16,Transaction> it(m_outstanding);
+    while (it.hasNext())
+    {
+        it.next();
+        if (now - it.value().sent < m_timeout)
+            continue;
+        Transaction request = it.value();
+        it.remove();
+        m_timeouts++;
+        LOG(VB_GENERAL, LOG_WARNING, QStringLiteral("Modbus request to slave %1 timed out").arg(request.slave));
+        Complete(request, QByteArray());
+    }
+}
+
+/// Pass the result of Request to its listener(s). An empty Response is a failure (e.g. a timeout).
+void TorcModbusMaster::Complete(const Transaction &Request, const QByteArray &Response)
+{
+    QVector<quint16> values;
+    int exception = 0;
+    bool success = DecodeResponse(Request.pdu, Response, values, exception);
+    if (!Response.isEmpty())
+    {
+        m_responses++;
+        if (!success)
+        {
+            m_errors++;
+            LOG(VB_GENERAL, LOG_WARNING, QStringLiteral("Modbus request (function %1) to slave %2 failed (exception %3)")
+                .arg(static_cast<quint8>(Request.pdu.at(0))).arg(Request.slave).arg(exception));
+        }
+    }
+
+    if (Request.write)
+    {
+        quint64 key = WriteKey(Request.range);
+        if (success)
+            m_written.insert(key, Request.values);
+        else
+            m_written.remove(key);
+        if (Request.listener)
+            Request.listener->ModbusValueWritten(Request.values, success);
+        return;
+    }
+
+    if (success)
+        m_registersRead += static_cast<quint64>(values.size());
+
+    const Range &range = Request.range;
+    for (int i = 0; i < m_registers.size(); ++i)
+    {
+        Register &reg = m_registers[i];
+        if (!reg.pending || reg.range.slave != range.slave || reg.range.table != range.table ||
+            reg.range.address < range.address || reg.range.address + reg.range.count > range.address + range.count)
+        {
+            continue;
+        }
+        reg.pending = false;
+        reg.listener->ModbusValueRead(success ? values.mid(reg.range.address - range.address, reg.range.count) : QVector<quint16>(), success);
+    }
+}
+
+void TorcModbusMaster::FailOutstanding(void)
+{
+    QMap<quint16,Transaction> outstanding;
+    outstanding.swap(m_outstanding);
+    foreach (const Transaction &request, outstanding)
+        Complete(request, QByteArray());
+}
+
+/// Fail queued writes and due reads while there is no connection.
+void TorcModbusMaster::FailDue(qint64 Now)
+{
+    foreach (quint64 key, m_writeOrder)
+    {
+        PendingWrite write = m_writes.take(key);
+        m_written.remove(key);
+        if (write.listener)
+            write.listener->ModbusValueWritten(write.values, false);
+    }
+    m_writeOrder.clear();
+
+    for (int i = 0; i < m_registers.size(); ++i)
+    {
+        Register &reg = m_registers[i];
+        if (reg.pending || reg.nextRead > Now)
+            continue;
+        reg.nextRead = Now + reg.interval;
+        reg.listener->ModbusValueRead(QVector<quint16>(), false);
+    }
+}
+
+/// Return the time at which the main loop next has something to do.
+qint64 TorcModbusMaster::NextDeadline(qint64 Now) const
+{
+    qint64 deadline = Now + 1000;
+    if (!m_open && !m_aborted)
+        deadline = qMin(deadline, m_nextOpen);
+
+    // NB nothing can be sent until a response arrives if the pipeline is full
+    if (m_outstanding.size() < m_pipeline)
+    {
+        foreach (const Register &reg, m_registers)
+            if (!reg.pending)
+                deadline = qMin(deadline, qMax(reg.nextRead, m_spacing > 0 ? m_nextSlot.value(reg.range.slave, 0) : 0));
+        foreach (const PendingWrite &write, m_writes)
+            deadline = qMin(deadline, m_spacing > 0 ? m_nextSlot.value(write.range.slave, 0) : Now);
+    }
+
+    foreach (const Transaction &request, m_outstanding)
+        deadline = qMin(deadline, request.sent + m_timeout);
+    return qMax(deadline, Now);
+}
+
+/// Send Frame on the serial line and wait for the response, returning its PDU in Response.
+bool TorcModbusMaster::ExchangeRTU(const QByteArray &Frame, QByteArray &Response)
+{
+#if defined(Q_OS_UNIX)
+    (void)tcflush(m_fd, TCIOFLUSH);
+    if (write(m_fd, Frame.constData(), static_cast<size_t>(Frame.size())) != Frame.size())
+    {
+        LOG(VB_GENERAL, LOG_ERR, QStringLiteral("Failed to write to '%1' (err: %2)").arg(m_serial, strerror(errno)));
+        return false;
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+    QByteArray frame;
+    int length = 0;
+    forever
+    {
+        length = GetRTULength(frame);
+        if (length < 0)
+        {
+            LOG(VB_GENERAL, LOG_WARNING, QStringLiteral("Invalid Modbus RTU response on '%1'").arg(m_serial));
+            return false;
+        }
+        if (length > 0 && frame.size() >= length)
+            break;
+
+        int remaining = m_timeout - static_cast<int>(timer.elapsed());
+        if (remaining < 1)
+            return false;
+
+        struct pollfd fds;
+        fds.fd      = m_fd;
+        fds.events  = POLLIN;
+        fds.revents = 0;
+        int result = poll(&fds, 1, remaining);
+        if (result < 0 && errno == EINTR)
+            continue;
+        if (result < 1)
+            return false;
+
+        char buffer[256];
+        ssize_t size = read(m_fd, buffer, sizeof(buffer));
+        if (size < 0 && (errno == EAGAIN || errno == EINTR))
+            continue;
+        if (size < 1)
+            return false;
+        frame.append(buffer, static_cast<int>(size));
+    }
+
+    frame.truncate(length);
+    quint16 crc = static_cast<quint16>(static_cast<quint8>(frame.at(length - 2)) | (static_cast<quint8>(frame.at(length - 1)) << 8));
+    if (frame.at(0) != Frame.at(0) || CRC16(frame.left(length - 2)) != crc)
+    {
+        LOG(VB_GENERAL, LOG_WARNING, QStringLiteral("Corrupt Modbus RTU response on '%1'").arg(m_serial));
+        return false;
+    }
+
+    Response = frame.mid(1, length - 3);
+    return true;
+#else
+    (void)Frame;
+    (void)Response;
+    return false;
+#endif
+}
+
+quint64 TorcModbusMaster::WriteKey(const Range &Target)
+{
+    return (static_cast<quint64>(Target.slave) << 40) | (static_cast<quint64>(Target.table) << 32) | static_cast<quint64>(Target.address);
+}
@@ -0,0 +1,203 @@
+#ifndef TORCMODBUSMASTER_H
+#define TORCMODBUSMASTER_H
+
+// Qt
+#include <QMap>
+#include <QHash>
+#include <QMutex>
+#include <QVector>
+#include <QVariant>
+#include <QElapsedTimer>
+#include <QWaitCondition>
+
+// Torc
+#include "torcqthread.h"
+
+class QTcpSocket;
+
+#define MODBUS_TCP               QStringLiteral("tcp")
+#define MODBUS_RTU               QStringLiteral("rtu")
+#define MODBUS_DEFAULT_PORT      502
+#define MODBUS_DEFAULT_BAUD      9600
+#define MODBUS_DEFAULT_TIMEOUT   1000 // milliseconds
+#define MODBUS_DEFAULT_PIPELINE  4    // outstanding TCP transactions
+#define MODBUS_DEFAULT_INTERVAL  1000 // milliseconds
+#define MODBUS_RECONNECT_DELAY   5000 // milliseconds
+#define MODBUS_MAX_REGISTERS     125  // per read request
+#define MODBUS_MAX_BITS          2000 // per read request
+#define MODBUS_MAX_WRITE         123  // registers per write request
+
+class TorcModbusListener
+{
+  public:
+    TorcModbusListener() = default;
+    virtual ~TorcModbusListener() = default;
+
+    /// New values for the listener's registers (or bits, as 0 or 1). Called from the master thread.
+    virtual void    ModbusValueRead    (const QVector<quint16> &Values, bool Valid) = 0;
+    /// The result of a call to TorcModbusMaster::Write. Called from the master thread.
+    virtual void    ModbusValueWritten (const QVector<quint16> &Values, bool Success) = 0;
+
+  private:
+    Q_DISABLE_COPY(TorcModbusListener)
+};
+
+class TorcModbusMaster final : public TorcQThread
+{
+    Q_OBJECT
+
+  public:
+    enum Table
+    {
+        Coil = 0,
+        Discrete,
+        Input,
+        Holding
+    };
+
+    enum Function
+    {
+        ReadCoils              = 1,
+        ReadDiscreteInputs     = 2,
+        ReadHoldingRegisters   = 3,
+        ReadInputRegisters     = 4,
+        WriteSingleCoil        = 5,
+        WriteSingleRegister    = 6,
+        WriteMultipleRegisters = 16
+    };
+
+    class Range
+    {
+      public:
+        int         slave;
+        Table       table;
+        int         address;
+        int         count;
+    };
+
+  public:
+    static TorcModbusMaster* Acquire        (const QString &Connection, const QVariantMap &Details);
+    static void              Release        (TorcModbusMaster *Master);
+    static QString           GetConnection  (bool Rtu, const QVariantMap &Details);
+    static bool              ParseTable     (const QString &Name, Table &Result);
+
+    static QList<Range>      Coalesce       (const QList<Range> &Due, int MaxGap);
+    static QByteArray        EncodeRead     (Table Type, int Address, int Count);
+    static QByteArray        EncodeWrite    (Table Type, int Address, const QVector<quint16> &Values);
+    static bool              DecodeResponse (const QByteArray &Request, const QByteArray &Response,
+                                             QVector<quint16> &Values, int &Exception);
+    static QByteArray        EncodeTCP      (quint16 Transaction, int Slave, const QByteArray &PDU);
+    static bool              TakeTCPFrame   (QByteArray &Buffer, quint16 &Transaction, int &Slave,
+                                             QByteArray &PDU, bool &Error);
+    static QByteArray        EncodeRTU      (int Slave, const QByteArray &PDU);
+    static int               GetRTULength   (const QByteArray &Frame);
+    static quint16           CRC16          (const QByteArray &Data);
+
+  public:
+    TorcModbusMaster(const QString &Connection, const QVariantMap &Details);
+   ~TorcModbusMaster();
+
+    bool            AddRegister    (TorcModbusListener *Listener, int Slave, Table Type, int Address, int Count,
+                                    int Interval = MODBUS_DEFAULT_INTERVAL);
+    void            RemoveListener (TorcModbusListener *Listener);
+    bool            Write          (TorcModbusListener *Listener, int Slave, Table Type, int Address,
+                                    const QVector<quint16> &Values);
+    void            Stop           (void);
+    QString         GetConnection  (void) const;
+    QVariantMap     GetStatistics  (void);
+
+    void            Start          (void) override;
+    void            Finish         (void) override;
+
+  protected:
+    void            run            (void) override;
+
+  private:
+    class Register
+    {
+      public:
+        TorcModbusListener *listener;
+        Range       range;
+        qint64      interval;
+        qint64      nextRead;
+        bool        pending;
+    };
+
+    class PendingWrite
+    {
+      public:
+        TorcModbusListener *listener;
+        Range       range;
+        QVector<quint16> values;
+    };
+
+    class Transaction
+    {
+      public:
+        quint16     id;
+        int         slave;
+        QByteArray  pdu;
+        qint64      sent;
+        bool        write;
+        Range       range;
+        TorcModbusListener *listener;
+        QVector<quint16> values;
+    };
+
+  private:
+    bool            Open           (void);
+    void            Close          (void);
+    bool            CanSend        (int Slave, qint64 Now) const;
+    void            Send           (Transaction &Request, qint64 Now);
+    void            SendWrites     (qint64 Now);
+    void            SendReads      (qint64 Now);
+    void            ReadResponses  (void);
+    void            Complete       (const Transaction &Request, const QByteArray &Response);
+    void            FailOutstanding(void);
+    void            FailDue        (qint64 Now);
+    qint64          NextDeadline   (qint64 Now) const;
+    bool            ExchangeRTU    (const QByteArray &Frame, QByteArray &Response);
+    static quint64  WriteKey       (const Range &Target);
+
+  private:
+    Q_DISABLE_COPY(TorcModbusMaster)
+    QString         m_connection;
+    bool            m_rtu;
+    QString         m_host;
+    quint16         m_port;
+    QString         m_serial;
+    int             m_baud;
+    QString         m_parity;
+    int             m_stopBits;
+    int             m_timeout;
+    int             m_pipeline;
+    qint64          m_spacing;
+    int             m_gap;
+    int             m_users;
+    QMutex          m_lock;
+    QWaitCondition  m_wait;
+    bool            m_aborted;
+    QElapsedTimer   m_clock;
+    QTcpSocket     *m_socket;
+    int             m_fd;
+    QByteArray      m_buffer;
+    bool            m_open;
+    qint64          m_nextOpen;
+    quint16         m_nextTransaction;
+    QList<Register> m_registers;
+    QList<quint64>  m_writeOrder;
+    QHash<quint64,PendingWrite>     m_writes;
+    QHash<quint64,QVector<quint16>> m_written;
+    QMap<quint16,Transaction>       m_outstanding;
+    QHash<int,qint64>               m_nextSlot;
+    quint64         m_requests;
+    quint64         m_responses;
+    quint64         m_errors;
+    quint64         m_timeouts;
+    quint64         m_registersRead;
+    quint64         m_writeRequests;
+    quint64         m_coalescedWrites;
+    int             m_maxOutstanding;
+};
+
+#endif // TORCMODBUSMASTER_H
@@ -20,8 +20,12 @@
 * USA.
 */
 
+// Qt
+#include <QTextStream>
+
 // Torc
 #include "torclogging.h"
+#include "torcexitcodes.h"
 #include "torccentral.h"
 #include "torcpigpio.h"
 #include "torcinputs.h"
@@ -30,6 +34,10 @@
 // wiringPi
 #include "wiringPi.h"
 
+// function select values (as returned by getAlt) for the PWM alternate functions
+#define BCM_FSEL_ALT0 4
+#define BCM_FSEL_ALT5 2
+
 /*!
 * \page pi Torc on the Raspberry Pi
 * \section pitorc Introduction
@@ -137,6 +145,23 @@
 * The 'misc' directory in the source contains a script to run Torc as a service. Details are included in the file.
 *
 * \subsection Super user permissions
+*
+* \subsection pipwm PWM outputs.
+* Each GPIO PWM output uses the cheapest method available for its pin:
+* - kernel PWM channels (add 'dtoverlay=pwm-2chan' to /boot/config.txt) for pins 1 and 26 (first channel) and
+*   23 and 24 (second channel). These use no CPU. The overlay routes each channel to one pin only (GPIO 18 and 19 by
+*   default, i.e. pins 1 and 24) and a pin is only used if it is set to its PWM function - otherwise the next method
+*   is tried.
+* - hardware PWM on pin 1, through wiringPi.
+* - DMA timed PWM from the pigpio daemon, on any pin ('sudo apt-get install pigpio' and 'sudo systemctl enable pigpiod').
+* - software PWM, on any pin. This uses a real time thread for each pin (a large part of a core on smaller boards)
+*   and is only used if the output sets <software>true</software>.
+*
+* To compare the methods on your hardware, run (with Torc otherwise stopped):
+* \code
+* sudo torc -pwmbenchmark 1
+* \endcode
+* which reports the CPU used by each method while fading the given pin, against an idle baseline.
 */
 
 TorcPiGPIO* TorcPiGPIO::gPiGPIO = new TorcPiGPIO();
@@ -145,10 +170,63 @@ TorcPiGPIO::TorcPiGPIO()
   : m_inputs(),
     m_outputs(),
     m_pwmOutputs(),
-    m_setup(false)
+    m_setup(false),
+    m_pwmScheduler()
 {
     if (wiringPiSetup() > -1)
         m_setup = true;
+
+    // PWM providers - the scheduler prefers the cheapest
+    if (m_setup)
+    {
+        // kernel PWM channels (with the pwm-2chan overlay, GPIO 18 or 12 and GPIO 13 or 19) - but only for a pin
+        // whose mux selects the channel, as the overlay routes each channel to only one of its pins
+        QMap<int,QPair<int,int> > channels;
+        QMap<int,int> functions;
+        channels.insert(1,  qMakePair(0, 0)); // GPIO 18
+        functions.insert(1, BCM_FSEL_ALT5);
+        channels.insert(26, qMakePair(0, 0)); // GPIO 12
+        functions.insert(26, BCM_FSEL_ALT0);
+        channels.insert(23, qMakePair(0, 1)); // GPIO 13
+        functions.insert(23, BCM_FSEL_ALT0);
+        channels.insert(24, qMakePair(0, 1)); // GPIO 19
+        functions.insert(24, BCM_FSEL_ALT5);
+        m_pwmScheduler.AddProvider(new TorcSysfsPWMProvider(QStringLiteral("/sys/class/pwm"), channels, TORC_PWM_FREQUENCY, functions, getAlt));
+
+        // pigpiod and software PWM on any pin
+        QMap<int,int> gpios;
+        for (int pin = 0; pin < 32; ++pin)
+            if (wpiPinToGpio(pin) > -1)
+                gpios.insert(pin, wpiPinToGpio(pin));
+        m_pwmScheduler.AddProvider(new TorcPigpiodPWMProvider(QStringLiteral("127.0.0.1"), 8888, gpios));
+        m_pwmScheduler.AddProvider(new TorcWiringPiPWMProvider());
+        m_pwmScheduler.AddProvider(new TorcSoftPWMProvider());
+    }
+}
+
+/*! \brief Compare the CPU used by each PWM provider on the pin given with -pwmbenchmark.
+ *
+ * e.g. 'torc -pwmbenchmark 1' (with no other instance of Torc running). Software PWM is included.
+*/
+int TorcPiGPIO::RunPWMBenchmark(TorcCommandLine *CommandLine)
+{
+    if (!CommandLine || !gPiGPIO->m_setup)
+        return TORC_EXIT_UNKOWN_ERROR;
+
+    bool ok = false;
+    int pin = CommandLine->GetValue(QStringLiteral("pwmbenchmark")).toInt(&ok);
+    if (!ok || wpiPinToGpio(pin) < 0)
+    {
+        LOG(VB_GENERAL, LOG_ERR, QStringLiteral("Invalid pin for PWM benchmark"));
+        return TORC_EXIT_INVALID_CMDLINE;
+    }
+
+    QTextStream out(stdout);
+    out << QStringLiteral("PWM benchmark for pin %1 (10 seconds each, 50 updates per second)").arg(pin) << endl;
+    QStringList results = TorcPWMBenchmark::Run(gPiGPIO->m_pwmScheduler.GetProviders(), pin, 10000, 50);
+    foreach (const QString &result, results)
+        out << result << endl;
+    return TORC_EXIT_OK;
 }
 
 void TorcPiGPIO::Create(const QVariantMap &GPIO)
@@ -242,7 +320,7 @@ void TorcPiGPIO::Create(const QVariantMap &GPIO)
                     }
                     else if (type == QStringLiteral("pwm") && output)
                     {
-                        TorcPiPWMOutput* out = new TorcPiPWMOutput(number, pin);
+                        TorcPiPWMOutput* out = new TorcPiPWMOutput(number, &m_pwmScheduler, pin);
                         m_pwmOutputs.insert(number, out);
                     }
                     else
@@ -284,6 +362,53 @@ void TorcPiGPIO::Destroy(void)
     m_pwmOutputs.clear();
 }
 
+void TorcPiGPIO::RemoveDevices(const QStringList &UniqueIds, QStringList &Removed)
+{
+    QWriteLocker locker(&m_handlerLock);
+
+    QMutableMapIterator<int,TorcPiSwitchInput*> it(m_inputs);
+    while (it.hasNext())
+    {
+        it.next();
+        QString uniqueid = it.value()->GetUniqueId();
+        if (UniqueIds.contains(uniqueid))
+        {
+            TorcInputs::gInputs->RemoveInput(it.value());
+            it.value()->DownRef();
+            it.remove();
+            Removed.append(uniqueid);
+        }
+    }
+
+    QMutableMapIterator<int,TorcPiSwitchOutput*> it2(m_outputs);
+    while (it2.hasNext())
+    {
+        it2.next();
+        QString uniqueid = it2.value()->GetUniqueId();
+        if (UniqueIds.contains(uniqueid))
+        {
+            TorcOutputs::gOutputs->RemoveOutput(it2.value());
+            it2.value()->DownRef();
+            it2.remove();
+            Removed.append(uniqueid);
+        }
+    }
+
+    QMutableMapIterator<int,TorcPiPWMOutput*> it3(m_pwmOutputs);
+    while (it3.hasNext())
+    {
+        it3.next();
+        QString uniqueid = it3.value()->GetUniqueId();
+        if (UniqueIds.contains(uniqueid))
+        {
+            TorcOutputs::gOutputs->RemoveOutput(it3.value());
+            it3.value()->DownRef();
+            it3.remove();
+            Removed.append(uniqueid);
+        }
+    }
+}
+
 /* For revision 1 (original Pi Model b) boards, allow wiringPi pins 0 to 6.
  * Pin 7 is used by the kernel for the 1Wire bus.
  * Pins 8 and 9 are for I2C.
@@ -337,6 +462,7 @@ static const QString pigpioInputTypes = QStringLiteral(
 "    <xs:element name='username' type='userNameType' minOccurs='0' maxOccurs='1'/>\r\n"
 "    <xs:element name='userdescription' type='userDescriptionType' minOccurs='0' maxOccurs='1'/>\r\n"
 "    <xs:element name='gpiopinnumber'   type='gpioPinNumberType'/>\r\n"
+"    <xs:element name='filter'          type='inputFilterType' minOccurs='0' maxOccurs='1'/>\r\n"
 "  </xs:all>\r\n"
 "</xs:complexType>\r\n"
 "\r\n"
@@ -367,6 +493,8 @@ static const QString pigpioOutputTypes = QStringLiteral(
 "    <xs:element name='userdescription' type='userDescriptionType' minOccurs='0' maxOccurs='1'/>\r\n"
 "    <xs:element name='gpiopinnumber' type='gpioPinNumberType'/>\r\n"
 "    <xs:element name='default'  type='pwmNumberType'/>\r\n"
+"    <xs:element name='resolution' type='pwmResolutionType' minOccurs='0' maxOccurs='1'/>\r\n"
+"    <xs:element name='software' type='xs:boolean' minOccurs='0' maxOccurs='1'/>\r\n"
 "  </xs:all>\r\n"
 "</xs:complexType>\r\n"
 "\r\n"
@@ -10,6 +10,8 @@
 #include "torcpiswitchoutput.h"
 #include "torcpipwmoutput.h"
 #include "torcpiswitchinput.h"
+#include "torcpwmprovider.h"
+#include "torccommandline.h"
 
 #define PI_GPIO QStringLiteral("gpio")
 
@@ -20,15 +22,18 @@ class TorcPiGPIO : public TorcDeviceHandler
     ~TorcPiGPIO() = default;
 
     static TorcPiGPIO* gPiGPIO;
+    static int                 RunPWMBenchmark (TorcCommandLine *CommandLine);
 
     void                       Create      (const QVariantMap &GPIO);
     void                       Destroy     (void);
+    void                       RemoveDevices (const QStringList &UniqueIds, QStringList &Removed);
 
   private:
     QMap<int,TorcPiSwitchInput*>  m_inputs;
     QMap<int,TorcPiSwitchOutput*> m_outputs;
     QMap<int,TorcPiPWMOutput*>    m_pwmOutputs;
     bool                          m_setup;
+    TorcPWMScheduler              m_pwmScheduler;
 };
 
 #endif // TORCPIGPIO_H
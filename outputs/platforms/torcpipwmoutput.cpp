@@ -35,77 +35,191 @@
 #define DEFAULT_VALUE 0
 #define PI_PWM_RESOLUTION 1024
 
+/*! \class TorcWiringPiPWMProvider
+ *  \brief The Raspberry Pi's hardware PWM on pin 1 (BCM_GPIO 18), driven directly by wiringPi.
+*/
+TorcWiringPiPWMProvider::TorcWiringPiPWMProvider()
+  : TorcPWMProvider(),
+    m_open(false)
+{
+}
+
+QString TorcWiringPiPWMProvider::GetName(void) const
+{
+    return QStringLiteral("wiringPi");
+}
+
+int TorcWiringPiPWMProvider::GetCost(void) const
+{
+    return 1;
+}
+
+/// Hardware PWM only operates at 10bit accuracy.
+int TorcWiringPiPWMProvider::GetFixedRange(void) const
+{
+    return PI_PWM_RESOLUTION;
+}
+
+bool TorcWiringPiPWMProvider::CanProvide(int Pin)
+{
+    return Pin == TORC_HWPWM_PIN && !m_open;
+}
+
+bool TorcWiringPiPWMProvider::Open(int Pin, int /*Range*/)
+{
+    if (!CanProvide(Pin))
+        return false;
+
+    pinMode(Pin, PWM_OUTPUT);
+    pwmWrite(Pin, 0);
+    m_open = true;
+    return true;
+}
+
+bool TorcWiringPiPWMProvider::Write(int Pin, int Value)
+{
+    if (Pin != TORC_HWPWM_PIN || !m_open)
+        return false;
+    pwmWrite(Pin, Value);
+    return true;
+}
+
+void TorcWiringPiPWMProvider::Close(int Pin)
+{
+    if (Pin == TORC_HWPWM_PIN)
+        m_open = false;
+}
+
+/*! \class TorcSoftPWMProvider
+ *  \brief wiringPi's software PWM, available on any pin.
+ *
+ * Each pin uses a real time thread that toggles the pin in a loop - which uses a significant amount of CPU
+ * and may be subject to jitter under load. It is only used when enabled for an output (<software>).
+*/
+TorcSoftPWMProvider::TorcSoftPWMProvider()
+  : TorcPWMProvider(),
+    m_lock(),
+    m_open()
+{
+}
+
+QString TorcSoftPWMProvider::GetName(void) const
+{
+    return QStringLiteral("software");
+}
+
+int TorcSoftPWMProvider::GetCost(void) const
+{
+    return TORC_PWM_SOFTWARE_COST;
+}
+
+bool TorcSoftPWMProvider::CanProvide(int Pin)
+{
+    QMutexLocker locker(&m_lock);
+    return wpiPinToGpio(Pin) > -1 && !m_open.contains(Pin);
+}
+
+bool TorcSoftPWMProvider::Open(int Pin, int Range)
+{
+    QMutexLocker locker(&m_lock);
+    if (m_open.contains(Pin))
+        return false;
+
+    if (softPwmCreate(Pin, 0, Range) != 0)
+    {
+        LOG(VB_GENERAL, LOG_ERR, QStringLiteral("Failed to setup software PWM on pin %1").arg(Pin));
+        return false;
+    }
+
+    LOG(VB_GENERAL, LOG_WARNING, QStringLiteral("Using software PWM on pin %1: It MIGHT flicker...").arg(Pin));
+    m_open.append(Pin);
+    return true;
+}
+
+bool TorcSoftPWMProvider::Write(int Pin, int Value)
+{
+    QMutexLocker locker(&m_lock);
+    if (!m_open.contains(Pin))
+        return false;
+    softPwmWrite(Pin, Value);
+    return true;
+}
+
+void TorcSoftPWMProvider::Close(int Pin)
+{
+    QMutexLocker locker(&m_lock);
+    if (m_open.removeAll(Pin))
+        softPwmStop(Pin);
+}
+
 /*! \class TorcPiPWMOutput
  *  \brief A device to output PWM signals on the Raspberry Pi
  *
- * The Raspberry Pi supports 1 hardware PWM output on pin 1 (BCM_GPIPO 18).
- * For other pins, we use wiringPi's software PWM support and warn about its
- * usage (software PWM may utilise relatively large amounts of CPU and may be
- * subject to jitter under load - and nobody wants flickering LEDs!).
+ * The output is driven by the cheapest available TorcPWMProvider - a kernel PWM channel (pins 1, 23, 24 and 26
+ * with the pwm-2chan overlay), the pigpio daemon (any pin), or hardware PWM on pin 1 through wiringPi.
+ * wiringPi's software PWM is only used if <software> is set - it may utilise relatively large amounts of CPU
+ * and may be subject to jitter under load (and nobody wants flickering LEDs!).
  */
-TorcPiPWMOutput::TorcPiPWMOutput(int Pin, const QVariantMap &Details)
+TorcPiPWMOutput::TorcPiPWMOutput(int Pin, TorcPWMScheduler *Scheduler, const QVariantMap &Details)
   : TorcPWMOutput(DEFAULT_VALUE, QStringLiteral("PiGPIOPWMOutput"), Details, PI_PWM_RESOLUTION),
-    m_pin(Pin)
+    m_pin(Pin),
+    m_provider(nullptr)
 {
-    // hardware PWM only operates at default 10bit accuracy
-    if ((m_resolution != m_maxResolution) && (m_pin == TORC_HWPWM_PIN))
+    bool software = Details.value(QStringLiteral("software")).toString().trimmed() == QStringLiteral("true");
+    if (Scheduler)
+        m_provider = Scheduler->Open(m_pin, m_resolution, software);
+
+    // some providers only operate at a fixed accuracy
+    int fixed = m_provider ? m_provider->GetFixedRange() : 0;
+    if (fixed > 0 && m_resolution != (uint)fixed)
     {
-        m_resolution = m_maxResolution;
-        LOG(VB_GENERAL, LOG_WARNING, QStringLiteral("Ignoring user defined resolution for hardware PWM - defaulting to %1").arg(m_maxResolution));
+        m_resolution = fixed;
+        LOG(VB_GENERAL, LOG_WARNING, QStringLiteral("Ignoring user defined resolution for %1 PWM - defaulting to %2")
+            .arg(m_provider->GetName()).arg(fixed));
     }
 
-    int value = lround(DEFAULT_VALUE * (double)m_resolution);
+    if (m_provider)
+        (void)m_provider->Write(m_pin, lround(DEFAULT_VALUE * (double)m_resolution));
 
-    if (m_pin == TORC_HWPWM_PIN)
-    {
-        pinMode(m_pin, PWM_OUTPUT);
-        pwmWrite(m_pin, value);
-    }
-    else
-    {
-        if (softPwmCreate(m_pin, value, m_resolution) == 0)
-        {
-            LOG(VB_GENERAL, LOG_WARNING, QStringLiteral("Using software PWM on pin %1: It MIGHT flicker...").arg(m_pin));
-        }
-        else
-        {
-            LOG(VB_GENERAL, LOG_ERR, QStringLiteral("Failed to setup software PWM on pin %1").arg(m_pin));
-        }
-    }
+    // write from the gpio output queue
+    SetOutputQueue(PI_GPIO);
 }
 
 TorcPiPWMOutput::~TorcPiPWMOutput()
 {
+    DetachOutputQueue();
+
     // always return the pin to its default state.
     // we must do this here to trigger the correct SetValue implementation
     SetValue(defaultValue);
 
-    // shutdown the soft pwm thread
-    if (m_pin != TORC_HWPWM_PIN)
-        softPwmStop(m_pin);
+    if (m_provider)
+        m_provider->Close(m_pin);
 }
 
-
 QStringList TorcPiPWMOutput::GetDescription(void)
 {
-    return QStringList() << tr("Pin %1 PWM").arg(m_pin) << tr("Resolution %1").arg(m_resolution);
+    return QStringList() << tr("Pin %1 PWM").arg(m_pin) << tr("Resolution %1").arg(m_resolution)
+                         << (m_provider ? m_provider->GetName() : tr("Not available"));
 }
 
 void TorcPiPWMOutput::SetValue(double Value)
 {
     QMutexLocker locker(&lock);
 
+    // the value is published (at the output's resolution) once it has been applied
+    if (PostValue(lround(qBound(0.0, Value, 1.0) * (double)m_resolution) / (double)m_resolution))
+        return;
+
     double newdouble = Value;
     if (!ValueIsDifferent(newdouble))
         return;
 
-    int newvalue = lround(newdouble * (double)m_resolution);
-
-    if (m_pin == TORC_HWPWM_PIN)
-        pwmWrite(m_pin, newvalue);
-    else
-        softPwmWrite(m_pin, newvalue);
-
+    (void)ApplyValue(newdouble);
     TorcPWMOutput::SetValue(Value);
 }
 
+bool TorcPiPWMOutput::ApplyValue(double Value)
+{
+    return m_provider && m_provider->Write(m_pin, lround(Value * (double)m_resolution));
+}
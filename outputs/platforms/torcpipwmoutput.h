@@ -3,15 +3,52 @@
 
 // Torc
 #include "torcpwmoutput.h"
+#include "torcpwmprovider.h"
 
 #define TORC_HWPWM_PIN 1
 
+class TorcWiringPiPWMProvider final : public TorcPWMProvider
+{
+  public:
+    TorcWiringPiPWMProvider();
+   ~TorcWiringPiPWMProvider() = default;
+
+    QString     GetName       (void) const override;
+    int         GetCost       (void) const override;
+    int         GetFixedRange (void) const override;
+    bool        CanProvide    (int Pin) override;
+    bool        Open          (int Pin, int Range) override;
+    bool        Write         (int Pin, int Value) override;
+    void        Close         (int Pin) override;
+
+  private:
+    bool        m_open;
+};
+
+class TorcSoftPWMProvider final : public TorcPWMProvider
+{
+  public:
+    TorcSoftPWMProvider();
+   ~TorcSoftPWMProvider() = default;
+
+    QString     GetName       (void) const override;
+    int         GetCost       (void) const override;
+    bool        CanProvide    (int Pin) override;
+    bool        Open          (int Pin, int Range) override;
+    bool        Write         (int Pin, int Value) override;
+    void        Close         (int Pin) override;
+
+  private:
+    QMutex      m_lock;
+    QList<int>  m_open;
+};
+
 class TorcPiPWMOutput : public TorcPWMOutput
 {
     Q_OBJECT
 
   public:
-    TorcPiPWMOutput(int Pin, const QVariantMap &Details);
+    TorcPiPWMOutput(int Pin, TorcPWMScheduler *Scheduler, const QVariantMap &Details);
     ~TorcPiPWMOutput();
 
     QStringList GetDescription(void);
@@ -19,8 +56,13 @@ class TorcPiPWMOutput : public TorcPWMOutput
   public slots:
     void        SetValue (double Value);
 
+  protected:
+    bool        ApplyValue (double Value) override;
+
   private:
-    int         m_pin;
+    Q_DISABLE_COPY(TorcPiPWMOutput)
+    int              m_pin;
+    TorcPWMProvider *m_provider;
 };
 
 #endif // TORCPIPWMOUTPUT_H
@@ -37,10 +37,15 @@ TorcPiSwitchOutput::TorcPiSwitchOutput(int Pin, const QVariantMap &Details)
     // setup and initialise pin for output
     pinMode(m_pin, OUTPUT);
     digitalWrite(m_pin, DEFAULT_VALUE);
+
+    // write from the gpio output queue
+    SetOutputQueue(PI_GPIO);
 }
 
 TorcPiSwitchOutput::~TorcPiSwitchOutput()
 {
+    DetachOutputQueue();
+
     // always return the pin to its default state.
     // we must do this here to trigger the correct SetValue implementation
     SetValue(defaultValue);
@@ -58,10 +63,20 @@ void TorcPiSwitchOutput::SetValue(double Value)
     // as in TorcSwitchOutput::SetValue
     double newvalue = Value == 0.0 ? 0 : 1;
 
+    // the value is published once it has been applied
+    if (PostValue(newvalue))
+        return;
+
     // ignore same value updates
     if (qFuzzyCompare(newvalue + 1.0f, value + 1.0f))
         return;
 
-    digitalWrite(m_pin, newvalue);
+    (void)ApplyValue(newvalue);
     TorcSwitchOutput::SetValue(newvalue);
 }
+
+bool TorcPiSwitchOutput::ApplyValue(double Value)
+{
+    digitalWrite(m_pin, Value == 0.0 ? 0 : 1);
+    return true;
+}
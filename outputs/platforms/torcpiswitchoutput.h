@@ -17,6 +17,9 @@ class TorcPiSwitchOutput : public TorcSwitchOutput
   public slots:
     void        SetValue (double Value);
 
+  protected:
+    bool        ApplyValue (double Value) override;
+
   private:
     int         m_pin;
 };
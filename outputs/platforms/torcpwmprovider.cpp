@@ -0,0 +1,463 @@
+/* Class TorcPWMProvider/TorcPWMScheduler
+*
+* This file is part of the Torc project.
+*
+* Copyright (C) Mark Kendall 2018
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+* USA.
+*/
+
+// Qt
+#include <QDir>
+#include <QFileInfo>
+#include <QThread>
+#include <QElapsedTimer>
+
+// Torc
+#include "torclogging.h"
+#include "torccoreutils.h"
+#include "torcpwmprovider.h"
+
+// Linux
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+
+// pigpiod socket commands
+#define PIGPIO_MODES 0
+#define PIGPIO_PWM   5
+#define PIGPIO_PRS   6
+#define PIGPIO_PFS   7
+#define PIGPIO_OUTPUT 1
+
+/*! \class TorcPWMProvider
+ *  \brief A source of PWM signals for GPIO pins.
+ *
+ * Providers differ in which pins they can drive and what each output costs - from hardware PWM channels (no CPU
+ * once set) to software PWM, which uses a busy thread for each pin. TorcPWMScheduler assigns each output to the
+ * cheapest provider that is available.
+ *
+ * \sa TorcSysfsPWMProvider
+ * \sa TorcPigpiodPWMProvider
+*/
+int TorcPWMProvider::GetFixedRange(void) const
+{
+    return 0;
+}
+
+/*! \class TorcPWMScheduler
+ *  \brief Assign PWM outputs to the cheapest available provider.
+ *
+ * Software providers are only used when explicitly allowed. The scheduler owns its providers.
+*/
+TorcPWMScheduler::TorcPWMScheduler()
+  : m_lock(),
+    m_providers()
+{
+}
+
+TorcPWMScheduler::~TorcPWMScheduler()
+{
+    qDeleteAll(m_providers);
+}
+
+void TorcPWMScheduler::AddProvider(TorcPWMProvider *Provider)
+{
+    if (!Provider)
+        return;
+
+    QMutexLocker locker(&m_lock);
+    int index = 0;
+    while (index < m_providers.size() && m_providers.at(index)->GetCost() <= Provider->GetCost())
+        index++;
+    m_providers.insert(index, Provider);
+}
+
+/// Open Pin with the cheapest provider that can drive it, returning the provider or nullptr if there is none.
+TorcPWMProvider* TorcPWMScheduler::Open(int Pin, int Range, bool AllowSoftware)
+{
+    QMutexLocker locker(&m_lock);
+    bool software = false;
+    foreach (TorcPWMProvider *provider, m_providers)
+    {
+        if (!provider->CanProvide(Pin))
+            continue;
+
+        if (provider->GetCost() >= TORC_PWM_SOFTWARE_COST && !AllowSoftware)
+        {
+            software = true;
+            continue;
+        }
+
+        if (provider->Open(Pin, Range))
+        {
+            LOG(VB_GENERAL, LOG_INFO, QStringLiteral("Using %1 PWM for pin %2").arg(provider->GetName()).arg(Pin));
+            return provider;
+        }
+    }
+
+    if (software)
+        LOG(VB_GENERAL, LOG_ERR, QStringLiteral("No hardware PWM for pin %1 - software PWM must be enabled explicitly").arg(Pin));
+    else
+        LOG(VB_GENERAL, LOG_ERR, QStringLiteral("No PWM available for pin %1").arg(Pin));
+    return nullptr;
+}
+
+/// Return every provider, cheapest first.
+QList<TorcPWMProvider*> TorcPWMScheduler::GetProviders(void)
+{
+    QMutexLocker locker(&m_lock);
+    return m_providers;
+}
+
+/*! \class TorcSysfsPWMProvider
+ *  \brief Hardware PWM channels exported by the kernel through /sys/class/pwm.
+ *
+ * Pins maps each pin to the pwmchip and channel that drives it (on the Raspberry Pi, this requires the pwm or
+ * pwm-2chan device tree overlay). Pins that share a channel cannot be used together. The duty cycle file for each
+ * channel is kept open so that each update is a single write.
+ *
+ * A channel can usually be routed to one of several pins and only drives the pin(s) whose mux selects it. Functions
+ * maps a pin to the function that connects it to its channel and GetFunction reports the current function - a pin
+ * listed in Functions is only provided if the two match (so the scheduler falls through to the next provider
+ * rather than driving another pin).
+*/
+TorcSysfsPWMProvider::TorcSysfsPWMProvider(const QString &Root, const QMap<int,QPair<int,int> > &Pins, int Frequency,
+                                           const QMap<int,int> &Functions, TorcPinFunction GetFunction)
+  : TorcPWMProvider(),
+    m_lock(),
+    m_root(Root),
+    m_pins(Pins),
+    m_functions(Functions),
+    m_getFunction(GetFunction),
+    m_period(1000000000 / qMax(Frequency, 1)),
+    m_open()
+{
+}
+
+TorcSysfsPWMProvider::~TorcSysfsPWMProvider()
+{
+    foreach (int pin, m_open.keys())
+        Close(pin);
+}
+
+QString TorcSysfsPWMProvider::GetName(void) const
+{
+    return QStringLiteral("sysfs");
+}
+
+int TorcSysfsPWMProvider::GetCost(void) const
+{
+    return 0;
+}
+
+bool TorcSysfsPWMProvider::CanProvide(int Pin)
+{
+    QMutexLocker locker(&m_lock);
+    if (!m_pins.contains(Pin) || m_open.contains(Pin))
+        return false;
+
+    QPair<int,int> channel = m_pins.value(Pin);
+    if (InUse(channel))
+        return false;
+
+    if (m_functions.contains(Pin) && (!m_getFunction || m_getFunction(Pin) != m_functions.value(Pin)))
+    {
+        LOG(VB_GENERAL, LOG_INFO, QStringLiteral("Pin %1 is not routed to pwmchip%2 channel %3").arg(Pin).arg(channel.first).arg(channel.second));
+        return false;
+    }
+
+    bool ok = false;
+    int count = TorcCoreUtils::ReadSysfsAttribute(GetChip(channel.first) + QStringLiteral("npwm")).toInt(&ok);
+    return ok && channel.second < count;
+}
+
+bool TorcSysfsPWMProvider::Open(int Pin, int Range)
+{
+    QMutexLocker locker(&m_lock);
+    if (!m_pins.contains(Pin) || m_open.contains(Pin) || Range < 1)
+        return false;
+
+    QPair<int,int> channel = m_pins.value(Pin);
+    QString chip      = GetChip(channel.first);
+    QString directory = chip + QStringLiteral("pwm%1/").arg(channel.second);
+
+    if (!QDir(directory).exists())
+    {
+        (void)TorcCoreUtils::WriteSysfsAttribute(chip + QStringLiteral("export"), QByteArray::number(channel.second));
+
+        // the channel's attributes may not be writable until udev has finished with them
+        for (int i = 0; i < 20 && !QFileInfo(directory + QStringLiteral("period")).isWritable(); ++i)
+            QThread::msleep(10);
+    }
+
+    // the duty cycle cannot exceed the period - so clear it first
+    if (!TorcCoreUtils::WriteSysfsAttribute(directory + QStringLiteral("duty_cycle"), QByteArray("0")) ||
+        !TorcCoreUtils::WriteSysfsAttribute(directory + QStringLiteral("period"), QByteArray::number(m_period)) ||
+        !TorcCoreUtils::WriteSysfsAttribute(directory + QStringLiteral("enable"), QByteArray("1")))
+    {
+        LOG(VB_GENERAL, LOG_ERR, QStringLiteral("Failed to set up PWM channel '%1'").arg(directory));
+        return false;
+    }
+
+    int handle = open((directory + QStringLiteral("duty_cycle")).toLocal8Bit().constData(), O_WRONLY | O_CLOEXEC);
+    if (handle < 0)
+    {
+        LOG(VB_GENERAL, LOG_ERR, QStringLiteral("Failed to open '%1duty_cycle' (err: %2)").arg(directory).arg(strerror(errno)));
+        return false;
+    }
+
+    Channel entry = { directory, handle, Range };
+    m_open.insert(Pin, entry);
+    return true;
+}
+
+bool TorcSysfsPWMProvider::Write(int Pin, int Value)
+{
+    QMutexLocker locker(&m_lock);
+    QMap<int,Channel>::const_iterator it = m_open.constFind(Pin);
+    if (it == m_open.constEnd())
+        return false;
+
+    qint64 duty = (m_period * qBound(0, Value, it.value().range)) / it.value().range;
+    QByteArray value = QByteArray::number(duty);
+    return pwrite(it.value().handle, value.constData(), value.size(), 0) == value.size();
+}
+
+void TorcSysfsPWMProvider::Close(int Pin)
+{
+    QMutexLocker locker(&m_lock);
+    if (!m_open.contains(Pin))
+        return;
+
+    Channel channel = m_open.take(Pin);
+    close(channel.handle);
+    (void)TorcCoreUtils::WriteSysfsAttribute(channel.directory + QStringLiteral("enable"), QByteArray("0"));
+
+    QPair<int,int> pwm = m_pins.value(Pin);
+    (void)TorcCoreUtils::WriteSysfsAttribute(GetChip(pwm.first) + QStringLiteral("unexport"), QByteArray::number(pwm.second));
+}
+
+QString TorcSysfsPWMProvider::GetChip(int Chip) const
+{
+    return m_root + QStringLiteral("/pwmchip%1/").arg(Chip);
+}
+
+bool TorcSysfsPWMProvider::InUse(const QPair<int,int> &Channel) const
+{
+    foreach (int pin, m_open.keys())
+        if (m_pins.value(pin) == Channel)
+            return true;
+    return false;
+}
+
+/*! \class TorcPigpiodPWMProvider
+ *  \brief DMA timed PWM on any GPIO pin, using the pigpio daemon.
+ *
+ * pigpiod generates PWM from DMA (so uses very little CPU for any number of pins) and is controlled through its
+ * socket interface - so no additional libraries are required. Pins maps each pin to its Broadcom GPIO number.
+ * The daemon must be running (e.g. 'sudo systemctl enable pigpiod').
+*/
+TorcPigpiodPWMProvider::TorcPigpiodPWMProvider(const QString &Address, int Port, const QMap<int,int> &Pins, int Frequency)
+  : TorcPWMProvider(),
+    m_lock(),
+    m_address(Address),
+    m_port(Port),
+    m_pins(Pins),
+    m_frequency(Frequency),
+    m_socket(-1),
+    m_open()
+{
+}
+
+TorcPigpiodPWMProvider::~TorcPigpiodPWMProvider()
+{
+    foreach (int pin, m_open)
+        Close(pin);
+    if (m_socket > -1)
+        close(m_socket);
+}
+
+QString TorcPigpiodPWMProvider::GetName(void) const
+{
+    return QStringLiteral("pigpiod");
+}
+
+int TorcPigpiodPWMProvider::GetCost(void) const
+{
+    return 2;
+}
+
+bool TorcPigpiodPWMProvider::CanProvide(int Pin)
+{
+    QMutexLocker locker(&m_lock);
+    return m_pins.contains(Pin) && !m_open.contains(Pin) && Connect();
+}
+
+bool TorcPigpiodPWMProvider::Open(int Pin, int Range)
+{
+    QMutexLocker locker(&m_lock);
+    if (!m_pins.contains(Pin) || m_open.contains(Pin) || !Connect())
+        return false;
+
+    // NB the range is 25 to 40000
+    quint32 gpio = m_pins.value(Pin);
+    if (Command(PIGPIO_MODES, gpio, PIGPIO_OUTPUT) < 0 || Command(PIGPIO_PFS, gpio, m_frequency) < 0 ||
+        Command(PIGPIO_PRS, gpio, Range) < 0 || Command(PIGPIO_PWM, gpio, 0) < 0)
+    {
+        LOG(VB_GENERAL, LOG_ERR, QStringLiteral("Failed to set up PWM for GPIO %1 with pigpiod").arg(gpio));
+        return false;
+    }
+
+    m_open.append(Pin);
+    return true;
+}
+
+bool TorcPigpiodPWMProvider::Write(int Pin, int Value)
+{
+    QMutexLocker locker(&m_lock);
+    if (!m_open.contains(Pin))
+        return false;
+    return Command(PIGPIO_PWM, m_pins.value(Pin), qMax(Value, 0)) > -1;
+}
+
+void TorcPigpiodPWMProvider::Close(int Pin)
+{
+    QMutexLocker locker(&m_lock);
+    if (m_open.removeAll(Pin))
+        (void)Command(PIGPIO_PWM, m_pins.value(Pin), 0);
+}
+
+bool TorcPigpiodPWMProvider::Connect(void)
+{
+    if (m_socket > -1)
+        return true;
+
+    sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_port   = htons(m_port);
+    if (inet_pton(AF_INET, m_address.toLatin1().constData(), &address.sin_addr) != 1)
+        return false;
+
+    m_socket = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (m_socket < 0)
+        return false;
+
+    if (::connect(m_socket, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0)
+    {
+        close(m_socket);
+        m_socket = -1;
+        return false;
+    }
+
+    int nodelay = 1;
+    (void)setsockopt(m_socket, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
+    LOG(VB_GENERAL, LOG_INFO, QStringLiteral("Connected to pigpiod at %1:%2").arg(m_address).arg(m_port));
+    return true;
+}
+
+/// Send a command and return its result (negative on error). The connection is dropped on failure.
+int TorcPigpiodPWMProvider::Command(quint32 Command, quint32 Parameter1, quint32 Parameter2)
+{
+    if (m_socket < 0)
+        return -1;
+
+    // command, p1, p2 and the length of any extension (none) - in host (little endian) order
+    quint32 request[4]  = { Command, Parameter1, Parameter2, 0 };
+    quint32 response[4] = { 0, 0, 0, 0 };
+    if (send(m_socket, request, sizeof(request), MSG_NOSIGNAL) != (ssize_t)sizeof(request) ||
+        recv(m_socket, response, sizeof(response), MSG_WAITALL) != (ssize_t)sizeof(response))
+    {
+        LOG(VB_GENERAL, LOG_ERR, QStringLiteral("Lost connection to pigpiod"));
+        close(m_socket);
+        m_socket = -1;
+        return -1;
+    }
+
+    return static_cast<qint32>(response[3]);
+}
+
+static qint64 ProcessTime(void)
+{
+    timespec time;
+    if (clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &time) != 0)
+        return 0;
+    return (time.tv_sec * 1000000LL) + (time.tv_nsec / 1000);
+}
+
+/*! \class TorcPWMBenchmark
+ *  \brief Compare the CPU used by PWM providers.
+ *
+ * Each provider that can drive Pin fades it up and down, with Rate updates per second, for Duration milliseconds.
+ * The CPU time of the whole process is measured - so the threads used by software PWM are included - and compared
+ * with an idle baseline. Returns one line per provider.
+*/
+QStringList TorcPWMBenchmark::Run(const QList<TorcPWMProvider*> &Providers, int Pin, int Duration, int Rate)
+{
+    static const int range = 1024;
+    QStringList result;
+    int interval = 1000 / qBound(1, Rate, 1000);
+
+    for (int i = -1; i < Providers.size(); ++i)
+    {
+        TorcPWMProvider *provider = i < 0 ? nullptr : Providers.at(i);
+        QString name = provider ? provider->GetName() : QStringLiteral("idle");
+        if (provider && (!provider->CanProvide(Pin) || !provider->Open(Pin, range)))
+        {
+            result.append(QStringLiteral("%1: not available for pin %2").arg(name).arg(Pin));
+            continue;
+        }
+
+        quint64 writes = 0;
+        quint64 errors = 0;
+        qint64  writetime = 0;
+        QElapsedTimer wall;
+        QElapsedTimer timer;
+        qint64 cpu = ProcessTime();
+        wall.start();
+        while (wall.elapsed() < Duration)
+        {
+            if (provider)
+            {
+                int position = writes % (2 * range);
+                timer.start();
+                if (!provider->Write(Pin, position < range ? position : (2 * range) - position))
+                    errors++;
+                writetime += timer.nsecsElapsed();
+                writes++;
+            }
+            QThread::msleep(interval);
+        }
+        cpu = ProcessTime() - cpu;
+        qint64 elapsed = qMax(wall.elapsed(), (qint64)1);
+
+        if (provider)
+            provider->Close(Pin);
+
+        result.append(QStringLiteral("%1: cpu %2% (%3ms in %4ms) writes %5 errors %6 mean write %7us")
+                      .arg(name).arg((cpu / 10.0) / elapsed, 0, 'f', 1).arg(cpu / 1000).arg(elapsed)
+                      .arg(writes).arg(errors).arg(writes ? (writetime / 1000.0) / writes : 0.0, 0, 'f', 1));
+    }
+
+    return result;
+}
@@ -0,0 +1,125 @@
+#ifndef TORCPWMPROVIDER_H
+#define TORCPWMPROVIDER_H
+
+// Qt
+#include <QMap>
+#include <QPair>
+#include <QMutex>
+#include <QStringList>
+
+#define TORC_PWM_FREQUENCY     1000 // Hz
+#define TORC_PWM_SOFTWARE_COST 100
+
+/// Return the function (pin mux setting) currently selected for Pin, or a negative value if unknown.
+typedef int (*TorcPinFunction)(int Pin);
+
+/// A source of PWM signals for GPIO pins.
+class TorcPWMProvider
+{
+  public:
+    TorcPWMProvider() = default;
+    virtual ~TorcPWMProvider() = default;
+
+    virtual QString GetName       (void) const = 0;
+    /// The relative CPU cost of each PWM output. Software (bit-banged) providers cost TORC_PWM_SOFTWARE_COST or more.
+    virtual int     GetCost       (void) const = 0;
+    /// The only range (resolution) supported, or 0 if any range is supported.
+    virtual int     GetFixedRange (void) const;
+    virtual bool    CanProvide    (int Pin) = 0;
+    virtual bool    Open          (int Pin, int Range) = 0;
+    /// Set the duty cycle of Pin to Value (0 to Range). This may be called from any thread.
+    virtual bool    Write         (int Pin, int Value) = 0;
+    virtual void    Close         (int Pin) = 0;
+
+  private:
+    Q_DISABLE_COPY(TorcPWMProvider)
+};
+
+class TorcPWMScheduler
+{
+  public:
+    TorcPWMScheduler();
+   ~TorcPWMScheduler();
+
+    void            AddProvider   (TorcPWMProvider *Provider);
+    TorcPWMProvider* Open         (int Pin, int Range, bool AllowSoftware);
+    QList<TorcPWMProvider*> GetProviders (void);
+
+  private:
+    Q_DISABLE_COPY(TorcPWMScheduler)
+    QMutex                  m_lock;
+    QList<TorcPWMProvider*> m_providers;
+};
+
+class TorcSysfsPWMProvider final : public TorcPWMProvider
+{
+  public:
+    TorcSysfsPWMProvider(const QString &Root, const QMap<int,QPair<int,int> > &Pins, int Frequency = TORC_PWM_FREQUENCY,
+                         const QMap<int,int> &Functions = QMap<int,int>(), TorcPinFunction GetFunction = nullptr);
+   ~TorcSysfsPWMProvider();
+
+    QString         GetName       (void) const override;
+    int             GetCost       (void) const override;
+    bool            CanProvide    (int Pin) override;
+    bool            Open          (int Pin, int Range) override;
+    bool            Write         (int Pin, int Value) override;
+    void            Close         (int Pin) override;
+
+  private:
+    class Channel
+    {
+      public:
+        QString     directory;
+        int         handle;
+        int         range;
+    };
+
+    QString         GetChip       (int Chip) const;
+    bool            InUse         (const QPair<int,int> &Channel) const;
+
+  private:
+    Q_DISABLE_COPY(TorcSysfsPWMProvider)
+    QMutex                       m_lock;
+    QString                      m_root;
+    QMap<int,QPair<int,int> >    m_pins;
+    QMap<int,int>                m_functions;
+    TorcPinFunction              m_getFunction;
+    qint64                       m_period;
+    QMap<int,Channel>            m_open;
+};
+
+class TorcPigpiodPWMProvider final : public TorcPWMProvider
+{
+  public:
+    TorcPigpiodPWMProvider(const QString &Address, int Port, const QMap<int,int> &Pins, int Frequency = TORC_PWM_FREQUENCY);
+   ~TorcPigpiodPWMProvider();
+
+    QString         GetName       (void) const override;
+    int             GetCost       (void) const override;
+    bool            CanProvide    (int Pin) override;
+    bool            Open          (int Pin, int Range) override;
+    bool            Write         (int Pin, int Value) override;
+    void            Close         (int Pin) override;
+
+  private:
+    bool            Connect       (void);
+    int             Command       (quint32 Command, quint32 Parameter1, quint32 Parameter2);
+
+  private:
+    Q_DISABLE_COPY(TorcPigpiodPWMProvider)
+    QMutex          m_lock;
+    QString         m_address;
+    int             m_port;
+    QMap<int,int>   m_pins;
+    int             m_frequency;
+    int             m_socket;
+    QList<int>      m_open;
+};
+
+class TorcPWMBenchmark
+{
+  public:
+    static QStringList Run (const QList<TorcPWMProvider*> &Providers, int Pin, int Duration, int Rate);
+};
+
+#endif // TORCPWMPROVIDER_H
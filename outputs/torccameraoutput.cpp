@@ -741,3 +741,22 @@ void TorcCameraOutputs::Destroy(void)
     }
     m_cameras.clear();
 }
+
+void TorcCameraOutputs::RemoveDevices(const QStringList &UniqueIds, QStringList &Removed)
+{
+    QWriteLocker locker(&m_handlerLock);
+
+    QMutableHashIterator<QString, TorcCameraOutput*> it(m_cameras);
+    while (it.hasNext())
+    {
+        it.next();
+        QString uniqueid = it.value()->GetUniqueId();
+        if (UniqueIds.contains(uniqueid))
+        {
+            TorcOutputs::gOutputs->RemoveOutput(it.value());
+            it.value()->DownRef();
+            it.remove();
+            Removed.append(uniqueid);
+        }
+    }
+}
@@ -131,6 +131,7 @@ class TorcCameraOutputs final : public TorcDeviceHandler
 
     void Create  (const QVariantMap &Details) override;
     void Destroy (void) override;
+    void RemoveDevices (const QStringList &UniqueIds, QStringList &Removed) override;
 
   private:
     QHash<QString, TorcCameraOutput*> m_cameras;
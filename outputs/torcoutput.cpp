@@ -28,13 +28,18 @@
 
 #define BLACKLIST QStringLiteral("SetValue,SetValid")
 
+// NB batches belong to the thread that started them
+static thread_local int                gBatchDepth = 0;
+static thread_local QList<TorcOutput*> gBatched;
+
 // N.B. We need to pass the staticMetaObject to TorcHTTPService as the object is not yet complete.
 //      If we pass 'this' during construction, this->metaObject() only contains details of the super class.
 TorcOutput::TorcOutput(TorcOutput::Type Type, double Value, const QString &ModelId, const QVariantMap &Details)
   : TorcDevice(true, Value, Value, ModelId, Details),
     TorcHTTPService(this, QStringLiteral("%1/%2%3").arg(OUTPUTS_DIRECTORY, TorcCoreUtils::EnumToLowerString<TorcOutput::Type>(Type), Details.value(QStringLiteral("name")).toString()),
                     Details.value(QStringLiteral("name")).toString(), TorcOutput::staticMetaObject, BLACKLIST),
-    m_owner(nullptr)
+    m_owner(nullptr),
+    m_outputQueue(nullptr)
 {
     TorcOutputs::gOutputs->AddOutput(this);
 }
@@ -44,11 +49,122 @@ TorcOutput::TorcOutput(TorcOutput::Type Type, double Value, const QString &Model
   : TorcDevice(true, Value, Value, ModelId, Details),
     TorcHTTPService(Output, QStringLiteral("%1/%2/%3").arg(OUTPUTS_DIRECTORY, TorcCoreUtils::EnumToLowerString<TorcOutput::Type>(Type), Details.value(QStringLiteral("name")).toString()),
                     Details.value(QStringLiteral("name")).toString(), MetaObject, BLACKLIST + "," + Blacklist),
-    m_owner(nullptr)
+    m_owner(nullptr),
+    m_outputQueue(nullptr)
 {
     TorcOutputs::gOutputs->AddOutput(this);
 }
 
+TorcOutput::~TorcOutput()
+{
+    DetachOutputQueue();
+    gBatched.removeAll(this);
+}
+
+/*! \brief Start a batch of output changes.
+ *
+ * Outputs that are updated from this thread before the matching call to EndBatch may defer their (usually hardware)
+ * update until the end of the batch - so that a group of changes (e.g. from TorcTransitionClock) is delivered
+ * to the output drivers together. Batches can be nested.
+ *
+ * Batch state is per thread - a batch in one thread has no effect on outputs updated from another.
+ *
+ * \note An output that defers an update must not be deleted by another thread before the batch ends.
+*/
+void TorcOutput::BeginBatch(void)
+{
+    gBatchDepth++;
+}
+
+/// Complete a batch and flush every output that deferred an update.
+void TorcOutput::EndBatch(void)
+{
+    if (gBatchDepth < 1 || --gBatchDepth > 0)
+        return;
+
+    QList<TorcOutput*> batched;
+    batched.swap(gBatched);
+
+    foreach (TorcOutput* output, batched)
+        output->FlushBatch();
+}
+
+/*! \brief Register for a call to FlushBatch at the end of the current batch.
+ *
+ * Returns false if there is no batch in progress for the current thread, in which case the output must be updated now.
+*/
+bool TorcOutput::DeferUntilEndOfBatch(void)
+{
+    if (!gBatchDepth)
+        return false;
+    if (!gBatched.contains(this))
+        gBatched.append(this);
+    return true;
+}
+
+/// Apply any update deferred by DeferUntilEndOfBatch. The default implementation does nothing.
+void TorcOutput::FlushBatch(void)
+{
+}
+
+/*! \brief Apply values from the output queue for Bus rather than from the thread that sets them.
+ *
+ * Subclasses that use a queue should implement ApplyValue and pass new values to PostValue, which publishes the value
+ * once it has been applied. Subclasses must call DetachOutputQueue from their destructor, before returning the output
+ * to its default state.
+*/
+void TorcOutput::SetOutputQueue(const QString &Bus)
+{
+    DetachOutputQueue();
+    m_outputQueue = TorcOutputQueue::Acquire(Bus);
+}
+
+/// Stop using the output queue, waiting for any write in progress. Values still queued are discarded.
+void TorcOutput::DetachOutputQueue(void)
+{
+    if (!m_outputQueue)
+        return;
+
+    m_outputQueue->Remove(this);
+    TorcOutputQueue::Release(m_outputQueue);
+    m_outputQueue = nullptr;
+}
+
+/*! \brief Queue Value to be applied from the output queue thread.
+ *
+ * Returns false if there is no queue, in which case the output must be updated now.
+*/
+bool TorcOutput::PostValue(double Value)
+{
+    if (!m_outputQueue)
+        return false;
+    m_outputQueue->Post(this, Value);
+    return true;
+}
+
+/// Write Value to the hardware. This is called from the output queue thread. The default implementation does nothing.
+bool TorcOutput::ApplyValue(double /*Value*/)
+{
+    return true;
+}
+
+void TorcOutput::ValueApplied(double Value, bool Success)
+{
+    QMetaObject::invokeMethod(this, "PublishValue", Qt::QueuedConnection, Q_ARG(double, Value), Q_ARG(bool, Success));
+}
+
+/// Publish a value once it has been applied, so that the output reflects the state of the hardware.
+void TorcOutput::PublishValue(double Value, bool Success)
+{
+    if (!Success)
+    {
+        LOG(VB_GENERAL, LOG_ERR, QStringLiteral("Failed to set '%1' to %2").arg(GetUniqueId()).arg(Value));
+        return;
+    }
+
+    TorcDevice::SetValue(Value);
+}
+
 bool TorcOutput::HasOwner(void)
 {
     QMutexLocker locker(&lock);
@@ -84,6 +200,15 @@ bool TorcOutput::SetOwner(QObject *Owner)
     return true;
 }
 
+/// Release ownership, if held by Owner, so that another control may take ownership.
+void TorcOutput::ReleaseOwner(QObject *Owner)
+{
+    QMutexLocker locker(&lock);
+
+    if (m_owner == Owner)
+        m_owner = nullptr;
+}
+
 void TorcOutput::SubscriberDeleted(QObject *Subscriber)
 {
     TorcHTTPService::HandleSubscriberDeleted(Subscriber);
@@ -9,10 +9,11 @@
 #include "torcreferencecounted.h"
 #include "torchttpservice.h"
 #include "torcdevice.h"
+#include "torcoutputqueue.h"
 
 #define OUTPUTS_DIRECTORY QStringLiteral("outputs")
 
-class TorcOutput : public TorcDevice, public TorcHTTPService
+class TorcOutput : public TorcDevice, public TorcHTTPService, public TorcOutputQueueTarget
 {
     Q_OBJECT
     Q_CLASSINFO("Version",        "1.0.0")
@@ -40,12 +41,16 @@ class TorcOutput : public TorcDevice, public TorcHTTPService
     TorcOutput(TorcOutput::Type Type, double Value, const QString &ModelId, const QVariantMap &Details,
                QObject *Output, const QMetaObject &MetaObject, const QString &Blacklist = QStringLiteral(""));
 
-    virtual ~TorcOutput() = default;
+    virtual ~TorcOutput();
 
     virtual TorcOutput::Type GetType (void) = 0;
 
+    static void      BeginBatch             (void);
+    static void      EndBatch               (void);
+
     bool             HasOwner               (void);
     bool             SetOwner               (QObject *Owner);
+    void             ReleaseOwner           (QObject *Owner);
     QString          GetUIName              (void) override;
 
   public slots:
@@ -54,9 +59,22 @@ class TorcOutput : public TorcDevice, public TorcHTTPService
 
   protected:
     virtual void     Graph                  (QByteArray* Data);
+    bool             DeferUntilEndOfBatch   (void);
+    virtual void     FlushBatch             (void);
+    void             SetOutputQueue         (const QString &Bus);
+    void             DetachOutputQueue      (void);
+    bool             PostValue              (double Value);
+
+    // TorcOutputQueueTarget
+    bool             ApplyValue             (double Value) override;
+    void             ValueApplied           (double Value, bool Success) override;
+
+  private slots:
+    void             PublishValue           (double Value, bool Success);
 
   private:
     QObject         *m_owner;
+    TorcOutputQueue *m_outputQueue;
 
   private:
     Q_DISABLE_COPY(TorcOutput)
@@ -0,0 +1,262 @@
+/* Class TorcOutputQueue
+*
+* This file is part of the Torc project.
+*
+* Copyright (C) Mark Kendall 2018
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+* USA.
+*/
+
+// Torc
+#include "torclogging.h"
+#include "torcoutputqueue.h"
+
+static QMutex                         gQueuesLock;
+static QHash<QString,TorcOutputQueue*> gQueues;
+
+/*! \class TorcOutputQueue
+ *  \brief Apply output values from a dedicated thread for each bus.
+ *
+ * Outputs post new values to the queue for their bus (e.g. gpio) rather than writing to the hardware from within
+ * the control cascade - so a slow bus cannot stall control evaluation. Only the latest value posted for each output
+ * is applied and outputs are updated in the order in which they were first posted. Once a value has been written,
+ * the output is told (from the queue thread) whether the write succeeded.
+ *
+ * Queues are shared by name and stopped when the last user releases them.
+ *
+ * \note A target must be removed (Remove) before it is destroyed, which also waits for any write in progress.
+*/
+TorcOutputQueue* TorcOutputQueue::Acquire(const QString &Bus)
+{
+    QMutexLocker locker(&gQueuesLock);
+    TorcOutputQueue *queue = gQueues.value(Bus);
+    if (!queue)
+    {
+        queue = new TorcOutputQueue(Bus);
+        gQueues.insert(Bus, queue);
+        queue->start();
+    }
+    queue->m_users++;
+    return queue;
+}
+
+void TorcOutputQueue::Release(TorcOutputQueue *Queue)
+{
+    if (!Queue)
+        return;
+
+    {
+        QMutexLocker locker(&gQueuesLock);
+        if (--Queue->m_users > 0)
+            return;
+        gQueues.remove(Queue->m_bus);
+    }
+
+    delete Queue;
+}
+
+/// Return the statistics for every active queue, keyed by bus.
+QVariantMap TorcOutputQueue::GetQueueStatistics(void)
+{
+    QVariantMap result;
+    QMutexLocker locker(&gQueuesLock);
+    foreach (TorcOutputQueue *queue, gQueues)
+        result.insert(queue->m_bus, queue->GetStatistics());
+    return result;
+}
+
+TorcOutputQueue::TorcOutputQueue(const QString &Bus)
+  : TorcQThread(QStringLiteral("Output%1").arg(Bus)),
+    m_bus(Bus),
+    m_users(0),
+    m_lock(),
+    m_wait(),
+    m_idle(),
+    m_aborted(false),
+    m_clock(),
+    m_order(),
+    m_pending(),
+    m_applied(),
+    m_current(nullptr),
+    m_posted(0),
+    m_coalesced(0),
+    m_writes(0),
+    m_errors(0),
+    m_maxLatency(0),
+    m_totalLatency(),
+    m_latency(0.95)
+{
+    m_clock.start();
+}
+
+TorcOutputQueue::~TorcOutputQueue()
+{
+    Stop();
+
+    QMutexLocker locker(&m_lock);
+    if (m_writes)
+    {
+        LOG(VB_GENERAL, LOG_INFO, QStringLiteral("Output queue '%1': %2 writes (%3 coalesced) %4 errors, latency mean %5us 95th %6us max %7us")
+            .arg(m_bus).arg(m_writes).arg(m_coalesced).arg(m_errors)
+            .arg(m_totalLatency.Value() / m_writes, 0, 'f', 0).arg(m_latency.GetValue(), 0, 'f', 0).arg(m_maxLatency));
+    }
+}
+
+/*! \brief Queue Value for Target.
+ *
+ * Any value not yet applied for Target is replaced. A value that matches the last value applied is discarded, unless
+ * a write to Target is in progress.
+*/
+void TorcOutputQueue::Post(TorcOutputQueueTarget *Target, double Value)
+{
+    if (!Target)
+        return;
+
+    QMutexLocker locker(&m_lock);
+    m_posted++;
+
+    // a write in progress may change the applied value, so the new value must follow it
+    QHash<TorcOutputQueueTarget*,double>::const_iterator applied = m_applied.constFind(Target);
+    bool same = m_current != Target && applied != m_applied.constEnd() && qFuzzyCompare(applied.value() + 1.0, Value + 1.0);
+
+    QHash<TorcOutputQueueTarget*,Pending>::iterator it = m_pending.find(Target);
+    if (it != m_pending.end())
+    {
+        m_coalesced++;
+        if (same)
+        {
+            m_pending.erase(it);
+            m_order.removeOne(Target);
+        }
+        else
+        {
+            it.value().value = Value;
+        }
+        return;
+    }
+
+    if (same)
+    {
+        m_coalesced++;
+        return;
+    }
+
+    Pending pending = { Value, m_clock.nsecsElapsed() };
+    m_pending.insert(Target, pending);
+    m_order.append(Target);
+    m_wait.wakeAll();
+}
+
+/// Discard any value queued for Target and wait for any write to Target that is in progress.
+void TorcOutputQueue::Remove(TorcOutputQueueTarget *Target)
+{
+    QMutexLocker locker(&m_lock);
+    while (m_current == Target)
+        m_idle.wait(&m_lock);
+    if (m_pending.remove(Target))
+        m_order.removeOne(Target);
+    m_applied.remove(Target);
+}
+
+/// Wait until every queued value has been applied.
+void TorcOutputQueue::Flush(void)
+{
+    QMutexLocker locker(&m_lock);
+    while ((!m_order.isEmpty() || m_current) && isRunning())
+        m_idle.wait(&m_lock, 100);
+}
+
+/// Stop the thread once every queued value has been applied.
+void TorcOutputQueue::Stop(void)
+{
+    {
+        QMutexLocker locker(&m_lock);
+        m_aborted = true;
+        m_wait.wakeAll();
+    }
+    wait();
+}
+
+QString TorcOutputQueue::GetBus(void) const
+{
+    return m_bus;
+}
+
+/// Return the write counts and latencies (in microseconds, from first post to completion).
+QVariantMap TorcOutputQueue::GetStatistics(void)
+{
+    QMutexLocker locker(&m_lock);
+    QVariantMap result;
+    result.insert(QStringLiteral("posted"),        m_posted);
+    result.insert(QStringLiteral("coalesced"),     m_coalesced);
+    result.insert(QStringLiteral("writes"),        m_writes);
+    result.insert(QStringLiteral("errors"),        m_errors);
+    result.insert(QStringLiteral("pending"),       m_order.size());
+    result.insert(QStringLiteral("latencyMean"),   m_writes ? m_totalLatency.Value() / m_writes : 0.0);
+    result.insert(QStringLiteral("latency95"),     m_latency.GetValue());
+    result.insert(QStringLiteral("latencyMax"),    m_maxLatency);
+    return result;
+}
+
+void TorcOutputQueue::Start(void)
+{
+}
+
+void TorcOutputQueue::Finish(void)
+{
+}
+
+void TorcOutputQueue::run(void)
+{
+    Initialise();
+
+    QMutexLocker locker(&m_lock);
+    forever
+    {
+        while (m_order.isEmpty() && !m_aborted)
+            m_wait.wait(&m_lock);
+        if (m_order.isEmpty())
+            break;
+
+        // take one value at a time, so a target can be removed (or updated) while others are written
+        TorcOutputQueueTarget *target = m_order.takeFirst();
+        Pending pending = m_pending.take(target);
+        m_current = target;
+
+        locker.unlock();
+        bool success = target->ApplyValue(pending.value);
+        target->ValueApplied(pending.value, success);
+        locker.relock();
+
+        m_current = nullptr;
+        if (success)
+            m_applied.insert(target, pending.value);
+        else
+            m_errors++;
+        m_writes++;
+
+        qint64 latency = (m_clock.nsecsElapsed() - pending.posted) / 1000;
+        m_totalLatency.Add(latency);
+        m_latency.AddValue(latency);
+        if (latency > m_maxLatency)
+            m_maxLatency = latency;
+
+        m_idle.wakeAll();
+    }
+    locker.unlock();
+
+    Deinitialise();
+}
@@ -0,0 +1,81 @@
+#ifndef TORCOUTPUTQUEUE_H
+#define TORCOUTPUTQUEUE_H
+
+// Qt
+#include <QHash>
+#include <QMutex>
+#include <QVariant>
+#include <QElapsedTimer>
+#include <QWaitCondition>
+
+// Torc
+#include "torcqthread.h"
+#include "torcmaths.h"
+
+class TorcOutputQueueTarget
+{
+  public:
+    TorcOutputQueueTarget() = default;
+    virtual ~TorcOutputQueueTarget() = default;
+
+    virtual bool    ApplyValue    (double Value) = 0;
+    virtual void    ValueApplied  (double Value, bool Success) = 0;
+};
+
+class TorcOutputQueue final : public TorcQThread
+{
+    Q_OBJECT
+
+  public:
+    static TorcOutputQueue* Acquire         (const QString &Bus);
+    static void             Release         (TorcOutputQueue *Queue);
+    static QVariantMap      GetQueueStatistics (void);
+
+  public:
+    explicit TorcOutputQueue(const QString &Bus);
+   ~TorcOutputQueue();
+
+    void            Post          (TorcOutputQueueTarget *Target, double Value);
+    void            Remove        (TorcOutputQueueTarget *Target);
+    void            Flush         (void);
+    void            Stop          (void);
+    QString         GetBus        (void) const;
+    QVariantMap     GetStatistics (void);
+
+    void            Start         (void) override;
+    void            Finish        (void) override;
+
+  protected:
+    void            run           (void) override;
+
+  private:
+    class Pending
+    {
+      public:
+        double      value;
+        qint64      posted;
+    };
+
+  private:
+    Q_DISABLE_COPY(TorcOutputQueue)
+    QString         m_bus;
+    int             m_users;
+    QMutex          m_lock;
+    QWaitCondition  m_wait;
+    QWaitCondition  m_idle;
+    bool            m_aborted;
+    QElapsedTimer   m_clock;
+    QList<TorcOutputQueueTarget*>                m_order;
+    QHash<TorcOutputQueueTarget*,Pending>        m_pending;
+    QHash<TorcOutputQueueTarget*,double>         m_applied;
+    TorcOutputQueueTarget                       *m_current;
+    quint64         m_posted;
+    quint64         m_coalesced;
+    quint64         m_writes;
+    quint64         m_errors;
+    qint64          m_maxLatency;
+    TorcSum         m_totalLatency;
+    TorcPercentile  m_latency;
+};
+
+#endif // TORCOUTPUTQUEUE_H
@@ -134,6 +134,12 @@ QStringList TorcOutputs::GetOutputTypes(void)
     return TorcCoreUtils::EnumList<TorcOutput::Type>();
 }
 
+/// Return the write counts, errors and latencies for each output queue.
+QVariantMap TorcOutputs::GetOutputQueues(void)
+{
+    return TorcOutputQueue::GetQueueStatistics();
+}
+
 void TorcOutputs::AddOutput(TorcOutput *Output)
 {
     QWriteLocker locker(&m_httpServiceLock);
@@ -264,3 +270,19 @@ void TorcOutputs::Destroy(void)
     }
     m_createdOutputs.clear();
 }
+
+void TorcOutputs::RemoveDevices(const QStringList &UniqueIds, QStringList &Removed)
+{
+    QWriteLocker locker(&m_handlerLock);
+
+    foreach (const QString &uniqueid, UniqueIds)
+    {
+        TorcOutput *output = m_createdOutputs.take(uniqueid);
+        if (output)
+        {
+            output->DownRef();
+            RemoveOutput(output);
+            Removed.append(uniqueid);
+        }
+    }
+}
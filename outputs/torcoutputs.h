@@ -30,6 +30,7 @@ class TorcOutputs final : public QObject, public TorcHTTPService, public TorcDev
     // TorcDeviceHandler
     void                Create                    (const QVariantMap &Details) override;
     void                Destroy                   (void) override;
+    void                RemoveDevices             (const QStringList &UniqueIds, QStringList &Removed) override;
 
   public slots:
     // TorcHTTPService
@@ -37,6 +38,7 @@ class TorcOutputs final : public QObject, public TorcHTTPService, public TorcDev
 
     QVariantMap         GetOutputList             (void);
     QStringList         GetOutputTypes            (void);
+    QVariantMap         GetOutputQueues           (void);
 
   signals:
     void                OutputsChanged            (void);
@@ -24,6 +24,14 @@
 #include "torcexitcodes.h"
 #include "torccommandline.h"
 #include "torcxsdtest.h"
+#include "torcsimulator.h"
+
+#ifdef USING_PIGPIO
+#include "torcpigpio.h"
+#define TORC_PWM_OPTIONS TorcCommandLine::PWMBenchmark
+#else
+#define TORC_PWM_OPTIONS TorcCommandLine::None
+#endif
 
 int main(int argc, char **argv)
 {
@@ -37,7 +45,7 @@ int main(int argc, char **argv)
 
         {
             bool justexit = false;
-            QScopedPointer<TorcCommandLine> cmdline(new TorcCommandLine(TorcCommandLine::Database | TorcCommandLine::LogFile | TorcCommandLine::XSDTest));
+            QScopedPointer<TorcCommandLine> cmdline(new TorcCommandLine(TorcCommandLine::Database | TorcCommandLine::LogFile | TorcCommandLine::XSDTest | TorcCommandLine::Simulate | TORC_PWM_OPTIONS));
 
             if (!cmdline.data())
                 return TORC_EXIT_UNKOWN_ERROR;
@@ -53,6 +61,14 @@ int main(int argc, char **argv)
             if (!(cmdline.data()->GetValue(QStringLiteral("xsdtest")).toString().isEmpty()))
                 return TorcXSDTest::RunXSDTestSuite(cmdline.data());
 
+            if (!(cmdline.data()->GetValue(QStringLiteral("simulate")).toString().isEmpty()))
+                return TorcSimulator::RunSimulation(cmdline.data());
+
+#ifdef USING_PIGPIO
+            if (!(cmdline.data()->GetValue(QStringLiteral("pwmbenchmark")).toString().isEmpty()))
+                return TorcPiGPIO::RunPWMBenchmark(cmdline.data());
+#endif
+
             if (int error = TorcLocalContext::Create(cmdline.data()))
                 return error;
         }
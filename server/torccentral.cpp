@@ -19,7 +19,6 @@
 
 // Qt
 #include <QFile>
-#include <QFileInfo>
 #include <QProcess>
 #include <QJsonDocument>
 
@@ -37,14 +36,10 @@
 #include "controls/torccontrols.h"
 #include "notify/torcnotify.h"
 #include "torcxmlreader.h"
+#include "torcconfigdiff.h"
+#include "torcconfigloader.h"
 #include "torccentral.h"
 
-#ifdef USING_XMLPATTERNS
-#include "torcxmlvalidator.h"
-#elif USING_LIBXML2
-#include "torclibxmlvalidator.h"
-#endif
-
 #ifdef USING_GRAPHVIZ_LIBS
 #include <graphviz/gvc.h>
 #endif
@@ -88,7 +83,7 @@ TorcCentral::TorcCentral()
     // listen for interesting events
     gLocalContext->AddObserver(this);
 
-    if (LoadConfig())
+    if (LoadConfig(m_config))
     {
         TemperatureUnits temperatureunits = Celsius; // default to metric
 
@@ -148,90 +143,106 @@ TorcCentral::TorcCentral()
         TorcLocalContext::NotifyEvent(Torc::Start);
 
         // iff we have got this far, then create the graph
-        // start the graph
-        m_graph.clear();
-        m_graph.append(QStringLiteral("strict digraph \"%1\" {\r\n"
-                                    "    rankdir=\"LR\";\r\n"
-                                    "    node [shape=rect];\r\n")
-                            .arg(TORC_TORC));
-
-        // build the graph contents
-        TorcInputs::gInputs->Graph(&m_graph);
-        TorcOutputs::gOutputs->Graph(&m_graph);
-        TorcControls::gControls->Graph(&m_graph);
-        TorcNotify::gNotify->Graph(&m_graph);
-
-        // complete the graph
-        m_graph.append("}\r\n");
-
-        QFile file(graphdot);
-        if (file.open(QIODevice::ReadWrite))
-        {
-            file.write(m_graph);
-            file.flush();
-            file.close();
-            LOG(VB_GENERAL, LOG_INFO, QStringLiteral("Saved state graph as %1").arg(graphdot));
-        }
-        else
-        {
-            LOG(VB_GENERAL, LOG_ERR, QStringLiteral("Failed to open '%1' to write state graph").arg(graphdot));
-        }
+        CreateGraph();
+    }
+}
+
+TorcCentral::~TorcCentral()
+{
+    // deregister for events
+    gLocalContext->RemoveObserver(this);
+
+    // cleanup any devices
+    TorcDeviceHandler::Stop();
+}
+
+/// Create the state graph (as dot and svg files in the content directory).
+void TorcCentral::CreateGraph(void)
+{
+    QString graphdot = QStringLiteral("%1stategraph.dot").arg(GetTorcContentDir());
+    QString graphsvg = QStringLiteral("%1stategraph.svg").arg(GetTorcContentDir());
+
+    // NB the graph may be recreated when the configuration is reloaded
+    if (QFile::exists(graphdot))
+        QFile::remove(graphdot);
+    if (QFile::exists(graphsvg))
+        QFile::remove(graphsvg);
+
+    // start the graph
+    m_graph.clear();
+    m_graph.append(QStringLiteral("strict digraph \"%1\" {\r\n"
+                                "    rankdir=\"LR\";\r\n"
+                                "    node [shape=rect];\r\n")
+                        .arg(TORC_TORC));
+
+    // build the graph contents
+    TorcInputs::gInputs->Graph(&m_graph);
+    TorcOutputs::gOutputs->Graph(&m_graph);
+    TorcControls::gControls->Graph(&m_graph);
+    TorcNotify::gNotify->Graph(&m_graph);
+
+    // complete the graph
+    m_graph.append("}\r\n");
+
+    QFile file(graphdot);
+    if (file.open(QIODevice::ReadWrite))
+    {
+        file.write(m_graph);
+        file.flush();
+        file.close();
+        LOG(VB_GENERAL, LOG_INFO, QStringLiteral("Saved state graph as %1").arg(graphdot));
+    }
+    else
+    {
+        LOG(VB_GENERAL, LOG_ERR, QStringLiteral("Failed to open '%1' to write state graph").arg(graphdot));
+    }
 
-        // create a representation of the state graph
+    // create a representation of the state graph
 #ifdef USING_GRAPHVIZ_LIBS
-        bool created = false;
+    bool created = false;
+
+    FILE *handle = fopen(graphsvg.toLocal8Bit().data(), "w");
+    if (handle)
+    {
+        GVC_t *gvc  = gvContext();
+        Agraph_t *g = agmemread(m_graph.data());
+        gvLayout(gvc, g, "dot");
+        gvRender(gvc, g, "svg", handle);
+        gvFreeLayout(gvc,g);
+        agclose(g);
+        gvFreeContext(gvc);
+        fclose(handle);
+        created = true;
+    }
+    else
+    {
+        LOG(VB_GENERAL, LOG_WARNING, QStringLiteral("Failed to open '%1' for writing (err: %2)").arg(graphsvg, strerror(errno)));
+    }
 
-        FILE *handle = fopen(graphsvg.toLocal8Bit().data(), "w");
-        if (handle)
+    if (!created)
+    {
+#endif
+        // NB QProcess appears to be fatally broken. Just use system instead
+        QString command = QStringLiteral("dot -Tsvg -o %1 %2").arg(graphsvg, graphdot);
+        int err = system(command.toLocal8Bit());
+        if (err < 0)
         {
-            GVC_t *gvc  = gvContext();
-            Agraph_t *g = agmemread(m_graph.data());
-            gvLayout(gvc, g, "dot");
-            gvRender(gvc, g, "svg", handle);
-            gvFreeLayout(gvc,g);
-            agclose(g);
-            gvFreeContext(gvc);
-            fclose(handle);
-            created = true;
+            LOG(VB_GENERAL, LOG_ERR, QStringLiteral("Failed to create stategraph representation (err: %1)").arg(strerror(errno)));
         }
         else
         {
-            LOG(VB_GENERAL, LOG_WARNING, QStringLiteral("Failed to open '%1' for writing (err: %2)").arg(graphsvg, strerror(errno)));
-        }
-
-        if (!created)
-        {
-#endif
-            // NB QProcess appears to be fatally broken. Just use system instead
-            QString command = QStringLiteral("dot -Tsvg -o %1 %2").arg(graphsvg, graphdot);
-            int err = system(command.toLocal8Bit());
-            if (err < 0)
-            {
-                LOG(VB_GENERAL, LOG_ERR, QStringLiteral("Failed to create stategraph representation (err: %1)").arg(strerror(errno)));
-            }
-            else
-            {
-                LOG(VB_GENERAL, LOG_INFO, QStringLiteral("Saved state graph representation as %1").arg(graphsvg));
-                if (err > 0)
-                    LOG(VB_GENERAL, LOG_ERR, QStringLiteral("dot returned an unexpected result - stategraph may be incomplete or absent"));
-            }
+            LOG(VB_GENERAL, LOG_INFO, QStringLiteral("Saved state graph representation as %1").arg(graphsvg));
+            if (err > 0)
+                LOG(VB_GENERAL, LOG_ERR, QStringLiteral("dot returned an unexpected result - stategraph may be incomplete or absent"));
         }
 #ifdef USING_GRAPHVIZ_LIBS
     }
 #endif
+
     // no need for the graph data from here
     m_graph.clear();
 }
 
-TorcCentral::~TorcCentral()
-{
-    // deregister for events
-    gLocalContext->RemoveObserver(this);
-
-    // cleanup any devices
-    TorcDeviceHandler::Stop();
-}
-
 QString TorcCentral::GetUIName(void)
 {
     return tr("Central");
@@ -247,144 +258,202 @@ void TorcCentral::SubscriberDeleted(QObject *Subscriber)
     TorcHTTPService::HandleSubscriberDeleted(Subscriber);
 }
 
-bool TorcCentral::LoadConfig(void)
+/*! \brief Load the configuration file into Config.
+ *
+ * The configuration is normally loaded (and validated) in the background during startup - see TorcConfigLoader.
+*/
+bool TorcCentral::LoadConfig(QVariantMap &Config)
 {
-    bool skipvalidation = false;
-
-    if (!qEnvironmentVariableIsEmpty("TORC_NO_VALIDATION"))
-    {
-        LOG(VB_GENERAL, LOG_INFO, QStringLiteral("Skipping configuration file validation (command line)."));
-        skipvalidation = true;
-    }
-
-    QString xml = GetTorcConfigDir() + "/" + TORC_CONFIG_FILE;
-    QFileInfo config(xml);
-    if (!skipvalidation && !config.exists())
-    {
-        LOG(VB_GENERAL, LOG_ERR, QStringLiteral("Failed to find configuration file '%1'").arg(xml));
-        return false;
-    }
+    QByteArray xsd;
+    bool result = TorcConfigLoader::Load(Config, xsd);
 
 #if defined(USING_XMLPATTERNS) || defined(USING_LIBXML2)
-    QString customxsd = GetTorcContentDir() + "torc.xsd";
     // we always want to delete the old xsd - if it isn't present, it wasn't used!
-    // so retrieve now and then delete
-    QByteArray oldxsd;
+    QString customxsd = GetTorcContentDir() + "torc.xsd";
     if (QFile::exists(customxsd))
+        QFile::remove(customxsd);
+
+    // save the XSD for the user to inspect if necessary
+    if (!xsd.isEmpty())
     {
         QFile customxsdfile(customxsd);
-        if (customxsdfile.open(QIODevice::ReadOnly))
+        if (customxsdfile.open(QIODevice::ReadWrite))
         {
-            oldxsd = customxsdfile.readAll();
+            customxsdfile.write(xsd);
+            customxsdfile.flush();
             customxsdfile.close();
+            LOG(VB_GENERAL, LOG_INFO, QStringLiteral("Saved current XSD as '%1'").arg(customxsd));
+        }
+        else
+        {
+            LOG(VB_GENERAL, LOG_WARNING, QStringLiteral("Failed to open '%1' for writing").arg(customxsd));
         }
-        QFile::remove(customxsd);
     }
+#endif
 
-    QString basexsd = GetTorcShareDir() + "/html/torc.xsd";
-    if (!QFile::exists(basexsd))
+    return result;
+}
+
+/*! \brief Apply changes to the configuration file without restarting.
+ *
+ * The configuration file is validated and compared with the running configuration by device (see TorcConfigDiff).
+ * Devices that have been removed or changed are stopped and deleted, along with any control or notification that
+ * is connected to them, and new or changed devices are then created. The remaining devices (and their state and
+ * subscribers) are untouched.
+ *
+ * If the configuration fails validation, the running configuration is retained. If anything other than devices
+ * has changed (e.g. <settings>), Torc is restarted.
+*/
+bool TorcCentral::ReloadConfig(void)
+{
+    QVariantMap config;
+    if (!LoadConfig(config))
     {
-        LOG(VB_GENERAL, LOG_ERR, QStringLiteral("Failed to find base XSD file '%1'").arg(basexsd));
+        LOG(VB_GENERAL, LOG_ERR, QStringLiteral("Failed to load new configuration - ignoring"));
         return false;
     }
 
-    QByteArray newxsd;
-    if (!skipvalidation)
+    QStringList removed;
+    QStringList added;
+    QStringList changed;
+    if (!TorcConfigDiff::Compare(m_config, config, removed, added, changed))
     {
-        // customise and save the xsd now - even if validation is skipped from here, we need the
-        // xsd for reference
-        newxsd = GetCustomisedXSD(basexsd);
-        if (!newxsd.isEmpty())
-        {
-            // save the XSD for the user to inspect if necessary
-            QFile customxsdfile(customxsd);
-            if (customxsdfile.open(QIODevice::ReadWrite))
-            {
-                customxsdfile.write(newxsd);
-                customxsdfile.flush();
-                customxsdfile.close();
-                LOG(VB_GENERAL, LOG_INFO, QStringLiteral("Saved current XSD as '%1'").arg(customxsd));
-            }
-            else
-            {
-                LOG(VB_GENERAL, LOG_WARNING, QStringLiteral("Failed to open '%1' for writing").arg(customxsd));
-            }
-        }
-        else
-        {
-            LOG(VB_GENERAL, LOG_ERR, QStringLiteral("Strange - empty xsd..."));
-            return false;
-        }
+        LOG(VB_GENERAL, LOG_INFO, QStringLiteral("Configuration changes cannot be applied without a restart"));
+        TorcLocalContext::NotifyEvent(Torc::RestartTorc);
+        return true;
     }
 
-    // validation can take a while on slower machines (e.g. single core raspberry pi).
-    // try and skip if the config has not been modified
-    QString lastvalidated = gLocalContext->GetSetting(QStringLiteral("configLastValidated"), QStringLiteral("never"));
-    if (!skipvalidation && lastvalidated != QStringLiteral("never"))
+    LOG(VB_GENERAL, LOG_INFO, QStringLiteral("Reloading configuration: %1 removed, %2 added, %3 changed")
+        .arg(removed.size()).arg(added.size()).arg(changed.size()));
+
+    // remove changed and removed devices and everything connected to them. Handlers may remove more than
+    // was asked for, so repeat until everything that depends on a removed device has also been removed.
+    QStringList retired;
+    QStringList pending = removed + changed;
+    while (!pending.isEmpty())
     {
-        bool xsdmodified    = qstrcmp(oldxsd.constData(), newxsd.constData()) != 0;
-        bool configmodified = config.lastModified() >= QDateTime::fromString(lastvalidated);
+        QStringList retire = retired + pending;
+        TorcConfigDiff::Dependents(m_config, retire);
+        foreach (const QString &uniqueid, retired)
+            retire.removeAll(uniqueid);
+
+        QStringList handled;
+        TorcDeviceHandler::Remove(retire, handled);
+        RetireDevices(handled);
+        retired.append(retire);
+
+        pending.clear();
+        foreach (const QString &uniqueid, handled)
+            if (!retired.contains(uniqueid))
+                pending.append(uniqueid);
+        retired.append(pending);
+    }
 
-        if (xsdmodified)
-            LOG(VB_GENERAL, LOG_INFO, QStringLiteral("XSD file changed since last validation"));
-        else
-            LOG(VB_GENERAL, LOG_INFO, QStringLiteral("XSD unchanged since last validation"));
+    // and recreate everything that is still (or now) configured
+    QStringList configured = TorcConfigDiff::GetUniqueIds(config);
+    QStringList create = added;
+    foreach (const QString &uniqueid, retired)
+        if (configured.contains(uniqueid) && !create.contains(uniqueid))
+            create.append(uniqueid);
 
-        if (configmodified)
-            LOG(VB_GENERAL, LOG_INFO, QStringLiteral("Configuration file changed since last validation"));
-        else
-            LOG(VB_GENERAL, LOG_INFO, QStringLiteral("Configuration file unchanged since last validation:"));
+    LOG(VB_GENERAL, LOG_INFO, QStringLiteral("Removed %1 devices, creating %2").arg(retired.size()).arg(create.size()));
 
-        skipvalidation = !xsdmodified && !configmodified;
-    }
+    TorcDeviceHandler::Start(TorcConfigDiff::Prune(config, create));
+    TorcControls::gControls->Validate();
+    (void)TorcNotify::gNotify->Validate();
 
-    if (!skipvalidation)
     {
-        LOG(VB_GENERAL, LOG_INFO, QStringLiteral("Starting validation of configuration file"));
-        TorcXmlValidator validator(xml, newxsd);
-        if (!validator.Validated())
+        QMutexLocker lock(TorcDevice::gDeviceListLock);
+
+        QList<TorcControl*> controls;
+        foreach (const QString &uniqueid, create)
         {
-            LOG(VB_GENERAL, LOG_ERR, QStringLiteral("Configuration file '%1' failed validation").arg(xml));
-            // make sure we re-validate
-            gLocalContext->SetSetting(QStringLiteral("configLastValidated"), QStringLiteral("never"));
-            return false;
+            TorcDevice *device = TorcDevice::gDeviceList->value(uniqueid);
+            if (device)
+            {
+                device->Start();
+                TorcControl *control = qobject_cast<TorcControl*>(device);
+                if (control)
+                    controls.append(control);
+            }
         }
 
-        LOG(VB_GENERAL, LOG_INFO, QStringLiteral("Configuration successfully validated"));
-        gLocalContext->SetSetting(QStringLiteral("configLastValidated"), QDateTime::currentDateTime().toString());
+        // new controls may be connected to devices that have already started
+        foreach (TorcControl *control, controls)
+            control->Prime();
     }
-    else
+
+    m_config = config;
+
+    // update the copy of the config and the state graph
+    QString current = QStringLiteral("%1%2").arg(GetTorcContentDir(), TORC_CONFIG_FILE);
+    if (QFile::exists(current))
+        QFile::remove(current);
+    QFile currentconfig(QStringLiteral("%1/%2").arg(GetTorcConfigDir(), TORC_CONFIG_FILE));
+    if (!currentconfig.copy(current))
+        LOG(VB_GENERAL, LOG_WARNING, QStringLiteral("Failed to copy current config file to content directory"));
+    CreateGraph();
+
+    LOG(VB_GENERAL, LOG_INFO, QStringLiteral("Configuration reloaded"));
+    return true;
+}
+
+/// Stop and detach the given (removed) devices.
+void TorcCentral::RetireDevices(const QStringList &UniqueIds)
+{
+    QMutexLocker lock(TorcDevice::gDeviceListLock);
+
+    foreach (const QString &uniqueid, UniqueIds)
     {
-        LOG(VB_GENERAL, LOG_INFO, QStringLiteral("Skipping validation of configuration file"));
+        TorcDevice *device = TorcDevice::gDeviceList->value(uniqueid);
+        if (device)
+        {
+            device->Stop();
+            device->Retire();
+        }
     }
-#else
-    LOG(VB_GENERAL, LOG_INFO, QStringLiteral("Xml validation unavailable - not validating configuration file."));
-#endif
+}
 
-    TorcXMLReader reader(xml);
+static bool GetRootConfig(const TorcXMLReader &Reader, const QString &Source, QVariantMap &Config)
+{
     QString error;
-
-    if (!reader.IsValid(error))
+    if (!Reader.IsValid(error))
     {
         LOG(VB_GENERAL, LOG_ERR, error);
         return false;
     }
 
-    QVariantMap result = reader.GetResult();
+    QVariantMap result = Reader.GetResult();
 
     // root object should be 'torc'
     if (!result.contains(QStringLiteral("torc")))
     {
-        LOG(VB_GENERAL, LOG_ERR, QStringLiteral("Failed to find 'torc' root element in '%1'").arg(xml));
+        LOG(VB_GENERAL, LOG_ERR, QStringLiteral("Failed to find 'torc' root element in '%1'").arg(Source));
         return false;
     }
 
-    m_config = result.value(QStringLiteral("torc")).toMap();
-
-    LOG(VB_GENERAL, LOG_INFO, QStringLiteral("Loaded config from %1").arg(xml));
+    Config = result.value(QStringLiteral("torc")).toMap();
     return true;
 }
 
+/*! \brief Parse the configuration file File into Config.
+ *
+ * No validation is performed.
+*/
+bool TorcCentral::ReadConfig(const QString &File, QVariantMap &Config)
+{
+    TorcXMLReader reader(File);
+    return GetRootConfig(reader, File, Config);
+}
+
+/// Parse the configuration contained in Data into Config.
+bool TorcCentral::ReadConfig(const QByteArray &Data, QVariantMap &Config)
+{
+    QByteArray data(Data);
+    TorcXMLReader reader(data);
+    return GetRootConfig(reader, QStringLiteral("configuration"), Config);
+}
+
 QByteArray TorcCentral::GetCustomisedXSD(const QString &BaseXSDFile)
 {
     QByteArray result;
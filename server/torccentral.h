@@ -22,6 +22,7 @@ class TorcCentral final : public QObject, public TorcHTTPService
 
     Q_OBJECT
     Q_CLASSINFO("Version",     "1.0.0")
+    Q_CLASSINFO("ReloadConfig", "methods=PUT")
     Q_PROPERTY(QString temperatureUnits READ GetTemperatureUnits CONSTANT)
 
   public:
@@ -32,17 +33,22 @@ class TorcCentral final : public QObject, public TorcHTTPService
     bool            event                 (QEvent *Event) override;
     static QByteArray GetCustomisedXSD    (const QString &BaseXSDFile);
     static TemperatureUnits GetGlobalTemperatureUnits (void);
+    static bool     ReadConfig            (const QString &File, QVariantMap &Config);
+    static bool     ReadConfig            (const QByteArray &Data, QVariantMap &Config);
 
   public slots:
     // TorcHTTPService
     void            SubscriberDeleted     (QObject *Subscriber);
     QString         GetTemperatureUnits   (void);
+    bool            ReloadConfig          (void);
 
   protected:
     static TemperatureUnits gTemperatureUnits;
 
   private:
-    bool            LoadConfig            (void);
+    bool            LoadConfig            (QVariantMap &Config);
+    void            CreateGraph           (void);
+    void            RetireDevices         (const QStringList &UniqueIds);
 
   private:
     QVariantMap     m_config;
@@ -0,0 +1,258 @@
+/* Class TorcConfigDiff
+*
+* Copyright (C) Mark Kendall 2018
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+*/
+
+// Torc
+#include "torcexpression.h"
+#include "torcconfigdiff.h"
+
+#define DEVICE_NAME    QStringLiteral("name")
+#define DEVICE_FORMULA QStringLiteral("formula")
+
+/*! \class TorcConfigDiff
+ *  \brief Compare parsed configurations by device.
+ *
+ * Any element with a <name> is a device entry, identified by its name (the device's uniqueId). Two entries are the
+ * same if they have the same path in the configuration (e.g. inputs/network/switch) and identical contents. Everything
+ * else (e.g. <settings> or an I2C address shared by several devices) is treated as global configuration.
+ *
+ * \note Configurations are as returned by TorcXMLReader - repeated elements are stored with QMap::insertMulti.
+ * \sa TorcCentral::ReloadConfig
+*/
+
+/*! \brief Compare Old and New by device.
+ *
+ * Returns false if anything other than device entries has changed, in which case the lists are incomplete.
+*/
+bool TorcConfigDiff::Compare(const QVariantMap &Old, const QVariantMap &New, QStringList &Removed,
+                             QStringList &Added, QStringList &Changed)
+{
+    Removed.clear();
+    Added.clear();
+    Changed.clear();
+
+    if (Strip(Old) != Strip(New))
+        return false;
+
+    QHash<QString,QByteArray> old;
+    QHash<QString,QByteArray> current;
+    Flatten(Old, QStringLiteral(""), old, nullptr);
+    Flatten(New, QStringLiteral(""), current, nullptr);
+
+    QHash<QString,QByteArray>::const_iterator it = old.constBegin();
+    for ( ; it != old.constEnd(); ++it)
+    {
+        QHash<QString,QByteArray>::const_iterator it2 = current.constFind(it.key());
+        if (it2 == current.constEnd())
+            Removed.append(it.key());
+        else if (it2.value() != it.value())
+            Changed.append(it.key());
+    }
+
+    for (it = current.constBegin(); it != current.constEnd(); ++it)
+        if (!old.contains(it.key()))
+            Added.append(it.key());
+
+    Removed.sort();
+    Added.sort();
+    Changed.sort();
+    return true;
+}
+
+/*! \brief Add to UniqueIds every entry in Config that refers, directly or indirectly, to an entry in UniqueIds.
+ *
+ * A control (or notification) holds the devices it is connected to, so it must be rebuilt when any of them are.
+ * References are whole strings, apart from a <formula>, which refers to every name used in the expression.
+*/
+void TorcConfigDiff::Dependents(const QVariantMap &Config, QStringList &UniqueIds)
+{
+    QHash<QString,QByteArray>  entries;
+    QHash<QString,QStringList> references;
+    Flatten(Config, QStringLiteral(""), entries, &references);
+
+    bool found = true;
+    while (found)
+    {
+        found = false;
+        QHash<QString,QStringList>::const_iterator it = references.constBegin();
+        for ( ; it != references.constEnd(); ++it)
+        {
+            if (UniqueIds.contains(it.key()))
+                continue;
+
+            foreach (const QString &reference, it.value())
+            {
+                if (UniqueIds.contains(reference))
+                {
+                    UniqueIds.append(it.key());
+                    found = true;
+                    break;
+                }
+            }
+        }
+    }
+}
+
+/*! \brief Return the subset of Config that describes the devices in UniqueIds.
+ *
+ * The result can be passed to TorcDeviceHandler::Start to create just those devices. Global configuration that
+ * encloses a device entry (e.g. an I2C address) is retained.
+*/
+QVariantMap TorcConfigDiff::Prune(const QVariantMap &Config, const QStringList &UniqueIds)
+{
+    QVariantMap result;
+    bool keep = false;
+
+    QVariantMap::const_iterator it = Config.constBegin();
+    for ( ; it != Config.constEnd(); ++it)
+    {
+        if (it.value().type() != QVariant::Map)
+        {
+            result.insertMulti(it.key(), it.value());
+            continue;
+        }
+
+        QVariantMap child = it.value().toMap();
+        if (child.contains(DEVICE_NAME))
+        {
+            if (!UniqueIds.contains(child.value(DEVICE_NAME).toString()))
+                continue;
+        }
+        else
+        {
+            child = Prune(child, UniqueIds);
+            if (child.isEmpty())
+                continue;
+        }
+
+        result.insertMulti(it.key(), child);
+        keep = true;
+    }
+
+    return keep ? result : QVariantMap();
+}
+
+QStringList TorcConfigDiff::GetUniqueIds(const QVariantMap &Config)
+{
+    QHash<QString,QByteArray> entries;
+    Flatten(Config, QStringLiteral(""), entries, nullptr);
+    return entries.keys();
+}
+
+/// Collect a signature for every device entry in Config and, optionally, the strings each entry contains.
+void TorcConfigDiff::Flatten(const QVariantMap &Config, const QString &Path,
+                             QHash<QString,QByteArray> &Entries, QHash<QString,QStringList> *References)
+{
+    QVariantMap::const_iterator it = Config.constBegin();
+    for ( ; it != Config.constEnd(); ++it)
+    {
+        if (it.value().type() != QVariant::Map)
+            continue;
+
+        QString path = Path + "/" + it.key();
+        QVariantMap child = it.value().toMap();
+        if (!child.contains(DEVICE_NAME))
+        {
+            Flatten(child, path, Entries, References);
+            continue;
+        }
+
+        QString uniqueid = child.value(DEVICE_NAME).toString();
+        QByteArray signature = path.toUtf8();
+        Serialise(child, signature);
+        Entries.insert(uniqueid, signature);
+
+        if (References)
+        {
+            QStringList strings;
+            Strings(child, strings);
+            strings.removeAll(uniqueid);
+            References->insert(uniqueid, strings);
+        }
+    }
+}
+
+/// Return Config without any device entries (or the empty elements that held them).
+QVariant TorcConfigDiff::Strip(const QVariantMap &Config)
+{
+    QVariantMap result;
+    QVariantMap::const_iterator it = Config.constBegin();
+    for ( ; it != Config.constEnd(); ++it)
+    {
+        if (it.value().type() != QVariant::Map)
+        {
+            result.insertMulti(it.key(), it.value());
+            continue;
+        }
+
+        QVariantMap child = it.value().toMap();
+        if (child.contains(DEVICE_NAME))
+            continue;
+
+        QVariantMap stripped = Strip(child).toMap();
+        if (!stripped.isEmpty())
+            result.insertMulti(it.key(), stripped);
+    }
+    return result;
+}
+
+void TorcConfigDiff::Serialise(const QVariant &Value, QByteArray &Result)
+{
+    if (Value.type() != QVariant::Map)
+    {
+        Result.append(Value.toString().toUtf8());
+        return;
+    }
+
+    QVariantMap map = Value.toMap();
+    Result.append('{');
+    QVariantMap::const_iterator it = map.constBegin();
+    for ( ; it != map.constEnd(); ++it)
+    {
+        Result.append(it.key().toUtf8());
+        Result.append('=');
+        Serialise(it.value(), Result);
+        Result.append(';');
+    }
+    Result.append('}');
+}
+
+void TorcConfigDiff::Strings(const QVariant &Value, QStringList &Result)
+{
+    if (Value.type() != QVariant::Map)
+    {
+        QString string = Value.toString().trimmed();
+        if (!string.isEmpty())
+            Result.append(string);
+        return;
+    }
+
+    QVariantMap map = Value.toMap();
+    QVariantMap::const_iterator it = map.constBegin();
+    for ( ; it != map.constEnd(); ++it)
+    {
+        // an expression refers to devices by name within its formula
+        if (it.key() == DEVICE_FORMULA && it.value().type() != QVariant::Map)
+        {
+            TorcExpression expression;
+            if (expression.Parse(it.value().toString()))
+                Result.append(expression.GetNames());
+        }
+        Strings(it.value(), Result);
+    }
+}
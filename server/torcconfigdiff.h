@@ -0,0 +1,29 @@
+#ifndef TORCCONFIGDIFF_H
+#define TORCCONFIGDIFF_H
+
+// Qt
+#include <QHash>
+#include <QVariant>
+#include <QStringList>
+
+class TorcConfigDiff
+{
+  public:
+    static bool         Compare       (const QVariantMap &Old, const QVariantMap &New, QStringList &Removed,
+                                       QStringList &Added, QStringList &Changed);
+    static void         Dependents    (const QVariantMap &Config, QStringList &UniqueIds);
+    static QVariantMap  Prune         (const QVariantMap &Config, const QStringList &UniqueIds);
+    static QStringList  GetUniqueIds  (const QVariantMap &Config);
+
+  private:
+    TorcConfigDiff() = default;
+    ~TorcConfigDiff() = default;
+
+    static void         Flatten       (const QVariantMap &Config, const QString &Path,
+                                       QHash<QString,QByteArray> &Entries, QHash<QString,QStringList> *References);
+    static QVariant     Strip         (const QVariantMap &Config);
+    static void         Serialise     (const QVariant &Value, QByteArray &Result);
+    static void         Strings       (const QVariant &Value, QStringList &Result);
+};
+
+#endif // TORCCONFIGDIFF_H
@@ -0,0 +1,295 @@
+/* Class TorcConfigLoader
+*
+* Copyright (C) Mark Kendall 2018
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+*/
+
+// Qt
+#include <QFile>
+#include <QSaveFile>
+#include <QThreadPool>
+#include <QDataStream>
+#include <QCryptographicHash>
+
+// Torc
+#include "torclocaldefs.h"
+#include "torclogging.h"
+#include "torcdirectories.h"
+#include "torc/torcadminthread.h"
+#include "torccentral.h"
+#include "torcconfigloader.h"
+
+#ifdef USING_XMLPATTERNS
+#include "torcxmlvalidator.h"
+#elif USING_LIBXML2
+#include "torclibxmlvalidator.h"
+#endif
+
+#define CACHE_MAGIC   0x54434647 // TCFG
+#define CACHE_VERSION QDataStream::Qt_5_0
+
+QMutex*           TorcConfigLoader::gLoaderLock = new QMutex();
+TorcConfigLoader* TorcConfigLoader::gLoader     = nullptr;
+
+/*! \class TorcConfigLoader
+ *  \brief Validate and parse the configuration file, using a cached copy where possible.
+ *
+ * Validating the configuration file against the customised XSD is by far the slowest part of startup on
+ * single core machines. The parsed configuration is saved (as a QDataStream snapshot) in the configuration
+ * directory, keyed by a hash of the configuration file, the customised XSD and the build version. If none of
+ * these have changed, the snapshot is used and validation and parsing are skipped entirely.
+ *
+ * Loading is started by TorcConfigLoaderObject before the network and HTTP server are created and runs in the
+ * global thread pool. TorcCentral then collects the result (waiting if necessary) with Load.
+ *
+ * \sa TorcCentral::LoadConfig
+*/
+TorcConfigLoader::TorcConfigLoader()
+  : QRunnable(),
+    m_lock(),
+    m_wait(),
+    m_done(false),
+    m_valid(false),
+    m_config(),
+    m_xsd()
+{
+    setAutoDelete(false);
+}
+
+/// Start loading the configuration in the background.
+void TorcConfigLoader::Prefetch(void)
+{
+    QMutexLocker locker(gLoaderLock);
+    if (gLoader)
+        return;
+
+    gLoader = new TorcConfigLoader();
+    QThreadPool::globalInstance()->start(gLoader);
+}
+
+/// Discard any configuration that has been prefetched but not used.
+void TorcConfigLoader::Cancel(void)
+{
+    gLoaderLock->lock();
+    TorcConfigLoader *loader = gLoader;
+    gLoader = nullptr;
+    gLoaderLock->unlock();
+
+    if (loader)
+    {
+        QVariantMap config;
+        QByteArray xsd;
+        (void)loader->Wait(config, xsd);
+        delete loader;
+    }
+}
+
+/*! \brief Load the configuration into Config.
+ *
+ * If the configuration has been prefetched, wait for and return that result. Otherwise (e.g. when the
+ * configuration is reloaded) load it now. XSD is set to the customised XSD, if one was created.
+*/
+bool TorcConfigLoader::Load(QVariantMap &Config, QByteArray &XSD)
+{
+    gLoaderLock->lock();
+    TorcConfigLoader *loader = gLoader;
+    gLoader = nullptr;
+    gLoaderLock->unlock();
+
+    if (!loader)
+        return LoadConfig(Config, XSD);
+
+    bool result = loader->Wait(Config, XSD);
+    delete loader;
+    return result;
+}
+
+/// Return the cache key for the given configuration, XSD and validation setting.
+QByteArray TorcConfigLoader::GetKey(const QByteArray &XML, const QByteArray &XSD, bool Validate)
+{
+    QCryptographicHash hash(QCryptographicHash::Sha256);
+    hash.addData(QByteArrayLiteral(GIT_VERSION));
+    hash.addData(Validate ? QByteArrayLiteral("validated") : QByteArrayLiteral("unvalidated"));
+    hash.addData(QByteArray::number(XSD.size()));
+    hash.addData(XSD);
+    hash.addData(XML);
+    return hash.result();
+}
+
+/// Read the configuration snapshot in File, if it matches Key.
+bool TorcConfigLoader::ReadCache(const QString &File, const QByteArray &Key, QVariantMap &Config)
+{
+    QFile file(File);
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+
+    QDataStream stream(&file);
+    stream.setVersion(CACHE_VERSION);
+
+    quint32 magic = 0;
+    QByteArray key;
+    stream >> magic;
+    if (magic != CACHE_MAGIC)
+        return false;
+    stream >> key;
+    if (stream.status() != QDataStream::Ok || key != Key)
+        return false;
+
+    QVariantMap config;
+    stream >> config;
+    if (stream.status() != QDataStream::Ok || config.isEmpty())
+    {
+        LOG(VB_GENERAL, LOG_WARNING, QStringLiteral("Failed to read configuration cache '%1'").arg(File));
+        return false;
+    }
+
+    Config = config;
+    return true;
+}
+
+/// Save Config to File, replacing any existing snapshot.
+bool TorcConfigLoader::WriteCache(const QString &File, const QByteArray &Key, const QVariantMap &Config)
+{
+    QSaveFile file(File);
+    if (!file.open(QIODevice::WriteOnly))
+    {
+        LOG(VB_GENERAL, LOG_WARNING, QStringLiteral("Failed to open '%1' for writing").arg(File));
+        return false;
+    }
+
+    QDataStream stream(&file);
+    stream.setVersion(CACHE_VERSION);
+    stream << (quint32)CACHE_MAGIC << Key << Config;
+
+    if (stream.status() != QDataStream::Ok || !file.commit())
+    {
+        LOG(VB_GENERAL, LOG_WARNING, QStringLiteral("Failed to save configuration cache '%1'").arg(File));
+        return false;
+    }
+
+    return true;
+}
+
+void TorcConfigLoader::run(void)
+{
+    QVariantMap config;
+    QByteArray xsd;
+    bool valid = LoadConfig(config, xsd);
+
+    QMutexLocker locker(&m_lock);
+    m_valid  = valid;
+    m_config = config;
+    m_xsd    = xsd;
+    m_done   = true;
+    m_wait.wakeAll();
+}
+
+bool TorcConfigLoader::Wait(QVariantMap &Config, QByteArray &XSD)
+{
+    QMutexLocker locker(&m_lock);
+    while (!m_done)
+        m_wait.wait(&m_lock);
+
+    Config = m_config;
+    XSD    = m_xsd;
+    return m_valid;
+}
+
+bool TorcConfigLoader::LoadConfig(QVariantMap &Config, QByteArray &XSD)
+{
+    bool validate = qEnvironmentVariableIsEmpty("TORC_NO_VALIDATION");
+    if (!validate)
+        LOG(VB_GENERAL, LOG_INFO, QStringLiteral("Skipping configuration file validation (command line)."));
+
+    QString xml = GetTorcConfigDir() + "/" + TORC_CONFIG_FILE;
+    QFile file(xml);
+    if (!file.open(QIODevice::ReadOnly))
+    {
+        LOG(VB_GENERAL, LOG_ERR, QStringLiteral("Failed to open configuration file '%1'").arg(xml));
+        return false;
+    }
+    QByteArray data = file.readAll();
+    file.close();
+
+#if defined(USING_XMLPATTERNS) || defined(USING_LIBXML2)
+    // customise the xsd now - even if validation is skipped, we need the xsd for reference
+    QString basexsd = GetTorcShareDir() + "/html/torc.xsd";
+    if (!QFile::exists(basexsd))
+    {
+        LOG(VB_GENERAL, LOG_ERR, QStringLiteral("Failed to find base XSD file '%1'").arg(basexsd));
+        return false;
+    }
+
+    XSD = TorcCentral::GetCustomisedXSD(basexsd);
+    if (XSD.isEmpty())
+    {
+        LOG(VB_GENERAL, LOG_ERR, QStringLiteral("Strange - empty xsd..."));
+        return false;
+    }
+#else
+    LOG(VB_GENERAL, LOG_INFO, QStringLiteral("Xml validation unavailable - not validating configuration file."));
+    validate = false;
+#endif
+
+    QString cache = GetTorcConfigDir() + "/" + TORC_CONFIG_CACHE;
+    QByteArray key = GetKey(data, XSD, validate);
+    if (ReadCache(cache, key, Config))
+    {
+        LOG(VB_GENERAL, LOG_INFO, QStringLiteral("Configuration unchanged since last validation - loaded from '%1'").arg(cache));
+        return true;
+    }
+
+#if defined(USING_XMLPATTERNS) || defined(USING_LIBXML2)
+    if (validate)
+    {
+        LOG(VB_GENERAL, LOG_INFO, QStringLiteral("Starting validation of configuration file"));
+        TorcXmlValidator validator(xml, XSD);
+        if (!validator.Validated())
+        {
+            LOG(VB_GENERAL, LOG_ERR, QStringLiteral("Configuration file '%1' failed validation").arg(xml));
+            return false;
+        }
+        LOG(VB_GENERAL, LOG_INFO, QStringLiteral("Configuration successfully validated"));
+    }
+#endif
+
+    if (!TorcCentral::ReadConfig(data, Config))
+        return false;
+
+    LOG(VB_GENERAL, LOG_INFO, QStringLiteral("Loaded config from %1").arg(xml));
+    (void)WriteCache(cache, key, Config);
+    return true;
+}
+
+/// Start loading the configuration before the network and HTTP server are started.
+static class TorcConfigLoaderObject : public TorcAdminObject
+{
+  public:
+    TorcConfigLoaderObject()
+      : TorcAdminObject(TORC_ADMIN_CRIT_PRIORITY + 5) // start before the network
+    {
+    }
+
+    void Create(void)
+    {
+        TorcConfigLoader::Prefetch();
+    }
+
+    void Destroy(void)
+    {
+        TorcConfigLoader::Cancel();
+    }
+} TorcConfigLoaderObject;
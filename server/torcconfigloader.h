@@ -0,0 +1,44 @@
+#ifndef TORCCONFIGLOADER_H
+#define TORCCONFIGLOADER_H
+
+// Qt
+#include <QMutex>
+#include <QVariant>
+#include <QRunnable>
+#include <QWaitCondition>
+
+#define TORC_CONFIG_CACHE (TORC_TORC + QStringLiteral(".cache"))
+
+class TorcConfigLoader final : public QRunnable
+{
+  public:
+    static void         Prefetch     (void);
+    static void         Cancel       (void);
+    static bool         Load         (QVariantMap &Config, QByteArray &XSD);
+    static QByteArray   GetKey       (const QByteArray &XML, const QByteArray &XSD, bool Validate);
+    static bool         ReadCache    (const QString &File, const QByteArray &Key, QVariantMap &Config);
+    static bool         WriteCache   (const QString &File, const QByteArray &Key, const QVariantMap &Config);
+
+    void                run          (void) override;
+
+  private:
+    TorcConfigLoader();
+   ~TorcConfigLoader() = default;
+
+    bool                Wait         (QVariantMap &Config, QByteArray &XSD);
+    static bool         LoadConfig   (QVariantMap &Config, QByteArray &XSD);
+
+  private:
+    Q_DISABLE_COPY(TorcConfigLoader)
+    QMutex              m_lock;
+    QWaitCondition      m_wait;
+    bool                m_done;
+    bool                m_valid;
+    QVariantMap         m_config;
+    QByteArray          m_xsd;
+
+    static QMutex           *gLoaderLock;
+    static TorcConfigLoader *gLoader;
+};
+
+#endif // TORCCONFIGLOADER_H
@@ -72,7 +72,9 @@ TorcDevice::~TorcDevice()
         QMutexLocker locker(gDeviceListLock);
 
         LOG(VB_GENERAL, LOG_INFO, QStringLiteral("Device id: %1 removed").arg(uniqueId));
-        gDeviceList->remove(uniqueId);
+        // NB a retired device may already have been replaced
+        if (gDeviceList->value(uniqueId) == this)
+            gDeviceList->remove(uniqueId);
     }
 }
 
@@ -98,10 +100,32 @@ void TorcDevice::Stop(void)
     SetValid(false);
 }
 
+/*! \brief Detach the device ahead of its deletion.
+ *
+ * The device is removed from the device list, so that a replacement can be created with the same uniqueId, and
+ * all of its outgoing connections are broken. Used when the configuration is reloaded - the device itself
+ * is deleted later, when its last reference is released.
+*/
+void TorcDevice::Retire(void)
+{
+    {
+        QMutexLocker locker(gDeviceListLock);
+        if (gDeviceList->value(uniqueId) == this)
+            gDeviceList->remove(uniqueId);
+    }
+
+    disconnect();
+}
+
 void TorcDevice::SetValid(bool Valid)
 {
     QMutexLocker locker(&lock);
+    SetValidPriv(Valid);
+}
 
+/// \note The caller must hold lock.
+void TorcDevice::SetValidPriv(bool Valid)
+{
     if (Valid == valid)
         return;
 
@@ -115,7 +139,12 @@ void TorcDevice::SetValid(bool Valid)
 void TorcDevice::SetValue(double Value)
 {
     QMutexLocker locker(&lock);
+    SetValuePriv(Value);
+}
 
+/// \note The caller must hold lock.
+void TorcDevice::SetValuePriv(double Value)
+{
     // force an update if the last value was 'invalid'
     if (wasInvalid)
     {
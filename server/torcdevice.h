@@ -19,6 +19,7 @@
 class TorcDevice : public QObject, public TorcReferenceCounter
 {
     friend class TorcCentral;
+    friend class TorcSimulator;
 
     Q_OBJECT
     Q_PROPERTY(bool     valid                   READ GetValid()                   NOTIFY   ValidChanged(Valid))
@@ -34,6 +35,7 @@ class TorcDevice : public QObject, public TorcReferenceCounter
 
     virtual void           Start                  (void);
     virtual void           Stop                   (void);
+    virtual void           Retire                 (void);
     virtual QStringList    GetDescription         (void);
 
   public slots:
@@ -54,6 +56,8 @@ class TorcDevice : public QObject, public TorcReferenceCounter
 
   protected:
     virtual ~TorcDevice();
+    void                   SetValidPriv           (bool   Valid);
+    void                   SetValuePriv           (double Value);
 
   protected:
     bool                   valid;
@@ -56,3 +56,16 @@ void TorcDeviceHandler::Stop(void)
     for ( ; handler; handler = handler->GetNextHandler())
         handler->Destroy();
 }
+
+/*! \brief Remove the devices in UniqueIds, appending the uniqueId of every device removed to Removed.
+ *
+ * A handler may remove devices that were not requested (e.g. every channel of an I2C device that cannot be
+ * partially removed) - which is why Removed is returned. Removed devices are released by their handler but
+ * it is up to the caller to disconnect them (see TorcDevice::Retire).
+*/
+void TorcDeviceHandler::Remove(const QStringList &UniqueIds, QStringList &Removed)
+{
+    TorcDeviceHandler* handler = TorcDeviceHandler::GetDeviceHandler();
+    for ( ; handler; handler = handler->GetNextHandler())
+        handler->RemoveDevices(UniqueIds, Removed);
+}
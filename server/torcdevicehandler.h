@@ -6,6 +6,7 @@
 #include <QMutex>
 #include <QReadWriteLock>
 #include <QVariant>
+#include <QStringList>
 
 class TorcDeviceHandler
 {
@@ -15,10 +16,12 @@ class TorcDeviceHandler
 
     static  void Start   (const QVariantMap &Details);
     static  void Stop    (void);
+    static  void Remove  (const QStringList &UniqueIds, QStringList &Removed);
 
   protected:
     virtual void                     Create           (const QVariantMap &Details) = 0;
     virtual void                     Destroy          (void) = 0;
+    virtual void                     RemoveDevices    (const QStringList &UniqueIds, QStringList &Removed) = 0;
     static TorcDeviceHandler*        GetDeviceHandler (void);
     TorcDeviceHandler*               GetNextHandler   (void);
 
@@ -0,0 +1,436 @@
+/* Class TorcSimulator
+*
+* Copyright (C) Mark Kendall 2018
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+*/
+
+// Qt
+#include <QFile>
+#include <QElapsedTimer>
+#include <QCoreApplication>
+
+// Torc
+#include "torclocalcontext.h"
+#include "torcexitcodes.h"
+#include "torclogging.h"
+#include "torcdirectories.h"
+#include "torccoreutils.h"
+#include "torcclock.h"
+#include "torccentral.h"
+#include "inputs/torcinput.h"
+#include "inputs/torcsysteminputs.h"
+#include "outputs/torcoutput.h"
+#include "controls/torccontrols.h"
+#include "controls/torctimerscheduler.h"
+#include "controls/torctransitionclock.h"
+#include "torcsimulator.h"
+
+// std
+#include <algorithm>
+
+/*! \class TorcSimulator
+ *  \brief Run the current configuration offline against a timeline of input values.
+ *
+ * The simulator is started with the 'simulate' command line option, which names the timeline file, and loads the
+ * configuration file from the usual location (see the 'config' option).
+ *
+ * Every platform (hardware) input and output is replaced with the network device of the equivalent type, so the
+ * configuration can be run on any machine. Notifications are disabled.
+ *
+ * TorcClock is switched to a virtual clock and the simulator moves it directly from one event to the next - whether
+ * that is the next value in the timeline, the next timer transition or the next transition update - so a week
+ * of history runs in seconds. Every change to an output is written to the trace (the 'trace' option or stdout) as
+ *
+ * \code
+ * time,device,value
+ * \endcode
+ *
+ * A timeline has one value per line in the same format, where time is either an ISO 8601 date and time or a number of
+ * seconds from the start of the simulation. The simulation starts at the earliest absolute time or, if there is none,
+ * the current time. A line with only a time extends the simulation to that time. Lines starting with '#' are ignored.
+ *
+ * \note System inputs with a delay and button pulses still use real timers.
+*/
+TorcSimulator::TorcSimulator(QTextStream *Trace)
+  : m_trace(Trace),
+    m_events(0),
+    m_changes(0),
+    m_steps(0)
+{
+}
+
+int TorcSimulator::RunSimulation(TorcCommandLine *CommandLine)
+{
+    if (!CommandLine)
+        return TORC_EXIT_INVALID_CMDLINE;
+
+    if (int error = TorcLocalContext::Create(CommandLine, false))
+        return error;
+
+    int result = TORC_EXIT_UNKOWN_ERROR;
+    QString xml       = GetTorcConfigDir() + "/" + TORC_CONFIG_FILE;
+    QString timeline  = CommandLine->GetValue(QStringLiteral("simulate")).toString();
+    QString tracefile = CommandLine->GetValue(QStringLiteral("trace")).toString();
+
+    QVariantMap config;
+    QFile timelinefile(timeline);
+    QFile trace(tracefile);
+    QVector<Event> events;
+    qint64 start = QDateTime::currentMSecsSinceEpoch();
+    qint64 end   = start;
+    QString error;
+
+    if (!TorcCentral::ReadConfig(xml, config))
+    {
+        LOG(VB_GENERAL, LOG_ERR, QStringLiteral("Failed to read configuration file '%1'").arg(xml));
+    }
+    else if (!timelinefile.open(QIODevice::ReadOnly))
+    {
+        LOG(VB_GENERAL, LOG_ERR, QStringLiteral("Failed to open timeline '%1'").arg(timeline));
+    }
+    else if (!ParseTimeline(timelinefile.readAll(), start, events, end, error))
+    {
+        LOG(VB_GENERAL, LOG_ERR, QStringLiteral("Failed to parse timeline '%1' (%2)").arg(timeline, error));
+    }
+    else if (tracefile.isEmpty() ? !trace.open(stdout, QIODevice::WriteOnly) : !trace.open(QIODevice::WriteOnly | QIODevice::Truncate))
+    {
+        LOG(VB_GENERAL, LOG_ERR, QStringLiteral("Failed to open '%1' for writing").arg(tracefile));
+    }
+    else
+    {
+        LOG(VB_GENERAL, LOG_INFO, QStringLiteral("Simulating '%1' from %2 to %3 (%4 events)")
+            .arg(xml, QDateTime::fromMSecsSinceEpoch(start).toString(Qt::ISODate),
+                 QDateTime::fromMSecsSinceEpoch(end).toString(Qt::ISODate)).arg(events.size()));
+
+        QTextStream stream(&trace);
+        stream << "# time,device,value\n";
+        if (Simulate(config, events, start, end, &stream))
+            result = TORC_EXIT_OK;
+        stream.flush();
+    }
+
+    TorcLocalContext::TearDown();
+    return result;
+}
+
+/*! \brief Create the devices in Config, run the simulation from Start to End and remove the devices.
+ *
+ * Config is virtualised first. Every change to an output is written to Trace.
+*/
+bool TorcSimulator::Simulate(const QVariantMap &Config, const QVector<Event> &Events, qint64 Start, qint64 End, QTextStream *Trace)
+{
+    if (!Trace)
+        return false;
+
+    TorcClock::SetVirtualTime(Start);
+    TorcDeviceHandler::Start(Virtualise(Config));
+    TorcControls::gControls->Validate();
+
+    TorcSimulator simulator(Trace);
+    QList<QMetaObject::Connection> connections;
+    {
+        QMutexLocker locker(TorcDevice::gDeviceListLock);
+        QHash<QString,TorcDevice*>::const_iterator it = TorcDevice::gDeviceList->constBegin();
+        for ( ; it != TorcDevice::gDeviceList->constEnd(); ++it)
+        {
+            if (qobject_cast<TorcOutput*>(it.value()))
+            {
+                QString id = it.key();
+                connections.append(QObject::connect(it.value(), &TorcDevice::ValueChanged, [&simulator, id](double Value) { simulator.Trace(id, Value); }));
+            }
+        }
+
+        for (it = TorcDevice::gDeviceList->constBegin(); it != TorcDevice::gDeviceList->constEnd(); ++it)
+            it.value()->Start();
+    }
+    TorcLocalContext::NotifyEvent(Torc::Start);
+
+    bool result = simulator.Run(Events, Start, End);
+
+    TorcDeviceHandler::Stop();
+    foreach (const QMetaObject::Connection &connection, connections)
+        QObject::disconnect(connection);
+    TorcClock::SetRealTime();
+    return result;
+}
+
+/*! \brief Replace every platform device in Config with the network device of the same type.
+ *
+ * Network and constant devices and system inputs are unchanged. The notify section is removed.
+*/
+QVariantMap TorcSimulator::Virtualise(const QVariantMap &Config)
+{
+    QStringList types;
+    types << TorcCoreUtils::EnumToLowerString<TorcInput::Type>(TorcInput::Temperature)
+          << TorcCoreUtils::EnumToLowerString<TorcInput::Type>(TorcInput::pH)
+          << TorcCoreUtils::EnumToLowerString<TorcInput::Type>(TorcInput::Switch)
+          << TorcCoreUtils::EnumToLowerString<TorcInput::Type>(TorcInput::PWM)
+          << TorcCoreUtils::EnumToLowerString<TorcInput::Type>(TorcInput::Button)
+          << TorcCoreUtils::EnumToLowerString<TorcInput::Type>(TorcInput::Integer);
+
+    QVariantMap result;
+    QVariantMap::const_iterator it = Config.constBegin();
+    for ( ; it != Config.constEnd(); ++it)
+    {
+        if (it.key() == QStringLiteral("notify"))
+            continue;
+
+        if (it.key() != INPUTS_DIRECTORY && it.key() != OUTPUTS_DIRECTORY)
+        {
+            result.insertMulti(it.key(), it.value());
+            continue;
+        }
+
+        QVariantMap devices = it.value().toMap();
+        QVariantMap network = devices.value(NETWORK_DEVICE_STRING).toMap();
+        QVariantMap groups;
+        QVariantMap::const_iterator group = devices.constBegin();
+        for ( ; group != devices.constEnd(); ++group)
+        {
+            if (group.key() == NETWORK_DEVICE_STRING)
+                continue;
+            if (group.key() == CONSTANT_DEVICE_STRING || group.key() == SYSTEM_INPUTS_STRING)
+                groups.insertMulti(group.key(), group.value());
+            else
+                VirtualiseDevices(group.value().toMap(), types, QString(), network);
+        }
+
+        if (!network.isEmpty())
+            groups.insert(NETWORK_DEVICE_STRING, network);
+        result.insertMulti(it.key(), groups);
+    }
+    return result;
+}
+
+/*! \brief Add a network device to Network for every device found in Devices.
+ *
+ * A device is any element with a name. Its type is taken from its own tag (e.g. <switch>) or the nearest parent
+ * with a recognised tag (e.g. <pca9685>).
+*/
+void TorcSimulator::VirtualiseDevices(const QVariantMap &Devices, const QStringList &Types, const QString &Type, QVariantMap &Network)
+{
+    static QHash<QString,QString> platformtypes;
+    if (platformtypes.isEmpty())
+    {
+        platformtypes.insert(QStringLiteral("ds18b20"), TorcCoreUtils::EnumToLowerString<TorcInput::Type>(TorcInput::Temperature));
+        platformtypes.insert(QStringLiteral("pca9685"), TorcCoreUtils::EnumToLowerString<TorcInput::Type>(TorcInput::PWM));
+    }
+
+    QVariantMap::const_iterator it = Devices.constBegin();
+    for ( ; it != Devices.constEnd(); ++it)
+    {
+        if (it.value().type() != QVariant::Map)
+            continue;
+
+        QString type = Types.contains(it.key()) ? it.key() : platformtypes.value(it.key(), Type);
+        QVariantMap details = it.value().toMap();
+        if (!details.contains(QStringLiteral("name")))
+        {
+            VirtualiseDevices(details, Types, type, Network);
+            continue;
+        }
+
+        QString name = details.value(QStringLiteral("name")).toString();
+        if (type.isEmpty())
+        {
+            LOG(VB_GENERAL, LOG_WARNING, QStringLiteral("Cannot simulate '%1' (unknown type '%2')").arg(name, it.key()));
+            continue;
+        }
+
+        QVariantMap device;
+        device.insert(QStringLiteral("name"), name);
+        device.insert(QStringLiteral("default"), details.value(QStringLiteral("default"), 0));
+        if (details.contains(QStringLiteral("username")))
+            device.insert(QStringLiteral("username"), details.value(QStringLiteral("username")));
+        if (details.contains(QStringLiteral("userdescription")))
+            device.insert(QStringLiteral("userdescription"), details.value(QStringLiteral("userdescription")));
+        Network.insertMulti(type, device);
+        LOG(VB_GENERAL, LOG_INFO, QStringLiteral("Simulating '%1' as network %2").arg(name, type));
+    }
+}
+
+/*! \brief Parse a timeline into Events, sorted by time.
+ *
+ * On entry, Start is the default start time. If the timeline contains absolute times, Start is set to the earliest.
+ * End is set to the time of the last line.
+*/
+bool TorcSimulator::ParseTimeline(const QByteArray &Timeline, qint64 &Start, QVector<Event> &Events, qint64 &End, QString &Error)
+{
+    QVector<Event> relative;
+    QVector<Event> absolute;
+    bool haveabsolute = false;
+    qint64 first = 0;
+
+    QList<QByteArray> lines = Timeline.split('\n');
+    for (int index = 0; index < lines.size(); ++index)
+    {
+        QString line = QString::fromUtf8(lines.at(index)).trimmed();
+        if (line.isEmpty() || line.startsWith('#'))
+            continue;
+
+        QStringList fields = line.split(',');
+        if (fields.size() != 1 && fields.size() != 3)
+        {
+            Error = QStringLiteral("line %1: expected time,device,value").arg(index + 1);
+            return false;
+        }
+
+        Event event { 0, QString(), 0.0 };
+        if (fields.size() == 3)
+        {
+            bool ok = false;
+            event.device = fields.at(1).trimmed();
+            event.value  = fields.at(2).trimmed().toDouble(&ok);
+            if (!ok || event.device.isEmpty())
+            {
+                Error = QStringLiteral("line %1: invalid device or value").arg(index + 1);
+                return false;
+            }
+        }
+
+        bool ok = false;
+        QString time   = fields.at(0).trimmed();
+        double seconds = time.toDouble(&ok);
+        if (ok)
+        {
+            event.time = qRound64(seconds * 1000.0);
+            relative.append(event);
+            continue;
+        }
+
+        QDateTime datetime = QDateTime::fromString(time, Qt::ISODate);
+        if (!datetime.isValid())
+        {
+            Error = QStringLiteral("line %1: invalid time '%2'").arg(index + 1).arg(time);
+            return false;
+        }
+
+        event.time = datetime.toMSecsSinceEpoch();
+        if (!haveabsolute || event.time < first)
+            first = event.time;
+        haveabsolute = true;
+        absolute.append(event);
+    }
+
+    if (haveabsolute)
+        Start = first;
+
+    Events = absolute;
+    foreach (Event event, relative)
+    {
+        event.time += Start;
+        Events.append(event);
+    }
+
+    // NB stable sort preserves the order of values for the same time
+    std::stable_sort(Events.begin(), Events.end(), [](const Event &One, const Event &Two) { return One.time < Two.time; });
+
+    End = Events.isEmpty() ? Start : Events.last().time;
+
+    // lines with no device only set the end time
+    Events.erase(std::remove_if(Events.begin(), Events.end(), [](const Event &Item) { return Item.device.isEmpty(); }), Events.end());
+    return true;
+}
+
+/*! \brief Run the simulation from Start to End.
+ *
+ * At each step the virtual clock is moved to the earliest of the next timeline value, timer transition and
+ * transition update. Values are applied first, then timers and transitions, and the control graph is
+ * propagated before the next step.
+*/
+bool TorcSimulator::Run(const QVector<Event> &Events, qint64 Start, qint64 End)
+{
+    QElapsedTimer elapsed;
+    elapsed.start();
+
+    // resolve inputs once
+    QHash<QString,TorcInput*> inputs;
+    {
+        QMutexLocker locker(TorcDevice::gDeviceListLock);
+        foreach (const Event &event, Events)
+        {
+            if (inputs.contains(event.device))
+                continue;
+            TorcInput *input = qobject_cast<TorcInput*>(TorcDevice::gDeviceList->value(event.device));
+            if (!input)
+                LOG(VB_GENERAL, LOG_WARNING, QStringLiteral("Timeline input '%1' not found - ignoring").arg(event.device));
+            inputs.insert(event.device, input);
+        }
+    }
+
+    Settle();
+
+    qint64 now  = Start;
+    int    next = 0;
+    forever
+    {
+        qint64 due = End + 1;
+        if (next < Events.size())
+            due = qMin(due, Events.at(next).time);
+        quint64 timer = 0;
+        if (TorcTimerScheduler::gTimerScheduler->NextDue(timer))
+            due = qMin(due, (qint64)timer);
+        qint64 transition = 0;
+        if (TorcTransitionClock::gTransitionClock->NextDue(transition))
+            due = qMin(due, transition);
+
+        if (due > End)
+            break;
+
+        now = qMax(now, due);
+        TorcClock::SetVirtualTime(now);
+        m_steps++;
+
+        for ( ; next < Events.size() && Events.at(next).time <= now; ++next)
+        {
+            TorcInput *input = inputs.value(Events.at(next).device);
+            if (input)
+            {
+                input->SetValue(Events.at(next).value);
+                m_events++;
+            }
+        }
+
+        TorcTimerScheduler::gTimerScheduler->Service();
+        TorcTransitionClock::gTransitionClock->Service();
+        Settle();
+    }
+
+    TorcClock::SetVirtualTime(End);
+
+    qint64 wall = qMax(elapsed.elapsed(), (qint64)1);
+    LOG(VB_GENERAL, LOG_INFO, QStringLiteral("Simulated %1 seconds in %2ms (%3x real time)")
+        .arg((End - Start) / 1000).arg(wall).arg((End - Start) / wall));
+    LOG(VB_GENERAL, LOG_INFO, QStringLiteral("%1 input values, %2 steps, %3 output changes, %4 transition updates (%5 suppressed)")
+        .arg(m_events).arg(m_steps).arg(m_changes)
+        .arg(TorcTransitionClock::gTransitionClock->Updates()).arg(TorcTransitionClock::gTransitionClock->Suppressed()));
+    return true;
+}
+
+void TorcSimulator::Trace(const QString &Device, double Value)
+{
+    m_changes++;
+    *m_trace << TorcClock::CurrentDateTime().toString(QStringLiteral("yyyy-MM-ddTHH:mm:ss.zzz")) << ',' << Device << ',' << Value << '\n';
+}
+
+/// Deliver any pending events and complete the current control graph pass.
+void TorcSimulator::Settle(void)
+{
+    QCoreApplication::sendPostedEvents();
+    TorcControls::gControls->Propagate();
+    // deliver output changes from components evaluated on the thread pool
+    QCoreApplication::sendPostedEvents();
+}
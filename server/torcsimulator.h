@@ -0,0 +1,48 @@
+#ifndef TORCSIMULATOR_H
+#define TORCSIMULATOR_H
+
+// Qt
+#include <QVector>
+#include <QVariant>
+#include <QTextStream>
+
+// Torc
+#include "torccommandline.h"
+
+class TorcSimulator
+{
+  public:
+    class Event
+    {
+      public:
+        qint64  time;
+        QString device;
+        double  value;
+    };
+
+    static int          RunSimulation     (TorcCommandLine *CommandLine);
+    static bool         Simulate          (const QVariantMap &Config, const QVector<Event> &Events, qint64 Start,
+                                           qint64 End, QTextStream *Trace);
+    static QVariantMap  Virtualise        (const QVariantMap &Config);
+    static bool         ParseTimeline     (const QByteArray &Timeline, qint64 &Start, QVector<Event> &Events,
+                                           qint64 &End, QString &Error);
+
+  private:
+    explicit TorcSimulator(QTextStream *Trace);
+    ~TorcSimulator() = default;
+
+    static void         VirtualiseDevices (const QVariantMap &Devices, const QStringList &Types, const QString &Type,
+                                           QVariantMap &Network);
+    bool                Run               (const QVector<Event> &Events, qint64 Start, qint64 End);
+    void                Trace             (const QString &Device, double Value);
+    void                Settle            (void);
+
+  private:
+    Q_DISABLE_COPY(TorcSimulator)
+    QTextStream        *m_trace;
+    quint64             m_events;
+    quint64             m_changes;
+    quint64             m_steps;
+};
+
+#endif // TORCSIMULATOR_H
@@ -5,13 +5,79 @@
 // Torc
 #include "testserialisers.h"
 #include "testtorclocalcontext.h"
+#include "testtorcpropagator.h"
+#include "testtorcexpression.h"
+#include "testtorctimerwheel.h"
+#include "testtorcsimulator.h"
+#include "testtorcmaths.h"
+#include "testtorcconfigdiff.h"
+#include "testtorcconfigloader.h"
+#include "testtorc1wiremaster.h"
+#include "testtorcpca9685.h"
+#include "testtorcoutputqueue.h"
+#include "testtorcinputfilter.h"
+#include "testtorcinputs.h"
+#include "testtorcmqtt.h"
+#include "testtorcmodbus.h"
+#include "testtorcwebsocket.h"
+#include "testtorchttpservice.h"
+#include "testtorctransitionclock.h"
+#ifdef Q_OS_LINUX
+#include "testtorcgpioevents.h"
+#include "testtorcpwmprovider.h"
+#include "testtorciiodevice.h"
+#endif
 
 int main(int argc, char** argv) {
     QCoreApplication app(argc, argv);
 
     TestSerialisers testSerialisers;
+    TestTorcPropagator testPropagator;
+    TestTorcExpression testExpression;
+    TestTorcTimerWheel testTimerWheel;
+    TestTorcSimulator testSimulator;
+    TestTorcMaths testMaths;
+    TestTorcConfigDiff testConfigDiff;
+    TestTorcConfigLoader testConfigLoader;
+    TestTorc1WireMaster test1WireMaster;
+    TestTorcPCA9685 testPCA9685;
+    TestTorcOutputQueue testOutputQueue;
+    TestTorcInputFilter testInputFilter;
+    TestTorcInputs testInputs;
+    TestTorcMQTT testMQTT;
+    TestTorcModbus testModbus;
+    TestTorcWebSocket testWebSocket;
+    TestTorcHTTPService testHTTPService;
+    TestTorcTransitionClock testTransitionClock;
+#ifdef Q_OS_LINUX
+    TestTorcGPIOEvents testGPIOEvents;
+    TestTorcPWMProvider testPWMProvider;
+    TestTorcIIODevice testIIODevice;
+#endif
     TestTorcLocalContext testLocalContext(argc, argv);
     int status = QTest::qExec(&testSerialisers);
+    status    |= QTest::qExec(&testPropagator);
+    status    |= QTest::qExec(&testExpression);
+    status    |= QTest::qExec(&testTimerWheel);
+    status    |= QTest::qExec(&testSimulator);
+    status    |= QTest::qExec(&testMaths);
+    status    |= QTest::qExec(&testConfigDiff);
+    status    |= QTest::qExec(&testConfigLoader);
+    status    |= QTest::qExec(&test1WireMaster);
+    status    |= QTest::qExec(&testPCA9685);
+    status    |= QTest::qExec(&testOutputQueue);
+    status    |= QTest::qExec(&testInputFilter);
+    status    |= QTest::qExec(&testInputs);
+    status    |= QTest::qExec(&testMQTT);
+    status    |= QTest::qExec(&testModbus);
+    status    |= QTest::qExec(&testWebSocket);
+    status    |= QTest::qExec(&testHTTPService);
+    status    |= QTest::qExec(&testTransitionClock);
+#ifdef Q_OS_LINUX
+    status    |= QTest::qExec(&testGPIOEvents);
+    status    |= QTest::qExec(&testPWMProvider);
+    status    |= QTest::qExec(&testIIODevice);
+#endif
     status    |= QTest::qExec(&testLocalContext);
     return status;
 }
@@ -5,6 +5,7 @@
 // Torc
 #include "torcjsonserialiser.h"
 #include "torcxmlreader.h"
+#include "torcplist.h"
 #include "testserialisers.h"
 
 void TestSerialisers::testJSONSerialiser(void)
@@ -26,6 +27,51 @@ void TestSerialisers::testJSONSerialiser(void)
     QVERIFY(array2 == array);
 }
 
+void TestSerialisers::testJSONStreaming(void)
+{
+    QVariantMap item;
+    item.insert("name", "a \"quoted\"\tname");
+    item.insert("value", 1.5);
+    item.insert("valid", true);
+    item.insert("list", QStringList() << "one" << "two");
+    item.insert("empty", QVariant());
+
+    TorcSerialiser* jsonserialiser = TorcSerialiser::GetSerialiser("application/json");
+    QVERIFY(jsonserialiser);
+    QByteArray data;
+    jsonserialiser->Start(data);
+    jsonserialiser->StartObject(data, "item");
+    jsonserialiser->AddProperty(data, "first", item);
+    jsonserialiser->StartArray(data, "numbers");
+    for (int i = 0; i < 3; ++i)
+        jsonserialiser->AddValue(data, QString(), i);
+    jsonserialiser->EndArray(data);
+    jsonserialiser->EndObject(data);
+    jsonserialiser->Finish(data);
+    delete jsonserialiser;
+
+    QVariantMap inner;
+    inner.insert("first", item);
+    inner.insert("numbers", QVariantList() << 0 << 1 << 2);
+    QVariantMap outer;
+    outer.insert("item", inner);
+
+    QJsonParseError error;
+    QJsonDocument doc = QJsonDocument::fromJson(data, &error);
+    QVERIFY(error.error == QJsonParseError::NoError);
+    QVERIFY(doc == QJsonDocument::fromVariant(outer));
+
+    // integral numbers (e.g. millisecond timestamps) are not written in exponent form
+    QVariantList numbers;
+    numbers << 1000000.0 << 1700000000000.0 << -42.0 << 0.5 << 9007199254740992.0 << 1e300;
+    jsonserialiser = TorcSerialiser::GetSerialiser("application/json");
+    QVERIFY(jsonserialiser);
+    data.clear();
+    jsonserialiser->Serialise(data, numbers, "numbers");
+    delete jsonserialiser;
+    QCOMPARE(data, QByteArray("{\"numbers\":[1000000,1700000000000,-42,0.5,9007199254740992,1e+300]}"));
+}
+
 void TestSerialisers::doTestXMLSerialiser(QByteArray &Data)
 {
     TorcXMLReader reader(Data);
@@ -55,3 +101,73 @@ void TestSerialisers::testXMLSerialiser(void)
         doTestXMLSerialiser(t);
     }
 }
+
+/*! \brief Return a payload representative of TorcHTTPService::GetServiceDetails.
+ *
+ * Every property and method repeats the same keys and many of the same values.
+*/
+QVariantMap TestSerialisers::ServiceDescription(void)
+{
+    QVariantMap properties;
+    for (int i = 0; i < 40; ++i)
+    {
+        QString name = QString("property%1").arg(i);
+        QVariantMap description;
+        description.insert("notification", name + "Changed");
+        description.insert("read", "Get" + name);
+        if (i % 2)
+            description.insert("write", "Set" + name);
+        description.insert("value", (i % 3) ? QVariant((double)i) : QVariant(bool(i % 2)));
+        properties.insert(name, description);
+    }
+
+    QVariantMap methods;
+    for (int i = 0; i < 60; ++i)
+    {
+        QVariantList params;
+        for (int j = 0; j < i % 4; ++j)
+            params.append(QString("Param%1").arg(j));
+        QVariantMap method;
+        method.insert("params", params);
+        method.insert("returns", (i % 2) ? "string" : "object");
+        methods.insert(QString("Method%1").arg(i), method);
+    }
+
+    QVariantMap details;
+    details.insert("properties", properties);
+    details.insert("methods", methods);
+    return details;
+}
+
+void TestSerialisers::testBinaryPListSerialiser(void)
+{
+    QVariantMap details = ServiceDescription();
+    TorcSerialiser* serialiser = TorcSerialiser::GetSerialiser("application/x-plist");
+    QVERIFY(serialiser);
+    QByteArray data;
+    serialiser->Serialise(data, details, "details");
+    delete serialiser;
+
+    TorcPList plist(data);
+    QVERIFY(plist.GetValue("details") == QVariant(details));
+}
+
+void TestSerialisers::benchmarkBinaryPListSerialiser(void)
+{
+    QVariantMap details = ServiceDescription();
+    TorcSerialiser* serialiser = TorcSerialiser::GetSerialiser("application/x-plist");
+    QVERIFY(serialiser);
+    QByteArray data;
+    QBENCHMARK
+    {
+        data.clear();
+        serialiser->Serialise(data, details, "details");
+    }
+    delete serialiser;
+
+    QByteArray json;
+    serialiser = TorcSerialiser::GetSerialiser("application/json");
+    serialiser->Serialise(json, details, "details");
+    delete serialiser;
+    qDebug("Binary plist %d bytes (JSON %d bytes)", data.size(), json.size());
+}
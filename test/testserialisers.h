@@ -9,10 +9,14 @@ class TestSerialisers : public QObject
 
   private slots:
     void testJSONSerialiser(void);
+    void testJSONStreaming(void);
     void testXMLSerialiser(void);
+    void testBinaryPListSerialiser(void);
+    void benchmarkBinaryPListSerialiser(void);
 
   private:
     void doTestXMLSerialiser(QByteArray &Data);
+    static QVariantMap ServiceDescription(void);
 };
 
 #endif // TESTSERIALISERS_H
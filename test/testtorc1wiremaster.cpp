@@ -0,0 +1,128 @@
+// Qt
+#include <QtTest/QtTest>
+#include <QTemporaryDir>
+
+// Torc
+#include "torc1wiremaster.h"
+#include "testtorchelpers.h"
+#include "testtorc1wiremaster.h"
+
+class Test1WireListener final : public Torc1WireListener
+{
+  public:
+    Test1WireListener() : Torc1WireListener(), m_readings(0), m_value(0.0), m_valid(false) { }
+
+    void TemperatureRead(double Value, bool Valid) override
+    {
+        m_readings++;
+        m_value = Value;
+        m_valid = Valid;
+    }
+
+    int    m_readings;
+    double m_value;
+    bool   m_valid;
+};
+
+// add a sensor to the fake bus master and link it from the device directory, as the kernel does
+static bool AddSensor(const QString &Root, const QString &Serial, const QByteArray &Slave, const QByteArray &Resolution = QByteArray())
+{
+    QDir dir(Root);
+    if (!dir.mkpath(QStringLiteral("w1_bus_master1/") + Serial))
+        return false;
+    QString path = Root + "/w1_bus_master1/" + Serial;
+    if (!TestTorcHelpers::WriteFile(path + "/w1_slave", Slave))
+        return false;
+    if (!Resolution.isEmpty() && !TestTorcHelpers::WriteFile(path + "/resolution", Resolution))
+        return false;
+    return QFile::link(path, Root + "/devices/" + Serial);
+}
+
+void TestTorc1WireMaster::testParse(void)
+{
+    int value = 0;
+    QVERIFY(Torc1WireMaster::ParseSlave(QByteArray("72 01 4b 46 7f ff 0e 10 57 : crc=57 YES\n72 01 4b 46 7f ff 0e 10 57 t=23125\n"), value));
+    QCOMPARE(value, 23125);
+    QVERIFY(Torc1WireMaster::ParseSlave(QByteArray("ec ff 4b 46 7f ff 0c 10 4e : crc=4e YES\nec ff 4b 46 7f ff 0c 10 4e t=-1250\n"), value));
+    QCOMPARE(value, -1250);
+    QVERIFY(Torc1WireMaster::ParseSlave(QByteArray("00 00 00 00 00 00 00 00 00 : crc=00 YES\n00 00 00 00 00 00 00 00 00 t=0"), value));
+    QCOMPARE(value, 0);
+
+    value = 42;
+    QVERIFY(!Torc1WireMaster::ParseSlave(QByteArray("72 01 4b 46 7f ff 0e 10 57 : crc=57 NO\n72 01 4b 46 7f ff 0e 10 57 t=23125\n"), value));
+    QVERIFY(!Torc1WireMaster::ParseSlave(QByteArray("72 01 4b 46 7f ff 0e 10 57 : crc=57 YES\n72 01 4b 46 7f ff 0e 10 57\n"), value));
+    QVERIFY(!Torc1WireMaster::ParseSlave(QByteArray("72 01 4b 46 7f ff 0e 10 57 : crc=57 YES\n72 01 4b 46 7f ff 0e 10 57 t=-\n"), value));
+    QVERIFY(!Torc1WireMaster::ParseSlave(QByteArray("t=23125\n"), value));
+    QVERIFY(!Torc1WireMaster::ParseSlave(QByteArray(), value));
+    QCOMPARE(value, 42);
+}
+
+void TestTorc1WireMaster::testConversionTime(void)
+{
+    QCOMPARE(Torc1WireMaster::ConversionTime(9),  93);
+    QCOMPARE(Torc1WireMaster::ConversionTime(10), 187);
+    QCOMPARE(Torc1WireMaster::ConversionTime(11), 375);
+    QCOMPARE(Torc1WireMaster::ConversionTime(12), 750);
+    QCOMPARE(Torc1WireMaster::ConversionTime(0),  93);
+    QCOMPARE(Torc1WireMaster::ConversionTime(16), 750);
+}
+
+void TestTorc1WireMaster::testBulkRead(void)
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    QString root = dir.path();
+    QVERIFY(QDir(root).mkpath(QStringLiteral("devices")));
+    QVERIFY(QDir(root).mkpath(QStringLiteral("w1_bus_master1")));
+    QVERIFY(TestTorcHelpers::WriteFile(root + "/w1_bus_master1/therm_bulk_read", QByteArray("0\n")));
+
+    QVERIFY(AddSensor(root, QStringLiteral("28-000000000001"), QByteArray("72 01 4b 46 7f ff 0e 10 57 : crc=57 YES\n72 01 4b 46 7f ff 0e 10 57 t=23125\n"), QByteArray("9\n")));
+    QVERIFY(AddSensor(root, QStringLiteral("28-000000000002"), QByteArray("72 01 4b 46 7f ff 0e 10 57 : crc=57 NO\n72 01 4b 46 7f ff 0e 10 57 t=23125\n"), QByteArray("10\n")));
+    QVERIFY(AddSensor(root, QStringLiteral("28-000000000003"), QByteArray("ec ff 4b 46 7f ff 0c 10 4e : crc=4e YES\nec ff 4b 46 7f ff 0c 10 4e t=-1250\n")));
+
+    QString master = Torc1WireMaster::GetMasterDirectory(root + "/devices/", QStringLiteral("28-000000000001"));
+    QCOMPARE(master, QFileInfo(root + "/w1_bus_master1").canonicalFilePath() + '/');
+    QVERIFY(Torc1WireMaster::GetMasterDirectory(root + "/devices/", QStringLiteral("28-000000000009")).isEmpty());
+
+    Torc1WireMaster bus(master, 1000);
+    Test1WireListener sensor1, sensor2, sensor3, missing;
+    bus.AddSensor(QStringLiteral("28-000000000001"), &sensor1);
+    bus.AddSensor(QStringLiteral("28-000000000002"), &sensor2);
+    bus.AddSensor(QStringLiteral("28-000000000003"), &sensor3);
+    bus.AddSensor(QStringLiteral("28-000000000009"), &missing);
+    bus.Start();
+
+    // one conversion for the whole bus...
+    QTRY_VERIFY_WITH_TIMEOUT(sensor1.m_readings > 0, 3000);
+    QCOMPARE(bus.GetConversionCount(), (quint64)1);
+    QCOMPARE(bus.GetCycleCount(), (quint64)1);
+    QFile bulk(master + "therm_bulk_read");
+    QVERIFY(bulk.open(QIODevice::ReadOnly));
+    QCOMPARE(bulk.readAll(), QByteArray("trigger\n"));
+    bulk.close();
+
+    // ...then every sensor is read
+    QCOMPARE(sensor1.m_readings, 1);
+    QVERIFY(sensor1.m_valid);
+    QCOMPARE(sensor1.m_value, 23.125);
+    QCOMPARE(sensor2.m_readings, 1);
+    QVERIFY(!sensor2.m_valid);
+    QCOMPARE(sensor3.m_readings, 1);
+    QVERIFY(sensor3.m_valid);
+    QCOMPARE(sensor3.m_value, -1.25);
+    QCOMPARE(missing.m_readings, 1);
+    QVERIFY(!missing.m_valid);
+
+    // the next cycle picks up new values and skips removed sensors
+    QVERIFY(TestTorcHelpers::WriteFile(master + "28-000000000001/w1_slave", QByteArray("72 01 4b 46 7f ff 0e 10 57 : crc=57 YES\n72 01 4b 46 7f ff 0e 10 57 t=24000\n")));
+    QVERIFY(!bus.RemoveSensor(QStringLiteral("28-000000000009")));
+    QTRY_VERIFY_WITH_TIMEOUT(sensor1.m_readings > 1, 3000);
+    QCOMPARE(sensor1.m_value, 24.0);
+    QCOMPARE(missing.m_readings, 1);
+    QCOMPARE(bus.GetConversionCount(), (quint64)2);
+
+    bus.Stop();
+    QVERIFY(!bus.RemoveSensor(QStringLiteral("28-000000000001")));
+    QVERIFY(!bus.RemoveSensor(QStringLiteral("28-000000000002")));
+    QVERIFY(bus.RemoveSensor(QStringLiteral("28-000000000003")));
+}
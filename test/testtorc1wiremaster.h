@@ -0,0 +1,16 @@
+#ifndef TESTTORC1WIREMASTER_H
+#define TESTTORC1WIREMASTER_H
+
+#include <QObject>
+
+class TestTorc1WireMaster : public QObject
+{
+    Q_OBJECT
+
+  private slots:
+    void testParse(void);
+    void testConversionTime(void);
+    void testBulkRead(void);
+};
+
+#endif // TESTTORC1WIREMASTER_H
@@ -0,0 +1,211 @@
+// Qt
+#include <QtTest/QtTest>
+
+// Torc
+#include "torcconfigdiff.h"
+#include "testtorcconfigdiff.h"
+
+static QVariantMap Device(const QString &Name, const QString &Key = QString(), const QString &Value = QString())
+{
+    QVariantMap device;
+    device.insert(QStringLiteral("name"), Name);
+    if (!Key.isEmpty())
+        device.insert(Key, Value);
+    return device;
+}
+
+static QVariantMap Control(const QString &Name, const QString &Input, const QString &Output)
+{
+    QVariantMap control = Device(Name);
+    QVariantMap inputs;
+    inputs.insert(QStringLiteral("device"), Input);
+    QVariantMap outputs;
+    outputs.insert(QStringLiteral("device"), Output);
+    control.insert(QStringLiteral("inputs"), inputs);
+    control.insert(QStringLiteral("outputs"), outputs);
+    return control;
+}
+
+// two network switches, a network pwm output, a PCA9685 with two channels and a chain of two controls
+static QVariantMap Config(void)
+{
+    QVariantMap network;
+    network.insertMulti(QStringLiteral("switch"), Device(QStringLiteral("switch1"), QStringLiteral("default"), QStringLiteral("0")));
+    network.insertMulti(QStringLiteral("switch"), Device(QStringLiteral("switch2"), QStringLiteral("default"), QStringLiteral("0")));
+    QVariantMap inputs;
+    inputs.insert(QStringLiteral("network"), network);
+
+    QVariantMap pca9685;
+    pca9685.insert(QStringLiteral("i2caddress"), QStringLiteral("0x40"));
+    pca9685.insertMulti(QStringLiteral("channel"), Device(QStringLiteral("channel0"), QStringLiteral("number"), QStringLiteral("0")));
+    pca9685.insertMulti(QStringLiteral("channel"), Device(QStringLiteral("channel1"), QStringLiteral("number"), QStringLiteral("1")));
+    QVariantMap i2c;
+    i2c.insert(QStringLiteral("pca9685"), pca9685);
+    QVariantMap outputs;
+    outputs.insert(QStringLiteral("i2c"), i2c);
+
+    QVariantMap logic;
+    logic.insertMulti(QStringLiteral("passthrough"), Control(QStringLiteral("control1"), QStringLiteral("switch1"), QStringLiteral("control2")));
+    logic.insertMulti(QStringLiteral("invert"),      Control(QStringLiteral("control2"), QStringLiteral("control1"), QStringLiteral("channel0")));
+    QVariantMap controls;
+    controls.insert(QStringLiteral("logic"), logic);
+
+    QVariantMap settings;
+    settings.insert(QStringLiteral("temperatureunits"), QStringLiteral("metric"));
+
+    QVariantMap config;
+    config.insert(QStringLiteral("settings"), settings);
+    config.insert(QStringLiteral("inputs"),   inputs);
+    config.insert(QStringLiteral("outputs"),  outputs);
+    config.insert(QStringLiteral("controls"), controls);
+    return config;
+}
+
+void TestTorcConfigDiff::testCompare(void)
+{
+    QVariantMap old = Config();
+    QStringList removed;
+    QStringList added;
+    QStringList changed;
+    QVERIFY(TorcConfigDiff::Compare(old, Config(), removed, added, changed));
+    QVERIFY(removed.isEmpty() && added.isEmpty() && changed.isEmpty());
+    QCOMPARE(TorcConfigDiff::GetUniqueIds(old).size(), 6);
+
+    // change switch2, remove switch1 and add switch3
+    QVariantMap network;
+    network.insertMulti(QStringLiteral("switch"), Device(QStringLiteral("switch2"), QStringLiteral("default"), QStringLiteral("1")));
+    network.insertMulti(QStringLiteral("switch"), Device(QStringLiteral("switch3")));
+    QVariantMap inputs;
+    inputs.insert(QStringLiteral("network"), network);
+    QVariantMap config = Config();
+    config.insert(QStringLiteral("inputs"), inputs);
+
+    QVERIFY(TorcConfigDiff::Compare(old, config, removed, added, changed));
+    QCOMPARE(removed, QStringList() << QStringLiteral("switch1"));
+    QCOMPARE(added,   QStringList() << QStringLiteral("switch3"));
+    QCOMPARE(changed, QStringList() << QStringLiteral("switch2"));
+
+    // moving a device is a change
+    QVariantMap constant;
+    constant.insert(QStringLiteral("switch"), Device(QStringLiteral("switch2"), QStringLiteral("default"), QStringLiteral("1")));
+    inputs.insert(QStringLiteral("constant"), constant);
+    inputs.insert(QStringLiteral("network"), QVariantMap());
+    config.insert(QStringLiteral("inputs"), inputs);
+    QVERIFY(TorcConfigDiff::Compare(old, config, removed, added, changed));
+    QVERIFY(changed.contains(QStringLiteral("switch2")));
+
+    // settings and I2C addresses cannot be changed per device
+    config = Config();
+    QVariantMap settings;
+    settings.insert(QStringLiteral("temperatureunits"), QStringLiteral("imperial"));
+    config.insert(QStringLiteral("settings"), settings);
+    QVERIFY(!TorcConfigDiff::Compare(old, config, removed, added, changed));
+
+    config = Config();
+    QVariantMap outputs = config.value(QStringLiteral("outputs")).toMap();
+    QVariantMap i2c     = outputs.value(QStringLiteral("i2c")).toMap();
+    QVariantMap pca9685 = i2c.value(QStringLiteral("pca9685")).toMap();
+    pca9685.insert(QStringLiteral("i2caddress"), QStringLiteral("0x41"));
+    i2c.insert(QStringLiteral("pca9685"), pca9685);
+    outputs.insert(QStringLiteral("i2c"), i2c);
+    config.insert(QStringLiteral("outputs"), outputs);
+    QVERIFY(!TorcConfigDiff::Compare(old, config, removed, added, changed));
+}
+
+void TestTorcConfigDiff::testDependents(void)
+{
+    // control1 uses switch1 and control2 uses control1
+    QStringList uniqueids(QStringLiteral("switch1"));
+    TorcConfigDiff::Dependents(Config(), uniqueids);
+    uniqueids.sort();
+    QCOMPARE(uniqueids, QStringList() << QStringLiteral("control1") << QStringLiteral("control2") << QStringLiteral("switch1"));
+
+    // control2 drives channel0
+    uniqueids = QStringList(QStringLiteral("channel0"));
+    TorcConfigDiff::Dependents(Config(), uniqueids);
+    QVERIFY(uniqueids.contains(QStringLiteral("control2")));
+    QVERIFY(uniqueids.contains(QStringLiteral("control1")));
+
+    // nothing uses switch2 or channel1
+    uniqueids = QStringList() << QStringLiteral("switch2") << QStringLiteral("channel1");
+    TorcConfigDiff::Dependents(Config(), uniqueids);
+    QCOMPARE(uniqueids.size(), 2);
+}
+
+/*! \brief Follow a reload that changes an input used only within an expression's formula.
+ *
+ * As for TorcCentral::ReloadConfig, the expression must be retired with the input and recreated.
+*/
+void TestTorcConfigDiff::testReloadExpression(void)
+{
+    QVariantMap old = Config();
+    QVariantMap expression = Device(QStringLiteral("expression1"), QStringLiteral("formula"), QStringLiteral("switch2 and not {switch-3}"));
+    QVariantMap outputs;
+    outputs.insert(QStringLiteral("device"), QStringLiteral("channel1"));
+    expression.insert(QStringLiteral("outputs"), outputs);
+    QVariantMap controls = old.value(QStringLiteral("controls")).toMap();
+    QVariantMap logic = controls.value(QStringLiteral("logic")).toMap();
+    logic.insertMulti(QStringLiteral("expression"), expression);
+    controls.insert(QStringLiteral("logic"), logic);
+    old.insert(QStringLiteral("controls"), controls);
+
+    QVariantMap inputs = old.value(QStringLiteral("inputs")).toMap();
+    QVariantMap network = inputs.value(QStringLiteral("network")).toMap();
+    network.insertMulti(QStringLiteral("switch"), Device(QStringLiteral("switch-3"), QStringLiteral("default"), QStringLiteral("0")));
+    inputs.insert(QStringLiteral("network"), network);
+    old.insert(QStringLiteral("inputs"), inputs);
+
+    // change switch2's default
+    QVariantMap current = old;
+    network.clear();
+    network.insertMulti(QStringLiteral("switch"), Device(QStringLiteral("switch1"), QStringLiteral("default"), QStringLiteral("0")));
+    network.insertMulti(QStringLiteral("switch"), Device(QStringLiteral("switch2"), QStringLiteral("default"), QStringLiteral("1")));
+    network.insertMulti(QStringLiteral("switch"), Device(QStringLiteral("switch-3"), QStringLiteral("default"), QStringLiteral("0")));
+    inputs.insert(QStringLiteral("network"), network);
+    current.insert(QStringLiteral("inputs"), inputs);
+
+    QStringList removed;
+    QStringList added;
+    QStringList changed;
+    QVERIFY(TorcConfigDiff::Compare(old, current, removed, added, changed));
+    QVERIFY(removed.isEmpty());
+    QVERIFY(added.isEmpty());
+    QCOMPARE(changed, QStringList(QStringLiteral("switch2")));
+
+    QStringList retire = changed;
+    TorcConfigDiff::Dependents(old, retire);
+    retire.sort();
+    QCOMPARE(retire, QStringList() << QStringLiteral("expression1") << QStringLiteral("switch2"));
+
+    QStringList create = TorcConfigDiff::GetUniqueIds(TorcConfigDiff::Prune(current, retire));
+    create.sort();
+    QCOMPARE(create, retire);
+
+    // names in braces are references too
+    retire = QStringList(QStringLiteral("switch-3"));
+    TorcConfigDiff::Dependents(old, retire);
+    QVERIFY(retire.contains(QStringLiteral("expression1")));
+
+    // the expression is also rebuilt with its output, which does not pull in its inputs
+    retire = QStringList(QStringLiteral("channel1"));
+    TorcConfigDiff::Dependents(old, retire);
+    QVERIFY(retire.contains(QStringLiteral("expression1")));
+    QVERIFY(!retire.contains(QStringLiteral("switch2")));
+}
+
+void TestTorcConfigDiff::testPrune(void)
+{
+    QVariantMap pruned = TorcConfigDiff::Prune(Config(), QStringList() << QStringLiteral("channel1") << QStringLiteral("switch2"));
+    QStringList uniqueids = TorcConfigDiff::GetUniqueIds(pruned);
+    uniqueids.sort();
+    QCOMPARE(uniqueids, QStringList() << QStringLiteral("channel1") << QStringLiteral("switch2"));
+
+    // enclosing configuration is retained, unrelated configuration is not
+    QVariantMap pca9685 = pruned.value(QStringLiteral("outputs")).toMap().value(QStringLiteral("i2c")).toMap()
+                                .value(QStringLiteral("pca9685")).toMap();
+    QCOMPARE(pca9685.value(QStringLiteral("i2caddress")).toString(), QStringLiteral("0x40"));
+    QVERIFY(!pruned.contains(QStringLiteral("controls")));
+    QVERIFY(!pruned.contains(QStringLiteral("settings")));
+
+    QVERIFY(TorcConfigDiff::Prune(Config(), QStringList()).isEmpty());
+}
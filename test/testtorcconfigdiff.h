@@ -0,0 +1,17 @@
+#ifndef TESTTORCCONFIGDIFF_H
+#define TESTTORCCONFIGDIFF_H
+
+#include <QObject>
+
+class TestTorcConfigDiff : public QObject
+{
+    Q_OBJECT
+
+  private slots:
+    void testCompare(void);
+    void testDependents(void);
+    void testReloadExpression(void);
+    void testPrune(void);
+};
+
+#endif // TESTTORCCONFIGDIFF_H
@@ -0,0 +1,72 @@
+// Qt
+#include <QtTest/QtTest>
+#include <QTemporaryDir>
+
+// Torc
+#include "torcconfigloader.h"
+#include "testtorcconfigloader.h"
+
+void TestTorcConfigLoader::testKey(void)
+{
+    QByteArray xml("<torc><settings/></torc>");
+    QByteArray xsd("<xs:schema/>");
+    QByteArray key = TorcConfigLoader::GetKey(xml, xsd, true);
+
+    QCOMPARE(TorcConfigLoader::GetKey(xml, xsd, true), key);
+    QVERIFY(TorcConfigLoader::GetKey(xml + " ", xsd, true) != key);
+    QVERIFY(TorcConfigLoader::GetKey(xml, xsd + " ", true) != key);
+    QVERIFY(TorcConfigLoader::GetKey(xml, xsd, false) != key);
+
+    // moving bytes between the xsd and the configuration must change the key
+    QVERIFY(TorcConfigLoader::GetKey(QByteArray("ab"), QByteArray("c"), true) !=
+            TorcConfigLoader::GetKey(QByteArray("b"),  QByteArray("ca"), true));
+}
+
+void TestTorcConfigLoader::testCache(void)
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    QString cache = dir.path() + "/torc.cache";
+
+    QVariantMap device;
+    device.insert(QStringLiteral("name"), QStringLiteral("switch1"));
+    device.insert(QStringLiteral("default"), QStringLiteral("1"));
+    QVariantMap network;
+    network.insertMulti(QStringLiteral("switch"), device);
+    device.insert(QStringLiteral("name"), QStringLiteral("switch2"));
+    network.insertMulti(QStringLiteral("switch"), device);
+    QVariantMap inputs;
+    inputs.insert(QStringLiteral("network"), network);
+    QVariantMap config;
+    config.insert(QStringLiteral("inputs"), inputs);
+
+    QByteArray key = TorcConfigLoader::GetKey(QByteArray("xml"), QByteArray("xsd"), true);
+    QVariantMap result;
+    QVERIFY(!TorcConfigLoader::ReadCache(cache, key, result));
+    QVERIFY(TorcConfigLoader::WriteCache(cache, key, config));
+
+    // round trip, including repeated elements
+    QVERIFY(TorcConfigLoader::ReadCache(cache, key, result));
+    QCOMPARE(result, config);
+    QCOMPARE(result.value(QStringLiteral("inputs")).toMap().value(QStringLiteral("network")).toMap()
+                   .values(QStringLiteral("switch")).size(), 2);
+
+    // stale cache
+    result.clear();
+    QVERIFY(!TorcConfigLoader::ReadCache(cache, TorcConfigLoader::GetKey(QByteArray("xml2"), QByteArray("xsd"), true), result));
+    QVERIFY(result.isEmpty());
+
+    // truncated cache
+    QFile file(cache);
+    QVERIFY(file.open(QIODevice::ReadWrite));
+    QVERIFY(file.resize(file.size() / 2));
+    file.close();
+    QVERIFY(!TorcConfigLoader::ReadCache(cache, key, result));
+
+    // garbage
+    QVERIFY(file.open(QIODevice::WriteOnly | QIODevice::Truncate));
+    file.write("not a configuration cache");
+    file.close();
+    QVERIFY(!TorcConfigLoader::ReadCache(cache, key, result));
+    QVERIFY(result.isEmpty());
+}
@@ -0,0 +1,15 @@
+#ifndef TESTTORCCONFIGLOADER_H
+#define TESTTORCCONFIGLOADER_H
+
+#include <QObject>
+
+class TestTorcConfigLoader : public QObject
+{
+    Q_OBJECT
+
+  private slots:
+    void testKey(void);
+    void testCache(void);
+};
+
+#endif // TESTTORCCONFIGLOADER_H
@@ -0,0 +1,101 @@
+// Qt
+#include <QtTest/QtTest>
+
+// Torc
+#include "torcexpression.h"
+#include "testtorcexpression.h"
+
+// inputs are bound in the order a, b, c, {d-e}
+static const double gValues[] = { 2.0, 3.0, 0.0, 10.0 };
+
+static bool Compile(TorcExpression &Expression, const QString &Formula)
+{
+    if (!Expression.Parse(Formula))
+        return false;
+
+    QStringList known = QStringList() << QStringLiteral("a") << QStringLiteral("b") << QStringLiteral("c") << QStringLiteral("d-e");
+    QVector<int> indices;
+    foreach (const QString &name, Expression.GetNames())
+        indices.append(known.indexOf(name));
+    return Expression.Bind(indices);
+}
+
+void TestTorcExpression::testEvaluate_data(void)
+{
+    QTest::addColumn<QString>("formula");
+    QTest::addColumn<double>("result");
+
+    QTest::newRow("input")      << QStringLiteral("a")                      << 2.0;
+    QTest::newRow("precedence") << QStringLiteral("a + b * 2")              << 8.0;
+    QTest::newRow("brackets")   << QStringLiteral("(a + b) * 2")            << 10.0;
+    QTest::newRow("subtract")   << QStringLiteral("b - a - 1")              << 0.0;
+    QTest::newRow("negate")     << QStringLiteral("-a + b")                 << 1.0;
+    QTest::newRow("braces")     << QStringLiteral("{d-e} / a")              << 5.0;
+    QTest::newRow("less")       << QStringLiteral("a < b - 0.5")            << 1.0;
+    QTest::newRow("lt")         << QStringLiteral("a lt b - 1")             << 0.0;
+    QTest::newRow("equal")      << QStringLiteral("a + 1 == b")             << 1.0;
+    QTest::newRow("notequal")   << QStringLiteral("a != 2")                 << 0.0;
+    QTest::newRow("and")        << QStringLiteral("a < b and not c")        << 1.0;
+    QTest::newRow("or")         << QStringLiteral("c || a > b")             << 0.0;
+    QTest::newRow("not")        << QStringLiteral("!c && !!a")              << 1.0;
+    QTest::newRow("functions")  << QStringLiteral("max(a, min(b, 2.5)) + abs(-a)") << 4.5;
+    QTest::newRow("repeated")   << QStringLiteral("a * a + a")              << 6.0;
+    QTest::newRow("keywords")   << QStringLiteral("a ge 2 AND b le 3 or false") << 1.0;
+}
+
+void TestTorcExpression::testEvaluate(void)
+{
+    QFETCH(QString, formula);
+    QFETCH(double, result);
+
+    TorcExpression expression;
+    QVERIFY2(Compile(expression, formula), qPrintable(expression.GetError()));
+    // NB offset by 1.0 as several results are zero
+    QCOMPARE(expression.Evaluate(gValues) + 1.0, result + 1.0);
+}
+
+void TestTorcExpression::testConstantFolding(void)
+{
+    TorcExpression expression;
+    QVERIFY(Compile(expression, QStringLiteral("a < (20 - 0.5) * 2")));
+    QCOMPARE(expression.Size(), 3);
+    QCOMPARE(expression.GetNames(), QStringList() << QStringLiteral("a"));
+    QCOMPARE(expression.Evaluate(gValues), 1.0);
+
+    QVERIFY(Compile(expression, QStringLiteral("b and not false")));
+    QCOMPARE(expression.Size(), 3);
+    QCOMPARE(expression.Evaluate(gValues), 1.0);
+}
+
+void TestTorcExpression::testErrors(void)
+{
+    TorcExpression expression;
+    QVERIFY(!expression.Parse(QStringLiteral("")));
+    QVERIFY(!expression.Parse(QStringLiteral("a +")));
+    QVERIFY(!expression.Parse(QStringLiteral("(a + b")));
+    QVERIFY(!expression.Parse(QStringLiteral("a b")));
+    QVERIFY(!expression.Parse(QStringLiteral("foo(a)")));
+    QVERIFY(!expression.Parse(QStringLiteral("min(a)")));
+    QVERIFY(!expression.Parse(QStringLiteral("{a")));
+    QVERIFY(!expression.GetError().isEmpty());
+
+    // unbound expressions cannot be evaluated
+    QVERIFY(expression.Parse(QStringLiteral("a + b")));
+    QVERIFY(!expression.Bind(QVector<int>() << 0));
+    QVERIFY(qFuzzyIsNull(expression.Evaluate(gValues)));
+}
+
+/// The formula from a typical 'heater' chain (LessThan, Invert, All) evaluated as a single node.
+void TestTorcExpression::benchmarkEvaluate(void)
+{
+    TorcExpression expression;
+    QVERIFY(Compile(expression, QStringLiteral("a < b - 0.5 and {d-e} > 5 and not c")));
+
+    double total = 0.0;
+    QBENCHMARK
+    {
+        for (int i = 0; i < 1000; ++i)
+            total += expression.Evaluate(gValues);
+    }
+    QVERIFY(total > 0.0);
+}
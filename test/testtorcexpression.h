@@ -0,0 +1,18 @@
+#ifndef TESTTORCEXPRESSION_H
+#define TESTTORCEXPRESSION_H
+
+#include <QObject>
+
+class TestTorcExpression : public QObject
+{
+    Q_OBJECT
+
+  private slots:
+    void testEvaluate_data(void);
+    void testEvaluate(void);
+    void testConstantFolding(void);
+    void testErrors(void);
+    void benchmarkEvaluate(void);
+};
+
+#endif // TESTTORCEXPRESSION_H
@@ -0,0 +1,182 @@
+// Qt
+#include <QtTest/QtTest>
+
+// Torc
+#include "torcgpioevents.h"
+#include "testtorcgpioevents.h"
+
+// Linux
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+
+// std
+#include <algorithm>
+
+#define STRESS_INPUTS 64
+
+// A GPIO line backed by a pipe - each byte written is a new value
+class TestGPIOLine final : public TorcGPIOLine
+{
+  public:
+    TestGPIOLine()
+      : TorcGPIOLine(),
+        m_pipe(),
+        m_value(0)
+    {
+        if (pipe2(m_pipe, O_NONBLOCK | O_CLOEXEC) < 0)
+            m_pipe[0] = m_pipe[1] = -1;
+    }
+
+   ~TestGPIOLine()
+    {
+        close(m_pipe[0]);
+        close(m_pipe[1]);
+    }
+
+    int     GetHandle (void) const override { return m_pipe[0]; }
+    quint32 GetEvents (void) const override { return EPOLLIN; }
+
+    int Read(void) override
+    {
+        char buffer[64];
+        ssize_t size = 0;
+        while ((size = read(m_pipe[0], buffer, sizeof(buffer))) > 0)
+            m_value = buffer[size - 1] == '1' ? 1 : 0;
+        return m_value;
+    }
+
+    void Set(int Value)
+    {
+        (void)write(m_pipe[1], Value ? "1" : "0", 1);
+    }
+
+  private:
+    int m_pipe[2];
+    int m_value;
+};
+
+class TestGPIOListener final : public TorcGPIOListener
+{
+  public:
+    TestGPIOListener() : TorcGPIOListener(), m_values() { }
+    void GPIOValueChanged(int Value) override { m_values.append(Value); }
+    QList<int> m_values;
+};
+
+void TestTorcGPIOEvents::testEvents(void)
+{
+    TorcGPIOEvents events;
+    TestGPIOLine line;
+    TestGPIOListener listener;
+
+    QVERIFY(line.GetHandle() > -1);
+    QVERIFY(events.AddLine(&line, &listener, 0));
+    QVERIFY(!events.AddLine(&line, &listener, 0));
+
+    // initial value
+    QTRY_COMPARE(listener.m_values, QList<int>() << 0);
+
+    line.Set(1);
+    QTRY_COMPARE(listener.m_values, QList<int>() << 0 << 1);
+    line.Set(0);
+    QTRY_COMPARE(listener.m_values, QList<int>() << 0 << 1 << 0);
+
+    // no change, no event
+    line.Set(0);
+    QTest::qWait(50);
+    QCOMPARE(listener.m_values.size(), 3);
+
+    events.RemoveLine(&line);
+    QVERIFY(!events.isRunning());
+    line.Set(1);
+    QTest::qWait(50);
+    QCOMPARE(listener.m_values.size(), 3);
+}
+
+void TestTorcGPIOEvents::testDebounce(void)
+{
+    TorcGPIOEvents events;
+    TestGPIOLine line;
+    TestGPIOListener listener;
+    QVERIFY(events.AddLine(&line, &listener, 100));
+    QTRY_COMPARE(listener.m_values.size(), 1);
+
+    // the first edge after a quiet period is reported immediately...
+    QTest::qWait(120);
+    line.Set(1);
+    QTRY_COMPARE_WITH_TIMEOUT(listener.m_values.size(), 2, 80);
+
+    // ...bounces are absorbed and the settled value is reported when the period expires
+    line.Set(0);
+    line.Set(1);
+    line.Set(0);
+    QTest::qWait(50);
+    QCOMPARE(listener.m_values.size(), 2);
+    QTRY_COMPARE(listener.m_values, QList<int>() << 0 << 1 << 0);
+
+    // a bounce that returns to the reported value is not reported at all
+    QTest::qWait(120);
+    line.Set(1);
+    line.Set(0);
+    QTest::qWait(250);
+    QVERIFY(listener.m_values.size() <= 5);
+    QCOMPARE(listener.m_values.last(), 0);
+
+    events.RemoveLine(&line);
+}
+
+void TestTorcGPIOEvents::testStress(void)
+{
+    TorcGPIOEvents events;
+    QVector<TestGPIOLine*> lines;
+    QVector<TestGPIOListener*> listeners;
+    for (int i = 0; i < STRESS_INPUTS; ++i)
+    {
+        lines.append(new TestGPIOLine());
+        listeners.append(new TestGPIOListener());
+        QVERIFY(events.AddLine(lines.last(), listeners.last(), 20));
+    }
+
+    QTRY_VERIFY(std::all_of(listeners.constBegin(), listeners.constEnd(), [](TestGPIOListener *Listener) { return Listener->m_values.size() == 1; }));
+    QTest::qWait(30);
+
+    // toggle every input, with bounces, many times
+    static const int cycles = 20;
+    for (int cycle = 0; cycle < cycles; ++cycle)
+    {
+        int value = (cycle + 1) & 1;
+        for (int i = 0; i < STRESS_INPUTS; ++i)
+        {
+            lines[i]->Set(value);
+            lines[i]->Set(!value);
+            lines[i]->Set(value);
+        }
+        QTest::qWait(40);
+    }
+
+    // every input ends in the right state, without having reported every bounce
+    int expected = cycles & 1;
+    QTRY_VERIFY(std::all_of(listeners.constBegin(), listeners.constEnd(), [expected](TestGPIOListener *Listener) { return Listener->m_values.last() == expected; }));
+    foreach (TestGPIOListener *listener, listeners)
+    {
+        QVERIFY(listener->m_values.size() <= 1 + cycles * 2);
+        for (int i = 1; i < listener->m_values.size(); ++i)
+            QVERIFY(listener->m_values.at(i) != listener->m_values.at(i - 1));
+    }
+
+    // changes are delivered in batches rather than one at a time
+    quint64 changes = 0;
+    foreach (TestGPIOListener *listener, listeners)
+        changes += listener->m_values.size();
+    QVERIFY(events.GetBatchCount() < changes / 4);
+    QVERIFY(events.GetEventCount() >= (quint64)STRESS_INPUTS * cycles);
+
+    for (int i = 0; i < STRESS_INPUTS; ++i)
+    {
+        events.RemoveLine(lines[i]);
+        delete lines[i];
+        delete listeners[i];
+    }
+    QVERIFY(!events.isRunning());
+}
@@ -0,0 +1,16 @@
+#ifndef TESTTORCGPIOEVENTS_H
+#define TESTTORCGPIOEVENTS_H
+
+#include <QObject>
+
+class TestTorcGPIOEvents : public QObject
+{
+    Q_OBJECT
+
+  private slots:
+    void testEvents(void);
+    void testDebounce(void);
+    void testStress(void);
+};
+
+#endif // TESTTORCGPIOEVENTS_H
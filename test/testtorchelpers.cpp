@@ -0,0 +1,69 @@
+// Qt
+#include <QFile>
+
+// Torc
+#include "testtorchelpers.h"
+
+bool TestTorcHelpers::WriteFile(const QString &Name, const QByteArray &Data)
+{
+    QFile file(Name);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+        return false;
+    bool result = file.write(Data) == Data.size();
+    file.close();
+    return result;
+}
+
+/// Return the contents of Name without surrounding whitespace, or an empty array if it cannot be read.
+QByteArray TestTorcHelpers::ReadFile(const QString &Name)
+{
+    QFile file(Name);
+    if (!file.open(QIODevice::ReadOnly))
+        return QByteArray();
+    return file.readAll().trimmed();
+}
+
+TestTorcBlocker::TestTorcBlocker()
+  : m_blockLock(),
+    m_blockWait(),
+    m_hold(false),
+    m_blocked(false)
+{
+}
+
+/// Stall the next call to Block until Release is called.
+void TestTorcBlocker::Hold(void)
+{
+    QMutexLocker locker(&m_blockLock);
+    m_hold = true;
+}
+
+/// Wait (for up to 5 seconds) until the backend is stalled in Block.
+bool TestTorcBlocker::WaitUntilBlocked(void)
+{
+    QMutexLocker locker(&m_blockLock);
+    while (!m_blocked)
+        if (!m_blockWait.wait(&m_blockLock, 5000))
+            return false;
+    return true;
+}
+
+void TestTorcBlocker::Release(void)
+{
+    QMutexLocker locker(&m_blockLock);
+    m_hold = false;
+    m_blockWait.wakeAll();
+}
+
+/// Called by the backend from within a write - returns immediately unless held.
+void TestTorcBlocker::Block(void)
+{
+    QMutexLocker locker(&m_blockLock);
+    while (m_hold)
+    {
+        m_blocked = true;
+        m_blockWait.wakeAll();
+        m_blockWait.wait(&m_blockLock);
+    }
+    m_blocked = false;
+}
@@ -0,0 +1,39 @@
+#ifndef TESTTORCHELPERS_H
+#define TESTTORCHELPERS_H
+
+// Qt
+#include <QMutex>
+#include <QString>
+#include <QByteArray>
+#include <QWaitCondition>
+
+namespace TestTorcHelpers
+{
+    // create fake kernel (sysfs etc) files and read back what was written to them
+    bool       WriteFile (const QString &Name, const QByteArray &Data);
+    QByteArray ReadFile  (const QString &Name);
+}
+
+// stall a backend (bus transport, output target etc) mid-write, so that further updates are queued together
+class TestTorcBlocker
+{
+  public:
+    TestTorcBlocker();
+    virtual ~TestTorcBlocker() = default;
+
+    void Hold             (void);
+    bool WaitUntilBlocked (void);
+    void Release          (void);
+
+  protected:
+    void Block            (void);
+
+  private:
+    Q_DISABLE_COPY(TestTorcBlocker)
+    QMutex         m_blockLock;
+    QWaitCondition m_blockWait;
+    bool           m_hold;
+    bool           m_blocked;
+};
+
+#endif // TESTTORCHELPERS_H
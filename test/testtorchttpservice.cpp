@@ -0,0 +1,257 @@
+// Qt
+#include <QtTest/QtTest>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QElapsedTimer>
+
+// Torc
+#include "torchttpreader.h"
+#include "torchttprequest.h"
+#include "testtorchttpservice.h"
+
+TestDecoderService::TestDecoderService()
+  : QObject(),
+    TorcHTTPService(this, QStringLiteral("test/decoders"), QStringLiteral("testdecoders"), TestDecoderService::staticMetaObject)
+{
+}
+
+void TestDecoderService::SubscriberDeleted(QObject *Subscriber)
+{
+    TorcHTTPService::HandleSubscriberDeleted(Subscriber);
+}
+
+int TestDecoderService::GetInt(int Value)
+{
+    return Value;
+}
+
+short TestDecoderService::GetShort(short Value)
+{
+    return Value;
+}
+
+double TestDecoderService::GetDouble(double Value)
+{
+    return Value;
+}
+
+bool TestDecoderService::GetBool(bool Value)
+{
+    return Value;
+}
+
+QString TestDecoderService::GetString(const QString &Value)
+{
+    return Value;
+}
+
+QString TestDecoderService::GetTime(const QTime &Value)
+{
+    return Value.toString(Qt::ISODate);
+}
+
+QString TestDecoderService::GetDate(const QDate &Value)
+{
+    return Value.toString(Qt::ISODate);
+}
+
+QString TestDecoderService::GetDateTime(const QDateTime &Value)
+{
+    return Value.toString(Qt::ISODate);
+}
+
+int TestDecoderService::GetSum(int First, int Second)
+{
+    return First + Second;
+}
+
+/// A request that can be created (and destroyed) outside of TorcWebSocket.
+class TestHTTPRequest final : public TorcHTTPRequest
+{
+  public:
+    explicit TestHTTPRequest(TorcHTTPReader *Reader)
+      : TorcHTTPRequest(Reader)
+    {
+    }
+};
+
+/// Send a GET request for Path over a local socket and read it back as the server would.
+static bool ReadRequest(const QByteArray &Path, TorcHTTPReader &Reader)
+{
+    QTcpServer server;
+    QTcpSocket client;
+    server.listen(QHostAddress::LocalHost);
+    client.connectToHost(QHostAddress::LocalHost, server.serverPort());
+    client.waitForConnected(1000);
+    server.waitForNewConnection(1000);
+    QTcpSocket *socket = server.nextPendingConnection();
+    if (!socket)
+        return false;
+
+    client.write("GET " + Path + " HTTP/1.1\r\nHost: localhost\r\nAccept: application/json\r\n\r\n");
+    client.waitForBytesWritten(1000);
+
+    QElapsedTimer timer;
+    timer.start();
+    while (!Reader.IsReady() && timer.elapsed() < 5000)
+    {
+        if (socket->bytesAvailable() < 1)
+            socket->waitForReadyRead(100);
+        if (!Reader.Read(socket))
+            return false;
+    }
+    return Reader.IsReady();
+}
+
+/// Make an HTTP request to the test service and return the status (and optionally the serialised response).
+static HTTPStatus CallHTTP(TestDecoderService &Service, const QByteArray &Method, QByteArray *Content = nullptr)
+{
+    TorcHTTPReader reader;
+    if (!ReadRequest("/services/test/decoders/" + Method, reader))
+        return HTTP_NotFound;
+    TestHTTPRequest request(&reader);
+    Service.ProcessHTTPRequest(QString(), 0, QString(), 0, request);
+    if (Content)
+        *Content = request.GetResponseContent();
+    return request.GetHTTPStatus();
+}
+
+/// Make an RPC call to the test service, returning true and the result if the call succeeded.
+static bool CallRPC(TestDecoderService &Service, const QString &Method, const QVariant &Parameters, QVariant &Result)
+{
+    QObject connection;
+    QVariantMap reply = Service.ProcessRequest(QStringLiteral("/services/test/decoders/") + Method, Parameters, &connection, true);
+    Result = reply.value(QStringLiteral("result"));
+    return reply.contains(QStringLiteral("result")) && !reply.contains(QStringLiteral("error"));
+}
+
+static QVariantMap Value(const QVariant &Value)
+{
+    QVariantMap result;
+    result.insert(QStringLiteral("Value"), Value);
+    return result;
+}
+
+static int ErrorCode(TestDecoderService &Service, const QString &Method, const QVariant &Parameters)
+{
+    QObject connection;
+    QVariantMap reply = Service.ProcessRequest(QStringLiteral("/services/test/decoders/") + Method, Parameters, &connection, true);
+    return reply.value(QStringLiteral("error")).toMap().value(QStringLiteral("code")).toInt();
+}
+
+void TestTorcHTTPService::testDecodeValid(void)
+{
+    TestDecoderService service;
+    QVariant result;
+
+    // values arrive from JSON-RPC as numbers, booleans and strings
+    QVERIFY(CallRPC(service, QStringLiteral("GetInt"), Value(12), result));
+    QCOMPARE(result.toInt(), 12);
+    QVERIFY(CallRPC(service, QStringLiteral("GetInt"), Value(QStringLiteral("-12")), result));
+    QCOMPARE(result.toInt(), -12);
+    QVERIFY(CallRPC(service, QStringLiteral("GetShort"), Value(-32768), result));
+    QCOMPARE(result.toInt(), -32768);
+    QVERIFY(CallRPC(service, QStringLiteral("GetDouble"), Value(1.5), result));
+    QCOMPARE(result.toDouble(), 1.5);
+    QVERIFY(CallRPC(service, QStringLiteral("GetDouble"), Value(QStringLiteral("2.25")), result));
+    QCOMPARE(result.toDouble(), 2.25);
+    QVERIFY(CallRPC(service, QStringLiteral("GetBool"), Value(true), result));
+    QCOMPARE(result.toBool(), true);
+    QVERIFY(CallRPC(service, QStringLiteral("GetBool"), Value(QStringLiteral("yes")), result));
+    QCOMPARE(result.toBool(), true);
+    QVERIFY(CallRPC(service, QStringLiteral("GetBool"), Value(QStringLiteral("no")), result));
+    QCOMPARE(result.toBool(), false);
+    QVERIFY(CallRPC(service, QStringLiteral("GetString"), Value(5), result));
+    QCOMPARE(result.toString(), QStringLiteral("5"));
+    QVERIFY(CallRPC(service, QStringLiteral("GetTime"), Value(QStringLiteral("12:34:56")), result));
+    QCOMPARE(result.toString(), QStringLiteral("12:34:56"));
+    QVERIFY(CallRPC(service, QStringLiteral("GetDate"), Value(QStringLiteral("2018-06-01")), result));
+    QCOMPARE(result.toString(), QStringLiteral("2018-06-01"));
+    QVERIFY(CallRPC(service, QStringLiteral("GetDateTime"), Value(QStringLiteral("2018-06-01T12:00:00Z")), result));
+    QCOMPARE(result.toString(), QStringLiteral("2018-06-01T12:00:00Z"));
+
+    // named and positional parameters
+    QVariantMap named;
+    named.insert(QStringLiteral("Second"), 2);
+    named.insert(QStringLiteral("First"), 40);
+    QVERIFY(CallRPC(service, QStringLiteral("GetSum"), named, result));
+    QCOMPARE(result.toInt(), 42);
+    QVERIFY(CallRPC(service, QStringLiteral("GetSum"), QVariantList() << 1 << 2, result));
+    QCOMPARE(result.toInt(), 3);
+
+    // and as HTTP query strings, with the result streamed into the response
+    QByteArray content;
+    QVERIFY(CallHTTP(service, "GetInt?Value=12", &content) == HTTP_OK);
+    QCOMPARE(content, QByteArray("12"));
+    QVERIFY(CallHTTP(service, "GetString?Value=abc", &content) == HTTP_OK);
+    QCOMPARE(content, QByteArray("\"abc\""));
+    QVERIFY(CallHTTP(service, "GetServiceVersion", &content) == HTTP_OK);
+    QCOMPARE(content, QByteArray("{\"version\":\"1.0.0\"}"));
+    QVERIFY(CallHTTP(service, "GetDouble?Value=-0.5") == HTTP_OK);
+    QVERIFY(CallHTTP(service, "GetTime?Value=12:34") == HTTP_OK);
+    QVERIFY(CallHTTP(service, "GetSum?First=1&Second=2") == HTTP_OK);
+}
+
+void TestTorcHTTPService::testDecodeTruncated(void)
+{
+    TestDecoderService service;
+    QVariant result;
+
+    // missing parameters
+    QVariantMap first;
+    first.insert(QStringLiteral("First"), 1);
+    QVERIFY(!CallRPC(service, QStringLiteral("GetSum"), first, result));
+    QVERIFY(!CallRPC(service, QStringLiteral("GetSum"), QVariantList() << 1, result));
+    QVERIFY(!CallRPC(service, QStringLiteral("GetSum"), QVariant(), result));
+    QVERIFY(CallHTTP(service, "GetSum?First=1") == HTTP_BadRequest);
+
+    // incomplete values
+    QVERIFY(!CallRPC(service, QStringLiteral("GetInt"), Value(QStringLiteral("-")), result));
+    QVERIFY(!CallRPC(service, QStringLiteral("GetDouble"), Value(QStringLiteral("1e")), result));
+    QVERIFY(!CallRPC(service, QStringLiteral("GetTime"), Value(QStringLiteral("12:")), result));
+    QVERIFY(!CallRPC(service, QStringLiteral("GetDate"), Value(QStringLiteral("2018-06")), result));
+    QVERIFY(!CallRPC(service, QStringLiteral("GetDateTime"), Value(QStringLiteral("2018-06-")), result));
+    QCOMPARE(ErrorCode(service, QStringLiteral("GetTime"), Value(QStringLiteral("12:"))), -32602);
+    QVERIFY(CallHTTP(service, "GetInt?Value=") == HTTP_BadRequest);
+    QVERIFY(CallHTTP(service, "GetTime?Value=12:") == HTTP_BadRequest);
+    QVERIFY(CallHTTP(service, "GetDate?Value=2018-0") == HTTP_BadRequest);
+}
+
+void TestTorcHTTPService::testDecodeMalformed(void)
+{
+    TestDecoderService service;
+    QVariant result;
+
+    // not numbers
+    QVERIFY(!CallRPC(service, QStringLiteral("GetInt"), Value(QStringLiteral("twelve")), result));
+    QVERIFY(!CallRPC(service, QStringLiteral("GetInt"), Value(QStringLiteral("12abc")), result));
+    QVERIFY(!CallRPC(service, QStringLiteral("GetDouble"), Value(QStringLiteral("1.2.3")), result));
+    QCOMPARE(ErrorCode(service, QStringLiteral("GetInt"), Value(QStringLiteral("twelve"))), -32602);
+
+    // out of range
+    QVERIFY(!CallRPC(service, QStringLiteral("GetShort"), Value(40000), result));
+
+    // structured values where a simple value is expected
+    QVariantMap map;
+    map.insert(QStringLiteral("nested"), 1);
+    QVERIFY(!CallRPC(service, QStringLiteral("GetInt"), Value(map), result));
+    QVERIFY(!CallRPC(service, QStringLiteral("GetString"), Value(QVariantList() << 1 << 2), result));
+    QVERIFY(!CallRPC(service, QStringLiteral("GetBool"), Value(map), result));
+    QVERIFY(!CallRPC(service, QStringLiteral("GetTime"), Value(map), result));
+
+    // unknown parameter names and unsupported parameter containers
+    QVariantMap wrong;
+    wrong.insert(QStringLiteral("Other"), 1);
+    QVERIFY(!CallRPC(service, QStringLiteral("GetInt"), wrong, result));
+    QVERIFY(!CallRPC(service, QStringLiteral("GetInt"), QVariant(12), result));
+
+    // and over HTTP
+    QVERIFY(CallHTTP(service, "GetInt?Value=12abc") == HTTP_BadRequest);
+    QVERIFY(CallHTTP(service, "GetDouble?Value=1.2.3") == HTTP_BadRequest);
+    QVERIFY(CallHTTP(service, "GetTime?Value=25:61") == HTTP_BadRequest);
+    QVERIFY(CallHTTP(service, "GetInt?Other=12") == HTTP_BadRequest);
+
+    // the service still works afterwards
+    QVERIFY(CallRPC(service, QStringLiteral("GetInt"), Value(7), result));
+    QCOMPARE(result.toInt(), 7);
+}
@@ -0,0 +1,43 @@
+#ifndef TESTTORCHTTPSERVICE_H
+#define TESTTORCHTTPSERVICE_H
+
+#include <QObject>
+#include <QTime>
+#include <QDate>
+#include <QDateTime>
+
+// Torc
+#include "torchttpservice.h"
+
+class TestDecoderService final : public QObject, public TorcHTTPService
+{
+    Q_OBJECT
+    Q_CLASSINFO("Version", "1.0.0")
+
+  public:
+    TestDecoderService();
+
+  public slots:
+    void        SubscriberDeleted (QObject *Subscriber);
+    int         GetInt            (int Value);
+    short       GetShort          (short Value);
+    double      GetDouble         (double Value);
+    bool        GetBool           (bool Value);
+    QString     GetString         (const QString &Value);
+    QString     GetTime           (const QTime &Value);
+    QString     GetDate           (const QDate &Value);
+    QString     GetDateTime       (const QDateTime &Value);
+    int         GetSum            (int First, int Second);
+};
+
+class TestTorcHTTPService : public QObject
+{
+    Q_OBJECT
+
+  private slots:
+    void testDecodeValid(void);
+    void testDecodeTruncated(void);
+    void testDecodeMalformed(void);
+};
+
+#endif // TESTTORCHTTPSERVICE_H
@@ -0,0 +1,214 @@
+// Qt
+#include <QtTest/QtTest>
+#include <QTemporaryDir>
+
+// Torc
+#include "torciiodevice.h"
+#include "testtorchelpers.h"
+#include "testtorciiodevice.h"
+
+// Linux
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+class TestIIOListener final : public TorcIIOListener
+{
+  public:
+    TestIIOListener() : TorcIIOListener(), m_lock(), m_values(), m_invalid(0) { }
+
+    void IIOValueRead(double Value, bool Valid) override
+    {
+        QMutexLocker locker(&m_lock);
+        if (Valid)
+            m_values.append(Value);
+        else
+            m_invalid++;
+    }
+
+    QList<double> Values(void)
+    {
+        QMutexLocker locker(&m_lock);
+        return m_values;
+    }
+
+    QMutex        m_lock;
+    QList<double> m_values;
+    int           m_invalid;
+};
+
+void TestTorcIIODevice::testParseType(void)
+{
+    TorcIIOChannel channel;
+    QVERIFY(!channel.ParseType("garbage"));
+    QVERIFY(!channel.ParseType("le:s12/12>>0")); // storage must be whole bytes
+
+    QVERIFY(channel.ParseType("le:s12/16>>4\n"));
+    QVERIFY(channel.isSigned);
+    QVERIFY(!channel.bigEndian);
+    QCOMPARE(channel.bits, 12);
+    QCOMPARE(channel.storage, 2);
+    QCOMPARE(channel.shift, 4);
+
+    // -100 as 12 bits, shifted left by 4, little endian
+    quint16 value = static_cast<quint16>((-100 & 0xfff) << 4);
+    uchar scan[4] = { 0xff, static_cast<uchar>(value & 0xff), static_cast<uchar>(value >> 8), 0xff };
+    channel.location = 1;
+    QCOMPARE(channel.Decode(scan), -100.0);
+
+    QVERIFY(channel.ParseType("be:u16/16>>0"));
+    QVERIFY(!channel.isSigned);
+    QVERIFY(channel.bigEndian);
+    uchar big[3] = { 0x00, 0x12, 0x34 };
+    QCOMPARE(channel.Decode(big), 4660.0);
+
+    QVERIFY(channel.ParseType("le:s64/64>>0"));
+    uchar timestamp[9] = { 0x00, 0xfe, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff };
+    QCOMPARE(channel.Decode(timestamp), -2.0);
+}
+
+void TestTorcIIODevice::testUnits(void)
+{
+    QCOMPARE(TorcIIODevice::GetUnits(QStringLiteral("in_temp0")), 0.001);
+    QCOMPARE(TorcIIODevice::GetUnits(QStringLiteral("in_voltage3")), 0.001);
+    QCOMPARE(TorcIIODevice::GetUnits(QStringLiteral("temp1")), 0.001);
+    QCOMPARE(TorcIIODevice::GetUnits(QStringLiteral("in0")), 0.001);
+    QCOMPARE(TorcIIODevice::GetUnits(QStringLiteral("power1")), 0.000001);
+    QCOMPARE(TorcIIODevice::GetUnits(QStringLiteral("in_illuminance")), 1.0);
+}
+
+void TestTorcIIODevice::testFindDevice(void)
+{
+    QTemporaryDir root;
+    QVERIFY(root.isValid());
+    QDir dir(root.path());
+    QVERIFY(dir.mkpath(QStringLiteral("iio:device0")));
+    QVERIFY(dir.mkpath(QStringLiteral("iio:device1")));
+    QVERIFY(TestTorcHelpers::WriteFile(root.path() + QStringLiteral("/iio:device0/name"), "ads1015\n"));
+    QVERIFY(TestTorcHelpers::WriteFile(root.path() + QStringLiteral("/iio:device1/name"), "bme280\n"));
+
+    QVERIFY(TorcIIODevice::FindDevice(root.path(), QStringLiteral("bme280")).endsWith(QStringLiteral("/iio:device1")));
+    QVERIFY(TorcIIODevice::FindDevice(root.path(), QStringLiteral("iio:device0")).endsWith(QStringLiteral("/iio:device0")));
+    QVERIFY(TorcIIODevice::FindDevice(root.path(), QStringLiteral("ds1621")).isEmpty());
+}
+
+void TestTorcIIODevice::testPolling(void)
+{
+    QTemporaryDir root;
+    QVERIFY(root.isValid());
+    QString device = root.path();
+    QVERIFY(TestTorcHelpers::WriteFile(device + QStringLiteral("/in_temp_input"), "25000\n"));
+    QVERIFY(TestTorcHelpers::WriteFile(device + QStringLiteral("/in_voltage0_raw"), "1000\n"));
+    QVERIFY(TestTorcHelpers::WriteFile(device + QStringLiteral("/in_voltage_scale"), "0.5\n"));
+    QVERIFY(TestTorcHelpers::WriteFile(device + QStringLiteral("/in_voltage0_offset"), "10\n"));
+
+    // no scan_elements - so the channels are polled
+    TestIIOListener temperature;
+    TestIIOListener voltage;
+    TorcIIODevice iio(device, QString(), false);
+    iio.SetSampleRate(100.0);
+    QVERIFY(iio.AddChannel(QStringLiteral("in_temp"), &temperature, 20.0));
+    QVERIFY(iio.AddChannel(QStringLiteral("in_voltage0"), &voltage, 20.0, 2.0, 1.0));
+    QVERIFY(!iio.AddChannel(QStringLiteral("in_voltage1"), nullptr));
+
+    QTRY_VERIFY_WITH_TIMEOUT(!temperature.Values().isEmpty() && !voltage.Values().isEmpty(), 5000);
+    QVERIFY(!iio.IsBuffered());
+    QCOMPARE(temperature.Values().first(), 25.0);
+    // ((1000 + 10) * 0.5) millivolts * 2 + 1
+    QCOMPARE(voltage.Values().first(), 2.01);
+    QVERIFY(iio.GetReadCount() >= iio.GetSampleCount());
+
+    QVERIFY(!iio.RemoveChannel(&temperature));
+    QVERIFY(iio.isRunning());
+    QVERIFY(iio.RemoveChannel(&voltage));
+    QVERIFY(!iio.isRunning());
+}
+
+void TestTorcIIODevice::testHwmon(void)
+{
+    QTemporaryDir root;
+    QVERIFY(root.isValid());
+    QVERIFY(TestTorcHelpers::WriteFile(root.path() + QStringLiteral("/name"), "cpu_thermal\n"));
+    QVERIFY(TestTorcHelpers::WriteFile(root.path() + QStringLiteral("/temp1_input"), "42500\n"));
+
+    TestIIOListener temperature;
+    TorcIIODevice hwmon(root.path(), QString(), true);
+    QVERIFY(hwmon.AddChannel(QStringLiteral("temp1"), &temperature, 20.0));
+    QTRY_VERIFY_WITH_TIMEOUT(!temperature.Values().isEmpty(), 5000);
+    QCOMPARE(temperature.Values().first(), 42.5);
+
+    // a missing sensor is reported as invalid
+    QVERIFY(TestTorcHelpers::WriteFile(root.path() + QStringLiteral("/temp1_input"), ""));
+    QTRY_VERIFY_WITH_TIMEOUT(temperature.m_invalid > 0, 5000);
+    QVERIFY(hwmon.RemoveChannel(&temperature));
+}
+
+void TestTorcIIODevice::testBuffered(void)
+{
+    QTemporaryDir root;
+    QVERIFY(root.isValid());
+    QDir dir(root.path());
+    QVERIFY(dir.mkpath(QStringLiteral("iio:device0/scan_elements")));
+    QVERIFY(dir.mkpath(QStringLiteral("iio:device0/buffer")));
+    QVERIFY(dir.mkpath(QStringLiteral("iio:device0/trigger")));
+    QString device = root.path() + QStringLiteral("/iio:device0");
+    QString scan   = device + QStringLiteral("/scan_elements/");
+    QVERIFY(TestTorcHelpers::WriteFile(device + QStringLiteral("/in_voltage0_raw"), "0\n"));
+    QVERIFY(TestTorcHelpers::WriteFile(device + QStringLiteral("/in_voltage1_raw"), "0\n"));
+    QVERIFY(TestTorcHelpers::WriteFile(device + QStringLiteral("/in_voltage_scale"), "1\n"));
+    QVERIFY(TestTorcHelpers::WriteFile(device + QStringLiteral("/buffer/enable"), "0\n"));
+    QVERIFY(TestTorcHelpers::WriteFile(device + QStringLiteral("/buffer/length"), "0\n"));
+    QVERIFY(TestTorcHelpers::WriteFile(device + QStringLiteral("/trigger/current_trigger"), "\n"));
+    QVERIFY(TestTorcHelpers::WriteFile(scan + QStringLiteral("in_voltage0_en"), "0\n"));
+    QVERIFY(TestTorcHelpers::WriteFile(scan + QStringLiteral("in_voltage0_index"), "0\n"));
+    QVERIFY(TestTorcHelpers::WriteFile(scan + QStringLiteral("in_voltage0_type"), "le:u12/16>>0\n"));
+    QVERIFY(TestTorcHelpers::WriteFile(scan + QStringLiteral("in_voltage1_en"), "0\n"));
+    QVERIFY(TestTorcHelpers::WriteFile(scan + QStringLiteral("in_voltage1_index"), "1\n"));
+    QVERIFY(TestTorcHelpers::WriteFile(scan + QStringLiteral("in_voltage1_type"), "le:s16/16>>0\n"));
+    QVERIFY(TestTorcHelpers::WriteFile(scan + QStringLiteral("in_timestamp_en"), "1\n"));
+    QVERIFY(TestTorcHelpers::WriteFile(scan + QStringLiteral("in_timestamp_index"), "2\n"));
+    QVERIFY(TestTorcHelpers::WriteFile(scan + QStringLiteral("in_timestamp_type"), "le:s64/64>>0\n"));
+
+    // a FIFO stands in for the character device. Keep it open for writing so the reader never sees EOF.
+    QString character = root.path() + QStringLiteral("/iio:device0.dev");
+    QVERIFY(mkfifo(character.toLocal8Bit().constData(), 0600) == 0);
+    int fifo = open(character.toLocal8Bit().constData(), O_RDWR | O_NONBLOCK);
+    QVERIFY(fifo > -1);
+
+    TestIIOListener first;
+    TestIIOListener second;
+    TorcIIODevice iio(device, character, false, QStringLiteral("hrtimer0"));
+    QVERIFY(iio.AddChannel(QStringLiteral("in_voltage1"), &second, 10.0));
+    QVERIFY(iio.AddChannel(QStringLiteral("in_voltage0"), &first, 10.0, 1.0, 0.5));
+    QTRY_VERIFY_WITH_TIMEOUT(iio.IsBuffered(), 5000);
+
+    QCOMPARE(TestTorcHelpers::ReadFile(device + QStringLiteral("/buffer/enable")), QByteArray("1"));
+    QCOMPARE(TestTorcHelpers::ReadFile(device + QStringLiteral("/trigger/current_trigger")), QByteArray("hrtimer0"));
+    QCOMPARE(TestTorcHelpers::ReadFile(scan + QStringLiteral("in_voltage0_en")), QByteArray("1"));
+    QCOMPARE(TestTorcHelpers::ReadFile(scan + QStringLiteral("in_voltage1_en")), QByteArray("1"));
+    QCOMPARE(TestTorcHelpers::ReadFile(scan + QStringLiteral("in_timestamp_en")), QByteArray("0"));
+
+    // 100 scans of 2 channels, 4 bytes each (in index order), in a single write
+    QByteArray data;
+    for (int i = 0; i < 100; ++i)
+    {
+        qint16 zero = static_cast<qint16>(i % 2 ? 1010 : 990);
+        qint16 one  = -2000;
+        data.append(static_cast<char>(zero & 0xff)).append(static_cast<char>((zero >> 8) & 0xff));
+        data.append(static_cast<char>(one & 0xff)).append(static_cast<char>((one >> 8) & 0xff));
+    }
+    QCOMPARE(write(fifo, data.constData(), data.size()), (ssize_t)data.size());
+
+    QTRY_VERIFY_WITH_TIMEOUT(!first.Values().isEmpty() && !second.Values().isEmpty(), 5000);
+    QCOMPARE(first.Values().first(), 1.5);
+    QCOMPARE(second.Values().first(), -2.0);
+
+    // many samples per read
+    QCOMPARE(iio.GetSampleCount(), (quint64)100);
+    QVERIFY(iio.GetReadCount() < 10);
+
+    QVERIFY(!iio.RemoveChannel(&second));
+    QVERIFY(iio.RemoveChannel(&first));
+    QCOMPARE(TestTorcHelpers::ReadFile(device + QStringLiteral("/buffer/enable")), QByteArray("0"));
+    close(fifo);
+}
@@ -0,0 +1,19 @@
+#ifndef TESTTORCIIODEVICE_H
+#define TESTTORCIIODEVICE_H
+
+#include <QObject>
+
+class TestTorcIIODevice : public QObject
+{
+    Q_OBJECT
+
+  private slots:
+    void testParseType(void);
+    void testUnits(void);
+    void testFindDevice(void);
+    void testPolling(void);
+    void testHwmon(void);
+    void testBuffered(void);
+};
+
+#endif // TESTTORCIIODEVICE_H
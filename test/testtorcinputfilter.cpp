@@ -0,0 +1,154 @@
+// Qt
+#include <QtTest/QtTest>
+
+// Torc
+#include "torcclock.h"
+#include "torcinputfilter.h"
+#include "testtorcinputfilter.h"
+
+/// Pass Values through Chain, as an input would, and return the values that were accepted.
+static QList<double> Run(TorcInputFilterChain &Chain, const QList<double> &Values, qint64 Step = 0)
+{
+    QList<double> result;
+    double last = 0.0;
+    qint64 now  = 0;
+    foreach (double value, Values)
+    {
+        if (Chain.Filter(value, last, now))
+        {
+            result.append(value);
+            last = value;
+        }
+        now += Step;
+    }
+    return result;
+}
+
+void TestTorcInputFilter::testConfig(void)
+{
+    TorcInputFilterChain none;
+    QVERIFY(none.IsEmpty());
+
+    QVariantMap filter;
+    filter.insert(QStringLiteral("deadband"), QStringLiteral("0.1"));
+    filter.insert(QStringLiteral("hysteresis"), QStringLiteral("0.2"));
+    filter.insert(QStringLiteral("mininterval"), QStringLiteral("1000"));
+    QVariantMap details;
+    details.insert(QStringLiteral("name"), QStringLiteral("test"));
+    details.insert(INPUT_FILTER, filter);
+
+    TorcInputFilterChain chain(details);
+    QVERIFY(!chain.IsEmpty());
+    QVariantMap statistics = chain.GetStatistics();
+    QVERIFY(statistics.contains(QStringLiteral("deadband")));
+    QVERIFY(statistics.contains(QStringLiteral("hysteresis")));
+    QVERIFY(statistics.contains(QStringLiteral("mininterval")));
+    QCOMPARE(statistics.value(QStringLiteral("suppressed")).toULongLong(), (quint64)0);
+}
+
+void TestTorcInputFilter::testDeadband(void)
+{
+    TorcInputFilterChain chain;
+    chain.AddFilter(new TorcDeadbandFilter(0.01));
+
+    // pH jittering in the third decimal place
+    QList<double> values = QList<double>() << 7.000 << 7.003 << 6.998 << 7.004 << 7.020 << 7.025 << 7.031;
+    QCOMPARE(Run(chain, values), QList<double>() << 7.000 << 7.020 << 7.031);
+    QCOMPARE(chain.GetAccepted(), (quint64)3);
+    QCOMPARE(chain.GetSuppressed(), (quint64)4);
+    QCOMPARE(chain.GetStatistics().value(QStringLiteral("deadband")).toULongLong(), (quint64)4);
+}
+
+void TestTorcInputFilter::testHysteresis(void)
+{
+    TorcInputFilterChain chain;
+    chain.AddFilter(new TorcHysteresisFilter(0.1));
+
+    // a 1Wire sensor toggling by 0.0625 is ignored, a steady rise is tracked and a small reversal is ignored
+    QList<double> values = QList<double>() << 20.0 << 20.0625 << 20.0 << 20.0625 << 20.125 << 20.1875 << 20.25 << 20.1875 << 20.0;
+    QCOMPARE(Run(chain, values), QList<double>() << 20.0 << 20.125 << 20.1875 << 20.25 << 20.0);
+    QCOMPARE(chain.GetSuppressed(), (quint64)4);
+}
+
+void TestTorcInputFilter::testMinimumInterval(void)
+{
+    TorcInputFilterChain chain;
+    chain.AddFilter(new TorcMinimumIntervalFilter(1000));
+
+    // a change every 300ms is published at most once a second
+    QList<double> values = QList<double>() << 1 << 2 << 3 << 4 << 5 << 6 << 7 << 8 << 9;
+    QCOMPARE(Run(chain, values, 300), QList<double>() << 1 << 5 << 9);
+    QCOMPARE(chain.GetSuppressed(), (quint64)6);
+
+    // a switch that turns on and off again within the interval holds its final state until the interval has passed
+    TorcInputFilterChain edge;
+    edge.AddFilter(new TorcMinimumIntervalFilter(1000));
+    double held  = -1.0;
+    qint64 until = -1;
+    QVERIFY(edge.Filter(0.0, 0.0, 0));
+    QVERIFY(!edge.GetHeld(held, until));
+    QVERIFY(edge.Filter(1.0, 0.0, 1000));
+    QVERIFY(!edge.Filter(0.0, 1.0, 1200));
+    QVERIFY(edge.GetHeld(held, until));
+    QCOMPARE(held, 0.0);
+    QCOMPARE(until, (qint64)2000);
+    QVERIFY(edge.Filter(held, 1.0, until));
+    QVERIFY(!edge.GetHeld(held, until));
+
+    // a held value is discarded when the input returns to the accepted value, or is reset
+    QVERIFY(!edge.Filter(1.0, 0.0, 2500));
+    QVERIFY(edge.GetHeld(held, until));
+    edge.ClearHeld();
+    QVERIFY(!edge.GetHeld(held, until));
+    QVERIFY(!edge.Filter(1.0, 0.0, 2600));
+    edge.Reset();
+    QVERIFY(!edge.GetHeld(held, until));
+
+    // a value suppressed by the deadband is not held
+    TorcInputFilterChain deadband;
+    deadband.AddFilter(new TorcDeadbandFilter(0.5));
+    QVERIFY(deadband.Filter(1.0, 0.0, 0));
+    QVERIFY(!deadband.Filter(1.1, 1.0, 0));
+    QVERIFY(!deadband.GetHeld(held, until));
+}
+
+void TestTorcInputFilter::testClock(void)
+{
+    // without an explicit time, the chain uses TorcClock
+    TorcClock::SetVirtualTime(QDateTime(QDate(2018, 1, 1), QTime(0, 0)).toMSecsSinceEpoch());
+    TorcInputFilterChain chain;
+    chain.AddFilter(new TorcMinimumIntervalFilter(1000));
+    QVERIFY(chain.Filter(0.0, 0.0));
+    QVERIFY(!chain.Filter(1.0, 0.0));
+    double held  = 0.0;
+    qint64 until = 0;
+    QVERIFY(chain.GetHeld(held, until));
+    QCOMPARE(until, TorcClock::Elapsed() + 1000);
+    TorcClock::SetVirtualTime(TorcClock::CurrentMSecsSinceEpoch() + 1000);
+    QVERIFY(chain.Filter(held, 0.0));
+    TorcClock::SetRealTime();
+}
+
+void TestTorcInputFilter::testChain(void)
+{
+    TorcInputFilterChain chain;
+    chain.AddFilter(new TorcDeadbandFilter(0.5));
+    chain.AddFilter(new TorcMinimumIntervalFilter(1000));
+
+    // the first value is always accepted
+    QVERIFY(chain.Filter(10.0, 0.0, 0));
+    QVERIFY(!chain.Filter(10.1, 10.0, 2000)); // deadband
+    QVERIFY(!chain.Filter(11.0, 10.0, 500));  // interval
+    QVERIFY(chain.Filter(11.0, 10.0, 1000));
+
+    // and after a reset
+    chain.Reset();
+    QVERIFY(chain.Filter(11.1, 11.0, 1001));
+    QVERIFY(!chain.Filter(12.0, 11.1, 1500));
+
+    QVariantMap statistics = chain.GetStatistics();
+    QCOMPARE(statistics.value(QStringLiteral("accepted")).toULongLong(), (quint64)3);
+    QCOMPARE(statistics.value(QStringLiteral("suppressed")).toULongLong(), (quint64)3);
+    QCOMPARE(statistics.value(QStringLiteral("deadband")).toULongLong(), (quint64)1);
+    QCOMPARE(statistics.value(QStringLiteral("mininterval")).toULongLong(), (quint64)2);
+}
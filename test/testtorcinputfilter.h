@@ -0,0 +1,19 @@
+#ifndef TESTTORCINPUTFILTER_H
+#define TESTTORCINPUTFILTER_H
+
+#include <QObject>
+
+class TestTorcInputFilter : public QObject
+{
+    Q_OBJECT
+
+  private slots:
+    void testConfig(void);
+    void testDeadband(void);
+    void testHysteresis(void);
+    void testMinimumInterval(void);
+    void testClock(void);
+    void testChain(void);
+};
+
+#endif // TESTTORCINPUTFILTER_H
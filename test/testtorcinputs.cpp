@@ -0,0 +1,287 @@
+// Qt
+#include <QtTest/QtTest>
+
+// Torc
+#include "torcinputs.h"
+#include "torcoutputs.h"
+#include "torccontrols.h"
+#include "torcnetworkpwmoutput.h"
+#include "testtorcinputs.h"
+
+/// Build a binary batch, as sent by a constrained client.
+static QByteArray Batch(quint8 Flags, const QList<QPair<QByteArray,double> > &Entries, qint64 Timestamp = 0)
+{
+    QByteArray result;
+    QDataStream stream(&result, QIODevice::WriteOnly);
+    stream.setByteOrder(QDataStream::BigEndian);
+    stream.setFloatingPointPrecision(Flags & 0x02 ? QDataStream::DoublePrecision : QDataStream::SinglePrecision);
+    stream << (quint8)1 << Flags << (quint16)Entries.size();
+    for (int i = 0; i < Entries.size(); ++i)
+    {
+        stream << (quint8)Entries.at(i).first.size();
+        stream.writeRawData(Entries.at(i).first.constData(), Entries.at(i).first.size());
+        stream << Entries.at(i).second;
+        if (Flags & 0x01)
+            stream << (Timestamp + i);
+    }
+    return result;
+}
+
+void TestTorcInputs::testParseJSON(void)
+{
+    QVariantList values;
+    QString error;
+
+    QByteArray list("[{\"uniqueId\":\"temp1\",\"value\":20.5,\"timestamp\":1000},{\"uniqueId\":\"temp2\",\"value\":-3}]");
+    QVERIFY(TorcInputs::ParseInputValues(list, false, values, error));
+    QCOMPARE(values.size(), 2);
+    QVariantMap first = values.at(0).toMap();
+    QCOMPARE(first.value(QStringLiteral("uniqueId")).toString(), QStringLiteral("temp1"));
+    QCOMPARE(first.value(QStringLiteral("value")).toDouble(), 20.5);
+    QCOMPARE(first.value(QStringLiteral("timestamp")).toLongLong(), (qint64)1000);
+    QCOMPARE(values.at(1).toMap().value(QStringLiteral("value")).toDouble(), -3.0);
+
+    QByteArray object("{\"values\":[{\"uniqueId\":\"ph1\",\"value\":7.01}]}");
+    QVERIFY(TorcInputs::ParseInputValues(object, false, values, error));
+    QCOMPARE(values.size(), 1);
+    QCOMPARE(values.at(0).toMap().value(QStringLiteral("uniqueId")).toString(), QStringLiteral("ph1"));
+
+    QVERIFY(!TorcInputs::ParseInputValues(QByteArray("[{\"uniqueId\":"), false, values, error));
+    QVERIFY(!error.isEmpty());
+    error.clear();
+    QVERIFY(!TorcInputs::ParseInputValues(QByteArray("{\"value\":1}"), false, values, error));
+    QVERIFY(!error.isEmpty());
+}
+
+void TestTorcInputs::testParseBinary(void)
+{
+    QList<QPair<QByteArray,double> > entries;
+    entries << qMakePair(QByteArray("temp1"), 20.5) << qMakePair(QByteArray("switch"), 1.0);
+
+    QVariantList values;
+    QString error;
+    QVERIFY(TorcInputs::ParseInputValues(Batch(0x00, entries), true, values, error));
+    QCOMPARE(values.size(), 2);
+    QCOMPARE(values.at(0).toMap().value(QStringLiteral("uniqueId")).toString(), QStringLiteral("temp1"));
+    QCOMPARE(values.at(0).toMap().value(QStringLiteral("value")).toDouble(), 20.5);
+    QVERIFY(!values.at(0).toMap().contains(QStringLiteral("timestamp")));
+    QCOMPARE(values.at(1).toMap().value(QStringLiteral("uniqueId")).toString(), QStringLiteral("switch"));
+
+    QVERIFY(TorcInputs::ParseInputValues(Batch(0x01, entries, 1530000000000), true, values, error));
+    QCOMPARE(values.size(), 2);
+    QCOMPARE(values.at(0).toMap().value(QStringLiteral("timestamp")).toLongLong(), (qint64)1530000000000);
+    QCOMPARE(values.at(1).toMap().value(QStringLiteral("timestamp")).toLongLong(), (qint64)1530000000001);
+}
+
+void TestTorcInputs::testParseBinaryDouble(void)
+{
+    // 7.1 is not exactly representable as a float
+    QList<QPair<QByteArray,double> > entries;
+    entries << qMakePair(QByteArray("ph1"), 7.1);
+
+    QVariantList values;
+    QString error;
+    QVERIFY(TorcInputs::ParseInputValues(Batch(0x03, entries, 1), true, values, error));
+    QCOMPARE(values.at(0).toMap().value(QStringLiteral("value")).toDouble(), 7.1);
+
+    QVERIFY(TorcInputs::ParseInputValues(Batch(0x00, entries), true, values, error));
+    QCOMPARE(values.at(0).toMap().value(QStringLiteral("value")).toDouble(), (double)7.1f);
+}
+
+void TestTorcInputs::testParseBinaryInvalid(void)
+{
+    QList<QPair<QByteArray,double> > entries;
+    entries << qMakePair(QByteArray("temp1"), 20.5) << qMakePair(QByteArray("temp2"), 21.5);
+    QByteArray batch = Batch(0x01, entries, 1000);
+
+    QVariantList values;
+    QString error;
+    QVERIFY(!TorcInputs::ParseInputValues(QByteArray(), true, values, error));
+    error.clear();
+
+    // every truncation must fail
+    for (int i = 1; i < batch.size(); ++i)
+    {
+        QVERIFY(!TorcInputs::ParseInputValues(batch.left(i), true, values, error));
+        QVERIFY(!error.isEmpty());
+        error.clear();
+    }
+
+    QVERIFY(!TorcInputs::ParseInputValues(batch + QByteArray(1, '\0'), true, values, error));
+    error.clear();
+
+    QByteArray version(batch);
+    version[0] = 2;
+    QVERIFY(!TorcInputs::ParseInputValues(version, true, values, error));
+}
+
+static QVariantMap Entry(const QString &UniqueId, const QVariant &Value, qint64 Timestamp = 0)
+{
+    QVariantMap entry;
+    entry.insert(QStringLiteral("uniqueId"), UniqueId);
+    entry.insert(QStringLiteral("value"), Value);
+    if (Timestamp)
+        entry.insert(QStringLiteral("timestamp"), Timestamp);
+    return entry;
+}
+
+/// Two network inputs and a constant input, averaged by a logic control.
+static QVariantMap BatchConfig(void)
+{
+    QVariantMap first;
+    first.insert(QStringLiteral("name"), QStringLiteral("testbatcha"));
+    first.insert(QStringLiteral("default"), 0);
+    QVariantMap second;
+    second.insert(QStringLiteral("name"), QStringLiteral("testbatchb"));
+    second.insert(QStringLiteral("default"), 0);
+    QVariantMap network;
+    network.insertMulti(QStringLiteral("pwm"), first);
+    network.insertMulti(QStringLiteral("pwm"), second);
+    QVariantMap fixed;
+    fixed.insert(QStringLiteral("name"), QStringLiteral("testbatchconstant"));
+    fixed.insert(QStringLiteral("value"), 1);
+    QVariantMap constant;
+    constant.insert(QStringLiteral("pwm"), fixed);
+    QVariantMap inputs;
+    inputs.insert(QStringLiteral("network"), network);
+    inputs.insert(QStringLiteral("constant"), constant);
+
+    QVariantMap controlinputs;
+    controlinputs.insertMulti(QStringLiteral("device"), QStringLiteral("testbatcha"));
+    controlinputs.insertMulti(QStringLiteral("device"), QStringLiteral("testbatchb"));
+    QVariantMap controloutputs;
+    controloutputs.insert(QStringLiteral("device"), QStringLiteral("testbatchoutput"));
+    QVariantMap average;
+    average.insert(QStringLiteral("name"), QStringLiteral("testbatchaverage"));
+    average.insert(QStringLiteral("inputs"), controlinputs);
+    average.insert(QStringLiteral("outputs"), controloutputs);
+    QVariantMap logic;
+    logic.insert(QStringLiteral("average"), average);
+    QVariantMap controls;
+    controls.insert(QStringLiteral("logic"), logic);
+
+    QVariantMap config;
+    config.insert(QStringLiteral("inputs"), inputs);
+    config.insert(QStringLiteral("controls"), controls);
+    return config;
+}
+
+/// Return the number of evaluation passes run for the component containing Control.
+static quint64 Passes(const QString &Control)
+{
+    foreach (const QVariant &component, TorcControls::gControls->GetComponents())
+    {
+        QVariantMap status = component.toMap();
+        if (status.value(QStringLiteral("controls")).toStringList().contains(Control))
+            return status.value(QStringLiteral("passes")).toULongLong();
+    }
+    return 0;
+}
+
+/// Wait for the control graph to settle and deliver the (queued) output updates.
+static void Settle(void)
+{
+    TorcControls::gControls->Propagate();
+    QCoreApplication::processEvents();
+}
+
+void TestTorcInputs::testSetInputValues(void)
+{
+    QVariantMap details;
+    details.insert(QStringLiteral("name"), QStringLiteral("testbatchoutput"));
+    TorcNetworkPWMOutput *output = new TorcNetworkPWMOutput(0, details);
+    QList<double> values;
+    QObject::connect(output, &TorcDevice::ValueChanged, [&values](double Value) { values.append(Value); });
+
+    TorcDeviceHandler::Start(BatchConfig());
+    TorcControls::gControls->Validate();
+
+    QVariantMap result = TorcInputs::gInputs->SetInputValues(QVariantList() << Entry(QStringLiteral("testbatcha"), 0.2)
+                                                                             << Entry(QStringLiteral("testbatchb"), 0.2));
+    QCOMPARE(result.value(QStringLiteral("applied")).toInt(), 2);
+    Settle();
+    QCOMPARE(output->GetValue(), 0.2);
+    values.clear();
+
+    // only the latest value for each input is applied and the control is evaluated once, after the whole batch
+    quint64 passes = Passes(QStringLiteral("testbatchaverage"));
+    result = TorcInputs::gInputs->SetInputValues(QVariantList() << Entry(QStringLiteral("testbatcha"), 0.1)
+                                                                 << Entry(QStringLiteral("testbatcha"), 0.3)
+                                                                 << Entry(QStringLiteral("testbatchb"), 0.5));
+    QCOMPARE(result.value(QStringLiteral("applied")).toInt(), 2);
+    QCOMPARE(result.value(QStringLiteral("stale")).toInt(), 0);
+    QVERIFY(result.value(QStringLiteral("errors")).toList().isEmpty());
+    Settle();
+    QCOMPARE(values.size(), 1);
+    QCOMPARE(values.at(0), 0.4);
+    QCOMPARE(Passes(QStringLiteral("testbatchaverage")), passes + 1);
+    values.clear();
+
+    // stale timestamps are dropped - against earlier batches and within a batch
+    result = TorcInputs::gInputs->SetInputValues(QVariantList() << Entry(QStringLiteral("testbatcha"), 0.5, 2000));
+    QCOMPARE(result.value(QStringLiteral("applied")).toInt(), 1);
+    Settle();
+    result = TorcInputs::gInputs->SetInputValues(QVariantList() << Entry(QStringLiteral("testbatcha"), 0.9, 1000)
+                                                                 << Entry(QStringLiteral("testbatcha"), 0.9, 2000)
+                                                                 << Entry(QStringLiteral("testbatchb"), 0.7, 5000)
+                                                                 << Entry(QStringLiteral("testbatchb"), 0.9, 4000));
+    QCOMPARE(result.value(QStringLiteral("applied")).toInt(), 1);
+    QCOMPARE(result.value(QStringLiteral("stale")).toInt(), 3);
+    Settle();
+    QCOMPARE(values.size(), 2);
+    QCOMPARE(values.at(0), 0.5);
+    QCOMPARE(values.at(1), 0.6);
+    values.clear();
+
+    // unknown inputs, inputs that are not network inputs and invalid values are rejected
+    result = TorcInputs::gInputs->SetInputValues(QVariantList() << Entry(QStringLiteral("testbatchunknown"), 0.1)
+                                                                 << Entry(QStringLiteral("testbatchconstant"), 0.1)
+                                                                 << Entry(QStringLiteral("testbatcha"), QStringLiteral("high")));
+    QCOMPARE(result.value(QStringLiteral("applied")).toInt(), 0);
+    QCOMPARE(result.value(QStringLiteral("errors")).toList().size(), 3);
+    Settle();
+    QVERIFY(values.isEmpty());
+
+    TorcDeviceHandler::Stop();
+    TorcOutputs::gOutputs->RemoveOutput(output);
+    output->DownRef();
+    QCoreApplication::sendPostedEvents(nullptr, QEvent::DeferredDelete);
+}
+
+void TestTorcInputs::testHoldPropagation(void)
+{
+    QVariantMap details;
+    details.insert(QStringLiteral("name"), QStringLiteral("testbatchoutput"));
+    TorcNetworkPWMOutput *output = new TorcNetworkPWMOutput(0, details);
+
+    TorcDeviceHandler::Start(BatchConfig());
+    TorcControls::gControls->Validate();
+    (void)TorcInputs::gInputs->SetInputValues(QVariantList() << Entry(QStringLiteral("testbatcha"), 0.0)
+                                                              << Entry(QStringLiteral("testbatchb"), 0.0));
+    Settle();
+
+    // nothing is evaluated while propagation is held (and holds nest)
+    quint64 passes = Passes(QStringLiteral("testbatchaverage"));
+    TorcControls::gControls->HoldPropagation();
+    TorcControls::gControls->HoldPropagation();
+    (void)TorcInputs::gInputs->SetInputValues(QVariantList() << Entry(QStringLiteral("testbatcha"), 0.8));
+    (void)TorcInputs::gInputs->SetInputValues(QVariantList() << Entry(QStringLiteral("testbatchb"), 0.4));
+    Settle();
+    QCOMPARE(Passes(QStringLiteral("testbatchaverage")), passes);
+    QCOMPARE(output->GetValue(), 0.0);
+
+    TorcControls::gControls->ReleasePropagation();
+    Settle();
+    QCOMPARE(Passes(QStringLiteral("testbatchaverage")), passes);
+
+    // and the control is evaluated once when the last hold is released
+    TorcControls::gControls->ReleasePropagation();
+    Settle();
+    QCOMPARE(Passes(QStringLiteral("testbatchaverage")), passes + 1);
+    QCOMPARE(output->GetValue(), 0.6);
+
+    TorcDeviceHandler::Stop();
+    TorcOutputs::gOutputs->RemoveOutput(output);
+    output->DownRef();
+    QCoreApplication::sendPostedEvents(nullptr, QEvent::DeferredDelete);
+}
@@ -0,0 +1,19 @@
+#ifndef TESTTORCINPUTS_H
+#define TESTTORCINPUTS_H
+
+#include <QObject>
+
+class TestTorcInputs : public QObject
+{
+    Q_OBJECT
+
+  private slots:
+    void testParseJSON(void);
+    void testParseBinary(void);
+    void testParseBinaryDouble(void);
+    void testParseBinaryInvalid(void);
+    void testSetInputValues(void);
+    void testHoldPropagation(void);
+};
+
+#endif // TESTTORCINPUTS_H
@@ -0,0 +1,179 @@
+// Qt
+#include <QtTest/QtTest>
+
+// Torc
+#include "torcmaths.h"
+#include "testtorcmaths.h"
+
+// std
+#include <algorithm>
+#include <cmath>
+
+void TestTorcMaths::testRingBuffer(void)
+{
+    TorcRingBuffer<int> buffer(3);
+    QVERIFY(buffer.IsEmpty());
+    QCOMPARE(buffer.Capacity(), 3);
+
+    // wrap around several times
+    for (int i = 0; i < 10; ++i)
+    {
+        if (buffer.IsFull())
+            QCOMPARE(buffer.PopFront(), i - 3);
+        buffer.PushBack(i);
+    }
+    QVERIFY(buffer.IsFull());
+    QCOMPARE(buffer.Front(), 7);
+    QCOMPARE(buffer.At(1), 8);
+    QCOMPARE(buffer.Back(), 9);
+    QCOMPARE(buffer.PopBack(), 9);
+    QCOMPARE(buffer.Size(), 2);
+    buffer.Clear();
+    QVERIFY(buffer.IsEmpty());
+}
+
+void TestTorcMaths::testAverage(void)
+{
+    TorcAverage<double> average(4);
+    for (int i = 1; i <= 4; ++i)
+        (void)average.AddValue(i);
+    QCOMPARE(average.GetAverage(), 2.5);
+    QCOMPARE(average.AddValue(5), 3.5);
+
+    // a large offset must not leave residual error once it has left the window
+    (void)average.AddValue(1.0e16);
+    for (int i = 0; i < 4; ++i)
+        (void)average.AddValue(1.0);
+    QCOMPARE(average.GetAverage(), 1.0);
+
+    TorcAverage<int> total;
+    for (int i = 0; i < 100; ++i)
+        (void)total.AddValue(i);
+    QCOMPARE(total.GetAverage(), 49.5);
+    total.Reset();
+    QCOMPARE(total.GetAverage(), 0.0);
+}
+
+void TestTorcMaths::testWindowStatistics(void)
+{
+    // 10 second window
+    TorcWindowStatistics statistics(10000, 1024);
+    statistics.AddValue(0,    4.0);
+    statistics.AddValue(1000, 2.0);
+    statistics.AddValue(2000, 6.0);
+    statistics.AddValue(3000, 8.0);
+    QCOMPARE(statistics.Count(), 4);
+    QCOMPARE(statistics.Mean(), 5.0);
+    QCOMPARE(statistics.Minimum(), 2.0);
+    QCOMPARE(statistics.Maximum(), 8.0);
+    QCOMPARE(statistics.Variance(), 5.0);
+    QCOMPARE(statistics.RateOfChange(), 4.0 / 3.0);
+
+    // the first two samples leave the window
+    statistics.AddValue(11500, 7.0);
+    QCOMPARE(statistics.Count(), 3);
+    QCOMPARE(statistics.Mean(), 7.0);
+    QCOMPARE(statistics.Minimum(), 6.0);
+    QCOMPARE(statistics.Maximum(), 8.0);
+
+    // the oldest sample (2000) expires at 12000
+    qint64 expiry = 0;
+    QVERIFY(statistics.NextExpiry(expiry));
+    QCOMPARE(expiry, (qint64)12000);
+    statistics.Expire(expiry - 1);
+    QCOMPARE(statistics.Count(), 3);
+    statistics.Expire(expiry);
+    QCOMPARE(statistics.Count(), 2);
+    QCOMPARE(statistics.Minimum(), 7.0);
+    QVERIFY(statistics.NextExpiry(expiry));
+    QCOMPARE(expiry, (qint64)13000);
+    statistics.Expire(21500);
+    QCOMPARE(statistics.Count(), 0);
+    QVERIFY(!statistics.NextExpiry(expiry));
+
+    // compare with a brute force calculation over a random walk, with the capacity limiting the window
+    qsrand(1);
+    TorcWindowStatistics limited(1000000, 50);
+    QVector<double> values;
+    double value = 100.0;
+    for (int i = 0; i < 5000; ++i)
+    {
+        value += ((qrand() % 2001) - 1000) / 100.0;
+        values.append(value);
+        limited.AddValue(i, value);
+
+        QVector<double> window = values.mid(qMax(0, values.size() - 50));
+        double sum = 0.0;
+        foreach (double sample, window)
+            sum += sample;
+        double mean = sum / window.size();
+        double squares = 0.0;
+        foreach (double sample, window)
+            squares += (sample - mean) * (sample - mean);
+
+        QCOMPARE(limited.Count(), window.size());
+        QVERIFY(qAbs(limited.Mean() - mean) < 1e-9);
+        QVERIFY(qAbs(limited.Variance() - (window.size() > 1 ? squares / window.size() : 0.0)) < 1e-6);
+        QCOMPARE(limited.Minimum(), *std::min_element(window.constBegin(), window.constEnd()));
+        QCOMPARE(limited.Maximum(), *std::max_element(window.constBegin(), window.constEnd()));
+    }
+
+    limited.Reset();
+    QCOMPARE(limited.Count(), 0);
+    QCOMPARE(limited.Mean(), 0.0);
+}
+
+void TestTorcMaths::testEWMA(void)
+{
+    TorcEWMA average(1000);
+    QCOMPARE(average.AddValue(0, 10.0), 10.0);
+
+    // a step change is 63% complete after one time constant, however it is sampled
+    (void)average.AddValue(1000, 20.0);
+    QVERIFY(qAbs(average.GetAverage() - (20.0 - 10.0 * std::exp(-1.0))) < 1e-9);
+
+    TorcEWMA stepped(1000);
+    (void)stepped.AddValue(0, 10.0);
+    for (int i = 1; i <= 10; ++i)
+        (void)stepped.AddValue(i * 100, 20.0);
+    QVERIFY(qAbs(stepped.GetAverage() - average.GetAverage()) < 1e-9);
+
+    // no time elapsed, no change
+    QCOMPARE(stepped.AddValue(1000, 100.0), stepped.GetAverage());
+    QVERIFY(stepped.GetAverage() < 20.0);
+}
+
+void TestTorcMaths::testPercentile(void)
+{
+    // exact for small counts
+    TorcPercentile median(0.5);
+    QCOMPARE(median.GetValue(), 0.0);
+    median.AddValue(3.0);
+    median.AddValue(1.0);
+    median.AddValue(2.0);
+    QCOMPARE(median.GetValue(), 2.0);
+
+    // estimates over a uniform distribution
+    qsrand(1);
+    TorcPercentile estimate50(0.5);
+    TorcPercentile estimate90(0.9);
+    for (int i = 0; i < 100000; ++i)
+    {
+        double value = (qrand() % 10001) / 100.0;
+        estimate50.AddValue(value);
+        estimate90.AddValue(value);
+    }
+    QCOMPARE(estimate50.Count(), (quint64)100000);
+    QVERIFY(qAbs(estimate50.GetValue() - 50.0) < 1.0);
+    QVERIFY(qAbs(estimate90.GetValue() - 90.0) < 1.0);
+
+    // the windowed estimate follows a change in distribution within a window
+    TorcWindowPercentile window(0.5, 10000);
+    double result = 0.0;
+    for (int i = 0; i < 20000; ++i)
+        result = window.AddValue(i, (qrand() % 101) / 10.0);
+    QVERIFY(qAbs(result - 5.0) < 0.5);
+    for (int i = 20000; i < 30000; ++i)
+        result = window.AddValue(i, 100.0 + (qrand() % 101) / 10.0);
+    QVERIFY(qAbs(result - 105.0) < 0.5);
+}
@@ -0,0 +1,18 @@
+#ifndef TESTTORCMATHS_H
+#define TESTTORCMATHS_H
+
+#include <QObject>
+
+class TestTorcMaths : public QObject
+{
+    Q_OBJECT
+
+  private slots:
+    void testRingBuffer(void);
+    void testAverage(void);
+    void testWindowStatistics(void);
+    void testEWMA(void);
+    void testPercentile(void);
+};
+
+#endif // TESTTORCMATHS_H
@@ -0,0 +1,589 @@
+// Qt
+#include <QtTest/QtTest>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QElapsedTimer>
+
+// Torc
+#include "torcmodbusmaster.h"
+#include "torcmodbusbus.h"
+#include "testtorcmodbus.h"
+
+static quint16 Get16(const QByteArray &Data, int Offset)
+{
+    return static_cast<quint16>((static_cast<quint8>(Data.at(Offset)) << 8) | static_cast<quint8>(Data.at(Offset + 1)));
+}
+
+static QByteArray Bytes(const char *Hex)
+{
+    return QByteArray::fromHex(Hex);
+}
+
+/*! A Modbus TCP server stand-in that accepts a single master at a time.
+ *
+ * Holding registers read as (slave * 1000 + address) until written, input registers as 10000 more than that and
+ * coils as (address % 2). Any address of 9000 or above returns an 'illegal data address' exception. Responses can
+ * be delayed to check that requests are pipelined.
+*/
+class TestModbusSimulator
+{
+  public:
+    TestModbusSimulator()
+      : delay(0),
+        outstanding(0),
+        maxOutstanding(0),
+        requests(),
+        slaves(),
+        times(),
+        holding(),
+        coils(),
+        m_server(),
+        m_socket(nullptr),
+        m_buffer(),
+        m_clock()
+    {
+        QObject::connect(&m_server, &QTcpServer::newConnection, &m_server, [this]() { Accept(); });
+        m_server.listen(QHostAddress::LocalHost);
+        m_clock.start();
+    }
+
+    QVariantMap Settings(int Pipeline = 4, int Rate = 0, int Gap = 0) const
+    {
+        QVariantMap result;
+        result.insert(QStringLiteral("host"),     QStringLiteral("127.0.0.1"));
+        result.insert(QStringLiteral("port"),     QString::number(m_server.serverPort()));
+        result.insert(QStringLiteral("timeout"),  QStringLiteral("2000"));
+        result.insert(QStringLiteral("pipeline"), QString::number(Pipeline));
+        result.insert(QStringLiteral("gap"),      QString::number(Gap));
+        if (Rate > 0)
+            result.insert(QStringLiteral("rate"), QString::number(Rate));
+        return result;
+    }
+
+    int Reads(void) const
+    {
+        int result = 0;
+        foreach (const QByteArray &request, requests)
+            if (request.at(0) >= 1 && request.at(0) <= 4)
+                result++;
+        return result;
+    }
+
+  public:
+    int               delay;
+    int               outstanding;
+    int               maxOutstanding;
+    QList<QByteArray> requests;
+    QList<int>        slaves;
+    QList<qint64>     times;
+    QHash<int,quint16> holding;
+    QHash<int,bool>   coils;
+
+  private:
+    void Accept(void)
+    {
+        QTcpSocket *socket = m_server.nextPendingConnection();
+        if (m_socket)
+            m_socket->deleteLater();
+        m_socket = socket;
+        m_buffer.clear();
+        QObject::connect(socket, &QTcpSocket::readyRead, &m_server, [this, socket]() { if (socket == m_socket) Read(); });
+    }
+
+    void Read(void)
+    {
+        m_buffer.append(m_socket->readAll());
+        quint16 id = 0;
+        int slave  = 0;
+        bool error = false;
+        QByteArray pdu;
+        while (TorcModbusMaster::TakeTCPFrame(m_buffer, id, slave, pdu, error))
+        {
+            requests.append(pdu);
+            slaves.append(slave);
+            times.append(m_clock.elapsed());
+            if (++outstanding > maxOutstanding)
+                maxOutstanding = outstanding;
+
+            QByteArray frame = TorcModbusMaster::EncodeTCP(id, slave, Respond(slave, pdu));
+            if (delay > 0)
+                QTimer::singleShot(delay, &m_server, [this, frame]() { Reply(frame); });
+            else
+                Reply(frame);
+        }
+    }
+
+    void Reply(const QByteArray &Frame)
+    {
+        outstanding--;
+        if (m_socket)
+            m_socket->write(Frame);
+    }
+
+    QByteArray Respond(int Slave, const QByteArray &PDU)
+    {
+        quint8 function = static_cast<quint8>(PDU.at(0));
+        int address     = Get16(PDU, 1);
+        int count       = Get16(PDU, 3);
+        QByteArray result;
+        if (address >= 9000)
+        {
+            result.append(static_cast<char>(function | 0x80));
+            result.append(static_cast<char>(2));
+            return result;
+        }
+
+        int key = (Slave << 16) | address;
+        result.append(static_cast<char>(function));
+        switch (function)
+        {
+            case 1:
+            case 2:
+            {
+                QByteArray bits((count + 7) / 8, 0);
+                for (int i = 0; i < count; ++i)
+                    if (coils.value(key + i, (address + i) % 2))
+                        bits[i / 8] = static_cast<char>(bits.at(i / 8) | (1 << (i % 8)));
+                result.append(static_cast<char>(bits.size()));
+                result.append(bits);
+                break;
+            }
+            case 3:
+            case 4:
+            {
+                result.append(static_cast<char>(count * 2));
+                for (int i = 0; i < count; ++i)
+                {
+                    quint16 value = holding.value(key + i, static_cast<quint16>(Slave * 1000 + address + i));
+                    if (function == 4)
+                        value = static_cast<quint16>(10000 + Slave * 1000 + address + i);
+                    result.append(static_cast<char>(value >> 8));
+                    result.append(static_cast<char>(value & 0xff));
+                }
+                break;
+            }
+            case 5:
+                coils.insert(key, count == 0xff00);
+                return PDU;
+            case 6:
+                holding.insert(key, static_cast<quint16>(count));
+                return PDU;
+            case 16:
+                for (int i = 0; i < count; ++i)
+                    holding.insert(key + i, Get16(PDU, 6 + i * 2));
+                return PDU.left(5);
+            default:
+                result[0] = static_cast<char>(function | 0x80);
+                result.append(static_cast<char>(1));
+        }
+        return result;
+    }
+
+  private:
+    Q_DISABLE_COPY(TestModbusSimulator)
+    QTcpServer    m_server;
+    QTcpSocket   *m_socket;
+    QByteArray    m_buffer;
+    QElapsedTimer m_clock;
+};
+
+/// Records what the master reports, from the master thread.
+class TestModbusListener final : public TorcModbusListener
+{
+  public:
+    TestModbusListener()
+      : TorcModbusListener(),
+        m_lock(),
+        m_reads(0),
+        m_invalid(0),
+        m_values(),
+        m_writes(0),
+        m_failures(0),
+        m_written()
+    {
+    }
+
+    void ModbusValueRead(const QVector<quint16> &Values, bool Valid) override
+    {
+        QMutexLocker locker(&m_lock);
+        if (Valid)
+        {
+            m_reads++;
+            m_values = Values;
+        }
+        else
+        {
+            m_invalid++;
+        }
+    }
+
+    void ModbusValueWritten(const QVector<quint16> &Values, bool Success) override
+    {
+        QMutexLocker locker(&m_lock);
+        if (Success)
+        {
+            m_writes++;
+            m_written = Values;
+        }
+        else
+        {
+            m_failures++;
+        }
+    }
+
+    int              GetReads    (void) { QMutexLocker locker(&m_lock); return m_reads;    }
+    int              GetInvalid  (void) { QMutexLocker locker(&m_lock); return m_invalid;  }
+    QVector<quint16> GetValues   (void) { QMutexLocker locker(&m_lock); return m_values;   }
+    int              GetWrites   (void) { QMutexLocker locker(&m_lock); return m_writes;   }
+    int              GetFailures (void) { QMutexLocker locker(&m_lock); return m_failures; }
+    QVector<quint16> GetWritten  (void) { QMutexLocker locker(&m_lock); return m_written;  }
+
+  private:
+    QMutex           m_lock;
+    int              m_reads;
+    int              m_invalid;
+    QVector<quint16> m_values;
+    int              m_writes;
+    int              m_failures;
+    QVector<quint16> m_written;
+};
+
+void TestTorcModbus::testCRC(void)
+{
+    // the example frame from the Modbus serial line specification
+    QCOMPARE(TorcModbusMaster::CRC16(Bytes("01030000000a")), (quint16)0xcdc5);
+    QCOMPARE(TorcModbusMaster::EncodeRTU(1, Bytes("030000000a")), Bytes("01030000000ac5cd"));
+
+    // a frame followed by its CRC checks to zero
+    QCOMPARE(TorcModbusMaster::CRC16(Bytes("01030000000ac5cd")), (quint16)0);
+
+    // response lengths
+    QCOMPARE(TorcModbusMaster::GetRTULength(Bytes("01")),         0);
+    QCOMPARE(TorcModbusMaster::GetRTULength(Bytes("0103")),       0);
+    QCOMPARE(TorcModbusMaster::GetRTULength(Bytes("010304")),     9);
+    QCOMPARE(TorcModbusMaster::GetRTULength(Bytes("010101")),     6);
+    QCOMPARE(TorcModbusMaster::GetRTULength(Bytes("0106")),       8);
+    QCOMPARE(TorcModbusMaster::GetRTULength(Bytes("0110")),       8);
+    QCOMPARE(TorcModbusMaster::GetRTULength(Bytes("0183")),       5);
+    QCOMPARE(TorcModbusMaster::GetRTULength(Bytes("0141")),      -1);
+}
+
+void TestTorcModbus::testPDU(void)
+{
+    QCOMPARE(TorcModbusMaster::EncodeRead(TorcModbusMaster::Coil,     0x0013, 0x25), Bytes("0100130025"));
+    QCOMPARE(TorcModbusMaster::EncodeRead(TorcModbusMaster::Discrete, 0x00c4, 0x16), Bytes("0200c40016"));
+    QCOMPARE(TorcModbusMaster::EncodeRead(TorcModbusMaster::Holding,  0x006b, 3),    Bytes("03006b0003"));
+    QCOMPARE(TorcModbusMaster::EncodeRead(TorcModbusMaster::Input,    0x0008, 1),    Bytes("0400080001"));
+
+    QCOMPARE(TorcModbusMaster::EncodeWrite(TorcModbusMaster::Coil,    0x00ac, QVector<quint16>() << 1), Bytes("0500acff00"));
+    QCOMPARE(TorcModbusMaster::EncodeWrite(TorcModbusMaster::Coil,    0x00ac, QVector<quint16>() << 0), Bytes("0500ac0000"));
+    QCOMPARE(TorcModbusMaster::EncodeWrite(TorcModbusMaster::Holding, 0x0001, QVector<quint16>() << 3), Bytes("0600010003"));
+    QCOMPARE(TorcModbusMaster::EncodeWrite(TorcModbusMaster::Holding, 0x0001, QVector<quint16>() << 0x000a << 0x0102),
+             Bytes("100001000204000a0102"));
+
+    // read only tables, multiple coils and empty writes are not supported
+    QVERIFY(TorcModbusMaster::EncodeWrite(TorcModbusMaster::Input,    0, QVector<quint16>() << 1).isEmpty());
+    QVERIFY(TorcModbusMaster::EncodeWrite(TorcModbusMaster::Discrete, 0, QVector<quint16>() << 1).isEmpty());
+    QVERIFY(TorcModbusMaster::EncodeWrite(TorcModbusMaster::Coil,     0, QVector<quint16>() << 1 << 0).isEmpty());
+    QVERIFY(TorcModbusMaster::EncodeWrite(TorcModbusMaster::Holding,  0, QVector<quint16>()).isEmpty());
+
+    QVector<quint16> values;
+    int exception = 0;
+
+    // registers
+    QVERIFY(TorcModbusMaster::DecodeResponse(Bytes("03006b0003"), Bytes("0306022b00000064"), values, exception));
+    QCOMPARE(values, QVector<quint16>() << 0x022b << 0 << 0x64);
+
+    // bits, least significant first
+    QVERIFY(TorcModbusMaster::DecodeResponse(Bytes("0100130013"), Bytes("0103cd6b05"), values, exception));
+    QCOMPARE(values.size(), 19);
+    QCOMPARE(values.at(0), (quint16)1);
+    QCOMPARE(values.at(1), (quint16)0);
+    QCOMPARE(values.at(2), (quint16)1);
+    QCOMPARE(values.at(18), (quint16)1);
+
+    // writes are echoed
+    QVERIFY(TorcModbusMaster::DecodeResponse(Bytes("0500acff00"), Bytes("0500acff00"), values, exception));
+    QVERIFY(TorcModbusMaster::DecodeResponse(Bytes("100001000204000a0102"), Bytes("1000010002"), values, exception));
+    QVERIFY(!TorcModbusMaster::DecodeResponse(Bytes("0600010003"), Bytes("0600010004"), values, exception));
+
+    // exceptions, wrong functions and short responses
+    QVERIFY(!TorcModbusMaster::DecodeResponse(Bytes("03006b0003"), Bytes("8302"), values, exception));
+    QCOMPARE(exception, 2);
+    QVERIFY(!TorcModbusMaster::DecodeResponse(Bytes("03006b0003"), Bytes("0402022b"), values, exception));
+    QCOMPARE(exception, 0);
+    QVERIFY(!TorcModbusMaster::DecodeResponse(Bytes("03006b0003"), Bytes("0304022b0000"), values, exception));
+    QVERIFY(!TorcModbusMaster::DecodeResponse(Bytes("03006b0003"), QByteArray(), values, exception));
+
+    // TCP framing
+    QByteArray frame = TorcModbusMaster::EncodeTCP(0x1234, 17, Bytes("03006b0003"));
+    QCOMPARE(frame, Bytes("12340000000611" "03006b0003"));
+
+    QByteArray buffer = frame + frame.left(4);
+    quint16 id = 0;
+    int slave  = 0;
+    bool error = false;
+    QByteArray pdu;
+    QVERIFY(TorcModbusMaster::TakeTCPFrame(buffer, id, slave, pdu, error));
+    QCOMPARE(id, (quint16)0x1234);
+    QCOMPARE(slave, 17);
+    QCOMPARE(pdu, Bytes("03006b0003"));
+    QVERIFY(!TorcModbusMaster::TakeTCPFrame(buffer, id, slave, pdu, error));
+    QVERIFY(!error);
+    buffer.append(frame.mid(4));
+    QVERIFY(TorcModbusMaster::TakeTCPFrame(buffer, id, slave, pdu, error));
+    QVERIFY(buffer.isEmpty());
+
+    // not Modbus
+    buffer = Bytes("12340001000611" "03006b0003");
+    QVERIFY(!TorcModbusMaster::TakeTCPFrame(buffer, id, slave, pdu, error));
+    QVERIFY(error);
+}
+
+void TestTorcModbus::testCoalesce(void)
+{
+    typedef TorcModbusMaster::Range Range;
+    QList<Range> due;
+    due << Range { 1, TorcModbusMaster::Holding, 10, 1 }
+        << Range { 1, TorcModbusMaster::Holding,  0, 2 }
+        << Range { 1, TorcModbusMaster::Holding,  2, 2 }  // adjacent
+        << Range { 1, TorcModbusMaster::Holding,  1, 1 }  // overlapping
+        << Range { 1, TorcModbusMaster::Input,    4, 1 }  // different table
+        << Range { 2, TorcModbusMaster::Holding,  4, 1 }; // different slave
+
+    QList<Range> result = TorcModbusMaster::Coalesce(due, 0);
+    QCOMPARE(result.size(), 4);
+    QCOMPARE(result.at(0).slave, 1);
+    QVERIFY(result.at(0).table == TorcModbusMaster::Input);
+    QCOMPARE(result.at(1).address, 0);
+    QCOMPARE(result.at(1).count, 4);
+    QCOMPARE(result.at(2).address, 10);
+    QCOMPARE(result.at(2).count, 1);
+    QCOMPARE(result.at(3).slave, 2);
+
+    // reading a few unused registers saves a request
+    result = TorcModbusMaster::Coalesce(due, 6);
+    QCOMPARE(result.size(), 3);
+    QCOMPARE(result.at(1).address, 0);
+    QCOMPARE(result.at(1).count, 11);
+
+    // but a request cannot exceed the maximum read
+    due.clear();
+    due << Range { 1, TorcModbusMaster::Holding, 0, 100 } << Range { 1, TorcModbusMaster::Holding, 100, 25 }
+        << Range { 1, TorcModbusMaster::Holding, 125, 1 };
+    result = TorcModbusMaster::Coalesce(due, 0);
+    QCOMPARE(result.size(), 2);
+    QCOMPARE(result.at(0).count, MODBUS_MAX_REGISTERS);
+    QCOMPARE(result.at(1).address, 125);
+
+    due.clear();
+    due << Range { 1, TorcModbusMaster::Coil, 0, 1500 } << Range { 1, TorcModbusMaster::Coil, 1500, 500 };
+    QCOMPARE(TorcModbusMaster::Coalesce(due, 0).size(), 1);
+    due << Range { 1, TorcModbusMaster::Coil, 2000, 1 };
+    QCOMPARE(TorcModbusMaster::Coalesce(due, 0).size(), 2);
+}
+
+void TestTorcModbus::testDecode(void)
+{
+    typedef TorcModbusRegister R;
+    QCOMPARE(R::Decode(QVector<quint16>() << 0xffff, R::UInt16, false), 65535.0);
+    QCOMPARE(R::Decode(QVector<quint16>() << 0xffff, R::Int16,  false), -1.0);
+    QCOMPARE(R::Decode(QVector<quint16>() << 0x0001 << 0x0002, R::UInt32, false), 65538.0);
+    QCOMPARE(R::Decode(QVector<quint16>() << 0x0002 << 0x0001, R::UInt32, true),  65538.0);
+    QCOMPARE(R::Decode(QVector<quint16>() << 0xffff << 0xfffe, R::Int32,  false), -2.0);
+    QCOMPARE(R::Decode(QVector<quint16>() << 0x41c8 << 0x0000, R::Float32, false), 25.0);
+    QCOMPARE(R::Decode(QVector<quint16>() << 0x0000 << 0xc148, R::Float32, true), -12.5);
+    QCOMPARE(R::Decode(QVector<quint16>() << 0x41c8, R::Float32, false), 0.0);
+
+    R::Format format = R::UInt16;
+    QVERIFY(R::ParseFormat(QStringLiteral("float32"), format));
+    QVERIFY(format == R::Float32);
+    QVERIFY(!R::ParseFormat(QStringLiteral("float64"), format));
+
+    TorcModbusMaster::Table table = TorcModbusMaster::Holding;
+    QVERIFY(TorcModbusMaster::ParseTable(QStringLiteral("coil"), table));
+    QVERIFY(table == TorcModbusMaster::Coil);
+    QVERIFY(!TorcModbusMaster::ParseTable(QStringLiteral("register"), table));
+}
+
+void TestTorcModbus::testPolling(void)
+{
+    TestModbusSimulator simulator;
+    QVariantMap settings = simulator.Settings();
+    TorcModbusMaster *master = new TorcModbusMaster(TorcModbusMaster::GetConnection(false, settings), settings);
+
+    // registers added before the master starts are all due in its first pass
+    TestModbusListener first, second, third, input, coil;
+    QVERIFY(master->AddRegister(&first,  1, TorcModbusMaster::Holding, 0,  1, 60000));
+    QVERIFY(master->AddRegister(&second, 1, TorcModbusMaster::Holding, 1,  2, 60000));
+    QVERIFY(master->AddRegister(&third,  1, TorcModbusMaster::Holding, 10, 1, 60000));
+    QVERIFY(master->AddRegister(&input,  1, TorcModbusMaster::Input,   0,  1, 60000));
+    QVERIFY(master->AddRegister(&coil,   1, TorcModbusMaster::Coil,    3,  1, 60000));
+    QVERIFY(!master->AddRegister(&coil,  1, TorcModbusMaster::Holding, 0,  126));
+    QVERIFY(!master->AddRegister(&coil,  0, TorcModbusMaster::Holding, 0,  1));
+    master->start();
+
+    QTRY_COMPARE_WITH_TIMEOUT(first.GetReads(),  1, 5000);
+    QTRY_COMPARE_WITH_TIMEOUT(second.GetReads(), 1, 5000);
+    QTRY_COMPARE_WITH_TIMEOUT(third.GetReads(),  1, 5000);
+    QTRY_COMPARE_WITH_TIMEOUT(input.GetReads(),  1, 5000);
+    QTRY_COMPARE_WITH_TIMEOUT(coil.GetReads(),   1, 5000);
+    QCOMPARE(first.GetValues(),  QVector<quint16>() << 1000);
+    QCOMPARE(second.GetValues(), QVector<quint16>() << 1001 << 1002);
+    QCOMPARE(third.GetValues(),  QVector<quint16>() << 1010);
+    QCOMPARE(input.GetValues(),  QVector<quint16>() << 11000);
+    QCOMPARE(coil.GetValues(),   QVector<quint16>() << 1);
+
+    // the first two are read together
+    QCOMPARE(simulator.requests.size(), 4);
+    QVERIFY(simulator.requests.contains(TorcModbusMaster::EncodeRead(TorcModbusMaster::Holding, 0, 3)));
+    QVERIFY(simulator.requests.contains(TorcModbusMaster::EncodeRead(TorcModbusMaster::Holding, 10, 1)));
+
+    QVariantMap statistics = master->GetStatistics();
+    QCOMPARE(statistics.value(QStringLiteral("requests")).toInt(), 4);
+    QCOMPARE(statistics.value(QStringLiteral("registersRead")).toInt(), 6);
+    QCOMPARE(statistics.value(QStringLiteral("errors")).toInt(), 0);
+
+    delete master;
+
+    // masters are shared by connection
+    TorcModbusMaster *shared = TorcModbusMaster::Acquire(TorcModbusMaster::GetConnection(false, settings), settings);
+    QCOMPARE(TorcModbusMaster::Acquire(TorcModbusMaster::GetConnection(false, settings), settings), shared);
+    TorcModbusMaster::Release(shared);
+    TorcModbusMaster::Release(shared);
+
+    // a slave exception invalidates the register
+    master = new TorcModbusMaster(TorcModbusMaster::GetConnection(false, settings), settings);
+    TestModbusListener bad;
+    QVERIFY(master->AddRegister(&bad, 1, TorcModbusMaster::Holding, 9500, 1, 60000));
+    master->start();
+    QTRY_COMPARE_WITH_TIMEOUT(bad.GetInvalid(), 1, 5000);
+    QCOMPARE(bad.GetReads(), 0);
+    QCOMPARE(master->GetStatistics().value(QStringLiteral("errors")).toInt(), 1);
+    delete master;
+}
+
+void TestTorcModbus::testPipelining(void)
+{
+    TestModbusSimulator simulator;
+    simulator.delay = 100;
+    QVariantMap settings = simulator.Settings(4);
+    TorcModbusMaster *master = new TorcModbusMaster(TorcModbusMaster::GetConnection(false, settings), settings);
+
+    // one register on each of 4 slaves cannot be merged
+    TestModbusListener listeners[4];
+    for (int i = 0; i < 4; ++i)
+        QVERIFY(master->AddRegister(&listeners[i], i + 1, TorcModbusMaster::Holding, 0, 1, 60000));
+
+    QElapsedTimer timer;
+    timer.start();
+    master->start();
+    for (int i = 0; i < 4; ++i)
+        QTRY_COMPARE_WITH_TIMEOUT(listeners[i].GetReads(), 1, 5000);
+    QCOMPARE(listeners[3].GetValues(), QVector<quint16>() << 4000);
+
+    // all 4 requests were outstanding at once
+    QCOMPARE(simulator.Reads(), 4);
+    QCOMPARE(simulator.maxOutstanding, 4);
+    QCOMPARE(master->GetStatistics().value(QStringLiteral("maxOutstanding")).toInt(), 4);
+    delete master;
+
+    // without pipelining, each request waits for the last response
+    TestModbusSimulator serial;
+    serial.delay = 100;
+    settings = serial.Settings(1);
+    master = new TorcModbusMaster(TorcModbusMaster::GetConnection(false, settings), settings);
+    TestModbusListener others[4];
+    for (int i = 0; i < 4; ++i)
+        QVERIFY(master->AddRegister(&others[i], i + 1, TorcModbusMaster::Holding, 0, 1, 60000));
+    master->start();
+    for (int i = 0; i < 4; ++i)
+        QTRY_COMPARE_WITH_TIMEOUT(others[i].GetReads(), 1, 5000);
+    QCOMPARE(serial.maxOutstanding, 1);
+    QCOMPARE(master->GetStatistics().value(QStringLiteral("maxOutstanding")).toInt(), 1);
+    delete master;
+}
+
+void TestTorcModbus::testRateLimit(void)
+{
+    // 10 requests per second per slave
+    TestModbusSimulator simulator;
+    QVariantMap settings = simulator.Settings(4, 10);
+    TorcModbusMaster *master = new TorcModbusMaster(TorcModbusMaster::GetConnection(false, settings), settings);
+
+    TestModbusListener first, second, third, other;
+    QVERIFY(master->AddRegister(&first,  1, TorcModbusMaster::Holding, 0,   1, 60000));
+    QVERIFY(master->AddRegister(&second, 1, TorcModbusMaster::Holding, 50,  1, 60000));
+    QVERIFY(master->AddRegister(&third,  1, TorcModbusMaster::Holding, 100, 1, 60000));
+    QVERIFY(master->AddRegister(&other,  2, TorcModbusMaster::Holding, 0,   1, 60000));
+    master->start();
+
+    QTRY_COMPARE_WITH_TIMEOUT(third.GetReads(), 1, 5000);
+    QTRY_COMPARE_WITH_TIMEOUT(other.GetReads(), 1, 5000);
+    QCOMPARE(simulator.requests.size(), 4);
+
+    // requests to slave 1 are spaced out (allowing for timer jitter)...
+    QList<qint64> times;
+    for (int i = 0; i < simulator.slaves.size(); ++i)
+        if (simulator.slaves.at(i) == 1)
+            times.append(simulator.times.at(i));
+    QCOMPARE(times.size(), 3);
+    QVERIFY2(times.at(1) - times.at(0) >= 80, qPrintable(QStringLiteral("%1ms").arg(times.at(1) - times.at(0))));
+    QVERIFY2(times.at(2) - times.at(1) >= 80, qPrintable(QStringLiteral("%1ms").arg(times.at(2) - times.at(1))));
+
+    // ...but slave 2 does not wait for them
+    QVERIFY(simulator.slaves.indexOf(2) < 2);
+    delete master;
+}
+
+void TestTorcModbus::testWrite(void)
+{
+    TestModbusSimulator simulator;
+    QVariantMap settings = simulator.Settings();
+    TorcModbusMaster *master = new TorcModbusMaster(TorcModbusMaster::GetConnection(false, settings), settings);
+    TestModbusListener listener;
+
+    // writes to the same register are coalesced until they are sent
+    QVERIFY(master->Write(&listener, 1, TorcModbusMaster::Holding, 20, QVector<quint16>() << 1));
+    QVERIFY(master->Write(&listener, 1, TorcModbusMaster::Holding, 20, QVector<quint16>() << 2));
+    QVERIFY(master->Write(&listener, 1, TorcModbusMaster::Holding, 20, QVector<quint16>() << 3));
+    QVERIFY(!master->Write(&listener, 1, TorcModbusMaster::Input,  20, QVector<quint16>() << 3));
+    QCOMPARE(master->GetStatistics().value(QStringLiteral("coalescedWrites")).toInt(), 2);
+
+    master->start();
+    QTRY_COMPARE_WITH_TIMEOUT(listener.GetWrites(), 1, 5000);
+    QCOMPARE(listener.GetWritten(), QVector<quint16>() << 3);
+    QCOMPARE(simulator.requests.size(), 1);
+    QCOMPARE(simulator.holding.value((1 << 16) | 20), (quint16)3);
+
+    // a value that the slave already holds is not written again
+    QVERIFY(master->Write(&listener, 1, TorcModbusMaster::Holding, 20, QVector<quint16>() << 3));
+    QTest::qWait(100);
+    QCOMPARE(simulator.requests.size(), 1);
+
+    // coils and multiple registers
+    QVERIFY(master->Write(&listener, 2, TorcModbusMaster::Coil, 5, QVector<quint16>() << 1));
+    QTRY_COMPARE_WITH_TIMEOUT(listener.GetWrites(), 2, 5000);
+    QVERIFY(simulator.coils.value((2 << 16) | 5));
+    QVERIFY(master->Write(&listener, 2, TorcModbusMaster::Holding, 30, QVector<quint16>() << 7 << 8));
+    QTRY_COMPARE_WITH_TIMEOUT(listener.GetWrites(), 3, 5000);
+    QCOMPARE(simulator.requests.last(), TorcModbusMaster::EncodeWrite(TorcModbusMaster::Holding, 30, QVector<quint16>() << 7 << 8));
+
+    // and read back
+    TestModbusListener reader;
+    QVERIFY(master->AddRegister(&reader, 2, TorcModbusMaster::Holding, 30, 2, 60000));
+    QTRY_COMPARE_WITH_TIMEOUT(reader.GetReads(), 1, 5000);
+    QCOMPARE(reader.GetValues(), QVector<quint16>() << 7 << 8);
+
+    // a rejected write is reported
+    QVERIFY(master->Write(&listener, 1, TorcModbusMaster::Holding, 9500, QVector<quint16>() << 1));
+    QTRY_COMPARE_WITH_TIMEOUT(listener.GetFailures(), 1, 5000);
+
+    // writes queued without a listener are still made before the master stops
+    int requests = simulator.requests.size();
+    master->RemoveListener(&listener);
+    QVERIFY(master->Write(nullptr, 1, TorcModbusMaster::Holding, 21, QVector<quint16>() << 9));
+    QTRY_COMPARE_WITH_TIMEOUT(simulator.requests.size(), requests + 1, 5000);
+    QCOMPARE(simulator.holding.value((1 << 16) | 21), (quint16)9);
+    delete master;
+}
@@ -0,0 +1,21 @@
+#ifndef TESTTORCMODBUS_H
+#define TESTTORCMODBUS_H
+
+#include <QObject>
+
+class TestTorcModbus : public QObject
+{
+    Q_OBJECT
+
+  private slots:
+    void testCRC(void);
+    void testPDU(void);
+    void testCoalesce(void);
+    void testDecode(void);
+    void testPolling(void);
+    void testPipelining(void);
+    void testRateLimit(void);
+    void testWrite(void);
+};
+
+#endif // TESTTORCMODBUS_H
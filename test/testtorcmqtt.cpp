@@ -0,0 +1,371 @@
+// Qt
+#include <QtTest/QtTest>
+#include <QTcpServer>
+#include <QTcpSocket>
+
+// Torc
+#include "torcmqttclient.h"
+#include "torcmqttbridge.h"
+#include "testtorcmqtt.h"
+
+/// A broker stand-in that accepts a single client at a time and records what it is sent.
+class TestMQTTBroker
+{
+  public:
+    class Publish
+    {
+      public:
+        QString     topic;
+        QByteArray  payload;
+        int         qos;
+        quint16     id;
+        bool        duplicate;
+    };
+
+    TestMQTTBroker()
+      : holdAcks(false),
+        connects(0),
+        lastFlags(0),
+        clientIds(),
+        subscriptions(),
+        publishes(),
+        held(),
+        released(0),
+        acks(),
+        m_server(),
+        m_socket(nullptr),
+        m_buffer(),
+        m_sessions()
+    {
+        QObject::connect(&m_server, &QTcpServer::newConnection, &m_server, [this]() { Accept(); });
+        m_server.listen(QHostAddress::LocalHost);
+    }
+
+    quint16 Port(void) const
+    {
+        return m_server.serverPort();
+    }
+
+    void Send(const QByteArray &Data)
+    {
+        if (m_socket)
+            m_socket->write(Data);
+    }
+
+    void Drop(void)
+    {
+        if (m_socket)
+            m_socket->abort();
+    }
+
+    void Release(void)
+    {
+        foreach (quint16 id, held)
+            Send(TorcMQTTClient::EncodePacket(TorcMQTTClient::PubAck << 4, TorcMQTTClient::EncodeId(id)));
+        held.clear();
+    }
+
+  public:
+    bool           holdAcks;
+    int            connects;
+    quint8         lastFlags;
+    QStringList    clientIds;
+    QStringList    subscriptions;
+    QList<Publish> publishes;
+    QList<quint16> held;
+    int            released;
+    QList<quint16> acks;
+
+  private:
+    void Accept(void)
+    {
+        QTcpSocket *socket = m_server.nextPendingConnection();
+        if (m_socket)
+            m_socket->deleteLater();
+        m_socket = socket;
+        m_buffer.clear();
+        QObject::connect(socket, &QTcpSocket::readyRead, &m_server, [this, socket]() { if (socket == m_socket) Read(); });
+    }
+
+    void Read(void)
+    {
+        m_buffer.append(m_socket->readAll());
+        quint8 header = 0;
+        QByteArray body;
+        bool error = false;
+        while (TorcMQTTClient::TakePacket(m_buffer, header, body, error))
+            Handle(header, body);
+    }
+
+    void Handle(quint8 Header, const QByteArray &Body)
+    {
+        quint16 id = Body.size() >= 2 ? (quint16)(((quint8)Body.at(0) << 8) | (quint8)Body.at(1)) : 0;
+        switch (Header >> 4)
+        {
+            case TorcMQTTClient::Connect:
+            {
+                connects++;
+                lastFlags = (quint8)Body.at(7);
+                int length = ((quint8)Body.at(10) << 8) | (quint8)Body.at(11);
+                QString clientid = QString::fromUtf8(Body.mid(12, length));
+                clientIds.append(clientid);
+                bool present = !(lastFlags & 0x02) && m_sessions.contains(clientid);
+                m_sessions.insert(clientid);
+                QByteArray ack;
+                ack.append((char)(present ? 1 : 0));
+                ack.append((char)0);
+                Send(TorcMQTTClient::EncodePacket(TorcMQTTClient::ConnAck << 4, ack));
+                break;
+            }
+            case TorcMQTTClient::Publish:
+            {
+                Publish publish;
+                publish.qos       = (Header >> 1) & 0x03;
+                publish.duplicate = Header & 0x08;
+                int length        = ((quint8)Body.at(0) << 8) | (quint8)Body.at(1);
+                publish.topic     = QString::fromUtf8(Body.mid(2, length));
+                publish.id        = publish.qos ? (quint16)(((quint8)Body.at(2 + length) << 8) | (quint8)Body.at(3 + length)) : 0;
+                publish.payload   = Body.mid(2 + length + (publish.qos ? 2 : 0));
+                publishes.append(publish);
+                if (publish.qos == 1)
+                {
+                    if (holdAcks)
+                        held.append(publish.id);
+                    else
+                        Send(TorcMQTTClient::EncodePacket(TorcMQTTClient::PubAck << 4, TorcMQTTClient::EncodeId(publish.id)));
+                }
+                else if (publish.qos == 2)
+                {
+                    Send(TorcMQTTClient::EncodePacket(TorcMQTTClient::PubRec << 4, TorcMQTTClient::EncodeId(publish.id)));
+                }
+                break;
+            }
+            case TorcMQTTClient::PubRel:
+                released++;
+                Send(TorcMQTTClient::EncodePacket(TorcMQTTClient::PubComp << 4, TorcMQTTClient::EncodeId(id)));
+                break;
+            case TorcMQTTClient::PubAck:
+            case TorcMQTTClient::PubRec:
+                acks.append(id);
+                if ((Header >> 4) == TorcMQTTClient::PubRec)
+                    Send(TorcMQTTClient::EncodePacket((TorcMQTTClient::PubRel << 4) | 0x02, TorcMQTTClient::EncodeId(id)));
+                break;
+            case TorcMQTTClient::Subscribe:
+            {
+                QByteArray codes = TorcMQTTClient::EncodeId(id);
+                int position = 2;
+                while (position + 2 < Body.size())
+                {
+                    int length = ((quint8)Body.at(position) << 8) | (quint8)Body.at(position + 1);
+                    subscriptions.append(QString::fromUtf8(Body.mid(position + 2, length)));
+                    codes.append(Body.at(position + 2 + length));
+                    position += 3 + length;
+                }
+                Send(TorcMQTTClient::EncodePacket(TorcMQTTClient::SubAck << 4, codes));
+                break;
+            }
+            case TorcMQTTClient::PingReq:
+                Send(TorcMQTTClient::EncodePacket(TorcMQTTClient::PingResp << 4, QByteArray()));
+                break;
+            default:
+                break;
+        }
+    }
+
+  private:
+    Q_DISABLE_COPY(TestMQTTBroker)
+    QTcpServer     m_server;
+    QTcpSocket    *m_socket;
+    QByteArray     m_buffer;
+    QSet<QString>  m_sessions;
+};
+
+static QByteArray PublishPacket(const QString &Topic, const QByteArray &Payload, int QoS, quint16 Id, bool Duplicate = false)
+{
+    QByteArray body;
+    TorcMQTTClient::AppendString(body, Topic.toUtf8());
+    if (QoS > 0)
+        body.append(TorcMQTTClient::EncodeId(Id));
+    body.append(Payload);
+    return TorcMQTTClient::EncodePacket((TorcMQTTClient::Publish << 4) | (QoS << 1) | (Duplicate ? 0x08 : 0x00), body);
+}
+
+void TestTorcMQTT::testFraming(void)
+{
+    // remaining length boundaries
+    QCOMPARE(TorcMQTTClient::EncodePacket(0xC0, QByteArray()), QByteArray("\xC0\x00", 2));
+    QCOMPARE(TorcMQTTClient::EncodePacket(0x30, QByteArray(127, 'x')).mid(1, 1), QByteArray("\x7F", 1));
+    QCOMPARE(TorcMQTTClient::EncodePacket(0x30, QByteArray(128, 'x')).mid(1, 2), QByteArray("\x80\x01", 2));
+    QCOMPARE(TorcMQTTClient::EncodePacket(0x30, QByteArray(16384, 'x')).mid(1, 3), QByteArray("\x80\x80\x01", 3));
+
+    // complete and partial packets
+    QByteArray buffer = TorcMQTTClient::EncodePacket(0x30, QByteArray(200, 'a')) + TorcMQTTClient::EncodePacket(0xD0, QByteArray());
+    QByteArray partial = buffer.left(100);
+    quint8 header = 0;
+    QByteArray body;
+    bool error = true;
+    QVERIFY(!TorcMQTTClient::TakePacket(partial, header, body, error));
+    QVERIFY(!error);
+    QCOMPARE(partial.size(), 100);
+
+    QVERIFY(TorcMQTTClient::TakePacket(buffer, header, body, error));
+    QCOMPARE(header, (quint8)0x30);
+    QCOMPARE(body, QByteArray(200, 'a'));
+    QVERIFY(TorcMQTTClient::TakePacket(buffer, header, body, error));
+    QCOMPARE(header, (quint8)0xD0);
+    QVERIFY(body.isEmpty());
+    QVERIFY(buffer.isEmpty());
+
+    // a remaining length of more than 4 bytes is malformed
+    QByteArray malformed("\x30\xFF\xFF\xFF\xFF\x01", 6);
+    QVERIFY(!TorcMQTTClient::TakePacket(malformed, header, body, error));
+    QVERIFY(error);
+}
+
+void TestTorcMQTT::testPayload(void)
+{
+    double value = -1.0;
+    QVERIFY(TorcMQTTBridge::ParsePayload(QByteArray("21.5"), value));
+    QCOMPARE(value, 21.5);
+    QVERIFY(TorcMQTTBridge::ParsePayload(QByteArray(" on\n"), value));
+    QCOMPARE(value, 1.0);
+    QVERIFY(TorcMQTTBridge::ParsePayload(QByteArray("FALSE"), value));
+    QCOMPARE(value, 0.0);
+    QVERIFY(TorcMQTTBridge::ParsePayload(QByteArray("{\"value\": 7.2, \"unit\": \"pH\"}"), value));
+    QCOMPARE(value, 7.2);
+    QVERIFY(!TorcMQTTBridge::ParsePayload(QByteArray("warm"), value));
+    QVERIFY(!TorcMQTTBridge::ParsePayload(QByteArray("nan"), value));
+    QVERIFY(!TorcMQTTBridge::ParsePayload(QByteArray("{\"value\": \"7\"}"), value));
+}
+
+void TestTorcMQTT::testPublishBatching(void)
+{
+    TestMQTTBroker broker;
+    TorcMQTTClient client(QStringLiteral("127.0.0.1"), broker.Port(), QStringLiteral("test-batch"), 0);
+    client.Start();
+    QTRY_VERIFY_WITH_TIMEOUT(client.IsConnected(), 5000);
+
+    // everything published before returning to the event loop is sent in one write
+    quint64 writes = client.GetWrites();
+    client.PublishMessage(QStringLiteral("torc/a"), QByteArray("1"), 0, false);
+    client.PublishMessage(QStringLiteral("torc/b"), QByteArray("2"), 0, false);
+    client.PublishMessage(QStringLiteral("torc/a"), QByteArray("3"), 0, false);
+    client.PublishMessage(QStringLiteral("torc/c"), QByteArray("4"), 1, true);
+    QCOMPARE(client.GetQueued(), 3);
+    QCOMPARE(client.GetCoalesced(), (quint64)1);
+
+    QTRY_COMPARE_WITH_TIMEOUT(broker.publishes.size(), 3, 5000);
+    QCOMPARE(client.GetWrites(), writes + 1);
+    QCOMPARE(client.GetPublished(), (quint64)3);
+    QCOMPARE(broker.publishes.at(0).topic, QStringLiteral("torc/a"));
+    QCOMPARE(broker.publishes.at(0).payload, QByteArray("3"));
+    QCOMPARE(broker.publishes.at(1).topic, QStringLiteral("torc/b"));
+    QCOMPARE(broker.publishes.at(2).topic, QStringLiteral("torc/c"));
+    QCOMPARE(broker.publishes.at(2).qos, 1);
+    QTRY_COMPARE_WITH_TIMEOUT(client.GetInFlight(), 0, 5000);
+}
+
+void TestTorcMQTT::testInFlightWindow(void)
+{
+    TestMQTTBroker broker;
+    broker.holdAcks = true;
+    TorcMQTTClient client(QStringLiteral("127.0.0.1"), broker.Port(), QStringLiteral("test-window"), 0, 2);
+    client.Start();
+    QTRY_VERIFY_WITH_TIMEOUT(client.IsConnected(), 5000);
+
+    for (int i = 0; i < 5; ++i)
+        client.PublishMessage(QStringLiteral("torc/%1").arg(i), QByteArray::number(i), 1, false);
+    // QoS 0 is not held back by the window
+    client.PublishMessage(QStringLiteral("torc/event"), QByteArray("x"), 0, false);
+
+    QTRY_COMPARE_WITH_TIMEOUT(broker.publishes.size(), 3, 5000);
+    QTest::qWait(50);
+    QCOMPARE(broker.publishes.size(), 3);
+    QCOMPARE(client.GetInFlight(), 2);
+    QCOMPARE(client.GetQueued(), 3);
+
+    broker.holdAcks = false;
+    broker.Release();
+    QTRY_COMPARE_WITH_TIMEOUT(broker.publishes.size(), 6, 5000);
+    QTRY_COMPARE_WITH_TIMEOUT(client.GetInFlight(), 0, 5000);
+    QCOMPARE(client.GetQueued(), 0);
+
+    QStringList topics;
+    foreach (const TestMQTTBroker::Publish &publish, broker.publishes)
+        if (publish.qos == 1)
+            topics.append(publish.topic);
+    QCOMPARE(topics, QStringList() << "torc/0" << "torc/1" << "torc/2" << "torc/3" << "torc/4");
+}
+
+void TestTorcMQTT::testQoS2(void)
+{
+    TestMQTTBroker broker;
+    TorcMQTTClient client(QStringLiteral("127.0.0.1"), broker.Port(), QStringLiteral("test-qos2"), 0);
+    client.Start();
+    QTRY_VERIFY_WITH_TIMEOUT(client.IsConnected(), 5000);
+
+    client.PublishMessage(QStringLiteral("torc/exact"), QByteArray("1"), 2, false);
+    QTRY_COMPARE_WITH_TIMEOUT(broker.released, 1, 5000);
+    QTRY_COMPARE_WITH_TIMEOUT(client.GetInFlight(), 0, 5000);
+    QCOMPARE(broker.publishes.size(), 1);
+}
+
+void TestTorcMQTT::testSubscribe(void)
+{
+    TestMQTTBroker broker;
+    TorcMQTTClient client(QStringLiteral("127.0.0.1"), broker.Port(), QStringLiteral("test-subscribe"), 0);
+    QList<QPair<QString,QByteArray> > received;
+    QObject::connect(&client, &TorcMQTTClient::MessageReceived, &client, [&received](const QString &Topic, const QByteArray &Payload)
+    {
+        received.append(qMakePair(Topic, Payload));
+    });
+    client.AddSubscription(QStringLiteral("garden/temperature"), 1);
+    client.AddSubscription(QStringLiteral("garden/ph"), 2);
+    client.Start();
+    QTRY_COMPARE_WITH_TIMEOUT(broker.subscriptions.size(), 2, 5000);
+    QVERIFY(broker.subscriptions.contains(QStringLiteral("garden/temperature")));
+
+    broker.Send(PublishPacket(QStringLiteral("garden/temperature"), QByteArray("21.5"), 1, 7));
+    QTRY_COMPARE_WITH_TIMEOUT(received.size(), 1, 5000);
+    QCOMPARE(received.at(0).first, QStringLiteral("garden/temperature"));
+    QCOMPARE(received.at(0).second, QByteArray("21.5"));
+    QTRY_COMPARE_WITH_TIMEOUT(broker.acks, QList<quint16>() << 7, 5000);
+
+    // a resent QoS 2 message is delivered once
+    broker.Send(PublishPacket(QStringLiteral("garden/ph"), QByteArray("7.1"), 2, 8));
+    broker.Send(PublishPacket(QStringLiteral("garden/ph"), QByteArray("7.1"), 2, 8, true));
+    QTRY_COMPARE_WITH_TIMEOUT(broker.acks, QList<quint16>() << 7 << 8 << 8, 5000);
+    QCOMPARE(received.size(), 2);
+    QCOMPARE(received.at(1).second, QByteArray("7.1"));
+}
+
+void TestTorcMQTT::testReconnect(void)
+{
+    TestMQTTBroker broker;
+    broker.holdAcks = true;
+    TorcMQTTClient client(QStringLiteral("127.0.0.1"), broker.Port(), QStringLiteral("test-reconnect"), 0);
+    client.SetReconnectDelay(20, 100);
+    client.AddSubscription(QStringLiteral("garden/temperature"), 1);
+    client.Start();
+    QTRY_VERIFY_WITH_TIMEOUT(client.IsConnected(), 5000);
+    QTRY_COMPARE_WITH_TIMEOUT(broker.subscriptions.size(), 1, 5000);
+    QVERIFY(!(broker.lastFlags & 0x02)); // persistent session
+
+    client.PublishMessage(QStringLiteral("torc/heating"), QByteArray("1"), 1, true);
+    QTRY_COMPARE_WITH_TIMEOUT(broker.publishes.size(), 1, 5000);
+    quint16 id = broker.publishes.at(0).id;
+    broker.held.clear();
+
+    // the unacknowledged message is resent when the session resumes - and the subscription is not repeated
+    broker.holdAcks = false;
+    broker.Drop();
+    QTRY_COMPARE_WITH_TIMEOUT(broker.connects, 2, 5000);
+    QTRY_COMPARE_WITH_TIMEOUT(broker.publishes.size(), 2, 5000);
+    QCOMPARE(broker.clientIds, QStringList() << "test-reconnect" << "test-reconnect");
+    QVERIFY(broker.publishes.at(1).duplicate);
+    QCOMPARE(broker.publishes.at(1).id, id);
+    QCOMPARE(broker.publishes.at(1).topic, QStringLiteral("torc/heating"));
+    QTRY_COMPARE_WITH_TIMEOUT(client.GetInFlight(), 0, 5000);
+    QTRY_VERIFY_WITH_TIMEOUT(client.IsConnected(), 5000);
+    QCOMPARE(broker.subscriptions.size(), 1);
+}
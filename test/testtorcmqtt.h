@@ -0,0 +1,20 @@
+#ifndef TESTTORCMQTT_H
+#define TESTTORCMQTT_H
+
+#include <QObject>
+
+class TestTorcMQTT : public QObject
+{
+    Q_OBJECT
+
+  private slots:
+    void testFraming(void);
+    void testPayload(void);
+    void testPublishBatching(void);
+    void testInFlightWindow(void);
+    void testQoS2(void);
+    void testSubscribe(void);
+    void testReconnect(void);
+};
+
+#endif // TESTTORCMQTT_H
@@ -0,0 +1,232 @@
+// Qt
+#include <QtTest/QtTest>
+#include <QMutex>
+
+// Torc
+#include "torcoutputqueue.h"
+#include "testtorchelpers.h"
+#include "testtorcoutputqueue.h"
+
+// std
+#include <thread>
+
+// records every write and acknowledgement - and can stall the queue thread mid-write
+class TestQueueTarget final : public TorcOutputQueueTarget, public TestTorcBlocker
+{
+  public:
+    TestQueueTarget(int Id, QList<int> *Log, QMutex *LogLock, bool Fail = false)
+      : TorcOutputQueueTarget(),
+        TestTorcBlocker(),
+        m_id(Id),
+        m_fail(Fail),
+        m_log(Log),
+        m_logLock(LogLock),
+        m_lock(),
+        m_values(),
+        m_acknowledged()
+    {
+    }
+
+    bool ApplyValue(double Value) override
+    {
+        {
+            QMutexLocker locker(m_logLock);
+            m_log->append(m_id);
+        }
+
+        {
+            QMutexLocker locker(&m_lock);
+            m_values.append(Value);
+        }
+
+        Block();
+        return !m_fail;
+    }
+
+    void ValueApplied(double Value, bool Success) override
+    {
+        QMutexLocker locker(&m_lock);
+        m_acknowledged.append(qMakePair(Value, Success));
+    }
+
+    QList<double> Values(void)
+    {
+        QMutexLocker locker(&m_lock);
+        return m_values;
+    }
+
+    QList<QPair<double,bool> > Acknowledged(void)
+    {
+        QMutexLocker locker(&m_lock);
+        return m_acknowledged;
+    }
+
+  private:
+    Q_DISABLE_COPY(TestQueueTarget)
+    int            m_id;
+    bool           m_fail;
+    QList<int>    *m_log;
+    QMutex        *m_logLock;
+    QMutex         m_lock;
+    QList<double>  m_values;
+    QList<QPair<double,bool> > m_acknowledged;
+};
+
+void TestTorcOutputQueue::testLatestValue(void)
+{
+    QMutex lock;
+    QList<int> log;
+    TestQueueTarget blocker(0, &log, &lock);
+    TestQueueTarget target(1, &log, &lock);
+    TorcOutputQueue queue(QStringLiteral("test"));
+    queue.start();
+
+    // stall the queue, then update the target repeatedly - only the last value is written
+    blocker.Hold();
+    queue.Post(&blocker, 1.0);
+    QVERIFY(blocker.WaitUntilBlocked());
+    for (int i = 1; i <= 100; ++i)
+        queue.Post(&target, i / 100.0);
+    blocker.Release();
+    queue.Flush();
+
+    QCOMPARE(target.Values().size(), 1);
+    QCOMPARE(target.Values().at(0), 1.0);
+    QCOMPARE(target.Acknowledged().size(), 1);
+    QVERIFY(target.Acknowledged().at(0).second);
+
+    QVariantMap statistics = queue.GetStatistics();
+    QCOMPARE(statistics.value(QStringLiteral("posted")).toULongLong(), (qulonglong)101);
+    QCOMPARE(statistics.value(QStringLiteral("writes")).toULongLong(), (qulonglong)2);
+    QCOMPARE(statistics.value(QStringLiteral("coalesced")).toULongLong(), (qulonglong)99);
+    QVERIFY(statistics.value(QStringLiteral("latencyMax")).toLongLong() >= 0);
+}
+
+void TestTorcOutputQueue::testOrder(void)
+{
+    QMutex lock;
+    QList<int> log;
+    TestQueueTarget blocker(0, &log, &lock);
+    TestQueueTarget first(1, &log, &lock);
+    TestQueueTarget second(2, &log, &lock);
+    TestQueueTarget third(3, &log, &lock);
+    TorcOutputQueue queue(QStringLiteral("test"));
+    queue.start();
+
+    // outputs are written in the order they were first updated, even if updated again later
+    blocker.Hold();
+    queue.Post(&blocker, 1.0);
+    QVERIFY(blocker.WaitUntilBlocked());
+    queue.Post(&second, 1.0);
+    queue.Post(&first, 1.0);
+    queue.Post(&third, 1.0);
+    queue.Post(&second, 0.5);
+    blocker.Release();
+    queue.Flush();
+
+    QCOMPARE(log, QList<int>() << 0 << 2 << 1 << 3);
+    QCOMPARE(second.Values(), QList<double>() << 0.5);
+}
+
+void TestTorcOutputQueue::testDuplicates(void)
+{
+    QMutex lock;
+    QList<int> log;
+    TestQueueTarget blocker(0, &log, &lock);
+    TestQueueTarget target(1, &log, &lock);
+    TorcOutputQueue queue(QStringLiteral("test"));
+    queue.start();
+
+    queue.Post(&target, 1.0);
+    queue.Flush();
+
+    // the same value again is not written
+    queue.Post(&target, 1.0);
+    queue.Flush();
+    QCOMPARE(target.Values().size(), 1);
+
+    // a change that is reverted before it is written is dropped
+    blocker.Hold();
+    queue.Post(&blocker, 1.0);
+    QVERIFY(blocker.WaitUntilBlocked());
+    queue.Post(&target, 0.0);
+    queue.Post(&target, 1.0);
+    blocker.Release();
+    queue.Flush();
+    QCOMPARE(target.Values().size(), 1);
+
+    // but a revert to the applied value while a change is being written is not
+    target.Hold();
+    queue.Post(&target, 0.0);
+    QVERIFY(target.WaitUntilBlocked());
+    queue.Post(&target, 1.0);
+    target.Release();
+    queue.Flush();
+    QCOMPARE(target.Values(), QList<double>() << 1.0 << 0.0 << 1.0);
+}
+
+void TestTorcOutputQueue::testErrors(void)
+{
+    QMutex lock;
+    QList<int> log;
+    TestQueueTarget target(1, &log, &lock, true);
+    TorcOutputQueue queue(QStringLiteral("test"));
+    queue.start();
+
+    // a failed write is acknowledged as such and retried on the next update
+    queue.Post(&target, 1.0);
+    queue.Flush();
+    queue.Post(&target, 1.0);
+    queue.Flush();
+
+    QCOMPARE(target.Values().size(), 2);
+    QCOMPARE(target.Acknowledged().size(), 2);
+    QVERIFY(!target.Acknowledged().at(0).second);
+    QCOMPARE(queue.GetStatistics().value(QStringLiteral("errors")).toULongLong(), (qulonglong)2);
+}
+
+void TestTorcOutputQueue::testRemove(void)
+{
+    QMutex lock;
+    QList<int> log;
+    TestQueueTarget blocker(0, &log, &lock);
+    TestQueueTarget target(1, &log, &lock);
+    TorcOutputQueue queue(QStringLiteral("test"));
+    queue.start();
+
+    // pending values are discarded
+    blocker.Hold();
+    queue.Post(&blocker, 1.0);
+    QVERIFY(blocker.WaitUntilBlocked());
+    queue.Post(&target, 1.0);
+    queue.Remove(&target);
+    blocker.Release();
+    queue.Flush();
+    QCOMPARE(target.Values().size(), 0);
+
+    // and a write in progress completes before Remove returns
+    blocker.Hold();
+    queue.Post(&blocker, 0.0);
+    QVERIFY(blocker.WaitUntilBlocked());
+    std::thread release([&blocker]() { QThread::msleep(50); blocker.Release(); });
+    queue.Remove(&blocker);
+    QCOMPARE(blocker.Acknowledged().size(), 2);
+    release.join();
+}
+
+void TestTorcOutputQueue::testShared(void)
+{
+    TorcOutputQueue *first  = TorcOutputQueue::Acquire(QStringLiteral("shared"));
+    TorcOutputQueue *second = TorcOutputQueue::Acquire(QStringLiteral("shared"));
+    TorcOutputQueue *other  = TorcOutputQueue::Acquire(QStringLiteral("other"));
+    QCOMPARE(first, second);
+    QVERIFY(first != other);
+    QVERIFY(first->isRunning());
+    QVERIFY(TorcOutputQueue::GetQueueStatistics().contains(QStringLiteral("shared")));
+
+    TorcOutputQueue::Release(first);
+    QVERIFY(TorcOutputQueue::GetQueueStatistics().contains(QStringLiteral("shared")));
+    TorcOutputQueue::Release(second);
+    QVERIFY(!TorcOutputQueue::GetQueueStatistics().contains(QStringLiteral("shared")));
+    TorcOutputQueue::Release(other);
+}
@@ -0,0 +1,19 @@
+#ifndef TESTTORCOUTPUTQUEUE_H
+#define TESTTORCOUTPUTQUEUE_H
+
+#include <QObject>
+
+class TestTorcOutputQueue : public QObject
+{
+    Q_OBJECT
+
+  private slots:
+    void testLatestValue(void);
+    void testOrder(void);
+    void testDuplicates(void);
+    void testErrors(void);
+    void testRemove(void);
+    void testShared(void);
+};
+
+#endif // TESTTORCOUTPUTQUEUE_H
@@ -0,0 +1,193 @@
+// Qt
+#include <QtTest/QtTest>
+#include <QMutex>
+
+// Torc
+#include "torci2cpca9685writer.h"
+#include "testtorchelpers.h"
+#include "testtorcpca9685.h"
+
+// record every transaction instead of writing to a device - and stall the bus thread so updates are queued together
+class TestI2CTransport final : public TorcI2CTransport, public TestTorcBlocker
+{
+  public:
+    TestI2CTransport() : TorcI2CTransport(), TestTorcBlocker(), m_lock(), m_transactions() { }
+
+    bool Write(const quint8 *Data, int Length) override
+    {
+        {
+            QMutexLocker locker(&m_lock);
+            m_transactions.append(QByteArray(reinterpret_cast<const char*>(Data), Length));
+        }
+
+        Block();
+        return true;
+    }
+
+    QList<QByteArray> Take(void)
+    {
+        QMutexLocker locker(&m_lock);
+        QList<QByteArray> result = m_transactions;
+        m_transactions.clear();
+        return result;
+    }
+
+  private:
+    QMutex            m_lock;
+    QList<QByteArray> m_transactions;
+};
+
+static int Decode(const QByteArray &Data, int Offset)
+{
+    int on  = (quint8)Data.at(Offset)     | ((quint8)Data.at(Offset + 1) << 8);
+    int off = (quint8)Data.at(Offset + 2) | ((quint8)Data.at(Offset + 3) << 8);
+    if (off & 0x1000)
+        return 0;
+    if (on & 0x1000)
+        return PCA9685_RESOLUTION;
+    return off;
+}
+
+void TestTorcPCA9685::testEncode(void)
+{
+    quint8 buffer[4];
+    TorcI2CPCA9685Writer::Encode(0, buffer);
+    QCOMPARE(buffer[0], (quint8)0x00);
+    QCOMPARE(buffer[1], (quint8)0x00);
+    QCOMPARE(buffer[3], (quint8)0x10);
+
+    TorcI2CPCA9685Writer::Encode(PCA9685_RESOLUTION, buffer);
+    QCOMPARE(buffer[1], (quint8)0x10);
+    QCOMPARE(buffer[3] & 0x10, 0);
+
+    TorcI2CPCA9685Writer::Encode(0x0123, buffer);
+    QCOMPARE(buffer[0], (quint8)0x00);
+    QCOMPARE(buffer[1], (quint8)0x00);
+    QCOMPARE(buffer[2], (quint8)0x23);
+    QCOMPARE(buffer[3], (quint8)0x01);
+}
+
+void TestTorcPCA9685::testSetup(void)
+{
+    TestI2CTransport *transport = new TestI2CTransport();
+    TorcI2CPCA9685Writer writer(transport);
+    QVERIFY(writer.Setup(1000));
+
+    // the last write to MODE1 must leave auto-increment enabled
+    quint8 mode1 = 0;
+    foreach (const QByteArray &transaction, transport->Take())
+    {
+        QCOMPARE(transaction.size(), 2);
+        if (transaction.at(0) == 0x00)
+            mode1 = (quint8)transaction.at(1);
+    }
+    QVERIFY(mode1 & 0x20);
+}
+
+void TestTorcPCA9685::testRuns(void)
+{
+    TestI2CTransport *transport = new TestI2CTransport();
+    TorcI2CPCA9685Writer writer(transport);
+
+    // every channel with a different value is a single 65 byte write (rather than 64 register writes)
+    for (int i = 0; i < PCA9685_CHANNELS; ++i)
+        writer.SetChannel(i, i * 100);
+    writer.start();
+    writer.Flush();
+
+    QList<QByteArray> transactions = transport->Take();
+    QCOMPARE(transactions.size(), 1);
+    QCOMPARE(transactions.at(0).size(), 1 + PCA9685_CHANNELS * 4);
+    QCOMPARE((quint8)transactions.at(0).at(0), (quint8)0x06);
+    for (int i = 0; i < PCA9685_CHANNELS; ++i)
+        QCOMPARE(Decode(transactions.at(0), 1 + i * 4), i * 100);
+
+    QCOMPARE(writer.GetErrorCount(), (quint64)0);
+
+    // two separate runs
+    TestI2CTransport *transport2 = new TestI2CTransport();
+    TorcI2CPCA9685Writer writer2(transport2);
+    writer2.SetChannel(1, 1);
+    writer2.SetChannel(2, 2);
+    writer2.SetChannel(3, 3);
+    writer2.SetChannel(10, 10);
+    writer2.SetChannel(11, 11);
+    writer2.start();
+    writer2.Flush();
+
+    transactions = transport2->Take();
+    QCOMPARE(transactions.size(), 2);
+    QCOMPARE(transactions.at(0).size(), 1 + 3 * 4);
+    QCOMPARE((quint8)transactions.at(0).at(0), (quint8)(0x06 + 1 * 4));
+    QCOMPARE(transactions.at(1).size(), 1 + 2 * 4);
+    QCOMPARE((quint8)transactions.at(1).at(0), (quint8)(0x06 + 10 * 4));
+    QCOMPARE(Decode(transactions.at(1), 5), 11);
+}
+
+void TestTorcPCA9685::testAllLED(void)
+{
+    TestI2CTransport *transport = new TestI2CTransport();
+    TorcI2CPCA9685Writer writer(transport);
+    QVERIFY(writer.Setup(1000));
+    transport->Take();
+
+    // channel 5 first and then every other channel - two runs that leave every channel the same
+    transport->Hold();
+    writer.SetChannel(5, 2000);
+    writer.start();
+    QVERIFY(transport->WaitUntilBlocked());
+    for (int i = 0; i < PCA9685_CHANNELS; ++i)
+        if (i != 5)
+            writer.SetChannel(i, 2000);
+    transport->Release();
+    writer.Flush();
+
+    QList<QByteArray> transactions = transport->Take();
+    QCOMPARE(transactions.size(), 2);
+    QCOMPARE(transactions.at(0).size(), 5);
+    QCOMPARE((quint8)transactions.at(0).at(0), (quint8)(0x06 + 5 * 4));
+    QCOMPARE(transactions.at(1).size(), 5);
+    QCOMPARE((quint8)transactions.at(1).at(0), (quint8)0xFA);
+    QCOMPARE(Decode(transactions.at(1), 1), 2000);
+}
+
+void TestTorcPCA9685::testLatestValue(void)
+{
+    TestI2CTransport *transport = new TestI2CTransport();
+    TorcI2CPCA9685Writer writer(transport);
+
+    writer.SetChannel(3, 100);
+    writer.SetChannel(3, 200);
+    writer.SetChannel(3, 300);
+    writer.start();
+    writer.Flush();
+
+    QList<QByteArray> transactions = transport->Take();
+    QCOMPARE(transactions.size(), 1);
+    QCOMPARE(transactions.at(0).size(), 5);
+    QCOMPARE((quint8)transactions.at(0).at(0), (quint8)(0x06 + 3 * 4));
+    QCOMPARE(Decode(transactions.at(0), 1), 300);
+}
+
+void TestTorcPCA9685::testFade(void)
+{
+    TestI2CTransport *transport = new TestI2CTransport();
+    TorcI2CPCA9685Writer writer(transport);
+    writer.start();
+
+    // 100 frames of 16 channels - previously 6400 transactions
+    static const int frames = 100;
+    int transactions = 0;
+    for (int frame = 0; frame < frames; ++frame)
+    {
+        for (int i = 0; i < PCA9685_CHANNELS; ++i)
+            writer.SetChannel(i, (frame * 40) + i);
+        writer.Flush();
+        transactions += transport->Take().size();
+    }
+
+    // the thread may wake while a frame is being queued, but every frame is far cheaper than before
+    QVERIFY(transactions >= frames);
+    QVERIFY(transactions <= frames * 4);
+    qDebug() << "Transactions for" << frames << "frames:" << transactions << "(previously" << frames * PCA9685_CHANNELS * 4 << ")";
+}
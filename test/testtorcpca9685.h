@@ -0,0 +1,19 @@
+#ifndef TESTTORCPCA9685_H
+#define TESTTORCPCA9685_H
+
+#include <QObject>
+
+class TestTorcPCA9685 : public QObject
+{
+    Q_OBJECT
+
+  private slots:
+    void testEncode(void);
+    void testSetup(void);
+    void testRuns(void);
+    void testAllLED(void);
+    void testLatestValue(void);
+    void testFade(void);
+};
+
+#endif // TESTTORCPCA9685_H
@@ -0,0 +1,150 @@
+// Qt
+#include <QtTest/QtTest>
+
+// Torc
+#include "torcpropagator.h"
+#include "torccontrolcomponent.h"
+#include "testtorcpropagator.h"
+
+/*! \brief Generate a layered graph where each node takes input from Fanin nodes in the previous layer.
+ *
+ * Every pair of layers contains multiple diamonds.
+*/
+QVector<QVector<int> > TestTorcPropagator::GenerateGraph(int Width, int Depth, int Fanin)
+{
+    qsrand(1);
+    QVector<QVector<int> > inputs(Width * Depth);
+    for (int layer = 1; layer < Depth; ++layer)
+        for (int node = 0; node < Width; ++node)
+            for (int i = 0; i < Fanin; ++i)
+                inputs[(layer * Width) + node].append(((layer - 1) * Width) + (qrand() % Width));
+    return inputs;
+}
+
+static QVector<QVector<int> > Outputs(const QVector<QVector<int> > &Inputs)
+{
+    QVector<QVector<int> > outputs(Inputs.size());
+    for (int node = 0; node < Inputs.size(); ++node)
+        foreach (int input, Inputs[node])
+            outputs[input].append(node);
+    return outputs;
+}
+
+/// Count evaluations for a direct signal/slot cascade, where every changed output re-evaluates each of its outputs.
+static quint64 Cascade(const QVector<QVector<int> > &Outputs, int Node)
+{
+    quint64 result = 0;
+    foreach (int output, Outputs[Node])
+        result += 1 + Cascade(Outputs, output);
+    return result;
+}
+
+/// Count evaluations for a scheduled pass triggered by a change to Node.
+static quint64 Propagate(TorcPropagator &Propagator, const QVector<QVector<int> > &Outputs, int Node)
+{
+    quint64 start = Propagator.Evaluations();
+    foreach (int output, Outputs[Node])
+        Propagator.Schedule(output);
+    int next = -1;
+    while ((next = Propagator.Next()) > -1)
+        foreach (int output, Outputs[next])
+            Propagator.Schedule(output);
+    return Propagator.Evaluations() - start;
+}
+
+void TestTorcPropagator::testLevels(void)
+{
+    // 0 -> 1 -> 3, 0 -> 2 -> 3 (diamond), 3 -> 4, 0 -> 4
+    QVector<QVector<int> > inputs(5);
+    inputs[1] << 0;
+    inputs[2] << 0;
+    inputs[3] << 1 << 2;
+    inputs[4] << 3 << 0;
+
+    TorcPropagator propagator;
+    QVERIFY(propagator.Build(inputs));
+    QCOMPARE(propagator.GetLevel(0), 0);
+    QCOMPARE(propagator.GetLevel(1), 1);
+    QCOMPARE(propagator.GetLevel(2), 1);
+    QCOMPARE(propagator.GetLevel(3), 2);
+    QCOMPARE(propagator.GetLevel(4), 3);
+
+    // each node is evaluated once, after all of its inputs
+    QVector<QVector<int> > outputs = Outputs(inputs);
+    QCOMPARE(Propagate(propagator, outputs, 0), (quint64)4);
+    QCOMPARE(Cascade(outputs, 0), (quint64)7);
+
+    QVERIFY(propagator.Schedule(4));
+    QVERIFY(!propagator.Schedule(4));
+    QVERIFY(!propagator.Schedule(1));
+    QCOMPARE(propagator.Next(), 1);
+    QCOMPARE(propagator.Next(), 4);
+    QCOMPARE(propagator.Next(), -1);
+    QVERIFY(!propagator.IsPending());
+}
+
+void TestTorcPropagator::testCycle(void)
+{
+    // 1 <-> 2
+    QVector<QVector<int> > inputs(3);
+    inputs[1] << 0 << 2;
+    inputs[2] << 1;
+
+    TorcPropagator propagator;
+    QVERIFY(!propagator.Build(inputs));
+
+    // a cycle must not loop within a pass
+    QVERIFY(propagator.Schedule(1));
+    QCOMPARE(propagator.Next(), 1);
+    propagator.Schedule(2);
+    QCOMPARE(propagator.Next(), -1);
+    QVERIFY(propagator.IsPending());
+    QCOMPARE(propagator.Next(), 2);
+    propagator.Schedule(1);
+    QCOMPARE(propagator.Next(), -1);
+    QVERIFY(propagator.IsPending());
+}
+
+void TestTorcPropagator::testComponents(void)
+{
+    // 0 - 1 - 2, 3 (isolated), 4 - 5 and 6 - 5 (joined through 5, e.g. a shared sensor)
+    QVector<QVector<int> > links(7);
+    links[1] << 0 << 2;
+    links[4] << 5;
+    links[6] << 5;
+
+    QVector<int> components;
+    QCOMPARE(TorcControlComponent::Partition(links, components), 3);
+    QCOMPARE(components, QVector<int>() << 0 << 0 << 0 << 1 << 2 << 2 << 2);
+
+    // links in either direction join components
+    links = QVector<QVector<int> >(4);
+    links[3] << 0;
+    links[2] << 3;
+    QCOMPARE(TorcControlComponent::Partition(links, components), 2);
+    QCOMPARE(components, QVector<int>() << 0 << 1 << 0 << 0);
+}
+
+void TestTorcPropagator::benchmarkPropagation(void)
+{
+    QVector<QVector<int> > inputs  = GenerateGraph(50, 12, 2);
+    QVector<QVector<int> > outputs = Outputs(inputs);
+    TorcPropagator propagator;
+    QVERIFY(propagator.Build(inputs));
+
+    quint64 cascade   = 0;
+    quint64 scheduled = 0;
+    QBENCHMARK
+    {
+        cascade   = 0;
+        scheduled = 0;
+        for (int source = 0; source < 50; ++source)
+        {
+            cascade   += Cascade(outputs, source);
+            scheduled += Propagate(propagator, outputs, source);
+        }
+    }
+
+    QVERIFY(scheduled <= cascade);
+    qDebug("Evaluations per input change: cascade %.1f scheduled %.1f", cascade / 50.0, scheduled / 50.0);
+}
@@ -0,0 +1,21 @@
+#ifndef TESTTORCPROPAGATOR_H
+#define TESTTORCPROPAGATOR_H
+
+#include <QObject>
+#include <QVector>
+
+class TestTorcPropagator : public QObject
+{
+    Q_OBJECT
+
+  private slots:
+    void testLevels(void);
+    void testCycle(void);
+    void testComponents(void);
+    void benchmarkPropagation(void);
+
+  private:
+    static QVector<QVector<int> > GenerateGraph (int Width, int Depth, int Fanin);
+};
+
+#endif // TESTTORCPROPAGATOR_H
@@ -0,0 +1,230 @@
+// Qt
+#include <QtTest/QtTest>
+#include <QTemporaryDir>
+
+// Torc
+#include "torcpwmprovider.h"
+#include "testtorchelpers.h"
+#include "testtorcpwmprovider.h"
+
+// std
+#include <thread>
+
+// Linux
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+class TestPWMProvider final : public TorcPWMProvider
+{
+  public:
+    TestPWMProvider(const QString &Name, int Cost, bool Available, bool Opens = true)
+      : TorcPWMProvider(), m_name(Name), m_cost(Cost), m_available(Available), m_opens(Opens), m_writes(0) { }
+
+    QString GetName    (void) const override     { return m_name; }
+    int     GetCost    (void) const override     { return m_cost; }
+    bool    CanProvide (int) override            { return m_available; }
+    bool    Open       (int, int) override       { return m_opens; }
+    bool    Write      (int, int) override       { m_writes++; return true; }
+    void    Close      (int) override            { }
+
+    QString m_name;
+    int     m_cost;
+    bool    m_available;
+    bool    m_opens;
+    int     m_writes;
+};
+
+static QMap<int,int> gPinFunctions;
+
+static int GetPinFunction(int Pin)
+{
+    return gPinFunctions.value(Pin, -1);
+}
+
+void TestTorcPWMProvider::testScheduler(void)
+{
+    TorcPWMScheduler scheduler;
+    TestPWMProvider *software = new TestPWMProvider(QStringLiteral("software"), TORC_PWM_SOFTWARE_COST, true);
+    TestPWMProvider *daemon   = new TestPWMProvider(QStringLiteral("daemon"), 2, true);
+    TestPWMProvider *hardware = new TestPWMProvider(QStringLiteral("hardware"), 0, true);
+    scheduler.AddProvider(software);
+    scheduler.AddProvider(daemon);
+    scheduler.AddProvider(hardware);
+
+    // cheapest first
+    QCOMPARE(scheduler.GetProviders().first(), (TorcPWMProvider*)hardware);
+    QCOMPARE(scheduler.Open(1, 1024, false), (TorcPWMProvider*)hardware);
+
+    // fall back when unavailable or if opening fails
+    hardware->m_available = false;
+    QCOMPARE(scheduler.Open(1, 1024, false), (TorcPWMProvider*)daemon);
+    daemon->m_opens = false;
+
+    // software only when allowed
+    QVERIFY(scheduler.Open(1, 1024, false) == nullptr);
+    QCOMPARE(scheduler.Open(1, 1024, true), (TorcPWMProvider*)software);
+}
+
+void TestTorcPWMProvider::testSysfs(void)
+{
+    QTemporaryDir root;
+    QVERIFY(root.isValid());
+    QDir dir(root.path());
+    QVERIFY(dir.mkpath(QStringLiteral("pwmchip0/pwm0")));
+    QString chip = root.path() + QStringLiteral("/pwmchip0/");
+    QVERIFY(TestTorcHelpers::WriteFile(chip + QStringLiteral("npwm"), "2\n"));
+    QVERIFY(TestTorcHelpers::WriteFile(chip + QStringLiteral("export"), ""));
+    QVERIFY(TestTorcHelpers::WriteFile(chip + QStringLiteral("unexport"), ""));
+    QVERIFY(TestTorcHelpers::WriteFile(chip + QStringLiteral("pwm0/period"), "0\n"));
+    QVERIFY(TestTorcHelpers::WriteFile(chip + QStringLiteral("pwm0/duty_cycle"), "0\n"));
+    QVERIFY(TestTorcHelpers::WriteFile(chip + QStringLiteral("pwm0/enable"), "0\n"));
+
+    QMap<int,QPair<int,int> > pins;
+    pins.insert(1,  qMakePair(0, 0));
+    pins.insert(26, qMakePair(0, 0));
+    pins.insert(30, qMakePair(0, 2));
+    TorcSysfsPWMProvider provider(root.path(), pins, 1000);
+
+    QVERIFY(!provider.CanProvide(5));
+    QVERIFY(!provider.CanProvide(30)); // no such channel
+    QVERIFY(provider.CanProvide(1));
+    QVERIFY(provider.Open(1, 1000));
+    QCOMPARE(TestTorcHelpers::ReadFile(chip + QStringLiteral("pwm0/period")), QByteArray("1000000"));
+    QCOMPARE(TestTorcHelpers::ReadFile(chip + QStringLiteral("pwm0/enable")), QByteArray("1"));
+
+    // pin 26 shares the channel
+    QVERIFY(!provider.CanProvide(26));
+    QVERIFY(!provider.CanProvide(1));
+
+    QVERIFY(provider.Write(1, 500));
+    QCOMPARE(TestTorcHelpers::ReadFile(chip + QStringLiteral("pwm0/duty_cycle")), QByteArray("500000"));
+    QVERIFY(provider.Write(1, 2000)); // clamped to the range
+    QCOMPARE(TestTorcHelpers::ReadFile(chip + QStringLiteral("pwm0/duty_cycle")), QByteArray("1000000"));
+    QVERIFY(!provider.Write(26, 500));
+
+    provider.Close(1);
+    QCOMPARE(TestTorcHelpers::ReadFile(chip + QStringLiteral("pwm0/enable")), QByteArray("0"));
+    QCOMPARE(TestTorcHelpers::ReadFile(chip + QStringLiteral("unexport")), QByteArray("0"));
+    QVERIFY(provider.CanProvide(26));
+}
+
+void TestTorcPWMProvider::testSysfsFunctions(void)
+{
+    QTemporaryDir root;
+    QVERIFY(root.isValid());
+    QDir dir(root.path());
+    QVERIFY(dir.mkpath(QStringLiteral("pwmchip0")));
+    QVERIFY(TestTorcHelpers::WriteFile(root.path() + QStringLiteral("/pwmchip0/npwm"), "2\n"));
+
+    // two pins that can be routed to channel 0 with different functions
+    QMap<int,QPair<int,int> > pins;
+    pins.insert(1,  qMakePair(0, 0));
+    pins.insert(26, qMakePair(0, 0));
+    QMap<int,int> functions;
+    functions.insert(1,  2);
+    functions.insert(26, 4);
+
+    // only the pin that is routed to the channel is provided
+    gPinFunctions.clear();
+    gPinFunctions.insert(1,  2);
+    gPinFunctions.insert(26, 1);
+    TorcSysfsPWMProvider provider(root.path(), pins, 1000, functions, GetPinFunction);
+    QVERIFY(provider.CanProvide(1));
+    QVERIFY(!provider.CanProvide(26));
+    gPinFunctions.insert(26, 4);
+    QVERIFY(provider.CanProvide(26));
+
+    // a pin with a function cannot be provided if the function cannot be checked
+    TorcSysfsPWMProvider unchecked(root.path(), pins, 1000, functions);
+    QVERIFY(!unchecked.CanProvide(1));
+
+    // and the scheduler falls through to the next provider
+    TorcPWMScheduler scheduler;
+    TestPWMProvider *daemon = new TestPWMProvider(QStringLiteral("daemon"), 2, true);
+    scheduler.AddProvider(new TorcSysfsPWMProvider(root.path(), pins, 1000, functions, GetPinFunction));
+    scheduler.AddProvider(daemon);
+    gPinFunctions.insert(26, 1);
+    QCOMPARE(scheduler.Open(26, 1024, false), (TorcPWMProvider*)daemon);
+}
+
+void TestTorcPWMProvider::testPigpiod(void)
+{
+    // a stand in for the daemon, which records each command and returns its second parameter
+    int server = socket(AF_INET, SOCK_STREAM, 0);
+    QVERIFY(server > -1);
+    sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family      = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port        = 0;
+    QVERIFY(bind(server, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == 0);
+    QVERIFY(listen(server, 1) == 0);
+    socklen_t length = sizeof(address);
+    QVERIFY(getsockname(server, reinterpret_cast<sockaddr*>(&address), &length) == 0);
+    int port = ntohs(address.sin_port);
+
+    QList<QList<quint32> > commands;
+    std::thread daemon([server, &commands]()
+    {
+        int client = accept(server, nullptr, nullptr);
+        if (client < 0)
+            return;
+        quint32 request[4];
+        while (recv(client, request, sizeof(request), MSG_WAITALL) == (ssize_t)sizeof(request))
+        {
+            commands.append(QList<quint32>() << request[0] << request[1] << request[2]);
+            quint32 response[4] = { request[0], request[1], request[2], request[2] };
+            if (send(client, response, sizeof(response), MSG_NOSIGNAL) != (ssize_t)sizeof(response))
+                break;
+        }
+        close(client);
+    });
+
+    {
+        QMap<int,int> pins;
+        pins.insert(7, 4);
+        TorcPigpiodPWMProvider provider(QStringLiteral("127.0.0.1"), port, pins, 800);
+        QVERIFY(!provider.CanProvide(8));
+        QVERIFY(provider.CanProvide(7));
+        QVERIFY(provider.Open(7, 1000));
+        QVERIFY(!provider.CanProvide(7));
+        QVERIFY(provider.Write(7, 250));
+        provider.Close(7);
+        QVERIFY(!provider.Write(7, 250));
+    }
+
+    daemon.join();
+    close(server);
+
+    // mode (output), frequency, range, off, 250 and off again
+    QCOMPARE(commands.size(), 6);
+    QCOMPARE(commands.at(0), QList<quint32>() << 0 << 4 << 1);
+    QCOMPARE(commands.at(1), QList<quint32>() << 7 << 4 << 800);
+    QCOMPARE(commands.at(2), QList<quint32>() << 6 << 4 << 1000);
+    QCOMPARE(commands.at(3), QList<quint32>() << 5 << 4 << 0);
+    QCOMPARE(commands.at(4), QList<quint32>() << 5 << 4 << 250);
+    QCOMPARE(commands.at(5), QList<quint32>() << 5 << 4 << 0);
+
+    // no daemon
+    QMap<int,int> pins;
+    pins.insert(7, 4);
+    TorcPigpiodPWMProvider missing(QStringLiteral("127.0.0.1"), port, pins);
+    QVERIFY(!missing.CanProvide(7));
+}
+
+void TestTorcPWMProvider::testBenchmark(void)
+{
+    TestPWMProvider available(QStringLiteral("available"), 0, true);
+    TestPWMProvider unavailable(QStringLiteral("unavailable"), 0, false);
+    QList<TorcPWMProvider*> providers;
+    providers << &available << &unavailable;
+
+    QStringList results = TorcPWMBenchmark::Run(providers, 1, 100, 100);
+    QCOMPARE(results.size(), 3);
+    QVERIFY(results.at(0).startsWith(QStringLiteral("idle: cpu")));
+    QVERIFY(results.at(1).startsWith(QStringLiteral("available: cpu")));
+    QVERIFY(results.at(2).contains(QStringLiteral("not available")));
+    QVERIFY(available.m_writes > 0);
+}
@@ -0,0 +1,18 @@
+#ifndef TESTTORCPWMPROVIDER_H
+#define TESTTORCPWMPROVIDER_H
+
+#include <QObject>
+
+class TestTorcPWMProvider : public QObject
+{
+    Q_OBJECT
+
+  private slots:
+    void testScheduler(void);
+    void testSysfs(void);
+    void testSysfsFunctions(void);
+    void testPigpiod(void);
+    void testBenchmark(void);
+};
+
+#endif // TESTTORCPWMPROVIDER_H
@@ -0,0 +1,250 @@
+// Qt
+#include <QtTest/QtTest>
+
+// Torc
+#include "torcclock.h"
+#include "torcsimulator.h"
+#include "testtorcsimulator.h"
+
+void TestTorcSimulator::testTimeline(void)
+{
+    QByteArray timeline("# comment\n"
+                        "\n"
+                        "60,switch1,1\n"
+                        "2018-06-01T12:00:00,temp1,20.5\n"
+                        "2018-06-01T11:59:59,temp1,20.0\n"
+                        "0.5,switch1,0\n"
+                        "3600\n");
+
+    qint64 start = 0;
+    qint64 end   = 0;
+    QString error;
+    QVector<TorcSimulator::Event> events;
+    QVERIFY(TorcSimulator::ParseTimeline(timeline, start, events, end, error));
+
+    // starts at the earliest absolute time, relative times are offset from the start
+    qint64 first = QDateTime::fromString(QStringLiteral("2018-06-01T11:59:59"), Qt::ISODate).toMSecsSinceEpoch();
+    QCOMPARE(start, first);
+    QCOMPARE(end, first + 3600000);
+    QCOMPARE(events.size(), 4);
+    QCOMPARE(events.at(0).device, QStringLiteral("temp1"));
+    QCOMPARE(events.at(0).time, first);
+    QCOMPARE(events.at(1).device, QStringLiteral("switch1"));
+    QCOMPARE(events.at(1).time, first + 500);
+    QCOMPARE(events.at(2).time, first + 1000);
+    QCOMPARE(events.at(2).value, 20.5);
+    QCOMPARE(events.at(3).time, first + 60000);
+    QCOMPARE(events.at(3).value, 1.0);
+
+    // relative only - start is unchanged
+    start = 1000;
+    QVERIFY(TorcSimulator::ParseTimeline(QByteArray("1,a,1\n1,a,2\n"), start, events, end, error));
+    QCOMPARE(start, (qint64)1000);
+    QCOMPARE(end, (qint64)2000);
+    QCOMPARE(events.size(), 2);
+    QCOMPARE(events.at(1).value, 2.0);
+}
+
+void TestTorcSimulator::testTimelineErrors(void)
+{
+    qint64 start = 0;
+    qint64 end   = 0;
+    QString error;
+    QVector<TorcSimulator::Event> events;
+    QVERIFY(!TorcSimulator::ParseTimeline(QByteArray("1,a\n"), start, events, end, error));
+    QVERIFY(!TorcSimulator::ParseTimeline(QByteArray("1,a,b\n"), start, events, end, error));
+    QVERIFY(!TorcSimulator::ParseTimeline(QByteArray("yesterday,a,1\n"), start, events, end, error));
+    QVERIFY(error.contains(QStringLiteral("line 1")));
+}
+
+void TestTorcSimulator::testVirtualise(void)
+{
+    QVariantMap ds18b20;
+    ds18b20.insert(QStringLiteral("name"), QStringLiteral("tank"));
+    ds18b20.insert(QStringLiteral("wire1serial"), QStringLiteral("28-123456789abc"));
+    QVariantMap wire1;
+    wire1.insert(QStringLiteral("ds18b20"), ds18b20);
+
+    QVariantMap constant;
+    constant.insert(QStringLiteral("name"), QStringLiteral("setpoint"));
+    constant.insert(QStringLiteral("value"), 25);
+    QVariantMap constants;
+    constants.insert(QStringLiteral("temperature"), constant);
+
+    QVariantMap inputs;
+    inputs.insert(QStringLiteral("wire1"), wire1);
+    inputs.insert(QStringLiteral("constant"), constants);
+
+    QVariantMap channel1;
+    channel1.insert(QStringLiteral("name"), QStringLiteral("light1"));
+    channel1.insert(QStringLiteral("number"), 0);
+    channel1.insert(QStringLiteral("default"), 0.5);
+    QVariantMap channel2;
+    channel2.insert(QStringLiteral("name"), QStringLiteral("light2"));
+    channel2.insert(QStringLiteral("number"), 1);
+    QVariantMap pca9685;
+    pca9685.insert(QStringLiteral("i2caddress"), QStringLiteral("0x40"));
+    pca9685.insertMulti(QStringLiteral("channel"), channel1);
+    pca9685.insertMulti(QStringLiteral("channel"), channel2);
+    QVariantMap i2c;
+    i2c.insert(QStringLiteral("pca9685"), pca9685);
+    QVariantMap gpioswitch;
+    gpioswitch.insert(QStringLiteral("name"), QStringLiteral("pump"));
+    gpioswitch.insert(QStringLiteral("gpiopinnumber"), 7);
+    QVariantMap gpio;
+    gpio.insert(QStringLiteral("switch"), gpioswitch);
+    QVariantMap outputs;
+    outputs.insert(QStringLiteral("i2c"), i2c);
+    outputs.insert(QStringLiteral("gpio"), gpio);
+
+    QVariantMap config;
+    config.insert(QStringLiteral("inputs"), inputs);
+    config.insert(QStringLiteral("outputs"), outputs);
+    config.insert(QStringLiteral("controls"), QVariantMap());
+    config.insert(QStringLiteral("notify"), QVariantMap());
+
+    QVariantMap result = TorcSimulator::Virtualise(config);
+    QVERIFY(!result.contains(QStringLiteral("notify")));
+    QVERIFY(result.contains(QStringLiteral("controls")));
+
+    QVariantMap newinputs = result.value(QStringLiteral("inputs")).toMap();
+    QVERIFY(!newinputs.contains(QStringLiteral("wire1")));
+    QVERIFY(newinputs.contains(QStringLiteral("constant")));
+    QVariantMap network = newinputs.value(QStringLiteral("network")).toMap();
+    QCOMPARE(network.value(QStringLiteral("temperature")).toMap().value(QStringLiteral("name")).toString(), QStringLiteral("tank"));
+
+    QVariantMap newoutputs = result.value(QStringLiteral("outputs")).toMap();
+    QCOMPARE(newoutputs.size(), 1);
+    network = newoutputs.value(QStringLiteral("network")).toMap();
+    QList<QVariant> pwm = network.values(QStringLiteral("pwm"));
+    QCOMPARE(pwm.size(), 2);
+    QStringList names;
+    foreach (const QVariant &device, pwm)
+        names << device.toMap().value(QStringLiteral("name")).toString();
+    names.sort();
+    QCOMPARE(names, QStringList() << QStringLiteral("light1") << QStringLiteral("light2"));
+    QCOMPARE(network.value(QStringLiteral("switch")).toMap().value(QStringLiteral("name")).toString(), QStringLiteral("pump"));
+}
+
+#define TRACE_FORMAT QStringLiteral("yyyy-MM-ddTHH:mm:ss.zzz")
+
+// the changes to Device in Trace, ignoring the initial state
+static QStringList Changes(const QString &Trace, const QString &Device, qint64 Start)
+{
+    QString first = QDateTime::fromMSecsSinceEpoch(Start).toString(TRACE_FORMAT);
+    QStringList result;
+    foreach (const QString &line, Trace.split('\n', QString::SkipEmptyParts))
+        if (line.contains(',' + Device + ',') && !line.startsWith(first))
+            result << line;
+    return result;
+}
+
+static QString Change(qint64 Time, const QString &Device, const QString &Value)
+{
+    return QDateTime::fromMSecsSinceEpoch(Time).toString(TRACE_FORMAT) + ',' + Device + ',' + Value;
+}
+
+/*! \brief Run a minutely timer for two minutes on the virtual clock and check the trace.
+ *
+ * The timer is on from 20 to 30 seconds past each minute.
+*/
+void TestTorcSimulator::testSimulate(void)
+{
+    QVariantMap pump;
+    pump.insert(QStringLiteral("name"), QStringLiteral("testpump"));
+    pump.insert(QStringLiteral("default"), 0);
+    QVariantMap network;
+    network.insert(QStringLiteral("switch"), pump);
+    QVariantMap outputs;
+    outputs.insert(QStringLiteral("network"), network);
+
+    QVariantMap timeroutputs;
+    timeroutputs.insert(QStringLiteral("device"), QStringLiteral("testpump"));
+    QVariantMap minutely;
+    minutely.insert(QStringLiteral("name"), QStringLiteral("testtimer"));
+    minutely.insert(QStringLiteral("start"), QStringLiteral("0.20"));
+    minutely.insert(QStringLiteral("duration"), QStringLiteral("0.10"));
+    minutely.insert(QStringLiteral("outputs"), timeroutputs);
+    QVariantMap timer;
+    timer.insert(QStringLiteral("minutely"), minutely);
+    QVariantMap controls;
+    controls.insert(QStringLiteral("timer"), timer);
+
+    QVariantMap config;
+    config.insert(QStringLiteral("outputs"), outputs);
+    config.insert(QStringLiteral("controls"), controls);
+
+    qint64 start = QDateTime::fromString(QStringLiteral("2018-06-01T12:00:00Z"), Qt::ISODate).toMSecsSinceEpoch();
+    QString result;
+    QTextStream trace(&result);
+    QVERIFY(TorcSimulator::Simulate(config, QVector<TorcSimulator::Event>(), start, start + 120000, &trace));
+    trace.flush();
+    QCoreApplication::sendPostedEvents(nullptr, QEvent::DeferredDelete);
+    QVERIFY(!TorcClock::IsVirtual());
+
+    QStringList expected;
+    expected << Change(start + 20000, QStringLiteral("testpump"), QStringLiteral("1"))
+             << Change(start + 30000, QStringLiteral("testpump"), QStringLiteral("0"))
+             << Change(start + 80000, QStringLiteral("testpump"), QStringLiteral("1"))
+             << Change(start + 90000, QStringLiteral("testpump"), QStringLiteral("0"));
+    QCOMPARE(Changes(result, QStringLiteral("testpump"), start), expected);
+}
+
+/*! \brief Check that a window maximum falls as samples expire, without any further input.
+ *
+ * The maximum (0.8 at 1 second) leaves the 10 second window at 11 seconds.
+*/
+void TestTorcSimulator::testWindowExpiry(void)
+{
+    QVariantMap level;
+    level.insert(QStringLiteral("name"), QStringLiteral("testlevel"));
+    level.insert(QStringLiteral("default"), 0);
+    QVariantMap network;
+    network.insert(QStringLiteral("pwm"), level);
+    QVariantMap inputs;
+    inputs.insert(QStringLiteral("network"), network);
+
+    QVariantMap maximum;
+    maximum.insert(QStringLiteral("name"), QStringLiteral("testmax"));
+    maximum.insert(QStringLiteral("default"), 0);
+    network.clear();
+    network.insert(QStringLiteral("pwm"), maximum);
+    QVariantMap outputs;
+    outputs.insert(QStringLiteral("network"), network);
+
+    QVariantMap controlinputs;
+    controlinputs.insert(QStringLiteral("device"), QStringLiteral("testlevel"));
+    QVariantMap controloutputs;
+    controloutputs.insert(QStringLiteral("device"), QStringLiteral("testmax"));
+    QVariantMap windowmax;
+    windowmax.insert(QStringLiteral("name"), QStringLiteral("testwindowmax"));
+    windowmax.insert(QStringLiteral("window"), QStringLiteral("0.10"));
+    windowmax.insert(QStringLiteral("inputs"), controlinputs);
+    windowmax.insert(QStringLiteral("outputs"), controloutputs);
+    QVariantMap logic;
+    logic.insert(QStringLiteral("windowmax"), windowmax);
+    QVariantMap controls;
+    controls.insert(QStringLiteral("logic"), logic);
+
+    QVariantMap config;
+    config.insert(QStringLiteral("inputs"), inputs);
+    config.insert(QStringLiteral("outputs"), outputs);
+    config.insert(QStringLiteral("controls"), controls);
+
+    qint64 start = QDateTime::fromString(QStringLiteral("2018-06-01T12:00:00Z"), Qt::ISODate).toMSecsSinceEpoch();
+    qint64 end   = 0;
+    QString error;
+    QVector<TorcSimulator::Event> events;
+    QVERIFY(TorcSimulator::ParseTimeline(QByteArray("1,testlevel,0.8\n2,testlevel,0.3\n30\n"), start, events, end, error));
+
+    QString result;
+    QTextStream trace(&result);
+    QVERIFY(TorcSimulator::Simulate(config, events, start, end, &trace));
+    trace.flush();
+    QCoreApplication::sendPostedEvents(nullptr, QEvent::DeferredDelete);
+
+    QStringList expected;
+    expected << Change(start + 1000,  QStringLiteral("testmax"), QStringLiteral("0.8"))
+             << Change(start + 11000, QStringLiteral("testmax"), QStringLiteral("0.3"));
+    QCOMPARE(Changes(result, QStringLiteral("testmax"), start), expected);
+}
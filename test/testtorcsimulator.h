@@ -0,0 +1,18 @@
+#ifndef TESTTORCSIMULATOR_H
+#define TESTTORCSIMULATOR_H
+
+#include <QObject>
+
+class TestTorcSimulator : public QObject
+{
+    Q_OBJECT
+
+  private slots:
+    void testTimeline(void);
+    void testTimelineErrors(void);
+    void testVirtualise(void);
+    void testSimulate(void);
+    void testWindowExpiry(void);
+};
+
+#endif // TESTTORCSIMULATOR_H
@@ -0,0 +1,163 @@
+// Qt
+#include <QtTest/QtTest>
+
+// Torc
+#include "torctimerwheel.h"
+#include "testtorctimerwheel.h"
+
+// an arbitrary, unaligned, start time
+static const quint64 kStart = Q_UINT64_C(1530000000123);
+static const quint64 kWeek  = Q_UINT64_C(7) * 24 * 60 * 60 * 1000;
+
+void TestTorcTimerWheel::testExpiry(void)
+{
+    qsrand(1);
+    TorcTimerWheel wheel;
+    QVector<int> result;
+    wheel.Advance(kStart, result);
+
+    // timers from 1ms to more than a week ahead
+    QVector<quint64> due;
+    for (int i = 0; i < 2000; ++i)
+    {
+        int handle = wheel.Add();
+        QCOMPARE(handle, i);
+        quint64 time = kStart + 1 + ((((quint64)qrand() << 16) ^ (quint64)qrand()) % (kWeek + kWeek / 2));
+        if (i < 10)
+            time = kStart + 1 + i; // and some that are immediately due
+        due.append(time);
+        wheel.Schedule(handle, time);
+    }
+    QCOMPARE(wheel.Count(), 2000);
+
+    // advance in irregular steps. Every timer must expire in the first step that passes its due time.
+    QVector<bool> expired(due.size(), false);
+    quint64 now  = kStart;
+    quint64 step = 1;
+    while (wheel.Count() > 0)
+    {
+        quint64 last = now;
+        now += step;
+        step = (step * 7) % 9999991 + 1;
+
+        result.clear();
+        wheel.Advance(now, result);
+        quint64 previous = 0;
+        foreach (int handle, result)
+        {
+            QVERIFY(!expired[handle]);
+            QVERIFY(due[handle] > last && due[handle] <= now);
+            QVERIFY(due[handle] >= previous);
+            QVERIFY(!wheel.IsScheduled(handle));
+            expired[handle] = true;
+            previous = due[handle];
+        }
+    }
+
+    QVERIFY(!expired.contains(false));
+    quint64 next = 0;
+    QVERIFY(!wheel.NextExpiry(next));
+}
+
+void TestTorcTimerWheel::testCancel(void)
+{
+    TorcTimerWheel wheel;
+    QVector<int> result;
+    wheel.Advance(kStart, result);
+
+    int first  = wheel.Add();
+    int second = wheel.Add();
+    wheel.Schedule(first,  kStart + 5000);
+    wheel.Schedule(second, kStart + 5000);
+    QCOMPARE(wheel.Count(), 2);
+
+    // replace and cancel
+    wheel.Schedule(first, kStart + 100);
+    QCOMPARE(wheel.Count(), 2);
+    wheel.Cancel(second);
+    QCOMPARE(wheel.Count(), 1);
+
+    quint64 next = 0;
+    QVERIFY(wheel.NextExpiry(next));
+    QVERIFY(next <= kStart + 100);
+
+    wheel.Advance(kStart + 99, result);
+    QVERIFY(result.isEmpty());
+    wheel.Advance(kStart + 100, result);
+    QCOMPARE(result, QVector<int>() << first);
+
+    // times in the past are due immediately
+    wheel.Schedule(second, kStart);
+    wheel.Advance(kStart + 101, result);
+    QCOMPARE(result, QVector<int>() << first << second);
+
+    // handles are re-used
+    wheel.Remove(first);
+    QCOMPARE(wheel.Add(), first);
+}
+
+void TestTorcTimerWheel::testRebase(void)
+{
+    TorcTimerWheel wheel;
+    QVector<int> result;
+    wheel.Advance(kStart, result);
+
+    int handle = wheel.Add();
+    wheel.Schedule(handle, kStart + 60000);
+
+    // the clock moves back by one hour - the timeout remains 60 seconds away
+    quint64 now = kStart - 3600000;
+    wheel.Rebase(now);
+    QCOMPARE(wheel.GetDue(handle), now + 60000);
+    wheel.Advance(now + 59999, result);
+    QVERIFY(result.isEmpty());
+    wheel.Advance(now + 60000, result);
+    QCOMPARE(result, QVector<int>() << handle);
+}
+
+/*! \brief Simulate a day of minutely, hourly and daily timers.
+ *
+ * Timers that are due together are delivered together - so the number of wake ups is bounded by the number of
+ * distinct transition times (plus occasional cascades) rather than the number of timers.
+*/
+void TestTorcTimerWheel::benchmarkTimers(void)
+{
+    static const int     count     = 5000;
+    static const quint64 periods[] = { 60 * 1000, 60 * 60 * 1000, 24 * 60 * 60 * 1000 };
+
+    quint64 wakeups = 0;
+    quint64 expirations = 0;
+
+    QBENCHMARK
+    {
+        qsrand(1);
+        TorcTimerWheel wheel;
+        QVector<int> result;
+        wheel.Advance(kStart, result);
+
+        QVector<quint64> period(count);
+        for (int i = 0; i < count; ++i)
+        {
+            int handle = wheel.Add();
+            period[handle] = periods[i % 3];
+            // transitions on whole seconds, as configured in torc.xml
+            wheel.Schedule(handle, kStart + ((qrand() % (period[handle] / 1000)) + 1) * 1000);
+        }
+
+        wakeups = 0;
+        expirations = 0;
+        quint64 next = 0;
+        while (wheel.NextExpiry(next) && next < kStart + (24 * 60 * 60 * 1000))
+        {
+            wakeups++;
+            result.clear();
+            wheel.Advance(next, result);
+            expirations += result.size();
+            foreach (int handle, result)
+                wheel.Schedule(handle, next + period[handle]);
+        }
+    }
+
+    qDebug() << "Timers" << count << "expirations" << expirations << "wake ups" << wakeups;
+    QVERIFY(expirations > wakeups * 5);
+}
@@ -0,0 +1,17 @@
+#ifndef TESTTORCTIMERWHEEL_H
+#define TESTTORCTIMERWHEEL_H
+
+#include <QObject>
+
+class TestTorcTimerWheel : public QObject
+{
+    Q_OBJECT
+
+  private slots:
+    void testExpiry(void);
+    void testCancel(void);
+    void testRebase(void);
+    void benchmarkTimers(void);
+};
+
+#endif // TESTTORCTIMERWHEEL_H
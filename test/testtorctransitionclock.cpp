@@ -0,0 +1,203 @@
+// Qt
+#include <QtTest/QtTest>
+#include <QThread>
+
+// Torc
+#include "torcclock.h"
+#include "torcoutputs.h"
+#include "torctransitionclock.h"
+#include "torctransitioncontrol.h"
+#include "testtorctransitionclock.h"
+
+static QVariantMap Details(const QString &Name)
+{
+    QVariantMap details;
+    details.insert(QStringLiteral("name"), Name);
+    return details;
+}
+
+TestBatchOutput::TestBatchOutput(const QString &Name)
+  : TorcOutput(TorcOutput::PWM, 0, QStringLiteral("Test"), Details(Name)),
+    m_pending(0),
+    m_writes()
+{
+}
+
+TorcOutput::Type TestBatchOutput::GetType(void)
+{
+    return TorcOutput::PWM;
+}
+
+QList<double> TestBatchOutput::Take(void)
+{
+    QMutexLocker locker(&lock);
+    QList<double> result = m_writes;
+    m_writes.clear();
+    return result;
+}
+
+void TestBatchOutput::SetValue(double Value)
+{
+    QMutexLocker locker(&lock);
+    m_pending = Value;
+    if (!DeferUntilEndOfBatch())
+        m_writes.append(Value);
+    TorcOutput::SetValue(Value);
+}
+
+void TestBatchOutput::FlushBatch(void)
+{
+    QMutexLocker locker(&lock);
+    m_writes.append(m_pending);
+}
+
+static void Release(TestBatchOutput *Output)
+{
+    TorcOutputs::gOutputs->RemoveOutput(Output);
+    Output->DownRef();
+    QCoreApplication::sendPostedEvents(nullptr, QEvent::DeferredDelete);
+}
+
+// update an output in a batch of its own
+class TestBatchThread : public QThread
+{
+  public:
+    explicit TestBatchThread(TestBatchOutput *Output)
+      : QThread(),
+        m_output(Output),
+        m_unbatched(),
+        m_batched()
+    {
+    }
+
+    void run(void) override
+    {
+        m_output->SetValue(1.0);
+        m_unbatched = m_output->Take();
+
+        TorcOutput::BeginBatch();
+        m_output->SetValue(0.5);
+        m_output->SetValue(0.25);
+        TorcOutput::EndBatch();
+        m_batched = m_output->Take();
+    }
+
+    TestBatchOutput *m_output;
+    QList<double>    m_unbatched;
+    QList<double>    m_batched;
+
+  private:
+    Q_DISABLE_COPY(TestBatchThread)
+};
+
+/*! \brief Check that updates that do not change the quantised value are suppressed.
+ *
+ * A one second linear transition, updated every 10ms, in quarters. The quantised value changes at 130, 380, 630 and 880ms
+ * and the final value is always delivered.
+*/
+void TestTorcTransitionClock::testQuantum(void)
+{
+    // NB the control is not validated, so values are counted but go no further
+    TorcTransitionControl *control = new TorcTransitionControl(QStringLiteral("linear"), Details(QStringLiteral("testquantum")));
+    TorcTransitionClock clock;
+    qint64 start = 1000000;
+    TorcClock::SetVirtualTime(start);
+
+    int handle = clock.Register(control, QEasingCurve(QEasingCurve::Linear), 1000, 10, 0.25);
+    QVERIFY(handle > -1);
+    clock.Start(handle, true);
+    QVERIFY(clock.IsActive(handle));
+    QCOMPARE(clock.Updates(), (quint64)1);
+
+    qint64 next = 0;
+    while (clock.NextDue(next))
+    {
+        TorcClock::SetVirtualTime(next);
+        clock.Service();
+    }
+
+    QCOMPARE(next, start + 1000);
+    QVERIFY(!clock.IsActive(handle));
+    QCOMPARE(clock.Updates(), (quint64)6);
+    QCOMPARE(clock.Suppressed(), (quint64)95);
+
+    // without a quantum, every update is delivered
+    clock.Deregister(handle);
+    handle = clock.Register(control, QEasingCurve(QEasingCurve::Linear), 1000, 10, 0.0);
+    clock.Start(handle, false);
+    while (clock.NextDue(next))
+    {
+        TorcClock::SetVirtualTime(next);
+        clock.Service();
+    }
+    QCOMPARE(clock.Updates(), (quint64)107);
+    QCOMPARE(clock.Suppressed(), (quint64)95);
+
+    clock.Deregister(handle);
+    TorcClock::SetRealTime();
+    control->DownRef();
+    QCoreApplication::sendPostedEvents(nullptr, QEvent::DeferredDelete);
+}
+
+void TestTorcTransitionClock::testBatching(void)
+{
+    TestBatchOutput *output1 = new TestBatchOutput(QStringLiteral("testbatch1"));
+    TestBatchOutput *output2 = new TestBatchOutput(QStringLiteral("testbatch2"));
+
+    // no batch - written immediately
+    output1->SetValue(0.1);
+    QCOMPARE(output1->Take(), QList<double>() << 0.1);
+
+    // only the latest value is written at the end of the (outermost) batch
+    TorcOutput::BeginBatch();
+    output1->SetValue(0.2);
+    output1->SetValue(0.3);
+    output2->SetValue(0.4);
+    TorcOutput::BeginBatch();
+    output1->SetValue(0.5);
+    TorcOutput::EndBatch();
+    QVERIFY(output1->Take().isEmpty());
+    QVERIFY(output2->Take().isEmpty());
+    TorcOutput::EndBatch();
+    QCOMPARE(output1->Take(), QList<double>() << 0.5);
+    QCOMPARE(output2->Take(), QList<double>() << 0.4);
+
+    // unbalanced calls are ignored
+    TorcOutput::EndBatch();
+    output1->SetValue(0.6);
+    QCOMPARE(output1->Take(), QList<double>() << 0.6);
+
+    // an output deleted during a batch is not flushed
+    TorcOutput::BeginBatch();
+    output2->SetValue(0.7);
+    Release(output2);
+    output1->SetValue(0.8);
+    TorcOutput::EndBatch();
+    QCOMPARE(output1->Take(), QList<double>() << 0.8);
+
+    Release(output1);
+}
+
+/// A batch in one thread must neither defer nor flush updates from another.
+void TestTorcTransitionClock::testBatchThreads(void)
+{
+    TestBatchOutput *output1 = new TestBatchOutput(QStringLiteral("testbatchthread1"));
+    TestBatchOutput *output2 = new TestBatchOutput(QStringLiteral("testbatchthread2"));
+
+    TorcOutput::BeginBatch();
+    output1->SetValue(1.0);
+
+    TestBatchThread thread(output2);
+    thread.start();
+    QVERIFY(thread.wait(5000));
+    QCOMPARE(thread.m_unbatched, QList<double>() << 1.0);
+    QCOMPARE(thread.m_batched, QList<double>() << 0.25);
+    QVERIFY(output1->Take().isEmpty());
+
+    TorcOutput::EndBatch();
+    QCOMPARE(output1->Take(), QList<double>() << 1.0);
+    QVERIFY(output2->Take().isEmpty());
+
+    Release(output1);
+    Release(output2);
+}
@@ -0,0 +1,41 @@
+#ifndef TESTTORCTRANSITIONCLOCK_H
+#define TESTTORCTRANSITIONCLOCK_H
+
+#include <QObject>
+
+// Torc
+#include "torcoutput.h"
+
+// record every value written to the 'hardware'
+class TestBatchOutput final : public TorcOutput
+{
+    Q_OBJECT
+
+  public:
+    explicit TestBatchOutput(const QString &Name);
+
+    TorcOutput::Type GetType (void) override;
+    QList<double>    Take    (void);
+
+  public slots:
+    void             SetValue(double Value) override;
+
+  protected:
+    void             FlushBatch(void) override;
+
+  private:
+    double           m_pending;
+    QList<double>    m_writes;
+};
+
+class TestTorcTransitionClock : public QObject
+{
+    Q_OBJECT
+
+  private slots:
+    void testQuantum(void);
+    void testBatching(void);
+    void testBatchThreads(void);
+};
+
+#endif // TESTTORCTRANSITIONCLOCK_H
@@ -0,0 +1,461 @@
+// Qt
+#include <QtTest/QtTest>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QElapsedTimer>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QJsonArray>
+
+// Torc
+#include "torcwebsocketreader.h"
+#include "torcwebsocket.h"
+#include "torcrpcrequest.h"
+#include "testtorcwebsocket.h"
+
+#define FRAGMENT WS_MIN_FRAGMENT_SIZE
+
+/// Exposes the reader's protected interface to the tests.
+class TestWebSocketReader final : public TorcWebSocketReader
+{
+  public:
+    TestWebSocketReader(QTcpSocket &Socket, bool ServerSide)
+      : TorcWebSocketReader(Socket, SubProtocolNone, ServerSide)
+    {
+    }
+
+    using TorcWebSocketReader::GetPayload;
+    using TorcWebSocketReader::Reset;
+    using TorcWebSocketReader::ResetRead;
+    using TorcWebSocketReader::SendFrame;
+    using TorcWebSocketReader::SendPending;
+    using TorcWebSocketReader::HasPending;
+    using TorcWebSocketReader::SetFragmentSize;
+    using TorcWebSocketReader::Read;
+};
+
+class TestFrame
+{
+  public:
+    int        opcode;
+    bool       final;
+    QByteArray payload;
+};
+
+/// A connected pair of local sockets.
+class TestSocketPair
+{
+  public:
+    TestSocketPair()
+      : server(),
+        client(),
+        accepted(nullptr)
+    {
+        server.listen(QHostAddress::LocalHost);
+        client.connectToHost(QHostAddress::LocalHost, server.serverPort());
+        client.waitForConnected(1000);
+        server.waitForNewConnection(1000);
+        accepted = server.nextPendingConnection();
+    }
+
+    QTcpServer  server;
+    QTcpSocket  client;
+    QTcpSocket *accepted;
+
+  private:
+    Q_DISABLE_COPY(TestSocketPair)
+};
+
+/// Flush everything the reader has pending to the socket.
+static void Drain(TestWebSocketReader &Reader, QTcpSocket &Socket)
+{
+    QElapsedTimer timer;
+    timer.start();
+    while (Reader.HasPending() && timer.elapsed() < 5000)
+    {
+        Socket.waitForBytesWritten(100);
+        Reader.SendPending();
+    }
+    while (Socket.bytesToWrite() > 0 && timer.elapsed() < 5000)
+        Socket.waitForBytesWritten(100);
+}
+
+/// Parse the unmasked (server to client) frames that Socket receives until Messages data messages are complete.
+static QList<TestFrame> ReadFrames(QTcpSocket &Socket, int Messages)
+{
+    QList<TestFrame> result;
+    QByteArray buffer;
+    QElapsedTimer timer;
+    timer.start();
+    while (timer.elapsed() < 5000)
+    {
+        if (Socket.bytesAvailable() < 1)
+            Socket.waitForReadyRead(100);
+        buffer.append(Socket.readAll());
+
+        while (buffer.size() >= 2)
+        {
+            int header = 2;
+            quint64 length = static_cast<quint8>(buffer.at(1)) & 0x7f;
+            if (length == 126)
+            {
+                if (buffer.size() < 4)
+                    break;
+                header = 4;
+                length = (static_cast<quint8>(buffer.at(2)) << 8) | static_cast<quint8>(buffer.at(3));
+            }
+            else if (length == 127)
+            {
+                if (buffer.size() < 10)
+                    break;
+                header = 10;
+                length = 0;
+                for (int i = 2; i < 10; ++i)
+                    length = (length << 8) | static_cast<quint8>(buffer.at(i));
+            }
+
+            if (static_cast<quint64>(buffer.size()) < header + length)
+                break;
+
+            TestFrame frame;
+            frame.opcode  = buffer.at(0) & 0x0f;
+            frame.final   = (buffer.at(0) & 0x80) != 0;
+            frame.payload = buffer.mid(header, static_cast<int>(length));
+            buffer.remove(0, header + static_cast<int>(length));
+            result.append(frame);
+            if (frame.final && !(frame.opcode & 0x8) && --Messages < 1)
+                return result;
+        }
+    }
+    return result;
+}
+
+/// Write a raw, unmasked frame as a server would.
+static void WriteFrame(QTcpSocket &Socket, int OpCode, bool Final, const QByteArray &Payload)
+{
+    QByteArray frame;
+    frame.append(static_cast<char>(OpCode | (Final ? 0x80 : 0x00)));
+    if (Payload.size() < 126)
+    {
+        frame.append(static_cast<char>(Payload.size()));
+    }
+    else
+    {
+        frame.append(static_cast<char>(126));
+        frame.append(static_cast<char>((Payload.size() >> 8) & 0xff));
+        frame.append(static_cast<char>(Payload.size() & 0xff));
+    }
+    frame.append(Payload);
+    Socket.write(frame);
+    Socket.waitForBytesWritten(1000);
+}
+
+static QByteArray Message(int Size, char Seed)
+{
+    QByteArray result(Size, 0);
+    for (int i = 0; i < Size; ++i)
+        result[i] = static_cast<char>('a' + (Seed + i) % 26);
+    return result;
+}
+
+void TestTorcWebSocket::testFragmentation(void)
+{
+    TestSocketPair pair;
+    QVERIFY(pair.accepted);
+    TestWebSocketReader writer(*pair.accepted, true);
+    writer.SetFragmentSize(FRAGMENT);
+
+    // a small message is a single final frame
+    QByteArray small = Message(FRAGMENT, 0);
+    writer.SendFrame(TorcWebSocketReader::OpText, small);
+    QVERIFY(!writer.HasPending());
+    QList<TestFrame> frames = ReadFrames(pair.client, 1);
+    QCOMPARE(frames.size(), 1);
+    QVERIFY(frames.first().final);
+    QCOMPARE(frames.first().payload, small);
+
+    // a large message is split into fragment sized continuation frames
+    QByteArray large = Message(FRAGMENT * 5 + 100, 1);
+    writer.SendFrame(TorcWebSocketReader::OpBinary, large);
+    QVERIFY(writer.HasPending());
+    Drain(writer, *pair.accepted);
+    QVERIFY(!writer.HasPending());
+
+    frames = ReadFrames(pair.client, 1);
+    QCOMPARE(frames.size(), 6);
+    QByteArray joined;
+    for (int i = 0; i < frames.size(); ++i)
+    {
+        QCOMPARE(frames[i].opcode, i ? (int)TorcWebSocketReader::OpContinuation : (int)TorcWebSocketReader::OpBinary);
+        QCOMPARE(frames[i].final, i == frames.size() - 1);
+        QVERIFY(frames[i].payload.size() <= FRAGMENT);
+        joined.append(frames[i].payload);
+    }
+    QCOMPARE(joined, large);
+
+    // and a client side reader reassembles it
+    TestSocketPair pair2;
+    QVERIFY(pair2.accepted);
+    TestWebSocketReader sender(*pair2.accepted, true);
+    TestWebSocketReader receiver(pair2.client, false);
+    sender.SetFragmentSize(FRAGMENT);
+    sender.SendFrame(TorcWebSocketReader::OpBinary, large);
+    Drain(sender, *pair2.accepted);
+
+    bool complete = false;
+    QElapsedTimer timer;
+    timer.start();
+    while (!complete && timer.elapsed() < 5000)
+    {
+        if (pair2.client.bytesAvailable() < 1)
+            pair2.client.waitForReadyRead(100);
+        complete = receiver.Read();
+    }
+    QVERIFY(complete);
+    QCOMPARE(receiver.GetPayload(), large);
+    receiver.ResetRead();
+}
+
+void TestTorcWebSocket::testInterleavedSend(void)
+{
+    TestSocketPair pair;
+    QVERIFY(pair.accepted);
+    TestWebSocketReader writer(*pair.accepted, true);
+    writer.SetFragmentSize(FRAGMENT);
+
+    // start a large message, then send a ping, a second large message and a small message behind it
+    QByteArray first  = Message(FRAGMENT * 4, 2);
+    QByteArray second = Message(FRAGMENT * 2 + 1, 3);
+    QByteArray small  = Message(10, 4);
+    QByteArray ping("ping");
+    writer.SendFrame(TorcWebSocketReader::OpBinary, first);
+    QVERIFY(writer.HasPending());
+    writer.SendFrame(TorcWebSocketReader::OpPing, ping);
+    writer.SendFrame(TorcWebSocketReader::OpBinary, second);
+    writer.SendFrame(TorcWebSocketReader::OpText, small);
+    Drain(writer, *pair.accepted);
+
+    // the ping goes out straight away, the small message as soon as the first message completes
+    // and the second large message last - and no data message interrupts another
+    QList<TestFrame> frames = ReadFrames(pair.client, 3);
+    QList<int> pingAt;
+    QList<QByteArray> messages;
+    QByteArray current;
+    bool inMessage = false;
+    for (int i = 0; i < frames.size(); ++i)
+    {
+        const TestFrame &frame = frames.at(i);
+        if (frame.opcode & 0x8)
+        {
+            QCOMPARE(frame.opcode, (int)TorcWebSocketReader::OpPing);
+            QCOMPARE(frame.payload, ping);
+            pingAt.append(i);
+            continue;
+        }
+
+        QCOMPARE(frame.opcode == TorcWebSocketReader::OpContinuation, inMessage);
+        current.append(frame.payload);
+        inMessage = !frame.final;
+        if (frame.final)
+        {
+            messages.append(current);
+            current.clear();
+        }
+    }
+
+    QCOMPARE(pingAt.size(), 1);
+    QVERIFY(pingAt.first() > 0 && pingAt.first() < 4);
+    QCOMPARE(messages.size(), 3);
+    QCOMPARE(messages.at(0), first);
+    QCOMPARE(messages.at(1), small);
+    QCOMPARE(messages.at(2), second);
+}
+
+void TestTorcWebSocket::testInterleavedRead(void)
+{
+    TestSocketPair pair;
+    QVERIFY(pair.accepted);
+    TestWebSocketReader reader(pair.client, false);
+
+    // a fragmented message with a ping between its fragments
+    WriteFrame(*pair.accepted, TorcWebSocketReader::OpText, false, QByteArray("Hello "));
+    WriteFrame(*pair.accepted, TorcWebSocketReader::OpPing, true,  QByteArray("check"));
+    WriteFrame(*pair.accepted, TorcWebSocketReader::OpContinuation, false, QByteArray("fragmented "));
+    WriteFrame(*pair.accepted, TorcWebSocketReader::OpPong, true,  QByteArray());
+    WriteFrame(*pair.accepted, TorcWebSocketReader::OpContinuation, true,  QByteArray("world"));
+
+    bool complete = false;
+    QElapsedTimer timer;
+    timer.start();
+    while (!complete && timer.elapsed() < 5000)
+    {
+        if (pair.client.bytesAvailable() < 1)
+            pair.client.waitForReadyRead(100);
+        complete = reader.Read();
+    }
+    QVERIFY(complete);
+    QCOMPARE(reader.GetPayload(), QByteArray("Hello fragmented world"));
+    reader.ResetRead();
+
+    // the ping is answered with a masked pong while the message is still incomplete
+    pair.client.waitForBytesWritten(1000);
+    QByteArray pong;
+    timer.restart();
+    while (pong.size() < 2 + 4 + 5 && timer.elapsed() < 5000)
+    {
+        pair.accepted->waitForReadyRead(100);
+        pong.append(pair.accepted->readAll());
+    }
+    QCOMPARE(pong.size(), 2 + 4 + 5);
+    QCOMPARE(static_cast<quint8>(pong.at(0)), static_cast<quint8>(0x80 | TorcWebSocketReader::OpPong));
+    QCOMPARE(static_cast<quint8>(pong.at(1)), static_cast<quint8>(0x80 | 5));
+    QByteArray unmasked;
+    for (int i = 0; i < 5; ++i)
+        unmasked.append(static_cast<char>(pong.at(6 + i) ^ pong.at(2 + i % 4)));
+    QCOMPARE(unmasked, QByteArray("check"));
+
+    // a second message reads normally after the reset
+    WriteFrame(*pair.accepted, TorcWebSocketReader::OpText, true, QByteArray("again"));
+    complete = false;
+    timer.restart();
+    while (!complete && timer.elapsed() < 5000)
+    {
+        if (pair.client.bytesAvailable() < 1)
+            pair.client.waitForReadyRead(100);
+        complete = reader.Read();
+    }
+    QVERIFY(complete);
+    QCOMPARE(reader.GetPayload(), QByteArray("again"));
+}
+
+void TestTorcWebSocket::testReset(void)
+{
+    TestSocketPair pair;
+    QVERIFY(pair.accepted);
+    TestWebSocketReader writer(*pair.accepted, true);
+    writer.SetFragmentSize(FRAGMENT);
+
+    QByteArray large  = Message(FRAGMENT * 8, 5);
+    QByteArray queued = Message(FRAGMENT * 2, 6);
+    QByteArray small  = Message(8, 7);
+    writer.SendFrame(TorcWebSocketReader::OpBinary, large);
+    writer.SendFrame(TorcWebSocketReader::OpBinary, queued);
+    writer.SendFrame(TorcWebSocketReader::OpText, small);
+    QVERIFY(writer.HasPending());
+
+    // nothing that was partially sent or queued survives a reset
+    writer.Reset();
+    QVERIFY(!writer.HasPending());
+    Drain(writer, *pair.accepted);
+
+    QByteArray received;
+    QElapsedTimer timer;
+    timer.start();
+    while (timer.elapsed() < 500)
+    {
+        pair.client.waitForReadyRead(50);
+        received.append(pair.client.readAll());
+    }
+    QVERIFY(received.size() < FRAGMENT * 2);
+
+    // and a new message is sent whole
+    QByteArray after = Message(20, 8);
+    writer.SendFrame(TorcWebSocketReader::OpText, after);
+    QList<TestFrame> frames = ReadFrames(pair.client, 1);
+    QCOMPARE(frames.size(), 1);
+    QCOMPARE(frames.first().payload, after);
+}
+
+void TestTorcWebSocket::testBatching(void)
+{
+    TorcRPCRequest *first  = new TorcRPCRequest(QStringLiteral("/services/First"), nullptr);
+    TorcRPCRequest *second = new TorcRPCRequest(QStringLiteral("/services/Second"), nullptr);
+    TorcRPCRequest *notify = new TorcRPCRequest(QStringLiteral("/services/Notify"));
+    first->SetID(1);
+    second->SetID(2);
+    second->AddParameter(QStringLiteral("value"), 5);
+
+    // a lone request is sent as a plain object
+    QList<TorcRPCRequest*> requests;
+    requests << first;
+    QJsonDocument single = QJsonDocument::fromJson(TorcWebSocket::SerialiseBatch(requests, TorcWebSocketReader::SubProtocolJSONRPC));
+    QVERIFY(single.isObject());
+    QCOMPARE(single.object().value(QStringLiteral("method")).toString(), QStringLiteral("/services/First"));
+    QVERIFY(first->GetState() & TorcRPCRequest::RequestSent);
+
+    // more than one is sent as a batch, in order
+    requests << second << notify;
+    QJsonDocument batch = QJsonDocument::fromJson(TorcWebSocket::SerialiseBatch(requests, TorcWebSocketReader::SubProtocolJSONRPC));
+    QVERIFY(batch.isArray());
+    QJsonArray array = batch.array();
+    QCOMPARE(array.size(), 3);
+    QCOMPARE(array.at(0).toObject().value(QStringLiteral("id")).toInt(), 1);
+    QCOMPARE(array.at(1).toObject().value(QStringLiteral("id")).toInt(), 2);
+    QCOMPARE(array.at(1).toObject().value(QStringLiteral("params")).toObject().value(QStringLiteral("value")).toInt(), 5);
+    QCOMPARE(array.at(2).toObject().value(QStringLiteral("method")).toString(), QStringLiteral("/services/Notify"));
+    QVERIFY(!array.at(2).toObject().contains(QStringLiteral("id")));
+    foreach (TorcRPCRequest *request, requests)
+        QVERIFY(request->GetState() & TorcRPCRequest::RequestSent);
+
+    // a batched response is split into individual responses
+    QByteArray response("[{\"jsonrpc\":\"2.0\",\"result\":10,\"id\":1},"
+                        "{\"jsonrpc\":\"2.0\",\"error\":{\"code\":-32601,\"message\":\"Method not found\"},\"id\":2}]");
+    TorcRPCRequest *reply = new TorcRPCRequest(TorcWebSocketReader::SubProtocolJSONRPC, response, nullptr, true);
+    QVERIFY(reply->GetData().isEmpty());
+    QCOMPARE(reply->GetBatchResponses().size(), 2);
+    TorcRPCRequest *result = reply->GetBatchResponses().at(0);
+    TorcRPCRequest *error  = reply->GetBatchResponses().at(1);
+    QCOMPARE(result->GetID(), 1);
+    QCOMPARE(result->GetReply().toInt(), 10);
+    QVERIFY(!(result->GetState() & TorcRPCRequest::Errored));
+    QCOMPARE(error->GetID(), 2);
+    QVERIFY(error->GetState() & TorcRPCRequest::Errored);
+
+    reply->DownRef();
+    foreach (TorcRPCRequest *request, requests)
+        request->DownRef();
+}
+
+void TestTorcWebSocket::testTimeouts(void)
+{
+    // requests time out on the tick that is RPC_REQUEST_TIMEOUT after the current (partial) tick
+    const int ticks = RPC_REQUEST_TIMEOUT / RPC_TIMEOUT_TICK + 1;
+    QVERIFY(ticks < RPC_TIMEOUT_SLOTS);
+
+    TorcRPCTimeouts timeouts;
+    QVERIFY(timeouts.IsEmpty());
+    timeouts.Add(1);
+    timeouts.Add(2);
+    timeouts.Add(3);
+    QCOMPARE(timeouts.Count(), 3);
+
+    // an answered request is removed
+    timeouts.Remove(2);
+    QCOMPARE(timeouts.Count(), 2);
+
+    for (int i = 1; i < ticks; ++i)
+    {
+        QVERIFY(timeouts.Tick().isEmpty());
+        // adding an existing request reschedules it
+        if (i == 2)
+            timeouts.Add(3);
+    }
+    QCOMPARE(timeouts.Count(), 2);
+
+    QCOMPARE(timeouts.Tick(), QList<int>() << 1);
+    QVERIFY(timeouts.Tick().isEmpty());
+    QCOMPARE(timeouts.Tick(), QList<int>() << 3);
+    QVERIFY(timeouts.IsEmpty());
+
+    // and the wheel wraps around
+    for (int i = 0; i < RPC_TIMEOUT_SLOTS * 3; ++i)
+    {
+        timeouts.Add(100 + i);
+        QList<int> expired = timeouts.Tick();
+        if (i >= ticks - 1)
+            QCOMPARE(expired, QList<int>() << (100 + i - ticks + 1));
+        else
+            QVERIFY(expired.isEmpty());
+    }
+    QCOMPARE(timeouts.Count(), ticks - 1);
+}
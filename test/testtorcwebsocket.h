@@ -0,0 +1,19 @@
+#ifndef TESTTORCWEBSOCKET_H
+#define TESTTORCWEBSOCKET_H
+
+#include <QObject>
+
+class TestTorcWebSocket : public QObject
+{
+    Q_OBJECT
+
+  private slots:
+    void testFragmentation(void);
+    void testInterleavedSend(void);
+    void testInterleavedRead(void);
+    void testReset(void);
+    void testBatching(void);
+    void testTimeouts(void);
+};
+
+#endif // TESTTORCWEBSOCKET_H
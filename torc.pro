@@ -81,7 +81,7 @@ win32 {
 QMAKE_CXXFLAGS += -D_FILE_OFFSET_BITS=64 -D_LARGEFILE_SOURCE
 
 DEPENDPATH  += ./torc ./torc/http ./torc/upnp ./inputs ./inputs/platforms ./server
-DEPENDPATH  += ./outputs ./outputs/platforms ./torc/openmax ./controls ./notify
+DEPENDPATH  += ./outputs ./outputs/platforms ./torc/openmax ./controls ./notify ./mqtt
 INCLUDEPATH += $$DEPENDPATH
 
 # use graphviz via library or executable?
@@ -139,6 +139,20 @@ qtHaveModule(xmlpatterns_XX) {
 }
 
 linux {
+    # GPIO input events
+    HEADERS += inputs/platforms/torcgpioevents.h
+    SOURCES += inputs/platforms/torcgpioevents.cpp
+
+    # IIO and hwmon sensors
+    HEADERS += inputs/platforms/torciiodevice.h
+    HEADERS += inputs/platforms/torciiobus.h
+    SOURCES += inputs/platforms/torciiodevice.cpp
+    SOURCES += inputs/platforms/torciiobus.cpp
+
+    # PWM providers
+    HEADERS += outputs/platforms/torcpwmprovider.h
+    SOURCES += outputs/platforms/torcpwmprovider.cpp
+
     # linux power support
     qtHaveModule(dbus) {
         QT += dbus
@@ -291,6 +305,7 @@ HEADERS += torc/torcmime.h
 HEADERS += torc/torcbonjour.h
 HEADERS += torc/torcxmlreader.h
 HEADERS += torc/torctime.h
+HEADERS += torc/torcclock.h
 HEADERS += torc/torcuser.h
 HEADERS += torc/torcsegmentedringbuffer.h
 HEADERS += torc/http/torchttprequest.h
@@ -320,6 +335,7 @@ HEADERS += torc/upnp/torcupnp.h
 HEADERS += torc/upnp/torcssdp.h
 HEADERS += torc/upnp/torcupnpcontent.h
 HEADERS += inputs/torcinput.h
+HEADERS += inputs/torcinputfilter.h
 HEADERS += inputs/torcinputs.h
 HEADERS += inputs/torcpwminput.h
 HEADERS += inputs/torcswitchinput.h
@@ -336,13 +352,18 @@ HEADERS += inputs/torcintegerinput.h
 HEADERS += inputs/torcnetworkintegerinput.h
 HEADERS += inputs/platforms/torc1wirebus.h
 HEADERS += inputs/platforms/torc1wireds18b20.h
+HEADERS += inputs/platforms/torc1wiremaster.h
 HEADERS += outputs/torcoutput.h
+HEADERS += outputs/torcoutputqueue.h
 HEADERS += outputs/torcoutputs.h
 HEADERS += outputs/torcpwmoutput.h
 HEADERS += outputs/torcswitchoutput.h
 HEADERS += outputs/torcphoutput.h
 HEADERS += outputs/torctemperatureoutput.h
 HEADERS += outputs/platforms/torci2cbus.h
+HEADERS += outputs/platforms/torci2cpca9685writer.h
+HEADERS += outputs/platforms/torcmodbusmaster.h
+HEADERS += outputs/platforms/torcmodbusbus.h
 HEADERS += outputs/torcnetworkpwmoutput.h
 HEADERS += outputs/torcnetworkswitchoutput.h
 HEADERS += outputs/torcnetworktemperatureoutput.h
@@ -350,9 +371,16 @@ HEADERS += outputs/torcnetworkphoutput.h
 HEADERS += outputs/torcnetworkbuttonoutput.h
 HEADERS += controls/torccontrol.h
 HEADERS += controls/torccontrols.h
+HEADERS += controls/torccontrolcomponent.h
 HEADERS += controls/torclogiccontrol.h
 HEADERS += controls/torctimercontrol.h
 HEADERS += controls/torctransitioncontrol.h
+HEADERS += controls/torcpropagator.h
+HEADERS += controls/torcexpression.h
+HEADERS += controls/torcexpressioncontrol.h
+HEADERS += controls/torctimerwheel.h
+HEADERS += controls/torctimerscheduler.h
+HEADERS += controls/torctransitionclock.h
 HEADERS += notify/torcnotify.h
 HEADERS += notify/torcnotifier.h
 HEADERS += notify/torclognotifier.h
@@ -363,6 +391,8 @@ HEADERS += notify/torciotplotternotifier.h
 HEADERS += notify/torcnotification.h
 HEADERS += notify/torcsystemnotification.h
 HEADERS += notify/torctriggernotification.h
+HEADERS += mqtt/torcmqttclient.h
+HEADERS += mqtt/torcmqttbridge.h
 
 SOURCES += torc/torcloggingimp.cpp
 SOURCES += torc/torcplist.cpp
@@ -388,6 +418,8 @@ SOURCES += torc/torcdirectories.cpp
 SOURCES += torc/torcmime.cpp
 SOURCES += torc/torcxmlreader.cpp
 SOURCES += torc/torctime.cpp
+SOURCES += torc/torcclock.cpp
+SOURCES += torc/torcmaths.cpp
 SOURCES += torc/torcuser.cpp
 SOURCES += torc/torcsegmentedringbuffer.cpp
 SOURCES += torc/http/torchttprequest.cpp
@@ -417,6 +449,7 @@ SOURCES += torc/upnp/torcupnp.cpp
 SOURCES += torc/upnp/torcssdp.cpp
 SOURCES += torc/upnp/torcupnpcontent.cpp
 SOURCES += inputs/torcinput.cpp
+SOURCES += inputs/torcinputfilter.cpp
 SOURCES += inputs/torcinputs.cpp
 SOURCES += inputs/torcpwminput.cpp
 SOURCES += inputs/torcphinput.cpp
@@ -433,13 +466,18 @@ SOURCES += inputs/torcintegerinput.cpp
 SOURCES += inputs/torcnetworkintegerinput.cpp
 SOURCES += inputs/platforms/torc1wirebus.cpp
 SOURCES += inputs/platforms/torc1wireds18b20.cpp
+SOURCES += inputs/platforms/torc1wiremaster.cpp
 SOURCES += outputs/torcoutput.cpp
+SOURCES += outputs/torcoutputqueue.cpp
 SOURCES += outputs/torcoutputs.cpp
 SOURCES += outputs/torcpwmoutput.cpp
 SOURCES += outputs/torcswitchoutput.cpp
 SOURCES += outputs/torctemperatureoutput.cpp
 SOURCES += outputs/torcphoutput.cpp
 SOURCES += outputs/platforms/torci2cbus.cpp
+SOURCES += outputs/platforms/torci2cpca9685writer.cpp
+SOURCES += outputs/platforms/torcmodbusmaster.cpp
+SOURCES += outputs/platforms/torcmodbusbus.cpp
 SOURCES += outputs/torcnetworkpwmoutput.cpp
 SOURCES += outputs/torcnetworkswitchoutput.cpp
 SOURCES += outputs/torcnetworktemperatureoutput.cpp
@@ -447,9 +485,16 @@ SOURCES += outputs/torcnetworkphoutput.cpp
 SOURCES += outputs/torcnetworkbuttonoutput.cpp
 SOURCES += controls/torccontrol.cpp
 SOURCES += controls/torccontrols.cpp
+SOURCES += controls/torccontrolcomponent.cpp
 SOURCES += controls/torclogiccontrol.cpp
 SOURCES += controls/torctimercontrol.cpp
 SOURCES += controls/torctransitioncontrol.cpp
+SOURCES += controls/torcpropagator.cpp
+SOURCES += controls/torcexpression.cpp
+SOURCES += controls/torcexpressioncontrol.cpp
+SOURCES += controls/torctimerwheel.cpp
+SOURCES += controls/torctimerscheduler.cpp
+SOURCES += controls/torctransitionclock.cpp
 SOURCES += notify/torcnotify.cpp
 SOURCES += notify/torcnotifier.cpp
 SOURCES += notify/torclognotifier.cpp
@@ -460,16 +505,24 @@ SOURCES += notify/torcthingspeaknotifier.cpp
 SOURCES += notify/torcnotification.cpp
 SOURCES += notify/torcsystemnotification.cpp
 SOURCES += notify/torctriggernotification.cpp
+SOURCES += mqtt/torcmqttclient.cpp
+SOURCES += mqtt/torcmqttbridge.cpp
 
 HEADERS += server/torccentral.h
 HEADERS += server/torcdevice.h
 HEADERS += server/torcdevicehandler.h
 HEADERS += server/torcxsdtest.h
+HEADERS += server/torcsimulator.h
+HEADERS += server/torcconfigdiff.h
+HEADERS += server/torcconfigloader.h
 SOURCES += server/main.cpp
 SOURCES += server/torccentral.cpp
 SOURCES += server/torcdevice.cpp
 SOURCES += server/torcdevicehandler.cpp
 SOURCES += server/torcxsdtest.cpp
+SOURCES += server/torcsimulator.cpp
+SOURCES += server/torcconfigdiff.cpp
+SOURCES += server/torcconfigloader.cpp
 
 test {
     message("Building tests")
@@ -483,10 +536,54 @@ test {
     INSTALLS = target
     SOURCES -= server/main.cpp
     SOURCES += test/main.cpp
+    HEADERS += test/testtorchelpers.h
+    SOURCES += test/testtorchelpers.cpp
     HEADERS += test/testserialisers.h
     HEADERS += test/testtorclocalcontext.h
+    HEADERS += test/testtorcpropagator.h
+    HEADERS += test/testtorcexpression.h
+    HEADERS += test/testtorctimerwheel.h
+    HEADERS += test/testtorcsimulator.h
+    HEADERS += test/testtorcmaths.h
+    HEADERS += test/testtorcconfigdiff.h
+    HEADERS += test/testtorcconfigloader.h
+    HEADERS += test/testtorc1wiremaster.h
+    HEADERS += test/testtorcpca9685.h
+    HEADERS += test/testtorcoutputqueue.h
+    HEADERS += test/testtorcinputfilter.h
+    HEADERS += test/testtorcinputs.h
+    HEADERS += test/testtorcmqtt.h
+    HEADERS += test/testtorcmodbus.h
+    HEADERS += test/testtorcwebsocket.h
+    HEADERS += test/testtorchttpservice.h
+    HEADERS += test/testtorctransitionclock.h
     SOURCES += test/testserialisers.cpp
     SOURCES += test/testtorclocalcontext.cpp
+    SOURCES += test/testtorcpropagator.cpp
+    SOURCES += test/testtorcexpression.cpp
+    SOURCES += test/testtorctimerwheel.cpp
+    SOURCES += test/testtorcsimulator.cpp
+    SOURCES += test/testtorcmaths.cpp
+    SOURCES += test/testtorcconfigdiff.cpp
+    SOURCES += test/testtorcconfigloader.cpp
+    SOURCES += test/testtorc1wiremaster.cpp
+    SOURCES += test/testtorcpca9685.cpp
+    SOURCES += test/testtorcoutputqueue.cpp
+    SOURCES += test/testtorcinputfilter.cpp
+    SOURCES += test/testtorcinputs.cpp
+    SOURCES += test/testtorcmqtt.cpp
+    SOURCES += test/testtorcmodbus.cpp
+    SOURCES += test/testtorcwebsocket.cpp
+    SOURCES += test/testtorchttpservice.cpp
+    SOURCES += test/testtorctransitionclock.cpp
+    linux {
+        HEADERS += test/testtorcgpioevents.h
+        HEADERS += test/testtorcpwmprovider.h
+        HEADERS += test/testtorciiodevice.h
+        SOURCES += test/testtorcgpioevents.cpp
+        SOURCES += test/testtorcpwmprovider.cpp
+        SOURCES += test/testtorciiodevice.cpp
+    }
 }
 
 QMAKE_CLEAN += $(TARGET)
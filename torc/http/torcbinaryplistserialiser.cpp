@@ -18,7 +18,6 @@
 */
 
 // Qt
-#include <QTextCodec>
 #include <QtEndian>
 #include <QUuid>
 
@@ -27,57 +26,104 @@
 #include "torcplist.h"
 #include "torcbinaryplistserialiser.h"
 
-#include <stdint.h>
-
-#define START_OBJECT { m_objectOffsets.append(Dest.size()); }
+// std
+#include <limits.h>
+#include <string.h>
 
 /*! \class TorcBinaryPListSerialiser
  *  \brief Data serialiser for the Apple binary property list format
  *
- * \todo Top level dictionary
+ * Scalar objects are written to the destination as they are added. Dictionaries and arrays
+ * only hold references to other objects and are written once the document is complete, when the
+ * total object count (and hence the reference size) is known. At that point the remaining
+ * output (containers, offset table and trailer) is sized exactly, allocated once and filled
+ * in place.
+ *
+ * Strings (including dictionary keys) and small scalar values are interned - each distinct
+ * value is written once and shared by every reference to it.
+ *
+ * Top level properties are added to the root dictionary.
 */
 
 TorcBinaryPListSerialiser::TorcBinaryPListSerialiser()
   : TorcSerialiser(),
     m_referenceSize(8),
     m_objectOffsets(),
-    m_strings()
+    m_strings(),
+    m_scalars(),
+    m_containers(),
+    m_completed()
+{
+}
+
+///\brief Return the number of bytes (1, 2, 4 or 8) needed to store Value.
+static inline quint8 BytesNeeded(quint64 Value)
 {
+    return Value <= 0xff ? 1 : Value <= 0xffff ? 2 : Value <= 0xffffffff ? 4 : 8;
 }
 
-static inline void WriteReference(quint64 Reference, quint8 Size, quint8* Pointer, quint64 &Counter)
+///\brief Write Value in big endian format using Size bytes.
+static inline void WriteSized(quint8 *Pointer, quint64 Value, quint8 Size)
 {
     switch (Size)
     {
-        case 1:
-        {
-            Pointer[Counter++] = (quint8)(Reference & 0xff);
-            return;
-        }
-        case 2:
-        {
-            quint16 buffer = qToBigEndian((quint16)(Reference & 0xffff));
-            for (int i = 0; i < 2; ++i)
-                Pointer[Counter++] = *((quint8*)&buffer + i);
-            return;
-        }
-        case 4:
-        {
-            quint32 buffer = qToBigEndian((quint32)(Reference & 0xffffffff));
-            for (int i = 0; i < 4; ++i)
-                Pointer[Counter++] = *((quint8*)&buffer + i);
-            return;
-        }
-        case 8:
-        {
-            quint64 buffer = qToBigEndian(Reference);
-            for (int i = 0; i < 8; ++i)
-                Pointer[Counter++] = *((quint8*)&buffer + i);
-            return;
-        }
+        case 1:  *Pointer = (quint8)(Value & 0xff);                        return;
+        case 2:  qToBigEndian<quint16>((quint16)(Value & 0xffff), Pointer);     return;
+        case 4:  qToBigEndian<quint32>((quint32)(Value & 0xffffffff), Pointer); return;
+        default: qToBigEndian<quint64>(Value, Pointer);                    return;
     }
 }
 
+///\brief Return the size of an integer object for Value.
+static inline int UIntSize(quint64 Value)
+{
+    return 1 + BytesNeeded(Value);
+}
+
+///\brief Write an integer object, returning the number of bytes used.
+static inline int WriteUInt(quint8 *Pointer, quint64 Value)
+{
+    quint8 size = BytesNeeded(Value);
+    *Pointer = (quint8)(TorcPList::BPLIST_UINT | (size == 1 ? 0 : size == 2 ? 1 : size == 4 ? 2 : 3));
+    WriteSized(Pointer + 1, Value, size);
+    return 1 + size;
+}
+
+///\brief Return the size of an object marker with Count.
+static inline int MarkerSize(quint64 Count)
+{
+    return Count < BPLIST_LOW_MAX ? 1 : 1 + UIntSize(Count);
+}
+
+///\brief Write an object marker of Type with Count, returning the number of bytes used.
+static inline int WriteMarker(quint8 *Pointer, quint8 Type, quint64 Count)
+{
+    if (Count < BPLIST_LOW_MAX)
+    {
+        *Pointer = (quint8)(Type | Count);
+        return 1;
+    }
+
+    *Pointer = (quint8)(Type | BPLIST_LOW_MAX);
+    return 1 + WriteUInt(Pointer + 1, Count);
+}
+
+///\brief Write Value as a big endian double.
+static inline void WriteDouble(quint8 *Pointer, double Value)
+{
+    quint64 value;
+    memcpy(&value, &Value, sizeof(value));
+    qToBigEndian<quint64>(value, Pointer);
+}
+
+///\brief Extend Dest by Size bytes and return a pointer to the new space.
+static inline quint8* Extend(QByteArray &Dest, int Size)
+{
+    int position = Dest.size();
+    Dest.resize(position + Size);
+    return (quint8*)Dest.data() + position;
+}
+
 HTTPResponseType TorcBinaryPListSerialiser::ResponseType(void)
 {
     return HTTPResponseBinaryPList;
@@ -91,154 +137,186 @@ void TorcBinaryPListSerialiser::Begin(QByteArray &Dest)
 {
     Dest.reserve(1024);
     m_objectOffsets.clear();
+    m_strings.clear();
+    m_scalars.clear();
+    m_containers.clear();
+    m_completed.clear();
     Dest.append("bplist00");
+
+    // the root dictionary is always object 0
+    Container root;
+    root.m_object = m_objectOffsets.size();
+    root.m_type   = TorcPList::BPLIST_DICT;
+    m_objectOffsets.append(0);
+    m_containers.push(root);
+}
+
+void TorcBinaryPListSerialiser::StartObject(QByteArray &Dest, const QString &Name)
+{
+    StartContainer(Dest, Name, TorcPList::BPLIST_DICT);
+}
+
+void TorcBinaryPListSerialiser::EndObject(QByteArray &)
+{
+    EndContainer();
+}
+
+void TorcBinaryPListSerialiser::StartArray(QByteArray &Dest, const QString &Name)
+{
+    StartContainer(Dest, Name, TorcPList::BPLIST_ARRAY);
 }
 
-void TorcBinaryPListSerialiser::AddProperty(QByteArray &Dest, const QString &Name, const QVariant &Value)
+void TorcBinaryPListSerialiser::EndArray(QByteArray &)
 {
-    // this is the maximum count before string optimisation
-    quint64 count = 2;
-    CountObjects(count, Value);
+    EndContainer();
+}
 
-    LOG(VB_GENERAL, LOG_INFO, QStringLiteral("Max object count %1").arg(count));
+void TorcBinaryPListSerialiser::AddValue(QByteArray &Dest, const QString &Name, const QVariant &Value)
+{
+    AddReference(Dest, Name, BinaryFromVariant(Dest, Value));
+}
 
-    m_referenceSize = count < 0x000000ff ? 1 :
-                      count < 0x0000ffff ? 2 :
-                      count < 0xffffffff ? 4 : 8;
+void TorcBinaryPListSerialiser::StartContainer(QByteArray &Dest, const QString &Name, quint8 Type)
+{
+    Container container;
+    container.m_object = m_objectOffsets.size();
+    container.m_type   = Type;
+    m_objectOffsets.append(0); // updated when written
+    AddReference(Dest, Name, container.m_object);
+    m_containers.push(container);
+}
 
-    START_OBJECT
-    Dest.append((quint8)(TorcPList::BPLIST_DICT | 1));
-    quint64 offset = Dest.size();
-    QByteArray references(2 * m_referenceSize, 0);
-    Dest.append(references);
+void TorcBinaryPListSerialiser::EndContainer(void)
+{
+    // never remove the root dictionary
+    if (m_containers.size() > 1)
+        m_completed.append(m_containers.pop());
+}
+
+/*! \brief Add a reference to Object to the currently open container.
+*/
+void TorcBinaryPListSerialiser::AddReference(QByteArray &Dest, const QString &Name, quint64 Object)
+{
+    if (m_containers.isEmpty())
+        return;
 
-    WriteReference(BinaryFromQString(Dest, Name), m_referenceSize, (quint8*)Dest.data(), offset);
-    WriteReference(BinaryFromVariant(Dest, Name, Value), m_referenceSize, (quint8*)Dest.data(), offset);
+    Container &container = m_containers.top();
+    if (container.m_type == TorcPList::BPLIST_DICT)
+        container.m_keys.append(BinaryFromQString(Dest, Name));
+    container.m_values.append(Object);
 }
 
+/*! \brief Complete the document.
+ *
+ * The first pass sizes the containers, offset table and trailer. The second writes them
+ * directly into the preallocated space.
+*/
 void TorcBinaryPListSerialiser::End(QByteArray &Dest)
 {
+    // close anything left open, including the root dictionary
+    while (!m_containers.isEmpty())
+        m_completed.append(m_containers.pop());
+
+    quint64 count   = m_objectOffsets.size();
+    m_referenceSize = BytesNeeded(count - 1);
+
+    // first pass
     quint64 table = Dest.size();
+    foreach (const Container &container, m_completed)
+        table += MarkerSize(container.m_values.size()) + (container.m_keys.size() + container.m_values.size()) * m_referenceSize;
+    quint8 offsetsize = BytesNeeded(table);
+    quint64 total     = table + count * offsetsize + 32;
 
-    quint8 offsetsize = table < 0x000000ff ? 1 :
-                        table < 0x0000ffff ? 2 :
-                        table < 0xffffffff ? 4 : 8;
+    if (total > (quint64)INT_MAX)
+    {
+        LOG(VB_GENERAL, LOG_ERR, QStringLiteral("Binary plist too large (%1 bytes)").arg(total));
+        Dest.clear();
+        m_completed.clear();
+        return;
+    }
 
-    QList<quint64>::const_iterator it = m_objectOffsets.constBegin();
-    switch (offsetsize)
+    // second pass
+    quint64 position = Dest.size();
+    Dest.resize((int)total);
+    quint8* data = (quint8*)Dest.data();
+
+    foreach (const Container &container, m_completed)
     {
-        case 1:
+        m_objectOffsets[container.m_object] = position;
+        quint8* pointer = data + position;
+        pointer += WriteMarker(pointer, container.m_type, container.m_values.size());
+        foreach (quint64 key, container.m_keys)
         {
-            for ( ; it != m_objectOffsets.constEnd(); ++it)
-                Dest.append((quint8)((*it) & 0xff));
-            break;
+            WriteSized(pointer, key, m_referenceSize);
+            pointer += m_referenceSize;
         }
-        case 2:
+        foreach (quint64 value, container.m_values)
         {
-            for ( ; it != m_objectOffsets.constEnd(); ++it)
-            {
-                quint16 buffer = qToBigEndian((quint16)((*it) & 0xffff));
-                Dest.append(*((quint8*)&buffer));
-                Dest.append(*((quint8*)&buffer + 1));
-            }
-            break;
-        }
-        case 4:
-        {
-            for ( ; it != m_objectOffsets.constEnd(); ++it)
-            {
-                quint32 buffer= qToBigEndian((quint32)((*it) & 0xffffffff));
-                Dest.append(*((quint8*)&buffer));
-                Dest.append(*((quint8*)&buffer + 1));
-                Dest.append(*((quint8*)&buffer + 2));
-                Dest.append(*((quint8*)&buffer + 3));
-            }
-            break;
+            WriteSized(pointer, value, m_referenceSize);
+            pointer += m_referenceSize;
         }
-        case 8:
-        {
-            for ( ; it != m_objectOffsets.constEnd(); ++it)
-            {
-                quint64 buffer = qToBigEndian((*it));
-                Dest.append(*((quint8*)&buffer));
-                Dest.append(*((quint8*)&buffer + 1));
-                Dest.append(*((quint8*)&buffer + 2));
-                Dest.append(*((quint8*)&buffer + 3));
-                Dest.append(*((quint8*)&buffer + 4));
-                Dest.append(*((quint8*)&buffer + 5));
-                Dest.append(*((quint8*)&buffer + 6));
-                Dest.append(*((quint8*)&buffer + 7));
-            }
-            break;
-        }
-        default:
-            break;
+        position = pointer - data;
     }
+    m_completed.clear();
 
-    table = qToBigEndian(table);
-    quint64 count = qToBigEndian((quint64)m_objectOffsets.count());
-
-    QByteArray trailer(32, 0);
-    trailer[6]  = offsetsize;
-    trailer[7]  = m_referenceSize;
-    trailer[8]  = *((quint8*)&count);
-    trailer[9]  = *((quint8*)&count + 1);
-    trailer[10] = *((quint8*)&count + 2);
-    trailer[11] = *((quint8*)&count + 3);
-    trailer[12] = *((quint8*)&count + 4);
-    trailer[13] = *((quint8*)&count + 5);
-    trailer[14] = *((quint8*)&count + 6);
-    trailer[15] = *((quint8*)&count + 7);
-    trailer[24] = *((quint8*)&table);
-    trailer[25] = *((quint8*)&table + 1);
-    trailer[26] = *((quint8*)&table + 2);
-    trailer[27] = *((quint8*)&table + 3);
-    trailer[28] = *((quint8*)&table + 4);
-    trailer[29] = *((quint8*)&table + 5);
-    trailer[30] = *((quint8*)&table + 6);
-    trailer[31] = *((quint8*)&table + 7);
-
-    Dest.append(trailer);
-
-    LOG(VB_GENERAL, LOG_INFO, QStringLiteral("Actual object count %1").arg(m_objectOffsets.count()));
-
-#if 1
-    QByteArray testdata(Dest.data(), Dest.size());
-    TorcPList test(testdata);
-    LOG(VB_GENERAL, LOG_INFO, QStringLiteral("\n%1").arg(test.ToString()));
-#endif
+    quint8* pointer = data + table;
+    foreach (quint64 offset, m_objectOffsets)
+    {
+        WriteSized(pointer, offset, offsetsize);
+        pointer += offsetsize;
+    }
+
+    // trailer - root object is always 0
+    memset(pointer, 0, 32);
+    pointer[6] = offsetsize;
+    pointer[7] = m_referenceSize;
+    qToBigEndian<quint64>(count, pointer + 8);
+    qToBigEndian<quint64>(table, pointer + 24);
 }
 
-quint64 TorcBinaryPListSerialiser::BinaryFromVariant(QByteArray &Dest, const QString &Name, const QVariant &Value)
+/*! \brief Add a scalar object, reusing an identical object if one has already been added.
+ *
+ * Object holds the complete encoded object.
+*/
+quint64 TorcBinaryPListSerialiser::AddScalar(QByteArray &Dest, const quint8 *Object, int Size)
 {
-    // object formats not used: ascii string, set
+    QByteArray key = QByteArray::fromRawData((const char*)Object, Size);
+    QHash<QByteArray,quint64>::const_iterator it = m_scalars.constFind(key);
+    if (it != m_scalars.constEnd())
+        return it.value();
+
     quint64 result = m_objectOffsets.size();
+    m_objectOffsets.append(Dest.size());
+    memcpy(Extend(Dest, Size), Object, Size);
+    m_scalars.insert(QByteArray((const char*)Object, Size), result);
+    return result;
+}
+
+quint64 TorcBinaryPListSerialiser::BinaryFromVariant(QByteArray &Dest, const QVariant &Value)
+{
+    // object formats not used: set
+    // containers are handled by the streaming interface
+    quint8 object[9];
 
     if (Value.isNull())
     {
-        Dest.append((char)TorcPList::BPLIST_NULL);
-        return result;
+        object[0] = TorcPList::BPLIST_NULL;
+        return AddScalar(Dest, object, 1);
     }
 
     switch ((int)Value.type())
     {
-        case QMetaType::QVariantList: return BinaryFromArray(Dest, Name, Value.toList());
-        case QMetaType::QStringList:  return BinaryFromStringList(Dest, Name, Value.toStringList());
-        case QMetaType::QVariantMap:  return BinaryFromMap(Dest, Name, Value.toMap());
-        case QMetaType::QUuid:        BinaryFromUuid(Dest, Value); return result;
-        case QMetaType::QByteArray:   BinaryFromData(Dest, Value); return result;
+        case QMetaType::QUuid:      return BinaryFromUuid(Dest, Value);
+        case QMetaType::QByteArray: return BinaryFromData(Dest, Value);
         case QMetaType::Bool:
         {
-            START_OBJECT
-            bool value = Value.toBool();
-            Dest.append((quint8)(TorcPList::BPLIST_NULL | (value ? TorcPList::BPLIST_TRUE : TorcPList::BPLIST_FALSE)));
-            return result;
+            object[0] = (quint8)(TorcPList::BPLIST_NULL | (Value.toBool() ? TorcPList::BPLIST_TRUE : TorcPList::BPLIST_FALSE));
+            return AddScalar(Dest, object, 1);
         }
         case QMetaType::Char:
         {
-            START_OBJECT
-            Dest.append((quint8)(TorcPList::BPLIST_NULL | TorcPList::BPLIST_FILL));
-            return result;
+            object[0] = (quint8)(TorcPList::BPLIST_NULL | TorcPList::BPLIST_FILL);
+            return AddScalar(Dest, object, 1);
         }
         case QMetaType::Int:
         case QMetaType::Short:
@@ -247,64 +325,22 @@ quint64 TorcBinaryPListSerialiser::BinaryFromVariant(QByteArray &Dest, const QSt
         case QMetaType::Float:
         case QMetaType::Double:
         {
-            START_OBJECT
-            double value = Value.toDouble();
-            Dest.append((quint8)(TorcPList::BPLIST_REAL | 3));
-#if Q_BYTE_ORDER == Q_BIG_ENDIAN && !defined (__VFP_FP__)
-            Dest.append(*((char*)&value));
-            Dest.append(*((char*)&value + 1));
-            Dest.append(*((char*)&value + 2));
-            Dest.append(*((char*)&value + 3));
-            Dest.append(*((char*)&value + 4));
-            Dest.append(*((char*)&value + 5));
-            Dest.append(*((char*)&value + 6));
-            Dest.append(*((char*)&value + 7));
-#else
-            Dest.append(*((char*)&value + 7));
-            Dest.append(*((char*)&value + 6));
-            Dest.append(*((char*)&value + 5));
-            Dest.append(*((char*)&value + 4));
-            Dest.append(*((char*)&value + 3));
-            Dest.append(*((char*)&value + 2));
-            Dest.append(*((char*)&value + 1));
-            Dest.append(*((char*)&value));
-#endif
-            return result;
+            object[0] = (quint8)(TorcPList::BPLIST_REAL | 3);
+            WriteDouble(object + 1, Value.toDouble());
+            return AddScalar(Dest, object, 9);
         }
         case QMetaType::UInt:
         case QMetaType::UShort:
         case QMetaType::ULong:
         case QMetaType::ULongLong:
         {
-            START_OBJECT
-            BinaryFromUInt(Dest, Value.toULongLong());
-            return result;
+            return AddScalar(Dest, object, WriteUInt(object, Value.toULongLong()));
         }
         case QMetaType::QDateTime:
         {
-            START_OBJECT
-            Dest.append((quint8)(TorcPList::BPLIST_DATE | 3));
-            double value = (double)Value.toDateTime().toTime_t();
-#if Q_BYTE_ORDER == Q_BIG_ENDIAN && !defined (__VFP_FP__)
-            Dest.append(*((char*)&value));
-            Dest.append(*((char*)&value + 1));
-            Dest.append(*((char*)&value + 2));
-            Dest.append(*((char*)&value + 3));
-            Dest.append(*((char*)&value + 4));
-            Dest.append(*((char*)&value + 5));
-            Dest.append(*((char*)&value + 6));
-            Dest.append(*((char*)&value + 7));
-#else
-            Dest.append(*((char*)&value + 7));
-            Dest.append(*((char*)&value + 6));
-            Dest.append(*((char*)&value + 5));
-            Dest.append(*((char*)&value + 4));
-            Dest.append(*((char*)&value + 3));
-            Dest.append(*((char*)&value + 2));
-            Dest.append(*((char*)&value + 1));
-            Dest.append(*((char*)&value));
-#endif
-            return result;
+            object[0] = (quint8)(TorcPList::BPLIST_DATE | 3);
+            WriteDouble(object + 1, (double)Value.toDateTime().toTime_t());
+            return AddScalar(Dest, object, 9);
         }
         case QMetaType::QString:
         default:
@@ -312,231 +348,90 @@ quint64 TorcBinaryPListSerialiser::BinaryFromVariant(QByteArray &Dest, const QSt
     }
 }
 
-quint64 TorcBinaryPListSerialiser::BinaryFromStringList(QByteArray &Dest, const QString &Name, const QStringList &Value)
-{
-    (void)Name;
-
-    quint64 result = m_objectOffsets.size();
-    START_OBJECT
-
-    int size = Value.size();
-    Dest.append((quint8)(TorcPList::BPLIST_ARRAY | (size < BPLIST_LOW_MAX ? size : BPLIST_LOW_MAX)));
-    if (size >= BPLIST_LOW_MAX)
-        BinaryFromUInt(Dest, size);
-
-    quint64 offset = Dest.size();
-    QByteArray references(size * m_referenceSize, 0);
-    Dest.append(references);
-
-    QStringList::const_iterator it = Value.constBegin();
-    for ( ; it != Value.constEnd(); ++it)
-        WriteReference(BinaryFromQString(Dest, (*it)), m_referenceSize, (quint8*)Dest.data(), offset);
-
-    return result;
-}
-
-quint64 TorcBinaryPListSerialiser::BinaryFromArray(QByteArray &Dest, const QString &Name, const QVariantList &Value)
-{
-    if (!Value.isEmpty())
-    {
-        int type = Value[0].type();
-
-        QVariantList::const_iterator it = Value.constBegin();
-        for ( ; it != Value.constEnd(); ++it)
-            if ((int)(*it).type() != type)
-                return BinaryFromQString(Dest, QStringLiteral("Error: QVariantList is not valid service return type"));
-    }
-
-    quint64 result = m_objectOffsets.size();
-    START_OBJECT
-
-    int size = Value.size();
-    Dest.append((quint8)(TorcPList::BPLIST_ARRAY | (size < BPLIST_LOW_MAX ? size : BPLIST_LOW_MAX)));
-    if (size >= BPLIST_LOW_MAX)
-        BinaryFromUInt(Dest, size);
-
-    quint64 offset = Dest.size();
-    QByteArray references(size * m_referenceSize, 0);
-    Dest.append(references);
-
-    QVariantList::const_iterator it = Value.constBegin();
-    for ( ; it != Value.constEnd(); ++it)
-        WriteReference(BinaryFromVariant(Dest, Name, (*it)), m_referenceSize, (quint8*)Dest.data(), offset);
-
-    return result;
-}
-
-quint64 TorcBinaryPListSerialiser::BinaryFromMap(QByteArray &Dest, const QString &Name, const QVariantMap &Value)
-{
-    (void)Name;
-
-    quint64 result = m_objectOffsets.size();
-    START_OBJECT
-
-    int size = Value.size();
-    Dest.append((quint8)(TorcPList::BPLIST_DICT | (size < BPLIST_LOW_MAX ? size : BPLIST_LOW_MAX)));
-    if (size >= BPLIST_LOW_MAX)
-        BinaryFromUInt(Dest, size);
-
-    quint64 offset = Dest.size();
-    QByteArray references(size * 2 * m_referenceSize, 0);
-    Dest.append(references);
-
-    QVariantMap::const_iterator it = Value.constBegin();
-    for ( ; it != Value.constEnd(); ++it)
-        WriteReference(BinaryFromQString(Dest, it.key()), m_referenceSize, (quint8*)Dest.data(), offset);
-
-    it = Value.begin();
-    for ( ; it != Value.end(); ++it)
-        WriteReference(BinaryFromVariant(Dest, it.key(), it.value()), m_referenceSize, (quint8*)Dest.data(), offset);
-
-    return result;
-}
-
+/*! \brief Add a string object, reusing the existing object if the string has already been added.
+ *
+ * Strings that are entirely ASCII are stored as such, all others as UTF-16BE.
+*/
 quint64 TorcBinaryPListSerialiser::BinaryFromQString(QByteArray &Dest, const QString &Value)
 {
-    static QTextCodec* textCodec = QTextCodec::codecForName("UTF-16BE");
-
     QHash<QString,quint64>::const_iterator it = m_strings.constFind(Value);
     if (it != m_strings.constEnd())
         return it.value();
 
     quint64 result = (quint64)m_objectOffsets.size();
     m_strings.insert(Value, result);
+    m_objectOffsets.append(Dest.size());
 
-    START_OBJECT
-
-    QByteArray output = textCodec->fromUnicode(Value);
-
-    quint64 size = (output.size() >> 1) - 1;
-
-    Dest.append((quint8)(TorcPList::BPLIST_UNICODE | (size < BPLIST_LOW_MAX ? size : BPLIST_LOW_MAX)));
-    if (size >= BPLIST_LOW_MAX)
-        BinaryFromUInt(Dest, size);
-
-    Dest.append(output.data() + 2, output.size() - 2);
-    return result;
-}
-
-inline void binaryFromUint(QByteArray &Dest, quint64 Value, uint8_t size)
-{
-    if (8 == size)
-    {
-        Dest.append(*((quint8*)&Value));
-        Dest.append(*((quint8*)&Value + 1));
-        Dest.append(*((quint8*)&Value + 2));
-        Dest.append(*((quint8*)&Value + 3));
-        Dest.append(*((quint8*)&Value + 4));
-        Dest.append(*((quint8*)&Value + 5));
-        Dest.append(*((quint8*)&Value + 6));
-        Dest.append(*((quint8*)&Value + 7));
-    }
-    else if (4 == size)
+    int size = Value.size();
+    const ushort* utf16 = Value.utf16();
+    bool ascii = true;
+    for (int i = 0; i < size; ++i)
     {
-        quint32 value32= qToBigEndian((quint32)(Value & 0xffffffff));
-        Dest.append(*((quint8*)&value32));
-        Dest.append(*((quint8*)&value32 + 1));
-        Dest.append(*((quint8*)&value32 + 2));
-        Dest.append(*((quint8*)&value32 + 3));
+        if (utf16[i] > 0x7f)
+        {
+            ascii = false;
+            break;
+        }
     }
-    else if (2 == size)
+
+    int marker = MarkerSize(size);
+    quint8* pointer = Extend(Dest, marker + (ascii ? size : size * 2));
+    pointer += WriteMarker(pointer, ascii ? TorcPList::BPLIST_STRING : TorcPList::BPLIST_UNICODE, size);
+
+    if (ascii)
     {
-        quint16 value16 = qToBigEndian((quint16)(Value & 0xffff));
-        Dest.append(*((quint8*)&value16));
-        Dest.append(*((quint8*)&value16 + 1));
+        for (int i = 0; i < size; ++i)
+            pointer[i] = (quint8)utf16[i];
     }
     else
     {
-        Dest.append((quint8)(Value & 0xff));
+        for (int i = 0; i < size; ++i, pointer += 2)
+            qToBigEndian<quint16>(utf16[i], pointer);
     }
+
+    return result;
 }
 
-void TorcBinaryPListSerialiser::BinaryFromData(QByteArray &Dest, const QVariant &Value)
+quint64 TorcBinaryPListSerialiser::BinaryFromData(QByteArray &Dest, const QVariant &Value)
 {
-    START_OBJECT
+    quint64 result = m_objectOffsets.size();
+    m_objectOffsets.append(Dest.size());
+
     QByteArray data = Value.toByteArray();
     if (data.isNull())
     {
         LOG(VB_GENERAL, LOG_ERR, QStringLiteral("Failed to retrieve binary data"));
-        Dest.append((quint8)(TorcPList::BPLIST_NULL | TorcPList::BPLIST_FALSE));
-        return;
+        Dest.append((char)(TorcPList::BPLIST_NULL | TorcPList::BPLIST_FALSE));
+        return result;
     }
 
     int size = data.size();
-    Dest.append((quint8)(TorcPList::BPLIST_DATA | (size < BPLIST_LOW_MAX ? size : BPLIST_LOW_MAX)));
-    if (size >= BPLIST_LOW_MAX)
-        BinaryFromUInt(Dest, size);
-    Dest.append(data);
+    quint8* pointer = Extend(Dest, MarkerSize(size) + size);
+    pointer += WriteMarker(pointer, TorcPList::BPLIST_DATA, size);
+    memcpy(pointer, data.constData(), size);
+    return result;
 }
 
-void TorcBinaryPListSerialiser::BinaryFromUuid(QByteArray &Dest, const QVariant &Value)
+/*! \brief Add a UID object.
+ *
+ * UIDs are limited to 64bits. TorcPList packs them into the last 8 bytes of a QUuid.
+*/
+quint64 TorcBinaryPListSerialiser::BinaryFromUuid(QByteArray &Dest, const QVariant &Value)
 {
-    START_OBJECT
+    quint8 object[9];
     QByteArray value = Value.toUuid().toRfc4122();
     if (value.size() == 16)
     {
-
-        quint64 buffer = (quint64)(qToBigEndian(*((quint64*)value.constData() + 8)));
-        uint8_t size = buffer <= UINT8_MAX ? 1 : buffer <= UINT16_MAX ? 2 : buffer <= UINT32_MAX ? 4 : 8;
-        Dest.append((quint8)(TorcPList::BPLIST_UID | (size -1)));
-        binaryFromUint(Dest, buffer, size);
-    }
-    else
-    {
-        LOG(VB_GENERAL, LOG_ERR, QStringLiteral("Unknown UUID binary with size %1 bytes").arg(value.size()));
-        Dest.append((quint8)(TorcPList::BPLIST_NULL | TorcPList::BPLIST_FALSE));
-    }
-}
-
-void TorcBinaryPListSerialiser::BinaryFromUInt(QByteArray &Dest, quint64 Value)
-{
-    uint8_t size = Value <= UINT8_MAX ? 0 : Value <= UINT16_MAX ? 1 : Value <= UINT32_MAX ? 2 : 3;
-    Dest.append((quint8)(TorcPList::BPLIST_UINT | size));
-    binaryFromUint(Dest, Value, 2 ^ size);
-}
-
-void TorcBinaryPListSerialiser::CountObjects(quint64 &Count, const QVariant &Value)
-{
-    switch (static_cast<QMetaType::Type>(Value.type()))
-    {
-        case QMetaType::QVariantMap:
-        {
-            QVariantMap map = Value.toMap();
-            QVariantMap::const_iterator it = map.constBegin();
-            for ( ; it != map.constEnd(); ++it)
-                CountObjects(Count, it.value());
-            Count += map.size();
-            return;
-        }
-        case QMetaType::QVariantList:
-        {
-            Count++;
-            bool dict = false;
-            QVariantList list = Value.toList();
-            QVariantList::const_iterator it = list.constBegin();
-            uint type = list.isEmpty() ? QMetaType::UnknownType : static_cast<QMetaType::Type>(list[0].type());
-            for ( ; it != list.constEnd(); ++it)
-            {
-                if ((*it).type() != type)
-                    dict = true;
-                CountObjects(Count, (*it));
-            }
-            if (dict)
-                Count += list.size();
-            return;
-        }
-        case (QVariant::Type)QMetaType::QStringList:
-        {
-            Count++;
-            QStringList list = Value.toStringList();
-            Count += list.size();
-            return;
-        }
-        default:
-            break;
+        quint64 uid = qFromBigEndian<quint64>((const uchar*)value.constData() + 8);
+        quint8 size = BytesNeeded(uid);
+        object[0] = (quint8)(TorcPList::BPLIST_UID | (size - 1));
+        WriteSized(object + 1, uid, size);
+        return AddScalar(Dest, object, 1 + size);
     }
 
-    Count++;
+    LOG(VB_GENERAL, LOG_ERR, QStringLiteral("Unknown UUID binary with size %1 bytes").arg(value.size()));
+    object[0] = (quint8)(TorcPList::BPLIST_NULL | TorcPList::BPLIST_FALSE);
+    return AddScalar(Dest, object, 1);
 }
 
 class TorcBinaryPListSerialiserFactory : public TorcSerialiserFactory
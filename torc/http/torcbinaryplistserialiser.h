@@ -2,7 +2,9 @@
 #define TORCBINARYPLISTSERIALISER_H
 
 // Qt
-#include <QDataStream>
+#include <QHash>
+#include <QStack>
+#include <QVector>
 
 // Torc
 #include "torcserialiser.h"
@@ -14,28 +16,43 @@ class TorcBinaryPListSerialiser : public TorcSerialiser
     virtual ~TorcBinaryPListSerialiser() = default;
 
     HTTPResponseType ResponseType         (void) override;
+    void             StartObject          (QByteArray &Dest, const QString &Name) override;
+    void             EndObject            (QByteArray &Dest) override;
+    void             StartArray           (QByteArray &Dest, const QString &Name) override;
+    void             EndArray             (QByteArray &Dest) override;
+    void             AddValue             (QByteArray &Dest, const QString &Name, const QVariant &Value) override;
 
   protected:
     void             Prepare              (QByteArray &) override;
     void             Begin                (QByteArray &Dest) override;
-    void             AddProperty          (QByteArray &Dest, const QString &Name, const QVariant &Value) override;
     void             End                  (QByteArray &Dest) override;
 
   private:
-    quint64          BinaryFromVariant    (QByteArray &Dest, const QString &Name, const QVariant &Value);
-    quint64          BinaryFromStringList (QByteArray &Dest, const QString &Name, const QStringList &Value);
-    quint64          BinaryFromArray      (QByteArray &Dest, const QString &Name, const QVariantList &Value);
-    quint64          BinaryFromMap        (QByteArray &Dest, const QString &Name, const QVariantMap &Value);
+    class Container
+    {
+      public:
+        quint64          m_object;
+        quint8           m_type;
+        QVector<quint64> m_keys;
+        QVector<quint64> m_values;
+    };
+
+    void             StartContainer       (QByteArray &Dest, const QString &Name, quint8 Type);
+    void             EndContainer         (void);
+    void             AddReference         (QByteArray &Dest, const QString &Name, quint64 Object);
+    quint64          AddScalar            (QByteArray &Dest, const quint8 *Object, int Size);
+    quint64          BinaryFromVariant    (QByteArray &Dest, const QVariant &Value);
     quint64          BinaryFromQString    (QByteArray &Dest, const QString &Value);
-    void             BinaryFromUInt       (QByteArray &Dest, quint64 Value);
-    void             BinaryFromUuid       (QByteArray &Dest, const QVariant &Value);
-    void             BinaryFromData       (QByteArray &Dest, const QVariant &Value);
-    void             CountObjects         (quint64 &Count, const QVariant &Value);
+    quint64          BinaryFromUuid       (QByteArray &Dest, const QVariant &Value);
+    quint64          BinaryFromData       (QByteArray &Dest, const QVariant &Value);
 
   private:
-    quint8                 m_referenceSize;
-    QList<quint64>         m_objectOffsets;
-    QHash<QString,quint64> m_strings;
+    quint8                    m_referenceSize;
+    QVector<quint64>          m_objectOffsets;
+    QHash<QString,quint64>    m_strings;
+    QHash<QByteArray,quint64> m_scalars;
+    QStack<Container>         m_containers;
+    QVector<Container>        m_completed;
 };
 
 #endif // TORCBINARYPLISTSERIALISER_H
@@ -308,6 +308,12 @@ const QMap<QString,QString>& TorcHTTPRequest::Queries(void) const
     return m_queries;
 }
 
+/// Return the body of the request (e.g. for POST and PUT requests).
+const QByteArray& TorcHTTPRequest::GetContent(void) const
+{
+    return m_content;
+}
+
 void TorcHTTPRequest::Respond(QTcpSocket *Socket)
 {
     if (!Socket)
@@ -1041,12 +1047,41 @@ QString TorcHTTPRequest::RangeToString(QPair<quint64, quint64> Range, qint64 Siz
 }
 
 void TorcHTTPRequest::Serialise(const QVariant &Data, const QString &Type)
+{
+    TorcSerialiser *serialiser = StartSerialise();
+    serialiser->AddProperty(m_responseContent, Type, Data);
+    FinishSerialise(serialiser);
+}
+
+/*! \brief Start streaming a serialised response directly into the response content.
+ *
+ * The serialiser is chosen from the request's Accept header. Add content using the serialiser's
+ * streaming interface, passing GetResponseContent() as the destination, and complete
+ * the response with FinishSerialise.
+*/
+TorcSerialiser* TorcHTTPRequest::StartSerialise(void)
 {
     TorcSerialiser *serialiser = TorcSerialiser::GetSerialiser(m_headers.value(QStringLiteral("Accept")));
     SetResponseType(serialiser->ResponseType());
-    serialiser->Serialise(m_responseContent, Data, Type);
-    SetResponseContent(m_responseContent);
-    delete serialiser;
+    m_responseFile = QString();
+    m_responseContent.clear();
+    serialiser->Start(m_responseContent);
+    return serialiser;
+}
+
+QByteArray& TorcHTTPRequest::GetResponseContent(void)
+{
+    return m_responseContent;
+}
+
+/*! \brief Complete a response started with StartSerialise. Serialiser is deleted.
+*/
+void TorcHTTPRequest::FinishSerialise(TorcSerialiser *Serialiser)
+{
+    if (!Serialiser)
+        return;
+    Serialiser->Finish(m_responseContent);
+    delete Serialiser;
 }
 
 /*! \brief Return true if the resource is unmodified.
@@ -154,10 +154,14 @@ class TorcHTTPRequest
     QString                GetCache                 (void) const;
     const QMap<QString,QString>& Headers            (void) const;
     const QMap<QString,QString>& Queries            (void) const;
+    const QByteArray&      GetContent               (void) const;
     bool                   GetAllowCORS             (void) const;
     void                   Respond                  (QTcpSocket *Socket);
     void                   Redirected               (const QString &Redirected);
     void                   Serialise                (const QVariant &Data, const QString &Type);
+    TorcSerialiser*        StartSerialise           (void);
+    void                   FinishSerialise          (TorcSerialiser *Serialiser);
+    QByteArray&            GetResponseContent       (void);
     bool                   Unmodified               (const QDateTime &LastModified);
     bool                   Unmodified               (void);
     void                   Authorise                (HTTPAuthorisation Authorisation);
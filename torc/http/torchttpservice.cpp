@@ -21,8 +21,10 @@
 */
 
 // Qt
+#include <QHash>
 #include <QObject>
 #include <QMetaType>
+#include <QVarLengthArray>
 #include <QMetaMethod>
 #include <QTime>
 #include <QDate>
@@ -38,14 +40,35 @@
 #include "torchttpservice.h"
 #include "torcexitcodes.h"
 
+// std
+#include <limits.h>
+
+/*! \class MethodParameters
+ *  \brief Precompiled invocation details for a single service method.
+ *
+ * Everything that can be derived from the QMetaMethod is resolved once, when the method is first seen for
+ * a given QMetaObject: the parameter names, a typed decoder for each parameter (selected by QMetaType id) and
+ * the layout of a single block of argument storage. An invocation then only needs to construct the arguments
+ * in place (on the stack), decode the supplied values directly into them and call the method.
+ *
+ * MethodParameters is immutable once constructed and is shared between all services using the same QMetaObject.
+*/
 class MethodParameters
 {
   public:
+    typedef bool (*StringDecoder)  (void *Dest, const QString  &Value);
+    typedef bool (*VariantDecoder) (void *Dest, const QVariant &Value);
+
     MethodParameters(int Index, QMetaMethod Method, int AllowedRequestTypes, const QString &ReturnType)
       : m_valid(false),
         m_index(Index),
         m_names(),
+        m_parameterNames(),
         m_types(),
+        m_offsets(),
+        m_stringDecoders(),
+        m_variantDecoders(),
+        m_storageSize(0),
         m_allowedRequestTypes(AllowedRequestTypes),
         m_returnType(ReturnType),
         m_method(Method)
@@ -108,113 +131,355 @@ class MethodParameters
             m_types.append(type);
         }
 
+        // compile the argument storage layout and per parameter decoders (index 0 is the return value)
+        for (int i = 0; i < m_types.size(); ++i)
+        {
+            int size = m_types[i] ? QMetaType::sizeOf(m_types[i]) : 0;
+            m_offsets.append(m_storageSize);
+            m_storageSize += (size + 7) & ~7;
+            m_parameterNames.append(i ? QString::fromLatin1(m_names[i]) : QString());
+            m_stringDecoders.append(i ? StringDecoderFor(m_types[i]) : nullptr);
+            m_variantDecoders.append(i ? VariantDecoderFor(m_types[i]) : nullptr);
+        }
+
         m_valid = true;
     }
 
     ~MethodParameters() = default;
 
-    /*! \brief Call the stored method with the arguments passed in via Queries.
+    /*! \brief Call the stored method with the arguments passed in via the request's queries and stream the result.
+     *
+     * Arguments are decoded before anything is written, so an invalid request leaves the response untouched. The
+     * return value is serialised straight from the argument storage into the response content.
      *
      * \note Invoke is not thread safe and any method exposed using this class MUST ensure thread safety.
     */
-    QVariant Invoke(QObject *Object, const QMap<QString,QString> &Queries, QString &ReturnType, bool &VoidResult)
+    bool Invoke(QObject *Object, TorcHTTPRequest &Request) const
     {
-        // this may be called by multiple threads simultaneously, so we need to create our own paramaters instance.
-        // N.B. QMetaObject::invokeMethod only supports up to 10 arguments (plus a return value)
-        void* parameters[11];
-        memset(parameters, 0, 11 * sizeof(void*));
-        int size = qMin(11, m_types.size());
-
         // check parameter count
-        if (Queries.size() != size - 1)
+        const QMap<QString,QString> &queries = Request.Queries();
+        if (queries.size() != m_types.size() - 1)
+        {
+            LOG(VB_GENERAL, LOG_ERR, QStringLiteral("Method '%1' expects %2 parameters, sent %3")
+               .arg(m_names.value(0).constData()).arg(m_types.size() - 1).arg(queries.size()));
+            return false;
+        }
+
+        // populate parameters from query and ensure each parameter is listed
+        Arguments arguments(*this);
+        for (int i = 1; i < m_types.size(); ++i)
         {
-            if (!m_names.isEmpty())
+            QMap<QString,QString>::const_iterator it = queries.constFind(m_parameterNames[i]);
+            if (it == queries.constEnd())
             {
-                LOG(VB_GENERAL, LOG_ERR, QStringLiteral("Method '%1' expects %2 parameters, sent %3")
-                   .arg(m_names.value(0).constData()).arg(size - 1).arg(Queries.size()));
+                LOG(VB_GENERAL, LOG_ERR, QStringLiteral("Parameter '%1' for method '%2' is missing")
+                    .arg(m_parameterNames[i], m_names.value(0).constData()));
+                return false;
+            }
+            if (!m_stringDecoders[i](arguments.m_pointers[i], it.value()))
+            {
+                InvalidParameter(i);
+                return false;
             }
-            return QVariant();
         }
 
-        // populate parameters from query and ensure each parameter is listed
-        QMap<QString,QString>::const_iterator it;
-        for (int i = 0; i < size; ++i)
+        arguments.Invoke(Object);
+        return arguments.Serialise(Request);
+    }
+
+    /*! \brief Call the stored method with named (map) or positional (list) parameters, as received via RPC.
+     *
+     * Values are decoded directly from the QVariant - primitive types are not converted to and from strings.
+    */
+    QVariant Invoke(QObject *Object, const QVariant &Parameters, QString &ReturnType, bool &VoidResult) const
+    {
+        int expected = m_types.size() - 1;
+        Arguments arguments(*this);
+
+        if (Parameters.type() == QVariant::Map)
         {
-            parameters[i] = QMetaType::create(m_types.value(i));
-            if (i)
+            QVariantMap map = Parameters.toMap();
+            if (map.size() != expected)
             {
-                it = Queries.constFind(m_names.value(i));
-                if (it == Queries.end())
+                LOG(VB_GENERAL, LOG_ERR, QStringLiteral("Method '%1' expects %2 parameters, sent %3")
+                   .arg(m_names.value(0).constData()).arg(expected).arg(map.size()));
+                return QVariant();
+            }
+
+            for (int i = 1; i < m_types.size(); ++i)
+            {
+                QVariantMap::const_iterator it = map.constFind(m_parameterNames[i]);
+                if (it == map.constEnd())
                 {
                     LOG(VB_GENERAL, LOG_ERR, QStringLiteral("Parameter '%1' for method '%2' is missing")
-                        .arg(m_names.value(i).constData(), m_names.value(0).constData()));
+                        .arg(m_parameterNames[i], m_names.value(0).constData()));
+                    return QVariant();
+                }
+                if (!Decode(i, arguments.m_pointers[i], it.value()))
+                {
+                    InvalidParameter(i);
                     return QVariant();
                 }
-                SetValue(parameters[i], it.value(), m_types.value(i));
             }
         }
+        else if (Parameters.type() == QVariant::List)
+        {
+            QVariantList list = Parameters.toList();
+            if (list.size() != expected)
+            {
+                LOG(VB_GENERAL, LOG_ERR, QStringLiteral("Method '%1' expects %2 parameters, sent %3")
+                   .arg(m_names.value(0).constData()).arg(expected).arg(list.size()));
+                return QVariant();
+            }
 
-        if (Object->qt_metacall(QMetaObject::InvokeMetaMethod, m_index, parameters) > -1)
-            LOG(VB_GENERAL, LOG_ERR, QStringLiteral("qt_metacall error"));
+            for (int i = 1; i < m_types.size(); ++i)
+            {
+                if (!Decode(i, arguments.m_pointers[i], list[i - 1]))
+                {
+                    InvalidParameter(i);
+                    return QVariant();
+                }
+            }
+        }
+        else if (!Parameters.isNull())
+        {
+            LOG(VB_GENERAL, LOG_ERR, QStringLiteral("Unknown parameter variant"));
+            return QVariant();
+        }
+        else if (expected > 0)
+        {
+            LOG(VB_GENERAL, LOG_ERR, QStringLiteral("Method '%1' expects %2 parameters, sent 0")
+               .arg(m_names.value(0).constData()).arg(expected));
+            return QVariant();
+        }
+
+        return arguments.Call(Object, ReturnType, VoidResult);
+    }
 
-        // handle QVariant return type where we don't want to lose visibility of the underlying type
-        int type = m_types.value(0);
-        if (type == QMetaType::QVariant)
+    /*! \class Arguments
+     *  \brief Argument storage for a single invocation.
+     *
+     * All arguments (and the return value) are constructed in place in one block of stack storage, laid out
+     * when the method was compiled.
+    */
+    class Arguments
+    {
+      public:
+        explicit Arguments(const MethodParameters &Method)
+          : m_pointers(),
+            m_method(Method),
+            m_storage(Method.m_storageSize)
         {
-            int newtype = static_cast<int>(reinterpret_cast<QVariant*>(parameters[0])->type());
-            if (newtype != type)
-                type = newtype;
+            // N.B. QMetaObject::invokeMethod only supports up to 10 arguments (plus a return value)
+            for (int i = 0; i < m_method.m_types.size(); ++i)
+                if (m_method.m_types[i])
+                    m_pointers[i] = QMetaType::construct(m_method.m_types[i], m_storage.data() + m_method.m_offsets[i], nullptr);
         }
 
-        // we cannot create a QVariant that is void and an invalid QVariant signals an error state,
-        // so flag directly
-        VoidResult      = type == QMetaType::Void;
-        QVariant result = type == QMetaType::Void ? QVariant() : QVariant(type, parameters[0]);
+       ~Arguments()
+        {
+            for (int i = 0; i < m_method.m_types.size(); ++i)
+                if (m_pointers[i])
+                    QMetaType::destruct(m_method.m_types[i], m_pointers[i]);
+        }
 
-        // free allocated parameters
-        for (int i = 0; i < size; ++i)
-            if (parameters[i])
-                QMetaType::destroy(m_types.at(i), parameters[i]);
+        void Invoke(QObject *Object)
+        {
+            if (Object->qt_metacall(QMetaObject::InvokeMetaMethod, m_method.m_index, m_pointers) > -1)
+                LOG(VB_GENERAL, LOG_ERR, QStringLiteral("qt_metacall error"));
+        }
+
+        QVariant Call(QObject *Object, QString &ReturnType, bool &VoidResult)
+        {
+            Invoke(Object);
+
+            // handle QVariant return type where we don't want to lose visibility of the underlying type
+            int type = m_method.m_types.value(0);
+            if (type == QMetaType::QVariant)
+            {
+                int newtype = static_cast<int>(reinterpret_cast<QVariant*>(m_pointers[0])->type());
+                if (newtype != type)
+                    type = newtype;
+            }
 
-        ReturnType = m_returnType;
-        return result;
+            // we cannot create a QVariant that is void and an invalid QVariant signals an error state,
+            // so flag directly
+            VoidResult = type == QMetaType::Void;
+            ReturnType = m_method.m_returnType;
+            if (VoidResult)
+                return QVariant();
+            if (m_method.m_types.value(0) == QMetaType::QVariant)
+                return *reinterpret_cast<QVariant*>(m_pointers[0]);
+            return QVariant(type, m_pointers[0]);
+        }
+
+        /*! \brief Stream the return value of an invoked method into the response for Request.
+         *
+         * QVariant results are serialised in place and other types are only wrapped (implicitly shared) - the
+         * result is not copied into an intermediate QVariantMap. Returns false if there is no valid result.
+        */
+        bool Serialise(TorcHTTPRequest &Request)
+        {
+            int type = m_method.m_types.value(0);
+            if (type == QMetaType::Void)
+            {
+                Request.SetResponseType(HTTPResponseNone);
+                return true;
+            }
+
+            QVariant wrapped;
+            const QVariant *result = &wrapped;
+            if (type == QMetaType::QVariant)
+                result = reinterpret_cast<QVariant*>(m_pointers[0]);
+            else
+                wrapped = QVariant(type, m_pointers[0]);
+
+            // an invalid QVariant signals an error state
+            if (!result->isValid())
+                return false;
+
+            TorcSerialiser *serialiser = Request.StartSerialise();
+            serialiser->AddProperty(Request.GetResponseContent(), m_method.m_returnType, *result);
+            Request.FinishSerialise(serialiser);
+            Request.SetAllowGZip(true);
+            return true;
+        }
+
+        void* m_pointers[11];
+
+      private:
+        const MethodParameters   &m_method;
+        QVarLengthArray<char,256> m_storage;
+
+      private:
+        Q_DISABLE_COPY(Arguments)
+    };
+
+    ///\brief Decode Value into the storage for parameter Index, returning false if Value is not valid for its type.
+    bool Decode(int Index, void *Dest, const QVariant &Value) const
+    {
+        if (m_variantDecoders[Index])
+            return m_variantDecoders[Index](Dest, Value);
+        return m_stringDecoders[Index](Dest, Value.toString());
     }
 
-    static void SetValue(void* Pointer, const QString &Value, int Type)
+    void InvalidParameter(int Index) const
     {
-        if (!Pointer)
-            return;
+        LOG(VB_GENERAL, LOG_ERR, QStringLiteral("Invalid value for parameter '%1' of method '%2'")
+            .arg(m_parameterNames[Index], m_names.value(0).constData()));
+    }
 
+    /*! \brief Return a decoder that converts a string (e.g. an HTTP query value) to Type.
+     *
+     * Numeric, date and time values must be complete and well formed. Strings are always accepted and
+     * boolean values are true only for 1, true, y and yes.
+    */
+    static StringDecoder StringDecoderFor(int Type)
+    {
         switch (Type)
         {
-            case QMetaType::QVariant:   *((QVariant*)Pointer)      = QVariant(Value); return;
-            case QMetaType::Char:       *((char*)Pointer)          = Value.isEmpty() ? 0 : Value.at(0).toLatin1(); return;
-            case QMetaType::UChar:      *((unsigned char*)Pointer) = Value.isEmpty() ? 0 :Value.at(0).toLatin1();  return;
-            case QMetaType::QChar:      *((QChar*)Pointer)         = Value.isEmpty() ? 0 : Value.at(0);            return;
-            case QMetaType::Bool:       *((bool*)Pointer)          = ToBool(Value);       return;
-            case QMetaType::Short:      *((short*)Pointer)         = Value.toShort();     return;
-            case QMetaType::UShort:     *((ushort*)Pointer)        = Value.toUShort();    return;
-            case QMetaType::Int:        *((int*)Pointer)           = Value.toInt();       return;
-            case QMetaType::UInt:       *((uint*)Pointer)          = Value.toUInt();      return;
-            case QMetaType::Long:       *((long*)Pointer)          = Value.toLong();      return;
-            case QMetaType::ULong:      *((ulong*)Pointer)         = Value.toULong();     return;
-            case QMetaType::LongLong:   *((qlonglong*)Pointer)     = Value.toLongLong();  return;
-            case QMetaType::ULongLong:  *((qulonglong*)Pointer)    = Value.toULongLong(); return;
-            case QMetaType::Double:     *((double*)Pointer)        = Value.toDouble();    return;
-            case QMetaType::Float:      *((float*)Pointer)         = Value.toFloat();     return;
-            case QMetaType::QString:    *((QString*)Pointer)       = Value;               return;
-            case QMetaType::QByteArray: *((QByteArray*)Pointer)    = Value.toUtf8();      return;
-            case QMetaType::QTime:      *((QTime*)Pointer)         = QTime::fromString(Value, Qt::ISODate); return;
-            case QMetaType::QDate:      *((QDate*)Pointer)         = QDate::fromString(Value, Qt::ISODate); return;
+            case QMetaType::QVariant:   return [](void *D, const QString &V) { *static_cast<QVariant*>(D) = QVariant(V); return true; };
+            case QMetaType::Char:       return [](void *D, const QString &V) { *static_cast<char*>(D) = V.isEmpty() ? 0 : V.at(0).toLatin1(); return V.size() < 2; };
+            case QMetaType::UChar:      return [](void *D, const QString &V) { *static_cast<unsigned char*>(D) = V.isEmpty() ? 0 : V.at(0).toLatin1(); return V.size() < 2; };
+            case QMetaType::QChar:      return [](void *D, const QString &V) { *static_cast<QChar*>(D) = V.isEmpty() ? QChar(0) : V.at(0); return V.size() < 2; };
+            case QMetaType::Bool:       return [](void *D, const QString &V) { *static_cast<bool*>(D) = ToBool(V); return true; };
+            case QMetaType::Short:      return [](void *D, const QString &V) { bool ok = false; *static_cast<short*>(D)      = V.toShort(&ok);     return ok; };
+            case QMetaType::UShort:     return [](void *D, const QString &V) { bool ok = false; *static_cast<ushort*>(D)     = V.toUShort(&ok);    return ok; };
+            case QMetaType::Int:        return [](void *D, const QString &V) { bool ok = false; *static_cast<int*>(D)        = V.toInt(&ok);       return ok; };
+            case QMetaType::UInt:       return [](void *D, const QString &V) { bool ok = false; *static_cast<uint*>(D)       = V.toUInt(&ok);      return ok; };
+            case QMetaType::Long:       return [](void *D, const QString &V) { bool ok = false; *static_cast<long*>(D)       = V.toLong(&ok);      return ok; };
+            case QMetaType::ULong:      return [](void *D, const QString &V) { bool ok = false; *static_cast<ulong*>(D)      = V.toULong(&ok);     return ok; };
+            case QMetaType::LongLong:   return [](void *D, const QString &V) { bool ok = false; *static_cast<qlonglong*>(D)  = V.toLongLong(&ok);  return ok; };
+            case QMetaType::ULongLong:  return [](void *D, const QString &V) { bool ok = false; *static_cast<qulonglong*>(D) = V.toULongLong(&ok); return ok; };
+            case QMetaType::Double:     return [](void *D, const QString &V) { bool ok = false; *static_cast<double*>(D)     = V.toDouble(&ok);    return ok; };
+            case QMetaType::Float:      return [](void *D, const QString &V) { bool ok = false; *static_cast<float*>(D)      = V.toFloat(&ok);     return ok; };
+            case QMetaType::QString:    return [](void *D, const QString &V) { *static_cast<QString*>(D) = V; return true; };
+            case QMetaType::QByteArray: return [](void *D, const QString &V) { *static_cast<QByteArray*>(D) = V.toUtf8(); return true; };
+            case QMetaType::QTime:
+                return [](void *D, const QString &V)
+                {
+                    QTime time = QTime::fromString(V, Qt::ISODate);
+                    *static_cast<QTime*>(D) = time;
+                    return time.isValid();
+                };
+            case QMetaType::QDate:
+                return [](void *D, const QString &V)
+                {
+                    QDate date = QDate::fromString(V, Qt::ISODate);
+                    *static_cast<QDate*>(D) = date;
+                    return date.isValid();
+                };
             case QMetaType::QDateTime:
-            {
-                QDateTime dt = QDateTime::fromString(Value, Qt::ISODate);
-                dt.setTimeSpec(Qt::UTC);
-                *((QDateTime*)Pointer) = dt;
-                return;
-            }
+                return [](void *D, const QString &V)
+                {
+                    QDateTime dt = QDateTime::fromString(V, Qt::ISODate);
+                    dt.setTimeSpec(Qt::UTC);
+                    *static_cast<QDateTime*>(D) = dt;
+                    return dt.isValid();
+                };
             default: break;
         }
+
+        // unknown types are left default constructed
+        return [](void*, const QString&) { return true; };
+    }
+
+    /*! \brief Return a direct decoder for Type or nullptr if the value should be decoded via its string representation.
+     *
+     * Numeric values must be numbers (or numeric strings) that fit the parameter type. Structured values
+     * (maps and lists) are never valid.
+    */
+    static VariantDecoder VariantDecoderFor(int Type)
+    {
+        switch (Type)
+        {
+            case QMetaType::QVariant:
+                return [](void *D, const QVariant &V) { *static_cast<QVariant*>(D) = V; return true; };
+            case QMetaType::Bool:
+                return [](void *D, const QVariant &V)
+                {
+                    if (V.type() == QVariant::String)
+                    {
+                        *static_cast<bool*>(D) = ToBool(V.toString());
+                        return true;
+                    }
+                    *static_cast<bool*>(D) = V.toBool();
+                    return V.canConvert<bool>() && !IsStructured(V);
+                };
+            case QMetaType::Short:
+                return [](void *D, const QVariant &V)
+                {
+                    bool ok = false;
+                    int value = V.toInt(&ok);
+                    *static_cast<short*>(D) = static_cast<short>(value);
+                    return ok && value >= SHRT_MIN && value <= SHRT_MAX;
+                };
+            case QMetaType::UShort:
+                return [](void *D, const QVariant &V)
+                {
+                    bool ok = false;
+                    uint value = V.toUInt(&ok);
+                    *static_cast<ushort*>(D) = static_cast<ushort>(value);
+                    return ok && value <= USHRT_MAX;
+                };
+            case QMetaType::Int:       return [](void *D, const QVariant &V) { bool ok = false; *static_cast<int*>(D)        = V.toInt(&ok);       return ok; };
+            case QMetaType::UInt:      return [](void *D, const QVariant &V) { bool ok = false; *static_cast<uint*>(D)       = V.toUInt(&ok);      return ok; };
+            case QMetaType::Long:      return [](void *D, const QVariant &V) { bool ok = false; *static_cast<long*>(D)       = static_cast<long>(V.toLongLong(&ok));    return ok; };
+            case QMetaType::ULong:     return [](void *D, const QVariant &V) { bool ok = false; *static_cast<ulong*>(D)      = static_cast<ulong>(V.toULongLong(&ok));  return ok; };
+            case QMetaType::LongLong:  return [](void *D, const QVariant &V) { bool ok = false; *static_cast<qlonglong*>(D)  = V.toLongLong(&ok);  return ok; };
+            case QMetaType::ULongLong: return [](void *D, const QVariant &V) { bool ok = false; *static_cast<qulonglong*>(D) = V.toULongLong(&ok); return ok; };
+            case QMetaType::Double:    return [](void *D, const QVariant &V) { bool ok = false; *static_cast<double*>(D)     = V.toDouble(&ok);    return ok; };
+            case QMetaType::Float:     return [](void *D, const QVariant &V) { bool ok = false; *static_cast<float*>(D)      = V.toFloat(&ok);     return ok; };
+            case QMetaType::QString:   return [](void *D, const QVariant &V) { *static_cast<QString*>(D) = V.toString(); return !IsStructured(V); };
+            default: break;
+        }
+
+        return nullptr;
+    }
+
+    static bool IsStructured(const QVariant &Value)
+    {
+        return Value.type() == QVariant::Map || Value.type() == QVariant::List || Value.type() == QVariant::Hash;
     }
 
     static bool ToBool(const QString &Value)
@@ -230,82 +495,90 @@ class MethodParameters
         return false;
     }
 
-    /*! \brief Disable this method
-    */
-    void Disable(void)
-    {
-        m_allowedRequestTypes |= HTTPDisabled;
-    }
-
-    /*! \brief Enable this method
-    */
-    void Enable(void)
-    {
-        if (m_allowedRequestTypes & HTTPDisabled)
-            m_allowedRequestTypes -= HTTPDisabled;
-    }
-
-    bool                m_valid;
-    int                 m_index;
-    QVector<QByteArray> m_names;
-    QVector<int>        m_types;
-    int                 m_allowedRequestTypes;
-    QString             m_returnType;
-    QMetaMethod         m_method;
+    bool                   m_valid;
+    int                    m_index;
+    QVector<QByteArray>    m_names;
+    QVector<QString>       m_parameterNames;
+    QVector<int>           m_types;
+    QVector<int>           m_offsets;
+    QVector<StringDecoder> m_stringDecoders;
+    QVector<VariantDecoder> m_variantDecoders;
+    int                    m_storageSize;
+    int                    m_allowedRequestTypes;
+    QString                m_returnType;
+    QMetaMethod            m_method;
 };
 
-/*! \class TorcHTTPService
+/*! \class TorcHTTPServiceMethods
+ *  \brief A cache of compiled method tables.
  *
- * \todo Support for complex parameter types via RPC (e.g. array etc).
- * \todo ProcessRequest implicitly assumes JSON-RPC (though applies to much of the RPC code).
+ * Method tables are compiled once for each QMetaObject (and blacklist) and shared by every service instance of
+ * that class - an installation may have hundreds of inputs, outputs and controls of the same type. The tables
+ * survive restarts and are only deleted on exit.
 */
-TorcHTTPService::TorcHTTPService(QObject *Parent, const QString &Signature, const QString &Name,
-                                 const QMetaObject &MetaObject, const QString &Blacklist)
-  : TorcHTTPHandler(TORC_SERVICES_DIR + Signature, Name),
-    m_httpServiceLock(QReadWriteLock::Recursive),
-    m_parent(Parent),
-    m_version(QStringLiteral("Unknown")),
-    m_methods(),
-    m_properties(),
-    m_subscribers(),
-    m_subscriberLock(QMutex::Recursive)
+class TorcHTTPServiceMethods
 {
-    static const QString defaultblacklisted(QStringLiteral("deleteLater,SubscriberDeleted,"));
-    QStringList blacklist = (defaultblacklisted + Blacklist).split(',');
-
-    m_parent->setObjectName(Name);
+  public:
+    typedef QHash<QString,MethodParameters*> Table;
 
-    // the parent MUST implement SubscriberDeleted.
-    if (MetaObject.indexOfSlot(QMetaObject::normalizedSignature("SubscriberDeleted(QObject*)")) < 0)
+    TorcHTTPServiceMethods()
+      : m_lock(),
+        m_tables()
     {
-        LOG(VB_GENERAL, LOG_ERR, QStringLiteral("Service '%1' has no SubscriberDeleted slot. This is a programmer error - exiting").arg(Name));
-        QCoreApplication::exit(TORC_EXIT_UNKOWN_ERROR);
-        return;
     }
 
-    // determine version
-    int index = MetaObject.indexOfClassInfo("Version");
-    if (index > -1)
-        m_version = MetaObject.classInfo(index).value();
-    else
-        LOG(VB_GENERAL, LOG_WARNING, QStringLiteral("Service '%1' is missing version information").arg(Name));
+   ~TorcHTTPServiceMethods()
+    {
+        foreach (Table *table, m_tables)
+        {
+            qDeleteAll(*table);
+            delete table;
+        }
+    }
 
-    // is this a secure service (all methods require authentication)
-    bool secure = MetaObject.indexOfClassInfo("Secure") > -1;
+    const Table* Find(const QMetaObject *Meta, const QString &Blacklist)
+    {
+        QMutexLocker locker(&m_lock);
+        return m_tables.value(qMakePair(Meta, Blacklist), nullptr);
+    }
 
-    // build a list of metaobjects from all superclasses as well.
-    QList<const QMetaObject*> metas;
-    metas.append(&MetaObject);
-    const QMetaObject* super = MetaObject.superClass();
-    while (super)
+    const Table* Insert(const QMetaObject *Meta, const QString &Blacklist, Table *NewTable)
     {
-        metas.append(super);
-        super = super->superClass();
+        QMutexLocker locker(&m_lock);
+        QPair<const QMetaObject*,QString> key(Meta, Blacklist);
+        // another thread may have compiled the same class in the meantime
+        if (m_tables.contains(key))
+        {
+            qDeleteAll(*NewTable);
+            delete NewTable;
+            return m_tables.value(key);
+        }
+        m_tables.insert(key, NewTable);
+        return NewTable;
     }
 
+  private:
+    QMutex m_lock;
+    QHash<QPair<const QMetaObject*,QString>,Table*> m_tables;
+
+  private:
+    Q_DISABLE_COPY(TorcHTTPServiceMethods)
+};
+
+Q_GLOBAL_STATIC(TorcHTTPServiceMethods, gServiceMethods)
+
+/*! \brief Build the method table for MetaObject (and its superclasses).
+ *
+ * This is only called for the first service instance of a given class - see TorcHTTPServiceMethods.
+*/
+static QHash<QString,MethodParameters*>* CompileMethods(const QMetaObject &MetaObject, const QList<const QMetaObject*> &Metas,
+                                                       const QStringList &Blacklist, bool Secure, const QString &Signature, const QString &Name)
+{
+    QHash<QString,MethodParameters*> *methods = new QHash<QString,MethodParameters*>();
+
     // analyse available methods. Build the list from the top superclass 'down' to ensure we pick up
     // overriden slots and discard duplicates
-    QListIterator<const QMetaObject*> it(metas);
+    QListIterator<const QMetaObject*> it(Metas);
     it.toBack();
     while (it.hasPrevious())
     {
@@ -322,7 +595,7 @@ TorcHTTPService::TorcHTTPService(QObject *Parent, const QString &Signature, cons
                 name = name.section('(', 0, 0);
 
                 // discard unwanted slots
-                if (blacklist.contains(name))
+                if (Blacklist.contains(name))
                     continue;
 
                 // any Q_CLASSINFO for this method?
@@ -348,7 +621,7 @@ TorcHTTPService::TorcHTTPService(QObject *Parent, const QString &Signature, cons
 
                 // determine allowed request types
                 int allowed = HTTPOptions;
-                if (secure)
+                if (Secure)
                     allowed |= HTTPAuth;
                 if (customallowed != HTTPUnknownType)
                 {
@@ -365,7 +638,7 @@ TorcHTTPService::TorcHTTPService(QObject *Parent, const QString &Signature, cons
                 }
                 else
                 {
-                    LOG(VB_GENERAL, LOG_ERR, QStringLiteral("Unable to determine request types of method '%1' for '%2' - ignoring").arg(name, m_name));
+                    LOG(VB_GENERAL, LOG_ERR, QStringLiteral("Unable to determine request types of method '%1' for '%2' - ignoring").arg(name, Name));
                     continue;
                 }
 
@@ -378,20 +651,20 @@ TorcHTTPService::TorcHTTPService(QObject *Parent, const QString &Signature, cons
                 {
                     // check whether method has already been identified from superclass - need to match whole 'signature'
                     // not just name
-                    if (m_methods.contains(name))
+                    if (methods->contains(name))
                     {
-                        MethodParameters *existing = m_methods.value(name);
+                        MethodParameters *existing = methods->value(name);
                         if (existing->m_method.methodSignature() == method.methodSignature() &&
                             existing->m_method.returnType()      == method.returnType())
                         {
                             LOG(VB_GENERAL, LOG_DEBUG, QStringLiteral("Method '%1' in class '%2' already found in superclass - overriding")
                                 .arg(method.methodSignature().constData(), meta->className()));
-                            existing = m_methods.take(name);
+                            existing = methods->take(name);
                             delete existing;
                         }
                     }
 
-                    m_methods.insert(name, parameters);
+                    methods->insert(name, parameters);
                 }
                 else
                 {
@@ -401,6 +674,63 @@ TorcHTTPService::TorcHTTPService(QObject *Parent, const QString &Signature, cons
         }
     }
 
+    return methods;
+}
+
+/*! \class TorcHTTPService
+ *
+ * \todo Support for complex parameter types via RPC (e.g. array etc).
+ * \todo ProcessRequest implicitly assumes JSON-RPC (though applies to much of the RPC code).
+*/
+TorcHTTPService::TorcHTTPService(QObject *Parent, const QString &Signature, const QString &Name,
+                                 const QMetaObject &MetaObject, const QString &Blacklist)
+  : TorcHTTPHandler(TORC_SERVICES_DIR + Signature, Name),
+    m_httpServiceLock(QReadWriteLock::Recursive),
+    m_parent(Parent),
+    m_version(QStringLiteral("Unknown")),
+    m_methods(nullptr),
+    m_properties(),
+    m_subscribers(),
+    m_subscriberLock(QMutex::Recursive)
+{
+    static const QString defaultblacklisted(QStringLiteral("deleteLater,SubscriberDeleted,"));
+    QStringList blacklist = (defaultblacklisted + Blacklist).split(',');
+
+    m_parent->setObjectName(Name);
+
+    // the parent MUST implement SubscriberDeleted.
+    if (MetaObject.indexOfSlot(QMetaObject::normalizedSignature("SubscriberDeleted(QObject*)")) < 0)
+    {
+        LOG(VB_GENERAL, LOG_ERR, QStringLiteral("Service '%1' has no SubscriberDeleted slot. This is a programmer error - exiting").arg(Name));
+        QCoreApplication::exit(TORC_EXIT_UNKOWN_ERROR);
+        return;
+    }
+
+    // determine version
+    int index = MetaObject.indexOfClassInfo("Version");
+    if (index > -1)
+        m_version = MetaObject.classInfo(index).value();
+    else
+        LOG(VB_GENERAL, LOG_WARNING, QStringLiteral("Service '%1' is missing version information").arg(Name));
+
+    // is this a secure service (all methods require authentication)
+    bool secure = MetaObject.indexOfClassInfo("Secure") > -1;
+
+    // build a list of metaobjects from all superclasses as well.
+    QList<const QMetaObject*> metas;
+    metas.append(&MetaObject);
+    const QMetaObject* super = MetaObject.superClass();
+    while (super)
+    {
+        metas.append(super);
+        super = super->superClass();
+    }
+
+    // retrieve the compiled method table for this class - compiling it if this is the first instance
+    m_methods = gServiceMethods()->Find(&MetaObject, Blacklist);
+    if (!m_methods)
+        m_methods = gServiceMethods()->Insert(&MetaObject, Blacklist, CompileMethods(MetaObject, metas, blacklist, secure, Signature, Name));
+
     // analyse properties from the full list of metaobjects
     int invalidindex = -1;
     foreach (const QMetaObject* meta, metas)
@@ -430,7 +760,7 @@ TorcHTTPService::TorcHTTPService(QObject *Parent, const QString &Signature, cons
 
 TorcHTTPService::~TorcHTTPService()
 {
-    qDeleteAll(m_methods);
+    // N.B. m_methods is shared and owned by gServiceMethods
 }
 
 QString TorcHTTPService::GetUIName(void)
@@ -471,12 +801,14 @@ void TorcHTTPService::ProcessHTTPRequest(const QString &PeerAddress, int PeerPor
         }
 
         Request.SetStatus(HTTP_OK);
-        Request.Serialise(m_version, TORC_SERVICE_VERSION);
+        TorcSerialiser *serialiser = Request.StartSerialise();
+        serialiser->AddValue(Request.GetResponseContent(), TORC_SERVICE_VERSION, m_version);
+        Request.FinishSerialise(serialiser);
         return;
     }
 
-    QMap<QString,MethodParameters*>::const_iterator it = m_methods.constFind(method);
-    if (it != m_methods.constEnd())
+    QHash<QString,MethodParameters*>::const_iterator it = m_methods->constFind(method);
+    if (it != m_methods->constEnd())
     {
         // filter out invalid request types
         if ((!(type & (*it)->m_allowedRequestTypes)) ||
@@ -499,27 +831,12 @@ void TorcHTTPService::ProcessHTTPRequest(const QString &PeerAddress, int PeerPor
         if (!MethodIsAuthorised(Request, (*it)->m_allowedRequestTypes))
             return;
 
-        QString type;
-        bool    voidresult;
-        QVariant result = (*it)->Invoke(m_parent, Request.Queries(), type, voidresult);
-
-        // is there a result
-        if (!voidresult)
-        {
-            // check for invocation errors
-            if (result.type() == QVariant::Invalid)
-            {
-                Request.SetStatus(HTTP_BadRequest);
-                Request.SetResponseType(HTTPResponseDefault);
-                return;
-            }
-
-            Request.Serialise(result, type);
-            Request.SetAllowGZip(true);
-        }
-        else
+        // invoke and stream any result directly into the response
+        if (!(*it)->Invoke(m_parent, Request))
         {
-            Request.SetResponseType(HTTPResponseNone);
+            Request.SetStatus(HTTP_BadRequest);
+            Request.SetResponseType(HTTPResponseDefault);
+            return;
         }
 
         Request.SetStatus(HTTP_OK);
@@ -536,8 +853,8 @@ QVariantMap TorcHTTPService::ProcessRequest(const QString &Method, const QVarian
     if (Connection && !method.isEmpty())
     {
         // find the correct method to invoke
-        QMap<QString,MethodParameters*>::const_iterator it = m_methods.constFind(method);
-        if (it != m_methods.constEnd())
+        QHash<QString,MethodParameters*>::const_iterator it = m_methods->constFind(method);
+        if (it != m_methods->constEnd())
         {
             // disallow methods based on state and authentication
             int types         = it.value()->m_allowedRequestTypes;
@@ -559,38 +876,10 @@ QVariantMap TorcHTTPService::ProcessRequest(const QString &Method, const QVarian
             }
             else
             {
-                // invoke it
-
-                // convert the parameters
-                QMap<QString,QString> params;
-                if (Parameters.type() == QVariant::Map)
-                {
-                    QVariantMap map = Parameters.toMap();
-                    QVariantMap::iterator it = map.begin();
-                    for ( ; it != map.end(); ++it)
-                        params.insert(it.key(), it.value().toString());
-                }
-                else if (Parameters.type() == QVariant::List)
-                {
-                    QVariantList list = Parameters.toList();
-                    if (list.size() <= (*it)->m_names.size())
-                    {
-                        for (int i = 0; i < list.size(); ++i)
-                            params.insert((*it)->m_names[i], list[i].toString());
-                    }
-                    else
-                    {
-                        LOG(VB_GENERAL, LOG_ERR, QStringLiteral("Too many parameters"));
-                    }
-                }
-                else if (!Parameters.isNull())
-                {
-                    LOG(VB_GENERAL, LOG_ERR, QStringLiteral("Unknown parameter variant"));
-                }
-
+                // invoke it - parameters are decoded directly from the request
                 QString type;
                 bool    voidresult = false;
-                QVariant results = (*it)->Invoke(m_parent, params, type, voidresult);
+                QVariant results = (*it)->Invoke(m_parent, Parameters, type, voidresult);
 
                 // check result
                 if (!voidresult)
@@ -773,8 +1062,8 @@ QVariantMap TorcHTTPService::GetServiceDetails(void)
     }
 
     QVariantList params;
-    QMap<QString,MethodParameters*>::const_iterator it2 = m_methods.constBegin();
-    for ( ; it2 != m_methods.constEnd(); ++it2)
+    QHash<QString,MethodParameters*>::const_iterator it2 = m_methods->constBegin();
+    for ( ; it2 != m_methods->constEnd(); ++it2)
     {
         QVariantMap map;
 
@@ -3,6 +3,7 @@
 
 // Qt
 #include <QMap>
+#include <QHash>
 #include <QMutex>
 #include <QReadWriteLock>
 #include <QMetaObject>
@@ -44,7 +45,7 @@ class TorcHTTPService : public TorcHTTPHandler
   private:
     QObject                               *m_parent;
     QString                                m_version;
-    QMap<QString,MethodParameters*>        m_methods;
+    const QHash<QString,MethodParameters*> *m_methods;
     QMap<int,int>                          m_properties;
     QList<QObject*>                        m_subscribers;
     QMutex                                 m_subscriberLock;
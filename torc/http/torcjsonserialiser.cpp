@@ -21,14 +21,30 @@
 */
 
 // Qt
-#include <QJsonDocument>
+#include <QLocale>
 
 // Torc
 #include "torcjsonserialiser.h"
 
+// std
+#include <math.h>
+
+#define JSON_MAX_EXACT_INTEGER 9007199254740992.0 // 2^53
+
+/*! \class TorcJSONSerialiser
+ *  \brief A serialiser for JSON formatted output.
+ *
+ * Output is generated directly into the destination buffer. The format is that of
+ * QJsonDocument::toJson(QJsonDocument::Compact) without the intermediate QJsonDocument
+ * and QJsonValue representations.
+ *
+ * Top level properties with a non-empty name are wrapped in an object.
+*/
 TorcJSONSerialiser::TorcJSONSerialiser(bool Javascript)
   : TorcSerialiser(),
-    m_javaScriptType(Javascript)
+    m_javaScriptType(Javascript),
+    m_wrapped(false),
+    m_containers()
 {
 }
 
@@ -43,24 +59,177 @@ void TorcJSONSerialiser::Prepare(QByteArray &)
 
 void TorcJSONSerialiser::Begin(QByteArray &)
 {
+    m_wrapped = false;
+    m_containers.clear();
+}
+
+void TorcJSONSerialiser::End(QByteArray &Dest)
+{
+    if (m_wrapped)
+        Dest.append('}');
+    m_wrapped = false;
+    m_containers.clear();
+}
+
+bool TorcJSONSerialiser::MixedLists(void) const
+{
+    return true;
+}
+
+void TorcJSONSerialiser::StartObject(QByteArray &Dest, const QString &Name)
+{
+    StartItem(Dest, Name);
+    Dest.append('{');
+    m_containers.append(qMakePair(true, false));
+}
+
+void TorcJSONSerialiser::EndObject(QByteArray &Dest)
+{
+    if (!m_containers.isEmpty())
+        m_containers.removeLast();
+    Dest.append('}');
+}
+
+void TorcJSONSerialiser::StartArray(QByteArray &Dest, const QString &Name)
+{
+    StartItem(Dest, Name);
+    Dest.append('[');
+    m_containers.append(qMakePair(false, false));
+}
+
+void TorcJSONSerialiser::EndArray(QByteArray &Dest)
+{
+    if (!m_containers.isEmpty())
+        m_containers.removeLast();
+    Dest.append(']');
+}
+
+void TorcJSONSerialiser::AddValue(QByteArray &Dest, const QString &Name, const QVariant &Value)
+{
+    StartItem(Dest, Name);
+
+    switch (static_cast<QMetaType::Type>(Value.type()))
+    {
+        case QMetaType::UnknownType:
+        case QMetaType::Nullptr:
+            Dest.append("null");
+            return;
+        case QMetaType::Bool:
+            Dest.append(Value.toBool() ? "true" : "false");
+            return;
+        case QMetaType::Int:
+        case QMetaType::Short:
+        case QMetaType::Long:
+        case QMetaType::LongLong:
+        case QMetaType::UInt:
+        case QMetaType::UShort:
+        case QMetaType::ULong:
+        case QMetaType::ULongLong:
+        case QMetaType::Float:
+        case QMetaType::Double:
+        {
+            // N.B. QJsonValue stores all numbers as double - and, like QJsonDocument, integral values that
+            // can be represented exactly are written as integers rather than in exponent form
+            double value = Value.toDouble();
+            if (!qIsFinite(value))
+                Dest.append("null");
+            else if (qAbs(value) <= JSON_MAX_EXACT_INTEGER && floor(value) == value)
+                Dest.append(QByteArray::number(static_cast<qint64>(value)));
+            else
+                Dest.append(QByteArray::number(value, 'g', QLocale::FloatingPointShortest));
+            return;
+        }
+        case QMetaType::QString:
+            AddString(Dest, *reinterpret_cast<const QString*>(Value.constData()));
+            return;
+        default:
+            AddString(Dest, Value.toString());
+            return;
+    }
 }
 
-void TorcJSONSerialiser::AddProperty(QByteArray &Dest, const QString &Name, const QVariant &Value)
+/*! \brief Add any separator and, within an object, the key for the next item.
+ *
+ * The first named top level property opens the wrapping object.
+*/
+void TorcJSONSerialiser::StartItem(QByteArray &Dest, const QString &Name)
 {
-    if (Name.isEmpty())
+    if (m_containers.isEmpty())
     {
-        Dest = QByteArray(QJsonDocument::fromVariant(Value).toJson(QJsonDocument::Compact));
+        if (Name.isEmpty())
+            return;
+
+        if (!m_wrapped)
+        {
+            Dest.append('{');
+            m_wrapped = true;
+        }
+        else
+        {
+            Dest.append(',');
+        }
+
+        AddString(Dest, Name);
+        Dest.append(':');
+        return;
     }
-    else
+
+    QPair<bool,bool> &container = m_containers.last();
+    if (container.second)
+        Dest.append(',');
+    container.second = true;
+
+    if (container.first)
     {
-        QVariantMap map;
-        map.insert(Name, Value);
-        Dest = QByteArray(QJsonDocument::fromVariant(map).toJson(QJsonDocument::Compact));
+        AddString(Dest, Name);
+        Dest.append(':');
     }
 }
 
-void TorcJSONSerialiser::End(QByteArray &)
+void TorcJSONSerialiser::AddString(QByteArray &Dest, const QString &Value)
 {
+    static const char hex[] = "0123456789abcdef";
+
+    QByteArray utf8 = Value.toUtf8();
+    const char* data = utf8.constData();
+    int size = utf8.size();
+
+    Dest.reserve(Dest.size() + size + 2);
+    Dest.append('"');
+
+    // copy unescaped runs in one go
+    int run = 0;
+    for (int i = 0; i < size; ++i)
+    {
+        uchar c = static_cast<uchar>(data[i]);
+        if (c >= 0x20 && c != '"' && c != '\\')
+            continue;
+
+        if (i > run)
+            Dest.append(data + run, i - run);
+        run = i + 1;
+
+        switch (c)
+        {
+            case '"':  Dest.append("\\\""); break;
+            case '\\': Dest.append("\\\\"); break;
+            case '\b': Dest.append("\\b");  break;
+            case '\f': Dest.append("\\f");  break;
+            case '\n': Dest.append("\\n");  break;
+            case '\r': Dest.append("\\r");  break;
+            case '\t': Dest.append("\\t");  break;
+            default:
+            {
+                char escape[6] = { '\\', 'u', '0', '0', hex[c >> 4], hex[c & 0xf] };
+                Dest.append(escape, 6);
+                break;
+            }
+        }
+    }
+
+    if (size > run)
+        Dest.append(data + run, size - run);
+    Dest.append('"');
 }
 
 class TorcJSONSerialiserFactory : public TorcSerialiserFactory
@@ -2,7 +2,7 @@
 #define TORCJSONSERIALISER_H
 
 // Qt
-#include <QTextStream>
+#include <QVector>
 
 // Torc
 #include "torcserialiser.h"
@@ -14,16 +14,27 @@ class TorcJSONSerialiser : public TorcSerialiser
     virtual ~TorcJSONSerialiser() = default;
 
     HTTPResponseType ResponseType       (void) override;
+    void             StartObject        (QByteArray &Dest, const QString &Name) override;
+    void             EndObject          (QByteArray &Dest) override;
+    void             StartArray         (QByteArray &Dest, const QString &Name) override;
+    void             EndArray           (QByteArray &Dest) override;
+    void             AddValue           (QByteArray &Dest, const QString &Name, const QVariant &Value) override;
 
   protected:
     void             Prepare            (QByteArray &) override;
     void             Begin              (QByteArray &) override;
-    void             AddProperty        (QByteArray &Dest, const QString &Name, const QVariant &Value) override;
-    void             End                (QByteArray &) override;
+    void             End                (QByteArray &Dest) override;
+    bool             MixedLists         (void) const override;
+
+  private:
+    void             StartItem          (QByteArray &Dest, const QString &Name);
+    static void      AddString          (QByteArray &Dest, const QString &Value);
 
   private:
     Q_DISABLE_COPY(TorcJSONSerialiser)
     bool             m_javaScriptType;
+    bool             m_wrapped;
+    QVector<QPair<bool,bool> > m_containers; // object, has items
 };
 
 #endif // TORCJSONSERIALISER_H
@@ -22,7 +22,9 @@
 
 #include "torcplaintextserialiser.h"
 
-TorcPlainTextSerialiser::TorcPlainTextSerialiser() : TorcSerialiser()
+TorcPlainTextSerialiser::TorcPlainTextSerialiser()
+  : TorcSerialiser(),
+    m_depth(0)
 {
 }
 
@@ -37,16 +39,41 @@ void TorcPlainTextSerialiser::Prepare(QByteArray &)
 
 void TorcPlainTextSerialiser::Begin(QByteArray &)
 {
+    m_depth = 0;
 }
 
 void TorcPlainTextSerialiser::End(QByteArray &)
 {
 }
 
-void TorcPlainTextSerialiser::AddProperty(QByteArray &Dest, const QString &Name, const QVariant &Value)
+/*! \brief Containers have no plain text representation - only the name is added.
+*/
+void TorcPlainTextSerialiser::StartObject(QByteArray &Dest, const QString &Name)
+{
+    if (m_depth++ < 1)
+        Dest.append(Name.toLocal8Bit() + "\r\n");
+}
+
+void TorcPlainTextSerialiser::EndObject(QByteArray &)
+{
+    m_depth--;
+}
+
+void TorcPlainTextSerialiser::StartArray(QByteArray &Dest, const QString &Name)
+{
+    StartObject(Dest, Name);
+}
+
+void TorcPlainTextSerialiser::EndArray(QByteArray &Dest)
+{
+    EndObject(Dest);
+}
+
+void TorcPlainTextSerialiser::AddValue(QByteArray &Dest, const QString &Name, const QVariant &Value)
 {
     // Name is added for consistency with other serialisers...
-    Dest = QByteArray(Name.toLocal8Bit() + "\r\n" + Value.toByteArray());
+    if (m_depth < 1)
+        Dest.append(Name.toLocal8Bit() + "\r\n" + Value.toByteArray());
 }
 
 class TorcPlainTextSerialiserFactory : public TorcSerialiserFactory
@@ -11,15 +11,20 @@ class TorcPlainTextSerialiser : public TorcSerialiser
    ~TorcPlainTextSerialiser() = default;
 
     HTTPResponseType ResponseType       (void) override;
+    void             StartObject        (QByteArray &Dest, const QString &Name) override;
+    void             EndObject          (QByteArray &) override;
+    void             StartArray         (QByteArray &Dest, const QString &Name) override;
+    void             EndArray           (QByteArray &) override;
+    void             AddValue           (QByteArray &Dest, const QString &Name, const QVariant &Value) override;
 
   protected:
     void             Prepare            (QByteArray &) override;
     void             Begin              (QByteArray &) override;
-    void             AddProperty        (QByteArray &Dest, const QString &Name, const QVariant &Value) override;
     void             End                (QByteArray &) override;
 
   private:
     Q_DISABLE_COPY(TorcPlainTextSerialiser)
+    int              m_depth;
 };
 
 #endif // TORCPLAINTEXTSERIALISER_H
@@ -32,6 +32,9 @@ HTTPResponseType TorcPListSerialiser::ResponseType(void)
 
 void TorcPListSerialiser::Begin(QByteArray &)
 {
+    // N.B. m_elements tracks whether each open container is a dict and hence needs keys
+    m_elements.clear();
+    m_elements.push(true);
     m_xmlStream.setAutoFormatting(true);
     m_xmlStream.setAutoFormattingIndent(4);
     m_xmlStream.writeStartDocument(QStringLiteral("1.0"));
@@ -41,39 +44,63 @@ void TorcPListSerialiser::Begin(QByteArray &)
     m_xmlStream.writeStartElement(QStringLiteral("dict"));
 }
 
-void TorcPListSerialiser::AddProperty(QByteArray &, const QString &Name, const QVariant &Value)
+void TorcPListSerialiser::End(QByteArray &)
 {
-    PListFromVariant(Name, Value);
+    m_elements.clear();
+    m_xmlStream.writeEndElement();
+    m_xmlStream.writeEndElement();
+    m_xmlStream.writeEndDocument();
+    m_buffer.close();
 }
 
-void TorcPListSerialiser::End(QByteArray &)
+void TorcPListSerialiser::AddKey(const QString &Name)
 {
+    if (!m_elements.isEmpty() && m_elements.top())
+        m_xmlStream.writeTextElement(QStringLiteral("key"), Name);
+}
+
+void TorcPListSerialiser::StartObject(QByteArray &, const QString &Name)
+{
+    AddKey(Name);
+    m_xmlStream.writeStartElement(QStringLiteral("dict"));
+    m_elements.push(true);
+}
+
+void TorcPListSerialiser::EndObject(QByteArray &)
+{
+    m_elements.pop();
     m_xmlStream.writeEndElement();
+}
+
+void TorcPListSerialiser::StartArray(QByteArray &, const QString &Name)
+{
+    AddKey(Name);
+    m_xmlStream.writeStartElement(QStringLiteral("array"));
+    m_elements.push(false);
+}
+
+void TorcPListSerialiser::EndArray(QByteArray &)
+{
+    m_elements.pop();
     m_xmlStream.writeEndElement();
-    m_xmlStream.writeEndDocument();
 }
 
-void TorcPListSerialiser::PListFromVariant(const QString &Name, const QVariant &Value, bool NeedKey)
+void TorcPListSerialiser::AddValue(QByteArray &, const QString &Name, const QVariant &Value)
 {
     if (Value.isNull())
     {
-        if (NeedKey)
-            m_xmlStream.writeTextElement(QStringLiteral("key"), Name);
+        AddKey(Name);
         m_xmlStream.writeEmptyElement(QStringLiteral("null"));
         return;
     }
 
     switch ((int)Value.type())
     {
-        case QMetaType::QVariantList: PListFromList(Name, Value.toList());             break;
-        case QMetaType::QStringList:  PListFromStringList(Name, Value.toStringList()); break;
-        case QMetaType::QVariantMap:  PListFromMap(Name, Value.toMap());               break;
         case QMetaType::QDateTime:
         {
             if (Value.toDateTime().isValid())
             {
-                if (NeedKey)
-                    m_xmlStream.writeTextElement(QStringLiteral("key"), Name);
+                AddKey(Name);
                 m_xmlStream.writeTextElement(QStringLiteral("date"), Value.toDateTime().toUTC().toString(QStringLiteral("yyyy-MM-ddThh:mm:ssZ")));
             }
             break;
@@ -82,34 +109,29 @@ void TorcPListSerialiser::PListFromVariant(const QString &Name, const QVariant &
         {
             if (!Value.toByteArray().isNull())
             {
-                if (NeedKey)
-                    m_xmlStream.writeTextElement(QStringLiteral("key"), Name);
+                AddKey(Name);
                 m_xmlStream.writeTextElement(QStringLiteral("data"), Value.toByteArray().toBase64().data());
             }
             break;
         }
         case QMetaType::Bool:
         {
-            if (NeedKey)
-                m_xmlStream.writeTextElement(QStringLiteral("key"), Name);
+            AddKey(Name);
             m_xmlStream.writeEmptyElement(Value.toBool() ? QStringLiteral("true") : QStringLiteral("false"));
             break;
         }
         case QMetaType::Char:
         {
-            if (NeedKey)
-                m_xmlStream.writeTextElement(QStringLiteral("key"), Name);
+            AddKey(Name);
             m_xmlStream.writeEmptyElement(QStringLiteral("fill"));
             break;
         }
-        break;
         case QMetaType::UInt:
         case QMetaType::UShort:
         case QMetaType::ULong:
         case QMetaType::ULongLong:
         {
-            if (NeedKey)
-                m_xmlStream.writeTextElement(QStringLiteral("key"), Name);
+            AddKey(Name);
             m_xmlStream.writeTextElement(QStringLiteral("integer"), QString::number(Value.toULongLong()));
             break;
         }
@@ -121,8 +143,7 @@ void TorcPListSerialiser::PListFromVariant(const QString &Name, const QVariant &
         case QMetaType::Float:
         case QMetaType::Double:
         {
-            if (NeedKey)
-                m_xmlStream.writeTextElement(QStringLiteral("key"), Name);
+            AddKey(Name);
             m_xmlStream.writeTextElement(QStringLiteral("real"), QStringLiteral("%1").arg(Value.toDouble(), 0, 'f', 6));
             break;
         }
@@ -130,65 +151,13 @@ void TorcPListSerialiser::PListFromVariant(const QString &Name, const QVariant &
         case QMetaType::QString:
         default:
         {
-            if (NeedKey)
-                m_xmlStream.writeTextElement(QStringLiteral("key"), Name);
+            AddKey(Name);
             m_xmlStream.writeTextElement(QStringLiteral("string"), Value.toString());
             break;
         }
     }
 }
 
-void TorcPListSerialiser::PListFromList(const QString &Name, const QVariantList &Value)
-{
-    if (!Value.isEmpty())
-    {
-        int type = Value[0].type();
-
-        QVariantList::const_iterator it = Value.begin();
-        for ( ; it != Value.end(); ++it)
-        {
-            if ((int)(*it).type() != type)
-            {
-                PListFromVariant(QStringLiteral("Error"), QVARIANT_ERROR);
-                return;
-            }
-        }
-    }
-
-    m_xmlStream.writeTextElement(QStringLiteral("key"), Name);
-    m_xmlStream.writeStartElement(QStringLiteral("array"));
-
-    QVariantList::const_iterator it = Value.begin();
-    for ( ; it != Value.end(); ++it)
-        PListFromVariant(Name, (*it), false);
-
-    m_xmlStream.writeEndElement();
-}
-
-void TorcPListSerialiser::PListFromStringList(const QString &Name, const QStringList &Value)
-{
-    m_xmlStream.writeTextElement(QStringLiteral("key"), Name);
-    m_xmlStream.writeStartElement(QStringLiteral("array"));
-
-    QStringList::const_iterator it = Value.begin();
-    for ( ; it != Value.end(); ++it)
-        m_xmlStream.writeTextElement(QStringLiteral("string"), (*it));
-
-    m_xmlStream.writeEndElement();
-}
-
-void TorcPListSerialiser::PListFromMap(const QString &Name, const QVariantMap &Value)
-{
-    m_xmlStream.writeTextElement(QStringLiteral("key"), Name);
-    m_xmlStream.writeStartElement(QStringLiteral("dict"));
-
-    QVariantMap::const_iterator it = Value.begin();
-    for ( ; it != Value.end(); ++it)
-        PListFromVariant(it.key(), it.value());
-
-    m_xmlStream.writeEndElement();
-}
-
 class TorcApplePListSerialiserFactory : public TorcSerialiserFactory
 {
   public:
@@ -11,16 +11,17 @@ class TorcPListSerialiser : public TorcXMLSerialiser
     virtual ~TorcPListSerialiser() = default;
 
     HTTPResponseType ResponseType        (void) override;
+    void             StartObject         (QByteArray &, const QString &Name) override;
+    void             EndObject           (QByteArray &) override;
+    void             StartArray          (QByteArray &, const QString &Name) override;
+    void             EndArray            (QByteArray &) override;
+    void             AddValue            (QByteArray &, const QString &Name, const QVariant &Value) override;
 
   protected:
     void             Begin               (QByteArray &) override;
-    void             AddProperty         (QByteArray &, const QString &Name, const QVariant &Value) override;
     void             End                 (QByteArray &) override;
 
-    void             PListFromVariant    (const QString &Name, const QVariant &Value, bool NeedKey = true);
-    void             PListFromList       (const QString &Name, const QVariantList &Value);
-    void             PListFromStringList (const QString &Name, const QStringList &Value);
-    void             PListFromMap        (const QString &Name, const QVariantMap &Value);
+    void             AddKey              (const QString &Name);
 };
 
 #endif // TORCPLISTSERIALISER_H
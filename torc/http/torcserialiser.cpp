@@ -75,14 +75,105 @@ TorcSerialiser* TorcSerialiser::GetSerialiser(const QString &MimeType)
     return new TorcXMLSerialiser();
 }
 
+/*! \brief Serialise Data into Dest as a single property named Type.
+ *
+ * This is a convenience wrapper around the streaming interface.
+*/
 void TorcSerialiser::Serialise(QByteArray &Dest, const QVariant &Data, const QString &Type)
+{
+    Start(Dest);
+    AddProperty(Dest, Type, Data);
+    Finish(Dest);
+}
+
+/*! \brief Start a new document in Dest.
+ *
+ * Following a call to Start, the caller adds one or more top level properties, either by
+ * passing a complete QVariant to AddProperty or by emitting the structure directly with
+ * StartObject/EndObject, StartArray/EndArray and AddValue. The document is completed with Finish.
+ *
+ * Output is written directly into Dest as it is generated, so large results do not need to be
+ * assembled into an intermediate QVariantMap first.
+ *
+ * \note Name is ignored for direct children of an array by those formats that do not need it
+ * (JSON and the property list formats). The XML serialiser uses it as the element name.
+*/
+void TorcSerialiser::Start(QByteArray &Dest)
 {
     Prepare(Dest);
     Begin(Dest);
-    AddProperty(Dest, Type, Data);
+}
+
+void TorcSerialiser::Finish(QByteArray &Dest)
+{
     End(Dest);
 }
 
+/*! \brief Walk Value and emit it through the streaming interface.
+*/
+void TorcSerialiser::AddProperty(QByteArray &Dest, const QString &Name, const QVariant &Value)
+{
+    switch (static_cast<QMetaType::Type>(Value.type()))
+    {
+        case QMetaType::QVariantMap:
+        {
+            QVariantMap map = Value.toMap();
+            StartObject(Dest, Name);
+            QVariantMap::const_iterator it = map.constBegin();
+            for ( ; it != map.constEnd(); ++it)
+                AddProperty(Dest, it.key(), it.value());
+            EndObject(Dest);
+            return;
+        }
+        case QMetaType::QVariantList:
+        {
+            QVariantList list = Value.toList();
+            if (!MixedLists() && !list.isEmpty())
+            {
+                int type = list.first().type();
+                QVariantList::const_iterator it = list.constBegin();
+                for ( ; it != list.constEnd(); ++it)
+                {
+                    if ((int)(*it).type() != type)
+                    {
+                        AddValue(Dest, QStringLiteral("Error"), QVARIANT_ERROR);
+                        return;
+                    }
+                }
+            }
+
+            StartArray(Dest, Name);
+            QVariantList::const_iterator it = list.constBegin();
+            for ( ; it != list.constEnd(); ++it)
+                AddProperty(Dest, Name, (*it));
+            EndArray(Dest);
+            return;
+        }
+        case QMetaType::QStringList:
+        {
+            QStringList list = Value.toStringList();
+            static const QString string(QStringLiteral("String"));
+            StartArray(Dest, Name);
+            QStringList::const_iterator it = list.constBegin();
+            for ( ; it != list.constEnd(); ++it)
+                AddValue(Dest, string, (*it));
+            EndArray(Dest);
+            return;
+        }
+        default:
+            break;
+    }
+
+    AddValue(Dest, Name, Value);
+}
+
+/*! \brief Return true if the format can represent a QVariantList with mixed content types.
+*/
+bool TorcSerialiser::MixedLists(void) const
+{
+    return false;
+}
+
 TorcSerialiserFactory* TorcSerialiserFactory::gTorcSerialiserFactory = nullptr;
 
 TorcSerialiserFactory::TorcSerialiserFactory(const QString &Type, const QString &SubType, const QString &Description)
@@ -22,11 +22,21 @@ class TorcSerialiser
     void                     Serialise      (QByteArray &Dest, const QVariant &Data, const QString &Type = QString());
     virtual HTTPResponseType ResponseType   (void) = 0;
 
+    // streaming interface
+    void                     Start          (QByteArray &Dest);
+    void                     Finish         (QByteArray &Dest);
+    void                     AddProperty    (QByteArray &Dest, const QString &Name, const QVariant &Value);
+    virtual void             StartObject    (QByteArray &Dest, const QString &Name) = 0;
+    virtual void             EndObject      (QByteArray &Dest) = 0;
+    virtual void             StartArray     (QByteArray &Dest, const QString &Name) = 0;
+    virtual void             EndArray       (QByteArray &Dest) = 0;
+    virtual void             AddValue       (QByteArray &Dest, const QString &Name, const QVariant &Value) = 0;
+
   protected:
     virtual void             Prepare        (QByteArray &Dest) = 0;
     virtual void             Begin          (QByteArray &Dest) = 0;
-    virtual void             AddProperty    (QByteArray &Dest, const QString &Name, const QVariant &Value) = 0;
     virtual void             End            (QByteArray &Dest) = 0;
+    virtual bool             MixedLists     (void) const;
 
   private:
     Q_DISABLE_COPY(TorcSerialiser)
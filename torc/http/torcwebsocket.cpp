@@ -54,6 +54,9 @@
  * \note To test using the Autobahn python test suite, configure the suite to
  *       request a connection using 'echo' as the method (e.g. 'http://your-ip-address:your-port/echo').
  *
+ * Outgoing messages larger than the fragment size (setting 'WebSocketFragmentSize', default WS_DEFAULT_FRAGMENT_SIZE)
+ * are sent as a sequence of continuation frames as the socket drains - see TorcWebSocketReader::SendFrame.
+ *
  * \todo Limit frame size for reading
  * \todo Fix testsuite partial failures (fail fast on invalid UTF-8)
  * \todo Add timeout for response to upgrade request
@@ -78,7 +81,10 @@ TorcWebSocket::TorcWebSocket(TorcWebSocketThread* Parent, qintptr SocketDescript
     m_subProtocolFrameFormat(TorcWebSocketReader::OpText),
     m_currentRequestID(1),
     m_currentRequests(),
-    m_requestTimers(),
+    m_batchTimer(),
+    m_batchedRequests(),
+    m_timeoutTimer(),
+    m_timeouts(),
     m_subscribers()
 {
     connect(&m_watchdogTimer, &QTimer::timeout, this, &TorcWebSocket::TimedOut);
@@ -104,7 +110,10 @@ TorcWebSocket::TorcWebSocket(TorcWebSocketThread* Parent, const QHostAddress &Ad
     m_subProtocolFrameFormat(TorcWebSocketReader::FormatForSubProtocol(Protocol)),
     m_currentRequestID(1),
     m_currentRequests(),
-    m_requestTimers(),
+    m_batchTimer(),
+    m_batchedRequests(),
+    m_timeoutTimer(),
+    m_timeouts(),
     m_subscribers()
 {
     // NB outgoing connection - do not start watchdog timer
@@ -112,6 +121,9 @@ TorcWebSocket::TorcWebSocket(TorcWebSocketThread* Parent, const QHostAddress &Ad
 
 TorcWebSocket::~TorcWebSocket()
 {
+    // drop any batched requests - the socket is going away and they will never be sent
+    DropBatch();
+
     // cancel any outstanding requests
     if (!m_currentRequests.isEmpty())
     {
@@ -431,9 +443,17 @@ void TorcWebSocket::Start(void)
     connect(this, &TorcWebSocket::Disconnect, this, &TorcWebSocket::CloseSocket);
     connect(this, &TorcWebSocket::bytesWritten, this, &TorcWebSocket::BytesWritten);
 
+    // outgoing RPC batching and request timeouts
+    m_batchTimer.setSingleShot(true);
+    m_batchTimer.setTimerType(Qt::PreciseTimer);
+    m_timeoutTimer.setTimerType(Qt::CoarseTimer);
+    connect(&m_batchTimer,   &QTimer::timeout, this, &TorcWebSocket::SendBatch);
+    connect(&m_timeoutTimer, &QTimer::timeout, this, &TorcWebSocket::TimeoutTick);
+
     // common setup
     m_reader.Reset();
     m_wsReader.Reset();
+    m_wsReader.SetFragmentSize(gLocalContext->GetSetting(QStringLiteral("WebSocketFragmentSize"), (int)WS_DEFAULT_FRAGMENT_SIZE));
 
     connect(this, static_cast<void (TorcWebSocket::*)(QAbstractSocket::SocketError)>(&TorcWebSocket::error), this, &TorcWebSocket::Error);
     connect(this, &TorcWebSocket::disconnected, this, &TorcWebSocket::Disconnected);
@@ -523,6 +543,10 @@ bool TorcWebSocket::HandleNotification(const QString &Method)
 }
 
 /*! \brief Initiate a Remote Procedure Call.
+ *
+ * Requests are not sent immediately. Any requests issued within RPC_BATCH_WINDOW milliseconds of each other
+ * are gathered together and sent as a single JSON-RPC batch (see SendBatch). Timeouts for all outstanding
+ * requests are managed by a single timer wheel rather than a timer per request.
  *
  * \note This should always be called from within the websocket's thread.
 */
@@ -531,11 +555,10 @@ void TorcWebSocket::RemoteRequest(TorcRPCRequest *Request)
     if (!Request)
         return;
 
-    bool notification = Request->IsNotification();
-
     // NB notitications cannot be cancelled - they are fire and forget.
     // NB other requests cannot be cancelled before this call is processed (they will not be present in m_currentRequests)
-    if (!notification)
+    // NB notifications are held (not DownRef'd) until the batch is sent
+    if (!Request->IsNotification())
     {
         Request->UpRef();
         int id = m_currentRequestID++;
@@ -544,25 +567,143 @@ void TorcWebSocket::RemoteRequest(TorcRPCRequest *Request)
 
         Request->SetID(id);
         m_currentRequests.insert(id, Request);
-
-        // start a timer for this request
-        m_requestTimers.insert(startTimer(10000, Qt::CoarseTimer), id);
+        AddRequestTimeout(id);
 
         // keep id's at sane values
         if (m_currentRequestID > 100000)
             m_currentRequestID = 1;
     }
 
-    Request->AddState(TorcRPCRequest::RequestSent);
+    m_batchedRequests.append(Request);
 
-    if (m_subProtocol != TorcWebSocketReader::SubProtocolNone)
-        m_wsReader.SendFrame(m_subProtocolFrameFormat, Request->SerialiseRequest(m_subProtocol));
-    else
+    if (m_batchedRequests.size() >= RPC_BATCH_MAX)
+        SendBatch();
+    else if (!m_batchTimer.isActive())
+        m_batchTimer.start(RPC_BATCH_WINDOW);
+}
+
+///\brief Discard any requests that have not yet been sent, failing those that expect a response.
+void TorcWebSocket::DropBatch(void)
+{
+    m_batchTimer.stop();
+
+    if (m_batchedRequests.isEmpty())
+        return;
+
+    LOG(VB_GENERAL, LOG_WARNING, QStringLiteral("%1 dropping %2 unsent RPC requests").arg(m_debug).arg(m_batchedRequests.size()));
+
+    QList<TorcRPCRequest*> requests = m_batchedRequests;
+    m_batchedRequests.clear();
+
+    foreach (TorcRPCRequest *request, requests)
+    {
+        if (!request->IsNotification())
+        {
+            int id = request->GetID();
+            RemoveRequestTimeout(id);
+            m_currentRequests.remove(id);
+            request->AddState(TorcRPCRequest::Errored);
+            request->NotifyParent();
+        }
+
+        request->DownRef();
+    }
+}
+
+///\brief Send all requests gathered since the batch window opened - as a JSON-RPC batch if there is more than one.
+void TorcWebSocket::SendBatch(void)
+{
+    m_batchTimer.stop();
+
+    if (m_batchedRequests.isEmpty())
+        return;
+
+    QList<TorcRPCRequest*> requests = m_batchedRequests;
+    m_batchedRequests.clear();
+
+    if (m_subProtocol == TorcWebSocketReader::SubProtocolNone)
+    {
         LOG(VB_GENERAL, LOG_ERR, QStringLiteral("No protocol specified for remote procedure call"));
+    }
+    else
+    {
+        if (requests.size() > 1)
+            LOG(VB_NETWORK, LOG_DEBUG, QStringLiteral("%1 sending batch of %2 requests").arg(m_debug).arg(requests.size()));
+        QByteArray batch = SerialiseBatch(requests, m_subProtocol);
+        m_wsReader.SendFrame(m_subProtocolFrameFormat, batch);
+    }
 
-    // notifications are fire and forget, so downref immediately
-    if (notification)
-        Request->DownRef();
+    // notifications are fire and forget, so downref now they are sent
+    foreach (TorcRPCRequest *request, requests)
+        if (request->IsNotification())
+            request->DownRef();
+}
+
+/*! \brief Serialise Requests as a single message - a JSON-RPC batch (array) if there is more than one.
+ *
+ * Each request is marked as sent.
+*/
+QByteArray TorcWebSocket::SerialiseBatch(const QList<TorcRPCRequest*> &Requests, TorcWebSocketReader::WSSubProtocol Protocol)
+{
+    if (Requests.size() == 1)
+    {
+        Requests.first()->AddState(TorcRPCRequest::RequestSent);
+        return Requests.first()->SerialiseRequest(Protocol);
+    }
+
+    QByteArray batch;
+    batch.append('[');
+    for (int i = 0; i < Requests.size(); ++i)
+    {
+        if (i)
+            batch.append(',');
+        Requests[i]->AddState(TorcRPCRequest::RequestSent);
+        batch.append(Requests[i]->SerialiseRequest(Protocol));
+    }
+    batch.append(']');
+    return batch;
+}
+
+///\brief Schedule a timeout for the request with the given ID.
+void TorcWebSocket::AddRequestTimeout(int ID)
+{
+    m_timeouts.Add(ID);
+
+    if (!m_timeoutTimer.isActive())
+        m_timeoutTimer.start(RPC_TIMEOUT_TICK);
+}
+
+void TorcWebSocket::RemoveRequestTimeout(int ID)
+{
+    m_timeouts.Remove(ID);
+
+    if (m_timeouts.IsEmpty())
+        m_timeoutTimer.stop();
+}
+
+///\brief Advance the timeout wheel and time out any requests in the new slot.
+void TorcWebSocket::TimeoutTick(void)
+{
+    QList<int> expired = m_timeouts.Tick();
+
+    foreach (int requestid, expired)
+    {
+        TorcRPCRequest *request = nullptr;
+        if (m_currentRequests.contains(requestid) && (request = m_currentRequests.value(requestid)))
+        {
+            request->AddState(TorcRPCRequest::TimedOut);
+            LOG(VB_GENERAL, LOG_WARNING, QStringLiteral("'%1' request timed out").arg(request->GetMethod()));
+
+            request->NotifyParent();
+
+            m_currentRequests.remove(requestid);
+            m_batchedRequests.removeOne(request);
+            request->DownRef();
+        }
+    }
+
+    if (m_timeouts.IsEmpty())
+        m_timeoutTimer.stop();
 }
 
 /*! \brief Cancel a Remote Procedure Call.
@@ -577,13 +718,12 @@ void TorcWebSocket::CancelRequest(TorcRPCRequest *Request)
         int id = Request->GetID();
         if (m_currentRequests.contains(id))
         {
-            // cancel the timer
-            int timer = m_requestTimers.key(id);
-            killTimer(timer);
-            m_requestTimers.remove(timer);
+            // cancel the timeout
+            RemoveRequestTimeout(id);
 
-            // cancel the request
+            // cancel the request (which may not have been sent yet)
             m_currentRequests.remove(id);
+            m_batchedRequests.removeOne(Request);
             Request->DownRef();
         }
         else
@@ -718,7 +858,7 @@ void TorcWebSocket::ReadyRead(void)
             {
                 // have a payload
                 ProcessPayload(m_wsReader.GetPayload());
-                m_wsReader.Reset();
+                m_wsReader.ResetRead();
             }
         }
 
@@ -978,43 +1118,10 @@ void TorcWebSocket::BytesWritten(qint64)
 {
     if (m_watchdogTimer.isActive())
         m_watchdogTimer.start();
-}
-
-bool TorcWebSocket::event(QEvent *Event)
-{
-    if (Event->type() == QEvent::Timer)
-    {
-        QTimerEvent *event = static_cast<QTimerEvent*>(Event);
-        if (event)
-        {
-            int timerid = event->timerId();
-
-            if (m_requestTimers.contains(timerid))
-            {
-                // remove the timer
-                int requestid = m_requestTimers.value(timerid);
-                killTimer(timerid);
-                m_requestTimers.remove(timerid);
-
-                // handle the timeout
-                TorcRPCRequest *request = nullptr;
-                if (m_currentRequests.contains(requestid) && (request = m_currentRequests.value(requestid)))
-                {
-                    request->AddState(TorcRPCRequest::TimedOut);
-                    LOG(VB_GENERAL, LOG_WARNING, QStringLiteral("'%1' request timed out").arg(request->GetMethod()));
-
-                    request->NotifyParent();
-
-                    m_currentRequests.remove(requestid);
-                    request->DownRef();
-                }
-
-                return true;
-            }
-        }
-    }
 
-    return QSslSocket::event(Event);
+    // continue sending any fragmented message now that the socket has drained
+    if (m_socketState == SocketState::Upgraded && m_wsReader.HasPending())
+        m_wsReader.SendPending();
 }
 
 void TorcWebSocket::SetState(SocketState State)
@@ -1038,115 +1145,176 @@ void TorcWebSocket::ProcessPayload(const QByteArray &Payload)
 {
     if (m_subProtocol == TorcWebSocketReader::SubProtocolJSONRPC)
     {
-        // NB there is no method to support SENDING batched requests (hence
-        // we should only receive batched requests from 3rd parties) and hence there
-        // is no support for handling batched responses.
+        // NB batched payloads may contain requests (from 3rd parties) and/or responses to our own batched requests.
         TorcRPCRequest *request = new TorcRPCRequest(m_subProtocol, Payload, this, m_authenticated);
 
         // if the request has data, we need to send it (it was a request!)
         if (!request->GetData().isEmpty())
-        {
             m_wsReader.SendFrame(m_subProtocolFrameFormat, request->GetData());
-        }
         // if the request has an id, we need to process it
         else if (request->GetID() > -1)
+            ProcessReply(request);
+
+        foreach (TorcRPCRequest *reply, request->GetBatchResponses())
+            if (reply->GetID() > -1)
+                ProcessReply(reply);
+
+        request->DownRef();
+    }
+}
+
+///\brief Match a response against its outstanding request and notify the requestor.
+void TorcWebSocket::ProcessReply(TorcRPCRequest *Reply)
+{
+    int id = Reply->GetID();
+    TorcRPCRequest *requestor = nullptr;
+    if (m_currentRequests.contains(id) && (requestor = m_currentRequests.value(id)))
+    {
+        RemoveRequestTimeout(id);
+
+        requestor->AddState(TorcRPCRequest::ReplyReceived);
+
+        if (Reply->GetState() & TorcRPCRequest::Errored)
         {
-            int id = request->GetID();
-            TorcRPCRequest *requestor = nullptr;
-            if (m_currentRequests.contains(id) && (requestor = m_currentRequests.value(id)))
+            requestor->AddState(TorcRPCRequest::Errored);
+        }
+        else
+        {
+            QString method = requestor->GetMethod();
+            // is this a successful response to a subscription request?
+            if (method.endsWith(QStringLiteral("/Subscribe")))
             {
-                requestor->AddState(TorcRPCRequest::ReplyReceived);
+                method.chop(9);
+                QObject *parent = requestor->GetParent();
 
-                if (request->GetState() & TorcRPCRequest::Errored)
+                if (parent->metaObject()->indexOfSlot(QMetaObject::normalizedSignature("ServiceNotification(QString)")) < 0)
                 {
-                    requestor->AddState(TorcRPCRequest::Errored);
+                    LOG(VB_GENERAL, LOG_ERR, QStringLiteral("Cannot monitor subscription to '%1' for object '%2' - no notification slot").arg(method, parent->objectName()));
                 }
-                else
+                else if (Reply->GetReply().type() == QVariant::Map)
                 {
-                    QString method = requestor->GetMethod();
-                    // is this a successful response to a subscription request?
-                    if (method.endsWith(QStringLiteral("/Subscribe")))
+                    // listen for destroyed signals to ensure the subscriptions are cleaned up
+                    connect(parent, &QObject::destroyed, this, &TorcWebSocket::SubscriberDeleted);
+
+                    QVariantMap map = Reply->GetReply().toMap();
+                    if (map.contains(QStringLiteral("properties")) && map.value(QStringLiteral("properties")).type() == QVariant::List)
                     {
-                        method.chop(9);
-                        QObject *parent = requestor->GetParent();
+                        QVariantList properties = map.value(QStringLiteral("properties")).toList();
 
-                        if (parent->metaObject()->indexOfSlot(QMetaObject::normalizedSignature("ServiceNotification(QString)")) < 0)
-                        {
-                            LOG(VB_GENERAL, LOG_ERR, QStringLiteral("Cannot monitor subscription to '%1' for object '%2' - no notification slot").arg(method, parent->objectName()));
-                        }
-                        else if (request->GetReply().type() == QVariant::Map)
+                        // add each notification/parent pair to the subscriber list
+                        QVariantList::const_iterator it = properties.constBegin();
+                        for ( ; it != properties.constEnd(); ++it)
                         {
-                            // listen for destroyed signals to ensure the subscriptions are cleaned up
-                            connect(parent, &QObject::destroyed, this, &TorcWebSocket::SubscriberDeleted);
-
-                            QVariantMap map = request->GetReply().toMap();
-                            if (map.contains(QStringLiteral("properties")) && map.value(QStringLiteral("properties")).type() == QVariant::List)
+                            if (it->type() == QVariant::Map)
                             {
-                                QVariantList properties = map.value(QStringLiteral("properties")).toList();
-
-                                // add each notification/parent pair to the subscriber list
-                                QVariantList::const_iterator it = properties.constBegin();
-                                for ( ; it != properties.constEnd(); ++it)
+                                QVariantMap property = it->toMap();
+                                if (property.contains(QStringLiteral("notification")))
                                 {
-                                    if (it->type() == QVariant::Map)
+                                    QString service = method + property.value(QStringLiteral("notification")).toString();
+                                    if (m_subscribers.contains(service, parent))
+                                    {
+                                        LOG(VB_GENERAL, LOG_WARNING, QStringLiteral("Object '%1' already has subscription to '%2'").arg(parent->objectName(), service));
+                                    }
+                                    else
                                     {
-                                        QVariantMap property = it->toMap();
-                                        if (property.contains(QStringLiteral("notification")))
-                                        {
-                                            QString service = method + property.value(QStringLiteral("notification")).toString();
-                                            if (m_subscribers.contains(service, parent))
-                                            {
-                                                LOG(VB_GENERAL, LOG_WARNING, QStringLiteral("Object '%1' already has subscription to '%2'").arg(parent->objectName(), service));
-                                            }
-                                            else
-                                            {
-                                                m_subscribers.insertMulti(service, parent);
-                                                LOG(VB_GENERAL, LOG_INFO, QStringLiteral("Object '%1' subscribed to '%2'").arg(parent->objectName(), service));
-                                            }
-                                        }
+                                        m_subscribers.insertMulti(service, parent);
+                                        LOG(VB_GENERAL, LOG_INFO, QStringLiteral("Object '%1' subscribed to '%2'").arg(parent->objectName(), service));
                                     }
                                 }
                             }
                         }
                     }
-                    // or a successful unsubscribe?
-                    else if (method.endsWith(QStringLiteral("/Unsubscribe")))
-                    {
-                        method.chop(11);
-                        QObject *parent = requestor->GetParent();
-
-                        // iterate over our subscriber list and remove anything that starts with method and points to parent
-                        QStringList remove;
-
-                        QMap<QString,QObject*>::const_iterator it = m_subscribers.constBegin();
-                        for ( ; it != m_subscribers.constEnd(); ++it)
-                            if (it.value() == parent && it.key().startsWith(method))
-                                remove.append(it.key());
+                }
+            }
+            // or a successful unsubscribe?
+            else if (method.endsWith(QStringLiteral("/Unsubscribe")))
+            {
+                method.chop(11);
+                QObject *parent = requestor->GetParent();
 
-                        foreach (const QString &signature, remove)
-                        {
-                            LOG(VB_GENERAL, LOG_INFO, QStringLiteral("Object '%1' unsubscribed from '%2'").arg(parent->objectName(), signature));
-                            m_subscribers.remove(signature, parent);
-                        }
+                // iterate over our subscriber list and remove anything that starts with method and points to parent
+                QStringList remove;
 
-                        // and disconnect the destroyed signal if we have no more subscriptions for this object
-                        if (std::find(m_subscribers.cbegin(), m_subscribers.cend(), parent) == m_subscribers.cend())
-                        {
-                            // temporary logging to ensure clazy optimisation is working correctly
-                            LOG(VB_GENERAL, LOG_INFO, QStringLiteral("'%1' disconnect - no more subscriptions").arg(parent->objectName()));
-                            (void)disconnect(parent, nullptr, this, nullptr);
-                        }
-                    }
+                QMap<QString,QObject*>::const_iterator it = m_subscribers.constBegin();
+                for ( ; it != m_subscribers.constEnd(); ++it)
+                    if (it.value() == parent && it.key().startsWith(method))
+                        remove.append(it.key());
 
-                    requestor->SetReply(request->GetReply());
+                foreach (const QString &signature, remove)
+                {
+                    LOG(VB_GENERAL, LOG_INFO, QStringLiteral("Object '%1' unsubscribed from '%2'").arg(parent->objectName(), signature));
+                    m_subscribers.remove(signature, parent);
                 }
 
-                requestor->NotifyParent();
-                m_currentRequests.remove(id);
-                requestor->DownRef();
+                // and disconnect the destroyed signal if we have no more subscriptions for this object
+                if (std::find(m_subscribers.cbegin(), m_subscribers.cend(), parent) == m_subscribers.cend())
+                {
+                    // temporary logging to ensure clazy optimisation is working correctly
+                    LOG(VB_GENERAL, LOG_INFO, QStringLiteral("'%1' disconnect - no more subscriptions").arg(parent->objectName()));
+                    (void)disconnect(parent, nullptr, this, nullptr);
+                }
             }
+
+            requestor->SetReply(Reply->GetReply());
         }
 
-        request->DownRef();
+        requestor->NotifyParent();
+        m_currentRequests.remove(id);
+        requestor->DownRef();
     }
 }
+
+/*! \class TorcRPCTimeouts
+ *  \brief A timer wheel for outstanding RPC requests.
+ *
+ * Each request is placed in the slot that the wheel reaches RPC_REQUEST_TIMEOUT / RPC_TIMEOUT_TICK ticks later, so
+ * adding, removing and expiring requests are all constant time. The owner must call Tick every RPC_TIMEOUT_TICK
+ * milliseconds while the wheel is not empty.
+*/
+TorcRPCTimeouts::TorcRPCTimeouts()
+  : m_wheel(RPC_TIMEOUT_SLOTS),
+    m_position(0),
+    m_slots()
+{
+}
+
+void TorcRPCTimeouts::Add(int ID)
+{
+    Remove(ID);
+
+    // +1 as the current slot is already partially elapsed
+    int slot = (m_position + (RPC_REQUEST_TIMEOUT / RPC_TIMEOUT_TICK) + 1) % RPC_TIMEOUT_SLOTS;
+    m_wheel[slot].append(ID);
+    m_slots.insert(ID, slot);
+}
+
+void TorcRPCTimeouts::Remove(int ID)
+{
+    QHash<int,int>::iterator it = m_slots.find(ID);
+    if (it != m_slots.end())
+    {
+        m_wheel[it.value()].removeOne(ID);
+        m_slots.erase(it);
+    }
+}
+
+///\brief Advance the wheel by one tick and return the IDs of any requests that have now timed out.
+QList<int> TorcRPCTimeouts::Tick(void)
+{
+    m_position = (m_position + 1) % RPC_TIMEOUT_SLOTS;
+    QList<int> expired = m_wheel[m_position];
+    m_wheel[m_position].clear();
+    foreach (int id, expired)
+        m_slots.remove(id);
+    return expired;
+}
+
+bool TorcRPCTimeouts::IsEmpty(void) const
+{
+    return m_slots.isEmpty();
+}
+
+int TorcRPCTimeouts::Count(void) const
+{
+    return m_slots.size();
+}
@@ -3,9 +3,11 @@
 
 // Qt
 #include <QUrl>
+#include <QHash>
 #include <QTimer>
 #include <QObject>
 #include <QSslSocket>
+#include <QVector>
 #include <QHostAddress>
 
 // Torc
@@ -20,6 +22,29 @@ class TorcWebSocketThread;
 #define HTTP_SOCKET_TIMEOUT 30000  // 30 seconds of inactivity
 #define FULL_SOCKET_TIMEOUT 300000 // 5 minutes of inactivity
 
+#define RPC_REQUEST_TIMEOUT  10000 // 10 seconds to receive a response
+#define RPC_TIMEOUT_TICK     1000  // resolution of the request timeout wheel
+#define RPC_TIMEOUT_SLOTS    16    // must be greater than RPC_REQUEST_TIMEOUT / RPC_TIMEOUT_TICK
+#define RPC_BATCH_WINDOW     5     // milliseconds to gather outgoing requests into a batch
+#define RPC_BATCH_MAX        64    // maximum requests in a single batch
+
+class TorcRPCTimeouts
+{
+  public:
+    TorcRPCTimeouts();
+
+    void            Add                   (int ID);
+    void            Remove                (int ID);
+    QList<int>      Tick                  (void);
+    bool            IsEmpty               (void) const;
+    int             Count                 (void) const;
+
+  private:
+    QVector<QList<int> > m_wheel;
+    int              m_position;
+    QHash<int,int>   m_slots;
+};
+
 class TorcWebSocket : public QSslSocket
 {
     Q_OBJECT
@@ -43,6 +68,8 @@ class TorcWebSocket : public QSslSocket
     ~TorcWebSocket();
 
     static QVariantList GetSupportedSubProtocols (void);
+    static QByteArray   SerialiseBatch           (const QList<TorcRPCRequest*> &Requests,
+                                                  TorcWebSocketReader::WSSubProtocol Protocol);
     bool            IsSecure              (void);
 
   signals:
@@ -70,9 +97,8 @@ class TorcWebSocket : public QSslSocket
     void            SubscriberDeleted     (QObject *Subscriber);
     void            TimedOut              (void);
     void            BytesWritten          (qint64);
-
-  protected:
-    bool            event                 (QEvent *Event) override;
+    void            SendBatch             (void);
+    void            TimeoutTick           (void);
 
   private:
     Q_DISABLE_COPY(TorcWebSocket)
@@ -82,6 +108,10 @@ class TorcWebSocket : public QSslSocket
     void            ReadHandshake         (void);
     void            ReadHTTP              (void);
     void            ProcessPayload        (const QByteArray &Payload);
+    void            ProcessReply          (TorcRPCRequest *Reply);
+    void            DropBatch             (void);
+    void            AddRequestTimeout     (int ID);
+    void            RemoveRequestTimeout  (int ID);
 
   private:
     TorcWebSocketThread *m_parent;
@@ -103,7 +133,10 @@ class TorcWebSocket : public QSslSocket
 
     int              m_currentRequestID;
     QMap<int,TorcRPCRequest*> m_currentRequests;
-    QMap<int,int>    m_requestTimers;
+    QTimer           m_batchTimer;
+    QList<TorcRPCRequest*> m_batchedRequests;
+    QTimer           m_timeoutTimer;
+    TorcRPCTimeouts  m_timeouts;
 
     QMultiMap<QString,QObject*> m_subscribers;   // client side
 };
@@ -136,7 +136,14 @@ TorcWebSocketReader::TorcWebSocketReader(QTcpSocket &Socket, WSSubProtocol Proto
     m_framePayloadLength(0),
     m_framePayloadReadPosition(0),
     m_frameMask(QByteArray(4, 0)),
-    m_framePayload(QByteArray())
+    m_framePayload(QByteArray()),
+    m_fragmentSize(WS_DEFAULT_FRAGMENT_SIZE),
+    m_sending(false),
+    m_sendOpCode(OpContinuation),
+    m_sendPayload(),
+    m_sendPosition(0),
+    m_queuedSmall(),
+    m_queuedLarge()
 {
 }
 
@@ -145,7 +152,15 @@ const QByteArray& TorcWebSocketReader::GetPayload(void)
     return m_haveBufferedPayload ? m_bufferedPayload : m_framePayload;
 }
 
+///\brief Reset the reader, discarding any partially read message and anything still waiting to be sent.
 void TorcWebSocketReader::Reset(void)
+{
+    ResetRead();
+    ClearPending();
+}
+
+///\brief Discard the current payload (once handled) and prepare to read the next frame.
+void TorcWebSocketReader::ResetRead(void)
 {
     m_haveBufferedPayload      = false;
     m_bufferedPayload          = QByteArray();
@@ -171,6 +186,27 @@ void TorcWebSocketReader::SetSubProtocol(WSSubProtocol Protocol)
     m_subProtocolFrameFormat = FormatForSubProtocol(Protocol);
 }
 
+///\brief Set the maximum payload size for outgoing frames. Larger messages are fragmented.
+void TorcWebSocketReader::SetFragmentSize(int Size)
+{
+    m_fragmentSize = qMax(Size, WS_MIN_FRAGMENT_SIZE);
+}
+
+///\brief Return true if part of a fragmented message (or messages queued behind it) remains to be sent.
+bool TorcWebSocketReader::HasPending(void)
+{
+    return m_sending || !m_queuedSmall.isEmpty() || !m_queuedLarge.isEmpty();
+}
+
+void TorcWebSocketReader::ClearPending(void)
+{
+    m_sending      = false;
+    m_sendPayload  = QByteArray();
+    m_sendPosition = 0;
+    m_queuedSmall.clear();
+    m_queuedLarge.clear();
+}
+
 void TorcWebSocketReader::InitiateClose(CloseCode Close, const QString &Reason)
 {
     if (!m_closeSent)
@@ -184,6 +220,17 @@ void TorcWebSocketReader::InitiateClose(CloseCode Close, const QString &Reason)
     }
 }
 
+/*! \brief Send, fragment or queue a message.
+ *
+ * Control frames are always sent immediately - they may legitimately be interleaved with the fragments
+ * of a data message. Data messages no larger than the fragment size are sent as a single final frame.
+ * Larger messages are split into continuation frames which are written as the socket drains (see SendPending),
+ * so a multi-megabyte payload neither needs to be copied into one frame nor monopolises the socket buffer.
+ *
+ * RFC 6455 does not allow the fragments of different data messages to be interleaved, so data messages
+ * submitted while a fragmented message is in flight are queued. Small messages jump ahead of any queued large
+ * messages and are sent as soon as the current message completes.
+*/
 void TorcWebSocketReader::SendFrame(OpCode Code, QByteArray &Payload)
 {
     // don't send if OpClose has already been sent or OpClose received and
@@ -191,78 +238,182 @@ void TorcWebSocketReader::SendFrame(OpCode Code, QByteArray &Payload)
     if (m_closeSent || (m_closeReceived && Code != OpClose))
         return;
 
-    QByteArray frame;
-    QByteArray mask;
-    QByteArray size;
+    // control frames cannot be fragmented and must not wait
+    if (Code & 0x8)
+    {
+        if (!WriteFrame(Code, true, Payload.constData(), Payload.size()) && Code != OpClose)
+            InitiateClose(CloseUnexpectedError, QStringLiteral("Send error"));
+        return;
+    }
+
+    bool small = Payload.size() <= m_fragmentSize;
+
+    if (m_sending)
+    {
+        if (small)
+            m_queuedSmall.enqueue(qMakePair(Code, Payload));
+        else
+            m_queuedLarge.enqueue(qMakePair(Code, Payload));
+        return;
+    }
+
+    if (small)
+    {
+        if (!WriteFrame(Code, true, Payload.constData(), Payload.size()))
+            InitiateClose(CloseUnexpectedError, QStringLiteral("Send error"));
+        return;
+    }
+
+    StartMessage(Code, Payload);
+}
+
+void TorcWebSocketReader::StartMessage(OpCode Code, const QByteArray &Payload)
+{
+    // NB Payload is implicitly shared - fragments are masked and written from it directly without a deep copy
+    m_sending      = true;
+    m_sendOpCode   = Code;
+    m_sendPayload  = Payload;
+    m_sendPosition = 0;
+    LOG(VB_NETWORK, LOG_DEBUG, QStringLiteral("Fragmenting %1 byte payload (%2 byte fragments)").arg(Payload.size()).arg(m_fragmentSize));
+    SendPending();
+}
+
+/*! \brief Write the next fragment(s) of the current outgoing message.
+ *
+ * Fragments are only written while the socket's write buffer holds less than one fragment, which keeps the buffer
+ * shallow enough for control frames to get through promptly. The owning socket must call this as bytes are written.
+*/
+void TorcWebSocketReader::SendPending(void)
+{
+    while (m_sending && !m_closeSent && !m_closeReceived && m_socket.bytesToWrite() < m_fragmentSize)
+    {
+        int remaining = m_sendPayload.size() - m_sendPosition;
+        int length    = qMin(remaining, m_fragmentSize);
+        bool final    = length == remaining;
+        OpCode code   = m_sendPosition ? OpContinuation : m_sendOpCode;
+
+        if (!WriteFrame(code, final, m_sendPayload.constData() + m_sendPosition, length))
+        {
+            ClearPending();
+            InitiateClose(CloseUnexpectedError, QStringLiteral("Send error"));
+            return;
+        }
+
+        m_sendPosition += length;
+
+        if (final)
+        {
+            m_sending      = false;
+            m_sendPayload  = QByteArray();
+            m_sendPosition = 0;
+
+            // flush anything small that was waiting on this message
+            while (!m_queuedSmall.isEmpty())
+            {
+                QPair<OpCode,QByteArray> next = m_queuedSmall.dequeue();
+                if (!WriteFrame(next.first, true, next.second.constData(), next.second.size()))
+                {
+                    ClearPending();
+                    InitiateClose(CloseUnexpectedError, QStringLiteral("Send error"));
+                    return;
+                }
+            }
+
+            // and start the next large message
+            if (!m_queuedLarge.isEmpty())
+            {
+                QPair<OpCode,QByteArray> next = m_queuedLarge.dequeue();
+                m_sending      = true;
+                m_sendOpCode   = next.first;
+                m_sendPayload  = next.second;
+            }
+        }
+    }
 
-    // no fragmentation yet - so this is always the final fragment
-    frame.append(Code | 0x80);
+    if (m_closeSent || m_closeReceived)
+        ClearPending();
+}
+
+/*! \brief Compose and write a single websocket frame.
+ *
+ * \note If this is a client side socket, the frame payload is masked into a copy - Data is not modified.
+*/
+bool TorcWebSocketReader::WriteFrame(OpCode Code, bool Final, const char *Data, int Length)
+{
+    QByteArray frame;
+    frame.reserve(14 + (m_serverSide ? 0 : Length));
+    frame.append(Code | (Final ? 0x80 : 0x00));
 
     quint8 byte = 0;
+    char mask[4];
 
     // is this masked
     if (!m_serverSide)
     {
         for (int i = 0; i < 4; ++i)
-            mask.append(qrand() % 0x100);
+            mask[i] = qrand() % 0x100;
 
         byte |= 0x80;
     }
 
     // generate correct size
-    quint64 length = Payload.size();
+    quint64 length = Length;
 
     if (length < 126)
     {
         byte |= length;
+        frame.append(byte);
     }
     else if (length <= 0xffff)
     {
         byte |= 126;
-        size.append((length >> 8) & 0xff);
-        size.append(length & 0xff);
+        frame.append(byte);
+        frame.append((length >> 8) & 0xff);
+        frame.append(length & 0xff);
     }
     else if (length <= 0x7fffffff)
     {
         byte |= 127;
-        size.append((length >> 56) & 0xff);
-        size.append((length >> 48) & 0xff);
-        size.append((length >> 40) & 0xff);
-        size.append((length >> 32) & 0xff);
-        size.append((length >> 24) & 0xff);
-        size.append((length >> 16) & 0xff);
-        size.append((length >> 8 ) & 0xff);
-        size.append((length      ) & 0xff);
+        frame.append(byte);
+        frame.append((length >> 56) & 0xff);
+        frame.append((length >> 48) & 0xff);
+        frame.append((length >> 40) & 0xff);
+        frame.append((length >> 32) & 0xff);
+        frame.append((length >> 24) & 0xff);
+        frame.append((length >> 16) & 0xff);
+        frame.append((length >> 8 ) & 0xff);
+        frame.append((length      ) & 0xff);
     }
     else
     {
         LOG(VB_GENERAL, LOG_ERR, QStringLiteral("Infeasibly large payload!"));
-        return;
+        return false;
     }
 
-    frame.append(byte);
-    if (!size.isEmpty())
-        frame.append(size);
-
     if (!m_serverSide)
     {
-        frame.append(mask);
-        for (int i = 0; i < Payload.size(); ++i)
-            Payload[i] = Payload[i] ^ mask[i % 4];
+        // client frames are small enough (fragmented) to be masked and written in one go
+        frame.append(mask, 4);
+        int offset = frame.size();
+        frame.resize(offset + Length);
+        char *dest = frame.data() + offset;
+        for (int i = 0; i < Length; ++i)
+            dest[i] = Data[i] ^ mask[i % 4];
+
+        if (m_socket.write(frame) != frame.size())
+            return false;
     }
-
-    if (m_socket.write(frame) == frame.size())
+    else
     {
-        if ((!Payload.isEmpty() && m_socket.write(Payload) == Payload.size()) || Payload.isEmpty())
-        {
-            LOG(VB_NETWORK, LOG_DEBUG, QStringLiteral("Sent frame (Final), OpCode: '%1' Masked: %2 Length: %3")
-                .arg(OpCodeToString(Code)).arg(!m_serverSide).arg(Payload.size()));
-            return;
-        }
+        if (m_socket.write(frame) != frame.size())
+            return false;
+        if (Length > 0 && m_socket.write(Data, Length) != Length)
+            return false;
     }
 
-    if (Code != OpClose)
-        InitiateClose(CloseUnexpectedError, QStringLiteral("Send error"));
+    LOG(VB_NETWORK, LOG_DEBUG, QStringLiteral("Sent frame (%1), OpCode: '%2' Masked: %3 Length: %4")
+        .arg(Final ? QStringLiteral("Final") : QStringLiteral("Fragment"), OpCodeToString(Code)).arg(!m_serverSide).arg(Length));
+    return true;
 }
 
 void TorcWebSocketReader::HandlePing(QByteArray &Payload)
@@ -280,10 +431,7 @@ void TorcWebSocketReader::HandlePong(QByteArray &Payload)
     (void)Payload;
 }
 
-/*! \brief Compose and send a properly formatted websocket frame.
- *
- * \note If this is a client side socket, Payload will be masked in place.
-*/
+///\brief Validate a close request from the remote end and echo it back.
 void TorcWebSocketReader::HandleCloseRequest(QByteArray &Close)
 {
     CloseCode newclosecode = CloseNormal;
@@ -637,7 +785,7 @@ bool TorcWebSocketReader::Read(void)
                             else
                             {
                                 // we only return true when the parent needs to handle the payload
-                                // and MUST then call reset()
+                                // and MUST then call ResetRead()
                                 return true;
                             }
                         }
@@ -2,11 +2,15 @@
 #define TORCWEBSOCKETREADER_H
 
 // Qt
+#include <QQueue>
 #include <QTcpSocket>
 
 // Torc
 #define TORC_JSON_RPC QStringLiteral("torc.json-rpc")
 
+#define WS_DEFAULT_FRAGMENT_SIZE 16384 // outgoing payloads larger than this are fragmented
+#define WS_MIN_FRAGMENT_SIZE     1024
+
 class TorcWebSocketReader
 {
     friend class TorcWebSocket;
@@ -82,14 +86,21 @@ class TorcWebSocketReader
 
     const QByteArray& GetPayload         (void);
     void              Reset              (void);
+    void              ResetRead          (void);
     bool              CloseSent          (void);
     void              SendFrame          (OpCode Code, QByteArray &Payload);
+    void              SendPending        (void);
+    bool              HasPending         (void);
+    void              SetFragmentSize    (int Size);
     void              InitiateClose      (CloseCode Close, const QString &Reason);
     bool              Read               (void);
     void              EnableEcho         (void);
     void              SetSubProtocol     (WSSubProtocol Protocol);
 
   private:
+    bool              WriteFrame         (OpCode Code, bool Final, const char *Data, int Length);
+    void              StartMessage       (OpCode Code, const QByteArray &Payload);
+    void              ClearPending       (void);
     void              HandlePing         (QByteArray &Payload);
     void              HandlePong         (QByteArray &Payload);
     void              HandleCloseRequest (QByteArray &Close);
@@ -124,6 +135,15 @@ class TorcWebSocketReader
     quint64        m_framePayloadReadPosition;
     QByteArray     m_frameMask;
     QByteArray     m_framePayload;
+
+    // Write state
+    int            m_fragmentSize;
+    bool           m_sending;
+    OpCode         m_sendOpCode;
+    QByteArray     m_sendPayload;
+    int            m_sendPosition;
+    QQueue<QPair<OpCode,QByteArray> > m_queuedSmall;
+    QQueue<QPair<OpCode,QByteArray> > m_queuedLarge;
 };
 
 Q_DECLARE_OPERATORS_FOR_FLAGS(TorcWebSocketReader::WSSubProtocols)
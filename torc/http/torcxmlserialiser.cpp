@@ -33,7 +33,8 @@
 TorcXMLSerialiser::TorcXMLSerialiser()
   : TorcSerialiser(),
     m_xmlStream(),
-    m_buffer()
+    m_buffer(),
+    m_elements()
 {
 }
 
@@ -52,6 +53,7 @@ void TorcXMLSerialiser::Prepare(QByteArray &Dest)
 void TorcXMLSerialiser::Begin(QByteArray &Dest)
 {
     (void)Dest;
+    m_elements.clear();
     m_xmlStream.writeStartDocument(QStringLiteral("1.0"));
 }
 
@@ -59,84 +61,70 @@ void TorcXMLSerialiser::End(QByteArray &Dest)
 {
     (void)Dest;
     m_xmlStream.writeEndDocument();
+    m_buffer.close();
 }
 
-void TorcXMLSerialiser::AddProperty(QByteArray &Dest, const QString &Name, const QVariant &Value)
+/*! \brief Open an element for Name.
+ *
+ * An empty name (typically an unnamed top level property) does not open an element. Array items
+ * are named by the array.
+*/
+void TorcXMLSerialiser::StartElement(const QString &Name)
 {
-    (void)Dest;
-    if (!Name.isEmpty())
+    bool element = !Name.isEmpty();
+    if (element)
         m_xmlStream.writeStartElement(Name);
-    VariantToXML(Name, Value);
-    if (!Name.isEmpty())
-        m_xmlStream.writeEndElement();
+    m_elements.push(element);
 }
 
-void TorcXMLSerialiser::VariantToXML(const QString &Name, const QVariant &Value)
+void TorcXMLSerialiser::EndElement(void)
 {
-    switch(static_cast<QMetaType::Type>(Value.type()))
-    {
-        case QMetaType::QVariantList: ListToXML(Name, Value.toList());             return;
-        case QMetaType::QStringList:  StringListToXML(Name, Value.toStringList()); return;
-        case QMetaType::QVariantMap:  MapToXML(Name, Value.toMap());               return;
-        case (QVariant::Type)QMetaType::QDateTime:
-        {
-            QDateTime datetime(Value.toDateTime());
-            if (datetime.isNull())
-                m_xmlStream.writeAttribute(QStringLiteral("xsi:nil"), QStringLiteral("true"));
-            m_xmlStream.writeCharacters(datetime.toString(Qt::ISODate));
-            return;
-        }
-        default: m_xmlStream.writeCharacters(Value.toString()); return;
-    }
+    if (!m_elements.isEmpty() && m_elements.pop())
+        m_xmlStream.writeEndElement();
 }
 
-void TorcXMLSerialiser::ListToXML(const QString &Name, const QVariantList &Value)
+void TorcXMLSerialiser::StartObject(QByteArray &Dest, const QString &Name)
 {
-    if (!Value.isEmpty())
-    {
-        int type = Value[0].type();
-        QVariantList::const_iterator it = Value.begin();
-        for ( ; it != Value.end(); ++it)
-        {
-            if ((int)(*it).type() != type)
-            {
-                VariantToXML(QStringLiteral("Error"), QVARIANT_ERROR);
-                return;
-            }
-        }
-    }
+    (void)Dest;
+    StartElement(Name);
+}
 
-    QVariantList::const_iterator it = Value.begin();
-    for ( ; it != Value.end(); ++it)
-    {
-        m_xmlStream.writeStartElement(Name);
-        VariantToXML(Name, (*it));
-        m_xmlStream.writeEndElement();
-    }
+void TorcXMLSerialiser::EndObject(QByteArray &Dest)
+{
+    (void)Dest;
+    EndElement();
 }
 
-void TorcXMLSerialiser::StringListToXML(const QString &Name, const QStringList &Value)
+void TorcXMLSerialiser::StartArray(QByteArray &Dest, const QString &Name)
 {
-    (void)Name;
+    (void)Dest;
+    StartElement(Name);
+}
 
-    QStringList::const_iterator it = Value.begin();
-    for ( ; it != Value.end(); ++it)
-    {
-        m_xmlStream.writeStartElement(QStringLiteral("String"));
-        m_xmlStream.writeCharacters((*it));
-        m_xmlStream.writeEndElement();
-    }
+void TorcXMLSerialiser::EndArray(QByteArray &Dest)
+{
+    (void)Dest;
+    EndElement();
 }
 
-void TorcXMLSerialiser::MapToXML(const QString &Name, const QVariantMap &Value)
+void TorcXMLSerialiser::AddValue(QByteArray &Dest, const QString &Name, const QVariant &Value)
 {
-    QVariantMap::const_iterator it = Value.begin();
-    for ( ; it != Value.end(); ++it)
+    (void)Dest;
+    StartElement(Name);
+
+    if (Value.type() == QVariant::DateTime)
     {
-        m_xmlStream.writeStartElement(it.key());
-        VariantToXML(Name, it.value());
-        m_xmlStream.writeEndElement();
+        QDateTime datetime(Value.toDateTime());
+        if (datetime.isNull())
+            m_xmlStream.writeAttribute(QStringLiteral("xsi:nil"), QStringLiteral("true"));
+        m_xmlStream.writeCharacters(datetime.toString(Qt::ISODate));
     }
+    else
+    {
+        m_xmlStream.writeCharacters(Value.toString());
+    }
+
+    EndElement();
 }
 
 class TorcXMLSerialiserFactory : public TorcSerialiserFactory
@@ -2,6 +2,7 @@
 #define TORCXMLSERIALISER_H
 
 // Qt
+#include <QStack>
 #include <QBuffer>
 #include <QXmlStreamWriter>
 
@@ -15,21 +16,24 @@ class TorcXMLSerialiser : public TorcSerialiser
     virtual ~TorcXMLSerialiser() = default;
 
     virtual HTTPResponseType ResponseType    (void) override;
+    virtual void             StartObject     (QByteArray &Dest, const QString &Name) override;
+    virtual void             EndObject       (QByteArray &Dest) override;
+    virtual void             StartArray      (QByteArray &Dest, const QString &Name) override;
+    virtual void             EndArray        (QByteArray &Dest) override;
+    virtual void             AddValue        (QByteArray &Dest, const QString &Name, const QVariant &Value) override;
 
   protected:
     virtual void             Prepare         (QByteArray &Dest) override;
     virtual void             Begin           (QByteArray &Dest) override;
-    virtual void             AddProperty     (QByteArray &Dest, const QString &Name, const QVariant &Value) override;
     virtual void             End             (QByteArray &Dest) override;
 
-    void                     VariantToXML    (const QString &Name, const QVariant &Value);
-    void                     ListToXML       (const QString &Name, const QVariantList &Value);
-    void                     StringListToXML (const QString &Name, const QStringList &Value);
-    void                     MapToXML        (const QString &Name, const QVariantMap &Value);
+    void                     StartElement    (const QString &Name);
+    void                     EndElement      (void);
 
   protected:
     QXmlStreamWriter m_xmlStream;
     QBuffer          m_buffer;
+    QStack<bool>     m_elements;
 
   private:
     Q_DISABLE_COPY(TorcXMLSerialiser)
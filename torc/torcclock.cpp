@@ -0,0 +1,91 @@
+/* Class TorcClock
+*
+* This file is part of the Torc project.
+*
+* Copyright (C) Mark Kendall 2018
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+* USA.
+*/
+
+// Qt
+#include <QAtomicInt>
+#include <QElapsedTimer>
+
+// Torc
+#include "torcclock.h"
+
+// NB the clock is read from worker threads (e.g. logic controls)
+static QAtomicInt             gVirtual(0);
+static QAtomicInteger<qint64> gVirtualTime(0);
+
+static QElapsedTimer StartedTimer(void)
+{
+    QElapsedTimer timer;
+    timer.start();
+    return timer;
+}
+
+/*! \class TorcClock
+ *  \brief The time source for controls.
+ *
+ * By default TorcClock reports the wall clock. Once SetVirtualTime is called, it reports the given time instead and
+ * timers are no longer driven by the event loop - the owner of the virtual clock (e.g. TorcSimulator) must move time forward
+ * and service TorcTimerScheduler and TorcTransitionClock itself. This allows a configuration to be run much faster
+ * than real time.
+ *
+ * \note The virtual clock must only be changed from the main thread.
+*/
+
+/// The current time in milliseconds since the epoch.
+qint64 TorcClock::CurrentMSecsSinceEpoch(void)
+{
+    return gVirtual.loadAcquire() ? gVirtualTime.loadAcquire() : QDateTime::currentMSecsSinceEpoch();
+}
+
+QDateTime TorcClock::CurrentDateTime(void)
+{
+    return gVirtual.loadAcquire() ? QDateTime::fromMSecsSinceEpoch(gVirtualTime.loadAcquire()) : QDateTime::currentDateTime();
+}
+
+/*! \brief A monotonic time in milliseconds.
+ *
+ * The real clock is unaffected by changes to the system time. The virtual clock is the same as CurrentMSecsSinceEpoch.
+*/
+qint64 TorcClock::Elapsed(void)
+{
+    // NB initialised once, safely, as logic controls may call this from worker threads
+    static const QElapsedTimer timer = StartedTimer();
+    if (gVirtual.loadAcquire())
+        return gVirtualTime.loadAcquire();
+    return timer.elapsed();
+}
+
+bool TorcClock::IsVirtual(void)
+{
+    return gVirtual.loadAcquire();
+}
+
+/// Switch to (or move) the virtual clock.
+void TorcClock::SetVirtualTime(qint64 MSecsSinceEpoch)
+{
+    gVirtualTime.storeRelease(MSecsSinceEpoch);
+    gVirtual.storeRelease(1);
+}
+
+void TorcClock::SetRealTime(void)
+{
+    gVirtual.storeRelease(0);
+}
@@ -0,0 +1,22 @@
+#ifndef TORCCLOCK_H
+#define TORCCLOCK_H
+
+// Qt
+#include <QDateTime>
+
+class TorcClock
+{
+  public:
+    static qint64    CurrentMSecsSinceEpoch (void);
+    static QDateTime CurrentDateTime        (void);
+    static qint64    Elapsed                (void);
+    static bool      IsVirtual              (void);
+    static void      SetVirtualTime         (qint64 MSecsSinceEpoch);
+    static void      SetRealTime            (void);
+
+  private:
+    TorcClock() = default;
+    ~TorcClock() = default;
+};
+
+#endif // TORCCLOCK_H
@@ -116,6 +116,13 @@ TorcCommandLine::TorcCommandLine(Options Flags)
         AddPriv(QStringLiteral("logfile"), QStringLiteral(""), QStringLiteral("Override the logfile location."));
     if (options.testFlag(TorcCommandLine::XSDTest))
         AddPriv(QStringLiteral("xsdtest"), QStringLiteral(""), QStringLiteral("Run validation of test configuration XML files found in the given directory."), TorcCommandLine::XSDTest);
+    if (options.testFlag(TorcCommandLine::Simulate))
+    {
+        AddPriv(QStringLiteral("simulate"), QStringLiteral(""), QStringLiteral("Run the configuration offline against the given timeline file, faster than real time."), TorcCommandLine::Simulate);
+        AddPriv(QStringLiteral("trace"), QStringLiteral(""), QStringLiteral("Write the output trace from a simulation to the given file (default stdout)."), TorcCommandLine::Simulate);
+    }
+    if (options.testFlag(TorcCommandLine::PWMBenchmark))
+        AddPriv(QStringLiteral("pwmbenchmark"), QStringLiteral(""), QStringLiteral("Compare the CPU used by each PWM method on the given GPIO pin."), TorcCommandLine::PWMBenchmark);
     if (options.testFlag(TorcCommandLine::ConfDir))
         AddPriv(QStringLiteral("c,config"), QStringLiteral(""), QStringLiteral("Override the configuration directory for XML config file, database etc."));
     if (options.testFlag(TorcCommandLine::ShareDir))
@@ -29,7 +29,9 @@ class TorcCommandLine
         XSDTest  = (1 << 6),
         ConfDir  = (1 << 7),
         ShareDir = (1 << 8),
-        TransDir = (1 << 9)
+        TransDir = (1 << 9),
+        Simulate = (1 << 10),
+        PWMBenchmark = (1 << 11)
     };
 
     Q_DECLARE_FLAGS(Options, Option)
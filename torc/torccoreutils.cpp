@@ -246,3 +246,26 @@ QByteArray TorcCoreUtils::GZipCompressFile(QFile &Source)
     return result;
 #endif
 }
+
+/*! \brief Write Value to a kernel attribute file (e.g. in /sys) in a single write.
+ *
+ * Returns false if the file cannot be opened or the kernel rejects the value.
+*/
+bool TorcCoreUtils::WriteSysfsAttribute(const QString &File, const QByteArray &Value)
+{
+    QFile file(File);
+    if (!file.open(QIODevice::WriteOnly))
+        return false;
+    bool result = file.write(Value) == Value.size();
+    file.close();
+    return result;
+}
+
+/// \brief Read a kernel attribute file (e.g. in /sys), without surrounding whitespace. Returns an empty array on failure.
+QByteArray TorcCoreUtils::ReadSysfsAttribute(const QString &File)
+{
+    QFile file(File);
+    if (!file.open(QIODevice::ReadOnly))
+        return QByteArray();
+    return file.readAll().trimmed();
+}
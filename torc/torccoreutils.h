@@ -14,6 +14,8 @@ namespace TorcCoreUtils
     bool        HasZlib               (void);
     QByteArray  GZipCompress          (QByteArray &Source);
     QByteArray  GZipCompressFile      (QFile &Source);
+    bool        WriteSysfsAttribute   (const QString &File, const QByteArray &Value);
+    QByteArray  ReadSysfsAttribute    (const QString &File);
 
     template <typename T> QString EnumToLowerString(T Value)
     {
@@ -0,0 +1,416 @@
+/* Class TorcWindowStatistics/TorcEWMA/TorcPercentile
+*
+* Copyright (C) Mark Kendall 2018
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+*/
+
+// Qt
+#include <QtGlobal>
+
+// Torc
+#include "torcmaths.h"
+
+// std
+#include <algorithm>
+#include <cmath>
+
+/*! \class TorcWindowStatistics
+ *  \brief Streaming statistics for the samples added within a period of time.
+ *
+ * Samples older than Window (in milliseconds) are discarded as new samples are added (or Expire is called). If more
+ * than Capacity samples fall within the window, the oldest are discarded early - so memory use is fixed.
+ *
+ * The mean and variance are updated incrementally (Welford) as samples are added and removed and are recalculated
+ * from the retained samples after every Capacity removals, so rounding error cannot accumulate. The minimum and
+ * maximum are tracked with monotonic queues. All updates are O(1) amortised.
+ *
+ * \note Samples are not weighted by time - a value that is unchanged for most of the window counts once.
+*/
+TorcWindowStatistics::TorcWindowStatistics(qint64 Window, int Capacity)
+  : m_window(qMax(Window, (qint64)1)),
+    m_sequence(0),
+    m_mean(0.0),
+    m_m2(0.0),
+    m_removals(0),
+    m_samples(Capacity),
+    m_minimums(Capacity),
+    m_maximums(Capacity)
+{
+}
+
+void TorcWindowStatistics::AddValue(qint64 Time, double Value)
+{
+    Expire(Time);
+    if (m_samples.IsFull())
+        Remove();
+
+    Sample sample = { Time, m_sequence++, Value };
+    m_samples.PushBack(sample);
+
+    double delta = Value - m_mean;
+    m_mean += delta / m_samples.Size();
+    m_m2   += delta * (Value - m_mean);
+
+    while (!m_minimums.IsEmpty() && m_minimums.Back().value >= Value)
+        (void)m_minimums.PopBack();
+    m_minimums.PushBack(sample);
+    while (!m_maximums.IsEmpty() && m_maximums.Back().value <= Value)
+        (void)m_maximums.PopBack();
+    m_maximums.PushBack(sample);
+}
+
+/// Discard samples that are older than the window at Time.
+void TorcWindowStatistics::Expire(qint64 Time)
+{
+    while (!m_samples.IsEmpty() && (Time - m_samples.Front().time) >= m_window)
+        Remove();
+}
+
+/// Return the time at which the oldest sample leaves the window. Returns false if the window is empty.
+bool TorcWindowStatistics::NextExpiry(qint64 &Time) const
+{
+    if (m_samples.IsEmpty())
+        return false;
+    Time = m_samples.Front().time + m_window;
+    return true;
+}
+
+void TorcWindowStatistics::Reset(void)
+{
+    m_samples.Clear();
+    m_minimums.Clear();
+    m_maximums.Clear();
+    m_mean     = 0.0;
+    m_m2       = 0.0;
+    m_removals = 0;
+}
+
+int TorcWindowStatistics::Count(void) const
+{
+    return m_samples.Size();
+}
+
+double TorcWindowStatistics::Mean(void) const
+{
+    return m_mean;
+}
+
+/// The population variance of the samples in the window.
+double TorcWindowStatistics::Variance(void) const
+{
+    return m_samples.Size() > 1 ? qMax(m_m2, 0.0) / m_samples.Size() : 0.0;
+}
+
+double TorcWindowStatistics::Deviation(void) const
+{
+    return std::sqrt(Variance());
+}
+
+double TorcWindowStatistics::Minimum(void) const
+{
+    return m_minimums.IsEmpty() ? 0.0 : m_minimums.Front().value;
+}
+
+double TorcWindowStatistics::Maximum(void) const
+{
+    return m_maximums.IsEmpty() ? 0.0 : m_maximums.Front().value;
+}
+
+/// The change per second between the oldest and newest samples in the window.
+double TorcWindowStatistics::RateOfChange(void) const
+{
+    if (m_samples.Size() < 2)
+        return 0.0;
+
+    const Sample &first = m_samples.Front();
+    const Sample &last  = m_samples.Back();
+    if (last.time <= first.time)
+        return 0.0;
+    return ((last.value - first.value) * 1000.0) / (last.time - first.time);
+}
+
+/// Remove the oldest sample.
+void TorcWindowStatistics::Remove(void)
+{
+    Sample sample = m_samples.PopFront();
+    if (!m_minimums.IsEmpty() && m_minimums.Front().sequence == sample.sequence)
+        (void)m_minimums.PopFront();
+    if (!m_maximums.IsEmpty() && m_maximums.Front().sequence == sample.sequence)
+        (void)m_maximums.PopFront();
+
+    int count = m_samples.Size();
+    if (count < 1)
+    {
+        m_mean     = 0.0;
+        m_m2       = 0.0;
+        m_removals = 0;
+        return;
+    }
+
+    double delta = sample.value - m_mean;
+    m_mean -= delta / count;
+    m_m2   -= delta * (sample.value - m_mean);
+
+    if (++m_removals >= m_samples.Capacity())
+        Recalculate();
+}
+
+/// Recalculate the mean and sum of squares from the retained samples.
+void TorcWindowStatistics::Recalculate(void)
+{
+    int count = m_samples.Size();
+    TorcSum sum;
+    for (int i = 0; i < count; ++i)
+        sum.Add(m_samples.At(i).value);
+    m_mean = count ? sum.Value() / count : 0.0;
+
+    TorcSum squares;
+    for (int i = 0; i < count; ++i)
+    {
+        double delta = m_samples.At(i).value - m_mean;
+        squares.Add(delta * delta);
+    }
+    m_m2       = squares.Value();
+    m_removals = 0;
+}
+
+/*! \class TorcEWMA
+ *  \brief An exponentially weighted moving average for irregularly timed samples.
+ *
+ * The weight given to each new sample depends on the time elapsed since the previous sample, such that a step change
+ * in the input is 63% complete after TimeConstant milliseconds.
+*/
+TorcEWMA::TorcEWMA(qint64 TimeConstant)
+  : m_timeConstant(qMax(TimeConstant, (qint64)1)),
+    m_lastTime(0),
+    m_first(true),
+    m_average(0.0)
+{
+}
+
+double TorcEWMA::AddValue(qint64 Time, double Value)
+{
+    if (m_first)
+    {
+        m_average = Value;
+        m_first   = false;
+    }
+    else
+    {
+        qint64 elapsed = qMax(Time - m_lastTime, (qint64)0);
+        double alpha   = 1.0 - std::exp(-static_cast<double>(elapsed) / m_timeConstant);
+        m_average += alpha * (Value - m_average);
+    }
+
+    m_lastTime = Time;
+    return m_average;
+}
+
+double TorcEWMA::GetAverage(void) const
+{
+    return m_average;
+}
+
+void TorcEWMA::Reset(void)
+{
+    m_first   = true;
+    m_average = 0.0;
+}
+
+/*! \class TorcPercentile
+ *  \brief Estimate a percentile of a stream of values using five markers.
+ *
+ * This is the P-Square algorithm (Jain and Chlamtac) - memory use is fixed and each update is O(1).
+ * Percentile is a fraction (i.e. 0.5 for the median). Until five values have been added, the result is exact.
+*/
+TorcPercentile::TorcPercentile(double Percentile)
+  : m_percentile(qBound(0.0, Percentile, 1.0)),
+    m_count(0),
+    m_heights(),
+    m_positions(),
+    m_desired(),
+    m_increments()
+{
+    Reset();
+}
+
+void TorcPercentile::AddValue(double Value)
+{
+    if (m_count < 5)
+    {
+        m_heights[m_count++] = Value;
+        if (m_count == 5)
+            std::sort(m_heights, m_heights + 5);
+        return;
+    }
+
+    m_count++;
+
+    // find the cell containing the value, adjusting the extremes if needed
+    int cell = 0;
+    if (Value < m_heights[0])
+    {
+        m_heights[0] = Value;
+    }
+    else if (Value >= m_heights[4])
+    {
+        m_heights[4] = Value;
+        cell = 3;
+    }
+    else
+    {
+        while (cell < 3 && Value >= m_heights[cell + 1])
+            cell++;
+    }
+
+    for (int i = cell + 1; i < 5; ++i)
+        m_positions[i] += 1.0;
+    for (int i = 0; i < 5; ++i)
+        m_desired[i] += m_increments[i];
+
+    // adjust the middle markers if they are too far from their desired positions
+    for (int i = 1; i < 4; ++i)
+    {
+        double delta = m_desired[i] - m_positions[i];
+        if ((delta >= 1.0  && (m_positions[i + 1] - m_positions[i]) > 1.0) ||
+            (delta <= -1.0 && (m_positions[i - 1] - m_positions[i]) < -1.0))
+        {
+            int direction = delta < 0 ? -1 : 1;
+            double height = Parabolic(i, direction);
+            if (m_heights[i - 1] < height && height < m_heights[i + 1])
+                m_heights[i] = height;
+            else
+                m_heights[i] = Linear(i, direction);
+            m_positions[i] += direction;
+        }
+    }
+}
+
+double TorcPercentile::GetValue(void) const
+{
+    if (m_count >= 5)
+        return m_heights[2];
+    if (m_count < 1)
+        return 0.0;
+
+    double sorted[5];
+    std::copy(m_heights, m_heights + m_count, sorted);
+    std::sort(sorted, sorted + m_count);
+    return sorted[qRound(m_percentile * (m_count - 1))];
+}
+
+quint64 TorcPercentile::Count(void) const
+{
+    return m_count;
+}
+
+void TorcPercentile::Reset(void)
+{
+    m_count = 0;
+    for (int i = 0; i < 5; ++i)
+    {
+        m_heights[i]   = 0.0;
+        m_positions[i] = i + 1;
+    }
+
+    m_desired[0]    = 1.0;
+    m_desired[1]    = 1.0 + 2.0 * m_percentile;
+    m_desired[2]    = 1.0 + 4.0 * m_percentile;
+    m_desired[3]    = 3.0 + 2.0 * m_percentile;
+    m_desired[4]    = 5.0;
+    m_increments[0] = 0.0;
+    m_increments[1] = m_percentile / 2.0;
+    m_increments[2] = m_percentile;
+    m_increments[3] = (1.0 + m_percentile) / 2.0;
+    m_increments[4] = 1.0;
+}
+
+double TorcPercentile::Parabolic(int Index, double Direction) const
+{
+    double below = m_positions[Index] - m_positions[Index - 1];
+    double above = m_positions[Index + 1] - m_positions[Index];
+    return m_heights[Index] + Direction / (m_positions[Index + 1] - m_positions[Index - 1]) *
+           ((below + Direction) * (m_heights[Index + 1] - m_heights[Index]) / above +
+            (above - Direction) * (m_heights[Index] - m_heights[Index - 1]) / below);
+}
+
+double TorcPercentile::Linear(int Index, int Direction) const
+{
+    return m_heights[Index] + Direction * (m_heights[Index + Direction] - m_heights[Index]) /
+           (m_positions[Index + Direction] - m_positions[Index]);
+}
+
+/*! \class TorcWindowPercentile
+ *  \brief Estimate a percentile of the values added within (approximately) a period of time.
+ *
+ * A P-Square estimate cannot forget old values, so two estimators are restarted every Window milliseconds, offset
+ * by half a window. The result comes from whichever has been running longer and hence always covers between one
+ * half and one whole window.
+*/
+TorcWindowPercentile::TorcWindowPercentile(double Percentile, qint64 Window)
+  : m_window(qMax(Window, (qint64)2)),
+    m_origin(0),
+    m_started(false),
+    m_epochs(),
+    m_first(Percentile),
+    m_second(Percentile)
+{
+    Reset();
+}
+
+double TorcWindowPercentile::AddValue(qint64 Time, double Value)
+{
+    if (!m_started)
+    {
+        m_origin  = Time;
+        m_started = true;
+    }
+
+    qint64 elapsed = qMax(Time - m_origin, (qint64)0);
+    qint64 half    = m_window / 2;
+    qint64 first   = elapsed / m_window;
+    if (first != m_epochs[0])
+    {
+        m_first.Reset();
+        m_epochs[0] = first;
+    }
+    m_first.AddValue(Value);
+
+    if (elapsed < half)
+        return m_first.GetValue();
+
+    qint64 second = (elapsed - half) / m_window;
+    if (second != m_epochs[1])
+    {
+        m_second.Reset();
+        m_epochs[1] = second;
+    }
+    m_second.AddValue(Value);
+
+    // the estimator whose current period started earlier has seen more of the window
+    qint64 firstage  = elapsed % m_window;
+    qint64 secondage = (elapsed - half) % m_window;
+    return firstage >= secondage ? m_first.GetValue() : m_second.GetValue();
+}
+
+void TorcWindowPercentile::Reset(void)
+{
+    m_started   = false;
+    m_epochs[0] = -1;
+    m_epochs[1] = -1;
+    m_first.Reset();
+    m_second.Reset();
+}
@@ -2,7 +2,90 @@
 #define TORCMATHS_H
 
 // Qt
-#include <QQueue>
+#include <QVector>
+
+/*! \brief A fixed capacity first in, first out buffer.
+ *
+ * Storage is allocated once at construction and never resized. Values may be added to and removed from
+ * either end in constant time. PushBack must not be called when the buffer is full.
+*/
+template <typename T> class TorcRingBuffer
+{
+  public:
+    explicit TorcRingBuffer(int Capacity)
+      : m_values(qMax(Capacity, 1)),
+        m_head(0),
+        m_size(0)
+    {
+    }
+
+    int      Capacity  (void) const { return m_values.size(); }
+    int      Size      (void) const { return m_size; }
+    bool     IsEmpty   (void) const { return m_size == 0; }
+    bool     IsFull    (void) const { return m_size == m_values.size(); }
+    const T& Front     (void) const { return m_values.at(m_head); }
+    const T& Back      (void) const { return At(m_size - 1); }
+    const T& At        (int Index) const { return m_values.at(Wrap(m_head + Index)); }
+    void     Clear     (void)       { m_head = 0; m_size = 0; }
+
+    void PushBack(const T &Value)
+    {
+        m_values[Wrap(m_head + m_size)] = Value;
+        m_size++;
+    }
+
+    T PopFront(void)
+    {
+        T result = m_values.at(m_head);
+        m_head = Wrap(m_head + 1);
+        m_size--;
+        return result;
+    }
+
+    T PopBack(void)
+    {
+        m_size--;
+        return m_values.at(Wrap(m_head + m_size));
+    }
+
+  private:
+    int Wrap(int Index) const
+    {
+        return Index >= m_values.size() ? Index - m_values.size() : Index;
+    }
+
+  private:
+    QVector<T> m_values;
+    int        m_head;
+    int        m_size;
+};
+
+/*! \brief A compensated (Kahan-Babuska) sum.
+ *
+ * Values can be repeatedly added and subtracted without the rounding error growing with the number of operations.
+*/
+class TorcSum
+{
+  public:
+    TorcSum() : m_sum(0.0), m_compensation(0.0) { }
+
+    void Add(double Value)
+    {
+        double sum = m_sum + Value;
+        if (qAbs(m_sum) >= qAbs(Value))
+            m_compensation += (m_sum - sum) + Value;
+        else
+            m_compensation += (Value - sum) + m_sum;
+        m_sum = sum;
+    }
+
+    double Value (void) const { return m_sum + m_compensation; }
+    void   Reset (void)       { m_sum = 0.0; m_compensation = 0.0; }
+
+  private:
+    double m_sum;
+    double m_compensation;
+};
 
 /*! \brief Compute a running average.
  *
@@ -12,46 +95,146 @@ template <typename T> class TorcAverage
 {
   public:
     explicit TorcAverage(int MaxCount = 0)
-      : m_average(0.0),
+      : m_sum(),
         m_count(0),
         m_maxCount(MaxCount),
-        m_values()
+        m_values(MaxCount)
     {
     }
 
     double AddValue(T Value)
     {
-        if (m_maxCount)
+        if (m_maxCount > 0)
         {
-            while (m_values.size() >= m_maxCount)
+            if (m_values.IsFull())
             {
-                m_average = ((m_average * m_count) - m_values.dequeue()) / (m_count - 1);
+                m_sum.Add(-static_cast<double>(m_values.PopFront()));
                 m_count--;
             }
-            m_values.enqueue(Value);
+            m_values.PushBack(Value);
         }
-        m_average = ((m_average * m_count) + Value) / (m_count + 1);
+        m_sum.Add(static_cast<double>(Value));
         m_count++;
-        return m_average;
+        return GetAverage();
     }
 
-    double GetAverage(void)
+    double GetAverage(void) const
     {
-        return m_average;
+        return m_count ? m_sum.Value() / m_count : 0.0;
     }
 
     void Reset(void)
     {
-        m_average = 0.0;
+        m_sum.Reset();
         m_count = 0;
-        m_values.clear();
+        m_values.Clear();
     }
 
   private:
-    double    m_average;
-    quint64   m_count;
-    int       m_maxCount;
-    QQueue<T> m_values;
+    TorcSum           m_sum;
+    quint64           m_count;
+    int               m_maxCount;
+    TorcRingBuffer<T> m_values;
+};
+
+class TorcWindowStatistics
+{
+  public:
+    TorcWindowStatistics(qint64 Window, int Capacity);
+   ~TorcWindowStatistics() = default;
+
+    void    AddValue     (qint64 Time, double Value);
+    void    Expire       (qint64 Time);
+    bool    NextExpiry   (qint64 &Time) const;
+    void    Reset        (void);
+    int     Count        (void) const;
+    double  Mean         (void) const;
+    double  Variance     (void) const;
+    double  Deviation    (void) const;
+    double  Minimum      (void) const;
+    double  Maximum      (void) const;
+    double  RateOfChange (void) const;
+
+  private:
+    class Sample
+    {
+      public:
+        qint64  time;
+        quint64 sequence;
+        double  value;
+    };
+
+    void    Remove       (void);
+    void    Recalculate  (void);
+
+  private:
+    qint64                 m_window;
+    quint64                m_sequence;
+    double                 m_mean;
+    double                 m_m2;
+    int                    m_removals;
+    TorcRingBuffer<Sample> m_samples;
+    TorcRingBuffer<Sample> m_minimums;
+    TorcRingBuffer<Sample> m_maximums;
+};
+
+class TorcEWMA
+{
+  public:
+    explicit TorcEWMA(qint64 TimeConstant);
+   ~TorcEWMA() = default;
+
+    double  AddValue     (qint64 Time, double Value);
+    double  GetAverage   (void) const;
+    void    Reset        (void);
+
+  private:
+    qint64  m_timeConstant;
+    qint64  m_lastTime;
+    bool    m_first;
+    double  m_average;
+};
+
+class TorcPercentile
+{
+  public:
+    explicit TorcPercentile(double Percentile);
+   ~TorcPercentile() = default;
+
+    void    AddValue     (double Value);
+    double  GetValue     (void) const;
+    quint64 Count        (void) const;
+    void    Reset        (void);
+
+  private:
+    double  Parabolic    (int Index, double Direction) const;
+    double  Linear       (int Index, int Direction) const;
+
+  private:
+    double  m_percentile;
+    quint64 m_count;
+    double  m_heights[5];
+    double  m_positions[5];
+    double  m_desired[5];
+    double  m_increments[5];
+};
+
+class TorcWindowPercentile
+{
+  public:
+    TorcWindowPercentile(double Percentile, qint64 Window);
+   ~TorcWindowPercentile() = default;
+
+    double  AddValue     (qint64 Time, double Value);
+    void    Reset        (void);
+
+  private:
+    qint64          m_window;
+    qint64          m_origin;
+    bool            m_started;
+    qint64          m_epochs[2];
+    TorcPercentile  m_first;
+    TorcPercentile  m_second;
 };
 
 #endif // TORCMATHS_H
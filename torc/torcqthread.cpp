@@ -94,6 +94,7 @@ void TorcQThread::Deinitialise(void)
     emit Finished();
 
     // ensure database connections are released
-    gLocalContext->CloseDatabaseConnections();
+    if (gLocalContext)
+        gLocalContext->CloseDatabaseConnections();
     DeregisterLoggingThread();
 }
@@ -56,7 +56,8 @@ TorcRPCRequest::TorcRPCRequest(const QString &Method, QObject *Parent)
     m_parameters(),
     m_positionalParameters(),
     m_serialisedData(),
-    m_reply()
+    m_reply(),
+    m_batchResponses()
 {
     SetParent(Parent);
 }
@@ -77,7 +78,8 @@ TorcRPCRequest::TorcRPCRequest(const QString &Method)
     m_parameters(),
     m_positionalParameters(),
     m_serialisedData(),
-    m_reply()
+    m_reply(),
+    m_batchResponses()
 {
 }
 
@@ -95,7 +97,8 @@ TorcRPCRequest::TorcRPCRequest(const QJsonObject &Object, QObject *Parent, bool
     m_parameters(),
     m_positionalParameters(),
     m_serialisedData(),
-    m_reply()
+    m_reply(),
+    m_batchResponses()
 {
     ParseJSONObject(Object);
 }
@@ -115,7 +118,8 @@ TorcRPCRequest::TorcRPCRequest(TorcWebSocketReader::WSSubProtocol Protocol, cons
     m_parameters(),
     m_positionalParameters(),
     m_serialisedData(),
-    m_reply()
+    m_reply(),
+    m_batchResponses()
 {
     if (Protocol != TorcWebSocketReader::SubProtocolJSONRPC)
     {
@@ -150,6 +154,8 @@ TorcRPCRequest::TorcRPCRequest(TorcWebSocketReader::WSSubProtocol Protocol, cons
 
 TorcRPCRequest::~TorcRPCRequest()
 {
+    foreach (TorcRPCRequest *response, m_batchResponses)
+        response->DownRef();
     delete m_parentLock;
 }
 
@@ -199,7 +205,12 @@ void TorcRPCRequest::ProcessBatchCall(const QJsonArray &Array)
             result.append(request->GetData());
         }
 
-        request->DownRef();
+        // responses to batched requests that we sent are retained for the socket to match against
+        // its outstanding requests (see GetBatchResponses)
+        if (request->GetState() & Result)
+            m_batchResponses.append(request);
+        else
+            request->DownRef();
     }
 
     result.append("\r\n]");
@@ -458,3 +469,9 @@ QByteArray& TorcRPCRequest::GetData(void)
 {
     return m_serialisedData;
 }
+
+///\brief Return the individual responses contained in a batched (array) response.
+const QList<TorcRPCRequest*>& TorcRPCRequest::GetBatchResponses(void) const
+{
+    return m_batchResponses;
+}
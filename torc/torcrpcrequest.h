@@ -51,6 +51,8 @@ class TorcRPCRequest : public TorcReferenceCounter
     const QList<QVariant>&
                         GetPositionalParameters(void) const;
     QByteArray&         GetData                (void);
+    const QList<TorcRPCRequest*>&
+                        GetBatchResponses      (void) const;
 
   private:
     explicit TorcRPCRequest(const QJsonObject &Object, QObject *Parent, bool Authenticated);
@@ -75,6 +77,7 @@ class TorcRPCRequest : public TorcReferenceCounter
     QList<QVariant>     m_positionalParameters;
     QByteArray          m_serialisedData;
     QVariant            m_reply;
+    QList<TorcRPCRequest*> m_batchResponses;
 };
 
 Q_DECLARE_METATYPE(TorcRPCRequest*)